@@ -14,9 +14,9 @@
  * limitations under the License.
  */
 
-#include <android-base/file.h>
+#include <sys/stat.h>
+
 #include <android-base/logging.h>
-#include <android-base/stringprintf.h>
 
 #include "AtraceDevice.h"
 
@@ -29,31 +29,19 @@ namespace implementation {
 using ::android::hardware::atrace::V1_0::Status;
 using ::android::hardware::atrace::V1_0::TracingCategory;
 
-struct TracingConfig {
-    std::string description;
-    // path and if error on failure
-    std::vector<std::pair<std::string, bool>> paths;
-};
-
-// This is a map stores categories and their sysfs paths with required flags
-const std::map<std::string, TracingConfig> kTracingMap = {
-        // gfx
-        {
-                "gfx",
-                {"Graphics", {{"mdss", false}, {"sde", false}, {"mali_systrace", false}}},
-        },
-        {
-                "ion",
-                {"ION allocation", {{"kmem/ion_alloc_buffer_start", false}}},
-        },
-};
+// Replaces the built-in categories when present, see TracingCategoryManager::parseConfig.
+constexpr char kCategoryConfigPath[] = "/vendor/etc/atrace/atrace_categories.txt";
+// Where the events enabled by the HAL are recorded, so that they're disabled after a restart.
+// On tmpfs, created by the init rc.
+constexpr char kStatePath[] = "/dev/atrace-hal/enabled_events";
 
 // Methods from ::android::hardware::atrace::V1_0::IAtraceDevice follow.
 Return<void> AtraceDevice::listCategories(listCategories_cb _hidl_cb) {
+    const auto& tracingMap = manager_->categories();
     hidl_vec<TracingCategory> categories;
-    categories.resize(kTracingMap.size());
+    categories.resize(tracingMap.size());
     std::size_t i = 0;
-    for (auto& c : kTracingMap) {
+    for (auto& c : tracingMap) {
         categories[i].name = c.first;
         categories[i].description = c.second.description;
         i++;
@@ -72,51 +60,22 @@ AtraceDevice::AtraceDevice() {
                                                               "/sys/kernel/tracing or "
                                                               "/sys/kernel/debug/tracing";
     }
+
+    auto categories = TracingCategoryManager::loadConfig(kCategoryConfigPath);
+    manager_ = std::make_unique<TracingCategoryManager>(
+            tracefs_event_root_,
+            categories ? *std::move(categories) : TracingCategoryManager::defaultCategories(),
+            kStatePath);
 }
 
 Return<::android::hardware::atrace::V1_0::Status> AtraceDevice::enableCategories(
         const hidl_vec<hidl_string>& categories) {
-    if (!categories.size()) {
-        return Status::ERROR_INVALID_ARGUMENT;
-    }
-
-    for (auto& c : categories) {
-        if (kTracingMap.count(c)) {
-            for (auto& p : kTracingMap.at(c).paths) {
-                std::string tracefs_event_enable_path = android::base::StringPrintf(
-                        "%s%s/enable", tracefs_event_root_.c_str(), p.first.c_str());
-                if (!android::base::WriteStringToFile("1", tracefs_event_enable_path)) {
-                    LOG(ERROR) << "Failed to enable tracing on: " << tracefs_event_enable_path;
-                    if (p.second) {
-                        // disable before return
-                        disableAllCategories();
-                        return Status::ERROR_TRACING_POINT;
-                    }
-                }
-            }
-        } else {
-            return Status::ERROR_INVALID_ARGUMENT;
-        }
-    }
-    return Status::SUCCESS;
+    std::vector<std::string> names(categories.begin(), categories.end());
+    return manager_->enable(names);
 }
 
 Return<::android::hardware::atrace::V1_0::Status> AtraceDevice::disableAllCategories() {
-    auto ret = Status::SUCCESS;
-
-    for (auto& c : kTracingMap) {
-        for (auto& p : c.second.paths) {
-            std::string tracefs_event_enable_path = android::base::StringPrintf(
-                    "%s%s/enable", tracefs_event_root_.c_str(), p.first.c_str());
-            if (!android::base::WriteStringToFile("0", tracefs_event_enable_path)) {
-                LOG(ERROR) << "Failed to disable tracing on: " << tracefs_event_enable_path;
-                if (p.second) {
-                    ret = Status::ERROR_TRACING_POINT;
-                }
-            }
-        }
-    }
-    return ret;
+    return manager_->disableAll();
 }
 
 }  // namespace implementation
@@ -17,10 +17,14 @@
 #ifndef ANDROID_HARDWARE_ATRACE_V1_0_ATRACEDEVICE_H
 #define ANDROID_HARDWARE_ATRACE_V1_0_ATRACEDEVICE_H
 
+#include <memory>
+
 #include <android/hardware/atrace/1.0/IAtraceDevice.h>
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
 
+#include "TracingCategoryManager.h"
+
 namespace android {
 namespace hardware {
 namespace atrace {
@@ -45,6 +49,7 @@ struct AtraceDevice : public IAtraceDevice {
 
   private:
     std::string tracefs_event_root_;
+    std::unique_ptr<TracingCategoryManager> manager_;
 
     // Methods from ::android::hidl::base::V1_0::IBase follow.
 };
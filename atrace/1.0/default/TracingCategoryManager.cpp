@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TracingCategoryManager.h"
+
+#include <cerrno>
+#include <sstream>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+
+namespace android {
+namespace hardware {
+namespace atrace {
+namespace V1_0 {
+namespace implementation {
+
+namespace {
+
+bool isValidEventPath(const std::string& path) {
+    if (path.empty() || path.front() == '/' || path.back() == '/') {
+        return false;
+    }
+    for (const auto& component : android::base::Split(path, "/")) {
+        if (component.empty() || component == "." || component == "..") {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+std::optional<TracingCategoryMap> TracingCategoryManager::parseConfig(const std::string& config,
+                                                                      std::string* error) {
+    TracingCategoryMap categories;
+    std::istringstream lines(config);
+    std::string line;
+    for (int lineNumber = 1; std::getline(lines, line); lineNumber++) {
+        line = android::base::Trim(line);
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+        std::istringstream words(line);
+        std::string keyword, name;
+        words >> keyword >> name;
+        auto fail = [&](const std::string& reason) {
+            *error = "line " + std::to_string(lineNumber) + ": " + reason;
+            return std::nullopt;
+        };
+        if (name.empty()) {
+            return fail("missing name");
+        }
+
+        if (keyword == "category") {
+            std::string description;
+            std::getline(words, description);
+            description = android::base::Trim(description);
+            if (description.empty()) {
+                return fail("missing description of " + name);
+            }
+            if (!categories.emplace(name, TracingConfig{description, {}}).second) {
+                return fail("duplicate category " + name);
+            }
+        } else if (keyword == "event") {
+            std::string path, flag, extra;
+            words >> path >> flag >> extra;
+            auto category = categories.find(name);
+            if (category == categories.end()) {
+                return fail("undeclared category " + name);
+            }
+            if (!isValidEventPath(path)) {
+                return fail("invalid event path '" + path + "'");
+            }
+            if ((!flag.empty() && flag != "required") || !extra.empty()) {
+                return fail("unexpected '" + flag + extra + "'");
+            }
+            category->second.events.push_back({path, flag == "required"});
+        } else {
+            return fail("unknown statement " + keyword);
+        }
+    }
+    for (const auto& [name, category] : categories) {
+        if (category.events.empty()) {
+            *error = "category " + name + " has no events";
+            return std::nullopt;
+        }
+    }
+    return categories;
+}
+
+std::optional<TracingCategoryMap> TracingCategoryManager::loadConfig(const std::string& path) {
+    std::string config;
+    if (!android::base::ReadFileToString(path, &config)) {
+        if (errno != ENOENT) {
+            PLOG(ERROR) << "Failed to read " << path;
+        }
+        return std::nullopt;
+    }
+    std::string error;
+    auto categories = parseConfig(config, &error);
+    if (!categories) {
+        LOG(ERROR) << path << ": " << error;
+    }
+    return categories;
+}
+
+TracingCategoryMap TracingCategoryManager::defaultCategories() {
+    return {
+            // gfx
+            {
+                    "gfx",
+                    {"Graphics", {{"mdss", false}, {"sde", false}, {"mali_systrace", false}}},
+            },
+            {
+                    "ion",
+                    {"ION allocation", {{"kmem/ion_alloc_buffer_start", false}}},
+            },
+    };
+}
+
+TracingCategoryManager::TracingCategoryManager(std::string eventRoot,
+                                               TracingCategoryMap categories, std::string statePath)
+    : event_root_(std::move(eventRoot)),
+      categories_(std::move(categories)),
+      state_path_(std::move(statePath)) {
+    std::string state;
+    if (state_path_.empty() || !android::base::ReadFileToString(state_path_, &state)) {
+        return;
+    }
+    for (const auto& event : android::base::Split(state, "\n")) {
+        if (isValidEventPath(event)) {
+            inherited_events_.insert(event);
+        }
+    }
+    if (!inherited_events_.empty()) {
+        LOG(INFO) << "Taking over " << inherited_events_.size()
+                  << " events enabled by a previous instance";
+    }
+}
+
+std::string TracingCategoryManager::enablePath(const std::string& event) const {
+    return event_root_ + event + "/enable";
+}
+
+Status TracingCategoryManager::enable(const std::vector<std::string>& categories) {
+    if (categories.empty()) {
+        return Status::ERROR_INVALID_ARGUMENT;
+    }
+    // Collect the events first, so an unknown category doesn't leave anything half done.
+    std::map<std::string, bool> requested;
+    for (const auto& c : categories) {
+        auto category = categories_.find(c);
+        if (category == categories_.end()) {
+            return Status::ERROR_INVALID_ARGUMENT;
+        }
+        for (const auto& event : category->second.events) {
+            requested[event.path] |= event.required;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+    std::vector<std::string> acquired;
+    for (const auto& [event, required] : requested) {
+        auto held = events_.find(event);
+        if (held != events_.end()) {
+            held->second.required |= required;
+            continue;
+        }
+
+        EventState state;
+        state.required = required;
+        const std::string path = enablePath(event);
+        std::string value;
+        if (android::base::ReadFileToString(path, &value) && android::base::Trim(value) == "1") {
+            state.owned = inherited_events_.count(event) > 0;
+            events_.emplace(event, state);
+            acquired.push_back(event);
+            continue;
+        }
+        if (android::base::WriteStringToFile("1", path)) {
+            state.owned = true;
+            events_.emplace(event, state);
+            acquired.push_back(event);
+            continue;
+        }
+
+        LOG(ERROR) << "Failed to enable tracing on: " << path;
+        if (required) {
+            for (const auto& e : acquired) {
+                auto node = events_.extract(e);
+                releaseLocked(e, node.mapped());
+            }
+            saveLocked();
+            return Status::ERROR_TRACING_POINT;
+        }
+    }
+    saveLocked();
+    return Status::SUCCESS;
+}
+
+Status TracingCategoryManager::disableAll() {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto ret = Status::SUCCESS;
+    for (const auto& [event, state] : events_) {
+        if (!releaseLocked(event, state)) {
+            ret = Status::ERROR_TRACING_POINT;
+        }
+        inherited_events_.erase(event);
+    }
+    // Those of the previous instance which no request of ours has claimed since.
+    EventState inherited;
+    inherited.owned = true;
+    for (const auto& event : inherited_events_) {
+        releaseLocked(event, inherited);
+    }
+    events_.clear();
+    inherited_events_.clear();
+    saveLocked();
+    return ret;
+}
+
+bool TracingCategoryManager::releaseLocked(const std::string& event, const EventState& state) {
+    if (!state.owned) {
+        return true;
+    }
+
+    const std::string path = enablePath(event);
+    std::string value;
+    if (android::base::ReadFileToString(path, &value) && android::base::Trim(value) == "0") {
+        return true;
+    }
+    if (!android::base::WriteStringToFile("0", path)) {
+        LOG(ERROR) << "Failed to disable tracing on: " << path;
+        return !state.required;
+    }
+    return true;
+}
+
+void TracingCategoryManager::saveLocked() {
+    if (state_path_.empty()) {
+        return;
+    }
+    std::string state;
+    for (const auto& [event, eventState] : events_) {
+        if (eventState.owned) {
+            state += event + "\n";
+        }
+    }
+    for (const auto& event : inherited_events_) {
+        if (events_.count(event) == 0) {
+            state += event + "\n";
+        }
+    }
+    if (!android::base::WriteStringToFile(state, state_path_)) {
+        PLOG(ERROR) << "Failed to write " << state_path_;
+    }
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace atrace
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_ATRACE_V1_0_TRACINGCATEGORYMANAGER_H
+#define ANDROID_HARDWARE_ATRACE_V1_0_TRACINGCATEGORYMANAGER_H
+
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <android-base/thread_annotations.h>
+#include <android/hardware/atrace/1.0/types.h>
+
+namespace android {
+namespace hardware {
+namespace atrace {
+namespace V1_0 {
+namespace implementation {
+
+struct TracingEvent {
+    // Path of the event or event subsystem, relative to the tracefs events directory.
+    std::string path;
+    // Whether failing to enable the event fails the whole request.
+    bool required = false;
+};
+
+struct TracingConfig {
+    std::string description;
+    std::vector<TracingEvent> events;
+};
+
+using TracingCategoryMap = std::map<std::string, TracingConfig>;
+
+/**
+ * Enables the tracefs events of vendor categories.
+ *
+ * A tracing session may be started and stopped by different processes, as with atrace
+ * --async_start and --async_stop, so requests aren't tied to their caller:
+ * IAtraceDevice::disableAllCategories() carries no session to count against, and disableAll()
+ * releases every event enabled so far at once. Events which were already enabled when first
+ * requested are left enabled: whoever turned them on owns them. The events we own are recorded in
+ * a state file, so that after a restart of the HAL those enabled by the previous instance are still
+ * recognised as ours and disabled. Files are only written when their state changes.
+ *
+ * Enabling is all or nothing: if a required event can't be enabled, the events enabled by that
+ * request are turned off again and the earlier requests are left as they were.
+ */
+class TracingCategoryManager {
+  public:
+    // The config has one statement per line, blank lines and lines starting with # are ignored:
+    //   category <name> <description...>
+    //   event <category> <path> [required]
+    // Categories must be declared before their events.
+    static std::optional<TracingCategoryMap> parseConfig(const std::string& config,
+                                                         std::string* error);
+    static std::optional<TracingCategoryMap> loadConfig(const std::string& path);
+    static TracingCategoryMap defaultCategories();
+
+    // eventRoot is the tracefs events directory, with a trailing slash. statePath is where the
+    // events we own are recorded, it should be on a tmpfs as tracefs doesn't outlive a reboot
+    // either. Ownership isn't recorded if it's empty.
+    TracingCategoryManager(std::string eventRoot, TracingCategoryMap categories,
+                           std::string statePath = "");
+
+    const TracingCategoryMap& categories() const { return categories_; }
+
+    // Enables the events of the given categories, in addition to those already enabled.
+    Status enable(const std::vector<std::string>& categories);
+    // Releases all the events enabled so far, whoever requested them.
+    Status disableAll();
+
+  private:
+    struct EventState {
+        bool required = false;
+        // Whether the event was enabled by us, and so should be disabled by us.
+        bool owned = false;
+    };
+
+    std::string enablePath(const std::string& event) const;
+    // Disables the event if it was enabled by us. Returns false if the event couldn't be
+    // disabled.
+    bool releaseLocked(const std::string& event, const EventState& state) REQUIRES(lock_);
+    // Records the events we own in the state file.
+    void saveLocked() REQUIRES(lock_);
+
+    const std::string event_root_;
+    const TracingCategoryMap categories_;
+    const std::string state_path_;
+
+    std::mutex lock_;
+    std::map<std::string, EventState> events_ GUARDED_BY(lock_);
+    // Events enabled by a previous instance, which are ours to disable if still enabled.
+    std::set<std::string> inherited_events_ GUARDED_BY(lock_);
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace atrace
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_ATRACE_V1_0_TRACINGCATEGORYMANAGER_H
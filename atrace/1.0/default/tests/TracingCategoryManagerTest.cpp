@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/stat.h>
+
+#include <memory>
+#include <string>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <gtest/gtest.h>
+
+#include "TracingCategoryManager.h"
+
+using ::android::hardware::atrace::V1_0::Status;
+using ::android::hardware::atrace::V1_0::implementation::TracingCategoryManager;
+using ::android::hardware::atrace::V1_0::implementation::TracingCategoryMap;
+
+namespace {
+
+constexpr char kConfig[] = R"(
+# A test config.
+category gfx Graphics
+event gfx mdss
+event gfx sde
+category ion ION allocation
+event ion kmem/ion_alloc_buffer_start required
+category sched Scheduling
+event sched sched/sched_switch required
+event sched sched/sched_wakeup required
+event sched kmem/ion_alloc_buffer_start
+)";
+
+// A fake tracefs events directory, with an enable file for each event of the config.
+class TracingCategoryManagerTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        root_ = std::string(dir_.path) + "/";
+        std::string error;
+        auto categories = TracingCategoryManager::parseConfig(kConfig, &error);
+        ASSERT_TRUE(categories) << error;
+        for (const auto& [name, category] : *categories) {
+            for (const auto& event : category.events) {
+                createEvent(event.path);
+            }
+        }
+        manager_ = std::make_unique<TracingCategoryManager>(root_, *categories);
+    }
+
+    void createEvent(const std::string& event) {
+        std::string path = root_;
+        for (const auto& c : event) {
+            if (c == '/') {
+                mkdir(path.c_str(), 0700);
+            }
+            path += c;
+        }
+        mkdir(path.c_str(), 0700);
+        setState(event, "0");
+    }
+
+    void setState(const std::string& event, const std::string& value) {
+        ASSERT_TRUE(android::base::WriteStringToFile(value + "\n", enablePath(event)));
+    }
+
+    std::string state(const std::string& event) {
+        std::string value;
+        EXPECT_TRUE(android::base::ReadFileToString(enablePath(event), &value));
+        return value;
+    }
+
+    bool enabled(const std::string& event) { return android::base::Trim(state(event)) == "1"; }
+
+    std::string enablePath(const std::string& event) { return root_ + event + "/enable"; }
+
+    // Makes writes to the event's enable file fail.
+    void breakEvent(const std::string& event) {
+        unlink(enablePath(event).c_str());
+        mkdir(enablePath(event).c_str(), 0700);
+    }
+
+    // A new instance of the HAL, which picks up where the previous one left off.
+    std::unique_ptr<TracingCategoryManager> restart() {
+        return std::make_unique<TracingCategoryManager>(root_, manager_->categories(),
+                                                        std::string(state_dir_.path) + "/state");
+    }
+
+    TemporaryDir dir_;
+    TemporaryDir state_dir_;
+    std::string root_;
+    std::unique_ptr<TracingCategoryManager> manager_;
+};
+
+TEST_F(TracingCategoryManagerTest, ParsesConfig) {
+    std::string error;
+    auto categories = TracingCategoryManager::parseConfig(kConfig, &error);
+    ASSERT_TRUE(categories) << error;
+    ASSERT_EQ(3u, categories->size());
+    const auto& ion = categories->at("ion");
+    EXPECT_EQ("ION allocation", ion.description);
+    ASSERT_EQ(1u, ion.events.size());
+    EXPECT_EQ("kmem/ion_alloc_buffer_start", ion.events[0].path);
+    EXPECT_TRUE(ion.events[0].required);
+    EXPECT_FALSE(categories->at("gfx").events[0].required);
+}
+
+TEST_F(TracingCategoryManagerTest, RejectsInvalidConfig) {
+    for (const char* config : {
+                 "event gfx mdss\n",
+                 "category gfx\n",
+                 "category gfx Graphics\ncategory gfx Graphics\nevent gfx mdss\n",
+                 "category gfx Graphics\n",
+                 "category gfx Graphics\nevent gfx ../mdss\n",
+                 "category gfx Graphics\nevent gfx /mdss\n",
+                 "category gfx Graphics\nevent gfx mdss optional\n",
+                 "group gfx Graphics\n",
+         }) {
+        std::string error;
+        EXPECT_FALSE(TracingCategoryManager::parseConfig(config, &error)) << config;
+        EXPECT_FALSE(error.empty()) << config;
+    }
+}
+
+TEST_F(TracingCategoryManagerTest, RejectsUnknownCategories) {
+    EXPECT_EQ(Status::ERROR_INVALID_ARGUMENT, manager_->enable({}));
+    EXPECT_EQ(Status::ERROR_INVALID_ARGUMENT, manager_->enable({"gfx", "unknown"}));
+    EXPECT_EQ("0\n", state("mdss"));
+}
+
+TEST_F(TracingCategoryManagerTest, EnablesAndDisables) {
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"gfx"}));
+    EXPECT_TRUE(enabled("mdss"));
+    EXPECT_TRUE(enabled("sde"));
+    EXPECT_EQ("0\n", state("kmem/ion_alloc_buffer_start"));
+
+    ASSERT_EQ(Status::SUCCESS, manager_->disableAll());
+    EXPECT_FALSE(enabled("mdss"));
+    EXPECT_FALSE(enabled("sde"));
+}
+
+TEST_F(TracingCategoryManagerTest, DisablesWhatOtherClientsEnabled) {
+    // atrace --async_start and --async_stop are different processes, and the requests of a
+    // session may come from several of them.
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"ion"}));
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"gfx", "sched"}));
+
+    ASSERT_EQ(Status::SUCCESS, manager_->disableAll());
+    EXPECT_FALSE(enabled("kmem/ion_alloc_buffer_start"));
+    EXPECT_FALSE(enabled("sched/sched_switch"));
+    EXPECT_FALSE(enabled("mdss"));
+}
+
+TEST_F(TracingCategoryManagerTest, DisablesRepeatedRequestsAtOnce) {
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"ion"}));
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"ion", "sched"}));
+
+    ASSERT_EQ(Status::SUCCESS, manager_->disableAll());
+    EXPECT_FALSE(enabled("kmem/ion_alloc_buffer_start"));
+    EXPECT_FALSE(enabled("sched/sched_switch"));
+}
+
+TEST_F(TracingCategoryManagerTest, KeepsEventsEnabledUntilDisabled) {
+    // Nothing is released behind the back of a session whose requests came from processes which
+    // have since exited.
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"sched"}));
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"gfx"}));
+    EXPECT_TRUE(enabled("sched/sched_switch"));
+    EXPECT_TRUE(enabled("mdss"));
+
+    // Nor is anything left behind once disabled, and the next session starts afresh.
+    ASSERT_EQ(Status::SUCCESS, manager_->disableAll());
+    ASSERT_EQ(Status::SUCCESS, manager_->disableAll());
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"gfx"}));
+    EXPECT_TRUE(enabled("mdss"));
+    EXPECT_FALSE(enabled("sched/sched_switch"));
+}
+
+TEST_F(TracingCategoryManagerTest, LeavesEventsEnabledByOthers) {
+    setState("mdss", "1");
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"gfx"}));
+    // Not rewritten.
+    EXPECT_EQ("1\n", state("mdss"));
+    ASSERT_EQ(Status::SUCCESS, manager_->disableAll());
+    EXPECT_EQ("1\n", state("mdss"));
+    EXPECT_FALSE(enabled("sde"));
+}
+
+TEST_F(TracingCategoryManagerTest, SkipsWritesOfEventsAlreadyDisabled) {
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"gfx"}));
+    setState("sde", "0");
+    ASSERT_EQ(Status::SUCCESS, manager_->disableAll());
+    EXPECT_EQ("0\n", state("sde"));
+}
+
+TEST_F(TracingCategoryManagerTest, IgnoresFailuresOfOptionalEvents) {
+    breakEvent("sde");
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"gfx"}));
+    EXPECT_TRUE(enabled("mdss"));
+    ASSERT_EQ(Status::SUCCESS, manager_->disableAll());
+    EXPECT_FALSE(enabled("mdss"));
+}
+
+TEST_F(TracingCategoryManagerTest, RollsBackOnlyItsOwnChanges) {
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"ion"}));
+    breakEvent("sched/sched_wakeup");
+
+    EXPECT_EQ(Status::ERROR_TRACING_POINT, manager_->enable({"gfx", "sched"}));
+    // The events enabled by the failed request are disabled again...
+    EXPECT_FALSE(enabled("mdss"));
+    EXPECT_FALSE(enabled("sde"));
+    EXPECT_FALSE(enabled("sched/sched_switch"));
+    // ...but not those of earlier requests.
+    EXPECT_TRUE(enabled("kmem/ion_alloc_buffer_start"));
+
+    ASSERT_EQ(Status::SUCCESS, manager_->disableAll());
+    EXPECT_FALSE(enabled("kmem/ion_alloc_buffer_start"));
+}
+
+TEST_F(TracingCategoryManagerTest, ReportsFailuresToDisableRequiredEvents) {
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"sched"}));
+    breakEvent("sched/sched_switch");
+    EXPECT_EQ(Status::ERROR_TRACING_POINT, manager_->disableAll());
+    EXPECT_FALSE(enabled("sched/sched_wakeup"));
+}
+
+TEST_F(TracingCategoryManagerTest, DisablesEventsEnabledBeforeARestart) {
+    manager_ = restart();
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"gfx", "ion"}));
+    manager_ = restart();
+    setState("sched/sched_switch", "1");
+
+    // Requested again by the new instance, which finds them already enabled...
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"gfx"}));
+    ASSERT_EQ(Status::SUCCESS, manager_->disableAll());
+    EXPECT_FALSE(enabled("mdss"));
+    EXPECT_FALSE(enabled("sde"));
+    // ...or not requested at all.
+    EXPECT_FALSE(enabled("kmem/ion_alloc_buffer_start"));
+    // Those enabled by others are still left alone.
+    EXPECT_TRUE(enabled("sched/sched_switch"));
+
+    // And once disabled, they're no longer ours.
+    manager_ = restart();
+    setState("mdss", "1");
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"gfx"}));
+    ASSERT_EQ(Status::SUCCESS, manager_->disableAll());
+    EXPECT_TRUE(enabled("mdss"));
+}
+
+TEST_F(TracingCategoryManagerTest, LeavesEventsEnabledByOthersAcrossRestarts) {
+    manager_ = restart();
+    setState("mdss", "1");
+    ASSERT_EQ(Status::SUCCESS, manager_->enable({"gfx"}));
+    manager_ = restart();
+    ASSERT_EQ(Status::SUCCESS, manager_->disableAll());
+    EXPECT_TRUE(enabled("mdss"));
+    EXPECT_FALSE(enabled("sde"));
+}
+
+}  // namespace
@@ -24,6 +24,7 @@
 
 #define ATRACE_TAG ATRACE_TAG_AUDIO
 #include <HidlUtils.h>
+#include <android-base/scopeguard.h>
 #include <android/log.h>
 #include <cutils/properties.h>
 #include <media/EffectsFactoryApi.h>
@@ -343,14 +344,25 @@ size_t Effect::alignedSizeIn(size_t s) {
 
 // static
 template <typename T>
-std::unique_ptr<uint8_t[]> Effect::hidlVecToHal(const hidl_vec<T>& vec, uint32_t* halDataSize) {
+uint32_t Effect::hidlVecToHal(const hidl_vec<T>& vec, std::vector<uint8_t>* halData) {
     // Due to bugs in HAL, they may attempt to write into the provided
     // input buffer. The original binder buffer is r/o, thus it is needed
     // to create a r/w version.
-    *halDataSize = vec.size() * sizeof(T);
-    std::unique_ptr<uint8_t[]> halData(new uint8_t[*halDataSize]);
-    memcpy(&halData[0], &vec[0], *halDataSize);
-    return halData;
+    uint32_t halDataSize = vec.size() * sizeof(T);
+    halData->resize(halDataSize);
+    if (halDataSize > 0) {
+        memcpy(halData->data(), vec.data(), halDataSize);
+    }
+    return halDataSize;
+}
+
+void Effect::trimScratch() {
+    if (mCmdScratch.capacity() > kMaxRetainedScratchSize) {
+        std::vector<uint8_t>().swap(mCmdScratch);
+    }
+    if (mReplyScratch.capacity() > kMaxRetainedScratchSize) {
+        std::vector<uint8_t>().swap(mReplyScratch);
+    }
 }
 
 #if MAJOR_VERSION <= 6
@@ -414,7 +426,7 @@ bool Effect::parameterToHal(uint32_t paramSize, const void* paramData, uint32_t
         return false;
     }
     size_t halParamBufferSize = sizeof(effect_param_t) + valueOffsetFromData + valueSize;
-    halParamBuffer->resize(halParamBufferSize, 0);
+    halParamBuffer->assign(halParamBufferSize, 0);
     effect_param_t* halParam = reinterpret_cast<effect_param_t*>(halParamBuffer->data());
     halParam->psize = paramSize;
     halParam->vsize = valueSize;
@@ -479,33 +491,37 @@ Result Effect::getCurrentConfigImpl(uint32_t featureId, uint32_t configSize,
         return Result::INVALID_ARGUMENTS;
     }
     uint32_t halCmd = featureId;
-    std::vector<uint32_t> halResult(alignedSizeIn<uint32_t>(sizeof(uint32_t) + configSize), 0);
+    std::lock_guard<std::mutex> lock(mScratchLock);
+    auto trimOnExit = ::android::base::make_scope_guard([this] { trimScratch(); });
+    mReplyScratch.assign(
+            alignedSizeIn<uint32_t>(sizeof(uint32_t) + configSize) * sizeof(uint32_t), 0);
     uint32_t halResultSize = 0;
     return sendCommandReturningStatusAndData(
             EFFECT_CMD_GET_FEATURE_CONFIG, "GET_FEATURE_CONFIG", sizeof(uint32_t), &halCmd,
-            &halResultSize, &halResult[0], sizeof(uint32_t), [&] { onSuccess(&halResult[1]); });
+            &halResultSize, mReplyScratch.data(), sizeof(uint32_t),
+            [&] { onSuccess(mReplyScratch.data() + sizeof(uint32_t)); });
 }
 
 Result Effect::getParameterImpl(uint32_t paramSize, const void* paramData,
                                 uint32_t requestValueSize, uint32_t replyValueSize,
                                 GetParameterSuccessCallback onSuccess) {
+    std::lock_guard<std::mutex> lock(mScratchLock);
+    auto trimOnExit = ::android::base::make_scope_guard([this] { trimScratch(); });
     // As it is unknown what method HAL uses for copying the provided parameter data,
     // it is safer to make sure that input and output buffers do not overlap.
-    std::vector<uint8_t> halCmdBuffer;
-    if (!parameterToHal(paramSize, paramData, requestValueSize, nullptr, &halCmdBuffer)) {
+    if (!parameterToHal(paramSize, paramData, requestValueSize, nullptr, &mCmdScratch)) {
         return Result::INVALID_ARGUMENTS;
     }
     const void* valueData = nullptr;
-    std::vector<uint8_t> halParamBuffer;
-    if (!parameterToHal(paramSize, paramData, replyValueSize, &valueData, &halParamBuffer)) {
+    if (!parameterToHal(paramSize, paramData, replyValueSize, &valueData, &mReplyScratch)) {
         return Result::INVALID_ARGUMENTS;
     }
-    uint32_t halParamBufferSize = halParamBuffer.size();
+    uint32_t halParamBufferSize = mReplyScratch.size();
 
     return sendCommandReturningStatusAndData(
-        EFFECT_CMD_GET_PARAM, "GET_PARAM", halCmdBuffer.size(), &halCmdBuffer[0],
-        &halParamBufferSize, &halParamBuffer[0], sizeof(effect_param_t), [&] {
-            effect_param_t* halParam = reinterpret_cast<effect_param_t*>(&halParamBuffer[0]);
+        EFFECT_CMD_GET_PARAM, "GET_PARAM", mCmdScratch.size(), mCmdScratch.data(),
+        &halParamBufferSize, mReplyScratch.data(), sizeof(effect_param_t), [&] {
+            effect_param_t* halParam = reinterpret_cast<effect_param_t*>(mReplyScratch.data());
             onSuccess(halParam->vsize, valueData);
         });
 }
@@ -518,11 +534,13 @@ Result Effect::getSupportedConfigsImpl(uint32_t featureId, uint32_t maxConfigs,
     }
     uint32_t halCmd[2] = {featureId, maxConfigs};
     uint32_t halResultSize = 2 * sizeof(uint32_t) + maxConfigs * configSize;
-    std::vector<uint8_t> halResult(static_cast<size_t>(halResultSize), 0);
+    std::lock_guard<std::mutex> lock(mScratchLock);
+    auto trimOnExit = ::android::base::make_scope_guard([this] { trimScratch(); });
+    mReplyScratch.assign(static_cast<size_t>(halResultSize), 0);
     return sendCommandReturningStatusAndData(
         EFFECT_CMD_GET_FEATURE_SUPPORTED_CONFIGS, "GET_FEATURE_SUPPORTED_CONFIGS", sizeof(halCmd),
-        halCmd, &halResultSize, &halResult[0], 2 * sizeof(uint32_t), [&] {
-            uint32_t* halResult32 = reinterpret_cast<uint32_t*>(&halResult[0]);
+        halCmd, &halResultSize, mReplyScratch.data(), 2 * sizeof(uint32_t), [&] {
+            uint32_t* halResult32 = reinterpret_cast<uint32_t*>(mReplyScratch.data());
             uint32_t supportedConfigs = *(++halResult32);  // skip status field
             if (supportedConfigs > maxConfigs) supportedConfigs = maxConfigs;
             onSuccess(supportedConfigs, ++halResult32);
@@ -666,12 +684,35 @@ Result Effect::setConfigImpl(int commandCode, const char* commandName, const Eff
 
 Result Effect::setParameterImpl(uint32_t paramSize, const void* paramData, uint32_t valueSize,
                                 const void* valueData) {
-    std::vector<uint8_t> halParamBuffer;
-    if (!parameterToHal(paramSize, paramData, valueSize, &valueData, &halParamBuffer)) {
+    std::lock_guard<std::mutex> lock(mScratchLock);
+    auto trimOnExit = ::android::base::make_scope_guard([this] { trimScratch(); });
+    return setParameterLocked(paramSize, paramData, valueSize, valueData);
+}
+
+Result Effect::setParametersImpl(const std::vector<ParameterUpdate>& updates,
+                                 std::vector<Result>* results) {
+    std::lock_guard<std::mutex> lock(mScratchLock);
+    auto trimOnExit = ::android::base::make_scope_guard([this] { trimScratch(); });
+    results->resize(updates.size());
+    Result retval = Result::OK;
+    for (size_t i = 0; i < updates.size(); ++i) {
+        const ParameterUpdate& update = updates[i];
+        (*results)[i] = setParameterLocked(update.paramSize, update.paramData, update.valueSize,
+                                           update.valueData);
+        if (retval == Result::OK) {
+            retval = (*results)[i];
+        }
+    }
+    return retval;
+}
+
+Result Effect::setParameterLocked(uint32_t paramSize, const void* paramData, uint32_t valueSize,
+                                  const void* valueData) {
+    if (!parameterToHal(paramSize, paramData, valueSize, &valueData, &mCmdScratch)) {
         return Result::INVALID_ARGUMENTS;
     }
-    return sendCommandReturningStatus(EFFECT_CMD_SET_PARAM, "SET_PARAM", halParamBuffer.size(),
-                                      &halParamBuffer[0]);
+    return sendCommandReturningStatus(EFFECT_CMD_SET_PARAM, "SET_PARAM", mCmdScratch.size(),
+                                      mCmdScratch.data());
 }
 
 // Methods from ::android::hardware::audio::effect::CPP_VERSION::IEffect follow.
@@ -759,24 +800,28 @@ Return<Result> Effect::setInputDevice(const DeviceAddress& device) {
 
 Return<void> Effect::setAndGetVolume(const hidl_vec<uint32_t>& volumes,
                                      setAndGetVolume_cb _hidl_cb) {
-    uint32_t halDataSize;
-    std::unique_ptr<uint8_t[]> halData = hidlVecToHal(volumes, &halDataSize);
+    std::lock_guard<std::mutex> lock(mScratchLock);
+    auto trimOnExit = ::android::base::make_scope_guard([this] { trimScratch(); });
+    uint32_t halDataSize = hidlVecToHal(volumes, &mCmdScratch);
     uint32_t halResultSize = halDataSize;
-    std::vector<uint32_t> halResult(volumes.size(), 0);
+    mReplyScratch.assign(halResultSize, 0);
     Result retval = sendCommandReturningData(EFFECT_CMD_SET_VOLUME, "SET_VOLUME", halDataSize,
-                                             &halData[0], &halResultSize, &halResult[0]);
+                                             mCmdScratch.data(), &halResultSize,
+                                             mReplyScratch.data());
     hidl_vec<uint32_t> result;
     if (retval == Result::OK) {
-        result.setToExternal(&halResult[0], halResultSize);
+        result.setToExternal(reinterpret_cast<uint32_t*>(mReplyScratch.data()),
+                             halResultSize / sizeof(uint32_t));
     }
     _hidl_cb(retval, result);
     return Void();
 }
 
 Return<Result> Effect::volumeChangeNotification(const hidl_vec<uint32_t>& volumes) {
-    uint32_t halDataSize;
-    std::unique_ptr<uint8_t[]> halData = hidlVecToHal(volumes, &halDataSize);
-    return sendCommand(EFFECT_CMD_SET_VOLUME, "SET_VOLUME", halDataSize, &halData[0]);
+    std::lock_guard<std::mutex> lock(mScratchLock);
+    auto trimOnExit = ::android::base::make_scope_guard([this] { trimScratch(); });
+    uint32_t halDataSize = hidlVecToHal(volumes, &mCmdScratch);
+    return sendCommand(EFFECT_CMD_SET_VOLUME, "SET_VOLUME", halDataSize, mCmdScratch.data());
 }
 
 Return<Result> Effect::setAudioMode(AudioMode mode) {
@@ -829,12 +874,17 @@ Return<void> Effect::getAuxChannelsConfig(getAuxChannelsConfig_cb _hidl_cb) {
 }
 
 Return<Result> Effect::setAuxChannelsConfig(const EffectAuxChannelsConfig& config) {
-    std::vector<uint32_t> halCmd(
-            alignedSizeIn<uint32_t>(sizeof(uint32_t) + sizeof(channel_config_t)), 0);
+    std::lock_guard<std::mutex> lock(mScratchLock);
+    auto trimOnExit = ::android::base::make_scope_guard([this] { trimScratch(); });
+    mCmdScratch.assign(
+            alignedSizeIn<uint32_t>(sizeof(uint32_t) + sizeof(channel_config_t)) * sizeof(uint32_t),
+            0);
+    uint32_t* halCmd = reinterpret_cast<uint32_t*>(mCmdScratch.data());
     halCmd[0] = EFFECT_FEATURE_AUX_CHANNELS;
     effectAuxChannelsConfigToHal(config, reinterpret_cast<channel_config_t*>(&halCmd[1]));
     return sendCommandReturningStatus(EFFECT_CMD_SET_FEATURE_CONFIG,
-                                      "SET_FEATURE_CONFIG AUX_CHANNELS", halCmd.size(), &halCmd[0]);
+                                      "SET_FEATURE_CONFIG AUX_CHANNELS", mCmdScratch.size(),
+                                      mCmdScratch.data());
 }
 
 Return<Result> Effect::offload(const EffectOffloadParameter& param) {
@@ -858,14 +908,14 @@ Return<void> Effect::getDescriptor(getDescriptor_cb _hidl_cb) {
 
 Return<void> Effect::command(uint32_t commandId, const hidl_vec<uint8_t>& data,
                              uint32_t resultMaxSize, command_cb _hidl_cb) {
-    uint32_t halDataSize;
-    std::unique_ptr<uint8_t[]> halData = hidlVecToHal(data, &halDataSize);
+    std::lock_guard<std::mutex> lock(mScratchLock);
+    auto trimOnExit = ::android::base::make_scope_guard([this] { trimScratch(); });
+    uint32_t halDataSize = hidlVecToHal(data, &mCmdScratch);
     uint32_t halResultSize = resultMaxSize;
-    std::unique_ptr<uint8_t[]> halResult(new uint8_t[halResultSize]);
-    memset(&halResult[0], 0, halResultSize);
+    mReplyScratch.assign(halResultSize, 0);
 
-    void* dataPtr = halDataSize > 0 ? &halData[0] : NULL;
-    void* resultPtr = halResultSize > 0 ? &halResult[0] : NULL;
+    void* dataPtr = halDataSize > 0 ? mCmdScratch.data() : NULL;
+    void* resultPtr = halResultSize > 0 ? mReplyScratch.data() : NULL;
     status_t status = BAD_VALUE;
     switch (commandId) {
         case 'gtid':  // retrieve the tid, used for spatializer priority boost
@@ -883,7 +933,7 @@ Return<void> Effect::command(uint32_t commandId, const hidl_vec<uint8_t>& data,
     }
     hidl_vec<uint8_t> result;
     if (status == OK && resultPtr != NULL) {
-        result.setToExternal(&halResult[0], halResultSize);
+        result.setToExternal(mReplyScratch.data(), halResultSize);
     }
     _hidl_cb(status, result);
     return Void();
@@ -896,14 +946,21 @@ Return<Result> Effect::setParameter(const hidl_vec<uint8_t>& parameter,
 
 Return<void> Effect::getParameter(const hidl_vec<uint8_t>& parameter, uint32_t valueMaxSize,
                                   getParameter_cb _hidl_cb) {
-    hidl_vec<uint8_t> value;
+    // The value is only valid while the scratch buffers are locked, thus the reply
+    // must be sent from the success callback.
+    bool replied = false;
     Result retval = getParameterImpl(
         parameter.size(), &parameter[0], valueMaxSize,
         [&](uint32_t valueSize, const void* valueData) {
+            hidl_vec<uint8_t> value;
             value.setToExternal(reinterpret_cast<uint8_t*>(const_cast<void*>(valueData)),
                                 valueSize);
+            _hidl_cb(Result::OK, value);
+            replied = true;
         });
-    _hidl_cb(retval, value);
+    if (!replied) {
+        _hidl_cb(retval, hidl_vec<uint8_t>());
+    }
     return Void();
 }
 
@@ -935,11 +992,15 @@ Return<void> Effect::getCurrentConfigForFeature(uint32_t featureId, uint32_t con
 
 Return<Result> Effect::setCurrentConfigForFeature(uint32_t featureId,
                                                   const hidl_vec<uint8_t>& configData) {
-    std::vector<uint32_t> halCmd(alignedSizeIn<uint32_t>(sizeof(uint32_t) + configData.size()), 0);
+    std::lock_guard<std::mutex> lock(mScratchLock);
+    auto trimOnExit = ::android::base::make_scope_guard([this] { trimScratch(); });
+    mCmdScratch.assign(
+            alignedSizeIn<uint32_t>(sizeof(uint32_t) + configData.size()) * sizeof(uint32_t), 0);
+    uint32_t* halCmd = reinterpret_cast<uint32_t*>(mCmdScratch.data());
     halCmd[0] = featureId;
     memcpy(&halCmd[1], &configData[0], configData.size());
     return sendCommandReturningStatus(EFFECT_CMD_SET_FEATURE_CONFIG, "SET_FEATURE_CONFIG",
-                                      halCmd.size(), &halCmd[0]);
+                                      mCmdScratch.size(), mCmdScratch.data());
 }
 
 Return<Result> Effect::close() {
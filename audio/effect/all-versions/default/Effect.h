@@ -23,6 +23,7 @@
 
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include <fmq/EventFlag.h>
@@ -170,6 +171,18 @@ struct Effect : public IEffect {
     Result setParameterImpl(uint32_t paramSize, const void* paramData, uint32_t valueSize,
                             const void* valueData);
 
+    struct ParameterUpdate {
+        uint32_t paramSize;
+        const void* paramData;
+        uint32_t valueSize;
+        const void* valueData;
+    };
+    // Sets the parameters in order, as a sequence of SET_PARAM commands that isn't interleaved
+    // with other parameter calls. The result of each parameter is stored in 'results', a failed
+    // parameter doesn't prevent the following ones from being set. Returns the first failure.
+    Result setParametersImpl(const std::vector<ParameterUpdate>& updates,
+                             std::vector<Result>* results);
+
     // process execution statistics
     const std::shared_ptr<mediautils::MethodStatistics<std::string>> mStatistics =
             std::make_shared<mediautils::MethodStatistics<std::string>>();
@@ -186,6 +199,8 @@ struct Effect : public IEffect {
 
     // Sets the limit on the maximum size of vendor-provided data structures.
     static constexpr size_t kMaxDataSize = 1 << 20;
+    // Scratch buffers grown past this size by a large request are released after it.
+    static constexpr size_t kMaxRetainedScratchSize = 4096;
 
     static const char* sContextResultOfCommand;
     static const char* sContextCallToCommand;
@@ -201,13 +216,20 @@ struct Effect : public IEffect {
     EventFlag* mEfGroup;
     std::atomic<bool> mStopProcessThread;
     sp<Thread> mProcessThread;
+    // Marshalling buffers for commands and their replies, reused across calls so that
+    // parameter, feature config and volume calls don't allocate. The lock is held until
+    // the reply has been consumed, success callbacks must not call back into the effect.
+    std::mutex mScratchLock;
+    std::vector<uint8_t> mCmdScratch;
+    std::vector<uint8_t> mReplyScratch;
 
     virtual ~Effect();
 
     template <typename T>
     static size_t alignedSizeIn(size_t s);
     template <typename T>
-    std::unique_ptr<uint8_t[]> hidlVecToHal(const hidl_vec<T>& vec, uint32_t* halDataSize);
+    static uint32_t hidlVecToHal(const hidl_vec<T>& vec, std::vector<uint8_t>* halData);
+    void trimScratch();
     void effectAuxChannelsConfigFromHal(const channel_config_t& halConfig,
                                         EffectAuxChannelsConfig* config);
     static void effectAuxChannelsConfigToHal(const EffectAuxChannelsConfig& config,
@@ -239,6 +261,8 @@ struct Effect : public IEffect {
     Result setConfigImpl(int commandCode, const char* commandName, const EffectConfig& config,
                          const sp<IEffectBufferProviderCallback>& inputBufferProvider,
                          const sp<IEffectBufferProviderCallback>& outputBufferProvider);
+    Result setParameterLocked(uint32_t paramSize, const void* paramData, uint32_t valueSize,
+                              const void* valueData);
 };
 
 }  // namespace implementation
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "EffectFactoryHAL"
+#include "EffectCatalog.h"
+
+#include <android/log.h>
+#include <media/EffectsFactoryApi.h>
+#include <util/EffectUtils.h>
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace effect {
+namespace CPP_VERSION {
+namespace implementation {
+
+const EffectDescriptor* EffectCatalog::Snapshot::find(const effect_uuid_t& uuid) const {
+    auto it = indexByUuid.find(uuid);
+    return it != indexByUuid.end() ? &descriptors[it->second] : nullptr;
+}
+
+Result EffectCatalog::get(std::shared_ptr<const Snapshot>* snapshot) {
+    uint32_t numEffects = 0;
+    status_t status = EffectQueryNumberEffects(&numEffects);
+    if (status != OK) {
+        ALOGE("Error querying number of effects: %s", strerror(-status));
+        return Result::NOT_INITIALIZED;
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mSnapshot == nullptr || mSnapshot->numEffects != numEffects) {
+        std::shared_ptr<const Snapshot> rebuilt;
+        Result retval = build(&rebuilt);
+        if (retval != Result::OK) {
+            return retval;
+        }
+        mSnapshot = std::move(rebuilt);
+    }
+    *snapshot = mSnapshot;
+    return Result::OK;
+}
+
+void EffectCatalog::invalidate() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mSnapshot.reset();
+}
+
+// static
+Result EffectCatalog::build(std::shared_ptr<const Snapshot>* snapshot) {
+    auto result = std::make_shared<Snapshot>();
+    bool restart;
+    do {
+        restart = false;
+        result->numEffects = 0;
+        status_t status = EffectQueryNumberEffects(&result->numEffects);
+        if (status != OK) {
+            ALOGE("Error querying number of effects: %s", strerror(-status));
+            return Result::NOT_INITIALIZED;
+        }
+        result->descriptors.resize(result->numEffects);
+        result->indexByUuid.clear();
+        result->indexByUuid.reserve(result->numEffects);
+        for (uint32_t i = 0; i < result->numEffects; ++i) {
+            effect_descriptor_t halDescriptor;
+            status = EffectQueryEffect(i, &halDescriptor);
+            if (status == OK) {
+                EffectUtils::effectDescriptorFromHal(halDescriptor, &result->descriptors[i]);
+                result->indexByUuid.emplace(halDescriptor.uuid, i);
+                continue;
+            }
+            ALOGE("Error querying effect at position %d / %d: %s", i, result->numEffects,
+                  strerror(-status));
+            if (status == -ENOSYS) {
+                // Effect list has changed.
+                restart = true;
+            } else if (status == -ENOENT) {
+                // No more effects available.
+                result->descriptors.resize(i);
+            } else {
+                return Result::NOT_INITIALIZED;
+            }
+            break;
+        }
+    } while (restart);
+    *snapshot = std::move(result);
+    return Result::OK;
+}
+
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace effect
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_AUDIO_EFFECT_EFFECTCATALOG_H
+#define ANDROID_HARDWARE_AUDIO_EFFECT_EFFECTCATALOG_H
+
+#include <memory>
+#include <mutex>
+
+#include PATH(android/hardware/audio/effect/FILE_VERSION/types.h)
+
+#include <hardware/audio_effect.h>
+#include <hidl/HidlSupport.h>
+
+#include "EffectUuidMap.h"
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace effect {
+namespace CPP_VERSION {
+namespace implementation {
+
+using ::android::hardware::hidl_vec;
+using namespace ::android::hardware::audio::effect::CPP_VERSION;
+
+// Descriptors of all the effects provided by the effect libraries, converted to HIDL once.
+//
+// Enumerating the effects and converting their descriptors isn't free, and audio policy asks for
+// them again on every routing change. The catalog is kept until the number of effects reported
+// by the effects factory changes, which is the only sign of a change in the set of effect
+// libraries that it exposes.
+class EffectCatalog {
+  public:
+    // Immutable once built, so it can be shared with any number of readers.
+    struct Snapshot {
+        uint32_t numEffects = 0;  // As reported by EffectQueryNumberEffects.
+        hidl_vec<EffectDescriptor> descriptors;
+        EffectUuidMap<size_t> indexByUuid;
+
+        // Returns nullptr if there's no effect with that implementation UUID.
+        const EffectDescriptor* find(const effect_uuid_t& uuid) const;
+    };
+
+    // Returns the current catalog, after rebuilding it if the set of effects changed.
+    Result get(std::shared_ptr<const Snapshot>* snapshot);
+
+    // Makes the next get() rebuild the catalog.
+    void invalidate();
+
+  private:
+    static Result build(std::shared_ptr<const Snapshot>* snapshot);
+
+    std::mutex mLock;
+    std::shared_ptr<const Snapshot> mSnapshot;
+};
+
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace effect
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_AUDIO_EFFECT_EFFECTCATALOG_H
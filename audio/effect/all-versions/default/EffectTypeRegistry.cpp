@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "EffectFactoryHAL"
+#include "EffectTypeRegistry.h"
+#include "AcousticEchoCancelerEffect.h"
+#include "AutomaticGainControlEffect.h"
+#include "BassBoostEffect.h"
+#include "DownmixEffect.h"
+#include "EnvironmentalReverbEffect.h"
+#include "EqualizerEffect.h"
+#include "LoudnessEnhancerEffect.h"
+#include "NoiseSuppressionEffect.h"
+#include "PresetReverbEffect.h"
+#include "VirtualizerEffect.h"
+#include "VisualizerEffect.h"
+
+#include <system/audio_effects/effect_aec.h>
+#include <system/audio_effects/effect_agc.h>
+#include <system/audio_effects/effect_bassboost.h>
+#include <system/audio_effects/effect_downmix.h>
+#include <system/audio_effects/effect_environmentalreverb.h>
+#include <system/audio_effects/effect_equalizer.h>
+#include <system/audio_effects/effect_loudnessenhancer.h>
+#include <system/audio_effects/effect_ns.h>
+#include <system/audio_effects/effect_presetreverb.h>
+#include <system/audio_effects/effect_virtualizer.h>
+#include <system/audio_effects/effect_visualizer.h>
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace effect {
+namespace CPP_VERSION {
+namespace implementation {
+
+template <typename T>
+static sp<IEffect> createWrapper(effect_handle_t handle) {
+    return new T(handle);
+}
+
+// static
+EffectTypeRegistry& EffectTypeRegistry::getInstance() {
+    static EffectTypeRegistry instance;
+    return instance;
+}
+
+EffectTypeRegistry::EffectTypeRegistry() {
+    add(*FX_IID_AEC, createWrapper<AcousticEchoCancelerEffect>);
+    add(*FX_IID_AGC, createWrapper<AutomaticGainControlEffect>);
+    add(*SL_IID_BASSBOOST, createWrapper<BassBoostEffect>);
+    add(*EFFECT_UIID_DOWNMIX, createWrapper<DownmixEffect>);
+    add(*SL_IID_ENVIRONMENTALREVERB, createWrapper<EnvironmentalReverbEffect>);
+    add(*SL_IID_EQUALIZER, createWrapper<EqualizerEffect>);
+    add(*FX_IID_LOUDNESS_ENHANCER, createWrapper<LoudnessEnhancerEffect>);
+    add(*FX_IID_NS, createWrapper<NoiseSuppressionEffect>);
+    add(*SL_IID_PRESETREVERB, createWrapper<PresetReverbEffect>);
+    add(*SL_IID_VIRTUALIZER, createWrapper<VirtualizerEffect>);
+    add(*SL_IID_VISUALIZATION, createWrapper<VisualizerEffect>);
+}
+
+void EffectTypeRegistry::add(const effect_uuid_t& type, Creator creator) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mCreators[type] = std::move(creator);
+}
+
+sp<IEffect> EffectTypeRegistry::create(const effect_uuid_t& type, effect_handle_t handle) const {
+    Creator creator;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        auto it = mCreators.find(type);
+        if (it == mCreators.end()) {
+            return nullptr;
+        }
+        creator = it->second;
+    }
+    return creator(handle);
+}
+
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace effect
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
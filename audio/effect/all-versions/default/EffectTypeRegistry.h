@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_AUDIO_EFFECT_EFFECTTYPEREGISTRY_H
+#define ANDROID_HARDWARE_AUDIO_EFFECT_EFFECTTYPEREGISTRY_H
+
+#include <functional>
+#include <mutex>
+
+#include PATH(android/hardware/audio/effect/FILE_VERSION/IEffect.h)
+
+#include <hardware/audio_effect.h>
+
+#include "EffectUuidMap.h"
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace effect {
+namespace CPP_VERSION {
+namespace implementation {
+
+using ::android::sp;
+using namespace ::android::hardware::audio::effect::CPP_VERSION;
+
+// Maps effect type UUIDs to the HIDL wrapper class to create for effects of that type, e.g.
+// SL_IID_EQUALIZER to EqualizerEffect. Effects of types without a wrapper are exposed through
+// the generic Effect class.
+//
+// The wrappers of the standard effect types are registered up front. Vendors can register their
+// own typed wrappers, or replace the standard ones, before the factory creates any effect.
+class EffectTypeRegistry {
+  public:
+    using Creator = std::function<sp<IEffect>(effect_handle_t handle)>;
+
+    static EffectTypeRegistry& getInstance();
+
+    // Registers the wrapper for the given effect type, replacing any previous one.
+    void add(const effect_uuid_t& type, Creator creator);
+
+    // Returns nullptr if there's no wrapper for the given effect type.
+    sp<IEffect> create(const effect_uuid_t& type, effect_handle_t handle) const;
+
+  private:
+    EffectTypeRegistry();
+
+    mutable std::mutex mLock;
+    EffectUuidMap<Creator> mCreators;
+};
+
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace effect
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_AUDIO_EFFECT_EFFECTTYPEREGISTRY_H
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_AUDIO_EFFECT_EFFECTUUIDMAP_H
+#define ANDROID_HARDWARE_AUDIO_EFFECT_EFFECTUUIDMAP_H
+
+#include <string.h>
+
+#include <functional>
+#include <unordered_map>
+
+#include <hardware/audio_effect.h>
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace effect {
+namespace CPP_VERSION {
+namespace implementation {
+
+struct EffectUuidHash {
+    size_t operator()(const effect_uuid_t& uuid) const {
+        static_assert(sizeof(effect_uuid_t) == 2 * sizeof(uint64_t));
+        uint64_t words[2];
+        memcpy(words, &uuid, sizeof(words));
+        return std::hash<uint64_t>()(words[0] ^ (words[1] * 0x9e3779b97f4a7c15ULL));
+    }
+};
+
+struct EffectUuidEqual {
+    bool operator()(const effect_uuid_t& a, const effect_uuid_t& b) const {
+        return memcmp(&a, &b, sizeof(effect_uuid_t)) == 0;
+    }
+};
+
+// Hash map keyed by effect UUIDs, either implementation or type UUIDs.
+template <typename T>
+using EffectUuidMap = std::unordered_map<effect_uuid_t, T, EffectUuidHash, EffectUuidEqual>;
+
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace effect
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_AUDIO_EFFECT_EFFECTUUIDMAP_H
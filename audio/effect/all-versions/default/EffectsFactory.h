@@ -29,6 +29,9 @@
 #include <hidl/Status.h>
 
 #include <hidl/MQDescriptor.h>
+
+#include "EffectCatalog.h"
+
 namespace android {
 namespace hardware {
 namespace audio {
@@ -65,6 +68,8 @@ struct EffectsFactory : public IEffectsFactory {
                                                       effect_handle_t handle);
     Return<void> createEffectImpl(const Uuid& uuid, int32_t session, int32_t ioHandle,
                                   int32_t device, createEffect_cb _hidl_cb);
+
+    EffectCatalog mCatalog;
 };
 
 extern "C" IEffectsFactory* HIDL_FETCH_IEffectsFactory(const char* name);
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the marshalling overhead of Effect parameter calls. The effect
+// library is a stub that only acknowledges commands, so that what's measured
+// is the HAL wrapper rather than the effect itself.
+
+#include <benchmark/benchmark.h>
+#include <hardware/audio_effect.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "Effect.h"
+
+using ::android::sp;
+using ::android::hardware::audio::effect::CPP_VERSION::Result;
+using ::android::hardware::audio::effect::CPP_VERSION::implementation::Effect;
+
+namespace {
+
+struct StubEffect {
+    const effect_interface_s* itfe;
+    int32_t value;
+};
+
+int32_t stubProcess(effect_handle_t, audio_buffer_t*, audio_buffer_t*) {
+    return 0;
+}
+
+int32_t stubCommand(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize, void* pCmdData,
+                    uint32_t* replySize, void* pReplyData) {
+    StubEffect* effect = reinterpret_cast<StubEffect*>(self);
+    switch (cmdCode) {
+        case EFFECT_CMD_SET_PARAM: {
+            if (cmdSize < sizeof(effect_param_t) || replySize == nullptr ||
+                *replySize < sizeof(int32_t)) {
+                return -EINVAL;
+            }
+            const effect_param_t* param = static_cast<const effect_param_t*>(pCmdData);
+            const uint32_t valueOffset = (param->psize + 3) / 4 * 4;
+            memcpy(&effect->value, param->data + valueOffset,
+                   std::min<uint32_t>(param->vsize, sizeof(effect->value)));
+            *static_cast<int32_t*>(pReplyData) = 0;
+            return 0;
+        }
+        case EFFECT_CMD_GET_PARAM: {
+            if (cmdSize < sizeof(effect_param_t) || replySize == nullptr ||
+                *replySize < cmdSize) {
+                return -EINVAL;
+            }
+            effect_param_t* param = static_cast<effect_param_t*>(pReplyData);
+            memcpy(param, pCmdData, cmdSize);
+            const uint32_t valueOffset = (param->psize + 3) / 4 * 4;
+            param->status = 0;
+            param->vsize = std::min<uint32_t>(param->vsize, sizeof(effect->value));
+            memcpy(param->data + valueOffset, &effect->value, param->vsize);
+            *replySize = sizeof(effect_param_t) + valueOffset + param->vsize;
+            return 0;
+        }
+        default:
+            return -ENOSYS;
+    }
+}
+
+int32_t stubGetDescriptor(effect_handle_t, effect_descriptor_t*) {
+    return -ENOSYS;
+}
+
+const effect_interface_s kStubInterface = {stubProcess, stubCommand, stubGetDescriptor, nullptr};
+
+class StubEffectFixture : public benchmark::Fixture {
+  public:
+    void SetUp(const benchmark::State&) override {
+        mStub = {&kStubInterface, 0};
+        mEffect = new Effect(false /*isInput*/, reinterpret_cast<effect_handle_t>(&mStub));
+    }
+    void TearDown(const benchmark::State&) override { mEffect.clear(); }
+
+  protected:
+    StubEffect mStub;
+    sp<Effect> mEffect;
+};
+
+// The parameter path as it was before the scratch buffers: a fresh command buffer per call.
+Result setParamAllocating(effect_handle_t handle, uint32_t paramId, int32_t value) {
+    const size_t size = sizeof(effect_param_t) + sizeof(paramId) + sizeof(value);
+    std::vector<uint8_t> halParamBuffer(size, 0);
+    effect_param_t* halParam = reinterpret_cast<effect_param_t*>(halParamBuffer.data());
+    halParam->psize = sizeof(paramId);
+    halParam->vsize = sizeof(value);
+    memcpy(halParam->data, &paramId, sizeof(paramId));
+    memcpy(halParam->data + sizeof(paramId), &value, sizeof(value));
+    int32_t replyStatus;
+    uint32_t replySize = sizeof(replyStatus);
+    int32_t status = (*handle)->command(handle, EFFECT_CMD_SET_PARAM, halParamBuffer.size(),
+                                        halParamBuffer.data(), &replySize, &replyStatus);
+    return status == 0 && replyStatus == 0 ? Result::OK : Result::INVALID_ARGUMENTS;
+}
+
+BENCHMARK_DEFINE_F(StubEffectFixture, SetParam_Allocating)(benchmark::State& state) {
+    effect_handle_t handle = reinterpret_cast<effect_handle_t>(&mStub);
+    int32_t value = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(setParamAllocating(handle, 1, value++));
+    }
+}
+
+BENCHMARK_DEFINE_F(StubEffectFixture, SetParam)(benchmark::State& state) {
+    int32_t value = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mEffect->setParam(1, value++));
+    }
+}
+
+BENCHMARK_DEFINE_F(StubEffectFixture, GetParam)(benchmark::State& state) {
+    int32_t value = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mEffect->getParam(1, value));
+    }
+}
+
+// Sets state.range(0) parameters one call at a time, as the wrappers do.
+BENCHMARK_DEFINE_F(StubEffectFixture, SetParams_OneByOne)(benchmark::State& state) {
+    std::vector<int32_t> values(state.range(0), 1);
+    for (auto _ : state) {
+        for (uint32_t i = 0; i < values.size(); ++i) {
+            benchmark::DoNotOptimize(mEffect->setParam(i, values[i]));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+
+BENCHMARK_DEFINE_F(StubEffectFixture, SetParams_Batched)(benchmark::State& state) {
+    std::vector<uint32_t> ids(state.range(0));
+    std::vector<int32_t> values(state.range(0), 1);
+    std::vector<Effect::ParameterUpdate> updates(state.range(0));
+    for (uint32_t i = 0; i < updates.size(); ++i) {
+        ids[i] = i;
+        updates[i] = {sizeof(uint32_t), &ids[i], sizeof(int32_t), &values[i]};
+    }
+    std::vector<Result> results;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mEffect->setParametersImpl(updates, &results));
+    }
+    state.SetItemsProcessed(state.iterations() * updates.size());
+}
+
+BENCHMARK_REGISTER_F(StubEffectFixture, SetParam_Allocating);
+BENCHMARK_REGISTER_F(StubEffectFixture, SetParam);
+BENCHMARK_REGISTER_F(StubEffectFixture, GetParam);
+// A single band, and all the bands and properties of a typical equalizer.
+BENCHMARK_REGISTER_F(StubEffectFixture, SetParams_OneByOne)->Arg(1)->Arg(16);
+BENCHMARK_REGISTER_F(StubEffectFixture, SetParams_Batched)->Arg(1)->Arg(16);
+
+}  // namespace
+
+BENCHMARK_MAIN();
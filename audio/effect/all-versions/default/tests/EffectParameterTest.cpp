@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <hardware/audio_effect.h>
+
+#include <cstring>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "Effect.h"
+
+using ::android::sp;
+using ::android::hardware::audio::effect::CPP_VERSION::Result;
+using ::android::hardware::audio::effect::CPP_VERSION::implementation::Effect;
+
+namespace {
+
+constexpr uint32_t kRejectedParam = 2;
+
+// An effect library which records the parameters it's given, and rejects kRejectedParam.
+struct RecordingEffect {
+    const effect_interface_s* itfe;
+    std::vector<std::pair<uint32_t, int32_t>> params;
+};
+
+int32_t recordingProcess(effect_handle_t, audio_buffer_t*, audio_buffer_t*) {
+    return 0;
+}
+
+int32_t recordingCommand(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize, void* pCmdData,
+                         uint32_t* replySize, void* pReplyData) {
+    RecordingEffect* effect = reinterpret_cast<RecordingEffect*>(self);
+    if (cmdCode != EFFECT_CMD_SET_PARAM || cmdSize < sizeof(effect_param_t) + 2 * sizeof(int32_t) ||
+        replySize == nullptr || *replySize < sizeof(int32_t)) {
+        return -EINVAL;
+    }
+    const effect_param_t* param = static_cast<const effect_param_t*>(pCmdData);
+    uint32_t paramId;
+    int32_t value;
+    memcpy(&paramId, param->data, sizeof(paramId));
+    memcpy(&value, param->data + sizeof(paramId), sizeof(value));
+    if (paramId == kRejectedParam) {
+        *static_cast<int32_t*>(pReplyData) = -EINVAL;
+        return 0;
+    }
+    effect->params.emplace_back(paramId, value);
+    *static_cast<int32_t*>(pReplyData) = 0;
+    return 0;
+}
+
+int32_t recordingGetDescriptor(effect_handle_t, effect_descriptor_t*) {
+    return -ENOSYS;
+}
+
+const effect_interface_s kRecordingInterface = {recordingProcess, recordingCommand,
+                                                recordingGetDescriptor, nullptr};
+
+class EffectParameterTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mEffect = new Effect(false /*isInput*/, reinterpret_cast<effect_handle_t>(&mLibrary));
+    }
+
+    RecordingEffect mLibrary = {&kRecordingInterface, {}};
+    sp<Effect> mEffect;
+};
+
+TEST_F(EffectParameterTest, SetsParametersInOrder) {
+    const uint32_t ids[] = {1, 3, 4};
+    const int32_t values[] = {10, 30, 40};
+    std::vector<Effect::ParameterUpdate> updates;
+    for (size_t i = 0; i < std::size(ids); ++i) {
+        updates.push_back({sizeof(uint32_t), &ids[i], sizeof(int32_t), &values[i]});
+    }
+    std::vector<Result> results;
+    EXPECT_EQ(Result::OK, mEffect->setParametersImpl(updates, &results));
+    EXPECT_EQ(std::vector<Result>(3, Result::OK), results);
+    EXPECT_EQ((std::vector<std::pair<uint32_t, int32_t>>{{1, 10}, {3, 30}, {4, 40}}),
+              mLibrary.params);
+}
+
+TEST_F(EffectParameterTest, ReportsTheStatusOfEachParameter) {
+    const uint32_t ids[] = {1, kRejectedParam, 3};
+    const int32_t values[] = {10, 20, 30};
+    std::vector<Effect::ParameterUpdate> updates;
+    for (size_t i = 0; i < std::size(ids); ++i) {
+        updates.push_back({sizeof(uint32_t), &ids[i], sizeof(int32_t), &values[i]});
+    }
+    std::vector<Result> results;
+    EXPECT_EQ(Result::INVALID_ARGUMENTS, mEffect->setParametersImpl(updates, &results));
+    EXPECT_EQ((std::vector<Result>{Result::OK, Result::INVALID_ARGUMENTS, Result::OK}), results);
+    // The failed parameter doesn't stop the ones after it.
+    EXPECT_EQ((std::vector<std::pair<uint32_t, int32_t>>{{1, 10}, {3, 30}}), mLibrary.params);
+}
+
+TEST_F(EffectParameterTest, RejectsOversizedParametersWithoutSendingThem) {
+    const uint32_t ids[] = {1, 3};
+    const int32_t values[] = {10, 30};
+    const std::vector<uint8_t> oversized(EFFECT_PARAM_SIZE_MAX);
+    std::vector<Effect::ParameterUpdate> updates = {
+            {sizeof(uint32_t), &ids[0], sizeof(int32_t), &values[0]},
+            {sizeof(uint32_t), &ids[1], static_cast<uint32_t>(oversized.size()), oversized.data()},
+            {sizeof(uint32_t), &ids[1], sizeof(int32_t), &values[1]},
+    };
+    std::vector<Result> results;
+    EXPECT_EQ(Result::INVALID_ARGUMENTS, mEffect->setParametersImpl(updates, &results));
+    EXPECT_EQ((std::vector<Result>{Result::OK, Result::INVALID_ARGUMENTS, Result::OK}), results);
+    EXPECT_EQ((std::vector<std::pair<uint32_t, int32_t>>{{1, 10}, {3, 30}}), mLibrary.params);
+}
+
+}  // namespace
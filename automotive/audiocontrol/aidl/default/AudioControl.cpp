@@ -70,6 +70,19 @@ bool safelyParseInt(string s, int* out) {
 }
 }  // namespace
 
+AudioControl::AudioControl() : mZoneGainEngine(ZoneGainEngine::Config::defaultConfig()) {
+    mZoneGainEngine.setGainCallback([this](const std::vector<Reasons>& reasons,
+                                           const std::vector<AudioGainConfigInfo>& gains) {
+        shared_ptr<IAudioGainCallback> callback = std::atomic_load(&mAudioGainCallback);
+        if (callback == nullptr) {
+            LOG(DEBUG) << "No audio gain callback registered for " << gains.size()
+                       << " gain changes";
+            return;
+        }
+        callback->onAudioDeviceGainsChanged(reasons, gains);
+    });
+}
+
 ndk::ScopedAStatus AudioControl::registerFocusListener(
         const shared_ptr<IFocusListener>& in_listener) {
     LOG(DEBUG) << "registering focus listener";
@@ -129,6 +142,7 @@ ndk::ScopedAStatus AudioControl::onDevicesToDuckChange(
             LOG(INFO) << usage;
         }
     }
+    mZoneGainEngine.onDevicesToDuckChange(in_duckingInfos);
     return ndk::ScopedAStatus::ok();
 }
 
@@ -146,6 +160,7 @@ ndk::ScopedAStatus AudioControl::onDevicesToMuteChange(
             LOG(INFO) << addressToUnmute;
         }
     }
+    mZoneGainEngine.onDevicesToMuteChange(in_mutingInfos);
     return ndk::ScopedAStatus::ok();
 }
 
@@ -208,6 +223,8 @@ binder_status_t AudioControl::dump(int fd, const char** args, uint32_t numArgs)
         return cmdAbandonFocusWithMetaData(fd, args, numArgs);
     } else if (EqualsIgnoreCase(option, "--audioGainCallback")) {
         return cmdOnAudioDeviceGainsChanged(fd, args, numArgs);
+    } else if (EqualsIgnoreCase(option, "--routeDevice")) {
+        return cmdRouteDevice(fd, args, numArgs);
     } else {
         dprintf(fd, "Invalid option: %s\n", option.c_str());
         return STATUS_BAD_VALUE;
@@ -221,12 +238,15 @@ binder_status_t AudioControl::dumpsys(int fd) {
         dprintf(fd, "Focus listener registered\n");
     }
     dprintf(fd, "AudioGainCallback %sregistered\n", (mAudioGainCallback == nullptr ? "NOT " : ""));
+    mZoneGainEngine.dump(fd);
     return STATUS_OK;
 }
 
 binder_status_t AudioControl::cmdHelp(int fd) const {
     dprintf(fd, "Usage: \n\n");
-    dprintf(fd, "[no args]: dumps focus listener / gain callback registered status\n");
+    dprintf(fd,
+            "[no args]: dumps focus listener / gain callback registered status, and the ducking "
+            "and muting state of each zone and device\n");
     dprintf(fd, "--help: shows this help\n");
     dprintf(fd,
             "--request <USAGE> <ZONE_ID> <FOCUS_GAIN>: requests audio focus for specified "
@@ -250,6 +270,11 @@ binder_status_t AudioControl::cmdHelp(int fd) const {
             "<DEVICE_ADDRESS_1> <GAIN_INDEX_1> [<DEVICE_ADDRESS_N> <GAIN_INDEX_N> ...]: fire audio "
             "gain callback for audio zone ID (int), the given reasons (csv int) for given pairs "
             "of device address (string) and gain index (int) \n");
+    dprintf(fd,
+            "--routeDevice <ZONE_ID> <DEVICE_ADDRESS> <GAIN_INDEX>: routes the device address "
+            "(string) to audio zone ID (int) with the given unattenuated gain index (int) for "
+            "ducking and muting. Devices are otherwise routed to the zone of the first ducking "
+            "or muting change that names them\n");
 
     dprintf(fd,
             "Note on <METADATA>: <USAGE,CONTENT_TYPE[,TAGS]>  specified as where (int)usage, "
@@ -514,4 +539,36 @@ binder_status_t AudioControl::cmdOnAudioDeviceGainsChanged(int fd, const char**
             toEnumString(reasons).c_str(), toString(agcis).c_str());
     return STATUS_OK;
 }
+
+binder_status_t AudioControl::cmdRouteDevice(int fd, const char** args, uint32_t numArgs) {
+    if (!checkCallerHasWritePermissions(fd)) {
+        return STATUS_PERMISSION_DENIED;
+    }
+    if (numArgs != 4) {
+        dprintf(fd,
+                "Invalid number of arguments: please provide --routeDevice <ZONE_ID> "
+                "<DEVICE_ADDRESS> <GAIN_INDEX>\n");
+        return STATUS_BAD_VALUE;
+    }
+    int zoneId;
+    if (!safelyParseInt(string(args[1]), &zoneId)) {
+        dprintf(fd, "Non-integer zoneId provided with request: %s\n", string(args[1]).c_str());
+        return STATUS_BAD_VALUE;
+    }
+    std::string deviceAddress = std::string(args[2]);
+    int index;
+    if (!safelyParseInt(string(args[3]), &index)) {
+        dprintf(fd, "Non-integer index provided with request: %s\n", string(args[3]).c_str());
+        return STATUS_BAD_VALUE;
+    }
+
+    ZoneGainEngine::Device device{.zoneId = zoneId, .address = deviceAddress, .volumeIndex = index};
+    if (!mZoneGainEngine.addDevice(device)) {
+        dprintf(fd, "Device %s is already routed\n", deviceAddress.c_str());
+        return STATUS_BAD_VALUE;
+    }
+    dprintf(fd, "Routed device %s to zoneId %d with gain index %d\n", deviceAddress.c_str(),
+            zoneId, index);
+    return STATUS_OK;
+}
 }  // namespace aidl::android::hardware::automotive::audiocontrol
@@ -26,6 +26,8 @@
 
 #include <aidl/android/hardware/audio/common/PlaybackTrackMetadata.h>
 
+#include "ZoneGainEngine.h"
+
 namespace aidl::android::hardware::automotive::audiocontrol {
 
 namespace audiohalcommon = ::aidl::android::hardware::audio::common;
@@ -33,6 +35,8 @@ namespace audiomediacommon = ::aidl::android::media::audio::common;
 
 class AudioControl : public BnAudioControl {
   public:
+    AudioControl();
+
     ndk::ScopedAStatus onAudioFocusChange(const std::string& in_usage, int32_t in_zoneId,
                                           AudioFocusChange in_focusChange) override;
     ndk::ScopedAStatus onDevicesToDuckChange(
@@ -67,12 +71,17 @@ class AudioControl : public BnAudioControl {
      */
     std::shared_ptr<IAudioGainCallback> mAudioGainCallback = nullptr;
 
+    // Applies the ducking and muting requested by CarAudioService, and reports the resulting
+    // gain changes through mAudioGainCallback.
+    ZoneGainEngine mZoneGainEngine;
+
     binder_status_t cmdHelp(int fd) const;
     binder_status_t cmdRequestFocus(int fd, const char** args, uint32_t numArgs);
     binder_status_t cmdAbandonFocus(int fd, const char** args, uint32_t numArgs);
     binder_status_t cmdRequestFocusWithMetaData(int fd, const char** args, uint32_t numArgs);
     binder_status_t cmdAbandonFocusWithMetaData(int fd, const char** args, uint32_t numArgs);
     binder_status_t cmdOnAudioDeviceGainsChanged(int fd, const char** args, uint32_t numArgs);
+    binder_status_t cmdRouteDevice(int fd, const char** args, uint32_t numArgs);
 
     binder_status_t parseMetaData(int fd, const std::string& metadataLiteral,
                                   audiohalcommon::PlaybackTrackMetadata& trackMetadata);
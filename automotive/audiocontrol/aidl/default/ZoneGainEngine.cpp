@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AudioControl"
+// #define LOG_NDEBUG 0
+
+#include "ZoneGainEngine.h"
+
+#include <aidl/android/media/audio/common/AudioUsage.h>
+
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <stdio.h>
+
+namespace aidl::android::hardware::automotive::audiocontrol {
+
+using ::android::base::StartsWith;
+using ::std::string;
+
+namespace {
+const char kUsagePrefix[] = "AUDIO_USAGE_";
+
+// Usages are reported as audio_policy_configuration.xsd literals, or as AudioUsage values in
+// playback metadata. Both are keyed by the AudioUsage name.
+string normalizeUsage(const string& usage) {
+    return StartsWith(usage, kUsagePrefix) ? usage.substr(sizeof(kUsagePrefix) - 1) : usage;
+}
+
+const char* toString(ZoneGainEngine::RampShape shape) {
+    switch (shape) {
+        case ZoneGainEngine::RampShape::STEP:
+            return "STEP";
+        case ZoneGainEngine::RampShape::LINEAR:
+            return "LINEAR";
+        case ZoneGainEngine::RampShape::SMOOTH:
+            return "SMOOTH";
+    }
+    return "UNKNOWN";
+}
+}  // namespace
+
+ZoneGainEngine::Config ZoneGainEngine::Config::defaultConfig() {
+    Config config;
+    config.usagePolicies = {
+            {"ASSISTANCE_NAVIGATION_GUIDANCE", {10.0f, Reasons::NAV_DUCKING}},
+            {"EMERGENCY", {20.0f, Reasons::ADAS_DUCKING}},
+            {"SAFETY", {20.0f, Reasons::ADAS_DUCKING}},
+            {"VEHICLE_STATUS", {20.0f, Reasons::ADAS_DUCKING}},
+    };
+    config.defaultPolicy = {6.0f, Reasons::OTHER};
+    config.duckRamp = {RampShape::SMOOTH, std::chrono::milliseconds(100)};
+    config.unduckRamp = {RampShape::SMOOTH, std::chrono::milliseconds(500)};
+    config.muteRamp = {RampShape::LINEAR, std::chrono::milliseconds(20)};
+    config.unmuteRamp = {RampShape::LINEAR, std::chrono::milliseconds(200)};
+    config.defaultVolumeIndex = 30;
+    return config;
+}
+
+ZoneGainEngine::ZoneGainEngine(Config config, TimeSource now)
+    : mConfig(std::move(config)), mNow(std::move(now)) {}
+
+void ZoneGainEngine::setGainCallback(GainCallback callback) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mGainCallback = std::move(callback);
+}
+
+bool ZoneGainEngine::addDevice(const Device& device) {
+    std::lock_guard<std::mutex> lock(mLock);
+    DeviceState state;
+    state.device = device;
+    state.volumeIndex = device.volumeIndex;
+    state.rampStart = mNow();
+    return mDevices.emplace(device.address, std::move(state)).second;
+}
+
+void ZoneGainEngine::onDevicesToDuckChange(const std::vector<DuckingInfo>& duckingInfos) {
+    Changes changes;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        const Clock::time_point now = mNow();
+        for (const DuckingInfo& duckingInfo : duckingInfos) {
+            ZoneState& zone = mZones[duckingInfo.zoneId];
+            const DuckingPolicy previous = zone.policy;
+            zone.policy = resolvePolicyLocked(duckingInfo);
+            zone.usagesHoldingFocus.clear();
+            for (const auto& usage : duckingInfo.usagesHoldingFocus) {
+                zone.usagesHoldingFocus.push_back(normalizeUsage(usage));
+            }
+
+            // A device listed both ways is ducked, as the safer of the two.
+            for (const auto& address : duckingInfo.deviceAddressesToUnduck) {
+                if (DeviceState* state = findOrRouteLocked(address, duckingInfo.zoneId)) {
+                    state->ducked = false;
+                }
+            }
+            for (const auto& address : duckingInfo.deviceAddressesToDuck) {
+                if (DeviceState* state = findOrRouteLocked(address, duckingInfo.zoneId)) {
+                    state->ducked = true;
+                }
+            }
+
+            // The new focus holders also change the attenuation of devices ducked before.
+            for (auto& [address, state] : mDevices) {
+                if (state.device.zoneId == duckingInfo.zoneId) {
+                    updateGainLocked(&state, now,
+                                     state.ducked ? zone.policy.reason : previous.reason,
+                                     &changes);
+                }
+            }
+        }
+    }
+    notify(changes);
+}
+
+void ZoneGainEngine::onDevicesToMuteChange(const std::vector<MutingInfo>& mutingInfos) {
+    Changes changes;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        const Clock::time_point now = mNow();
+        for (const MutingInfo& mutingInfo : mutingInfos) {
+            std::vector<DeviceState*> updated;
+            // A device listed both ways is muted, as the safer of the two.
+            for (const auto& address : mutingInfo.deviceAddressesToUnmute) {
+                if (DeviceState* state = findOrRouteLocked(address, mutingInfo.zoneId)) {
+                    state->muted = false;
+                    updated.push_back(state);
+                }
+            }
+            for (const auto& address : mutingInfo.deviceAddressesToMute) {
+                if (DeviceState* state = findOrRouteLocked(address, mutingInfo.zoneId)) {
+                    state->muted = true;
+                    updated.push_back(state);
+                }
+            }
+            for (DeviceState* state : updated) {
+                updateGainLocked(state, now, mConfig.muteReason, &changes);
+            }
+        }
+    }
+    notify(changes);
+}
+
+std::optional<ZoneGainEngine::DeviceGain> ZoneGainEngine::getDeviceGain(
+        const string& address) const {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mDevices.find(address);
+    if (it == mDevices.end()) {
+        return std::nullopt;
+    }
+    const DeviceState& state = it->second;
+    return DeviceGain{
+            .zoneId = state.device.zoneId,
+            .ducked = state.ducked,
+            .muted = state.muted,
+            .targetDb = state.targetDb,
+            .currentDb = currentGainLocked(state, mNow()),
+            .volumeIndex = state.volumeIndex,
+    };
+}
+
+void ZoneGainEngine::dump(int fd) const {
+    std::lock_guard<std::mutex> lock(mLock);
+    const Clock::time_point now = mNow();
+    dprintf(fd, "Zones:\n");
+    for (const auto& [zoneId, zone] : mZones) {
+        dprintf(fd, "  zone %d: ducking by %.1f dB (reason %s) for usages holding focus [%s]\n",
+                zoneId, zone.policy.attenuationDb, toString(zone.policy.reason).c_str(),
+                ::android::base::Join(zone.usagesHoldingFocus, ",").c_str());
+    }
+    dprintf(fd, "Devices:\n");
+    for (const auto& [address, state] : mDevices) {
+        dprintf(fd,
+                "  %s: zone %d, %s%s, gain %.1f dB -> %.1f dB (%s ramp of %lld ms), "
+                "volume index %d of %d\n",
+                address.c_str(), state.device.zoneId, state.ducked ? "ducked" : "unducked",
+                state.muted ? ", muted" : "", currentGainLocked(state, now), state.targetDb,
+                toString(state.ramp.shape), static_cast<long long>(state.ramp.duration.count()),
+                state.volumeIndex, state.device.volumeIndex);
+    }
+    dprintf(fd, "Requests for devices of another zone: %lld\n",
+            static_cast<long long>(mRejectedRequests));
+}
+
+ZoneGainEngine::DeviceState* ZoneGainEngine::findOrRouteLocked(const string& address,
+                                                               int32_t zoneId) {
+    auto it = mDevices.find(address);
+    if (it == mDevices.end()) {
+        LOG(DEBUG) << "Routing device " << address << " to zone " << zoneId;
+        DeviceState state;
+        state.device = {
+                .zoneId = zoneId,
+                .address = address,
+                .volumeIndex = mConfig.defaultVolumeIndex,
+                .indexStepDb = mConfig.defaultIndexStepDb,
+        };
+        state.volumeIndex = mConfig.defaultVolumeIndex;
+        state.rampStart = mNow();
+        it = mDevices.emplace(address, std::move(state)).first;
+    } else if (it->second.device.zoneId != zoneId) {
+        LOG(WARNING) << "Ignoring request from zone " << zoneId << " for device " << address
+                     << " of zone " << it->second.device.zoneId;
+        mRejectedRequests++;
+        return nullptr;
+    }
+    return &it->second;
+}
+
+ZoneGainEngine::DuckingPolicy ZoneGainEngine::resolvePolicyLocked(
+        const DuckingInfo& duckingInfo) const {
+    std::vector<string> usages;
+    for (const auto& usage : duckingInfo.usagesHoldingFocus) {
+        usages.push_back(normalizeUsage(usage));
+    }
+    if (duckingInfo.playbackMetaDataHoldingFocus.has_value()) {
+        for (const auto& metadata : *duckingInfo.playbackMetaDataHoldingFocus) {
+            usages.push_back(toString(metadata.usage));
+        }
+    }
+    if (usages.empty()) {
+        return mConfig.defaultPolicy;
+    }
+
+    const DuckingPolicy* strongest = nullptr;
+    for (const auto& usage : usages) {
+        auto it = mConfig.usagePolicies.find(usage);
+        const DuckingPolicy* policy =
+                it == mConfig.usagePolicies.end() ? &mConfig.defaultPolicy : &it->second;
+        if (strongest == nullptr || policy->attenuationDb > strongest->attenuationDb) {
+            strongest = policy;
+        }
+    }
+    return *strongest;
+}
+
+void ZoneGainEngine::updateGainLocked(DeviceState* state, Clock::time_point now, Reasons reason,
+                                      Changes* changes) {
+    const Device& device = state->device;
+    float targetDb = 0.0f;
+    int32_t volumeIndex = device.volumeIndex;
+    if (state->muted) {
+        targetDb = kMutedGainDb;
+        volumeIndex = device.minIndex;
+    } else if (state->ducked) {
+        targetDb = -mZones[device.zoneId].policy.attenuationDb;
+        int32_t steps = 0;
+        if (device.indexStepDb > 0.0f) {
+            steps = static_cast<int32_t>(std::ceil(-targetDb / device.indexStepDb));
+        }
+        volumeIndex = std::max(device.minIndex, device.volumeIndex - steps);
+    }
+    if (targetDb == state->targetDb && volumeIndex == state->volumeIndex) {
+        return;
+    }
+
+    state->rampStartDb = currentGainLocked(*state, now);
+    state->rampStart = now;
+    if (state->muted) {
+        state->ramp = mConfig.muteRamp;
+    } else if (state->targetDb == kMutedGainDb) {
+        state->ramp = mConfig.unmuteRamp;
+    } else {
+        state->ramp = targetDb < state->targetDb ? mConfig.duckRamp : mConfig.unduckRamp;
+    }
+    state->targetDb = targetDb;
+
+    if (volumeIndex != state->volumeIndex) {
+        state->volumeIndex = volumeIndex;
+        changes->reasons.insert(reason);
+        changes->gains.push_back({device.zoneId, device.address, volumeIndex});
+    }
+}
+
+float ZoneGainEngine::currentGainLocked(const DeviceState& state, Clock::time_point now) const {
+    const auto elapsed = now - state.rampStart;
+    if (elapsed >= state.ramp.duration) {
+        return state.targetDb;
+    }
+    const float progress = std::chrono::duration<float>(elapsed) /
+                           std::chrono::duration<float>(state.ramp.duration);
+    float shaped = 0.0f;
+    switch (state.ramp.shape) {
+        case RampShape::STEP:
+            shaped = 0.0f;
+            break;
+        case RampShape::LINEAR:
+            shaped = progress;
+            break;
+        case RampShape::SMOOTH:
+            shaped = progress * progress * (3.0f - 2.0f * progress);
+            break;
+    }
+    return state.rampStartDb + (state.targetDb - state.rampStartDb) * shaped;
+}
+
+void ZoneGainEngine::notify(const Changes& changes) {
+    if (changes.gains.empty()) {
+        return;
+    }
+    GainCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        callback = mGainCallback;
+    }
+    if (callback) {
+        callback(std::vector<Reasons>(changes.reasons.begin(), changes.reasons.end()),
+                 changes.gains);
+    }
+}
+
+}  // namespace aidl::android::hardware::automotive::audiocontrol
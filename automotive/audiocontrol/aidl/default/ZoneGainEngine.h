@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ANDROID_HARDWARE_AUTOMOTIVE_AUDIOCONTROL_ZONEGAINENGINE_H
+#define ANDROID_HARDWARE_AUTOMOTIVE_AUDIOCONTROL_ZONEGAINENGINE_H
+
+#include <aidl/android/hardware/automotive/audiocontrol/AudioGainConfigInfo.h>
+#include <aidl/android/hardware/automotive/audiocontrol/DuckingInfo.h>
+#include <aidl/android/hardware/automotive/audiocontrol/MutingInfo.h>
+#include <aidl/android/hardware/automotive/audiocontrol/Reasons.h>
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace aidl::android::hardware::automotive::audiocontrol {
+
+/**
+ * Tracks the ducking and muting requested by CarAudioService for each output device, and the gain
+ * that results from it.
+ *
+ * Devices are routed to the zone they belong to, either explicitly through addDevice(), or by
+ * the first ducking or muting request that names them. Requests for a device made on behalf of
+ * another zone are ignored.
+ *
+ * Within a zone, the attenuation of ducked devices is that of the strongest usage holding focus,
+ * and changes whenever the holders do. A muted device stays muted regardless of its ducking, and
+ * returns to its ducked gain when unmuted. Gain changes ramp from the current gain to the new
+ * target along the configured curve; the volume index of the target is reported right away
+ * through the gain callback.
+ */
+class ZoneGainEngine {
+  public:
+    using Clock = std::chrono::steady_clock;
+    using TimeSource = std::function<Clock::time_point()>;
+    using GainCallback = std::function<void(const std::vector<Reasons>& reasons,
+                                            const std::vector<AudioGainConfigInfo>& gains)>;
+
+    // Gain used for muted devices while ramping, in dB.
+    static constexpr float kMutedGainDb = -96.0f;
+
+    enum class RampShape {
+        // Jumps to the target at the end of the ramp.
+        STEP,
+        // Moves linearly in dB.
+        LINEAR,
+        // Moves in dB along a smoothstep, starting and ending slowly.
+        SMOOTH,
+    };
+
+    struct Ramp {
+        RampShape shape = RampShape::LINEAR;
+        std::chrono::milliseconds duration{0};
+    };
+
+    struct DuckingPolicy {
+        // Attenuation applied to ducked devices, in dB.
+        float attenuationDb = 0.0f;
+        // Reason reported through the gain callback.
+        Reasons reason = Reasons::OTHER;
+    };
+
+    struct Config {
+        // Keyed by usage, without the AUDIO_USAGE_ prefix. Usages holding focus that aren't
+        // listed use defaultPolicy.
+        std::map<std::string, DuckingPolicy> usagePolicies;
+        DuckingPolicy defaultPolicy;
+        Reasons muteReason = Reasons::OTHER;
+        Ramp duckRamp;
+        Ramp unduckRamp;
+        Ramp muteRamp;
+        Ramp unmuteRamp;
+        // Used for devices routed by a ducking or muting request.
+        int32_t defaultVolumeIndex = 0;
+        float defaultIndexStepDb = 1.0f;
+
+        // The configuration of the default HAL.
+        static Config defaultConfig();
+    };
+
+    struct Device {
+        int32_t zoneId = 0;
+        std::string address;
+        // Volume index when neither ducked nor muted.
+        int32_t volumeIndex = 0;
+        // Volume index when muted.
+        int32_t minIndex = 0;
+        // Gain of one volume index step, in dB.
+        float indexStepDb = 1.0f;
+    };
+
+    struct DeviceGain {
+        int32_t zoneId = 0;
+        bool ducked = false;
+        bool muted = false;
+        float targetDb = 0.0f;
+        // Gain on the ramp towards targetDb at the time of the query.
+        float currentDb = 0.0f;
+        int32_t volumeIndex = 0;
+    };
+
+    explicit ZoneGainEngine(Config config, TimeSource now = Clock::now);
+
+    void setGainCallback(GainCallback callback);
+
+    // Routes a device to a zone. Returns false if the address is already routed.
+    bool addDevice(const Device& device);
+
+    void onDevicesToDuckChange(const std::vector<DuckingInfo>& duckingInfos);
+    void onDevicesToMuteChange(const std::vector<MutingInfo>& mutingInfos);
+
+    std::optional<DeviceGain> getDeviceGain(const std::string& address) const;
+
+    void dump(int fd) const;
+
+  private:
+    struct DeviceState {
+        Device device;
+        bool ducked = false;
+        bool muted = false;
+        float targetDb = 0.0f;
+        // The ramp towards targetDb.
+        float rampStartDb = 0.0f;
+        Clock::time_point rampStart;
+        Ramp ramp;
+        int32_t volumeIndex = 0;
+    };
+
+    struct ZoneState {
+        std::vector<std::string> usagesHoldingFocus;
+        DuckingPolicy policy;
+    };
+
+    // The gain changes of one request, reported once it's applied.
+    struct Changes {
+        std::set<Reasons> reasons;
+        std::vector<AudioGainConfigInfo> gains;
+    };
+
+    DeviceState* findOrRouteLocked(const std::string& address, int32_t zoneId);
+    DuckingPolicy resolvePolicyLocked(const DuckingInfo& duckingInfo) const;
+    // Moves the device to the gain of its ducking and muting state, recording the change.
+    void updateGainLocked(DeviceState* state, Clock::time_point now, Reasons reason,
+                          Changes* changes);
+    float currentGainLocked(const DeviceState& state, Clock::time_point now) const;
+    void notify(const Changes& changes);
+
+    const Config mConfig;
+    const TimeSource mNow;
+
+    mutable std::mutex mLock;
+    GainCallback mGainCallback;
+    std::map<std::string, DeviceState> mDevices;
+    std::map<int32_t, ZoneState> mZones;
+    // Requests naming a device routed to another zone.
+    int64_t mRejectedRequests = 0;
+};
+
+}  // namespace aidl::android::hardware::automotive::audiocontrol
+
+#endif  // ANDROID_HARDWARE_AUTOMOTIVE_AUDIOCONTROL_ZONEGAINENGINE_H
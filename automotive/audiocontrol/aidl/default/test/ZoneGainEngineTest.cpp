@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ZoneGainEngine.h"
+
+#include <gtest/gtest.h>
+
+namespace aidl::android::hardware::automotive::audiocontrol {
+
+using ::aidl::android::hardware::audio::common::PlaybackTrackMetadata;
+using ::aidl::android::media::audio::common::AudioUsage;
+using ::std::chrono::milliseconds;
+
+namespace {
+
+constexpr char kMedia[] = "AUDIO_USAGE_MEDIA";
+constexpr char kNavigation[] = "AUDIO_USAGE_ASSISTANCE_NAVIGATION_GUIDANCE";
+constexpr char kEmergency[] = "AUDIO_USAGE_EMERGENCY";
+
+DuckingInfo makeDuckingInfo(int32_t zoneId, std::vector<std::string> toDuck,
+                            std::vector<std::string> toUnduck,
+                            std::vector<std::string> usagesHoldingFocus) {
+    DuckingInfo duckingInfo;
+    duckingInfo.zoneId = zoneId;
+    duckingInfo.deviceAddressesToDuck = std::move(toDuck);
+    duckingInfo.deviceAddressesToUnduck = std::move(toUnduck);
+    duckingInfo.usagesHoldingFocus = std::move(usagesHoldingFocus);
+    return duckingInfo;
+}
+
+MutingInfo makeMutingInfo(int32_t zoneId, std::vector<std::string> toMute,
+                          std::vector<std::string> toUnmute) {
+    MutingInfo mutingInfo;
+    mutingInfo.zoneId = zoneId;
+    mutingInfo.deviceAddressesToMute = std::move(toMute);
+    mutingInfo.deviceAddressesToUnmute = std::move(toUnmute);
+    return mutingInfo;
+}
+
+struct GainChange {
+    std::vector<Reasons> reasons;
+    std::vector<AudioGainConfigInfo> gains;
+};
+
+}  // namespace
+
+class ZoneGainEngineTest : public testing::Test {
+  protected:
+    void SetUp() override {
+        ZoneGainEngine::Config config = ZoneGainEngine::Config::defaultConfig();
+        config.duckRamp = {ZoneGainEngine::RampShape::LINEAR, milliseconds(100)};
+        config.unduckRamp = {ZoneGainEngine::RampShape::SMOOTH, milliseconds(400)};
+        config.muteRamp = {ZoneGainEngine::RampShape::STEP, milliseconds(20)};
+        config.unmuteRamp = {ZoneGainEngine::RampShape::LINEAR, milliseconds(200)};
+        mEngine = std::make_unique<ZoneGainEngine>(config, [this] { return mNow; });
+        mEngine->setGainCallback([this](const std::vector<Reasons>& reasons,
+                                        const std::vector<AudioGainConfigInfo>& gains) {
+            mChanges.push_back({reasons, gains});
+        });
+        ASSERT_TRUE(mEngine->addDevice(
+                {.zoneId = 0, .address = "bus0_media_out", .volumeIndex = 30}));
+        ASSERT_TRUE(mEngine->addDevice(
+                {.zoneId = 0, .address = "bus1_navigation_out", .volumeIndex = 30}));
+        ASSERT_TRUE(mEngine->addDevice(
+                {.zoneId = 1, .address = "bus100_audio_zone_1", .volumeIndex = 20}));
+    }
+
+    ZoneGainEngine::DeviceGain getGain(const std::string& address) {
+        auto gain = mEngine->getDeviceGain(address);
+        EXPECT_TRUE(gain.has_value()) << address;
+        return gain.value_or(ZoneGainEngine::DeviceGain{});
+    }
+
+    void advance(milliseconds duration) { mNow += duration; }
+
+    ZoneGainEngine::Clock::time_point mNow;
+    std::vector<GainChange> mChanges;
+    std::unique_ptr<ZoneGainEngine> mEngine;
+};
+
+TEST_F(ZoneGainEngineTest, DucksByTheStrongestUsageHoldingFocus) {
+    mEngine->onDevicesToDuckChange(
+            {makeDuckingInfo(0, {"bus0_media_out"}, {}, {kMedia, kNavigation})});
+
+    auto gain = getGain("bus0_media_out");
+    EXPECT_TRUE(gain.ducked);
+    EXPECT_FLOAT_EQ(gain.targetDb, -10.0f);
+    EXPECT_EQ(gain.volumeIndex, 20);
+    ASSERT_EQ(mChanges.size(), 1u);
+    EXPECT_EQ(mChanges[0].reasons, std::vector<Reasons>{Reasons::NAV_DUCKING});
+    ASSERT_EQ(mChanges[0].gains.size(), 1u);
+    EXPECT_EQ(mChanges[0].gains[0].zoneId, 0);
+    EXPECT_EQ(mChanges[0].gains[0].devicePortAddress, "bus0_media_out");
+    EXPECT_EQ(mChanges[0].gains[0].volumeIndex, 20);
+
+    EXPECT_FALSE(getGain("bus1_navigation_out").ducked);
+}
+
+TEST_F(ZoneGainEngineTest, UsesTheUsagesOfPlaybackMetadata) {
+    DuckingInfo duckingInfo = makeDuckingInfo(0, {"bus0_media_out"}, {}, {kMedia});
+    duckingInfo.playbackMetaDataHoldingFocus =
+            std::vector<PlaybackTrackMetadata>{{.usage = AudioUsage::EMERGENCY}};
+    mEngine->onDevicesToDuckChange({duckingInfo});
+
+    EXPECT_FLOAT_EQ(getGain("bus0_media_out").targetDb, -20.0f);
+    ASSERT_EQ(mChanges.size(), 1u);
+    EXPECT_EQ(mChanges[0].reasons, std::vector<Reasons>{Reasons::ADAS_DUCKING});
+}
+
+TEST_F(ZoneGainEngineTest, FocusHoldersOfOneZoneDontAffectAnother) {
+    mEngine->onDevicesToDuckChange({makeDuckingInfo(0, {"bus0_media_out"}, {}, {kNavigation}),
+                                    makeDuckingInfo(1, {"bus100_audio_zone_1"}, {}, {kMedia})});
+    EXPECT_FLOAT_EQ(getGain("bus0_media_out").targetDb, -10.0f);
+    EXPECT_FLOAT_EQ(getGain("bus100_audio_zone_1").targetDb, -6.0f);
+    EXPECT_EQ(getGain("bus100_audio_zone_1").volumeIndex, 14);
+
+    // An emergency in zone 1 ducks zone 1 harder, but leaves zone 0 alone.
+    mChanges.clear();
+    mEngine->onDevicesToDuckChange({makeDuckingInfo(1, {}, {}, {kMedia, kEmergency})});
+    EXPECT_FLOAT_EQ(getGain("bus0_media_out").targetDb, -10.0f);
+    EXPECT_FLOAT_EQ(getGain("bus100_audio_zone_1").targetDb, -20.0f);
+    EXPECT_EQ(getGain("bus100_audio_zone_1").volumeIndex, 0);
+    ASSERT_EQ(mChanges.size(), 1u);
+    ASSERT_EQ(mChanges[0].gains.size(), 1u);
+    EXPECT_EQ(mChanges[0].gains[0].devicePortAddress, "bus100_audio_zone_1");
+    EXPECT_EQ(mChanges[0].reasons, std::vector<Reasons>{Reasons::ADAS_DUCKING});
+
+    // Once navigation abandons focus in zone 0, the weaker media policy applies there.
+    mChanges.clear();
+    mEngine->onDevicesToDuckChange({makeDuckingInfo(0, {"bus0_media_out"}, {}, {kMedia})});
+    EXPECT_FLOAT_EQ(getGain("bus0_media_out").targetDb, -6.0f);
+    EXPECT_FLOAT_EQ(getGain("bus100_audio_zone_1").targetDb, -20.0f);
+    ASSERT_EQ(mChanges.size(), 1u);
+    EXPECT_EQ(mChanges[0].gains[0].volumeIndex, 24);
+}
+
+TEST_F(ZoneGainEngineTest, IgnoresDevicesOfAnotherZone) {
+    mEngine->onDevicesToDuckChange(
+            {makeDuckingInfo(1, {"bus0_media_out", "bus100_audio_zone_1"}, {}, {kNavigation})});
+    EXPECT_FALSE(getGain("bus0_media_out").ducked);
+    EXPECT_TRUE(getGain("bus100_audio_zone_1").ducked);
+
+    mEngine->onDevicesToMuteChange({makeMutingInfo(0, {"bus100_audio_zone_1"}, {})});
+    EXPECT_FALSE(getGain("bus100_audio_zone_1").muted);
+}
+
+TEST_F(ZoneGainEngineTest, RoutesUnknownDevicesToTheRequestingZone) {
+    mEngine->onDevicesToMuteChange({makeMutingInfo(2, {"bus200_audio_zone_2"}, {})});
+    auto gain = getGain("bus200_audio_zone_2");
+    EXPECT_EQ(gain.zoneId, 2);
+    EXPECT_TRUE(gain.muted);
+
+    EXPECT_FALSE(mEngine->addDevice({.zoneId = 3, .address = "bus200_audio_zone_2"}));
+    EXPECT_EQ(getGain("bus200_audio_zone_2").zoneId, 2);
+}
+
+TEST_F(ZoneGainEngineTest, MuteOverridesDucking) {
+    mEngine->onDevicesToDuckChange({makeDuckingInfo(0, {"bus0_media_out"}, {}, {kNavigation})});
+    mEngine->onDevicesToMuteChange({makeMutingInfo(0, {"bus0_media_out"}, {})});
+    auto gain = getGain("bus0_media_out");
+    EXPECT_TRUE(gain.ducked);
+    EXPECT_TRUE(gain.muted);
+    EXPECT_FLOAT_EQ(gain.targetDb, ZoneGainEngine::kMutedGainDb);
+    EXPECT_EQ(gain.volumeIndex, 0);
+
+    // Unducking a muted device keeps it muted.
+    mChanges.clear();
+    mEngine->onDevicesToDuckChange({makeDuckingInfo(0, {}, {"bus0_media_out"}, {})});
+    EXPECT_FALSE(getGain("bus0_media_out").ducked);
+    EXPECT_EQ(getGain("bus0_media_out").volumeIndex, 0);
+    EXPECT_TRUE(mChanges.empty());
+
+    mEngine->onDevicesToMuteChange({makeMutingInfo(0, {}, {"bus0_media_out"})});
+    EXPECT_FLOAT_EQ(getGain("bus0_media_out").targetDb, 0.0f);
+    EXPECT_EQ(getGain("bus0_media_out").volumeIndex, 30);
+}
+
+TEST_F(ZoneGainEngineTest, UnmuteRestoresTheDuckedGain) {
+    mEngine->onDevicesToMuteChange({makeMutingInfo(0, {"bus0_media_out"}, {})});
+    mEngine->onDevicesToDuckChange({makeDuckingInfo(0, {"bus0_media_out"}, {}, {kNavigation})});
+    EXPECT_EQ(getGain("bus0_media_out").volumeIndex, 0);
+
+    mChanges.clear();
+    mEngine->onDevicesToMuteChange({makeMutingInfo(0, {}, {"bus0_media_out"})});
+    EXPECT_FLOAT_EQ(getGain("bus0_media_out").targetDb, -10.0f);
+    ASSERT_EQ(mChanges.size(), 1u);
+    EXPECT_EQ(mChanges[0].reasons, std::vector<Reasons>{Reasons::OTHER});
+    EXPECT_EQ(mChanges[0].gains[0].volumeIndex, 20);
+}
+
+TEST_F(ZoneGainEngineTest, DevicesListedBothWaysAreAttenuated) {
+    mEngine->onDevicesToDuckChange(
+            {makeDuckingInfo(0, {"bus0_media_out"}, {"bus0_media_out"}, {kNavigation})});
+    EXPECT_TRUE(getGain("bus0_media_out").ducked);
+
+    mEngine->onDevicesToMuteChange(
+            {makeMutingInfo(0, {"bus1_navigation_out"}, {"bus1_navigation_out"})});
+    EXPECT_TRUE(getGain("bus1_navigation_out").muted);
+}
+
+TEST_F(ZoneGainEngineTest, OnlyReportsIndexChanges) {
+    auto duckingInfo = makeDuckingInfo(0, {"bus0_media_out"}, {}, {kNavigation});
+    mEngine->onDevicesToDuckChange({duckingInfo});
+    mEngine->onDevicesToDuckChange({duckingInfo});
+    mEngine->onDevicesToMuteChange({makeMutingInfo(0, {}, {"bus1_navigation_out"})});
+    EXPECT_EQ(mChanges.size(), 1u);
+}
+
+TEST_F(ZoneGainEngineTest, RampsAlongTheConfiguredCurves) {
+    mEngine->onDevicesToDuckChange({makeDuckingInfo(0, {"bus0_media_out"}, {}, {kNavigation})});
+    EXPECT_FLOAT_EQ(getGain("bus0_media_out").currentDb, 0.0f);
+    advance(milliseconds(25));
+    EXPECT_FLOAT_EQ(getGain("bus0_media_out").currentDb, -2.5f);
+    advance(milliseconds(75));
+    EXPECT_FLOAT_EQ(getGain("bus0_media_out").currentDb, -10.0f);
+
+    // The smooth unduck ramp starts slowly, and is halfway there after half its time.
+    mEngine->onDevicesToDuckChange({makeDuckingInfo(0, {}, {"bus0_media_out"}, {})});
+    advance(milliseconds(100));
+    EXPECT_FLOAT_EQ(getGain("bus0_media_out").currentDb, -10.0f + 10.0f * 0.15625f);
+    advance(milliseconds(100));
+    EXPECT_FLOAT_EQ(getGain("bus0_media_out").currentDb, -5.0f);
+
+    // Ducking again mid-ramp starts from where the gain is.
+    mEngine->onDevicesToDuckChange({makeDuckingInfo(0, {"bus0_media_out"}, {}, {kEmergency})});
+    advance(milliseconds(50));
+    EXPECT_FLOAT_EQ(getGain("bus0_media_out").currentDb, -12.5f);
+
+    // Muting jumps at the end of the step ramp.
+    mEngine->onDevicesToMuteChange({makeMutingInfo(0, {"bus0_media_out"}, {})});
+    advance(milliseconds(19));
+    EXPECT_FLOAT_EQ(getGain("bus0_media_out").currentDb, -12.5f);
+    advance(milliseconds(1));
+    EXPECT_FLOAT_EQ(getGain("bus0_media_out").currentDb, ZoneGainEngine::kMutedGainDb);
+
+    mEngine->onDevicesToMuteChange({makeMutingInfo(0, {}, {"bus0_media_out"})});
+    advance(milliseconds(100));
+    EXPECT_FLOAT_EQ(getGain("bus0_media_out").currentDb,
+                    (ZoneGainEngine::kMutedGainDb - 20.0f) / 2.0f);
+}
+
+}  // namespace aidl::android::hardware::automotive::audiocontrol
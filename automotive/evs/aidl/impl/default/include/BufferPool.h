@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_evs_aidl_impl_evshal_include_BufferPool_H_
+#define android_hardware_automotive_evs_aidl_impl_evshal_include_BufferPool_H_
+
+#include "FrameSource.h"
+
+#include <aidl/android/hardware/automotive/evs/BufferDesc.h>
+#include <aidl/android/hardware/graphics/common/BufferUsage.h>
+#include <android-base/unique_fd.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+/**
+ * Buffers of one frame layout, backed by shared memory rather than graphics buffers so that they
+ * also work on hosts without a gralloc. The handle of a buffer holds a single file descriptor of
+ * the memory, which can be mapped to read the frame. Not thread safe.
+ */
+class BufferPool {
+  public:
+    // Arbitrary limit on the number of buffers of a pool, which safeguards against unreasonable
+    // resource consumption.
+    static constexpr int32_t kMaxBuffers = 100;
+
+    BufferPool(FrameLayout layout, std::string name,
+               ::aidl::android::hardware::graphics::common::BufferUsage usage);
+    ~BufferPool();
+
+    /**
+     * Sets the number of buffers, possibly none. Free buffers are released right away when
+     * shrinking, buffers in use once they're returned. Returns false, allocating nothing, if the
+     * count is out of range or memory runs out.
+     */
+    bool resize(int32_t count);
+
+    // Returns the id of a free buffer, now in use, if there is one.
+    std::optional<int32_t> acquire();
+    // Returns false if the buffer isn't in use.
+    bool release(int32_t id);
+
+    uint8_t* data(int32_t id) const { return mBuffers[id].data; }
+    // A description of the buffer, with a new file descriptor for the memory.
+    BufferDesc describe(int32_t id) const;
+
+    const FrameLayout& layout() const { return mLayout; }
+    int32_t size() const { return mCount; }
+    int32_t inUse() const { return mInUse; }
+
+  private:
+    struct Buffer {
+        ::android::base::unique_fd fd;
+        uint8_t* data = nullptr;
+        bool inUse = false;
+    };
+
+    bool allocate(Buffer* buffer);
+    void free(Buffer* buffer);
+
+    const FrameLayout mLayout;
+    const std::string mName;
+    const ::aidl::android::hardware::graphics::common::BufferUsage mUsage;
+    // Indexed by buffer id. Slots of released buffers stay empty until the pool grows again.
+    std::vector<Buffer> mBuffers;
+    int32_t mCount = 0;
+    int32_t mTargetCount = 0;
+    int32_t mInUse = 0;
+};
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
+
+#endif  // android_hardware_automotive_evs_aidl_impl_evshal_include_BufferPool_H_
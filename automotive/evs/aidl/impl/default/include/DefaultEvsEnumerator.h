@@ -17,12 +17,36 @@
 #ifndef android_hardware_automotive_evs_aidl_impl_evshal_include_DefaultEvsHal_H_
 #define android_hardware_automotive_evs_aidl_impl_evshal_include_DefaultEvsHal_H_
 
+#include "EvsVirtualCamera.h"
+#include "EvsVirtualDisplay.h"
+#include "VirtualCameraConfig.h"
+#include "VirtualCameraDevice.h"
+
 #include <aidl/android/hardware/automotive/evs/BnEvsEnumerator.h>
+#include <android-base/thread_annotations.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace aidl::android::hardware::automotive::evs::implementation {
 
+/**
+ * Enumerates virtual cameras and displays. Cameras stream generated patterns or video files, and
+ * displays keep what they're given in memory, so that clients can run on hosts without any camera
+ * or display hardware.
+ */
 class DefaultEvsEnumerator final
     : public ::aidl::android::hardware::automotive::evs::BnEvsEnumerator {
+  public:
+    // Uses the configuration on the device, or the default one if there is none.
+    DefaultEvsEnumerator();
+    explicit DefaultEvsEnumerator(VirtualCameraConfig config);
+
+    // Methods from ::aidl::android::hardware::automotive::evs::IEvsEnumerator follow.
     ::ndk::ScopedAStatus isHardware(bool* flag) override;
     ::ndk::ScopedAStatus openCamera(
             const std::string& cameraId,
@@ -59,6 +83,23 @@ class DefaultEvsEnumerator final
     ::ndk::ScopedAStatus getUltrasonicsArrayList(
             std::vector<::aidl::android::hardware::automotive::evs::UltrasonicsArrayDesc>* list)
             override;
+
+  private:
+    // The physical cameras behind a camera id, if there is such a camera.
+    std::optional<std::vector<VirtualCameraConfig::CameraInfo>> getMembers(
+            const std::string& cameraId) const;
+
+    const VirtualCameraConfig mConfig;
+
+    std::mutex mLock;
+    // Devices are shared by all clients of a camera, and released with the last of them.
+    std::map<std::string, std::weak_ptr<VirtualCameraDevice>> mDevices GUARDED_BY(mLock);
+    // Cameras and the display are released by clients that die without closing them.
+    std::vector<std::weak_ptr<EvsVirtualCamera>> mCameras GUARDED_BY(mLock);
+    std::weak_ptr<EvsVirtualDisplay> mActiveDisplay GUARDED_BY(mLock);
+    std::vector<std::shared_ptr<
+            ::aidl::android::hardware::automotive::evs::IEvsEnumeratorStatusCallback>>
+            mCallbacks GUARDED_BY(mLock);
 };
 
 }  // namespace aidl::android::hardware::automotive::evs::implementation
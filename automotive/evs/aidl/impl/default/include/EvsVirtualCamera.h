@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_evs_aidl_impl_evshal_include_EvsVirtualCamera_H_
+#define android_hardware_automotive_evs_aidl_impl_evshal_include_EvsVirtualCamera_H_
+
+#include "BufferPool.h"
+#include "VirtualCameraDevice.h"
+
+#include <aidl/android/hardware/automotive/evs/BnEvsCamera.h>
+#include <aidl/android/hardware/automotive/evs/IEvsCameraStream.h>
+#include <android-base/thread_annotations.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+/**
+ * One client's handle to a virtual camera. Every client has its own buffers, which frames of the
+ * shared device are copied into, while parameters and the primary role are shared with the other
+ * clients of the device.
+ */
+class EvsVirtualCamera final : public ::aidl::android::hardware::automotive::evs::BnEvsCamera,
+                               public VirtualCameraDevice::Client {
+  public:
+    explicit EvsVirtualCamera(std::shared_ptr<VirtualCameraDevice> device);
+    ~EvsVirtualCamera();
+
+    // Registers the camera with its device. Must be called once the camera is owned by a
+    // shared_ptr.
+    void init();
+    // Stops the stream and releases the device. Later calls fail with OWNERSHIP_LOST.
+    void shutdown();
+
+    const std::string& id() const { return mDevice->id(); }
+
+    // Methods from ::aidl::android::hardware::automotive::evs::IEvsCamera follow.
+    ::ndk::ScopedAStatus doneWithFrame(const std::vector<BufferDesc>& buffers) override;
+    ::ndk::ScopedAStatus forcePrimaryClient(
+            const std::shared_ptr<::aidl::android::hardware::automotive::evs::IEvsDisplay>&
+                    display) override;
+    ::ndk::ScopedAStatus getCameraInfo(CameraDesc* _aidl_return) override;
+    ::ndk::ScopedAStatus getExtendedInfo(int32_t opaqueIdentifier,
+                                         std::vector<uint8_t>* value) override;
+    ::ndk::ScopedAStatus getIntParameter(CameraParam id, std::vector<int32_t>* value) override;
+    ::ndk::ScopedAStatus getIntParameterRange(CameraParam id,
+                                              ParameterRange* _aidl_return) override;
+    ::ndk::ScopedAStatus getParameterList(std::vector<CameraParam>* _aidl_return) override;
+    ::ndk::ScopedAStatus getPhysicalCameraInfo(const std::string& deviceId,
+                                               CameraDesc* _aidl_return) override;
+    ::ndk::ScopedAStatus importExternalBuffers(const std::vector<BufferDesc>& buffers,
+                                               int32_t* _aidl_return) override;
+    ::ndk::ScopedAStatus pauseVideoStream() override;
+    ::ndk::ScopedAStatus resumeVideoStream() override;
+    ::ndk::ScopedAStatus setExtendedInfo(int32_t opaqueIdentifier,
+                                         const std::vector<uint8_t>& opaqueValue) override;
+    ::ndk::ScopedAStatus setIntParameter(CameraParam id, int32_t value,
+                                         std::vector<int32_t>* effectiveValue) override;
+    ::ndk::ScopedAStatus setPrimaryClient() override;
+    ::ndk::ScopedAStatus setMaxFramesInFlight(int32_t bufferCount) override;
+    ::ndk::ScopedAStatus startVideoStream(
+            const std::shared_ptr<::aidl::android::hardware::automotive::evs::IEvsCameraStream>&
+                    receiver) override;
+    ::ndk::ScopedAStatus stopVideoStream() override;
+    ::ndk::ScopedAStatus unsetPrimaryClient() override;
+
+    // Methods from VirtualCameraDevice::Client follow.
+    void onFrames(const std::vector<const uint8_t*>& frames, int64_t timestamp) override;
+    void onEvent(const EvsEventDesc& event) override;
+
+  private:
+    enum class StreamState {
+        STOPPED,
+        RUNNING,
+        // The stream is stopping, and frames in delivery may still arrive.
+        STOPPING,
+        // The camera was closed.
+        DEAD,
+    };
+
+    std::shared_ptr<EvsVirtualCamera> self() { return ref<EvsVirtualCamera>(); }
+    EvsEventDesc makeEvent(EvsEventType type) const;
+    CameraDesc describe(const std::string& id) const;
+
+    const std::shared_ptr<VirtualCameraDevice> mDevice;
+
+    mutable std::mutex mLock;
+    StreamState mState GUARDED_BY(mLock) = StreamState::STOPPED;
+    bool mPaused GUARDED_BY(mLock) = false;
+    std::shared_ptr<::aidl::android::hardware::automotive::evs::IEvsCameraStream> mStream
+            GUARDED_BY(mLock);
+    // One pool per member of the device.
+    std::vector<std::unique_ptr<BufferPool>> mPools GUARDED_BY(mLock);
+    std::map<int32_t, std::vector<uint8_t>> mExtendedInfo GUARDED_BY(mLock);
+};
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
+
+#endif  // android_hardware_automotive_evs_aidl_impl_evshal_include_EvsVirtualCamera_H_
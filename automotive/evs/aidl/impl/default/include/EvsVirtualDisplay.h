@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_evs_aidl_impl_evshal_include_EvsVirtualDisplay_H_
+#define android_hardware_automotive_evs_aidl_impl_evshal_include_EvsVirtualDisplay_H_
+
+#include "BufferPool.h"
+#include "VirtualCameraConfig.h"
+
+#include <aidl/android/hardware/automotive/evs/BnEvsDisplay.h>
+#include <android-base/thread_annotations.h>
+
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+/**
+ * A display that shows nothing. Frames returned while it's visible are kept in memory, so that
+ * what a client would have shown can be checked.
+ */
+class EvsVirtualDisplay final : public ::aidl::android::hardware::automotive::evs::BnEvsDisplay {
+  public:
+    explicit EvsVirtualDisplay(const VirtualCameraConfig::DisplayInfo& info);
+
+    // Marks the display as closed. Later calls fail with OWNERSHIP_LOST.
+    void forceShutdown();
+
+    // The number of frames shown so far, and a copy of the last one.
+    uint64_t framesShown() const;
+    std::vector<uint8_t> lastFrame() const;
+
+    // Methods from ::aidl::android::hardware::automotive::evs::IEvsDisplay follow.
+    ::ndk::ScopedAStatus getDisplayInfo(DisplayDesc* _aidl_return) override;
+    ::ndk::ScopedAStatus getDisplayState(DisplayState* _aidl_return) override;
+    ::ndk::ScopedAStatus getTargetBuffer(BufferDesc* _aidl_return) override;
+    ::ndk::ScopedAStatus returnTargetBufferForDisplay(const BufferDesc& buffer) override;
+    ::ndk::ScopedAStatus setDisplayState(DisplayState state) override;
+
+  private:
+    const VirtualCameraConfig::DisplayInfo mInfo;
+
+    mutable std::mutex mLock;
+    DisplayState mState GUARDED_BY(mLock) = DisplayState::NOT_VISIBLE;
+    BufferPool mBuffers GUARDED_BY(mLock);
+    uint64_t mFramesShown GUARDED_BY(mLock) = 0;
+    std::vector<uint8_t> mLastFrame GUARDED_BY(mLock);
+};
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
+
+#endif  // android_hardware_automotive_evs_aidl_impl_evshal_include_EvsVirtualDisplay_H_
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_evs_aidl_impl_evshal_include_FrameSource_H_
+#define android_hardware_automotive_evs_aidl_impl_evshal_include_FrameSource_H_
+
+#include "VirtualCameraConfig.h"
+
+#include <aidl/android/hardware/graphics/common/PixelFormat.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+/**
+ * How a frame of a format is laid out in a buffer. Rows are padded to the stride, in pixels, and
+ * planes follow each other without gaps. YV12 is laid out as graphics buffers of that format are:
+ * the stride is a multiple of 16 pixels, and the Cr and Cb planes have a stride of half of it,
+ * rounded up to 16.
+ */
+struct FrameLayout {
+    ::aidl::android::hardware::graphics::common::PixelFormat format;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t stride = 0;
+    size_t size = 0;
+
+    // Returns a layout with zero size for unsupported formats or odd sizes of 4:2:x formats.
+    static FrameLayout make(::aidl::android::hardware::graphics::common::PixelFormat format,
+                            int32_t width, int32_t height);
+    // The size of a frame without any row padding.
+    size_t packedSize() const;
+    int32_t pixelSizeBytes() const;
+};
+
+// Frame size and rate of a YUV4MPEG2 stream.
+struct Y4mHeader {
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t framerate = 0;
+
+    // Reads the header line of a stream. Only streams of 4:2:0 frames are accepted.
+    static bool read(std::istream& in, Y4mHeader* header);
+};
+
+/**
+ * Produces the frames of one virtual camera. Frames are written into buffers laid out as
+ * layout() describes. File sources loop back to their first frame at the end of the file.
+ */
+class FrameSource {
+  public:
+    virtual ~FrameSource() = default;
+
+    const FrameLayout& layout() const { return mLayout; }
+    int32_t framerate() const { return mFramerate; }
+
+    // Writes the next frame to dst, which holds layout().size bytes.
+    virtual bool nextFrame(uint8_t* dst) = 0;
+
+    // Returns nullptr if the source of the camera can't be opened.
+    static std::unique_ptr<FrameSource> create(const VirtualCameraConfig::CameraInfo& info);
+
+  protected:
+    FrameSource(FrameLayout layout, int32_t framerate)
+        : mLayout(std::move(layout)), mFramerate(framerate) {}
+
+    const FrameLayout mLayout;
+    const int32_t mFramerate;
+};
+
+class PatternFrameSource final : public FrameSource {
+  public:
+    PatternFrameSource(VirtualCameraConfig::Pattern pattern, int32_t width, int32_t height,
+                       int32_t framerate);
+
+    bool nextFrame(uint8_t* dst) override;
+
+  private:
+    const VirtualCameraConfig::Pattern mPattern;
+    uint32_t mFrameCount = 0;
+};
+
+class RawFileFrameSource final : public FrameSource {
+  public:
+    RawFileFrameSource(FrameLayout layout, int32_t framerate, std::ifstream file);
+
+    bool nextFrame(uint8_t* dst) override;
+
+  private:
+    std::ifstream mFile;
+    std::unique_ptr<uint8_t[]> mPacked;
+};
+
+class Y4mFileFrameSource final : public FrameSource {
+  public:
+    // file must be positioned after the stream header.
+    Y4mFileFrameSource(const Y4mHeader& header, int32_t framerate, std::ifstream file);
+
+    bool nextFrame(uint8_t* dst) override;
+
+  private:
+    std::ifstream mFile;
+    std::streampos mFirstFrame;
+    std::unique_ptr<uint8_t[]> mPacked;
+};
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
+
+#endif  // android_hardware_automotive_evs_aidl_impl_evshal_include_FrameSource_H_
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_evs_aidl_impl_evshal_include_VirtualCameraConfig_H_
+#define android_hardware_automotive_evs_aidl_impl_evshal_include_VirtualCameraConfig_H_
+
+#include <aidl/android/hardware/graphics/common/PixelFormat.h>
+
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+struct VirtualCameraConfig {
+    enum class SourceType {
+        // Frames are generated.
+        PATTERN,
+        // Frames are read from a file of tightly packed frames in the camera's format.
+        RAW,
+        // Frames are read from a YUV4MPEG2 file of 4:2:0 frames, and streamed as YV12.
+        Y4M,
+    };
+
+    enum class Pattern {
+        // Vertical color bars, scrolling by one column every frame.
+        COLOR_BARS,
+        // A gradient whose brightness cycles with the frame count.
+        GRADIENT,
+    };
+
+    struct CameraInfo {
+        std::string id;
+        SourceType source = SourceType::PATTERN;
+        Pattern pattern = Pattern::COLOR_BARS;
+        std::string path;
+        int32_t width = 0;
+        int32_t height = 0;
+        ::aidl::android::hardware::graphics::common::PixelFormat format =
+                ::aidl::android::hardware::graphics::common::PixelFormat::RGBA_8888;
+        int32_t framerate = 30;
+    };
+
+    // A logical camera whose frames hold one buffer of each of its physical cameras.
+    struct GroupInfo {
+        std::string id;
+        std::vector<std::string> members;
+    };
+
+    struct DisplayInfo {
+        uint8_t id = 0;
+        int32_t width = 0;
+        int32_t height = 0;
+    };
+
+    std::map<std::string, CameraInfo> cameras;
+    std::map<std::string, GroupInfo> groups;
+    std::map<uint8_t, DisplayInfo> displays;
+
+    // Two 640x360 pattern cameras at 30 fps, a group of both and one 1280x720 display.
+    static VirtualCameraConfig defaultConfig();
+};
+
+/**
+ * Parses a configuration, one device per line:
+ *
+ *   camera <id> pattern <width> <height> <fps> [colorbars|gradient]
+ *   camera <id> raw <path> <width> <height> <RGBA_8888|YCRCB_420_SP|YCBCR_422_I|YV12> <fps>
+ *   camera <id> y4m <path> [fps]
+ *   group <id> <camera id> <camera id>...
+ *   display <port> <width> <height>
+ *
+ * The size and, unless given, the frame rate of a Y4M camera are read from the header of its
+ * file. Groups may only refer to cameras defined before them. Empty lines and lines starting with
+ * '#' are ignored. Returns false, leaving config untouched, on malformed input.
+ */
+bool parseVirtualCameraConfig(std::istream& in, VirtualCameraConfig* config);
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
+
+#endif  // android_hardware_automotive_evs_aidl_impl_evshal_include_VirtualCameraConfig_H_
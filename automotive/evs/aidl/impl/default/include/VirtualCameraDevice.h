@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_automotive_evs_aidl_impl_evshal_include_VirtualCameraDevice_H_
+#define android_hardware_automotive_evs_aidl_impl_evshal_include_VirtualCameraDevice_H_
+
+#include "FrameSource.h"
+#include "VirtualCameraConfig.h"
+
+#include <aidl/android/hardware/automotive/evs/CameraParam.h>
+#include <aidl/android/hardware/automotive/evs/EvsEventDesc.h>
+#include <aidl/android/hardware/automotive/evs/ParameterRange.h>
+#include <android-base/thread_annotations.h>
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+/**
+ * A virtual camera shared by all clients that opened it. A physical camera has one frame source,
+ * a logical camera one per member. The device produces a frame of every source at the camera's
+ * frame rate while at least one client streams, and arbitrates which client is the primary one.
+ */
+class VirtualCameraDevice final : public std::enable_shared_from_this<VirtualCameraDevice> {
+  public:
+    class Client {
+      public:
+        virtual ~Client() = default;
+        // Called on the capture thread with one frame per member, in the order of members().
+        virtual void onFrames(const std::vector<const uint8_t*>& frames, int64_t timestamp) = 0;
+        virtual void onEvent(const EvsEventDesc& event) = 0;
+    };
+
+    // Returns nullptr if a frame source can't be opened.
+    static std::shared_ptr<VirtualCameraDevice> create(
+            const std::string& id, const std::vector<VirtualCameraConfig::CameraInfo>& members);
+    ~VirtualCameraDevice();
+
+    const std::string& id() const { return mId; }
+    bool isLogical() const { return mIsLogical; }
+    const std::vector<VirtualCameraConfig::CameraInfo>& members() const { return mMembers; }
+    // Returns -1 if the id is no member.
+    int32_t memberIndex(const std::string& memberId) const;
+    const FrameLayout& layout(size_t member) const { return mSources[member]->layout(); }
+
+    void addClient(const std::shared_ptr<Client>& client);
+    // Also stops streaming to the client and releases the primary role.
+    void removeClient(const Client* client);
+
+    // Once these return, the client gets no more frames until it streams again.
+    void startStreaming(const std::shared_ptr<Client>& client);
+    void stopStreaming(const Client* client);
+
+    // Returns false if another client is the primary one.
+    bool setPrimaryClient(const std::shared_ptr<Client>& client);
+    // Makes the client the primary one, notifying the previous one of its loss.
+    void forcePrimaryClient(const std::shared_ptr<Client>& client);
+    // Returns false if the client isn't the primary one. Other clients are notified.
+    bool unsetPrimaryClient(const Client* client);
+    bool isPrimaryClient(const Client* client) const;
+
+    static const std::vector<CameraParam>& supportedParameters();
+    // Both return false for unsupported parameters.
+    static bool getParameterRange(CameraParam id, ParameterRange* range);
+    bool getParameter(CameraParam id, int32_t* value) const;
+    // Clamps the value to the parameter's range, and notifies every client of the change.
+    bool setParameter(CameraParam id, int32_t value, int32_t* effectiveValue);
+
+  private:
+    VirtualCameraDevice(const std::string& id,
+                        const std::vector<VirtualCameraConfig::CameraInfo>& members,
+                        std::vector<std::unique_ptr<FrameSource>> sources);
+
+    void captureLoop(uint64_t generation);
+    std::vector<std::shared_ptr<Client>> clientsLocked() const REQUIRES(mLock);
+    void notify(const std::vector<std::shared_ptr<Client>>& clients, EvsEventType type,
+                std::vector<int32_t> payload = {});
+
+    const std::string mId;
+    const bool mIsLogical;
+    const std::vector<VirtualCameraConfig::CameraInfo> mMembers;
+    const int32_t mFramerate;
+    // Only used by the capture thread.
+    std::vector<std::unique_ptr<FrameSource>> mSources;
+    std::vector<std::unique_ptr<uint8_t[]>> mFrames;
+
+    mutable std::mutex mLock;
+    std::condition_variable mWakeUp;
+    std::vector<std::weak_ptr<Client>> mClients GUARDED_BY(mLock);
+    std::vector<std::weak_ptr<Client>> mStreamingClients GUARDED_BY(mLock);
+    std::weak_ptr<Client> mPrimaryClient GUARDED_BY(mLock);
+    std::map<CameraParam, int32_t> mParameters GUARDED_BY(mLock);
+    // Bumped whenever capturing stops, so that a thread that was left to finish on its own
+    // exits even if capturing restarts meanwhile.
+    uint64_t mGeneration GUARDED_BY(mLock) = 0;
+    std::thread mCaptureThread GUARDED_BY(mLock);
+
+    // Held by the capture thread while it hands frames to clients.
+    std::mutex mDeliveryLock;
+};
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
+
+#endif  // android_hardware_automotive_evs_aidl_impl_evshal_include_VirtualCameraDevice_H_
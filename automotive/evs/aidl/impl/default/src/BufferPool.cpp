@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "EvsBufferPool"
+
+#include "BufferPool.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utils/Log.h>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+using ::aidl::android::hardware::graphics::common::BufferUsage;
+using ::android::base::unique_fd;
+
+BufferPool::BufferPool(FrameLayout layout, std::string name, BufferUsage usage)
+    : mLayout(std::move(layout)), mName(std::move(name)), mUsage(usage) {}
+
+BufferPool::~BufferPool() {
+    for (auto& buffer : mBuffers) {
+        free(&buffer);
+    }
+}
+
+bool BufferPool::resize(int32_t count) {
+    if (count < 0 || count > kMaxBuffers) {
+        ALOGE("Rejecting a request for %d buffers", count);
+        return false;
+    }
+
+    if (count > mCount) {
+        // Slots of released buffers are filled first, keeping the ids of the others stable.
+        const size_t previousSlots = mBuffers.size();
+        std::vector<size_t> added;
+        for (size_t i = 0; mCount + static_cast<int32_t>(added.size()) < count; ++i) {
+            if (i == mBuffers.size()) {
+                mBuffers.emplace_back();
+            }
+            if (mBuffers[i].data != nullptr) {
+                continue;
+            }
+            if (!allocate(&mBuffers[i])) {
+                // Roll back to the previous state.
+                for (size_t id : added) {
+                    free(&mBuffers[id]);
+                }
+                mBuffers.resize(previousSlots);
+                return false;
+            }
+            added.push_back(i);
+        }
+        mCount = count;
+    } else {
+        for (auto& buffer : mBuffers) {
+            if (mCount == count) break;
+            if (buffer.data != nullptr && !buffer.inUse) {
+                free(&buffer);
+                mCount--;
+            }
+        }
+    }
+    mTargetCount = count;
+    return true;
+}
+
+std::optional<int32_t> BufferPool::acquire() {
+    for (size_t id = 0; id < mBuffers.size(); ++id) {
+        Buffer& buffer = mBuffers[id];
+        if (buffer.data != nullptr && !buffer.inUse) {
+            buffer.inUse = true;
+            mInUse++;
+            return static_cast<int32_t>(id);
+        }
+    }
+    return std::nullopt;
+}
+
+bool BufferPool::release(int32_t id) {
+    if (id < 0 || static_cast<size_t>(id) >= mBuffers.size() || !mBuffers[id].inUse) {
+        return false;
+    }
+    mBuffers[id].inUse = false;
+    mInUse--;
+    if (mCount > mTargetCount) {
+        // Finish shrinking the pool.
+        free(&mBuffers[id]);
+        mCount--;
+    }
+    return true;
+}
+
+BufferDesc BufferPool::describe(int32_t id) const {
+    BufferDesc desc;
+    desc.buffer.description.width = mLayout.width;
+    desc.buffer.description.height = mLayout.height;
+    desc.buffer.description.layers = 1;
+    desc.buffer.description.format = mLayout.format;
+    desc.buffer.description.usage = mUsage;
+    desc.buffer.description.stride = mLayout.stride;
+    desc.buffer.handle.fds.emplace_back(dup(mBuffers[id].fd.get()));
+    desc.pixelSizeBytes = mLayout.pixelSizeBytes();
+    desc.bufferId = id;
+    return desc;
+}
+
+bool BufferPool::allocate(Buffer* buffer) {
+    unique_fd fd(memfd_create(mName.c_str(), MFD_CLOEXEC));
+    if (fd < 0 || ftruncate(fd.get(), mLayout.size) != 0) {
+        ALOGE("Failed to allocate a %zu byte buffer for %s", mLayout.size, mName.c_str());
+        return false;
+    }
+    void* data = mmap(nullptr, mLayout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (data == MAP_FAILED) {
+        ALOGE("Failed to map a buffer for %s", mName.c_str());
+        return false;
+    }
+    buffer->fd = std::move(fd);
+    buffer->data = static_cast<uint8_t*>(data);
+    buffer->inUse = false;
+    return true;
+}
+
+void BufferPool::free(Buffer* buffer) {
+    if (buffer->data == nullptr) {
+        return;
+    }
+    if (buffer->inUse) {
+        ALOGE("Releasing a buffer of %s despite remote ownership", mName.c_str());
+        mInUse--;
+    }
+    munmap(buffer->data, mLayout.size);
+    buffer->data = nullptr;
+    buffer->fd.reset();
+    buffer->inUse = false;
+}
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
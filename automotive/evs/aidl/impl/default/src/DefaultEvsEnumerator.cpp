@@ -14,18 +14,58 @@
  * limitations under the License.
  */
 
-// TODO(b/203661081): Remove below lines to disable compiler warnings.
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wunused-parameter"
-
 #define LOG_TAG "DefaultEvsEnumerator"
 
 #include <DefaultEvsEnumerator.h>
 
+#include <aidl/android/hardware/automotive/evs/EvsResult.h>
+#include <utils/Log.h>
+
+#include <algorithm>
+#include <fstream>
+
 namespace aidl::android::hardware::automotive::evs::implementation {
 
+using ::aidl::android::hardware::graphics::common::BufferUsage;
 using ::ndk::ScopedAStatus;
 
+namespace {
+
+constexpr char kConfigPath[] = "/vendor/etc/automotive/evs/evs_virtual_cameras.conf";
+
+ScopedAStatus toStatus(EvsResult result) {
+    return ScopedAStatus::fromServiceSpecificError(static_cast<int32_t>(result));
+}
+
+VirtualCameraConfig loadConfig() {
+    std::ifstream file(kConfigPath);
+    VirtualCameraConfig config;
+    if (file && parseVirtualCameraConfig(file, &config)) {
+        return config;
+    }
+    ALOGI("No valid configuration in %s, using the default cameras", kConfigPath);
+    return VirtualCameraConfig::defaultConfig();
+}
+
+// An unset size matches any stream of the camera.
+bool isSupported(const std::vector<VirtualCameraConfig::CameraInfo>& members,
+                 const Stream& streamConfig) {
+    if (streamConfig.width == 0 && streamConfig.height == 0) {
+        return true;
+    }
+    return std::any_of(members.begin(), members.end(), [&streamConfig](const auto& member) {
+        return member.width == streamConfig.width && member.height == streamConfig.height &&
+               member.format == streamConfig.format;
+    });
+}
+
+}  // namespace
+
+DefaultEvsEnumerator::DefaultEvsEnumerator() : DefaultEvsEnumerator(loadConfig()) {}
+
+DefaultEvsEnumerator::DefaultEvsEnumerator(VirtualCameraConfig config)
+    : mConfig(std::move(config)) {}
+
 ScopedAStatus DefaultEvsEnumerator::isHardware(bool* flag) {
     // This returns true always.
     *flag = true;
@@ -35,59 +75,197 @@ ScopedAStatus DefaultEvsEnumerator::isHardware(bool* flag) {
 ScopedAStatus DefaultEvsEnumerator::openCamera(const std::string& cameraId,
                                                const Stream& streamConfig,
                                                std::shared_ptr<IEvsCamera>* obj) {
+    auto members = getMembers(cameraId);
+    if (!members) {
+        ALOGE("Camera %s is unknown", cameraId.c_str());
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+    if (!isSupported(*members, streamConfig)) {
+        ALOGE("Camera %s doesn't support a %dx%d stream", cameraId.c_str(), streamConfig.width,
+              streamConfig.height);
+        *obj = nullptr;
+        return ScopedAStatus::ok();
+    }
+
+    std::lock_guard<std::mutex> lock(mLock);
+    auto device = mDevices[cameraId].lock();
+    if (device == nullptr) {
+        device = VirtualCameraDevice::create(cameraId, *members);
+        if (device == nullptr) {
+            return toStatus(EvsResult::UNDERLYING_SERVICE_ERROR);
+        }
+        mDevices[cameraId] = device;
+    }
+
+    auto camera = ::ndk::SharedRefBase::make<EvsVirtualCamera>(device);
+    camera->init();
+    mCameras.erase(std::remove_if(mCameras.begin(), mCameras.end(),
+                                  [](const auto& weak) { return weak.expired(); }),
+                   mCameras.end());
+    mCameras.push_back(camera);
+    *obj = camera;
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus DefaultEvsEnumerator::closeCamera(const std::shared_ptr<IEvsCamera>& obj) {
+    if (obj == nullptr) {
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+
+    std::shared_ptr<EvsVirtualCamera> camera;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        for (auto it = mCameras.begin(); it != mCameras.end(); ++it) {
+            auto candidate = it->lock();
+            if (candidate != nullptr && candidate->asBinder() == obj->asBinder()) {
+                camera = std::move(candidate);
+                mCameras.erase(it);
+                break;
+            }
+        }
+    }
+    if (camera == nullptr) {
+        ALOGE("Ignoring a request to close an unknown camera");
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+    camera->shutdown();
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus DefaultEvsEnumerator::getCameraList(std::vector<CameraDesc>* list) {
+    list->clear();
+    for (const auto& [id, info] : mConfig.cameras) {
+        list->emplace_back().id = id;
+    }
+    for (const auto& [id, info] : mConfig.groups) {
+        list->emplace_back().id = id;
+    }
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus DefaultEvsEnumerator::getStreamList(const CameraDesc& desc,
                                                   std::vector<Stream>* _aidl_return) {
+    auto members = getMembers(desc.id);
+    if (!members) {
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+
+    _aidl_return->clear();
+    for (const auto& member : *members) {
+        _aidl_return->push_back({
+                .id = static_cast<int32_t>(_aidl_return->size()),
+                .streamType = StreamType::OUTPUT,
+                .width = member.width,
+                .height = member.height,
+                .framerate = member.framerate,
+                .format = member.format,
+                .usage = static_cast<BufferUsage>(
+                        static_cast<int64_t>(BufferUsage::CAMERA_OUTPUT) |
+                        static_cast<int64_t>(BufferUsage::CPU_READ_OFTEN)),
+                .rotation = Rotation::ROTATION_0,
+        });
+    }
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus DefaultEvsEnumerator::openDisplay(int32_t displayId,
                                                 std::shared_ptr<IEvsDisplay>* obj) {
+    auto it = displayId < 0 || displayId > UINT8_MAX
+                      ? mConfig.displays.end()
+                      : mConfig.displays.find(static_cast<uint8_t>(displayId));
+    if (it == mConfig.displays.end()) {
+        ALOGE("Display %d is unknown", displayId);
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+
+    std::lock_guard<std::mutex> lock(mLock);
+    // The latest client takes the display over.
+    if (auto previous = mActiveDisplay.lock(); previous != nullptr) {
+        ALOGW("Killing the previous display because of a new caller");
+        previous->forceShutdown();
+    }
+    auto display = ::ndk::SharedRefBase::make<EvsVirtualDisplay>(it->second);
+    mActiveDisplay = display;
+    *obj = display;
     return ScopedAStatus::ok();
 }
 
-ScopedAStatus DefaultEvsEnumerator::closeDisplay(const std::shared_ptr<IEvsDisplay>& state) {
+ScopedAStatus DefaultEvsEnumerator::closeDisplay(const std::shared_ptr<IEvsDisplay>& obj) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto display = mActiveDisplay.lock();
+    if (obj == nullptr || display == nullptr || display->asBinder() != obj->asBinder()) {
+        ALOGW("Ignoring a call to close a display which isn't the active one");
+        return ScopedAStatus::ok();
+    }
+    display->forceShutdown();
+    mActiveDisplay.reset();
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus DefaultEvsEnumerator::getDisplayIdList(std::vector<uint8_t>* list) {
+    list->clear();
+    for (const auto& [id, info] : mConfig.displays) {
+        list->push_back(id);
+    }
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus DefaultEvsEnumerator::getDisplayState(DisplayState* state) {
-    return ScopedAStatus::ok();
+    std::shared_ptr<EvsVirtualDisplay> display;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        display = mActiveDisplay.lock();
+    }
+    if (display == nullptr) {
+        *state = DisplayState::NOT_OPEN;
+        return ScopedAStatus::ok();
+    }
+    return display->getDisplayState(state);
 }
 
 ScopedAStatus DefaultEvsEnumerator::registerStatusCallback(
         const std::shared_ptr<IEvsEnumeratorStatusCallback>& callback) {
+    if (callback == nullptr) {
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+    // Virtual cameras never come or go, so there is nothing to report yet.
+    std::lock_guard<std::mutex> lock(mLock);
+    mCallbacks.push_back(callback);
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus DefaultEvsEnumerator::openUltrasonicsArray(
-        const std::string& id, std::shared_ptr<IEvsUltrasonicsArray>* obj) {
-    return ScopedAStatus::ok();
+        [[maybe_unused]] const std::string& id,
+        [[maybe_unused]] std::shared_ptr<IEvsUltrasonicsArray>* obj) {
+    return toStatus(EvsResult::NOT_SUPPORTED);
 }
 
 ScopedAStatus DefaultEvsEnumerator::closeUltrasonicsArray(
-        const std::shared_ptr<IEvsUltrasonicsArray>& obj) {
-    return ScopedAStatus::ok();
+        [[maybe_unused]] const std::shared_ptr<IEvsUltrasonicsArray>& obj) {
+    return toStatus(EvsResult::NOT_SUPPORTED);
 }
 
 ScopedAStatus DefaultEvsEnumerator::getUltrasonicsArrayList(
         std::vector<UltrasonicsArrayDesc>* list) {
+    // Ultrasonics arrays aren't supported.
+    list->clear();
     return ScopedAStatus::ok();
 }
 
-}  // namespace aidl::android::hardware::automotive::evs::implementation
+std::optional<std::vector<VirtualCameraConfig::CameraInfo>> DefaultEvsEnumerator::getMembers(
+        const std::string& cameraId) const {
+    if (auto it = mConfig.cameras.find(cameraId); it != mConfig.cameras.end()) {
+        return std::vector<VirtualCameraConfig::CameraInfo>{it->second};
+    }
+    auto it = mConfig.groups.find(cameraId);
+    if (it == mConfig.groups.end()) {
+        return std::nullopt;
+    }
+    std::vector<VirtualCameraConfig::CameraInfo> members;
+    for (const auto& member : it->second.members) {
+        members.push_back(mConfig.cameras.at(member));
+    }
+    return members;
+}
 
-#pragma clang diagnostic pop
+}  // namespace aidl::android::hardware::automotive::evs::implementation
@@ -0,0 +1,390 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "EvsVirtualCamera"
+
+#include "EvsVirtualCamera.h"
+
+#include <aidl/android/hardware/automotive/evs/EvsResult.h>
+#include <aidl/android/hardware/automotive/evs/IEvsDisplay.h>
+#include <utils/Log.h>
+
+#include <cstring>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+using ::aidl::android::hardware::graphics::common::BufferUsage;
+using ::ndk::ScopedAStatus;
+
+namespace {
+
+ScopedAStatus toStatus(EvsResult result) {
+    return ScopedAStatus::fromServiceSpecificError(static_cast<int32_t>(result));
+}
+
+}  // namespace
+
+EvsVirtualCamera::EvsVirtualCamera(std::shared_ptr<VirtualCameraDevice> device)
+    : mDevice(std::move(device)) {
+    const auto usage = static_cast<BufferUsage>(static_cast<int64_t>(BufferUsage::CAMERA_OUTPUT) |
+                                                static_cast<int64_t>(BufferUsage::CPU_READ_OFTEN));
+    std::lock_guard<std::mutex> lock(mLock);
+    for (size_t i = 0; i < mDevice->members().size(); ++i) {
+        mPools.push_back(
+                std::make_unique<BufferPool>(mDevice->layout(i), mDevice->members()[i].id, usage));
+    }
+}
+
+EvsVirtualCamera::~EvsVirtualCamera() {
+    mDevice->removeClient(this);
+}
+
+void EvsVirtualCamera::init() {
+    mDevice->addClient(self());
+}
+
+void EvsVirtualCamera::shutdown() {
+    std::shared_ptr<IEvsCameraStream> stream;
+    StreamState previousState;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        previousState = mState;
+        mState = StreamState::DEAD;
+        stream = std::move(mStream);
+    }
+    if (previousState == StreamState::DEAD) {
+        return;
+    }
+
+    // Also waits for a delivery in progress.
+    mDevice->removeClient(this);
+    if (previousState == StreamState::RUNNING && stream != nullptr) {
+        stream->notify(makeEvent(EvsEventType::STREAM_STOPPED));
+    }
+
+    // Buffers still held by the client stay valid for it, as it holds its own descriptors.
+    std::lock_guard<std::mutex> lock(mLock);
+    mPools.clear();
+}
+
+ScopedAStatus EvsVirtualCamera::doneWithFrame(const std::vector<BufferDesc>& buffers) {
+    std::lock_guard<std::mutex> lock(mLock);
+    for (const auto& buffer : buffers) {
+        const int32_t member = mDevice->memberIndex(buffer.deviceId);
+        if (member < 0 || static_cast<size_t>(member) >= mPools.size() ||
+            !mPools[member]->release(buffer.bufferId)) {
+            ALOGE("Ignoring the return of unknown buffer %d of %s", buffer.bufferId,
+                  buffer.deviceId.c_str());
+        }
+    }
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::forcePrimaryClient(const std::shared_ptr<IEvsDisplay>& display) {
+    // Only a client holding the active display may take over.
+    DisplayState state;
+    if (display == nullptr || !display->getDisplayState(&state).isOk() ||
+        state == DisplayState::NOT_OPEN || state == DisplayState::DEAD) {
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mState == StreamState::DEAD) {
+            return toStatus(EvsResult::OWNERSHIP_LOST);
+        }
+    }
+    mDevice->forcePrimaryClient(self());
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::getCameraInfo(CameraDesc* _aidl_return) {
+    *_aidl_return = describe(id());
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::getExtendedInfo(int32_t opaqueIdentifier,
+                                                std::vector<uint8_t>* value) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mExtendedInfo.find(opaqueIdentifier);
+    if (it == mExtendedInfo.end()) {
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+    *value = it->second;
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::getIntParameter(CameraParam id, std::vector<int32_t>* value) {
+    int32_t current;
+    if (!mDevice->getParameter(id, &current)) {
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+    // A logical camera reports the shared value once per member.
+    value->assign(mDevice->members().size(), current);
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::getIntParameterRange(CameraParam id,
+                                                     ParameterRange* _aidl_return) {
+    if (!VirtualCameraDevice::getParameterRange(id, _aidl_return)) {
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::getParameterList(std::vector<CameraParam>* _aidl_return) {
+    *_aidl_return = VirtualCameraDevice::supportedParameters();
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::getPhysicalCameraInfo(const std::string& deviceId,
+                                                      CameraDesc* _aidl_return) {
+    // A physical camera is its own only member.
+    if (mDevice->memberIndex(deviceId) < 0) {
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+    *_aidl_return = describe(deviceId);
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::importExternalBuffers(
+        [[maybe_unused]] const std::vector<BufferDesc>& buffers, int32_t* _aidl_return) {
+    // Frames are copied into buffers of our own.
+    *_aidl_return = 0;
+    return toStatus(EvsResult::NOT_SUPPORTED);
+}
+
+ScopedAStatus EvsVirtualCamera::pauseVideoStream() {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mState == StreamState::DEAD) {
+        return toStatus(EvsResult::OWNERSHIP_LOST);
+    }
+    mPaused = true;
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::resumeVideoStream() {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mState == StreamState::DEAD) {
+        return toStatus(EvsResult::OWNERSHIP_LOST);
+    }
+    mPaused = false;
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::setExtendedInfo(int32_t opaqueIdentifier,
+                                                const std::vector<uint8_t>& opaqueValue) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mState == StreamState::DEAD) {
+        return toStatus(EvsResult::OWNERSHIP_LOST);
+    }
+    mExtendedInfo[opaqueIdentifier] = opaqueValue;
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::setIntParameter(CameraParam id, int32_t value,
+                                                std::vector<int32_t>* effectiveValue) {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mState == StreamState::DEAD) {
+            return toStatus(EvsResult::OWNERSHIP_LOST);
+        }
+    }
+    int32_t applied;
+    if (!mDevice->isPrimaryClient(this) || !mDevice->setParameter(id, value, &applied)) {
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+    effectiveValue->assign(mDevice->members().size(), applied);
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::setPrimaryClient() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mState == StreamState::DEAD) {
+            return toStatus(EvsResult::OWNERSHIP_LOST);
+        }
+    }
+    if (!mDevice->setPrimaryClient(self())) {
+        return toStatus(EvsResult::OWNERSHIP_LOST);
+    }
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::setMaxFramesInFlight(int32_t bufferCount) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mState == StreamState::DEAD) {
+        return toStatus(EvsResult::OWNERSHIP_LOST);
+    }
+    if (bufferCount < 1) {
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+
+    std::vector<int32_t> previousSizes;
+    for (auto& pool : mPools) {
+        const int32_t previousSize = pool->size();
+        if (!pool->resize(bufferCount)) {
+            // Restore the pools resized already, so that all of them keep matching. Pools that had
+            // no buffers yet go back to none, as startVideoStream() relies on that.
+            for (size_t i = 0; i < previousSizes.size(); ++i) {
+                if (!mPools[i]->resize(previousSizes[i])) {
+                    ALOGE("Failed to restore %d buffers of %s", previousSizes[i], id().c_str());
+                }
+            }
+            return toStatus(EvsResult::BUFFER_NOT_AVAILABLE);
+        }
+        previousSizes.push_back(previousSize);
+    }
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::startVideoStream(
+        const std::shared_ptr<IEvsCameraStream>& receiver) {
+    if (receiver == nullptr) {
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mState == StreamState::DEAD) {
+            return toStatus(EvsResult::OWNERSHIP_LOST);
+        }
+        if (mState != StreamState::STOPPED) {
+            return toStatus(EvsResult::STREAM_ALREADY_RUNNING);
+        }
+        for (auto& pool : mPools) {
+            // Clients that didn't ask for a number of buffers get one.
+            if (pool->size() == 0 && !pool->resize(1)) {
+                return toStatus(EvsResult::BUFFER_NOT_AVAILABLE);
+            }
+        }
+        mStream = receiver;
+        mState = StreamState::RUNNING;
+        mPaused = false;
+    }
+
+    receiver->notify(makeEvent(EvsEventType::STREAM_STARTED));
+    mDevice->startStreaming(self());
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::stopVideoStream() {
+    std::shared_ptr<IEvsCameraStream> stream;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mState != StreamState::RUNNING) {
+            return ScopedAStatus::ok();
+        }
+        mState = StreamState::STOPPING;
+        stream = mStream;
+    }
+
+    // Once this returns, no more frames are delivered, so that the event is the last callback.
+    mDevice->stopStreaming(this);
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mState == StreamState::STOPPING) {
+            mState = StreamState::STOPPED;
+            mStream.reset();
+        }
+    }
+    stream->notify(makeEvent(EvsEventType::STREAM_STOPPED));
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualCamera::unsetPrimaryClient() {
+    if (!mDevice->unsetPrimaryClient(this)) {
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+    return ScopedAStatus::ok();
+}
+
+void EvsVirtualCamera::onFrames(const std::vector<const uint8_t*>& frames, int64_t timestamp) {
+    std::shared_ptr<IEvsCameraStream> stream;
+    std::vector<BufferDesc> buffers;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mState != StreamState::RUNNING || mPaused) {
+            return;
+        }
+        stream = mStream;
+
+        // A frame holds a buffer of every member, so it's dropped unless all have one free.
+        std::vector<int32_t> ids;
+        for (auto& pool : mPools) {
+            auto bufferId = pool->acquire();
+            if (!bufferId) {
+                break;
+            }
+            ids.push_back(*bufferId);
+        }
+        if (ids.size() < mPools.size()) {
+            for (size_t i = 0; i < ids.size(); ++i) {
+                mPools[i]->release(ids[i]);
+            }
+        } else {
+            for (size_t i = 0; i < mPools.size(); ++i) {
+                memcpy(mPools[i]->data(ids[i]), frames[i], mPools[i]->layout().size);
+                BufferDesc buffer = mPools[i]->describe(ids[i]);
+                buffer.deviceId = mDevice->members()[i].id;
+                buffer.timestamp = timestamp;
+                buffers.push_back(std::move(buffer));
+            }
+        }
+    }
+
+    if (buffers.empty()) {
+        stream->notify(makeEvent(EvsEventType::FRAME_DROPPED));
+        return;
+    }
+    std::vector<int32_t> ids;
+    for (const auto& buffer : buffers) {
+        ids.push_back(buffer.bufferId);
+    }
+    if (!stream->deliverFrame(buffers).isOk()) {
+        ALOGE("Failed to deliver a frame of %s", id().c_str());
+        std::lock_guard<std::mutex> lock(mLock);
+        for (size_t i = 0; i < ids.size() && i < mPools.size(); ++i) {
+            mPools[i]->release(ids[i]);
+        }
+    }
+}
+
+void EvsVirtualCamera::onEvent(const EvsEventDesc& event) {
+    std::shared_ptr<IEvsCameraStream> stream;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mState != StreamState::RUNNING) {
+            return;
+        }
+        stream = mStream;
+    }
+    stream->notify(event);
+}
+
+EvsEventDesc EvsVirtualCamera::makeEvent(EvsEventType type) const {
+    EvsEventDesc event;
+    event.aType = type;
+    event.deviceId = id();
+    return event;
+}
+
+CameraDesc EvsVirtualCamera::describe(const std::string& id) const {
+    // Virtual cameras have no characteristics to report.
+    CameraDesc desc;
+    desc.id = id;
+    return desc;
+}
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
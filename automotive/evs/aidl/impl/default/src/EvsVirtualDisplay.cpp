@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "EvsVirtualDisplay"
+
+#include "EvsVirtualDisplay.h"
+
+#include <aidl/android/hardware/automotive/evs/EvsResult.h>
+#include <utils/Log.h>
+
+#include <string>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+using ::aidl::android::hardware::graphics::common::BufferUsage;
+using ::aidl::android::hardware::graphics::common::PixelFormat;
+using ::ndk::ScopedAStatus;
+
+namespace {
+
+ScopedAStatus toStatus(EvsResult result) {
+    return ScopedAStatus::fromServiceSpecificError(static_cast<int32_t>(result));
+}
+
+}  // namespace
+
+EvsVirtualDisplay::EvsVirtualDisplay(const VirtualCameraConfig::DisplayInfo& info)
+    : mInfo(info),
+      mBuffers(FrameLayout::make(PixelFormat::RGBA_8888, info.width, info.height),
+               "EvsDisplay" + std::to_string(info.id),
+               static_cast<BufferUsage>(static_cast<int64_t>(BufferUsage::GPU_RENDER_TARGET) |
+                                        static_cast<int64_t>(BufferUsage::COMPOSER_OVERLAY))) {}
+
+void EvsVirtualDisplay::forceShutdown() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mState = DisplayState::DEAD;
+}
+
+uint64_t EvsVirtualDisplay::framesShown() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mFramesShown;
+}
+
+std::vector<uint8_t> EvsVirtualDisplay::lastFrame() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mLastFrame;
+}
+
+ScopedAStatus EvsVirtualDisplay::getDisplayInfo(DisplayDesc* _aidl_return) {
+    *_aidl_return = {
+            .id = std::to_string(mInfo.id),
+            .width = mInfo.width,
+            .height = mInfo.height,
+            .orientation = Rotation::ROTATION_0,
+            .vendorFlags = 0,
+    };
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualDisplay::getDisplayState(DisplayState* _aidl_return) {
+    std::lock_guard<std::mutex> lock(mLock);
+    *_aidl_return = mState;
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualDisplay::getTargetBuffer(BufferDesc* _aidl_return) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mState == DisplayState::DEAD) {
+        return toStatus(EvsResult::OWNERSHIP_LOST);
+    }
+    // The single buffer is allocated once a client asks for it.
+    if (mBuffers.size() == 0 && !mBuffers.resize(1)) {
+        return toStatus(EvsResult::UNDERLYING_SERVICE_ERROR);
+    }
+    auto bufferId = mBuffers.acquire();
+    if (!bufferId) {
+        return toStatus(EvsResult::BUFFER_NOT_AVAILABLE);
+    }
+    *_aidl_return = mBuffers.describe(*bufferId);
+    _aidl_return->deviceId = std::to_string(mInfo.id);
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualDisplay::returnTargetBufferForDisplay(const BufferDesc& buffer) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mBuffers.release(buffer.bufferId)) {
+        return toStatus(EvsResult::INVALID_ARG);
+    }
+    if (mState == DisplayState::DEAD) {
+        return toStatus(EvsResult::OWNERSHIP_LOST);
+    }
+
+    if (mState == DisplayState::VISIBLE_ON_NEXT_FRAME) {
+        mState = DisplayState::VISIBLE;
+    }
+    if (mState == DisplayState::VISIBLE) {
+        const uint8_t* data = mBuffers.data(buffer.bufferId);
+        mLastFrame.assign(data, data + mBuffers.layout().size);
+        mFramesShown++;
+    }
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus EvsVirtualDisplay::setDisplayState(DisplayState state) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mState == DisplayState::DEAD) {
+        return toStatus(EvsResult::OWNERSHIP_LOST);
+    }
+    switch (state) {
+        case DisplayState::NOT_VISIBLE:
+        case DisplayState::VISIBLE_ON_NEXT_FRAME:
+        case DisplayState::VISIBLE:
+            mState = state;
+            return ScopedAStatus::ok();
+        default:
+            // Clients can neither open nor close the display this way.
+            ALOGE("Rejecting a request for display state %d", static_cast<int32_t>(state));
+            return toStatus(EvsResult::INVALID_ARG);
+    }
+}
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "EvsFrameSource"
+
+#include "FrameSource.h"
+
+#include <utils/Log.h>
+
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+using ::aidl::android::hardware::graphics::common::PixelFormat;
+
+namespace {
+
+// Colors for the colorbar test pattern in ABGR format
+constexpr uint32_t kColors[] = {
+        0xFFFFFFFF,  // white
+        0xFF00FFFF,  // yellow
+        0xFFFFFF00,  // cyan
+        0xFF00FF00,  // green
+        0xFFFF00FF,  // fuchsia
+        0xFF0000FF,  // red
+        0xFFFF0000,  // blue
+        0xFF000000,  // black
+};
+constexpr uint32_t kNumColors = sizeof(kColors) / sizeof(kColors[0]);
+
+constexpr char kY4mMagic[] = "YUV4MPEG2";
+constexpr char kY4mFrameMagic[] = "FRAME";
+
+int32_t align16(int32_t value) {
+    return (value + 15) & ~15;
+}
+
+struct Plane {
+    int32_t rows;
+    size_t packedRowBytes;
+    size_t rowBytes;
+};
+
+// The planes of a frame in the order they're stored, both packed and in buffers.
+std::vector<Plane> getPlanes(const FrameLayout& layout) {
+    const int32_t w = layout.width;
+    const int32_t h = layout.height;
+    const size_t stride = layout.stride;
+    switch (layout.format) {
+        case PixelFormat::RGBA_8888:
+            return {{h, w * 4u, stride * 4}};
+        case PixelFormat::YCBCR_422_I:
+            return {{h, w * 2u, stride * 2}};
+        case PixelFormat::YCRCB_420_SP:
+            return {{h, static_cast<size_t>(w), stride}, {h / 2, static_cast<size_t>(w), stride}};
+        case PixelFormat::YV12: {
+            const size_t chromaStride = align16(layout.stride / 2);
+            return {{h, static_cast<size_t>(w), stride},
+                    {h / 2, w / 2u, chromaStride},
+                    {h / 2, w / 2u, chromaStride}};
+        }
+        default:
+            return {};
+    }
+}
+
+// Copies the planes of a packed frame into a buffer, in the given order.
+void copyPlanes(const FrameLayout& layout, const uint8_t* packed, uint8_t* dst,
+                const std::vector<size_t>& order) {
+    const std::vector<Plane> planes = getPlanes(layout);
+    std::vector<const uint8_t*> srcPlanes;
+    for (const Plane& plane : planes) {
+        srcPlanes.push_back(packed);
+        packed += plane.rows * plane.packedRowBytes;
+    }
+    for (size_t i = 0; i < planes.size(); ++i) {
+        const Plane& plane = planes[i];
+        const uint8_t* src = srcPlanes[order[i]];
+        for (int32_t row = 0; row < plane.rows; ++row) {
+            memcpy(dst, src, plane.packedRowBytes);
+            src += plane.packedRowBytes;
+            dst += plane.rowBytes;
+        }
+    }
+}
+
+bool readFully(std::ifstream& file, uint8_t* dst, size_t size) {
+    file.read(reinterpret_cast<char*>(dst), size);
+    return static_cast<size_t>(file.gcount()) == size;
+}
+
+}  // namespace
+
+FrameLayout FrameLayout::make(PixelFormat format, int32_t width, int32_t height) {
+    FrameLayout layout = {.format = format, .width = width, .height = height};
+    if (width <= 0 || height <= 0) {
+        return layout;
+    }
+
+    switch (format) {
+        case PixelFormat::RGBA_8888:
+            layout.stride = width;
+            break;
+        case PixelFormat::YCBCR_422_I:
+            if (width % 2) return layout;
+            layout.stride = width;
+            break;
+        case PixelFormat::YCRCB_420_SP:
+        case PixelFormat::YV12:
+            if (width % 2 || height % 2) return layout;
+            layout.stride = align16(width);
+            break;
+        default:
+            return layout;
+    }
+    for (const Plane& plane : getPlanes(layout)) {
+        layout.size += plane.rows * plane.rowBytes;
+    }
+    return layout;
+}
+
+size_t FrameLayout::packedSize() const {
+    size_t size = 0;
+    for (const Plane& plane : getPlanes(*this)) {
+        size += plane.rows * plane.packedRowBytes;
+    }
+    return size;
+}
+
+int32_t FrameLayout::pixelSizeBytes() const {
+    switch (format) {
+        case PixelFormat::RGBA_8888:
+            return 4;
+        case PixelFormat::YCBCR_422_I:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+bool Y4mHeader::read(std::istream& in, Y4mHeader* header) {
+    std::string line;
+    if (!std::getline(in, line)) {
+        return false;
+    }
+    std::istringstream tokens(line);
+    std::string token;
+    if (!(tokens >> token) || token != kY4mMagic) {
+        return false;
+    }
+
+    Y4mHeader parsed = {.framerate = 30};
+    while (tokens >> token) {
+        const std::string value = token.substr(1);
+        switch (token[0]) {
+            case 'W':
+                parsed.width = atoi(value.c_str());
+                break;
+            case 'H':
+                parsed.height = atoi(value.c_str());
+                break;
+            case 'F': {
+                int num = 0;
+                int den = 0;
+                if (sscanf(value.c_str(), "%d:%d", &num, &den) != 2 || num <= 0 || den <= 0) {
+                    return false;
+                }
+                parsed.framerate = std::max(1, (num + den / 2) / den);
+                break;
+            }
+            case 'C':
+                if (value.compare(0, 3, "420") != 0) {
+                    ALOGE("Unsupported Y4M color space %s", value.c_str());
+                    return false;
+                }
+                break;
+            default:
+                // Interlacing, aspect ratio and extensions don't matter here.
+                break;
+        }
+    }
+    if (parsed.width <= 0 || parsed.height <= 0 || parsed.width % 2 || parsed.height % 2) {
+        return false;
+    }
+    *header = parsed;
+    return true;
+}
+
+std::unique_ptr<FrameSource> FrameSource::create(const VirtualCameraConfig::CameraInfo& info) {
+    switch (info.source) {
+        case VirtualCameraConfig::SourceType::PATTERN:
+            return std::make_unique<PatternFrameSource>(info.pattern, info.width, info.height,
+                                                        info.framerate);
+        case VirtualCameraConfig::SourceType::RAW: {
+            FrameLayout layout = FrameLayout::make(info.format, info.width, info.height);
+            std::ifstream file(info.path, std::ios::binary);
+            if (layout.size == 0 || !file) {
+                ALOGE("Failed to open %s for camera %s", info.path.c_str(), info.id.c_str());
+                return nullptr;
+            }
+            return std::make_unique<RawFileFrameSource>(layout, info.framerate, std::move(file));
+        }
+        case VirtualCameraConfig::SourceType::Y4M: {
+            std::ifstream file(info.path, std::ios::binary);
+            Y4mHeader header;
+            if (!file || !Y4mHeader::read(file, &header)) {
+                ALOGE("Failed to open %s for camera %s", info.path.c_str(), info.id.c_str());
+                return nullptr;
+            }
+            return std::make_unique<Y4mFileFrameSource>(header, info.framerate, std::move(file));
+        }
+    }
+    return nullptr;
+}
+
+PatternFrameSource::PatternFrameSource(VirtualCameraConfig::Pattern pattern, int32_t width,
+                                       int32_t height, int32_t framerate)
+    : FrameSource(FrameLayout::make(PixelFormat::RGBA_8888, width, height), framerate),
+      mPattern(pattern) {}
+
+bool PatternFrameSource::nextFrame(uint8_t* dst) {
+    uint32_t* pixels = reinterpret_cast<uint32_t*>(dst);
+    const uint32_t width = mLayout.width;
+    const uint32_t height = mLayout.height;
+    for (uint32_t row = 0; row < height; row++) {
+        for (uint32_t col = 0; col < width; col++) {
+            if (mPattern == VirtualCameraConfig::Pattern::COLOR_BARS) {
+                pixels[col] = kColors[((col + mFrameCount) % width) * kNumColors / width];
+            } else {
+                const uint32_t r = col * 255 / width;
+                const uint32_t g = row * 255 / height;
+                const uint32_t b = (mFrameCount * 4) & 0xFF;
+                pixels[col] = 0xFF000000 | (b << 16) | (g << 8) | r;
+            }
+        }
+        pixels += mLayout.stride;
+    }
+    mFrameCount++;
+    return true;
+}
+
+RawFileFrameSource::RawFileFrameSource(FrameLayout layout, int32_t framerate, std::ifstream file)
+    : FrameSource(std::move(layout), framerate),
+      mFile(std::move(file)),
+      mPacked(new uint8_t[mLayout.packedSize()]) {}
+
+bool RawFileFrameSource::nextFrame(uint8_t* dst) {
+    const size_t size = mLayout.packedSize();
+    if (!readFully(mFile, mPacked.get(), size)) {
+        // Loop back to the first frame.
+        mFile.clear();
+        mFile.seekg(0);
+        if (!readFully(mFile, mPacked.get(), size)) {
+            ALOGE("File holds less than one frame");
+            return false;
+        }
+    }
+    std::vector<size_t> order(getPlanes(mLayout).size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    copyPlanes(mLayout, mPacked.get(), dst, order);
+    return true;
+}
+
+Y4mFileFrameSource::Y4mFileFrameSource(const Y4mHeader& header, int32_t framerate,
+                                       std::ifstream file)
+    : FrameSource(FrameLayout::make(PixelFormat::YV12, header.width, header.height),
+                  framerate > 0 ? framerate : header.framerate),
+      mFile(std::move(file)),
+      mFirstFrame(mFile.tellg()),
+      mPacked(new uint8_t[mLayout.packedSize()]) {}
+
+bool Y4mFileFrameSource::nextFrame(uint8_t* dst) {
+    const size_t size = mLayout.packedSize();
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        std::string frameHeader;
+        if (std::getline(mFile, frameHeader) &&
+            frameHeader.compare(0, strlen(kY4mFrameMagic), kY4mFrameMagic) == 0 &&
+            readFully(mFile, mPacked.get(), size)) {
+            // Y4M stores Cb before Cr, while YV12 puts Cr first.
+            copyPlanes(mLayout, mPacked.get(), dst, {0, 2, 1});
+            return true;
+        }
+        // Loop back to the first frame.
+        mFile.clear();
+        mFile.seekg(mFirstFrame);
+    }
+    ALOGE("Failed to read a Y4M frame");
+    return false;
+}
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
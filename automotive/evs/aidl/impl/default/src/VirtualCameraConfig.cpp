@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "VirtualCameraConfig"
+
+#include "VirtualCameraConfig.h"
+
+#include "FrameSource.h"
+
+#include <utils/Log.h>
+
+#include <fstream>
+#include <sstream>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+using ::aidl::android::hardware::graphics::common::PixelFormat;
+
+namespace {
+
+bool parseFormat(const std::string& name, PixelFormat* format) {
+    static const std::map<std::string, PixelFormat> kFormats = {
+            {"RGBA_8888", PixelFormat::RGBA_8888},
+            {"YCRCB_420_SP", PixelFormat::YCRCB_420_SP},
+            {"YCBCR_422_I", PixelFormat::YCBCR_422_I},
+            {"YV12", PixelFormat::YV12},
+    };
+    auto it = kFormats.find(name);
+    if (it == kFormats.end()) {
+        return false;
+    }
+    *format = it->second;
+    return true;
+}
+
+bool parseCamera(std::istringstream& tokens, VirtualCameraConfig::CameraInfo* info) {
+    std::string source;
+    if (!(tokens >> info->id >> source)) {
+        return false;
+    }
+
+    if (source == "pattern") {
+        info->source = VirtualCameraConfig::SourceType::PATTERN;
+        if (!(tokens >> info->width >> info->height >> info->framerate)) {
+            return false;
+        }
+        std::string pattern;
+        if (tokens >> pattern) {
+            if (pattern == "colorbars") {
+                info->pattern = VirtualCameraConfig::Pattern::COLOR_BARS;
+            } else if (pattern == "gradient") {
+                info->pattern = VirtualCameraConfig::Pattern::GRADIENT;
+            } else {
+                return false;
+            }
+        }
+    } else if (source == "raw") {
+        info->source = VirtualCameraConfig::SourceType::RAW;
+        std::string format;
+        if (!(tokens >> info->path >> info->width >> info->height >> format >>
+              info->framerate) ||
+            !parseFormat(format, &info->format) ||
+            FrameLayout::make(info->format, info->width, info->height).size == 0) {
+            return false;
+        }
+    } else if (source == "y4m") {
+        info->source = VirtualCameraConfig::SourceType::Y4M;
+        info->format = PixelFormat::YV12;
+        info->framerate = 0;
+        if (!(tokens >> info->path)) {
+            return false;
+        }
+        tokens >> info->framerate;
+
+        std::ifstream file(info->path, std::ios::binary);
+        Y4mHeader header;
+        if (!Y4mHeader::read(file, &header)) {
+            ALOGE("Failed to read the Y4M header of %s", info->path.c_str());
+            return false;
+        }
+        info->width = header.width;
+        info->height = header.height;
+        if (info->framerate <= 0) {
+            info->framerate = header.framerate;
+        }
+    } else {
+        return false;
+    }
+    return info->width > 0 && info->height > 0 && info->framerate > 0;
+}
+
+}  // namespace
+
+VirtualCameraConfig VirtualCameraConfig::defaultConfig() {
+    VirtualCameraConfig config;
+    for (const auto& [id, pattern] : {std::make_pair("/dev/video10", Pattern::COLOR_BARS),
+                                      std::make_pair("/dev/video11", Pattern::GRADIENT)}) {
+        CameraInfo& info = config.cameras[id];
+        info.id = id;
+        info.pattern = pattern;
+        info.width = 640;
+        info.height = 360;
+    }
+    config.groups["group0"] = {.id = "group0", .members = {"/dev/video10", "/dev/video11"}};
+    config.displays[0] = {.id = 0, .width = 1280, .height = 720};
+    return config;
+}
+
+bool parseVirtualCameraConfig(std::istream& in, VirtualCameraConfig* config) {
+    VirtualCameraConfig parsed;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        std::istringstream tokens(line);
+        std::string keyword;
+        if (!(tokens >> keyword) || keyword[0] == '#') {
+            continue;
+        }
+
+        bool valid = false;
+        if (keyword == "camera") {
+            VirtualCameraConfig::CameraInfo info;
+            valid = parseCamera(tokens, &info) && !parsed.cameras.count(info.id) &&
+                    !parsed.groups.count(info.id);
+            if (valid) {
+                parsed.cameras[info.id] = info;
+            }
+        } else if (keyword == "group") {
+            VirtualCameraConfig::GroupInfo info;
+            valid = static_cast<bool>(tokens >> info.id) && !parsed.cameras.count(info.id) &&
+                    !parsed.groups.count(info.id);
+            std::string member;
+            while (valid && tokens >> member) {
+                valid = parsed.cameras.count(member) > 0;
+                info.members.push_back(member);
+            }
+            if (valid && !info.members.empty()) {
+                parsed.groups[info.id] = info;
+            } else {
+                valid = false;
+            }
+        } else if (keyword == "display") {
+            int port = -1;
+            VirtualCameraConfig::DisplayInfo info;
+            valid = static_cast<bool>(tokens >> port >> info.width >> info.height) &&
+                    port >= 0 && port <= UINT8_MAX && info.width > 0 && info.height > 0;
+            if (valid) {
+                info.id = static_cast<uint8_t>(port);
+                parsed.displays[info.id] = info;
+            }
+        }
+
+        if (!valid) {
+            ALOGE("Malformed virtual camera configuration at line %d: %s", lineNumber,
+                  line.c_str());
+            return false;
+        }
+    }
+    *config = std::move(parsed);
+    return true;
+}
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "VirtualCameraDevice"
+
+#include "VirtualCameraDevice.h"
+
+#include <utils/Log.h>
+#include <utils/SystemClock.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+namespace {
+
+using ::android::base::ScopedLockAssertion;
+
+constexpr ParameterRange kParameterRange = {.min = 0, .max = 255, .step = 1};
+
+// The device whose frames the current thread is delivering, if any.
+thread_local const VirtualCameraDevice* tDeliveringDevice = nullptr;
+
+// Removes expired clients and the given one, if any, and returns whether the latter was found.
+bool pruneClients(std::vector<std::weak_ptr<VirtualCameraDevice::Client>>* clients,
+                  const VirtualCameraDevice::Client* client) {
+    bool found = false;
+    auto it = std::remove_if(clients->begin(), clients->end(), [&](const auto& weak) {
+        auto strong = weak.lock();
+        if (strong == nullptr) {
+            return true;
+        }
+        if (strong.get() == client) {
+            found = true;
+            return true;
+        }
+        return false;
+    });
+    clients->erase(it, clients->end());
+    return found;
+}
+
+// Members of a logical camera are captured together, at the rate of the slowest one.
+int32_t slowestFramerate(const std::vector<std::unique_ptr<FrameSource>>& sources) {
+    int32_t framerate = sources[0]->framerate();
+    for (const auto& source : sources) {
+        framerate = std::min(framerate, source->framerate());
+    }
+    return std::max(1, framerate);
+}
+
+}  // namespace
+
+std::shared_ptr<VirtualCameraDevice> VirtualCameraDevice::create(
+        const std::string& id, const std::vector<VirtualCameraConfig::CameraInfo>& members) {
+    std::vector<std::unique_ptr<FrameSource>> sources;
+    for (const auto& member : members) {
+        auto source = FrameSource::create(member);
+        if (source == nullptr || source->layout().size == 0) {
+            ALOGE("Failed to open the frame source of %s", member.id.c_str());
+            return nullptr;
+        }
+        sources.push_back(std::move(source));
+    }
+    if (sources.empty()) {
+        return nullptr;
+    }
+    // The constructor is private, so std::make_shared can't be used.
+    return std::shared_ptr<VirtualCameraDevice>(
+            new VirtualCameraDevice(id, members, std::move(sources)));
+}
+
+VirtualCameraDevice::VirtualCameraDevice(
+        const std::string& id, const std::vector<VirtualCameraConfig::CameraInfo>& members,
+        std::vector<std::unique_ptr<FrameSource>> sources)
+    : mId(id),
+      mIsLogical(members.size() != 1 || members[0].id != id),
+      mMembers(members),
+      mFramerate(slowestFramerate(sources)),
+      mSources(std::move(sources)) {
+    for (const auto& source : mSources) {
+        mFrames.emplace_back(new uint8_t[source->layout().size]());
+    }
+    for (CameraParam param : supportedParameters()) {
+        mParameters[param] = param == CameraParam::SHARPNESS ? kParameterRange.min
+                                                             : kParameterRange.max / 2;
+    }
+}
+
+VirtualCameraDevice::~VirtualCameraDevice() {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mCaptureThread.joinable()) {
+        // Only the capture thread itself can release the last reference while it's running.
+        mCaptureThread.detach();
+    }
+}
+
+int32_t VirtualCameraDevice::memberIndex(const std::string& memberId) const {
+    for (size_t i = 0; i < mMembers.size(); ++i) {
+        if (mMembers[i].id == memberId) {
+            return static_cast<int32_t>(i);
+        }
+    }
+    return -1;
+}
+
+void VirtualCameraDevice::addClient(const std::shared_ptr<Client>& client) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mClients.push_back(client);
+}
+
+void VirtualCameraDevice::removeClient(const Client* client) {
+    stopStreaming(client);
+    unsetPrimaryClient(client);
+
+    std::lock_guard<std::mutex> lock(mLock);
+    pruneClients(&mClients, client);
+}
+
+void VirtualCameraDevice::startStreaming(const std::shared_ptr<Client>& client) {
+    std::lock_guard<std::mutex> lock(mLock);
+    pruneClients(&mStreamingClients, client.get());
+    mStreamingClients.push_back(client);
+    if (!mCaptureThread.joinable()) {
+        // The thread keeps the device alive until it exits.
+        mCaptureThread = std::thread([self = shared_from_this(), generation = mGeneration] {
+            self->captureLoop(generation);
+        });
+    }
+}
+
+void VirtualCameraDevice::stopStreaming(const Client* client) {
+    // This may be a capture thread that has already been replaced by a newer one, if the client
+    // restarted streaming from within a callback. Either way, it holds the delivery lock, and
+    // a newer capture thread waits for it before delivering anything.
+    const bool onCaptureThread = tDeliveringDevice == this;
+    std::thread captureThread;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (!pruneClients(&mStreamingClients, client)) {
+            return;
+        }
+        if (mStreamingClients.empty()) {
+            mGeneration++;
+            captureThread = std::move(mCaptureThread);
+            mWakeUp.notify_all();
+        }
+    }
+
+    if (onCaptureThread) {
+        // A client stopped from within a callback, so joining would deadlock. Frames already
+        // taken for it are still delivered, and the thread exits on its own if nobody streams
+        // anymore.
+        if (captureThread.joinable()) {
+            captureThread.detach();
+        }
+        return;
+    }
+    if (captureThread.joinable()) {
+        captureThread.join();
+    } else {
+        // Wait for a delivery that may still include the client.
+        std::lock_guard<std::mutex> lock(mDeliveryLock);
+    }
+}
+
+bool VirtualCameraDevice::setPrimaryClient(const std::shared_ptr<Client>& client) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto primary = mPrimaryClient.lock();
+    if (primary != nullptr && primary != client) {
+        return false;
+    }
+    mPrimaryClient = client;
+    return true;
+}
+
+void VirtualCameraDevice::forcePrimaryClient(const std::shared_ptr<Client>& client) {
+    std::shared_ptr<Client> previous;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        previous = mPrimaryClient.lock();
+        mPrimaryClient = client;
+    }
+    if (previous != nullptr && previous != client) {
+        notify({previous}, EvsEventType::MASTER_RELEASED);
+    }
+}
+
+bool VirtualCameraDevice::unsetPrimaryClient(const Client* client) {
+    std::vector<std::shared_ptr<Client>> others;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mPrimaryClient.lock().get() != client) {
+            return false;
+        }
+        mPrimaryClient.reset();
+        for (auto& other : clientsLocked()) {
+            if (other.get() != client) {
+                others.push_back(std::move(other));
+            }
+        }
+    }
+    // Other clients may now claim the primary role.
+    notify(others, EvsEventType::MASTER_RELEASED);
+    return true;
+}
+
+bool VirtualCameraDevice::isPrimaryClient(const Client* client) const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mPrimaryClient.lock().get() == client;
+}
+
+const std::vector<CameraParam>& VirtualCameraDevice::supportedParameters() {
+    static const std::vector<CameraParam> kParameters = {
+            CameraParam::BRIGHTNESS,
+            CameraParam::CONTRAST,
+            CameraParam::SHARPNESS,
+    };
+    return kParameters;
+}
+
+bool VirtualCameraDevice::getParameterRange(CameraParam id, ParameterRange* range) {
+    const auto& params = supportedParameters();
+    if (std::find(params.begin(), params.end(), id) == params.end()) {
+        return false;
+    }
+    *range = kParameterRange;
+    return true;
+}
+
+bool VirtualCameraDevice::getParameter(CameraParam id, int32_t* value) const {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mParameters.find(id);
+    if (it == mParameters.end()) {
+        return false;
+    }
+    *value = it->second;
+    return true;
+}
+
+bool VirtualCameraDevice::setParameter(CameraParam id, int32_t value, int32_t* effectiveValue) {
+    std::vector<std::shared_ptr<Client>> clients;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        auto it = mParameters.find(id);
+        if (it == mParameters.end()) {
+            return false;
+        }
+        it->second = std::clamp(value, kParameterRange.min, kParameterRange.max);
+        *effectiveValue = it->second;
+        clients = clientsLocked();
+    }
+    notify(clients, EvsEventType::PARAMETER_CHANGED,
+           {static_cast<int32_t>(id), *effectiveValue});
+    return true;
+}
+
+void VirtualCameraDevice::captureLoop(uint64_t generation) {
+    using std::chrono::steady_clock;
+    const auto period = std::chrono::duration_cast<steady_clock::duration>(
+            std::chrono::seconds(1)) / mFramerate;
+
+    std::vector<const uint8_t*> frames;
+    for (const auto& frame : mFrames) {
+        frames.push_back(frame.get());
+    }
+
+    auto nextFrameTime = steady_clock::now();
+    while (true) {
+        for (size_t i = 0; i < mSources.size(); ++i) {
+            if (!mSources[i]->nextFrame(mFrames[i].get())) {
+                // Clients get the previous frame again.
+                ALOGW("Failed to produce a frame of %s", mMembers[i].id.c_str());
+            }
+        }
+        const int64_t timestamp = ::android::elapsedRealtimeNano() / 1000;
+
+        std::vector<std::shared_ptr<Client>> clients;
+        {
+            // Clients are collected with the delivery lock held, so that a client which stopped
+            // streaming only has to wait for the ongoing delivery.
+            std::lock_guard<std::mutex> deliveryLock(mDeliveryLock);
+            {
+                std::lock_guard<std::mutex> lock(mLock);
+                if (mGeneration != generation) {
+                    return;
+                }
+                pruneClients(&mStreamingClients, nullptr);
+                if (mStreamingClients.empty()) {
+                    // All streaming clients went away without stopping.
+                    mGeneration++;
+                    mCaptureThread.detach();
+                    return;
+                }
+                for (const auto& weak : mStreamingClients) {
+                    clients.push_back(weak.lock());
+                }
+            }
+            tDeliveringDevice = this;
+            for (const auto& client : clients) {
+                if (client != nullptr) {
+                    client->onFrames(frames, timestamp);
+                }
+            }
+            tDeliveringDevice = nullptr;
+        }
+        // Releasing the clients may destroy them, which must not happen with a lock held.
+        clients.clear();
+
+        nextFrameTime += period;
+        std::unique_lock<std::mutex> lock(mLock);
+        ScopedLockAssertion lockAssertion(mLock);
+        if (mWakeUp.wait_until(lock, nextFrameTime, [this, generation] {
+                ScopedLockAssertion lockAssertion(mLock);
+                return mGeneration != generation;
+            })) {
+            return;
+        }
+        const auto now = steady_clock::now();
+        if (now > nextFrameTime + period) {
+            // Skip the frames that were missed rather than producing a burst of them.
+            nextFrameTime = now;
+        }
+    }
+}
+
+std::vector<std::shared_ptr<VirtualCameraDevice::Client>> VirtualCameraDevice::clientsLocked()
+        const {
+    std::vector<std::shared_ptr<Client>> clients;
+    for (const auto& weak : mClients) {
+        if (auto client = weak.lock(); client != nullptr) {
+            clients.push_back(std::move(client));
+        }
+    }
+    return clients;
+}
+
+void VirtualCameraDevice::notify(const std::vector<std::shared_ptr<Client>>& clients,
+                                 EvsEventType type, std::vector<int32_t> payload) {
+    EvsEventDesc event = {.aType = type, .deviceId = mId, .payload = std::move(payload)};
+    for (const auto& client : clients) {
+        client->onEvent(event);
+    }
+}
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
@@ -24,6 +24,14 @@
 
 using ::aidl::android::hardware::automotive::evs::implementation::DefaultEvsEnumerator;
 
+namespace {
+
+// Frames are delivered from capture threads, but clients call back into cameras, e.g. to return
+// buffers, while others open or close cameras.
+constexpr uint32_t kMaxBinderThreadCount = 4;
+
+}  // namespace
+
 int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[]) {
     std::shared_ptr<DefaultEvsEnumerator> vhal = ndk::SharedRefBase::make<DefaultEvsEnumerator>();
 
@@ -35,7 +43,7 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[]) {
         return 1;
     }
 
-    if (!ABinderProcess_setThreadPoolMaxThreadCount(1)) {
+    if (!ABinderProcess_setThreadPoolMaxThreadCount(kMaxBinderThreadCount)) {
         ALOGE("%s", "failed to set thread pool max thread count");
         return 1;
     }
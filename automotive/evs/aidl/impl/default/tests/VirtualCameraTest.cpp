@@ -0,0 +1,633 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BufferPool.h"
+#include "DefaultEvsEnumerator.h"
+#include "FrameSource.h"
+#include "VirtualCameraConfig.h"
+
+#include <aidl/android/hardware/automotive/evs/BnEvsCameraStream.h>
+#include <aidl/android/hardware/automotive/evs/EvsResult.h>
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include <sys/mman.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+namespace {
+
+using ::aidl::android::hardware::graphics::common::BufferUsage;
+using ::aidl::android::hardware::graphics::common::PixelFormat;
+using ::ndk::ScopedAStatus;
+
+constexpr auto kTimeout = std::chrono::seconds(5);
+
+constexpr char kConfig[] = R"(
+# Small cameras at a high rate keep the tests fast.
+camera front pattern 64 32 60 colorbars
+camera rear pattern 32 16 60 gradient
+group surround front rear
+display 2 64 32
+)";
+
+int32_t errorOf(const ScopedAStatus& status) {
+    return status.getServiceSpecificError();
+}
+
+int32_t codeOf(EvsResult result) {
+    return static_cast<int32_t>(result);
+}
+
+VirtualCameraConfig testConfig() {
+    std::istringstream in(kConfig);
+    VirtualCameraConfig config;
+    EXPECT_TRUE(parseVirtualCameraConfig(in, &config));
+    return config;
+}
+
+// Buffer descriptions can't be copied, as they own file descriptors. The copy is good for
+// checking and returning frames.
+std::vector<BufferDesc> copyOf(const std::vector<BufferDesc>& buffers) {
+    std::vector<BufferDesc> copies;
+    for (const auto& buffer : buffers) {
+        BufferDesc& copy = copies.emplace_back();
+        copy.bufferId = buffer.bufferId;
+        copy.deviceId = buffer.deviceId;
+        copy.timestamp = buffer.timestamp;
+    }
+    return copies;
+}
+
+class FrameReceiver : public BnEvsCameraStream {
+  public:
+    // Frames are returned right away unless the receiver holds on to them.
+    explicit FrameReceiver(bool returnFrames = true) : mReturnFrames(returnFrames) {}
+
+    void setCamera(const std::shared_ptr<IEvsCamera>& camera) { mCamera = camera; }
+
+    ScopedAStatus deliverFrame(const std::vector<BufferDesc>& buffers) override {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mFrames.push_back(copyOf(buffers));
+        }
+        mCondition.notify_all();
+        if (auto camera = mCamera.lock(); camera != nullptr && mReturnFrames) {
+            camera->doneWithFrame(copyOf(buffers));
+        }
+        return ScopedAStatus::ok();
+    }
+
+    ScopedAStatus notify(const EvsEventDesc& event) override {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mEvents.push_back(event);
+        }
+        mCondition.notify_all();
+        return ScopedAStatus::ok();
+    }
+
+    bool waitForFrames(size_t count) {
+        std::unique_lock<std::mutex> lock(mLock);
+        return mCondition.wait_for(lock, kTimeout, [this, count] { return mFrames.size() >= count; });
+    }
+
+    bool waitForEvent(EvsEventType type, size_t count = 1) {
+        std::unique_lock<std::mutex> lock(mLock);
+        return mCondition.wait_for(lock, kTimeout,
+                                   [this, type, count] { return countLocked(type) >= count; });
+    }
+
+    size_t frameCount() {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mFrames.size();
+    }
+
+    std::vector<BufferDesc> frame(size_t index) {
+        std::lock_guard<std::mutex> lock(mLock);
+        return copyOf(mFrames[index]);
+    }
+
+    size_t eventCount(EvsEventType type) {
+        std::lock_guard<std::mutex> lock(mLock);
+        return countLocked(type);
+    }
+
+    std::vector<EvsEventDesc> events() {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mEvents;
+    }
+
+  private:
+    size_t countLocked(EvsEventType type) {
+        size_t count = 0;
+        for (const auto& event : mEvents) {
+            count += event.aType == type;
+        }
+        return count;
+    }
+
+    const bool mReturnFrames;
+    std::weak_ptr<IEvsCamera> mCamera;
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    std::vector<std::vector<BufferDesc>> mFrames;
+    std::vector<EvsEventDesc> mEvents;
+};
+
+// Stops its stream from within the first frame callback, starts it again and stops it again.
+class RestartingReceiver : public FrameReceiver {
+  public:
+    void setRestartedCamera(const std::shared_ptr<IEvsCamera>& camera) {
+        mRestartedCamera = camera;
+    }
+
+    ScopedAStatus deliverFrame(const std::vector<BufferDesc>& buffers) override {
+        ScopedAStatus status = FrameReceiver::deliverFrame(buffers);
+        if (auto camera = mRestartedCamera.lock(); camera != nullptr && !mRestarted) {
+            mRestarted = true;
+            EXPECT_TRUE(camera->stopVideoStream().isOk());
+            EXPECT_TRUE(camera->startVideoStream(ref<RestartingReceiver>()).isOk());
+            EXPECT_TRUE(camera->stopVideoStream().isOk());
+        }
+        return status;
+    }
+
+  private:
+    std::weak_ptr<IEvsCamera> mRestartedCamera;
+    // Only used by the capture thread.
+    bool mRestarted = false;
+};
+
+class VirtualCameraTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mEnumerator = ::ndk::SharedRefBase::make<DefaultEvsEnumerator>(testConfig());
+    }
+
+    std::shared_ptr<IEvsCamera> openCamera(const std::string& id) {
+        std::shared_ptr<IEvsCamera> camera;
+        EXPECT_TRUE(mEnumerator->openCamera(id, {}, &camera).isOk());
+        EXPECT_NE(camera, nullptr);
+        return camera;
+    }
+
+    std::shared_ptr<FrameReceiver> startStream(const std::shared_ptr<IEvsCamera>& camera,
+                                               bool returnFrames = true) {
+        auto receiver = ::ndk::SharedRefBase::make<FrameReceiver>(returnFrames);
+        receiver->setCamera(camera);
+        EXPECT_TRUE(camera->startVideoStream(receiver).isOk());
+        return receiver;
+    }
+
+    std::shared_ptr<IEvsEnumerator> mEnumerator;
+};
+
+TEST(VirtualCameraConfigTest, ParsesDevices) {
+    VirtualCameraConfig config = testConfig();
+    ASSERT_EQ(config.cameras.size(), 2u);
+    EXPECT_EQ(config.cameras["rear"].pattern, VirtualCameraConfig::Pattern::GRADIENT);
+    EXPECT_EQ(config.cameras["rear"].framerate, 60);
+    ASSERT_EQ(config.groups.size(), 1u);
+    EXPECT_EQ(config.groups["surround"].members, (std::vector<std::string>{"front", "rear"}));
+    ASSERT_EQ(config.displays.size(), 1u);
+    EXPECT_EQ(config.displays[2].width, 64);
+}
+
+TEST(VirtualCameraConfigTest, RejectsMalformedInput) {
+    for (const char* input : {
+                 "camera front pattern 64 32",
+                 "camera front raw /dev/null 63 32 YV12 30",
+                 "camera front pattern 64 32 30 stripes",
+                 "group surround front",
+                 "display 256 64 32",
+                 "camera front pattern 64 32 30\ncamera front pattern 64 32 30",
+         }) {
+        std::istringstream in(input);
+        VirtualCameraConfig config = VirtualCameraConfig::defaultConfig();
+        EXPECT_FALSE(parseVirtualCameraConfig(in, &config)) << input;
+        EXPECT_EQ(config.cameras.size(), 2u) << input;
+    }
+}
+
+TEST(FrameSourceTest, PadsRowsOfRawFrames) {
+    TemporaryDir dir;
+    const std::string path = std::string(dir.path) + "/frames.nv21";
+    FrameLayout layout = FrameLayout::make(PixelFormat::YCRCB_420_SP, 20, 4);
+    ASSERT_EQ(layout.stride, 32);
+    ASSERT_EQ(layout.packedSize(), 20u * 4 * 3 / 2);
+    {
+        // Two frames, the second one brighter.
+        std::ofstream file(path, std::ios::binary);
+        file << std::string(layout.packedSize(), '\x10') << std::string(layout.packedSize(), '\x20');
+    }
+    VirtualCameraConfig::CameraInfo info;
+    info.id = "raw";
+    info.source = VirtualCameraConfig::SourceType::RAW;
+    info.path = path;
+    info.width = 20;
+    info.height = 4;
+    info.format = PixelFormat::YCRCB_420_SP;
+    auto source = FrameSource::create(info);
+    ASSERT_NE(source, nullptr);
+
+    std::vector<uint8_t> frame(layout.size, 0);
+    for (uint8_t expected : {0x10, 0x20, 0x10}) {
+        ASSERT_TRUE(source->nextFrame(frame.data()));
+        // The second row starts after the padding of the first.
+        EXPECT_EQ(frame[19], expected);
+        EXPECT_EQ(frame[20], 0);
+        EXPECT_EQ(frame[32], expected);
+        // The chroma plane follows the luma rows.
+        EXPECT_EQ(frame[4 * 32], expected);
+    }
+}
+
+TEST(FrameSourceTest, ReordersChromaOfY4mFrames) {
+    TemporaryDir dir;
+    const std::string path = std::string(dir.path) + "/video.y4m";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "YUV4MPEG2 W4 H2 F15:1 C420jpeg\n";
+        file << "FRAME\n" << std::string(8, 'y') << "uuvv";
+    }
+    VirtualCameraConfig::CameraInfo info;
+    info.source = VirtualCameraConfig::SourceType::Y4M;
+    info.path = path;
+    info.framerate = 0;
+    auto source = FrameSource::create(info);
+    ASSERT_NE(source, nullptr);
+    EXPECT_EQ(source->framerate(), 15);
+
+    const FrameLayout& layout = source->layout();
+    ASSERT_EQ(layout.format, PixelFormat::YV12);
+    ASSERT_EQ(layout.stride, 16);
+    std::vector<uint8_t> frame(layout.size, 0);
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_TRUE(source->nextFrame(frame.data()));
+        EXPECT_EQ(frame[16], 'y');
+        // Cr comes first in YV12, and chroma rows have a stride of 16 too.
+        EXPECT_EQ(frame[2 * 16], 'v');
+        EXPECT_EQ(frame[3 * 16], 'u');
+    }
+}
+
+TEST(BufferPoolTest, ShrinksOnceBuffersAreReturned) {
+    BufferPool pool(FrameLayout::make(PixelFormat::RGBA_8888, 8, 8), "test",
+                    BufferUsage::CPU_READ_OFTEN);
+    EXPECT_FALSE(pool.resize(-1));
+    EXPECT_FALSE(pool.resize(BufferPool::kMaxBuffers + 1));
+    ASSERT_TRUE(pool.resize(3));
+
+    auto first = pool.acquire();
+    auto second = pool.acquire();
+    ASSERT_TRUE(first && second);
+    ASSERT_TRUE(pool.resize(1));
+    // Only the free buffer goes right away.
+    EXPECT_EQ(pool.size(), 2);
+    EXPECT_FALSE(pool.acquire());
+
+    EXPECT_TRUE(pool.release(*first));
+    EXPECT_EQ(pool.size(), 1);
+    EXPECT_FALSE(pool.release(*first));
+    EXPECT_TRUE(pool.release(*second));
+    EXPECT_EQ(pool.size(), 1);
+    EXPECT_TRUE(pool.acquire());
+}
+
+TEST(BufferPoolTest, ShrinksToNoBuffers) {
+    BufferPool pool(FrameLayout::make(PixelFormat::RGBA_8888, 8, 8), "test",
+                    BufferUsage::CPU_READ_OFTEN);
+    ASSERT_TRUE(pool.resize(2));
+    ASSERT_TRUE(pool.resize(0));
+    EXPECT_EQ(pool.size(), 0);
+    EXPECT_FALSE(pool.acquire());
+}
+
+TEST(BufferPoolTest, DescribesSharedMemory) {
+    BufferPool pool(FrameLayout::make(PixelFormat::RGBA_8888, 8, 8), "test",
+                    BufferUsage::CPU_READ_OFTEN);
+    ASSERT_TRUE(pool.resize(1));
+    auto id = pool.acquire();
+    ASSERT_TRUE(id);
+    pool.data(*id)[5] = 42;
+
+    BufferDesc desc = pool.describe(*id);
+    EXPECT_EQ(desc.bufferId, *id);
+    EXPECT_EQ(desc.buffer.description.stride, 8);
+    EXPECT_EQ(desc.pixelSizeBytes, 4);
+    ASSERT_EQ(desc.buffer.handle.fds.size(), 1u);
+    void* data = mmap(nullptr, pool.layout().size, PROT_READ, MAP_SHARED,
+                      desc.buffer.handle.fds[0].get(), 0);
+    ASSERT_NE(data, MAP_FAILED);
+    EXPECT_EQ(static_cast<uint8_t*>(data)[5], 42);
+    munmap(data, pool.layout().size);
+}
+
+TEST_F(VirtualCameraTest, ListsCamerasAndStreams) {
+    std::vector<CameraDesc> cameras;
+    ASSERT_TRUE(mEnumerator->getCameraList(&cameras).isOk());
+    std::vector<std::string> ids;
+    for (const auto& camera : cameras) {
+        ids.push_back(camera.id);
+    }
+    EXPECT_EQ(ids, (std::vector<std::string>{"front", "rear", "surround"}));
+
+    std::vector<Stream> streams;
+    ASSERT_TRUE(mEnumerator->getStreamList(cameras[2], &streams).isOk());
+    ASSERT_EQ(streams.size(), 2u);
+    EXPECT_EQ(streams[1].width, 32);
+    EXPECT_EQ(streams[1].framerate, 60);
+
+    std::vector<uint8_t> displays;
+    ASSERT_TRUE(mEnumerator->getDisplayIdList(&displays).isOk());
+    EXPECT_EQ(displays, std::vector<uint8_t>{2});
+}
+
+TEST_F(VirtualCameraTest, OpensOnlyKnownCamerasAndStreams) {
+    std::shared_ptr<IEvsCamera> camera;
+    EXPECT_EQ(errorOf(mEnumerator->openCamera("side", {}, &camera)),
+              codeOf(EvsResult::INVALID_ARG));
+
+    Stream stream;
+    stream.width = 640;
+    stream.height = 480;
+    stream.format = PixelFormat::RGBA_8888;
+    ASSERT_TRUE(mEnumerator->openCamera("front", stream, &camera).isOk());
+    EXPECT_EQ(camera, nullptr);
+
+    stream.width = 64;
+    stream.height = 32;
+    ASSERT_TRUE(mEnumerator->openCamera("front", stream, &camera).isOk());
+    ASSERT_NE(camera, nullptr);
+    EXPECT_TRUE(mEnumerator->closeCamera(camera).isOk());
+    EXPECT_EQ(errorOf(mEnumerator->closeCamera(camera)), codeOf(EvsResult::INVALID_ARG));
+}
+
+TEST_F(VirtualCameraTest, StreamsFrames) {
+    auto camera = openCamera("front");
+    ASSERT_TRUE(camera->setMaxFramesInFlight(3).isOk());
+    auto receiver = startStream(camera);
+    EXPECT_EQ(errorOf(camera->startVideoStream(receiver)),
+              codeOf(EvsResult::STREAM_ALREADY_RUNNING));
+
+    ASSERT_TRUE(receiver->waitForFrames(5));
+    ASSERT_TRUE(camera->stopVideoStream().isOk());
+    const size_t framesAtStop = receiver->frameCount();
+
+    std::vector<BufferDesc> first = receiver->frame(0);
+    std::vector<BufferDesc> last = receiver->frame(framesAtStop - 1);
+    ASSERT_EQ(first.size(), 1u);
+    EXPECT_EQ(first[0].deviceId, "front");
+    EXPECT_GT(last[0].timestamp, first[0].timestamp);
+
+    // Stopping is the last thing the receiver hears about.
+    auto events = receiver->events();
+    ASSERT_FALSE(events.empty());
+    EXPECT_EQ(events.front().aType, EvsEventType::STREAM_STARTED);
+    EXPECT_EQ(events.back().aType, EvsEventType::STREAM_STOPPED);
+    EXPECT_EQ(receiver->eventCount(EvsEventType::FRAME_DROPPED), 0u);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(receiver->frameCount(), framesAtStop);
+
+    EXPECT_TRUE(mEnumerator->closeCamera(camera).isOk());
+}
+
+TEST_F(VirtualCameraTest, RestartsStreamsFromCallbacks) {
+    auto camera = openCamera("front");
+    auto receiver = ::ndk::SharedRefBase::make<RestartingReceiver>();
+    receiver->setCamera(camera);
+    receiver->setRestartedCamera(camera);
+    ASSERT_TRUE(camera->startVideoStream(receiver).isOk());
+    ASSERT_TRUE(receiver->waitForEvent(EvsEventType::STREAM_STOPPED, 2));
+    EXPECT_EQ(receiver->eventCount(EvsEventType::STREAM_STARTED), 2u);
+
+    // The camera streams as usual afterwards.
+    const size_t frames = receiver->frameCount();
+    ASSERT_TRUE(camera->startVideoStream(receiver).isOk());
+    ASSERT_TRUE(receiver->waitForFrames(frames + 2));
+    ASSERT_TRUE(camera->stopVideoStream().isOk());
+    EXPECT_TRUE(mEnumerator->closeCamera(camera).isOk());
+}
+
+TEST_F(VirtualCameraTest, DropsFramesWithoutFreeBuffers) {
+    auto camera = openCamera("front");
+    EXPECT_EQ(errorOf(camera->setMaxFramesInFlight(0)), codeOf(EvsResult::INVALID_ARG));
+    ASSERT_TRUE(camera->setMaxFramesInFlight(2).isOk());
+    auto receiver = startStream(camera, /* returnFrames= */ false);
+
+    ASSERT_TRUE(receiver->waitForEvent(EvsEventType::FRAME_DROPPED));
+    EXPECT_EQ(receiver->frameCount(), 2u);
+
+    // Returning a buffer lets the next frame through.
+    ASSERT_TRUE(camera->doneWithFrame(receiver->frame(0)).isOk());
+    ASSERT_TRUE(receiver->waitForFrames(3));
+    ASSERT_TRUE(camera->stopVideoStream().isOk());
+    EXPECT_TRUE(mEnumerator->closeCamera(camera).isOk());
+}
+
+TEST_F(VirtualCameraTest, PausesStreams) {
+    auto camera = openCamera("front");
+    auto receiver = startStream(camera);
+    ASSERT_TRUE(receiver->waitForFrames(1));
+    ASSERT_TRUE(camera->pauseVideoStream().isOk());
+    // A frame may have been in delivery.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const size_t framesWhilePaused = receiver->frameCount();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(receiver->frameCount(), framesWhilePaused);
+
+    ASSERT_TRUE(camera->resumeVideoStream().isOk());
+    ASSERT_TRUE(receiver->waitForFrames(framesWhilePaused + 1));
+    EXPECT_TRUE(mEnumerator->closeCamera(camera).isOk());
+}
+
+TEST_F(VirtualCameraTest, StreamsAllMembersOfLogicalCameras) {
+    auto camera = openCamera("surround");
+    CameraDesc desc;
+    ASSERT_TRUE(camera->getPhysicalCameraInfo("rear", &desc).isOk());
+    EXPECT_EQ(desc.id, "rear");
+    EXPECT_EQ(errorOf(camera->getPhysicalCameraInfo("side", &desc)),
+              codeOf(EvsResult::INVALID_ARG));
+
+    auto receiver = startStream(camera);
+    ASSERT_TRUE(receiver->waitForFrames(3));
+    std::vector<BufferDesc> frame = receiver->frame(2);
+    ASSERT_EQ(frame.size(), 2u);
+    EXPECT_EQ(frame[0].deviceId, "front");
+    EXPECT_EQ(frame[1].deviceId, "rear");
+    EXPECT_EQ(frame[0].timestamp, frame[1].timestamp);
+    ASSERT_TRUE(camera->stopVideoStream().isOk());
+    EXPECT_TRUE(mEnumerator->closeCamera(camera).isOk());
+}
+
+TEST_F(VirtualCameraTest, SharesDevicesBetweenClients) {
+    auto first = openCamera("front");
+    auto second = openCamera("front");
+    auto firstReceiver = startStream(first);
+    auto secondReceiver = startStream(second);
+    ASSERT_TRUE(firstReceiver->waitForFrames(3));
+    ASSERT_TRUE(secondReceiver->waitForFrames(3));
+
+    // The other client keeps streaming.
+    ASSERT_TRUE(first->stopVideoStream().isOk());
+    const size_t count = secondReceiver->frameCount();
+    ASSERT_TRUE(secondReceiver->waitForFrames(count + 2));
+
+    EXPECT_TRUE(mEnumerator->closeCamera(first).isOk());
+    EXPECT_TRUE(mEnumerator->closeCamera(second).isOk());
+    EXPECT_TRUE(secondReceiver->waitForEvent(EvsEventType::STREAM_STOPPED));
+}
+
+TEST_F(VirtualCameraTest, LetsOnlyThePrimaryClientSetParameters) {
+    auto primary = openCamera("front");
+    auto secondary = openCamera("front");
+    auto secondaryReceiver = startStream(secondary);
+
+    std::vector<int32_t> values;
+    EXPECT_EQ(errorOf(secondary->setIntParameter(CameraParam::BRIGHTNESS, 10, &values)),
+              codeOf(EvsResult::INVALID_ARG));
+    ASSERT_TRUE(primary->setPrimaryClient().isOk());
+    EXPECT_EQ(errorOf(secondary->setPrimaryClient()), codeOf(EvsResult::OWNERSHIP_LOST));
+
+    ASSERT_TRUE(primary->setIntParameter(CameraParam::BRIGHTNESS, 300, &values).isOk());
+    EXPECT_EQ(values, std::vector<int32_t>{255});
+    ASSERT_TRUE(secondary->getIntParameter(CameraParam::BRIGHTNESS, &values).isOk());
+    EXPECT_EQ(values, std::vector<int32_t>{255});
+    EXPECT_TRUE(secondaryReceiver->waitForEvent(EvsEventType::PARAMETER_CHANGED));
+    EXPECT_EQ(errorOf(primary->getIntParameter(CameraParam::ABSOLUTE_ZOOM, &values)),
+              codeOf(EvsResult::INVALID_ARG));
+
+    // Others learn that the role is free.
+    EXPECT_EQ(errorOf(secondary->unsetPrimaryClient()), codeOf(EvsResult::INVALID_ARG));
+    ASSERT_TRUE(primary->unsetPrimaryClient().isOk());
+    EXPECT_TRUE(secondaryReceiver->waitForEvent(EvsEventType::MASTER_RELEASED));
+    EXPECT_TRUE(secondary->setPrimaryClient().isOk());
+
+    ASSERT_TRUE(secondary->stopVideoStream().isOk());
+    EXPECT_TRUE(mEnumerator->closeCamera(primary).isOk());
+    EXPECT_TRUE(mEnumerator->closeCamera(secondary).isOk());
+}
+
+TEST_F(VirtualCameraTest, ForcesPrimaryClientWithTheDisplay) {
+    auto primary = openCamera("front");
+    auto other = openCamera("front");
+    auto primaryReceiver = startStream(primary);
+    ASSERT_TRUE(primary->setPrimaryClient().isOk());
+
+    EXPECT_EQ(errorOf(other->forcePrimaryClient(nullptr)), codeOf(EvsResult::INVALID_ARG));
+    std::shared_ptr<IEvsDisplay> display;
+    ASSERT_TRUE(mEnumerator->openDisplay(2, &display).isOk());
+    ASSERT_TRUE(other->forcePrimaryClient(display).isOk());
+    EXPECT_TRUE(primaryReceiver->waitForEvent(EvsEventType::MASTER_RELEASED));
+
+    std::vector<int32_t> values;
+    EXPECT_TRUE(other->setIntParameter(CameraParam::CONTRAST, 1, &values).isOk());
+    EXPECT_FALSE(primary->setIntParameter(CameraParam::CONTRAST, 2, &values).isOk());
+
+    // A display that was taken over can't be used anymore.
+    ASSERT_TRUE(mEnumerator->closeDisplay(display).isOk());
+    EXPECT_EQ(errorOf(primary->forcePrimaryClient(display)), codeOf(EvsResult::INVALID_ARG));
+
+    ASSERT_TRUE(primary->stopVideoStream().isOk());
+    EXPECT_TRUE(mEnumerator->closeCamera(primary).isOk());
+    EXPECT_TRUE(mEnumerator->closeCamera(other).isOk());
+}
+
+TEST_F(VirtualCameraTest, ClosedCamerasLoseOwnership) {
+    auto camera = openCamera("front");
+    auto receiver = startStream(camera);
+    ASSERT_TRUE(receiver->waitForFrames(1));
+    ASSERT_TRUE(mEnumerator->closeCamera(camera).isOk());
+    EXPECT_TRUE(receiver->waitForEvent(EvsEventType::STREAM_STOPPED));
+
+    EXPECT_EQ(errorOf(camera->setMaxFramesInFlight(2)), codeOf(EvsResult::OWNERSHIP_LOST));
+    EXPECT_EQ(errorOf(camera->startVideoStream(receiver)), codeOf(EvsResult::OWNERSHIP_LOST));
+    EXPECT_EQ(errorOf(camera->setPrimaryClient()), codeOf(EvsResult::OWNERSHIP_LOST));
+}
+
+TEST_F(VirtualCameraTest, KeepsExtendedInfo) {
+    auto camera = openCamera("front");
+    std::vector<uint8_t> value;
+    EXPECT_EQ(errorOf(camera->getExtendedInfo(7, &value)), codeOf(EvsResult::INVALID_ARG));
+    ASSERT_TRUE(camera->setExtendedInfo(7, {1, 2, 3}).isOk());
+    ASSERT_TRUE(camera->getExtendedInfo(7, &value).isOk());
+    EXPECT_EQ(value, (std::vector<uint8_t>{1, 2, 3}));
+    EXPECT_TRUE(mEnumerator->closeCamera(camera).isOk());
+}
+
+TEST_F(VirtualCameraTest, ShowsFramesOnTheDisplay) {
+    DisplayState state;
+    ASSERT_TRUE(mEnumerator->getDisplayState(&state).isOk());
+    EXPECT_EQ(state, DisplayState::NOT_OPEN);
+    std::shared_ptr<IEvsDisplay> display;
+    EXPECT_EQ(errorOf(mEnumerator->openDisplay(0, &display)), codeOf(EvsResult::INVALID_ARG));
+    ASSERT_TRUE(mEnumerator->openDisplay(2, &display).isOk());
+    auto virtualDisplay = std::static_pointer_cast<EvsVirtualDisplay>(display);
+
+    BufferDesc buffer;
+    ASSERT_TRUE(display->getTargetBuffer(&buffer).isOk());
+    EXPECT_EQ(errorOf(display->getTargetBuffer(&buffer)),
+              codeOf(EvsResult::BUFFER_NOT_AVAILABLE));
+    // Frames returned while the display isn't visible aren't shown.
+    ASSERT_TRUE(display->returnTargetBufferForDisplay(buffer).isOk());
+    EXPECT_EQ(virtualDisplay->framesShown(), 0u);
+    EXPECT_EQ(errorOf(display->returnTargetBufferForDisplay(buffer)),
+              codeOf(EvsResult::INVALID_ARG));
+
+    ASSERT_TRUE(display->setDisplayState(DisplayState::VISIBLE_ON_NEXT_FRAME).isOk());
+    EXPECT_EQ(errorOf(display->setDisplayState(DisplayState::DEAD)),
+              codeOf(EvsResult::INVALID_ARG));
+    ASSERT_TRUE(display->getTargetBuffer(&buffer).isOk());
+    const size_t size = 64 * 32 * 4;
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      buffer.buffer.handle.fds[0].get(), 0);
+    ASSERT_NE(data, MAP_FAILED);
+    memset(data, 0x7f, size);
+    munmap(data, size);
+    ASSERT_TRUE(display->returnTargetBufferForDisplay(buffer).isOk());
+
+    ASSERT_TRUE(mEnumerator->getDisplayState(&state).isOk());
+    EXPECT_EQ(state, DisplayState::VISIBLE);
+    EXPECT_EQ(virtualDisplay->framesShown(), 1u);
+    EXPECT_EQ(virtualDisplay->lastFrame(), std::vector<uint8_t>(size, 0x7f));
+
+    // A new client takes the display over.
+    std::shared_ptr<IEvsDisplay> newDisplay;
+    ASSERT_TRUE(mEnumerator->openDisplay(2, &newDisplay).isOk());
+    ASSERT_TRUE(display->getDisplayState(&state).isOk());
+    EXPECT_EQ(state, DisplayState::DEAD);
+    EXPECT_EQ(errorOf(display->getTargetBuffer(&buffer)), codeOf(EvsResult::OWNERSHIP_LOST));
+    ASSERT_TRUE(mEnumerator->getDisplayState(&state).isOk());
+    EXPECT_EQ(state, DisplayState::NOT_VISIBLE);
+}
+
+TEST_F(VirtualCameraTest, DoesNotSupportUltrasonics) {
+    std::vector<UltrasonicsArrayDesc> arrays;
+    ASSERT_TRUE(mEnumerator->getUltrasonicsArrayList(&arrays).isOk());
+    EXPECT_TRUE(arrays.empty());
+    std::shared_ptr<IEvsUltrasonicsArray> array;
+    EXPECT_EQ(errorOf(mEnumerator->openUltrasonicsArray("array", &array)),
+              codeOf(EvsResult::NOT_SUPPORTED));
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::automotive::evs::implementation
@@ -18,6 +18,13 @@
 
 #include "FormatConvert.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
 namespace android {
 namespace hardware {
 namespace automotive {
@@ -35,49 +42,127 @@ int Utils::align(int value) {
 }
 
 
-// Limit the given value to the provided range.  :)
-inline float Utils::clamp(float v, float min, float max) {
-    if (v < min) return min;
-    if (v > max) return max;
-    return v;
+namespace {
+
+// Conversions are done in fixed point, with this many fractional bits.
+constexpr int kShift = 14;
+constexpr int32_t kOne = 1 << kShift;
+
+// Multipliers of a YUV to RGB matrix, scaled by kOne.  Each channel is
+//   ((Y - yOffset) * yScale + chroma terms + bias) >> kShift
+// with U and V centered on 0.
+struct Coefficients {
+    int32_t yOffset;
+    int32_t yScale;
+    int32_t rV;
+    int32_t gU;
+    int32_t gV;
+    int32_t bU;
+    int32_t bias;
+};
+
+int32_t toFixed(double v) {
+    return static_cast<int32_t>(std::lround(v * kOne));
+}
+
+Coefficients getCoefficients(const ConversionOptions& options) {
+    if (options.matrix == ColorMatrix::LEGACY) {
+        // The analog YUV matrix, truncated like the floating point conversion used to be.
+        return {0, kOne, toFixed(1.140), toFixed(-0.395), toFixed(-0.581), toFixed(2.032), 0};
+    }
+
+    // Derived from the luma weights of red and blue, as in ITU-R BT.601 and BT.709.
+    double kr = options.matrix == ColorMatrix::BT709 ? 0.2126 : 0.299;
+    double kb = options.matrix == ColorMatrix::BT709 ? 0.0722 : 0.114;
+    double kg = 1.0 - kr - kb;
+    double yScale = 1.0;
+    double cScale = 1.0;
+    int32_t yOffset = 0;
+    if (options.range == ColorRange::LIMITED) {
+        yScale = 255.0 / 219.0;
+        cScale = 255.0 / 224.0;
+        yOffset = 16;
+    }
+    return {yOffset,
+            toFixed(yScale),
+            toFixed(cScale * 2.0 * (1.0 - kr)),
+            toFixed(cScale * -2.0 * kb * (1.0 - kb) / kg),
+            toFixed(cScale * -2.0 * kr * (1.0 - kr) / kg),
+            toFixed(cScale * 2.0 * (1.0 - kb)),
+            kOne / 2};
 }
 
+// Branchless, so that the loops below vectorize.
+inline uint32_t clampToByte(int32_t v) {
+    return static_cast<uint32_t>(std::min(std::max(v, 0), 255));
+}
 
-uint32_t Utils::yuvToRgbx(const unsigned char Y,
-                          const unsigned char Uin,
-                          const unsigned char Vin,
-                          bool bgrxFormat) {
-    // Don't use this if you want to see the best performance.  :)
-    // Better to do this in a pixel shader if we really have to, but on actual
-    // embedded hardware we expect to be able to texture directly from the YUV data
-    float U = Uin - 128.0f;
-    float V = Vin - 128.0f;
-
-    float Rf = Y + 1.140f*V;
-    float Gf = Y - 0.395f*U - 0.581f*V;
-    float Bf = Y + 2.032f*U;
-    unsigned char R = (unsigned char)clamp(Rf, 0.0f, 255.0f);
-    unsigned char G = (unsigned char)clamp(Gf, 0.0f, 255.0f);
-    unsigned char B = (unsigned char)clamp(Bf, 0.0f, 255.0f);
-
-    if (!bgrxFormat) {
-        return (R      ) |
-               (G <<  8) |
-               (B << 16) |
-               0xFF000000;  // Fill the alpha channel with ones
+template <bool bgrx>
+inline uint32_t packPixel(int32_t y, int32_t r, int32_t g, int32_t b) {
+    uint32_t R = clampToByte((y + r) >> kShift);
+    uint32_t G = clampToByte((y + g) >> kShift);
+    uint32_t B = clampToByte((y + b) >> kShift);
+    if (!bgrx) {
+        return R | (G << 8) | (B << 16) | 0xFF000000;  // Fill the alpha channel with ones
     } else {
-        return (R << 16) |
-               (G <<  8) |
-               (B      ) |
-               0xFF000000;  // Fill the alpha channel with ones
+        return (R << 16) | (G << 8) | B | 0xFF000000;
+    }
+}
+
+// Converts one row of pixels.  Luma samples are yStep bytes apart, and each pair of pixels shares
+// one U and one V sample, which are uvStep bytes apart from those of the next pair.  The steps are
+// template arguments and the loop body has no branches, so the compiler can vectorize it.
+template <bool bgrx, unsigned yStep, unsigned uvStep>
+void convertRow(const Coefficients& k, unsigned width,
+                const uint8_t* __restrict y, const uint8_t* __restrict u,
+                const uint8_t* __restrict v, uint32_t* __restrict dst) {
+    const unsigned pairs = width / 2;
+    for (unsigned i = 0; i < pairs; i++) {
+        int32_t U = u[i * uvStep] - 128;
+        int32_t V = v[i * uvStep] - 128;
+        int32_t r = k.rV * V + k.bias;
+        int32_t g = k.gU * U + k.gV * V + k.bias;
+        int32_t b = k.bU * U + k.bias;
+
+        int32_t y0 = (y[2 * i * yStep] - k.yOffset) * k.yScale;
+        int32_t y1 = (y[(2 * i + 1) * yStep] - k.yOffset) * k.yScale;
+        dst[2 * i] = packPixel<bgrx>(y0, r, g, b);
+        dst[2 * i + 1] = packPixel<bgrx>(y1, r, g, b);
+    }
+
+    if (width & 1) {
+        int32_t U = u[pairs * uvStep] - 128;
+        int32_t V = v[pairs * uvStep] - 128;
+        int32_t y0 = (y[2 * pairs * yStep] - k.yOffset) * k.yScale;
+        dst[2 * pairs] = packPixel<bgrx>(y0, k.rV * V + k.bias, k.gU * U + k.gV * V + k.bias,
+                                         k.bU * U + k.bias);
+    }
+}
+
+// Calls convertRows(firstRow, lastRow) over stripes of the image, on up to numThreads threads.
+void forEachStripe(unsigned height, unsigned numThreads,
+                   const std::function<void(unsigned, unsigned)>& convertRows) {
+    numThreads = std::max(1u, std::min(numThreads, height));
+    unsigned rowsPerStripe = (height + numThreads - 1) / numThreads;
+
+    std::vector<std::thread> threads;
+    for (unsigned first = rowsPerStripe; first < height; first += rowsPerStripe) {
+        threads.emplace_back(convertRows, first, std::min(first + rowsPerStripe, height));
+    }
+    convertRows(0, std::min(rowsPerStripe, height));
+    for (auto& thread : threads) {
+        thread.join();
     }
 }
 
+} // namespace
+
 
 void Utils::copyNV21toRGB32(unsigned width, unsigned height,
                             uint8_t* src,
                             uint32_t* dst, unsigned dstStridePixels,
-                            bool bgrxFormat)
+                            bool bgrxFormat,
+                            const ConversionOptions& options)
 {
     // The NV21 format provides a Y array of 8bit values, followed by a 1/2 x 1/2 interleaved
     // U/V array.  It assumes an even width and height for the overall image, and a horizontal
@@ -89,27 +174,26 @@ void Utils::copyNV21toRGB32(unsigned width, unsigned height,
 
     uint8_t* srcY = src;
     uint8_t* srcUV = src+offsetUV;
+    const Coefficients k = getCoefficients(options);
+    const auto convert = bgrxFormat ? convertRow<true, 1, 2> : convertRow<false, 1, 2>;
 
-    for (unsigned r = 0; r < height; r++) {
-        // Note that we're walking the same UV row twice for even/odd luminance rows
-        uint8_t* rowY  = srcY  + r*strideLum;
-        uint8_t* rowUV = srcUV + (r/2 * strideColor);
-
-        uint32_t* rowDest = dst + r*dstStridePixels;
+    forEachStripe(height, options.numThreads, [&](unsigned first, unsigned last) {
+        for (unsigned r = first; r < last; r++) {
+            // Note that we're walking the same UV row twice for even/odd luminance rows
+            uint8_t* rowY  = srcY  + r*strideLum;
+            uint8_t* rowUV = srcUV + (r/2 * strideColor);
 
-        for (unsigned c = 0; c < width; c++) {
-            unsigned uCol = (c & ~1);   // uCol is always even and repeats 1:2 with Y values
-            unsigned vCol = uCol | 1;   // vCol is always odd
-            rowDest[c] = yuvToRgbx(rowY[c], rowUV[uCol], rowUV[vCol], bgrxFormat);
+            convert(k, width, rowY, rowUV, rowUV + 1, dst + r*dstStridePixels);
         }
-    }
+    });
 }
 
 
 void Utils::copyYV12toRGB32(unsigned width, unsigned height,
                             uint8_t* src,
                             uint32_t* dst, unsigned dstStridePixels,
-                            bool bgrxFormat)
+                            bool bgrxFormat,
+                            const ConversionOptions& options)
 {
     // The YV12 format provides a Y array of 8bit values, followed by a 1/2 x 1/2 U array, followed
     // by another 1/2 x 1/2 V array.  It assumes an even width and height for the overall image,
@@ -125,76 +209,67 @@ void Utils::copyYV12toRGB32(unsigned width, unsigned height,
     uint8_t* srcY = src;
     uint8_t* srcU = src+offsetU;
     uint8_t* srcV = src+offsetV;
+    const Coefficients k = getCoefficients(options);
+    const auto convert = bgrxFormat ? convertRow<true, 1, 1> : convertRow<false, 1, 1>;
 
-    for (unsigned r = 0; r < height; r++) {
-        // Note that we're walking the same U and V rows twice for even/odd luminance rows
-        uint8_t* rowY = srcY + r*strideLum;
-        uint8_t* rowU = srcU + (r/2 * strideColor);
-        uint8_t* rowV = srcV + (r/2 * strideColor);
-
-        uint32_t* rowDest = dst + r*dstStridePixels;
+    forEachStripe(height, options.numThreads, [&](unsigned first, unsigned last) {
+        for (unsigned r = first; r < last; r++) {
+            // Note that we're walking the same U and V rows twice for even/odd luminance rows
+            uint8_t* rowY = srcY + r*strideLum;
+            uint8_t* rowU = srcU + (r/2 * strideColor);
+            uint8_t* rowV = srcV + (r/2 * strideColor);
 
-        for (unsigned c = 0; c < width; c++) {
-            rowDest[c] = yuvToRgbx(rowY[c], rowU[c], rowV[c], bgrxFormat);
+            convert(k, width, rowY, rowU, rowV, dst + r*dstStridePixels);
         }
-    }
+    });
 }
 
 
 void Utils::copyYUYVtoRGB32(unsigned width, unsigned height,
                             uint8_t* src, unsigned srcStridePixels,
                             uint32_t* dst, unsigned dstStridePixels,
-                            bool bgrxFormat)
+                            bool bgrxFormat,
+                            const ConversionOptions& options)
 {
-    uint32_t* srcWords = (uint32_t*)src;
-
-    const int srcRowPadding32 = srcStridePixels/2 - width/2;  // 2 bytes per pixel, 4 bytes per word
-    const int dstRowPadding32 = dstStridePixels   - width;    // 4 bytes per pixel, 4 bytes per word
+    // Each 32bit word holds two pixels as Y1 U Y2 V, 2 bytes per pixel.
+    const Coefficients k = getCoefficients(options);
+    const auto convert = bgrxFormat ? convertRow<true, 2, 4> : convertRow<false, 2, 4>;
 
-    for (unsigned r = 0; r < height; r++) {
-        for (unsigned c = 0; c < width/2; c++) {
-            // Note:  we're walking two pixels at a time here (even/odd)
-            uint32_t srcPixel = *srcWords++;
+    forEachStripe(height, options.numThreads, [&](unsigned first, unsigned last) {
+        for (unsigned r = first; r < last; r++) {
+            uint8_t* rowSrc = src + r*srcStridePixels*2;
 
-            uint8_t Y1 = (srcPixel)       & 0xFF;
-            uint8_t U  = (srcPixel >> 8)  & 0xFF;
-            uint8_t Y2 = (srcPixel >> 16) & 0xFF;
-            uint8_t V  = (srcPixel >> 24) & 0xFF;
-
-            // On the RGB output, we're writing one pixel at a time
-            *(dst+0) = yuvToRgbx(Y1, U, V, bgrxFormat);
-            *(dst+1) = yuvToRgbx(Y2, U, V, bgrxFormat);
-            dst += 2;
+            convert(k, width & ~1u, rowSrc, rowSrc + 1, rowSrc + 3, dst + r*dstStridePixels);
         }
-
-        // Skip over any extra data or end of row alignment padding
-        srcWords += srcRowPadding32;
-        dst += dstRowPadding32;
-    }
+    });
 }
 
 
 void Utils::copyNV21toBGR32(unsigned width, unsigned height,
                             uint8_t* src,
-                            uint32_t* dst, unsigned dstStridePixels)
+                            uint32_t* dst, unsigned dstStridePixels,
+                            const ConversionOptions& options)
 {
-    return copyNV21toRGB32(width, height, src, dst, dstStridePixels, true);
+    return copyNV21toRGB32(width, height, src, dst, dstStridePixels, true, options);
 }
 
 
 void Utils::copyYV12toBGR32(unsigned width, unsigned height,
                             uint8_t* src,
-                            uint32_t* dst, unsigned dstStridePixels)
+                            uint32_t* dst, unsigned dstStridePixels,
+                            const ConversionOptions& options)
 {
-    return copyYV12toRGB32(width, height, src, dst, dstStridePixels, true);
+    return copyYV12toRGB32(width, height, src, dst, dstStridePixels, true, options);
 }
 
 
 void Utils::copyYUYVtoBGR32(unsigned width, unsigned height,
                             uint8_t* src, unsigned srcStridePixels,
-                            uint32_t* dst, unsigned dstStridePixels)
+                            uint32_t* dst, unsigned dstStridePixels,
+                            const ConversionOptions& options)
 {
-    return copyYUYVtoRGB32(width, height, src, srcStridePixels, dst, dstStridePixels, true);
+    return copyYUYVtoRGB32(width, height, src, srcStridePixels, dst, dstStridePixels, true,
+                           options);
 }
 
 
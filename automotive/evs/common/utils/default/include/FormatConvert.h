@@ -27,8 +27,33 @@ namespace automotive {
 namespace evs {
 namespace common {
 
+// The matrix used to convert YUV samples to RGB.  LEGACY keeps the analog YUV coefficients these
+// utilities always used, and ignores the range.  BT601 and BT709 are the YCbCr matrices of those
+// standards, with either full range samples or video range samples (Y in [16, 235] and Cb/Cr in
+// [16, 240]).
+enum class ColorMatrix {
+    LEGACY,
+    BT601,
+    BT709,
+};
+
+enum class ColorRange {
+    FULL,
+    LIMITED,
+};
+
+struct ConversionOptions {
+    ColorMatrix matrix = ColorMatrix::LEGACY;
+    ColorRange range = ColorRange::FULL;
+    // Rows are split into this many stripes, converted on separate threads.
+    unsigned numThreads = 1;
+};
+
 class Utils {
 public:
+    // Each of the YUV conversions below takes an optional ConversionOptions.  Pixels are converted
+    // in fixed point, which stays within 1 of an exact conversion on every channel.
+
     // Given an image buffer in NV21 format (HAL_PIXEL_FORMAT_YCRCB_420_SP), output 32bit RGBx/BGRx
     // values.  The NV21 format provides a Y array of 8bit values, followed by a 1/2 x 1/2 interleaved
     // U/V array.  It assumes an even width and height for the overall image, and a horizontal
@@ -36,11 +61,13 @@ public:
     static void copyNV21toRGB32(unsigned width, unsigned height,
                                 uint8_t* src,
                                 uint32_t* dst, unsigned dstStridePixels,
-                                bool bgrxFormat = false);
+                                bool bgrxFormat = false,
+                                const ConversionOptions& options = {});
 
     static void copyNV21toBGR32(unsigned width, unsigned height,
                                 uint8_t* src,
-                                uint32_t* dst, unsigned dstStridePixels);
+                                uint32_t* dst, unsigned dstStridePixels,
+                                const ConversionOptions& options = {});
 
 
     // Given an image buffer in YV12 format (HAL_PIXEL_FORMAT_YV12), output 32bit RGBx/BGRx values.
@@ -51,11 +78,13 @@ public:
     static void copyYV12toRGB32(unsigned width, unsigned height,
                                 uint8_t* src,
                                 uint32_t* dst, unsigned dstStridePixels,
-                                bool bgrxFormat = false);
+                                bool bgrxFormat = false,
+                                const ConversionOptions& options = {});
 
     static void copyYV12toBGR32(unsigned width, unsigned height,
                                 uint8_t* src,
-                                uint32_t* dst, unsigned dstStridePixels);
+                                uint32_t* dst, unsigned dstStridePixels,
+                                const ConversionOptions& options = {});
 
     // Given an image buffer in YUYV format (HAL_PIXEL_FORMAT_YCBCR_422_I), output 32bit RGBx/BGRx
     // values.  The NV21 format provides a Y array of 8bit values, followed by a 1/2 x 1/2 interleaved
@@ -64,11 +93,13 @@ public:
     static void copyYUYVtoRGB32(unsigned width, unsigned height,
                                 uint8_t* src, unsigned srcStrideBytes,
                                 uint32_t* dst, unsigned dstStrideBytes,
-                                bool bgrxFormat = false);
+                                bool bgrxFormat = false,
+                                const ConversionOptions& options = {});
 
     static void copyYUYVtoBGR32(unsigned width, unsigned height,
                                 uint8_t* src, unsigned srcStrideBytes,
-                                uint32_t* dst, unsigned dstStrideBytes);
+                                uint32_t* dst, unsigned dstStrideBytes,
+                                const ConversionOptions& options = {});
 
 
     // Given an simple rectangular image buffer with an integer number of bytes per pixel,
@@ -82,12 +113,6 @@ public:
 private:
     template<unsigned alignment>
     static int align(int value);
-
-    static inline float clamp(float v, float min, float max);
-    static uint32_t yuvToRgbx(const unsigned char Y,
-                              const unsigned char Uin,
-                              const unsigned char Vin,
-                              bool bgrxFormat = false);
 };
 
 } // namespace common
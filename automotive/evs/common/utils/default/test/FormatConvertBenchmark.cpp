@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FormatConvert.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+using ::android::hardware::automotive::evs::common::ColorMatrix;
+using ::android::hardware::automotive::evs::common::ColorRange;
+using ::android::hardware::automotive::evs::common::ConversionOptions;
+using ::android::hardware::automotive::evs::common::Utils;
+
+namespace {
+
+// One 1080p camera frame per iteration.
+constexpr unsigned kWidth = 1920;
+constexpr unsigned kHeight = 1080;
+
+ConversionOptions getOptions(const benchmark::State& state) {
+    return {static_cast<ColorMatrix>(state.range(0)), ColorRange::LIMITED,
+            static_cast<unsigned>(state.range(1))};
+}
+
+void BM_NV21toRGB32(benchmark::State& state) {
+    std::vector<uint8_t> src(kWidth * kHeight * 3 / 2, 128);
+    std::vector<uint32_t> dst(kWidth * kHeight);
+    ConversionOptions options = getOptions(state);
+    for (auto _ : state) {
+        Utils::copyNV21toRGB32(kWidth, kHeight, src.data(), dst.data(), kWidth, false, options);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kWidth * kHeight);
+}
+
+void BM_YV12toRGB32(benchmark::State& state) {
+    std::vector<uint8_t> src(kWidth * kHeight * 3 / 2, 128);
+    std::vector<uint32_t> dst(kWidth * kHeight);
+    ConversionOptions options = getOptions(state);
+    for (auto _ : state) {
+        Utils::copyYV12toRGB32(kWidth, kHeight, src.data(), dst.data(), kWidth, false, options);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kWidth * kHeight);
+}
+
+void BM_YUYVtoRGB32(benchmark::State& state) {
+    std::vector<uint8_t> src(kWidth * kHeight * 2, 128);
+    std::vector<uint32_t> dst(kWidth * kHeight);
+    ConversionOptions options = getOptions(state);
+    for (auto _ : state) {
+        Utils::copyYUYVtoRGB32(kWidth, kHeight, src.data(), kWidth, dst.data(), kWidth, false,
+                               options);
+        benchmark::DoNotOptimize(dst.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kWidth * kHeight);
+}
+
+// Arguments are the matrix and the number of threads.
+void conversionArgs(benchmark::internal::Benchmark* b) {
+    for (ColorMatrix matrix : {ColorMatrix::LEGACY, ColorMatrix::BT709}) {
+        for (int numThreads : {1, 4}) {
+            b->Args({static_cast<int>(matrix), numThreads});
+        }
+    }
+    b->UseRealTime();
+}
+
+}  // namespace
+
+BENCHMARK(BM_NV21toRGB32)->Apply(conversionArgs);
+BENCHMARK(BM_YV12toRGB32)->Apply(conversionArgs);
+BENCHMARK(BM_YUYVtoRGB32)->Apply(conversionArgs);
+
+BENCHMARK_MAIN();
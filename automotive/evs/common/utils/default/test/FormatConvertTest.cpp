@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FormatConvert.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace evs {
+namespace common {
+namespace {
+
+constexpr unsigned kWidth = 64;
+constexpr unsigned kHeight = 30;
+// Fixed point results may differ from the floating point ones by this much on every channel.
+constexpr int kTolerance = 1;
+
+float clamp(float v, float min, float max) {
+    if (v < min) return min;
+    if (v > max) return max;
+    return v;
+}
+
+// The floating point conversion these utilities used before, the golden reference of LEGACY.
+uint32_t legacyYuvToRgbx(uint8_t Y, uint8_t Uin, uint8_t Vin) {
+    float U = Uin - 128.0f;
+    float V = Vin - 128.0f;
+
+    float Rf = Y + 1.140f*V;
+    float Gf = Y - 0.395f*U - 0.581f*V;
+    float Bf = Y + 2.032f*U;
+    uint32_t R = (unsigned char)clamp(Rf, 0.0f, 255.0f);
+    uint32_t G = (unsigned char)clamp(Gf, 0.0f, 255.0f);
+    uint32_t B = (unsigned char)clamp(Bf, 0.0f, 255.0f);
+    return R | (G << 8) | (B << 16) | 0xFF000000;
+}
+
+// The exact YCbCr conversion of ITU-R BT.601 and BT.709.
+uint32_t ycbcrToRgbx(uint8_t Y, uint8_t Cb, uint8_t Cr, ColorMatrix matrix, ColorRange range) {
+    double kr = matrix == ColorMatrix::BT709 ? 0.2126 : 0.299;
+    double kb = matrix == ColorMatrix::BT709 ? 0.0722 : 0.114;
+    double kg = 1.0 - kr - kb;
+    double y = Y;
+    double u = Cb - 128.0;
+    double v = Cr - 128.0;
+    if (range == ColorRange::LIMITED) {
+        y = (y - 16.0) * 255.0 / 219.0;
+        u = u * 255.0 / 224.0;
+        v = v * 255.0 / 224.0;
+    }
+    double r = y + 2.0 * (1.0 - kr) * v;
+    double g = y - 2.0 * kb * (1.0 - kb) / kg * u - 2.0 * kr * (1.0 - kr) / kg * v;
+    double b = y + 2.0 * (1.0 - kb) * u;
+    uint32_t R = (uint32_t)std::lround(clamp(r, 0.0, 255.0));
+    uint32_t G = (uint32_t)std::lround(clamp(g, 0.0, 255.0));
+    uint32_t B = (uint32_t)std::lround(clamp(b, 0.0, 255.0));
+    return R | (G << 8) | (B << 16) | 0xFF000000;
+}
+
+uint32_t toBgrx(uint32_t rgbx) {
+    return (rgbx & 0xFF00FF00) | ((rgbx & 0xFF) << 16) | ((rgbx >> 16) & 0xFF);
+}
+
+uint32_t reference(uint8_t Y, uint8_t U, uint8_t V, const ConversionOptions& options) {
+    return options.matrix == ColorMatrix::LEGACY
+            ? legacyYuvToRgbx(Y, U, V)
+            : ycbcrToRgbx(Y, U, V, options.matrix, options.range);
+}
+
+::testing::AssertionResult nearPixel(uint32_t expected, uint32_t actual) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        int e = (expected >> shift) & 0xFF;
+        int a = (actual >> shift) & 0xFF;
+        if (std::abs(e - a) > kTolerance) {
+            return ::testing::AssertionFailure() << std::hex << "expected 0x" << expected
+                                                 << " but got 0x" << actual;
+        }
+    }
+    return ::testing::AssertionSuccess();
+}
+
+// A deterministic test image: gradients covering the whole range of each plane, with noise.
+std::vector<uint8_t> makeImage(size_t size) {
+    std::mt19937 random(1);
+    std::vector<uint8_t> image(size);
+    for (size_t i = 0; i < size; ++i) {
+        image[i] = static_cast<uint8_t>(i * 7 + random() % 16);
+    }
+    return image;
+}
+
+class FormatConvertTest : public ::testing::TestWithParam<ConversionOptions> {};
+
+TEST_P(FormatConvertTest, NV21) {
+    const ConversionOptions& options = GetParam();
+    std::vector<uint8_t> src = makeImage(kWidth * kHeight * 3 / 2);
+    std::vector<uint32_t> rgb(kWidth * kHeight);
+    std::vector<uint32_t> bgr(kWidth * kHeight);
+    Utils::copyNV21toRGB32(kWidth, kHeight, src.data(), rgb.data(), kWidth, false, options);
+    Utils::copyNV21toBGR32(kWidth, kHeight, src.data(), bgr.data(), kWidth, options);
+
+    const uint8_t* uv = src.data() + kWidth * kHeight;
+    for (unsigned r = 0; r < kHeight; ++r) {
+        for (unsigned c = 0; c < kWidth; ++c) {
+            const uint8_t* pair = uv + r / 2 * kWidth + (c & ~1);
+            uint32_t expected = reference(src[r * kWidth + c], pair[0], pair[1], options);
+            ASSERT_TRUE(nearPixel(expected, rgb[r * kWidth + c])) << "at " << c << "," << r;
+            ASSERT_EQ(toBgrx(rgb[r * kWidth + c]), bgr[r * kWidth + c]);
+        }
+    }
+}
+
+TEST_P(FormatConvertTest, YV12) {
+    const ConversionOptions& options = GetParam();
+    constexpr unsigned kStrideColor = kWidth / 2;  // Already 16 byte aligned
+    std::vector<uint8_t> src = makeImage(kWidth * kHeight * 3 / 2);
+    std::vector<uint32_t> rgb(kWidth * kHeight);
+    Utils::copyYV12toRGB32(kWidth, kHeight, src.data(), rgb.data(), kWidth, false, options);
+
+    const uint8_t* u = src.data() + kWidth * kHeight;
+    const uint8_t* v = u + kStrideColor * kHeight / 2;
+    for (unsigned r = 0; r < kHeight; ++r) {
+        for (unsigned c = 0; c < kWidth; ++c) {
+            unsigned chroma = r / 2 * kStrideColor + c / 2;
+            uint32_t expected = reference(src[r * kWidth + c], u[chroma], v[chroma], options);
+            ASSERT_TRUE(nearPixel(expected, rgb[r * kWidth + c])) << "at " << c << "," << r;
+        }
+    }
+}
+
+TEST_P(FormatConvertTest, YUYV) {
+    const ConversionOptions& options = GetParam();
+    constexpr unsigned kDstStride = kWidth + 8;
+    std::vector<uint8_t> src = makeImage(kWidth * kHeight * 2);
+    std::vector<uint32_t> rgb(kDstStride * kHeight);
+    Utils::copyYUYVtoRGB32(kWidth, kHeight, src.data(), kWidth, rgb.data(), kDstStride, false,
+                           options);
+
+    for (unsigned r = 0; r < kHeight; ++r) {
+        for (unsigned c = 0; c < kWidth; ++c) {
+            const uint8_t* word = src.data() + r * kWidth * 2 + (c & ~1) * 2;
+            uint32_t expected = reference(word[(c & 1) * 2], word[1], word[3], options);
+            ASSERT_TRUE(nearPixel(expected, rgb[r * kDstStride + c])) << "at " << c << "," << r;
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+        Matrices, FormatConvertTest,
+        ::testing::Values(ConversionOptions{ColorMatrix::LEGACY, ColorRange::FULL, 1},
+                          ConversionOptions{ColorMatrix::BT601, ColorRange::FULL, 1},
+                          ConversionOptions{ColorMatrix::BT601, ColorRange::LIMITED, 1},
+                          ConversionOptions{ColorMatrix::BT709, ColorRange::FULL, 1},
+                          ConversionOptions{ColorMatrix::BT709, ColorRange::LIMITED, 3}));
+
+TEST(FormatConvertRangeTest, LimitedRangeBlackAndWhite) {
+    // Y in [16, 235] maps to the full output range.
+    uint8_t src[16 * 2 * 3 / 2];
+    memset(src, 16, 16);
+    memset(src + 16, 235, 16);
+    memset(src + 32, 128, 16);
+    uint32_t dst[16 * 2];
+    Utils::copyNV21toRGB32(16, 2, src, dst, 16, false,
+                           {ColorMatrix::BT709, ColorRange::LIMITED, 1});
+    EXPECT_EQ(0xFF000000u, dst[0]);
+    EXPECT_EQ(0xFFFFFFFFu, dst[16]);
+}
+
+TEST(FormatConvertThreadTest, StripesMatchSingleThread) {
+    constexpr unsigned kOddHeight = 37;
+    std::vector<uint8_t> src = makeImage(kWidth * kOddHeight * 2);
+    std::vector<uint32_t> single(kWidth * kOddHeight);
+    std::vector<uint32_t> striped(kWidth * kOddHeight);
+    Utils::copyYUYVtoRGB32(kWidth, kOddHeight, src.data(), kWidth, single.data(), kWidth);
+    for (unsigned numThreads : {2u, 4u, 64u}) {
+        Utils::copyYUYVtoRGB32(kWidth, kOddHeight, src.data(), kWidth, striped.data(), kWidth,
+                               false, {ColorMatrix::LEGACY, ColorRange::FULL, numThreads});
+        EXPECT_EQ(single, striped) << numThreads << " threads";
+    }
+}
+
+}  // namespace
+}  // namespace common
+}  // namespace evs
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
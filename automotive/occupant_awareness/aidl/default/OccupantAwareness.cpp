@@ -14,6 +14,11 @@
  * limitations under the License.
  */
 
+#include <fstream>
+
+#include <android-base/logging.h>
+#include <utils/SystemClock.h>
+
 #include "OccupantAwareness.h"
 
 namespace android {
@@ -29,13 +34,37 @@ static const int32_t kAllCapabilities = OccupantAwareness::CAP_PRESENCE_DETECTIO
                                         OccupantAwareness::CAP_GAZE_DETECTION |
                                         OccupantAwareness::CAP_DRIVER_MONITORING_DETECTION;
 
+static const char kSyntheticConfigPath[] = "/vendor/etc/occupant_awareness_synthetic.conf";
+
+static SyntheticDetectionConfig loadSyntheticConfig() {
+    SyntheticDetectionConfig config = SyntheticDetectionConfig::defaultConfig();
+    std::ifstream in(kSyntheticConfigPath);
+    if (in && !parseSyntheticDetectionConfig(in, &config)) {
+        LOG(ERROR) << "Ignoring invalid " << kSyntheticConfigPath;
+        return SyntheticDetectionConfig::defaultConfig();
+    }
+    return config;
+}
+
+OccupantAwareness::OccupantAwareness() : OccupantAwareness(loadSyntheticConfig()) {}
+
+OccupantAwareness::OccupantAwareness(SyntheticDetectionConfig config)
+    : mSource(std::make_unique<SyntheticDetectionSource>(
+              std::move(config),
+              [this](const OccupantDetections& detections) { onDetectionEvent(detections); },
+              [] { return android::elapsedRealtime(); })) {}
+
 ScopedAStatus OccupantAwareness::startDetection(OccupantAwarenessStatus* status) {
     std::lock_guard<std::mutex> lock(mMutex);
-    if (mStatus != OccupantAwarenessStatus::NOT_SUPPORTED) {
-        mStatus = OccupantAwarenessStatus::NOT_SUPPORTED;
+    OccupantAwarenessStatus newStatus = OccupantAwarenessStatus::NOT_SUPPORTED;
+    if (getAllCapabilities() != 0) {
+        newStatus = mSource->start() ? OccupantAwarenessStatus::READY
+                                     : OccupantAwarenessStatus::FAILURE;
+    }
+    if (mStatus != newStatus) {
+        mStatus = newStatus;
         if (mCallback) {
-            mCallback->onSystemStatusChanged(kAllCapabilities,
-                                             OccupantAwarenessStatus::NOT_SUPPORTED);
+            mCallback->onSystemStatusChanged(kAllCapabilities, mStatus);
         }
     }
     *status = mStatus;
@@ -44,6 +73,8 @@ ScopedAStatus OccupantAwareness::startDetection(OccupantAwarenessStatus* status)
 
 ScopedAStatus OccupantAwareness::stopDetection(OccupantAwarenessStatus* status) {
     std::lock_guard<std::mutex> lock(mMutex);
+    // Detections are delivered without mMutex, so this can't deadlock with a delivery.
+    mSource->stop();
     if (mStatus != OccupantAwarenessStatus::NOT_INITIALIZED) {
         mStatus = OccupantAwarenessStatus::NOT_INITIALIZED;
         if (mCallback) {
@@ -60,8 +91,7 @@ ScopedAStatus OccupantAwareness::getCapabilityForRole(Role occupantRole, int32_t
         return ScopedAStatus::fromExceptionCode(EX_TRANSACTION_FAILED);
     }
 
-    // No awareness capability for default HAL.
-    *capabilities = 0;
+    *capabilities = mSource->getCapabilities(occupantRole);
     return ScopedAStatus::ok();
 }
 
@@ -76,6 +106,11 @@ ScopedAStatus OccupantAwareness::getState(Role occupantRole, int detectionCapabi
         return ScopedAStatus::fromExceptionCode(EX_TRANSACTION_FAILED);
     }
 
+    if ((detectionCapability & mSource->getCapabilities(occupantRole)) != detectionCapability) {
+        *status = OccupantAwarenessStatus::NOT_SUPPORTED;
+        return ScopedAStatus::ok();
+    }
+
     std::lock_guard<std::mutex> lock(mMutex);
     *status = mStatus;
     return ScopedAStatus::ok();
@@ -88,14 +123,22 @@ ScopedAStatus OccupantAwareness::setCallback(
     }
 
     std::lock_guard<std::mutex> lock(mMutex);
-    mCallback = callback;
+    std::atomic_store(&mCallback, callback);
     return ScopedAStatus::ok();
 }
 
 ScopedAStatus OccupantAwareness::getLatestDetection(OccupantDetections* detections) {
-    // No detection generated for default hal.
-    (void)detections;
-    return ScopedAStatus::fromExceptionCode(EX_TRANSACTION_FAILED);
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mStatus != OccupantAwarenessStatus::READY) {
+        return ScopedAStatus::fromExceptionCode(EX_TRANSACTION_FAILED);
+    }
+
+    std::optional<OccupantDetections> latest = mSource->getLatestDetections();
+    if (!latest.has_value()) {
+        return ScopedAStatus::fromExceptionCode(EX_TRANSACTION_FAILED);
+    }
+    *detections = std::move(*latest);
+    return ScopedAStatus::ok();
 }
 
 bool OccupantAwareness::isValidRole(Role occupantRole) {
@@ -114,6 +157,21 @@ bool OccupantAwareness::isSingularCapability(int detectionCapability) {
     return (detectionCapability & (detectionCapability - 1)) == 0;
 }
 
+int32_t OccupantAwareness::getAllCapabilities() const {
+    int32_t capabilities = 0;
+    for (int role = 1; role <= static_cast<int>(Role::ALL_OCCUPANTS); role <<= 1) {
+        capabilities |= mSource->getCapabilities(static_cast<Role>(role));
+    }
+    return capabilities;
+}
+
+void OccupantAwareness::onDetectionEvent(const OccupantDetections& detections) {
+    std::shared_ptr<IOccupantAwarenessClientCallback> callback = std::atomic_load(&mCallback);
+    if (callback != nullptr) {
+        callback->onDetectionEvent(detections);
+    }
+}
+
 }  // namespace implementation
 }  // namespace V1_0
 }  // namespace occupant_awareness
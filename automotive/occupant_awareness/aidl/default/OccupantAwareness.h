@@ -15,10 +15,16 @@
  */
 
 #pragma once
+
+#include <memory>
+#include <mutex>
+
 #include <aidl/android/hardware/automotive/occupant_awareness/BnOccupantAwareness.h>
 #include <aidl/android/hardware/automotive/occupant_awareness/BnOccupantAwarenessClientCallback.h>
 #include <utils/StrongPointer.h>
 
+#include "SyntheticDetectionSource.h"
+
 namespace android {
 namespace hardware {
 namespace automotive {
@@ -33,11 +39,15 @@ using ::aidl::android::hardware::automotive::occupant_awareness::OccupantDetecti
 using ::aidl::android::hardware::automotive::occupant_awareness::Role;
 
 /**
- * The default HAL mimics a system which has no Occupant awareness capability. The hal does not
- * do any useful work, and returns appropriate failure code / status.
+ * The default HAL detects occupants with a SyntheticDetectionSource, configured by
+ * /vendor/etc/occupant_awareness_synthetic.conf if present, and detecting the driver and front
+ * passenger otherwise. Roles the configuration doesn't list have no capability.
  **/
 class OccupantAwareness : public BnOccupantAwareness {
   public:
+    OccupantAwareness();
+    explicit OccupantAwareness(SyntheticDetectionConfig config);
+
     // Methods from ::android::hardware::automotive::occupant_awareness::IOccupantAwareness
     // follow.
     ndk::ScopedAStatus startDetection(OccupantAwarenessStatus* status) override;
@@ -53,10 +63,15 @@ class OccupantAwareness : public BnOccupantAwareness {
     bool isValidRole(Role occupantRole);
     bool isValidDetectionCapabilities(int detectionCapabilities);
     bool isSingularCapability(int detectionCapability);
+    int32_t getAllCapabilities() const;
+    void onDetectionEvent(const OccupantDetections& detections);
 
     std::mutex mMutex;
     std::shared_ptr<IOccupantAwarenessClientCallback> mCallback = nullptr;
     OccupantAwarenessStatus mStatus = OccupantAwarenessStatus::NOT_INITIALIZED;
+
+    // Declared last, so its threads stop before the rest of the HAL is destroyed.
+    std::unique_ptr<SyntheticDetectionSource> mSource;
 };
 
 }  // namespace implementation
@@ -0,0 +1,554 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#include <android-base/logging.h>
+
+#include "SyntheticDetectionSource.h"
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace occupant_awareness {
+namespace V1_0 {
+namespace implementation {
+
+using ::aidl::android::hardware::automotive::occupant_awareness::DriverMonitoringDetection;
+using ::aidl::android::hardware::automotive::occupant_awareness::GazeDetection;
+using ::aidl::android::hardware::automotive::occupant_awareness::IOccupantAwareness;
+using ::aidl::android::hardware::automotive::occupant_awareness::PresenceDetection;
+
+namespace {
+
+// Time spent looking at the road between glances, and on each glance.
+constexpr int64_t kMinRoadMillis = 2000;
+constexpr int64_t kMaxRoadMillis = 8000;
+constexpr int64_t kMinGlanceMillis = 300;
+constexpr int64_t kMaxGlanceMillis = 1500;
+
+constexpr std::array<VehicleRegion, 5> kGlanceTargets = {
+        VehicleRegion::REAR_VIEW_MIRROR,   VehicleRegion::LEFT_SIDE_MIRROR,
+        VehicleRegion::RIGHT_SIDE_MIRROR,  VehicleRegion::INSTRUMENT_CLUSTER,
+        VehicleRegion::HEAD_UNIT_DISPLAY,
+};
+
+bool isSingleRole(Role role) {
+    int value = static_cast<int>(role);
+    return value != 0 && (value & (value - 1)) == 0 &&
+           (value & ~static_cast<int>(Role::ALL_OCCUPANTS)) == 0;
+}
+
+template <typename Enum>
+bool parseEnum(const std::string& name, Enum* value) {
+    for (Enum candidate : ::ndk::enum_range<Enum>()) {
+        if (toString(candidate) == name) {
+            *value = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseSingleRole(const std::string& name, Role* role) {
+    return parseEnum(name, role) && isSingleRole(*role);
+}
+
+bool isOnRoad(VehicleRegion region) {
+    return region == VehicleRegion::FORWARD_ROADWAY || region == VehicleRegion::LEFT_ROADWAY ||
+           region == VehicleRegion::RIGHT_ROADWAY;
+}
+
+// Vehicle coordinates: x forward, y left, z up.
+std::vector<double> gazeVector(VehicleRegion region) {
+    std::array<double, 3> v;
+    switch (region) {
+        case VehicleRegion::LEFT_ROADWAY:
+            v = {0.87, 0.5, 0.0};
+            break;
+        case VehicleRegion::RIGHT_ROADWAY:
+            v = {0.87, -0.5, 0.0};
+            break;
+        case VehicleRegion::REAR_VIEW_MIRROR:
+            v = {0.8, -0.45, 0.4};
+            break;
+        case VehicleRegion::LEFT_SIDE_MIRROR:
+            v = {0.5, 0.85, -0.1};
+            break;
+        case VehicleRegion::RIGHT_SIDE_MIRROR:
+            v = {0.4, -0.9, -0.1};
+            break;
+        case VehicleRegion::INSTRUMENT_CLUSTER:
+            v = {0.9, 0.0, -0.45};
+            break;
+        case VehicleRegion::HEAD_UNIT_DISPLAY:
+            v = {0.8, -0.5, -0.35};
+            break;
+        default:
+            v = {1.0, 0.0, 0.0};
+            break;
+    }
+    const double norm = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    return {v[0] / norm, v[1] / norm, v[2] / norm};
+}
+
+// The head position of the occupant of a seat, in meters from the center of the front row.
+std::vector<double> headPosition(Role role) {
+    switch (role) {
+        case Role::DRIVER:
+            return {0.0, 0.37, 1.15};
+        case Role::FRONT_PASSENGER:
+            return {0.0, -0.37, 1.15};
+        case Role::ROW_2_PASSENGER_LEFT:
+            return {-0.9, 0.4, 1.1};
+        case Role::ROW_2_PASSENGER_CENTER:
+            return {-0.9, 0.0, 1.1};
+        case Role::ROW_2_PASSENGER_RIGHT:
+            return {-0.9, -0.4, 1.1};
+        case Role::ROW_3_PASSENGER_LEFT:
+            return {-1.8, 0.4, 1.05};
+        case Role::ROW_3_PASSENGER_CENTER:
+            return {-1.8, 0.0, 1.05};
+        case Role::ROW_3_PASSENGER_RIGHT:
+            return {-1.8, -0.4, 1.05};
+        default:
+            return {};
+    }
+}
+
+OccupantDetection* findOrAddRole(std::vector<OccupantDetection>* detections, Role role) {
+    for (auto& detection : *detections) {
+        if (detection.role == role) {
+            return &detection;
+        }
+    }
+    OccupantDetection detection;
+    detection.role = role;
+    detections->push_back(std::move(detection));
+    return &detections->back();
+}
+
+}  // namespace
+
+SyntheticDetectionConfig SyntheticDetectionConfig::defaultConfig() {
+    SyntheticDetectionConfig config;
+    config.capabilities = {
+            {Role::DRIVER, IOccupantAwareness::CAP_PRESENCE_DETECTION |
+                                   IOccupantAwareness::CAP_GAZE_DETECTION |
+                                   IOccupantAwareness::CAP_DRIVER_MONITORING_DETECTION},
+            {Role::FRONT_PASSENGER, IOccupantAwareness::CAP_PRESENCE_DETECTION},
+    };
+    return config;
+}
+
+bool parseSyntheticDetectionConfig(std::istream& in, SyntheticDetectionConfig* config) {
+    SyntheticDetectionConfig parsed = *config;
+    bool hasRoles = false;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string keyword;
+        if (!(fields >> keyword) || keyword[0] == '#') {
+            continue;
+        }
+
+        bool valid = true;
+        if (keyword == "rate") {
+            valid = static_cast<bool>(fields >> parsed.rateHz) && parsed.rateHz > 0;
+        } else if (keyword == "seed") {
+            valid = static_cast<bool>(fields >> parsed.seed);
+        } else if (keyword == "confidence") {
+            auto& model = parsed.confidence;
+            valid = static_cast<bool>(fields >> model.mean >> model.jitter);
+            double dropoutRate;
+            if (valid && fields >> dropoutRate) {
+                model.dropoutRate = dropoutRate;
+            }
+            valid = valid && model.jitter >= 0.0 && model.dropoutRate >= 0.0 &&
+                    model.dropoutRate <= 1.0;
+        } else if (keyword == "role") {
+            std::string roleName;
+            Role role;
+            valid = static_cast<bool>(fields >> roleName) && parseSingleRole(roleName, &role);
+            int32_t capabilities = 0;
+            std::string capability;
+            while (valid && fields >> capability) {
+                if (capability == "presence") {
+                    capabilities |= IOccupantAwareness::CAP_PRESENCE_DETECTION;
+                } else if (capability == "gaze") {
+                    capabilities |= IOccupantAwareness::CAP_GAZE_DETECTION;
+                } else if (capability == "monitoring") {
+                    capabilities |= IOccupantAwareness::CAP_DRIVER_MONITORING_DETECTION;
+                } else {
+                    valid = false;
+                }
+            }
+            if (valid) {
+                if (!hasRoles) {
+                    parsed.capabilities.clear();
+                    hasRoles = true;
+                }
+                parsed.capabilities[role] = capabilities;
+            }
+        } else if (keyword == "trace") {
+            valid = static_cast<bool>(fields >> parsed.traceFile);
+        } else if (keyword == "maxPending") {
+            valid = static_cast<bool>(fields >> parsed.maxPendingFrames) &&
+                    parsed.maxPendingFrames > 0;
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            LOG(ERROR) << "Invalid synthetic detection config on line " << lineNumber << ": "
+                       << line;
+            return false;
+        }
+    }
+    *config = std::move(parsed);
+    return true;
+}
+
+DetectionSynthesizer::DetectionSynthesizer(const SyntheticDetectionConfig& config)
+    : mCapabilities(config.capabilities), mConfidence(config.confidence), mRandom(config.seed) {}
+
+ConfidenceLevel DetectionSynthesizer::toConfidenceLevel(double confidence) {
+    if (confidence >= 0.95) {
+        return ConfidenceLevel::MAX;
+    } else if (confidence >= 0.7) {
+        return ConfidenceLevel::HIGH;
+    } else if (confidence >= 0.3) {
+        return ConfidenceLevel::LOW;
+    }
+    return ConfidenceLevel::NONE;
+}
+
+double DetectionSynthesizer::drawConfidence() {
+    std::uniform_real_distribution<double> distribution(mConfidence.mean - mConfidence.jitter,
+                                                        mConfidence.mean + mConfidence.jitter);
+    return std::clamp(distribution(mRandom), 0.0, 1.0);
+}
+
+int64_t DetectionSynthesizer::drawMillis(int64_t min, int64_t max) {
+    return std::uniform_int_distribution<int64_t>(min, max)(mRandom);
+}
+
+void DetectionSynthesizer::updateGaze(GazeState* gaze, int64_t timeStampMillis) {
+    while (timeStampMillis >= gaze->untilMillis || timeStampMillis < gaze->sinceMillis) {
+        // The next gaze starts where the previous one ended, unless the timestamps jumped, as
+        // they do on the first frame. Then the occupant starts looking at the road.
+        const bool jumped = timeStampMillis < gaze->sinceMillis ||
+                            timeStampMillis - gaze->untilMillis > kMaxRoadMillis;
+        const int64_t since = jumped ? timeStampMillis : gaze->untilMillis;
+        if (gaze->target == VehicleRegion::FORWARD_ROADWAY && !jumped) {
+            gaze->target = kGlanceTargets[drawMillis(0, kGlanceTargets.size() - 1)];
+            gaze->untilMillis = since + drawMillis(kMinGlanceMillis, kMaxGlanceMillis);
+        } else {
+            gaze->target = VehicleRegion::FORWARD_ROADWAY;
+            gaze->untilMillis = since + drawMillis(kMinRoadMillis, kMaxRoadMillis);
+        }
+        gaze->sinceMillis = since;
+    }
+}
+
+OccupantDetections DetectionSynthesizer::next(int64_t timeStampMillis) {
+    if (!mFirstTimeStampMillis.has_value()) {
+        mFirstTimeStampMillis = timeStampMillis;
+    }
+    OccupantDetections detections;
+    detections.timeStampMillis = timeStampMillis;
+    for (const auto& [role, capabilities] : mCapabilities) {
+        OccupantDetection detection;
+        detection.role = role;
+        const bool dropped = std::uniform_real_distribution<double>(0.0, 1.0)(mRandom) <
+                             mConfidence.dropoutRate;
+
+        if (capabilities & IOccupantAwareness::CAP_PRESENCE_DETECTION && !dropped) {
+            PresenceDetection presence;
+            presence.isOccupantDetected = true;
+            presence.detectionDurationMillis = timeStampMillis - *mFirstTimeStampMillis;
+            detection.presenceData.push_back(presence);
+        }
+
+        if (capabilities & (IOccupantAwareness::CAP_GAZE_DETECTION |
+                            IOccupantAwareness::CAP_DRIVER_MONITORING_DETECTION)) {
+            GazeState& gaze = mGaze[role];
+            updateGaze(&gaze, timeStampMillis);
+            const ConfidenceLevel confidence =
+                    dropped ? ConfidenceLevel::NONE : toConfidenceLevel(drawConfidence());
+
+            if (capabilities & IOccupantAwareness::CAP_GAZE_DETECTION) {
+                GazeDetection gazeDetection;
+                gazeDetection.gazeConfidence = confidence;
+                gazeDetection.headPosition = headPosition(role);
+                gazeDetection.headAngleUnitVector = gazeVector(gaze.target);
+                gazeDetection.gazeAngleUnitVector = gazeDetection.headAngleUnitVector;
+                gazeDetection.gazeTarget = gaze.target;
+                gazeDetection.timeOnTargetMillis = timeStampMillis - gaze.sinceMillis;
+                detection.gazeData.push_back(std::move(gazeDetection));
+            }
+            if (capabilities & IOccupantAwareness::CAP_DRIVER_MONITORING_DETECTION) {
+                DriverMonitoringDetection attention;
+                attention.confidenceScore = confidence;
+                attention.isLookingOnRoad = isOnRoad(gaze.target);
+                attention.gazeDurationMillis = timeStampMillis - gaze.sinceMillis;
+                detection.attentionData.push_back(attention);
+            }
+        }
+        detections.detections.push_back(std::move(detection));
+    }
+    return detections;
+}
+
+bool DetectionTrace::parse(std::istream& in, DetectionTrace* trace) {
+    DetectionTrace parsed;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string first;
+        if (!(fields >> first) || first[0] == '#') {
+            continue;
+        }
+
+        std::istringstream offsetField(first);
+        int64_t offsetMillis;
+        std::string roleName, kind;
+        Role role;
+        bool valid = static_cast<bool>(offsetField >> offsetMillis) && offsetMillis >= 0 &&
+                     (parsed.frames.empty() || offsetMillis >= parsed.frames.back().offsetMillis) &&
+                     static_cast<bool>(fields >> roleName >> kind) &&
+                     parseSingleRole(roleName, &role);
+        if (valid && (parsed.frames.empty() || offsetMillis != parsed.frames.back().offsetMillis)) {
+            parsed.frames.push_back({.offsetMillis = offsetMillis});
+        }
+
+        std::string confidenceName;
+        ConfidenceLevel confidence;
+        if (!valid) {
+            // Reported below.
+        } else if (kind == "presence") {
+            int detected;
+            PresenceDetection presence;
+            valid = static_cast<bool>(fields >> detected >> presence.detectionDurationMillis);
+            presence.isOccupantDetected = detected != 0;
+            if (valid) {
+                findOrAddRole(&parsed.frames.back().detections, role)
+                        ->presenceData.push_back(presence);
+            }
+        } else if (kind == "gaze") {
+            std::string regionName;
+            GazeDetection gaze;
+            valid = static_cast<bool>(fields >> confidenceName >> regionName >>
+                                      gaze.timeOnTargetMillis) &&
+                    parseEnum(confidenceName, &gaze.gazeConfidence) &&
+                    parseEnum(regionName, &gaze.gazeTarget);
+            if (valid) {
+                gaze.headPosition = headPosition(role);
+                gaze.headAngleUnitVector = gazeVector(gaze.gazeTarget);
+                gaze.gazeAngleUnitVector = gaze.headAngleUnitVector;
+                findOrAddRole(&parsed.frames.back().detections, role)
+                        ->gazeData.push_back(std::move(gaze));
+            }
+        } else if (kind == "monitoring") {
+            int lookingOnRoad;
+            DriverMonitoringDetection attention;
+            valid = static_cast<bool>(fields >> confidenceName >> lookingOnRoad >>
+                                      attention.gazeDurationMillis) &&
+                    parseEnum(confidenceName, &confidence);
+            attention.confidenceScore = confidence;
+            attention.isLookingOnRoad = lookingOnRoad != 0;
+            if (valid) {
+                findOrAddRole(&parsed.frames.back().detections, role)
+                        ->attentionData.push_back(attention);
+            }
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            LOG(ERROR) << "Invalid detection trace on line " << lineNumber << ": " << line;
+            return false;
+        }
+    }
+    *trace = std::move(parsed);
+    return true;
+}
+
+SyntheticDetectionSource::SyntheticDetectionSource(SyntheticDetectionConfig config,
+                                                   DeliveryCallback callback, TimeSource now)
+    : mConfig(std::move(config)), mCallback(std::move(callback)), mNow(std::move(now)) {}
+
+SyntheticDetectionSource::~SyntheticDetectionSource() {
+    stop();
+}
+
+bool SyntheticDetectionSource::start() {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mRunning) {
+        return true;
+    }
+
+    mTrace = {};
+    mSynthesizer.reset();
+    if (!mConfig.traceFile.empty()) {
+        std::ifstream in(mConfig.traceFile);
+        if (!in || !DetectionTrace::parse(in, &mTrace) || mTrace.frames.empty()) {
+            LOG(ERROR) << "Failed to load detection trace " << mConfig.traceFile;
+            return false;
+        }
+    } else {
+        mSynthesizer.emplace(mConfig);
+    }
+
+    mRunning = true;
+    mPending.clear();
+    mLatest.reset();
+    mTimerThread = std::thread(&SyntheticDetectionSource::timerThreadLoop, this);
+    mDeliveryThread = std::thread(&SyntheticDetectionSource::deliveryThreadLoop, this);
+    return true;
+}
+
+void SyntheticDetectionSource::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mRunning = false;
+        mTimerCondition.notify_all();
+        mDeliveryCondition.notify_all();
+    }
+    if (mTimerThread.joinable()) {
+        mTimerThread.join();
+    }
+    if (mDeliveryThread.joinable()) {
+        mDeliveryThread.join();
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    mPending.clear();
+}
+
+int32_t SyntheticDetectionSource::getCapabilities(Role role) const {
+    const int roles = static_cast<int>(role);
+    int32_t capabilities = IOccupantAwareness::CAP_PRESENCE_DETECTION |
+                           IOccupantAwareness::CAP_GAZE_DETECTION |
+                           IOccupantAwareness::CAP_DRIVER_MONITORING_DETECTION;
+    for (int bit = 1; bit <= static_cast<int>(Role::ALL_OCCUPANTS); bit <<= 1) {
+        if (roles & bit) {
+            auto it = mConfig.capabilities.find(static_cast<Role>(bit));
+            capabilities &= it == mConfig.capabilities.end() ? 0 : it->second;
+        }
+    }
+    return roles == 0 ? 0 : capabilities;
+}
+
+std::optional<OccupantDetections> SyntheticDetectionSource::getLatestDetections() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mLatest;
+}
+
+SyntheticDetectionSource::Stats SyntheticDetectionSource::getStats() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mStats;
+}
+
+void SyntheticDetectionSource::timerThreadLoop() {
+    using Clock = std::chrono::steady_clock;
+    const auto period = std::chrono::microseconds(1000000 / mConfig.rateHz);
+    Clock::time_point traceStart = Clock::now();
+    Clock::time_point next = traceStart;
+    size_t traceIndex = 0;
+    if (!mSynthesizer.has_value()) {
+        next += std::chrono::milliseconds(mTrace.frames[0].offsetMillis);
+    }
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mLock);
+            if (mTimerCondition.wait_until(lock, next, [this] { return !mRunning; })) {
+                return;
+            }
+        }
+
+        OccupantDetections detections;
+        if (mSynthesizer.has_value()) {
+            detections = mSynthesizer->next(mNow());
+            next += period;
+        } else {
+            const DetectionTrace::Frame& frame = mTrace.frames[traceIndex];
+            detections.timeStampMillis = mNow();
+            detections.detections = frame.detections;
+            if (++traceIndex == mTrace.frames.size()) {
+                // The trace loops one frame period after its last frame.
+                traceIndex = 0;
+                traceStart += std::chrono::milliseconds(frame.offsetMillis) + period;
+            }
+            next = traceStart + std::chrono::milliseconds(mTrace.frames[traceIndex].offsetMillis);
+        }
+        publish(std::move(detections));
+
+        // A timer that fell behind resumes from now rather than catching up in a burst.
+        const Clock::time_point now = Clock::now();
+        if (next < now) {
+            if (mSynthesizer.has_value()) {
+                next += ((now - next) / period + 1) * period;
+            } else {
+                traceStart += now - next;
+                next = now;
+            }
+        }
+    }
+}
+
+void SyntheticDetectionSource::publish(OccupantDetections detections) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mStats.generated++;
+    mLatest = detections;
+    if (mPending.size() >= mConfig.maxPendingFrames) {
+        mPending.pop_front();
+        mStats.dropped++;
+    }
+    mPending.push_back(std::move(detections));
+    mDeliveryCondition.notify_one();
+}
+
+void SyntheticDetectionSource::deliveryThreadLoop() {
+    while (true) {
+        OccupantDetections detections;
+        {
+            std::unique_lock<std::mutex> lock(mLock);
+            mDeliveryCondition.wait(lock, [this] { return !mRunning || !mPending.empty(); });
+            if (!mRunning) {
+                return;
+            }
+            detections = std::move(mPending.front());
+            mPending.pop_front();
+        }
+        mCallback(detections);
+        std::lock_guard<std::mutex> lock(mLock);
+        mStats.delivered++;
+    }
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace occupant_awareness
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <istream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <aidl/android/hardware/automotive/occupant_awareness/IOccupantAwareness.h>
+#include <aidl/android/hardware/automotive/occupant_awareness/OccupantDetections.h>
+#include <aidl/android/hardware/automotive/occupant_awareness/VehicleRegion.h>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace occupant_awareness {
+namespace V1_0 {
+namespace implementation {
+
+using ::aidl::android::hardware::automotive::occupant_awareness::ConfidenceLevel;
+using ::aidl::android::hardware::automotive::occupant_awareness::OccupantDetection;
+using ::aidl::android::hardware::automotive::occupant_awareness::OccupantDetections;
+using ::aidl::android::hardware::automotive::occupant_awareness::Role;
+using ::aidl::android::hardware::automotive::occupant_awareness::VehicleRegion;
+
+struct SyntheticDetectionConfig {
+    // How the confidence of each detection is drawn: uniformly within jitter of mean, on a 0 to 1
+    // scale. With dropoutRate probability, an occupant isn't detected at all in a frame.
+    struct ConfidenceModel {
+        double mean = 0.85;
+        double jitter = 0.1;
+        double dropoutRate = 0.0;
+    };
+
+    // Frames per second.
+    int32_t rateHz = 30;
+    // IOccupantAwareness::CAP_* flags of each single role that is detected.
+    std::map<Role, int32_t> capabilities;
+    ConfidenceModel confidence;
+    uint32_t seed = 0;
+    // When set, frames are replayed from this trace rather than synthesized.
+    std::string traceFile;
+    // Frames waiting for a slow callback beyond this are dropped, oldest first.
+    size_t maxPendingFrames = 2;
+
+    // The driver and front passenger are detected, with every capability for the driver.
+    static SyntheticDetectionConfig defaultConfig();
+};
+
+/**
+ * Parses a configuration, one setting per line:
+ *
+ *   rate 30
+ *   seed 1
+ *   confidence <mean> <jitter> [dropoutRate]
+ *   role DRIVER presence gaze monitoring
+ *   trace /vendor/etc/occupant_awareness_trace.txt
+ *   maxPending 2
+ *
+ * Role lines replace the roles of config. Empty lines and lines starting with '#' are ignored.
+ * Returns false on malformed input.
+ */
+bool parseSyntheticDetectionConfig(std::istream& in, SyntheticDetectionConfig* config);
+
+/**
+ * Synthesizes the detections of the configured roles frame by frame. Occupants are present from
+ * the first frame on and mostly look at the road, with glances at mirrors and displays. The
+ * frames only depend on the seed and the timestamps they're made for.
+ */
+class DetectionSynthesizer {
+  public:
+    explicit DetectionSynthesizer(const SyntheticDetectionConfig& config);
+
+    OccupantDetections next(int64_t timeStampMillis);
+
+    static ConfidenceLevel toConfidenceLevel(double confidence);
+
+  private:
+    struct GazeState {
+        VehicleRegion target = VehicleRegion::FORWARD_ROADWAY;
+        int64_t sinceMillis = 0;
+        int64_t untilMillis = 0;
+    };
+
+    double drawConfidence();
+    int64_t drawMillis(int64_t min, int64_t max);
+    void updateGaze(GazeState* gaze, int64_t timeStampMillis);
+
+    const std::map<Role, int32_t> mCapabilities;
+    const SyntheticDetectionConfig::ConfidenceModel mConfidence;
+    std::mt19937 mRandom;
+    std::optional<int64_t> mFirstTimeStampMillis;
+    std::map<Role, GazeState> mGaze;
+};
+
+/**
+ * A recorded detection trace. Each line holds one detection of a role at an offset from the
+ * start of the trace, and the lines of an offset make up one frame:
+ *
+ *   <offsetMillis> <ROLE> presence <detected 0|1> <detectionDurationMillis>
+ *   <offsetMillis> <ROLE> gaze <CONFIDENCE> <VEHICLE_REGION> <timeOnTargetMillis>
+ *   <offsetMillis> <ROLE> monitoring <CONFIDENCE> <lookingOnRoad 0|1> <gazeDurationMillis>
+ *
+ * Offsets can't decrease. Empty lines and lines starting with '#' are ignored.
+ */
+struct DetectionTrace {
+    struct Frame {
+        int64_t offsetMillis = 0;
+        std::vector<OccupantDetection> detections;
+    };
+    std::vector<Frame> frames;
+
+    static bool parse(std::istream& in, DetectionTrace* trace);
+};
+
+/**
+ * Produces frames of detections on a timer thread, at the configured rate or at the offsets of
+ * a trace, which loops. Frames are handed to a separate delivery thread, so a slow callback
+ * doesn't delay the timer: while the callback is busy, at most maxPendingFrames frames wait for
+ * it, and older ones are dropped.
+ */
+class SyntheticDetectionSource {
+  public:
+    using DeliveryCallback = std::function<void(const OccupantDetections& detections)>;
+    // Returns the timestamp of a new frame, in milliseconds.
+    using TimeSource = std::function<int64_t()>;
+
+    struct Stats {
+        int64_t generated = 0;
+        int64_t delivered = 0;
+        int64_t dropped = 0;
+    };
+
+    SyntheticDetectionSource(SyntheticDetectionConfig config, DeliveryCallback callback,
+                             TimeSource now);
+    ~SyntheticDetectionSource();
+
+    // Returns false if the trace of the configuration can't be loaded.
+    bool start();
+    void stop();
+
+    // Returns the CAP_* flags supported for every occupant of the role.
+    int32_t getCapabilities(Role role) const;
+    std::optional<OccupantDetections> getLatestDetections() const;
+    Stats getStats() const;
+
+  private:
+    void timerThreadLoop();
+    void deliveryThreadLoop();
+    void publish(OccupantDetections detections);
+
+    const SyntheticDetectionConfig mConfig;
+    const DeliveryCallback mCallback;
+    const TimeSource mNow;
+
+    DetectionTrace mTrace;
+    std::optional<DetectionSynthesizer> mSynthesizer;
+
+    mutable std::mutex mLock;
+    std::condition_variable mTimerCondition;
+    std::condition_variable mDeliveryCondition;
+    bool mRunning = false;
+    std::deque<OccupantDetections> mPending;
+    std::optional<OccupantDetections> mLatest;
+    Stats mStats;
+    std::thread mTimerThread;
+    std::thread mDeliveryThread;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace occupant_awareness
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
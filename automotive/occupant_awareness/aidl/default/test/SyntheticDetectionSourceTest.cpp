@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "SyntheticDetectionSource.h"
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace occupant_awareness {
+namespace V1_0 {
+namespace implementation {
+
+using ::aidl::android::hardware::automotive::occupant_awareness::IOccupantAwareness;
+using ::std::chrono::milliseconds;
+
+namespace {
+
+constexpr int32_t kAllCapabilities = IOccupantAwareness::CAP_PRESENCE_DETECTION |
+                                     IOccupantAwareness::CAP_GAZE_DETECTION |
+                                     IOccupantAwareness::CAP_DRIVER_MONITORING_DETECTION;
+
+const OccupantDetection* findRole(const OccupantDetections& detections, Role role) {
+    for (const auto& detection : detections.detections) {
+        if (detection.role == role) {
+            return &detection;
+        }
+    }
+    return nullptr;
+}
+
+// Collects the frames delivered by a source, optionally taking its time over each.
+class FrameRecorder {
+  public:
+    explicit FrameRecorder(milliseconds delay = milliseconds(0)) : mDelay(delay) {}
+
+    SyntheticDetectionSource::DeliveryCallback callback() {
+        return [this](const OccupantDetections& detections) {
+            std::this_thread::sleep_for(mDelay);
+            std::lock_guard<std::mutex> lock(mLock);
+            mFrames.push_back(detections);
+        };
+    }
+
+    std::vector<OccupantDetections> frames() {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mFrames;
+    }
+
+  private:
+    const milliseconds mDelay;
+    std::mutex mLock;
+    std::vector<OccupantDetections> mFrames;
+};
+
+SyntheticDetectionSource::TimeSource steadyMillis() {
+    return [] {
+        return std::chrono::duration_cast<milliseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+    };
+}
+
+}  // namespace
+
+TEST(SyntheticDetectionSourceTest, ReportsTheCapabilitiesOfEveryOccupantOfARole) {
+    FrameRecorder recorder;
+    SyntheticDetectionSource source(SyntheticDetectionConfig::defaultConfig(),
+                                    recorder.callback(), steadyMillis());
+    EXPECT_EQ(source.getCapabilities(Role::DRIVER), kAllCapabilities);
+    EXPECT_EQ(source.getCapabilities(Role::FRONT_PASSENGER),
+              IOccupantAwareness::CAP_PRESENCE_DETECTION);
+    EXPECT_EQ(source.getCapabilities(Role::FRONT_OCCUPANTS),
+              IOccupantAwareness::CAP_PRESENCE_DETECTION);
+    EXPECT_EQ(source.getCapabilities(Role::ROW_2_PASSENGER_LEFT), 0);
+    EXPECT_EQ(source.getCapabilities(Role::ALL_OCCUPANTS), 0);
+}
+
+TEST(SyntheticDetectionSourceTest, SynthesizesTheConfiguredRoles) {
+    DetectionSynthesizer synthesizer(SyntheticDetectionConfig::defaultConfig());
+    bool glanced = false;
+    for (int64_t t = 1000; t < 61000; t += 33) {
+        OccupantDetections detections = synthesizer.next(t);
+        EXPECT_EQ(detections.timeStampMillis, t);
+        ASSERT_EQ(detections.detections.size(), 2u);
+
+        const OccupantDetection* driver = findRole(detections, Role::DRIVER);
+        ASSERT_NE(driver, nullptr);
+        ASSERT_EQ(driver->presenceData.size(), 1u);
+        EXPECT_TRUE(driver->presenceData[0].isOccupantDetected);
+        EXPECT_EQ(driver->presenceData[0].detectionDurationMillis, t - 1000);
+        ASSERT_EQ(driver->gazeData.size(), 1u);
+        ASSERT_EQ(driver->attentionData.size(), 1u);
+        const auto& gaze = driver->gazeData[0];
+        const auto& attention = driver->attentionData[0];
+        EXPECT_EQ(gaze.gazeAngleUnitVector.size(), 3u);
+        EXPECT_EQ(attention.isLookingOnRoad, gaze.gazeTarget == VehicleRegion::FORWARD_ROADWAY);
+        EXPECT_EQ(attention.gazeDurationMillis, gaze.timeOnTargetMillis);
+        EXPECT_LE(gaze.timeOnTargetMillis, 8000);
+        glanced |= !attention.isLookingOnRoad;
+
+        const OccupantDetection* passenger = findRole(detections, Role::FRONT_PASSENGER);
+        ASSERT_NE(passenger, nullptr);
+        EXPECT_EQ(passenger->presenceData.size(), 1u);
+        EXPECT_TRUE(passenger->gazeData.empty());
+        EXPECT_TRUE(passenger->attentionData.empty());
+    }
+    EXPECT_TRUE(glanced);
+}
+
+TEST(SyntheticDetectionSourceTest, SynthesisOnlyDependsOnTheSeed) {
+    SyntheticDetectionConfig config = SyntheticDetectionConfig::defaultConfig();
+    config.confidence = {.mean = 0.7, .jitter = 0.3, .dropoutRate = 0.1};
+    config.seed = 7;
+    DetectionSynthesizer first(config);
+    DetectionSynthesizer second(config);
+    config.seed = 8;
+    DetectionSynthesizer other(config);
+    bool differs = false;
+    for (int64_t t = 0; t < 10000; t += 33) {
+        OccupantDetections detections = first.next(t);
+        EXPECT_EQ(detections, second.next(t));
+        differs |= detections != other.next(t);
+    }
+    EXPECT_TRUE(differs);
+}
+
+TEST(SyntheticDetectionSourceTest, AppliesTheConfidenceModel) {
+    SyntheticDetectionConfig config = SyntheticDetectionConfig::defaultConfig();
+    config.confidence = {.mean = 0.5, .jitter = 0.0};
+    DetectionSynthesizer synthesizer(config);
+    for (int64_t t = 0; t < 1000; t += 33) {
+        OccupantDetections detections = synthesizer.next(t);
+        const OccupantDetection* driver = findRole(detections, Role::DRIVER);
+        ASSERT_NE(driver, nullptr);
+        EXPECT_EQ(driver->gazeData[0].gazeConfidence, ConfidenceLevel::LOW);
+        EXPECT_EQ(driver->attentionData[0].confidenceScore, ConfidenceLevel::LOW);
+    }
+
+    config.confidence.dropoutRate = 1.0;
+    DetectionSynthesizer dropping(config);
+    OccupantDetections detections = dropping.next(0);
+    const OccupantDetection* driver = findRole(detections, Role::DRIVER);
+    ASSERT_NE(driver, nullptr);
+    EXPECT_TRUE(driver->presenceData.empty());
+    EXPECT_EQ(driver->gazeData[0].gazeConfidence, ConfidenceLevel::NONE);
+
+    EXPECT_EQ(DetectionSynthesizer::toConfidenceLevel(0.2), ConfidenceLevel::NONE);
+    EXPECT_EQ(DetectionSynthesizer::toConfidenceLevel(0.8), ConfidenceLevel::HIGH);
+    EXPECT_EQ(DetectionSynthesizer::toConfidenceLevel(1.0), ConfidenceLevel::MAX);
+}
+
+TEST(SyntheticDetectionSourceTest, ParsesConfigs) {
+    std::istringstream in(
+            "# comment\n"
+            "rate 60\n"
+            "seed 3\n"
+            "confidence 0.6 0.2 0.05\n"
+            "role DRIVER presence monitoring\n"
+            "role ROW_2_PASSENGER_LEFT presence\n"
+            "maxPending 4\n"
+            "trace /data/local/tmp/trace.txt\n");
+    SyntheticDetectionConfig config = SyntheticDetectionConfig::defaultConfig();
+    ASSERT_TRUE(parseSyntheticDetectionConfig(in, &config));
+    EXPECT_EQ(config.rateHz, 60);
+    EXPECT_EQ(config.seed, 3u);
+    EXPECT_DOUBLE_EQ(config.confidence.mean, 0.6);
+    EXPECT_DOUBLE_EQ(config.confidence.jitter, 0.2);
+    EXPECT_DOUBLE_EQ(config.confidence.dropoutRate, 0.05);
+    EXPECT_EQ(config.maxPendingFrames, 4u);
+    EXPECT_EQ(config.traceFile, "/data/local/tmp/trace.txt");
+    std::map<Role, int32_t> capabilities = {
+            {Role::DRIVER, IOccupantAwareness::CAP_PRESENCE_DETECTION |
+                                   IOccupantAwareness::CAP_DRIVER_MONITORING_DETECTION},
+            {Role::ROW_2_PASSENGER_LEFT, IOccupantAwareness::CAP_PRESENCE_DETECTION},
+    };
+    EXPECT_EQ(config.capabilities, capabilities);
+
+    for (const char* invalid : {"rate 0\n", "role FRONT_OCCUPANTS presence\n",
+                                "role DRIVER hearing\n", "confidence 0.5\n", "frames 3\n"}) {
+        std::istringstream invalidIn(invalid);
+        SyntheticDetectionConfig unchanged = SyntheticDetectionConfig::defaultConfig();
+        EXPECT_FALSE(parseSyntheticDetectionConfig(invalidIn, &unchanged)) << invalid;
+        EXPECT_EQ(unchanged.rateHz, 30);
+    }
+}
+
+TEST(SyntheticDetectionSourceTest, ParsesTraces) {
+    std::istringstream in(
+            "0 DRIVER presence 1 0\n"
+            "0 DRIVER gaze HIGH LEFT_SIDE_MIRROR 200\n"
+            "0 FRONT_PASSENGER presence 1 0\n"
+            "\n"
+            "33 DRIVER monitoring LOW 0 233\n");
+    DetectionTrace trace;
+    ASSERT_TRUE(DetectionTrace::parse(in, &trace));
+    ASSERT_EQ(trace.frames.size(), 2u);
+    EXPECT_EQ(trace.frames[0].offsetMillis, 0);
+    ASSERT_EQ(trace.frames[0].detections.size(), 2u);
+    const OccupantDetection& driver = trace.frames[0].detections[0];
+    EXPECT_EQ(driver.role, Role::DRIVER);
+    EXPECT_EQ(driver.presenceData.size(), 1u);
+    ASSERT_EQ(driver.gazeData.size(), 1u);
+    EXPECT_EQ(driver.gazeData[0].gazeTarget, VehicleRegion::LEFT_SIDE_MIRROR);
+    EXPECT_EQ(driver.gazeData[0].timeOnTargetMillis, 200);
+    EXPECT_EQ(trace.frames[1].offsetMillis, 33);
+    ASSERT_EQ(trace.frames[1].detections.size(), 1u);
+    ASSERT_EQ(trace.frames[1].detections[0].attentionData.size(), 1u);
+    EXPECT_FALSE(trace.frames[1].detections[0].attentionData[0].isLookingOnRoad);
+
+    for (const char* invalid :
+         {"10 DRIVER presence 1 0\n5 DRIVER presence 1 0\n", "0 ALL_OCCUPANTS presence 1 0\n",
+          "0 DRIVER gaze HIGH DASHBOARD 0\n", "0 DRIVER blink 1\n", "x DRIVER presence 1 0\n"}) {
+        std::istringstream invalidIn(invalid);
+        EXPECT_FALSE(DetectionTrace::parse(invalidIn, &trace)) << invalid;
+    }
+}
+
+TEST(SyntheticDetectionSourceTest, DeliversAtTheConfiguredRate) {
+    SyntheticDetectionConfig config = SyntheticDetectionConfig::defaultConfig();
+    config.rateHz = 100;
+    FrameRecorder recorder;
+    SyntheticDetectionSource source(config, recorder.callback(), steadyMillis());
+    EXPECT_FALSE(source.getLatestDetections().has_value());
+    ASSERT_TRUE(source.start());
+    std::this_thread::sleep_for(milliseconds(300));
+    source.stop();
+
+    auto frames = recorder.frames();
+    auto stats = source.getStats();
+    EXPECT_GE(stats.generated, 10);
+    EXPECT_LE(stats.generated, 35);
+    EXPECT_EQ(stats.delivered, static_cast<int64_t>(frames.size()));
+    for (size_t i = 1; i < frames.size(); i++) {
+        EXPECT_GT(frames[i].timeStampMillis, frames[i - 1].timeStampMillis);
+    }
+    ASSERT_TRUE(source.getLatestDetections().has_value());
+    EXPECT_GE(source.getLatestDetections()->timeStampMillis, frames.back().timeStampMillis);
+}
+
+TEST(SyntheticDetectionSourceTest, DropsFramesForASlowCallback) {
+    SyntheticDetectionConfig config = SyntheticDetectionConfig::defaultConfig();
+    config.rateHz = 200;
+    config.maxPendingFrames = 2;
+    FrameRecorder recorder(milliseconds(50));
+    SyntheticDetectionSource source(config, recorder.callback(), steadyMillis());
+    ASSERT_TRUE(source.start());
+    std::this_thread::sleep_for(milliseconds(300));
+    auto latest = source.getLatestDetections();
+    source.stop();
+
+    auto stats = source.getStats();
+    // The timer keeps its rate, and the callback only sees a fraction of the frames.
+    EXPECT_GE(stats.generated, 30);
+    EXPECT_LE(stats.delivered, 8);
+    EXPECT_GE(stats.dropped, stats.generated - stats.delivered - 2);
+    ASSERT_TRUE(latest.has_value());
+    auto frames = recorder.frames();
+    ASSERT_FALSE(frames.empty());
+    EXPECT_GE(latest->timeStampMillis, frames.back().timeStampMillis);
+}
+
+TEST(SyntheticDetectionSourceTest, ReplaysTraces) {
+    TemporaryFile file;
+    ASSERT_TRUE(android::base::WriteStringToFile(
+            "0 DRIVER presence 1 0\n"
+            "20 DRIVER presence 0 0\n"
+            "40 FRONT_PASSENGER presence 1 40\n",
+            file.path));
+    SyntheticDetectionConfig config = SyntheticDetectionConfig::defaultConfig();
+    config.rateHz = 50;
+    config.traceFile = file.path;
+    FrameRecorder recorder;
+    SyntheticDetectionSource source(config, recorder.callback(), steadyMillis());
+    ASSERT_TRUE(source.start());
+    // The trace lasts 60ms, one frame period after its last frame.
+    std::this_thread::sleep_for(milliseconds(150));
+    source.stop();
+
+    auto frames = recorder.frames();
+    ASSERT_GE(frames.size(), 5u);
+    for (size_t i = 0; i < frames.size(); i++) {
+        ASSERT_EQ(frames[i].detections.size(), 1u);
+        const OccupantDetection& detection = frames[i].detections[0];
+        switch (i % 3) {
+            case 0:
+                EXPECT_EQ(detection.role, Role::DRIVER);
+                EXPECT_TRUE(detection.presenceData[0].isOccupantDetected);
+                break;
+            case 1:
+                EXPECT_EQ(detection.role, Role::DRIVER);
+                EXPECT_FALSE(detection.presenceData[0].isOccupantDetected);
+                break;
+            case 2:
+                EXPECT_EQ(detection.role, Role::FRONT_PASSENGER);
+                break;
+        }
+    }
+}
+
+TEST(SyntheticDetectionSourceTest, FailsToStartWithoutItsTrace) {
+    SyntheticDetectionConfig config = SyntheticDetectionConfig::defaultConfig();
+    config.traceFile = "/nonexistent/trace.txt";
+    FrameRecorder recorder;
+    SyntheticDetectionSource source(config, recorder.callback(), steadyMillis());
+    EXPECT_FALSE(source.start());
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace occupant_awareness
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Clock.h"
+
+#include <iterator>
+
+#include "CancellationSignal.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+namespace {
+
+// How often VirtualClock::waitUntil checks for cancellation while the clock isn't moving.
+constexpr std::chrono::milliseconds CANCELLATION_POLL_INTERVAL{10};
+
+}  // namespace
+
+std::chrono::milliseconds SystemClock::now() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch());
+}
+
+bool SystemClock::waitUntil(std::chrono::milliseconds deadline,
+                            const std::future<void>& cancellationFuture) {
+    if (deadline == std::chrono::milliseconds::max()) {
+        cancellationFuture.wait();
+        return false;
+    }
+    return cancellationFuture.wait_until(std::chrono::steady_clock::time_point(deadline)) !=
+           std::future_status::ready;
+}
+
+std::chrono::milliseconds VirtualClock::now() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mNow;
+}
+
+bool VirtualClock::waitUntil(std::chrono::milliseconds deadline,
+                             const std::future<void>& cancellationFuture) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    auto it = mDeadlines.insert(deadline);
+    mCond.notify_all();
+    while (mNow < deadline && !shouldCancel(cancellationFuture)) {
+        mCond.wait_for(lock, CANCELLATION_POLL_INTERVAL);
+    }
+    mDeadlines.erase(it);
+    return !shouldCancel(cancellationFuture);
+}
+
+void VirtualClock::advance(std::chrono::milliseconds duration) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mNow += duration;
+    }
+    mCond.notify_all();
+}
+
+void VirtualClock::waitForWaiters(size_t count) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCond.wait(lock, [this, count] {
+        auto pending = std::distance(mDeadlines.upper_bound(mNow), mDeadlines.end());
+        return static_cast<size_t>(pending) >= count;
+    });
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
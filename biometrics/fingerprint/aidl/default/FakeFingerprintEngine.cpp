@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FakeFingerprintEngine.h"
+
+#include <algorithm>
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+void FakeFingerprintEngine::enrollImpl(ISessionCallback* cb,
+                                       const keymaster::HardwareAuthToken& hat,
+                                       const std::future<void>& cancellationFuture) {
+    LOG(INFO) << "enrollImpl";
+    // Do proper HAT verification in the real implementation.
+    if (hat.mac.empty()) {
+        cb->onError(Error::UNABLE_TO_PROCESS, 0 /* vendorError */);
+        return;
+    }
+    runScenario(cb, nextScenario(mScenarios.enroll, &mNextEnroll), cancellationFuture);
+}
+
+void FakeFingerprintEngine::authenticateImpl(ISessionCallback* cb, int64_t /* operationId */,
+                                             const std::future<void>& cancellationFuture) {
+    LOG(INFO) << "authenticateImpl";
+    if (checkLockout(cb)) {
+        return;
+    }
+    runScenario(cb, nextScenario(mScenarios.authenticate, &mNextAuthenticate), cancellationFuture);
+}
+
+void FakeFingerprintEngine::detectInteractionImpl(ISessionCallback* cb,
+                                                  const std::future<void>& cancellationFuture) {
+    LOG(INFO) << "detectInteractionImpl";
+    runScenario(cb, nextScenario(mScenarios.detectInteraction, &mNextDetectInteraction),
+                cancellationFuture);
+}
+
+const Scenario& FakeFingerprintEngine::nextScenario(const std::vector<Scenario>& scenarios,
+                                                    size_t* next) {
+    CHECK(!scenarios.empty());
+    const size_t index = std::min(*next, scenarios.size() - 1);
+    *next = index + 1;
+    return scenarios[index];
+}
+
+bool FakeFingerprintEngine::checkLockout(ISessionCallback* cb) {
+    switch (mLockout) {
+        case Lockout::NONE:
+            return false;
+        case Lockout::PERMANENT:
+            cb->onLockoutPermanent();
+            return true;
+        case Lockout::TIMED: {
+            const auto now = mClock->now();
+            if (now >= mLockoutEnd) {
+                mLockout = Lockout::NONE;
+                return false;
+            }
+            cb->onLockoutTimed((mLockoutEnd - now).count());
+            return true;
+        }
+    }
+    return false;
+}
+
+void FakeFingerprintEngine::runScenario(ISessionCallback* cb, const Scenario& scenario,
+                                        const std::future<void>& cancellationFuture) {
+    // Deadlines are relative to the start of the operation rather than to the previous step, so
+    // that a slow callback doesn't delay the rest of the scenario.
+    auto deadline = mClock->now();
+    for (const ScenarioStep& step : scenario) {
+        deadline += step.delay;
+        if (!mClock->waitUntil(deadline, cancellationFuture)) {
+            cb->onError(Error::CANCELED, 0 /* vendorCode */);
+            return;
+        }
+        runStep(cb, step);
+        if (step.isTerminal()) {
+            return;
+        }
+    }
+
+    // Nothing ends the operation, keep it running until the framework gives up on it.
+    mClock->waitUntil(std::chrono::milliseconds::max(), cancellationFuture);
+    cb->onError(Error::CANCELED, 0 /* vendorCode */);
+}
+
+void FakeFingerprintEngine::runStep(ISessionCallback* cb, const ScenarioStep& step) {
+    using Type = ScenarioStep::Type;
+    switch (step.type) {
+        case Type::ACQUIRED:
+            cb->onAcquired(step.acquiredInfo, step.vendorCode);
+            break;
+        case Type::ENROLLMENT_PROGRESS:
+            cb->onEnrollmentProgress(step.enrollmentId, step.remaining);
+            break;
+        case Type::AUTHENTICATION_SUCCEEDED:
+            cb->onAuthenticationSucceeded(step.enrollmentId, {} /* hat */);
+            break;
+        case Type::AUTHENTICATION_FAILED:
+            cb->onAuthenticationFailed();
+            break;
+        case Type::INTERACTION_DETECTED:
+            cb->onInteractionDetected();
+            break;
+        case Type::ERROR:
+            cb->onError(step.error, step.vendorCode);
+            break;
+        case Type::LOCKOUT_TIMED:
+            mLockout = Lockout::TIMED;
+            mLockoutEnd = mClock->now() + step.lockoutDuration;
+            cb->onLockoutTimed(step.lockoutDuration.count());
+            break;
+        case Type::LOCKOUT_PERMANENT:
+            mLockout = Lockout::PERMANENT;
+            cb->onLockoutPermanent();
+            break;
+    }
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -16,6 +16,8 @@
 
 #include "Fingerprint.h"
 
+#include <unistd.h>
+
 #include "Session.h"
 
 namespace aidl::android::hardware::biometrics::fingerprint {
@@ -32,11 +34,24 @@ constexpr char FW_VERSION[] = "1.01";
 constexpr char SERIAL_NUMBER[] = "00000001";
 constexpr char SW_COMPONENT_ID[] = "matchingAlgorithm";
 constexpr char SW_VERSION[] = "vendor/version/revision";
+// Optional scenario file for FakeFingerprintEngine, see Scenario.h for the format.
+constexpr char SCENARIOS_PATH[] = "/data/vendor/fingerprint/scenarios.txt";
+
+std::unique_ptr<FakeFingerprintEngine> createEngine() {
+    if (access(SCENARIOS_PATH, F_OK) == 0) {
+        if (auto scenarios = loadScenarios(SCENARIOS_PATH)) {
+            LOG(INFO) << "Using the scenarios from " << SCENARIOS_PATH;
+            return std::make_unique<FakeFingerprintEngine>(std::move(*scenarios),
+                                                           std::make_shared<SystemClock>());
+        }
+        LOG(ERROR) << "Ignoring invalid scenario file " << SCENARIOS_PATH;
+    }
+    return std::make_unique<FakeFingerprintEngine>();
+}
 
 }  // namespace
 
-Fingerprint::Fingerprint()
-    : mEngine(std::make_unique<FakeFingerprintEngine>()), mWorker(MAX_WORKER_QUEUE_SIZE) {}
+Fingerprint::Fingerprint() : mEngine(createEngine()), mWorker(MAX_WORKER_QUEUE_SIZE) {}
 
 ndk::ScopedAStatus Fingerprint::getSensorProps(std::vector<SensorProps>* out) {
     std::vector<common::ComponentInfo> componentInfo = {
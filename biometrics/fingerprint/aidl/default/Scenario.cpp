@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Scenario.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+#include <android/binder_enums.h>
+
+#include <algorithm>
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+namespace {
+
+using Type = ScenarioStep::Type;
+
+struct Operation {
+    const char* name;
+    std::vector<Scenario> Scenarios::*scenarios;
+    std::vector<Type> allowedTypes;
+};
+
+const std::vector<Operation>& operations() {
+    static const std::vector<Operation> kOperations = {
+            {"enroll", &Scenarios::enroll, {Type::ENROLLMENT_PROGRESS}},
+            {"authenticate",
+             &Scenarios::authenticate,
+             {Type::AUTHENTICATION_SUCCEEDED, Type::AUTHENTICATION_FAILED, Type::LOCKOUT_TIMED,
+              Type::LOCKOUT_PERMANENT}},
+            {"detect_interaction", &Scenarios::detectInteraction, {Type::INTERACTION_DETECTED}},
+    };
+    return kOperations;
+}
+
+struct Event {
+    const char* name;
+    Type type;
+    size_t minArgs;
+    size_t maxArgs;
+};
+
+constexpr Event EVENTS[] = {
+        {"acquired", Type::ACQUIRED, 1, 2},
+        {"enrollment_progress", Type::ENROLLMENT_PROGRESS, 2, 2},
+        {"authentication_succeeded", Type::AUTHENTICATION_SUCCEEDED, 1, 1},
+        {"authentication_failed", Type::AUTHENTICATION_FAILED, 0, 0},
+        {"interaction_detected", Type::INTERACTION_DETECTED, 0, 0},
+        {"error", Type::ERROR, 1, 2},
+        {"lockout_timed", Type::LOCKOUT_TIMED, 1, 1},
+        {"lockout_permanent", Type::LOCKOUT_PERMANENT, 0, 0},
+};
+
+// Accepts either the name of an AIDL enumerator or its numeric value.
+template <typename E>
+bool parseEnum(const std::string& s, E* out) {
+    for (E value : ndk::enum_range<E>()) {
+        if (toString(value) == s) {
+            *out = value;
+            return true;
+        }
+    }
+    std::underlying_type_t<E> value;
+    if (!::android::base::ParseInt(s, &value)) {
+        return false;
+    }
+    *out = static_cast<E>(value);
+    return true;
+}
+
+bool parseStep(const std::vector<std::string>& tokens, ScenarioStep* step) {
+    int64_t delay;
+    if (!::android::base::ParseInt(tokens[0], &delay, int64_t{0})) {
+        return false;
+    }
+    step->delay = std::chrono::milliseconds(delay);
+
+    if (tokens.size() < 2) {
+        return false;
+    }
+    const Event* event = nullptr;
+    for (const Event& e : EVENTS) {
+        if (tokens[1] == e.name) {
+            event = &e;
+        }
+    }
+    const size_t numArgs = tokens.size() - 2;
+    if (event == nullptr || numArgs < event->minArgs || numArgs > event->maxArgs) {
+        return false;
+    }
+    step->type = event->type;
+    const std::string* args = tokens.data() + 2;
+
+    switch (step->type) {
+        case Type::ACQUIRED:
+            return parseEnum(args[0], &step->acquiredInfo) &&
+                   (numArgs < 2 || ::android::base::ParseInt(args[1], &step->vendorCode));
+        case Type::ENROLLMENT_PROGRESS:
+            return ::android::base::ParseInt(args[0], &step->enrollmentId) &&
+                   ::android::base::ParseInt(args[1], &step->remaining, 0);
+        case Type::AUTHENTICATION_SUCCEEDED:
+            return ::android::base::ParseInt(args[0], &step->enrollmentId);
+        case Type::ERROR:
+            return parseEnum(args[0], &step->error) &&
+                   (numArgs < 2 || ::android::base::ParseInt(args[1], &step->vendorCode));
+        case Type::LOCKOUT_TIMED: {
+            int64_t duration;
+            if (!::android::base::ParseInt(args[0], &duration, int64_t{0})) {
+                return false;
+            }
+            step->lockoutDuration = std::chrono::milliseconds(duration);
+            return true;
+        }
+        case Type::AUTHENTICATION_FAILED:
+        case Type::INTERACTION_DETECTED:
+        case Type::LOCKOUT_PERMANENT:
+            return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+bool ScenarioStep::isTerminal() const {
+    switch (type) {
+        case Type::ACQUIRED:
+        case Type::AUTHENTICATION_FAILED:
+            return false;
+        case Type::ENROLLMENT_PROGRESS:
+            return remaining == 0;
+        case Type::AUTHENTICATION_SUCCEEDED:
+        case Type::INTERACTION_DETECTED:
+        case Type::ERROR:
+        case Type::LOCKOUT_TIMED:
+        case Type::LOCKOUT_PERMANENT:
+            return true;
+    }
+    return true;
+}
+
+Scenarios Scenarios::defaults() {
+    ScenarioStep enrolled;
+    enrolled.type = Type::ENROLLMENT_PROGRESS;
+
+    ScenarioStep authenticated;
+    authenticated.type = Type::AUTHENTICATION_SUCCEEDED;
+
+    ScenarioStep detected;
+    detected.type = Type::INTERACTION_DETECTED;
+
+    return {{{enrolled}}, {{authenticated}}, {{detected}}};
+}
+
+std::optional<Scenarios> parseScenarios(std::string_view text) {
+    Scenarios result;
+    const Operation* operation = nullptr;
+    Scenario* scenario = nullptr;
+
+    const auto lines = ::android::base::Split(std::string(text), "\n");
+    for (size_t i = 0; i < lines.size(); ++i) {
+        const std::string line = ::android::base::Trim(lines[i]);
+        const size_t lineNumber = i + 1;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        if (line.front() == '[' && line.back() == ']') {
+            const std::string name = line.substr(1, line.size() - 2);
+            operation = nullptr;
+            for (const Operation& op : operations()) {
+                if (name == op.name) {
+                    operation = &op;
+                }
+            }
+            if (operation == nullptr) {
+                LOG(ERROR) << "Line " << lineNumber << ": unknown operation: " << name;
+                return std::nullopt;
+            }
+            scenario = &(result.*operation->scenarios).emplace_back();
+            continue;
+        }
+
+        if (scenario == nullptr) {
+            LOG(ERROR) << "Line " << lineNumber << ": step outside of a scenario";
+            return std::nullopt;
+        }
+        if (!scenario->empty() && scenario->back().isTerminal()) {
+            LOG(ERROR) << "Line " << lineNumber << ": step after the end of the operation";
+            return std::nullopt;
+        }
+
+        ScenarioStep step;
+        if (!parseStep(::android::base::Tokenize(line, " \t"), &step)) {
+            LOG(ERROR) << "Line " << lineNumber << ": invalid step: " << line;
+            return std::nullopt;
+        }
+        const auto& allowed = operation->allowedTypes;
+        if (step.type != Type::ACQUIRED && step.type != Type::ERROR &&
+            std::find(allowed.begin(), allowed.end(), step.type) == allowed.end()) {
+            LOG(ERROR) << "Line " << lineNumber << ": invalid event for " << operation->name;
+            return std::nullopt;
+        }
+        scenario->push_back(step);
+    }
+
+    // Operations that aren't scripted behave as if there was no scenario file.
+    const Scenarios defaults = Scenarios::defaults();
+    for (const Operation& op : operations()) {
+        if ((result.*op.scenarios).empty()) {
+            result.*op.scenarios = defaults.*op.scenarios;
+        }
+    }
+    return result;
+}
+
+std::optional<Scenarios> loadScenarios(const std::string& path) {
+    std::string text;
+    if (!::android::base::ReadFileToString(path, &text)) {
+        PLOG(ERROR) << "Failed to read " << path;
+        return std::nullopt;
+    }
+    return parseScenarios(text);
+}
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
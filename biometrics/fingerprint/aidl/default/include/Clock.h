@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <set>
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// Source of time for FakeFingerprintEngine. Scenario steps are scheduled against a Clock so that
+// tests can replace wall-clock time with a VirtualClock and step through a scenario
+// deterministically.
+class Clock {
+  public:
+    virtual ~Clock() = default;
+
+    // Returns the time elapsed since an arbitrary, fixed epoch.
+    virtual std::chrono::milliseconds now() = 0;
+
+    // Blocks until now() reaches the given deadline or cancellationFuture becomes ready, whichever
+    // happens first. Returns false if the wait was cancelled. A deadline of
+    // std::chrono::milliseconds::max() waits for cancellation only.
+    virtual bool waitUntil(std::chrono::milliseconds deadline,
+                           const std::future<void>& cancellationFuture) = 0;
+};
+
+// Clock backed by std::chrono::steady_clock.
+class SystemClock final : public Clock {
+  public:
+    std::chrono::milliseconds now() override;
+
+    bool waitUntil(std::chrono::milliseconds deadline,
+                   const std::future<void>& cancellationFuture) override;
+};
+
+// Clock that only moves when advance() is called. Meant for tests.
+class VirtualClock final : public Clock {
+  public:
+    std::chrono::milliseconds now() override;
+
+    // Cancellation is also noticed without advancing the clock, although not immediately.
+    bool waitUntil(std::chrono::milliseconds deadline,
+                   const std::future<void>& cancellationFuture) override;
+
+    // Moves the clock forward and wakes up the threads whose deadline has been reached.
+    void advance(std::chrono::milliseconds duration);
+
+    // Blocks until at least the given number of threads are waiting in waitUntil for a deadline
+    // that hasn't been reached yet. This lets a test know that the worker thread has handled
+    // everything that was due and is waiting for its next step.
+    void waitForWaiters(size_t count);
+
+  private:
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    std::chrono::milliseconds mNow{0};
+    // Deadlines of the threads in waitUntil.
+    std::multiset<std::chrono::milliseconds> mDeadlines;
+};
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
@@ -16,14 +16,29 @@
 
 #pragma once
 
+#include <aidl/android/hardware/biometrics/fingerprint/ISessionCallback.h>
 #include <android-base/logging.h>
+
+#include <future>
+#include <memory>
 #include <random>
 
+#include "Clock.h"
+#include "Scenario.h"
+
 namespace aidl::android::hardware::biometrics::fingerprint {
 
+// Plays the scripted Scenarios for the operations that report progress (enroll, authenticate and
+// detectInteraction), and answers all other operations immediately.
 class FakeFingerprintEngine {
   public:
-    FakeFingerprintEngine() : mRandom(std::mt19937::default_seed) {}
+    FakeFingerprintEngine()
+        : FakeFingerprintEngine(Scenarios::defaults(), std::make_shared<SystemClock>()) {}
+
+    FakeFingerprintEngine(Scenarios scenarios, std::shared_ptr<Clock> clock)
+        : mRandom(std::mt19937::default_seed),
+          mScenarios(std::move(scenarios)),
+          mClock(std::move(clock)) {}
 
     void generateChallengeImpl(ISessionCallback* cb) {
         LOG(INFO) << "generateChallengeImpl";
@@ -37,25 +52,15 @@ class FakeFingerprintEngine {
         cb->onChallengeRevoked(challenge);
     }
 
-    void enrollImpl(ISessionCallback* cb, const keymaster::HardwareAuthToken& hat) {
-        LOG(INFO) << "enrollImpl";
-        // Do proper HAT verification in the real implementation.
-        if (hat.mac.empty()) {
-            cb->onError(Error::UNABLE_TO_PROCESS, 0 /* vendorError */);
-            return;
-        }
-        cb->onEnrollmentProgress(0 /* enrollmentId */, 0 /* remaining */);
-    }
+    // The cancellable operations play their next scenario until it ends or cancellationFuture
+    // becomes ready, in which case Error::CANCELED is reported.
+    void enrollImpl(ISessionCallback* cb, const keymaster::HardwareAuthToken& hat,
+                    const std::future<void>& cancellationFuture);
 
-    void authenticateImpl(ISessionCallback* cb, int64_t /* operationId */) {
-        LOG(INFO) << "authenticateImpl";
-        cb->onAuthenticationSucceeded(0 /* enrollmentId */, {} /* hat */);
-    }
+    void authenticateImpl(ISessionCallback* cb, int64_t operationId,
+                          const std::future<void>& cancellationFuture);
 
-    void detectInteractionImpl(ISessionCallback* cb) {
-        LOG(INFO) << "detectInteractionImpl";
-        cb->onInteractionDetected();
-    }
+    void detectInteractionImpl(ISessionCallback* cb, const std::future<void>& cancellationFuture);
 
     void enumerateEnrollmentsImpl(ISessionCallback* cb) {
         LOG(INFO) << "enumerateEnrollmentsImpl";
@@ -79,10 +84,36 @@ class FakeFingerprintEngine {
 
     void resetLockoutImpl(ISessionCallback* cb, const keymaster::HardwareAuthToken& /*hat*/) {
         LOG(INFO) << "resetLockoutImpl";
+        mLockout = Lockout::NONE;
         cb->onLockoutCleared();
     }
 
     std::mt19937 mRandom;
+
+  private:
+    enum class Lockout { NONE, TIMED, PERMANENT };
+
+    // Returns the scenario the next run of an operation plays, see Scenarios.
+    static const Scenario& nextScenario(const std::vector<Scenario>& scenarios, size_t* next);
+
+    // Reports the lockout to cb and returns true if authentication is currently locked out.
+    bool checkLockout(ISessionCallback* cb);
+
+    void runScenario(ISessionCallback* cb, const Scenario& scenario,
+                     const std::future<void>& cancellationFuture);
+
+    void runStep(ISessionCallback* cb, const ScenarioStep& step);
+
+    const Scenarios mScenarios;
+    const std::shared_ptr<Clock> mClock;
+
+    // The state below is only accessed from the worker thread.
+    size_t mNextEnroll = 0;
+    size_t mNextAuthenticate = 0;
+    size_t mNextDetectInteraction = 0;
+
+    Lockout mLockout = Lockout::NONE;
+    std::chrono::milliseconds mLockoutEnd{0};
 };
 
 }  // namespace aidl::android::hardware::biometrics::fingerprint
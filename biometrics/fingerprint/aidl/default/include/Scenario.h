@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/biometrics/fingerprint/AcquiredInfo.h>
+#include <aidl/android/hardware/biometrics/fingerprint/Error.h>
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+
+// A single event reported by FakeFingerprintEngine while it runs a scenario.
+struct ScenarioStep {
+    enum class Type {
+        ACQUIRED,
+        ENROLLMENT_PROGRESS,
+        AUTHENTICATION_SUCCEEDED,
+        AUTHENTICATION_FAILED,
+        INTERACTION_DETECTED,
+        ERROR,
+        LOCKOUT_TIMED,
+        LOCKOUT_PERMANENT,
+    };
+
+    // Time between the previous step, or the start of the operation, and this step.
+    std::chrono::milliseconds delay{0};
+    Type type = Type::ACQUIRED;
+
+    // Arguments, only the ones relevant to the type are used.
+    AcquiredInfo acquiredInfo = AcquiredInfo::UNKNOWN;
+    Error error = Error::UNKNOWN;
+    int32_t vendorCode = 0;
+    int32_t enrollmentId = 0;
+    int32_t remaining = 0;
+    std::chrono::milliseconds lockoutDuration{0};
+
+    // Whether the operation ends with this step.
+    bool isTerminal() const;
+};
+
+using Scenario = std::vector<ScenarioStep>;
+
+// Scenarios for each of the operations that report progress. Every time an operation runs, it
+// plays the next of its scenarios, and the last one again once they have all been played.
+struct Scenarios {
+    std::vector<Scenario> enroll;
+    std::vector<Scenario> authenticate;
+    std::vector<Scenario> detectInteraction;
+
+    // The behavior of the engine without a scenario file: every operation succeeds immediately.
+    static Scenarios defaults();
+};
+
+// Parses a scenario file. The file is made of sections, each of them adding a scenario to an
+// operation. Steps are listed one per line, as a delay in milliseconds followed by an event:
+//
+//   # Two failed attempts, then lockout.
+//   [authenticate]
+//   0 acquired START
+//   300 acquired GOOD
+//   50 authentication_failed
+//   700 acquired PARTIAL
+//   50 authentication_failed
+//   50 lockout_timed 30000
+//
+// The operations are enroll, authenticate and detect_interaction. The events are:
+//   acquired <AcquiredInfo> [vendorCode]
+//   enrollment_progress <enrollmentId> <remaining>
+//   authentication_succeeded <enrollmentId>
+//   authentication_failed
+//   interaction_detected
+//   error <Error> [vendorCode]
+//   lockout_timed <durationMillis>
+//   lockout_permanent
+//
+// enrollment_progress with nothing remaining, authentication_succeeded, interaction_detected,
+// error and lockouts end the operation, so they can only be the last step of a scenario. A
+// scenario without such a step keeps the operation running until it's cancelled, like a sensor
+// waiting for a finger. Operations without a scenario use the defaults.
+//
+// Returns std::nullopt and logs the offending line if the text is malformed.
+std::optional<Scenarios> parseScenarios(std::string_view text);
+
+// Reads and parses a scenario file. Returns std::nullopt if it can't be read or parsed.
+std::optional<Scenarios> loadScenarios(const std::string& path);
+
+}  // namespace aidl::android::hardware::biometrics::fingerprint
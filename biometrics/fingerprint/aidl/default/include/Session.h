@@ -99,6 +99,9 @@ class Session : public BnSession {
 
     bool isClosed();
 
+    // The state the session is in, for tests. It changes on the worker thread.
+    SessionState getCurrentState();
+
   private:
     // Crashes the HAL if it's not currently idling because that would be an invalid state machine
     // transition. Otherwise, sets the scheduled state to the given state.
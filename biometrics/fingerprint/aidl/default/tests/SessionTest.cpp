@@ -0,0 +1,542 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <aidl/android/hardware/biometrics/fingerprint/BnSessionCallback.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FakeFingerprintEngine.h"
+#include "Session.h"
+#include "WorkerThread.h"
+
+namespace aidl::android::hardware::biometrics::fingerprint {
+namespace {
+
+using namespace std::chrono_literals;
+
+constexpr size_t MAX_WORKER_QUEUE_SIZE = 5;
+
+const char* stateName(SessionState state) {
+    switch (state) {
+        case SessionState::IDLING:
+            return "IDLING";
+        case SessionState::CLOSED:
+            return "CLOSED";
+        case SessionState::GENERATING_CHALLENGE:
+            return "GENERATING_CHALLENGE";
+        case SessionState::REVOKING_CHALLENGE:
+            return "REVOKING_CHALLENGE";
+        case SessionState::ENROLLING:
+            return "ENROLLING";
+        case SessionState::AUTHENTICATING:
+            return "AUTHENTICATING";
+        case SessionState::DETECTING_INTERACTION:
+            return "DETECTING_INTERACTION";
+        case SessionState::ENUMERATING_ENROLLMENTS:
+            return "ENUMERATING_ENROLLMENTS";
+        case SessionState::REMOVING_ENROLLMENTS:
+            return "REMOVING_ENROLLMENTS";
+        case SessionState::GETTING_AUTHENTICATOR_ID:
+            return "GETTING_AUTHENTICATOR_ID";
+        case SessionState::INVALIDATING_AUTHENTICATOR_ID:
+            return "INVALIDATING_AUTHENTICATOR_ID";
+        case SessionState::RESETTING_LOCKOUT:
+            return "RESETTING_LOCKOUT";
+    }
+    return "?";
+}
+
+// Records every callback along with the state the session was in when it was called.
+class TestSessionCallback : public BnSessionCallback {
+  public:
+    void setSession(Session* session) { mSession = session; }
+
+    std::vector<std::string> takeEvents() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return std::move(mEvents);
+    }
+
+    ndk::ScopedAStatus onChallengeGenerated(int64_t /*challenge*/) override {
+        return record("onChallengeGenerated");
+    }
+    ndk::ScopedAStatus onChallengeRevoked(int64_t challenge) override {
+        return record("onChallengeRevoked " + std::to_string(challenge));
+    }
+    ndk::ScopedAStatus onAcquired(AcquiredInfo info, int32_t vendorCode) override {
+        return record("onAcquired " + toString(info) + " " + std::to_string(vendorCode));
+    }
+    ndk::ScopedAStatus onError(Error error, int32_t vendorCode) override {
+        return record("onError " + toString(error) + " " + std::to_string(vendorCode));
+    }
+    ndk::ScopedAStatus onEnrollmentProgress(int32_t enrollmentId, int32_t remaining) override {
+        return record("onEnrollmentProgress " + std::to_string(enrollmentId) + " " +
+                      std::to_string(remaining));
+    }
+    ndk::ScopedAStatus onAuthenticationSucceeded(
+            int32_t enrollmentId, const keymaster::HardwareAuthToken& /*hat*/) override {
+        return record("onAuthenticationSucceeded " + std::to_string(enrollmentId));
+    }
+    ndk::ScopedAStatus onAuthenticationFailed() override {
+        return record("onAuthenticationFailed");
+    }
+    ndk::ScopedAStatus onLockoutTimed(int64_t durationMillis) override {
+        return record("onLockoutTimed " + std::to_string(durationMillis));
+    }
+    ndk::ScopedAStatus onLockoutPermanent() override { return record("onLockoutPermanent"); }
+    ndk::ScopedAStatus onLockoutCleared() override { return record("onLockoutCleared"); }
+    ndk::ScopedAStatus onInteractionDetected() override {
+        return record("onInteractionDetected");
+    }
+    ndk::ScopedAStatus onEnrollmentsEnumerated(
+            const std::vector<int32_t>& /*enrollmentIds*/) override {
+        return record("onEnrollmentsEnumerated");
+    }
+    ndk::ScopedAStatus onEnrollmentsRemoved(
+            const std::vector<int32_t>& /*enrollmentIds*/) override {
+        return record("onEnrollmentsRemoved");
+    }
+    ndk::ScopedAStatus onAuthenticatorIdRetrieved(int64_t /*authenticatorId*/) override {
+        return record("onAuthenticatorIdRetrieved");
+    }
+    ndk::ScopedAStatus onAuthenticatorIdInvalidated(int64_t /*newAuthenticatorId*/) override {
+        return record("onAuthenticatorIdInvalidated");
+    }
+    ndk::ScopedAStatus onSessionClosed() override { return record("onSessionClosed"); }
+
+  private:
+    ndk::ScopedAStatus record(const std::string& event) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mEvents.push_back(event + " @" + stateName(mSession->getCurrentState()));
+        return ndk::ScopedAStatus::ok();
+    }
+
+    Session* mSession = nullptr;
+    std::mutex mMutex;
+    std::vector<std::string> mEvents;
+};
+
+using Events = std::vector<std::string>;
+
+class SessionTest : public ::testing::Test {
+  protected:
+    void SetUp() override { startSession(Scenarios::defaults()); }
+
+    void TearDown() override {
+        // Don't leave the worker blocked on the virtual clock.
+        mClock->advance(24h);
+    }
+
+    void startSession(Scenarios scenarios) {
+        mEngine = std::make_unique<FakeFingerprintEngine>(std::move(scenarios), mClock);
+        mCb = ndk::SharedRefBase::make<TestSessionCallback>();
+        mSession = ndk::SharedRefBase::make<Session>(0 /* sensorId */, 0 /* userId */, mCb,
+                                                     mEngine.get(), &mWorker);
+        mCb->setSession(mSession.get());
+    }
+
+    void startSession(std::string_view scenarioText) {
+        auto scenarios = parseScenarios(scenarioText);
+        ASSERT_TRUE(scenarios.has_value());
+        startSession(std::move(*scenarios));
+    }
+
+    // Waits until the worker has finished everything that was scheduled before.
+    void sync() {
+        std::promise<void> promise;
+        auto future = promise.get_future();
+        ASSERT_TRUE(mWorker.schedule(Callable::from(
+                [promise = std::move(promise)]() mutable { promise.set_value(); })));
+        future.wait();
+    }
+
+    // Moves the virtual clock and waits until the worker blocks on its next step.
+    void advanceToNextStep(std::chrono::milliseconds duration) {
+        mClock->advance(duration);
+        mClock->waitForWaiters(1);
+    }
+
+    std::shared_ptr<common::ICancellationSignal> enroll() {
+        keymaster::HardwareAuthToken hat;
+        hat.mac = {1};
+        std::shared_ptr<common::ICancellationSignal> cancellationSignal;
+        EXPECT_TRUE(mSession->enroll(hat, &cancellationSignal).isOk());
+        mCancellationSignals.push_back(cancellationSignal);
+        return cancellationSignal;
+    }
+
+    std::shared_ptr<common::ICancellationSignal> authenticate() {
+        std::shared_ptr<common::ICancellationSignal> cancellationSignal;
+        EXPECT_TRUE(mSession->authenticate(0 /* operationId */, &cancellationSignal).isOk());
+        mCancellationSignals.push_back(cancellationSignal);
+        return cancellationSignal;
+    }
+
+    std::shared_ptr<common::ICancellationSignal> detectInteraction() {
+        std::shared_ptr<common::ICancellationSignal> cancellationSignal;
+        EXPECT_TRUE(mSession->detectInteraction(&cancellationSignal).isOk());
+        mCancellationSignals.push_back(cancellationSignal);
+        return cancellationSignal;
+    }
+
+    std::shared_ptr<VirtualClock> mClock = std::make_shared<VirtualClock>();
+    std::unique_ptr<FakeFingerprintEngine> mEngine;
+    // Like the framework, hold on to the cancellation signals: dropping one cancels its operation.
+    std::vector<std::shared_ptr<common::ICancellationSignal>> mCancellationSignals;
+    std::shared_ptr<TestSessionCallback> mCb;
+    std::shared_ptr<Session> mSession;
+    // Destroyed first, so that no task outlives what it uses.
+    WorkerThread mWorker{MAX_WORKER_QUEUE_SIZE};
+};
+
+TEST_F(SessionTest, GeneratingChallenge) {
+    ASSERT_TRUE(mSession->generateChallenge().isOk());
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), Events{"onChallengeGenerated @GENERATING_CHALLENGE"});
+    EXPECT_EQ(mSession->getCurrentState(), SessionState::IDLING);
+}
+
+TEST_F(SessionTest, RevokingChallenge) {
+    ASSERT_TRUE(mSession->revokeChallenge(42).isOk());
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), Events{"onChallengeRevoked 42 @REVOKING_CHALLENGE"});
+    EXPECT_EQ(mSession->getCurrentState(), SessionState::IDLING);
+}
+
+TEST_F(SessionTest, Enrolling) {
+    enroll();
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), Events{"onEnrollmentProgress 0 0 @ENROLLING"});
+    EXPECT_EQ(mSession->getCurrentState(), SessionState::IDLING);
+}
+
+TEST_F(SessionTest, Authenticating) {
+    authenticate();
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), Events{"onAuthenticationSucceeded 0 @AUTHENTICATING"});
+    EXPECT_EQ(mSession->getCurrentState(), SessionState::IDLING);
+}
+
+TEST_F(SessionTest, DetectingInteraction) {
+    detectInteraction();
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), Events{"onInteractionDetected @DETECTING_INTERACTION"});
+    EXPECT_EQ(mSession->getCurrentState(), SessionState::IDLING);
+}
+
+TEST_F(SessionTest, EnumeratingEnrollments) {
+    ASSERT_TRUE(mSession->enumerateEnrollments().isOk());
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), Events{"onEnrollmentsEnumerated @ENUMERATING_ENROLLMENTS"});
+    EXPECT_EQ(mSession->getCurrentState(), SessionState::IDLING);
+}
+
+TEST_F(SessionTest, RemovingEnrollments) {
+    ASSERT_TRUE(mSession->removeEnrollments({1, 2}).isOk());
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), Events{"onEnrollmentsRemoved @REMOVING_ENROLLMENTS"});
+    EXPECT_EQ(mSession->getCurrentState(), SessionState::IDLING);
+}
+
+TEST_F(SessionTest, GettingAuthenticatorId) {
+    ASSERT_TRUE(mSession->getAuthenticatorId().isOk());
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), Events{"onAuthenticatorIdRetrieved @GETTING_AUTHENTICATOR_ID"});
+    EXPECT_EQ(mSession->getCurrentState(), SessionState::IDLING);
+}
+
+TEST_F(SessionTest, InvalidatingAuthenticatorId) {
+    ASSERT_TRUE(mSession->invalidateAuthenticatorId().isOk());
+    sync();
+    EXPECT_EQ(mCb->takeEvents(),
+              Events{"onAuthenticatorIdInvalidated @INVALIDATING_AUTHENTICATOR_ID"});
+    EXPECT_EQ(mSession->getCurrentState(), SessionState::IDLING);
+}
+
+TEST_F(SessionTest, ResettingLockout) {
+    ASSERT_TRUE(mSession->resetLockout({}).isOk());
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), Events{"onLockoutCleared @RESETTING_LOCKOUT"});
+    EXPECT_EQ(mSession->getCurrentState(), SessionState::IDLING);
+}
+
+TEST_F(SessionTest, Closed) {
+    ASSERT_TRUE(mSession->close().isOk());
+    EXPECT_EQ(mCb->takeEvents(), Events{"onSessionClosed @CLOSED"});
+    EXPECT_TRUE(mSession->isClosed());
+}
+
+TEST_F(SessionTest, StaysClosedWhenOperationEndsAfterClose) {
+    startSession(R"(
+        [authenticate]
+        100 authentication_succeeded 1
+    )");
+    authenticate();
+    mClock->waitForWaiters(1);
+    EXPECT_EQ(mSession->getCurrentState(), SessionState::AUTHENTICATING);
+
+    ASSERT_TRUE(mSession->close().isOk());
+    mClock->advance(100ms);
+    sync();
+    EXPECT_EQ(mCb->takeEvents(),
+              (Events{"onSessionClosed @CLOSED", "onAuthenticationSucceeded 1 @CLOSED"}));
+    EXPECT_TRUE(mSession->isClosed());
+}
+
+TEST_F(SessionTest, EnrollmentFollowsVirtualClock) {
+    startSession(R"(
+        [enroll]
+        100 acquired GOOD
+        0 enrollment_progress 7 2
+        500 acquired PARTIAL 3
+        200 acquired GOOD
+        0 enrollment_progress 7 1
+        300 acquired GOOD
+        0 enrollment_progress 7 0
+    )");
+    enroll();
+    mClock->waitForWaiters(1);
+    EXPECT_TRUE(mCb->takeEvents().empty());
+
+    advanceToNextStep(99ms);
+    EXPECT_TRUE(mCb->takeEvents().empty());
+
+    advanceToNextStep(1ms);
+    EXPECT_EQ(mCb->takeEvents(),
+              (Events{"onAcquired GOOD 0 @ENROLLING", "onEnrollmentProgress 7 2 @ENROLLING"}));
+
+    // Steps that are overdue all run as soon as the clock moves.
+    advanceToNextStep(700ms);
+    EXPECT_EQ(mCb->takeEvents(),
+              (Events{"onAcquired PARTIAL 3 @ENROLLING", "onAcquired GOOD 0 @ENROLLING",
+                      "onEnrollmentProgress 7 1 @ENROLLING"}));
+
+    mClock->advance(300ms);
+    sync();
+    EXPECT_EQ(mCb->takeEvents(),
+              (Events{"onAcquired GOOD 0 @ENROLLING", "onEnrollmentProgress 7 0 @ENROLLING"}));
+    EXPECT_EQ(mSession->getCurrentState(), SessionState::IDLING);
+}
+
+TEST_F(SessionTest, CancellationBeforeStart) {
+    std::promise<void> blocked;
+    ASSERT_TRUE(mWorker.schedule(
+            Callable::from([future = blocked.get_future()] { future.wait(); })));
+    enroll()->cancel();
+    blocked.set_value();
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), Events{"onError CANCELED 0 @ENROLLING"});
+    EXPECT_EQ(mSession->getCurrentState(), SessionState::IDLING);
+}
+
+TEST_F(SessionTest, CancellationMidScenario) {
+    startSession(R"(
+        [authenticate]
+        100 acquired GOOD
+        100 authentication_succeeded 1
+    )");
+    auto cancellationSignal = authenticate();
+    mClock->waitForWaiters(1);
+    advanceToNextStep(100ms);
+    EXPECT_EQ(mCb->takeEvents(), Events{"onAcquired GOOD 0 @AUTHENTICATING"});
+
+    cancellationSignal->cancel();
+    mClock->advance(100ms);
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), Events{"onError CANCELED 0 @AUTHENTICATING"});
+    EXPECT_EQ(mSession->getCurrentState(), SessionState::IDLING);
+}
+
+TEST_F(SessionTest, CancellationWithoutClockMoving) {
+    startSession(R"(
+        [detect_interaction]
+        1000 interaction_detected
+    )");
+    auto cancellationSignal = detectInteraction();
+    mClock->waitForWaiters(1);
+    cancellationSignal->cancel();
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), Events{"onError CANCELED 0 @DETECTING_INTERACTION"});
+}
+
+TEST_F(SessionTest, OperationWithoutEndRunsUntilCancelled) {
+    startSession(R"(
+        [authenticate]
+        0 acquired START
+        500 authentication_failed
+    )");
+    auto cancellationSignal = authenticate();
+    mClock->waitForWaiters(1);
+    advanceToNextStep(24h);
+    EXPECT_EQ(mCb->takeEvents(), (Events{"onAcquired START 0 @AUTHENTICATING",
+                                         "onAuthenticationFailed @AUTHENTICATING"}));
+    EXPECT_EQ(mSession->getCurrentState(), SessionState::AUTHENTICATING);
+
+    cancellationSignal->cancel();
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), Events{"onError CANCELED 0 @AUTHENTICATING"});
+}
+
+TEST_F(SessionTest, ErrorEndsScenario) {
+    startSession(R"(
+        [enroll]
+        10 acquired SENSOR_DIRTY
+        10 error HW_UNAVAILABLE 5
+    )");
+    enroll();
+    mClock->waitForWaiters(1);
+    mClock->advance(20ms);
+    sync();
+    EXPECT_EQ(mCb->takeEvents(),
+              (Events{"onAcquired SENSOR_DIRTY 0 @ENROLLING", "onError HW_UNAVAILABLE 5 @ENROLLING"}));
+}
+
+TEST_F(SessionTest, ScenariosPlayInOrderThenLastRepeats) {
+    startSession(R"(
+        [authenticate]
+        0 authentication_failed
+        0 error TIMEOUT
+        [authenticate]
+        0 authentication_succeeded 3
+    )");
+    for (int i = 0; i < 3; ++i) {
+        authenticate();
+        sync();
+    }
+    EXPECT_EQ(mCb->takeEvents(),
+              (Events{"onAuthenticationFailed @AUTHENTICATING", "onError TIMEOUT 0 @AUTHENTICATING",
+                      "onAuthenticationSucceeded 3 @AUTHENTICATING",
+                      "onAuthenticationSucceeded 3 @AUTHENTICATING"}));
+}
+
+TEST_F(SessionTest, TimedLockoutExpires) {
+    startSession(R"(
+        [authenticate]
+        0 authentication_failed
+        0 lockout_timed 30000
+        [authenticate]
+        0 authentication_succeeded 1
+    )");
+    authenticate();
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), (Events{"onAuthenticationFailed @AUTHENTICATING",
+                                         "onLockoutTimed 30000 @AUTHENTICATING"}));
+
+    mClock->advance(10s);
+    authenticate();
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), Events{"onLockoutTimed 20000 @AUTHENTICATING"});
+
+    mClock->advance(20s);
+    authenticate();
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), Events{"onAuthenticationSucceeded 1 @AUTHENTICATING"});
+}
+
+TEST_F(SessionTest, ResetLockoutClearsPermanentLockout) {
+    startSession(R"(
+        [authenticate]
+        0 lockout_permanent
+        [authenticate]
+        0 authentication_succeeded 1
+    )");
+    authenticate();
+    sync();
+    authenticate();
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), (Events{"onLockoutPermanent @AUTHENTICATING",
+                                         "onLockoutPermanent @AUTHENTICATING"}));
+
+    ASSERT_TRUE(mSession->resetLockout({}).isOk());
+    sync();
+    authenticate();
+    sync();
+    EXPECT_EQ(mCb->takeEvents(), (Events{"onLockoutCleared @RESETTING_LOCKOUT",
+                                         "onAuthenticationSucceeded 1 @AUTHENTICATING"}));
+}
+
+TEST(ScenarioTest, ParsesAllEvents) {
+    auto scenarios = parseScenarios(R"(
+        # Comment.
+        [enroll]
+        5 acquired GOOD
+        6 acquired 2 11
+        0 enrollment_progress 1 0
+
+        [authenticate]
+        0 authentication_failed
+        0 lockout_timed 100
+        [authenticate]
+        0 lockout_permanent
+        [authenticate]
+        0 authentication_succeeded 9
+
+        [detect_interaction]
+        0 error VENDOR 12
+    )");
+    ASSERT_TRUE(scenarios.has_value());
+    ASSERT_EQ(scenarios->enroll.size(), 1u);
+    ASSERT_EQ(scenarios->enroll[0].size(), 3u);
+    EXPECT_EQ(scenarios->enroll[0][0].delay, 5ms);
+    EXPECT_EQ(scenarios->enroll[0][0].acquiredInfo, AcquiredInfo::GOOD);
+    EXPECT_EQ(scenarios->enroll[0][1].acquiredInfo, AcquiredInfo::PARTIAL);
+    EXPECT_EQ(scenarios->enroll[0][1].vendorCode, 11);
+    EXPECT_TRUE(scenarios->enroll[0][2].isTerminal());
+
+    ASSERT_EQ(scenarios->authenticate.size(), 3u);
+    EXPECT_EQ(scenarios->authenticate[0][1].lockoutDuration, 100ms);
+    EXPECT_EQ(scenarios->authenticate[1][0].type, ScenarioStep::Type::LOCKOUT_PERMANENT);
+    EXPECT_EQ(scenarios->authenticate[2][0].enrollmentId, 9);
+
+    ASSERT_EQ(scenarios->detectInteraction.size(), 1u);
+    EXPECT_EQ(scenarios->detectInteraction[0][0].error, Error::VENDOR);
+    EXPECT_EQ(scenarios->detectInteraction[0][0].vendorCode, 12);
+}
+
+TEST(ScenarioTest, UnscriptedOperationsUseDefaults) {
+    auto scenarios = parseScenarios("[enroll]\n0 error NO_SPACE\n");
+    ASSERT_TRUE(scenarios.has_value());
+    const auto defaults = Scenarios::defaults();
+    ASSERT_EQ(scenarios->authenticate.size(), 1u);
+    EXPECT_EQ(scenarios->authenticate[0][0].type, defaults.authenticate[0][0].type);
+    ASSERT_EQ(scenarios->detectInteraction.size(), 1u);
+    EXPECT_EQ(scenarios->detectInteraction[0][0].type, defaults.detectInteraction[0][0].type);
+}
+
+TEST(ScenarioTest, RejectsMalformedFiles) {
+    const char* invalid[] = {
+            "0 acquired GOOD\n",
+            "[unknown]\n",
+            "[enroll]\n0 acquired NOT_AN_INFO\n",
+            "[enroll]\n-1 acquired GOOD\n",
+            "[enroll]\n0 acquired\n",
+            "[enroll]\n0 enrollment_progress 1 0 1\n",
+            "[enroll]\n0 authentication_succeeded 1\n",
+            "[enroll]\n0 enrollment_progress 1 0\n0 acquired GOOD\n",
+            "[authenticate]\n0 lockout_timed soon\n",
+            "[detect_interaction]\n0 teleport\n",
+    };
+    for (const char* text : invalid) {
+        EXPECT_FALSE(parseScenarios(text).has_value()) << text;
+    }
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::biometrics::fingerprint
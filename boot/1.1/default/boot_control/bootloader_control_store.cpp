@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <libboot_control/bootloader_control_store.h>
+
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <utility>
+
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+#include <bootloader_message/bootloader_message.h>
+
+#include "private/boot_control_definition.h"
+
+namespace android {
+namespace bootable {
+
+static_assert(sizeof(bootloader_control) == kBootloaderControlSize,
+              "kBootloaderControlSize doesn't match struct bootloader_control");
+
+// The primary copy is the one the bootloader reads. The shadow copy lives in
+// the last bytes of bootloader_message_ab::reserved, which is in a different
+// sector than the primary copy and is otherwise unused.
+constexpr off_t kBootloaderControlOffset = offsetof(bootloader_message_ab, slot_suffix);
+constexpr off_t kBootloaderControlShadowOffset =
+    offsetof(bootloader_message_ab, reserved) + sizeof(bootloader_message_ab::reserved) -
+    sizeof(bootloader_control);
+
+namespace {
+
+using Crc32Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+// Tables for the slicing-by-8 CRC-32 (IEEE 802.3, reflected) computation.
+// tables[0] is the classic bytewise table; tables[k] advances a byte through
+// k additional zero bytes.
+const Crc32Tables& GetCrc32Tables() {
+  static const Crc32Tables tables = [] {
+    Crc32Tables t;
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (uint32_t j = 0; j < 8; ++j) {
+        uint32_t mask = -(crc & 1);
+        crc = (crc >> 1) ^ (0xEDB88320 & mask);
+      }
+      t[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+      for (size_t k = 1; k < t.size(); ++k) {
+        t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+      }
+    }
+    return t;
+  }();
+  return tables;
+}
+
+uint32_t LoadLE32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint32_t CRC32(const uint8_t* buf, size_t size) {
+  const Crc32Tables& t = GetCrc32Tables();
+
+  uint32_t ret = -1;
+  for (; size >= 8; buf += 8, size -= 8) {
+    uint32_t lo = ret ^ LoadLE32(buf);
+    uint32_t hi = LoadLE32(buf + 4);
+    ret = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+  }
+  for (; size > 0; ++buf, --size) {
+    ret = (ret >> 8) ^ t[0][(ret ^ *buf) & 0xFF];
+  }
+
+  return ~ret;
+}
+
+bool HasValidCrc(const bootloader_control& boot_ctrl) {
+  return boot_ctrl.crc32_le == BootloaderControlLECRC(&boot_ctrl);
+}
+
+bool ReadBlock(int fd, off_t offset, bootloader_control* buffer) {
+  uint8_t* data = reinterpret_cast<uint8_t*>(buffer);
+  size_t done = 0;
+  while (done < sizeof(*buffer)) {
+    ssize_t n = TEMP_FAILURE_RETRY(pread(fd, data + done, sizeof(*buffer) - done, offset + done));
+    if (n <= 0) {
+      if (n == 0) errno = EIO;
+      return false;
+    }
+    done += n;
+  }
+  return true;
+}
+
+bool SameTime(const struct timespec& a, const struct timespec& b) {
+  return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+}  // namespace
+
+uint32_t BootloaderControlLECRC(const bootloader_control* boot_ctrl) {
+  return htole32(
+      CRC32(reinterpret_cast<const uint8_t*>(boot_ctrl), offsetof(bootloader_control, crc32_le)));
+}
+
+BootloaderControlStore::BootloaderControlStore(std::string misc_device)
+    : misc_device_(std::move(misc_device)) {}
+
+bool BootloaderControlStore::CacheIsFreshLocked() {
+  if (!cache_valid_) return false;
+  struct stat st;
+  if (stat(misc_device_.c_str(), &st) != 0) return false;
+  return st.st_dev == cache_dev_ && st.st_ino == cache_ino_ && SameTime(st.st_mtim, cache_mtime_) &&
+         SameTime(st.st_ctim, cache_ctime_);
+}
+
+void BootloaderControlStore::RememberIdentityLocked(const struct stat& st) {
+  cache_dev_ = st.st_dev;
+  cache_ino_ = st.st_ino;
+  cache_mtime_ = st.st_mtim;
+  cache_ctime_ = st.st_ctim;
+}
+
+void BootloaderControlStore::Invalidate() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  cache_valid_ = false;
+}
+
+void BootloaderControlStore::SetWriteBudgetForTesting(ssize_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  write_budget_ = bytes;
+}
+
+bool BootloaderControlStore::Load(bootloader_control* buffer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (CacheIsFreshLocked()) {
+    memcpy(buffer, cache_, sizeof(*buffer));
+    return true;
+  }
+  cache_valid_ = false;
+
+  android::base::unique_fd fd(open(misc_device_.c_str(), O_RDONLY | O_CLOEXEC));
+  if (fd.get() == -1) {
+    PLOG(ERROR) << "failed to open " << misc_device_;
+    return false;
+  }
+  // Take the identity before reading so that a concurrent external writer
+  // invalidates the cache on the next call rather than being missed.
+  struct stat st;
+  if (fstat(fd.get(), &st) != 0) {
+    PLOG(ERROR) << "failed to stat " << misc_device_;
+    return false;
+  }
+  if (!ReadBlock(fd.get(), kBootloaderControlOffset, buffer)) {
+    PLOG(ERROR) << "failed to read " << misc_device_;
+    return false;
+  }
+
+  if (!HasValidCrc(*buffer)) {
+    // An update may have been interrupted while the primary copy was being
+    // written. If so, the shadow copy holds the complete new block.
+    bootloader_control shadow;
+    if (ReadBlock(fd.get(), kBootloaderControlShadowOffset, &shadow) && HasValidCrc(shadow) &&
+        shadow.magic == BOOT_CTRL_MAGIC) {
+      LOG(WARNING) << "Primary boot control block is corrupted, restoring it from shadow copy.";
+      *buffer = shadow;
+      fd.reset();
+      android::base::unique_fd wfd(open(misc_device_.c_str(), O_WRONLY | O_CLOEXEC));
+      if (wfd.get() == -1 ||
+          !WriteBlockLocked(wfd.get(), kBootloaderControlOffset,
+                            reinterpret_cast<const uint8_t*>(&shadow)) ||
+          fdatasync(wfd.get()) != 0) {
+        PLOG(ERROR) << "failed to restore boot control block on " << misc_device_;
+      } else {
+        fstat(wfd.get(), &st);
+      }
+    } else {
+      // Let the caller decide how to repair it; don't cache a corrupted block.
+      return true;
+    }
+  }
+
+  memcpy(cache_, buffer, sizeof(*buffer));
+  RememberIdentityLocked(st);
+  cache_valid_ = true;
+  return true;
+}
+
+bool BootloaderControlStore::WriteBlockLocked(int fd, off_t offset, const uint8_t* data) {
+  size_t done = 0;
+  while (done < kBootloaderControlSize) {
+    size_t len = kBootloaderControlSize - done;
+    if (write_budget_ >= 0) {
+      if (write_budget_ == 0) {
+        errno = EIO;
+        return false;
+      }
+      len = std::min(len, static_cast<size_t>(write_budget_));
+    }
+    ssize_t n = TEMP_FAILURE_RETRY(pwrite(fd, data + done, len, offset + done));
+    if (n <= 0) {
+      if (n == 0) errno = EIO;
+      return false;
+    }
+    if (write_budget_ >= 0) write_budget_ -= n;
+    done += n;
+  }
+  return true;
+}
+
+bool BootloaderControlStore::UpdateAndSave(bootloader_control* buffer) {
+  buffer->crc32_le = BootloaderControlLECRC(buffer);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (CacheIsFreshLocked() && memcmp(cache_, buffer, sizeof(*buffer)) == 0) {
+    // Nothing changed, skip the write and the flush.
+    return true;
+  }
+  cache_valid_ = false;
+
+  android::base::unique_fd fd(open(misc_device_.c_str(), O_WRONLY | O_CLOEXEC));
+  if (fd.get() == -1) {
+    PLOG(ERROR) << "failed to open " << misc_device_;
+    return false;
+  }
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer);
+  // The shadow copy must be durable before the primary copy is touched, so
+  // that at any point in time at least one of them holds a complete block.
+  if (!WriteBlockLocked(fd.get(), kBootloaderControlShadowOffset, data) ||
+      fdatasync(fd.get()) != 0) {
+    PLOG(ERROR) << "failed to write shadow boot control block to " << misc_device_;
+    return false;
+  }
+  if (!WriteBlockLocked(fd.get(), kBootloaderControlOffset, data) || fdatasync(fd.get()) != 0) {
+    PLOG(ERROR) << "failed to write " << misc_device_;
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd.get(), &st) == 0) {
+    memcpy(cache_, buffer, sizeof(*buffer));
+    RememberIdentityLocked(st);
+    cache_valid_ = true;
+  }
+  return true;
+}
+
+}  // namespace bootable
+}  // namespace android
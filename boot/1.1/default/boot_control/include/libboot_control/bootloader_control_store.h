@@ -0,0 +1,94 @@
+//
+// Copyright (C) 2022 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <mutex>
+#include <string>
+
+struct bootloader_control;
+
+namespace android {
+namespace bootable {
+
+// Size in bytes of struct bootloader_control as stored in misc.
+constexpr size_t kBootloaderControlSize = 32;
+
+// Return the little-endian representation of the CRC-32 of the first fields
+// in |boot_ctrl| up to the crc32_le field.
+uint32_t BootloaderControlLECRC(const bootloader_control* boot_ctrl);
+
+// Reads and writes the bootloader_control block stored in the misc partition.
+//
+// The last block read or written is kept in memory and is served to callers
+// for as long as the misc device's inode times are unchanged, so repeated
+// getters don't need to reopen and reread the device.
+//
+// Updates are made crash consistent by first writing a shadow copy of the
+// block to the end of the reserved area of bootloader_message_ab, and only
+// then overwriting the primary copy read by the bootloader. If the primary
+// copy is found with an invalid CRC-32 on load, the shadow copy is used (and
+// written back) when it is valid.
+class BootloaderControlStore {
+ public:
+  // |misc_device| may be any seekable file, which lets tests use a regular
+  // file standing in for misc.
+  explicit BootloaderControlStore(std::string misc_device);
+
+  // Load the current bootloader_control into |buffer|. The returned block is
+  // not guaranteed to have a valid CRC-32 if neither copy on disk has one.
+  bool Load(bootloader_control* buffer);
+
+  // Update the CRC-32 in |buffer| and persist it. Does nothing if the block
+  // is identical to the one last loaded or saved.
+  bool UpdateAndSave(bootloader_control* buffer);
+
+  // Drop the cached block so that the next Load() rereads the device.
+  void Invalidate();
+
+  const std::string& misc_device() const { return misc_device_; }
+
+  // Make the device write path fail with EIO after |bytes| more bytes have
+  // been written, simulating a power loss mid-update. A negative value
+  // disables the fault.
+  void SetWriteBudgetForTesting(ssize_t bytes);
+
+ private:
+  bool CacheIsFreshLocked();
+  void RememberIdentityLocked(const struct stat& st);
+  bool WriteBlockLocked(int fd, off_t offset, const uint8_t* data);
+
+  const std::string misc_device_;
+
+  std::mutex mutex_;
+  bool cache_valid_ = false;
+  uint8_t cache_[kBootloaderControlSize] = {};
+  // Identity of the misc device at the time the cache was filled.
+  dev_t cache_dev_ = 0;
+  ino_t cache_ino_ = 0;
+  struct timespec cache_mtime_ = {};
+  struct timespec cache_ctime_ = {};
+
+  ssize_t write_budget_ = -1;
+};
+
+}  // namespace bootable
+}  // namespace android
@@ -16,9 +16,11 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 
 #include <android/hardware/boot/1.1/IBootControl.h>
+#include <libboot_control/bootloader_control_store.h>
 
 namespace android {
 namespace bootable {
@@ -56,6 +58,9 @@ class BootControl {
   // The path to the misc_device as reported in the fstab.
   std::string misc_device_;
 
+  // Cached access to the bootloader_control block stored in |misc_device_|.
+  std::unique_ptr<BootloaderControlStore> store_;
+
   // The number of slots present on the device.
   unsigned int num_slots_ = 0;
 
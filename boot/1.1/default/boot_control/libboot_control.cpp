@@ -16,19 +16,17 @@
 
 #include <libboot_control/libboot_control.h>
 
-#include <endian.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <string.h>
 
 #include <string>
 
-#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
-#include <android-base/unique_fd.h>
 #include <bootloader_message/bootloader_message.h>
+#include <libboot_control/bootloader_control_store.h>
 
 #include "private/boot_control_definition.h"
 
@@ -45,73 +43,6 @@ static_assert(kDefaultBootAttempts < 8, "tries_remaining field only has 3 bits")
 constexpr unsigned int kMaxNumSlots =
     sizeof(bootloader_control::slot_info) / sizeof(bootloader_control::slot_info[0]);
 constexpr const char* kSlotSuffixes[kMaxNumSlots] = { "_a", "_b", "_c", "_d" };
-constexpr off_t kBootloaderControlOffset = offsetof(bootloader_message_ab, slot_suffix);
-
-static uint32_t CRC32(const uint8_t* buf, size_t size) {
-  static uint32_t crc_table[256];
-
-  // Compute the CRC-32 table only once.
-  if (!crc_table[1]) {
-    for (uint32_t i = 0; i < 256; ++i) {
-      uint32_t crc = i;
-      for (uint32_t j = 0; j < 8; ++j) {
-        uint32_t mask = -(crc & 1);
-        crc = (crc >> 1) ^ (0xEDB88320 & mask);
-      }
-      crc_table[i] = crc;
-    }
-  }
-
-  uint32_t ret = -1;
-  for (size_t i = 0; i < size; ++i) {
-    ret = (ret >> 8) ^ crc_table[(ret ^ buf[i]) & 0xFF];
-  }
-
-  return ~ret;
-}
-
-// Return the little-endian representation of the CRC-32 of the first fields
-// in |boot_ctrl| up to the crc32_le field.
-uint32_t BootloaderControlLECRC(const bootloader_control* boot_ctrl) {
-  return htole32(
-      CRC32(reinterpret_cast<const uint8_t*>(boot_ctrl), offsetof(bootloader_control, crc32_le)));
-}
-
-bool LoadBootloaderControl(const std::string& misc_device, bootloader_control* buffer) {
-  android::base::unique_fd fd(open(misc_device.c_str(), O_RDONLY));
-  if (fd.get() == -1) {
-    PLOG(ERROR) << "failed to open " << misc_device;
-    return false;
-  }
-  if (lseek(fd, kBootloaderControlOffset, SEEK_SET) != kBootloaderControlOffset) {
-    PLOG(ERROR) << "failed to lseek " << misc_device;
-    return false;
-  }
-  if (!android::base::ReadFully(fd.get(), buffer, sizeof(bootloader_control))) {
-    PLOG(ERROR) << "failed to read " << misc_device;
-    return false;
-  }
-  return true;
-}
-
-bool UpdateAndSaveBootloaderControl(const std::string& misc_device, bootloader_control* buffer) {
-  buffer->crc32_le = BootloaderControlLECRC(buffer);
-  android::base::unique_fd fd(open(misc_device.c_str(), O_WRONLY | O_SYNC));
-  if (fd.get() == -1) {
-    PLOG(ERROR) << "failed to open " << misc_device;
-    return false;
-  }
-  if (lseek(fd.get(), kBootloaderControlOffset, SEEK_SET) != kBootloaderControlOffset) {
-    PLOG(ERROR) << "failed to lseek " << misc_device;
-    return false;
-  }
-  if (!android::base::WriteFully(fd.get(), buffer, sizeof(bootloader_control))) {
-    PLOG(ERROR) << "failed to write " << misc_device;
-    return false;
-  }
-  return true;
-}
-
 void InitDefaultBootloaderControl(BootControl* control, bootloader_control* boot_ctrl) {
   memset(boot_ctrl, 0, sizeof(*boot_ctrl));
 
@@ -212,8 +143,9 @@ bool BootControl::Init() {
     return false;
   }
 
+  auto store = std::make_unique<BootloaderControlStore>(device);
   bootloader_control boot_ctrl;
-  if (!LoadBootloaderControl(device.c_str(), &boot_ctrl)) {
+  if (!store->Load(&boot_ctrl)) {
     LOG(ERROR) << "Failed to load bootloader control block";
     return false;
   }
@@ -221,6 +153,7 @@ bool BootControl::Init() {
   // Note that since there isn't a module unload function this memory is leaked.
   // We use `device` below sometimes, so it's not moved out of here.
   misc_device_ = device;
+  store_ = std::move(store);
   initialized_ = true;
 
   // Validate the loaded data, otherwise we will destroy it and re-initialize it
@@ -230,7 +163,7 @@ bool BootControl::Init() {
     LOG(WARNING) << "Invalid boot control found, expected CRC-32 0x" << std::hex << computed_crc32
                  << " but found 0x" << std::hex << boot_ctrl.crc32_le << ". Re-initializing.";
     InitDefaultBootloaderControl(this, &boot_ctrl);
-    UpdateAndSaveBootloaderControl(device.c_str(), &boot_ctrl);
+    store_->UpdateAndSave(&boot_ctrl);
   }
 
   if (!InitMiscVirtualAbMessageIfNeeded()) {
@@ -251,19 +184,19 @@ unsigned int BootControl::GetCurrentSlot() {
 
 bool BootControl::MarkBootSuccessful() {
   bootloader_control bootctrl;
-  if (!LoadBootloaderControl(misc_device_, &bootctrl)) return false;
+  if (!store_->Load(&bootctrl)) return false;
 
   bootctrl.slot_info[current_slot_].successful_boot = 1;
   // tries_remaining == 0 means that the slot is not bootable anymore, make
   // sure we mark the current slot as bootable if it succeeds in the last
   // attempt.
   bootctrl.slot_info[current_slot_].tries_remaining = 1;
-  return UpdateAndSaveBootloaderControl(misc_device_, &bootctrl);
+  return store_->UpdateAndSave(&bootctrl);
 }
 
 unsigned int BootControl::GetActiveBootSlot() {
   bootloader_control bootctrl;
-  if (!LoadBootloaderControl(misc_device_, &bootctrl)) return false;
+  if (!store_->Load(&bootctrl)) return false;
 
   // Use the current slot by default.
   unsigned int active_boot_slot = current_slot_;
@@ -286,7 +219,7 @@ bool BootControl::SetActiveBootSlot(unsigned int slot) {
   }
 
   bootloader_control bootctrl;
-  if (!LoadBootloaderControl(misc_device_, &bootctrl)) return false;
+  if (!store_->Load(&bootctrl)) return false;
 
   // Set every other slot with a lower priority than the new "active" slot.
   const unsigned int kActivePriority = 15;
@@ -310,7 +243,7 @@ bool BootControl::SetActiveBootSlot(unsigned int slot) {
   // slot would be flip.
   if (slot != current_slot_) bootctrl.slot_info[slot].verity_corrupted = 0;
 
-  return UpdateAndSaveBootloaderControl(misc_device_, &bootctrl);
+  return store_->UpdateAndSave(&bootctrl);
 }
 
 bool BootControl::SetSlotAsUnbootable(unsigned int slot) {
@@ -320,13 +253,13 @@ bool BootControl::SetSlotAsUnbootable(unsigned int slot) {
   }
 
   bootloader_control bootctrl;
-  if (!LoadBootloaderControl(misc_device_, &bootctrl)) return false;
+  if (!store_->Load(&bootctrl)) return false;
 
   // The only way to mark a slot as unbootable, regardless of the priority is to
   // set the tries_remaining to 0.
   bootctrl.slot_info[slot].successful_boot = 0;
   bootctrl.slot_info[slot].tries_remaining = 0;
-  return UpdateAndSaveBootloaderControl(misc_device_, &bootctrl);
+  return store_->UpdateAndSave(&bootctrl);
 }
 
 bool BootControl::IsSlotBootable(unsigned int slot) {
@@ -336,7 +269,7 @@ bool BootControl::IsSlotBootable(unsigned int slot) {
   }
 
   bootloader_control bootctrl;
-  if (!LoadBootloaderControl(misc_device_, &bootctrl)) return false;
+  if (!store_->Load(&bootctrl)) return false;
 
   return bootctrl.slot_info[slot].tries_remaining != 0;
 }
@@ -348,7 +281,7 @@ bool BootControl::IsSlotMarkedSuccessful(unsigned int slot) {
   }
 
   bootloader_control bootctrl;
-  if (!LoadBootloaderControl(misc_device_, &bootctrl)) return false;
+  if (!store_->Load(&bootctrl)) return false;
 
   return bootctrl.slot_info[slot].successful_boot && bootctrl.slot_info[slot].tries_remaining;
 }
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <endian.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <random>
+#include <string>
+
+#include <android-base/file.h>
+#include <android-base/unique_fd.h>
+#include <bootloader_message/bootloader_message.h>
+#include <gtest/gtest.h>
+#include <libboot_control/bootloader_control_store.h>
+
+#include "private/boot_control_definition.h"
+
+namespace android {
+namespace bootable {
+namespace {
+
+constexpr off_t kPrimaryOffset = offsetof(bootloader_message_ab, slot_suffix);
+
+// Plain bytewise CRC-32, used as a reference for the optimized one.
+uint32_t ReferenceCRC32(const uint8_t* buf, size_t size) {
+  uint32_t ret = -1;
+  for (size_t i = 0; i < size; ++i) {
+    ret ^= buf[i];
+    for (int j = 0; j < 8; ++j) {
+      ret = (ret >> 1) ^ (0xEDB88320 & -(ret & 1));
+    }
+  }
+  return ~ret;
+}
+
+bootloader_control MakeBlock(uint8_t priority_a, uint8_t priority_b) {
+  bootloader_control boot_ctrl = {};
+  strlcpy(boot_ctrl.slot_suffix, "_a", sizeof(boot_ctrl.slot_suffix));
+  boot_ctrl.magic = BOOT_CTRL_MAGIC;
+  boot_ctrl.version = BOOT_CTRL_VERSION;
+  boot_ctrl.nb_slot = 2;
+  boot_ctrl.slot_info[0].priority = priority_a;
+  boot_ctrl.slot_info[0].tries_remaining = 7;
+  boot_ctrl.slot_info[1].priority = priority_b;
+  boot_ctrl.slot_info[1].tries_remaining = 7;
+  boot_ctrl.crc32_le = BootloaderControlLECRC(&boot_ctrl);
+  return boot_ctrl;
+}
+
+class BootloaderControlStoreTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    // A regular file standing in for the misc partition.
+    ASSERT_EQ(0, ftruncate(misc_.fd, 16 * 1024));
+  }
+
+  bool LoadFresh(bootloader_control* boot_ctrl) {
+    BootloaderControlStore store(misc_.path);
+    return store.Load(boot_ctrl);
+  }
+
+  TemporaryFile misc_;
+};
+
+TEST_F(BootloaderControlStoreTest, CrcMatchesReference) {
+  std::mt19937 rng(42);
+  for (int i = 0; i < 1000; ++i) {
+    bootloader_control boot_ctrl;
+    auto* bytes = reinterpret_cast<uint8_t*>(&boot_ctrl);
+    for (size_t j = 0; j < sizeof(boot_ctrl); ++j) bytes[j] = rng();
+    EXPECT_EQ(htole32(ReferenceCRC32(bytes, offsetof(bootloader_control, crc32_le))),
+              BootloaderControlLECRC(&boot_ctrl));
+  }
+}
+
+TEST_F(BootloaderControlStoreTest, SaveThenLoad) {
+  BootloaderControlStore store(misc_.path);
+  bootloader_control expected = MakeBlock(15, 14);
+  ASSERT_TRUE(store.UpdateAndSave(&expected));
+
+  bootloader_control actual;
+  ASSERT_TRUE(LoadFresh(&actual));
+  EXPECT_EQ(0, memcmp(&expected, &actual, sizeof(actual)));
+}
+
+TEST_F(BootloaderControlStoreTest, UnchangedSaveSkipsWrite) {
+  BootloaderControlStore store(misc_.path);
+  bootloader_control boot_ctrl = MakeBlock(15, 14);
+  ASSERT_TRUE(store.UpdateAndSave(&boot_ctrl));
+
+  // Any write to the device would now fail.
+  store.SetWriteBudgetForTesting(0);
+  bootloader_control same = MakeBlock(15, 14);
+  EXPECT_TRUE(store.UpdateAndSave(&same));
+  bootloader_control different = MakeBlock(14, 15);
+  EXPECT_FALSE(store.UpdateAndSave(&different));
+}
+
+TEST_F(BootloaderControlStoreTest, ExternalWriteInvalidatesCache) {
+  BootloaderControlStore store(misc_.path);
+  bootloader_control boot_ctrl = MakeBlock(15, 14);
+  ASSERT_TRUE(store.UpdateAndSave(&boot_ctrl));
+
+  // Another writer (e.g. the bootloader) updates the block behind our back.
+  bootloader_control external = MakeBlock(14, 15);
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(external)),
+            pwrite(misc_.fd, &external, sizeof(external), kPrimaryOffset));
+  // File times have a coarse granularity, make sure the change is visible.
+  struct timespec times[2] = {{1, 0}, {1, 0}};
+  ASSERT_EQ(0, futimens(misc_.fd, times));
+
+  bootloader_control actual;
+  ASSERT_TRUE(store.Load(&actual));
+  EXPECT_EQ(0, memcmp(&external, &actual, sizeof(actual)));
+}
+
+TEST_F(BootloaderControlStoreTest, InvalidBlockIsReturnedUncached) {
+  bootloader_control actual;
+  ASSERT_TRUE(LoadFresh(&actual));
+  EXPECT_NE(BootloaderControlLECRC(&actual), actual.crc32_le);
+}
+
+TEST_F(BootloaderControlStoreTest, TornWritesLeaveOldOrNewBlock) {
+  const bootloader_control old_block = MakeBlock(15, 14);
+  const bootloader_control new_block = MakeBlock(14, 15);
+
+  // Two copies of the block are written, cut the power after every byte.
+  for (ssize_t budget = 0; budget <= 2 * static_cast<ssize_t>(sizeof(bootloader_control));
+       ++budget) {
+    SCOPED_TRACE("write budget " + std::to_string(budget));
+    ASSERT_EQ(0, ftruncate(misc_.fd, 0));
+    ASSERT_EQ(0, ftruncate(misc_.fd, 16 * 1024));
+    {
+      BootloaderControlStore store(misc_.path);
+      bootloader_control boot_ctrl = old_block;
+      ASSERT_TRUE(store.UpdateAndSave(&boot_ctrl));
+      store.SetWriteBudgetForTesting(budget);
+      boot_ctrl = new_block;
+      EXPECT_EQ(budget == 2 * static_cast<ssize_t>(sizeof(bootloader_control)),
+                store.UpdateAndSave(&boot_ctrl));
+    }
+
+    // Simulated restart.
+    bootloader_control actual;
+    ASSERT_TRUE(LoadFresh(&actual));
+    EXPECT_EQ(BootloaderControlLECRC(&actual), actual.crc32_le);
+    EXPECT_TRUE(memcmp(&actual, &old_block, sizeof(actual)) == 0 ||
+                memcmp(&actual, &new_block, sizeof(actual)) == 0);
+
+    // The primary copy is repaired on load, so the bootloader sees it too.
+    bootloader_control primary;
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(primary)),
+              pread(misc_.fd, &primary, sizeof(primary), kPrimaryOffset));
+    EXPECT_EQ(0, memcmp(&actual, &primary, sizeof(primary)));
+  }
+}
+
+}  // namespace
+}  // namespace bootable
+}  // namespace android
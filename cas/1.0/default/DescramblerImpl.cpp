@@ -52,7 +52,8 @@ CHECK_SUBSAMPLE_DEF(CryptoPlugin);
 
 DescramblerImpl::DescramblerImpl(
         const sp<SharedLibrary>& library, DescramblerPlugin *plugin) :
-        mLibrary(library), mPluginHolder(plugin) {
+        mLibrary(library), mPluginHolder(plugin),
+        mHeapCache([](const hidl_memory& heap) { return mapMemory(heap); }) {
     ALOGV("CTOR: plugin=%p", mPluginHolder.get());
 }
 
@@ -108,7 +109,8 @@ Return<void> DescramblerImpl::descramble(
         return Void();
     }
 
-    sp<IMemory> srcMem = mapMemory(srcBuffer.heapBase);
+    // Clients keep using the same heap, so it's only mapped the first time.
+    sp<IMemory> srcMem = mHeapCache.map(srcBuffer.heapBase);
 
     // Validate if the offset and size in the SharedBuffer is consistent with the
     // mapped ashmem, since the offset and size is controlled by client.
@@ -201,6 +203,7 @@ Return<Status> DescramblerImpl::release() {
 
     std::shared_ptr<DescramblerPlugin> holder(nullptr);
     std::atomic_store(&mPluginHolder, holder);
+    mHeapCache.clear();
 
     return Status::OK;
 }
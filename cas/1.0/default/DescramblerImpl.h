@@ -19,6 +19,9 @@
 
 #include <media/stagefright/foundation/ABase.h>
 #include <android/hardware/cas/native/1.0/IDescrambler.h>
+#include <android/hidl/memory/1.0/IMemory.h>
+
+#include "SharedMemoryCache.h"
 
 namespace android {
 struct DescramblerPlugin;
@@ -56,6 +59,7 @@ public:
 private:
     sp<SharedLibrary> mLibrary;
     std::shared_ptr<DescramblerPlugin> mPluginHolder;
+    SharedMemoryCache<sp<hidl::memory::V1_0::IMemory>> mHeapCache;
 
     DISALLOW_EVIL_CONSTRUCTORS(DescramblerImpl);
 };
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "android.hardware.cas@1.0-SharedMemoryCache"
+
+#include <utils/Log.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <sstream>
+
+#include "SharedMemoryCache.h"
+
+namespace android {
+namespace hardware {
+namespace cas {
+namespace V1_0 {
+namespace implementation {
+
+namespace {
+
+std::optional<std::string> readFdinfo(int fd) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fdinfo/%d", fd);
+    FILE* file = fopen(path, "re");
+    if (file == nullptr) {
+        return std::nullopt;
+    }
+    std::string fdinfo;
+    char buffer[256];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        fdinfo.append(buffer, size);
+    }
+    fclose(file);
+    return fdinfo;
+}
+
+} // namespace
+
+std::optional<HeapIdentity> HeapIdentity::of(const hidl_memory& heap) {
+    const native_handle_t* handle = heap.handle();
+    if (handle == nullptr || handle->numFds < 1) {
+        return std::nullopt;
+    }
+    const int fd = handle->data[0];
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return std::nullopt;
+    }
+
+    HeapIdentity identity;
+    identity.mName = heap.name();
+    identity.mSize = heap.size();
+    if (S_ISREG(st.st_mode)) {
+        // memfd and other shmem files have an inode of their own.
+        identity.mDev = st.st_dev;
+        identity.mIno = st.st_ino;
+        return identity;
+    }
+    if (!S_ISCHR(st.st_mode)) {
+        return std::nullopt;
+    }
+
+    // Presumably ashmem, whose regions are only told apart by their backing
+    // file. Other character devices don't list one.
+    std::optional<std::string> fdinfo = readFdinfo(fd);
+    std::optional<uint64_t> inode = fdinfo ? ashmemInode(*fdinfo) : std::nullopt;
+    if (!inode.has_value()) {
+        ALOGV("heap %s has no backing inode, not caching it", heap.name().c_str());
+        return std::nullopt;
+    }
+    identity.mAshmem = true;
+    identity.mDev = st.st_rdev;
+    identity.mIno = *inode;
+    return identity;
+}
+
+std::optional<uint64_t> HeapIdentity::ashmemInode(const std::string& fdinfo) {
+    // Lines are "<key>:\t<value>". Newer kernels also list the "ino" of the
+    // descriptor's own file, which for ashmem is /dev/ashmem's.
+    std::istringstream lines(fdinfo);
+    std::string line;
+    while (std::getline(lines, line)) {
+        uint64_t inode;
+        char end;
+        if (sscanf(line.c_str(), "inode: %" SCNu64 "%c", &inode, &end) == 1 && inode != 0) {
+            return inode;
+        }
+    }
+    return std::nullopt;
+}
+
+bool HeapIdentity::matches(const HeapIdentity& other) const {
+    return mName == other.mName && mSize == other.mSize && mAshmem == other.mAshmem &&
+            mDev == other.mDev && mIno == other.mIno;
+}
+
+} // namespace implementation
+} // namespace V1_0
+} // namespace cas
+} // namespace hardware
+} // namespace android
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_CAS_V1_0_SHARED_MEMORY_CACHE_H_
+#define ANDROID_HARDWARE_CAS_V1_0_SHARED_MEMORY_CACHE_H_
+
+#include <hidl/HidlSupport.h>
+#include <sys/stat.h>
+
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace android {
+namespace hardware {
+namespace cas {
+namespace V1_0 {
+namespace implementation {
+
+/*
+ * Identifies the memory object behind a hidl_memory, across transactions.
+ *
+ * Each transaction carries a new file descriptor for the heap, so the
+ * descriptor number can't be used. memfd heaps are identified by the device
+ * and inode of their file instead.
+ *
+ * ashmem heaps all share the inode of /dev/ashmem. The kernel lists the inode
+ * of the shmem file backing the region in the fdinfo of ashmem descriptors,
+ * which is what identifies them here, as kcmp(2) isn't allowed by the
+ * service's seccomp policy. The backing file only exists once the region has
+ * been mapped, which clients do before sending it, and kernels without the
+ * fdinfo entry don't list it at all: such heaps aren't cached.
+ *
+ * Either inode can't be reused while a cached mapping keeps the file alive.
+ */
+class HeapIdentity {
+public:
+    // Returns nullopt if the heap can't be identified reliably, in which case
+    // it must not be cached.
+    static std::optional<HeapIdentity> of(const hidl_memory& heap);
+
+    // Returns the inode of the file backing an ashmem region, given the
+    // fdinfo of one of its descriptors.
+    static std::optional<uint64_t> ashmemInode(const std::string& fdinfo);
+
+    bool matches(const HeapIdentity& other) const;
+
+private:
+    HeapIdentity() = default;
+
+    std::string mName;
+    uint64_t mSize = 0;
+    bool mAshmem = false;
+    dev_t mDev = 0;
+    uint64_t mIno = 0;
+};
+
+/*
+ * Keeps the most recently used heaps mapped, so that clients reusing the same
+ * heap for a whole session don't pay for a mmap/munmap pair per access unit.
+ *
+ * Mapping is a ref-counted handle to a mapping (sp<IMemory> in the HAL), that
+ * unmaps when its last reference goes away. Callers hold their own reference
+ * while using the memory, so evicting an entry never unmaps memory in use.
+ */
+template <typename Mapping>
+class SharedMemoryCache {
+public:
+    using Mapper = std::function<Mapping(const hidl_memory&)>;
+
+    static constexpr size_t kDefaultCapacity = 4;
+
+    explicit SharedMemoryCache(Mapper mapper, size_t capacity = kDefaultCapacity)
+        : mMapper(std::move(mapper)), mCapacity(capacity) {}
+
+    // Returns a mapping of heap, or a null mapping if it can't be mapped.
+    Mapping map(const hidl_memory& heap) {
+        std::optional<HeapIdentity> identity = HeapIdentity::of(heap);
+        if (!identity.has_value()) {
+            return mMapper(heap);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+                if (it->identity.matches(*identity)) {
+                    mEntries.splice(mEntries.begin(), mEntries, it);
+                    return it->mapping;
+                }
+            }
+        }
+
+        // Map outside of the lock, mapping may be slow.
+        Mapping mapping = mMapper(heap);
+        if (!mapping) {
+            return mapping;
+        }
+
+        std::lock_guard<std::mutex> lock(mLock);
+        mEntries.push_front({std::move(*identity), mapping});
+        while (mEntries.size() > mCapacity) {
+            mEntries.pop_back();
+        }
+        return mapping;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mLock);
+        mEntries.clear();
+    }
+
+private:
+    struct Entry {
+        HeapIdentity identity;
+        Mapping mapping;
+    };
+
+    const Mapper mMapper;
+    const size_t mCapacity;
+
+    std::mutex mLock;
+    // Most recently used first.
+    std::list<Entry> mEntries;
+};
+
+} // namespace implementation
+} // namespace V1_0
+} // namespace cas
+} // namespace hardware
+} // namespace android
+
+#endif // ANDROID_HARDWARE_CAS_V1_0_SHARED_MEMORY_CACHE_H_
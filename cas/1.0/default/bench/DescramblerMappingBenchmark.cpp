@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares mapping the source heap on every descramble() call, as the HAL
+// used to, with SharedMemoryCache. The plugin is a passthrough stub so that
+// the mapping cost isn't hidden behind actual descrambling.
+
+#include <benchmark/benchmark.h>
+#include <cutils/ashmem.h>
+#include <cutils/native_handle.h>
+#include <media/cas/DescramblerAPI.h>
+#include <media/stagefright/foundation/AString.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <memory>
+
+#include "SharedMemoryCache.h"
+
+using ::android::DescramblerPlugin;
+using ::android::hardware::hidl_memory;
+using ::android::hardware::cas::V1_0::implementation::SharedMemoryCache;
+
+namespace {
+
+// Stands in for IMemory: the heap is mapped for as long as it's referenced.
+class MappedHeap {
+public:
+    explicit MappedHeap(const hidl_memory& heap) : mSize(heap.size()) {
+        mPtr = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                heap.handle()->data[0], 0);
+    }
+    ~MappedHeap() {
+        if (mPtr != MAP_FAILED) munmap(mPtr, mSize);
+    }
+    uint8_t* getPointer() const { return static_cast<uint8_t*>(mPtr); }
+    size_t getSize() const { return mSize; }
+    bool ok() const { return mPtr != MAP_FAILED; }
+
+private:
+    void* mPtr;
+    size_t mSize;
+};
+
+std::shared_ptr<MappedHeap> mapHeap(const hidl_memory& heap) {
+    auto mapping = std::make_shared<MappedHeap>(heap);
+    return mapping->ok() ? mapping : nullptr;
+}
+
+struct PassthroughDescrambler : public DescramblerPlugin {
+    bool requiresSecureDecoderComponent(const char* /* mime */) const override {
+        return false;
+    }
+    android::status_t setMediaCasSession(const android::CasSessionId& /* sessionId */) override {
+        return android::OK;
+    }
+    ssize_t descramble(bool /* secure */, ScramblingControl /* scramblingControl */,
+            size_t numSubSamples, const SubSample* subSamples, const void* srcPtr,
+            int32_t srcOffset, void* dstPtr, int32_t dstOffset,
+            android::AString* /* errorDetailMsg */) override {
+        size_t total = 0;
+        for (size_t i = 0; i < numSubSamples; i++) {
+            total += subSamples[i].mNumBytesOfClearData + subSamples[i].mNumBytesOfEncryptedData;
+        }
+        memmove(static_cast<uint8_t*>(dstPtr) + dstOffset,
+                static_cast<const uint8_t*>(srcPtr) + srcOffset, total);
+        return total;
+    }
+};
+
+enum HeapType {
+    kMemfd,
+    // What MemoryDealer and MemoryHeapBase allocate, and so what the CAS VTS
+    // and MediaCodec clients send. On the host, libcutils emulates ashmem with
+    // regular files: run on a device to measure actual ashmem.
+    kAshmem,
+};
+
+class Heap {
+public:
+    Heap(size_t size, HeapType type) : mSize(size) {
+        int fd;
+        if (type == kAshmem) {
+            fd = ashmem_create_region("cas-bench", size);
+            // Clients map their heap before sending it, which is what gives
+            // an ashmem region its backing file.
+            mClientMapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        } else {
+            fd = memfd_create("cas-bench", MFD_CLOEXEC);
+            ftruncate(fd, size);
+        }
+        mHandle = native_handle_create(1, 0);
+        mHandle->data[0] = fd;
+        mMemory = hidl_memory("ashmem", mHandle, size);
+    }
+    ~Heap() {
+        if (mClientMapping != MAP_FAILED) munmap(mClientMapping, mSize);
+        native_handle_close(mHandle);
+        native_handle_delete(mHandle);
+    }
+    const hidl_memory& memory() const { return mMemory; }
+
+private:
+    size_t mSize;
+    void* mClientMapping = MAP_FAILED;
+    native_handle_t* mHandle;
+    hidl_memory mMemory;
+};
+
+constexpr size_t kHeapSize = 1 << 20;
+
+// One access unit worth of descrambling. As for SHARED_MEMORY buffers, the
+// destination is in the source heap, at an offset so that the copy isn't a no-op.
+template <typename Map>
+void descrambleAccessUnit(DescramblerPlugin& plugin, const hidl_memory& heap, size_t size,
+        Map map) {
+    auto mapping = map(heap);
+    if (mapping == nullptr || size > mapping->getSize()) abort();
+    DescramblerPlugin::SubSample subSample = {16, static_cast<uint32_t>(size - 16)};
+    android::AString error;
+    benchmark::DoNotOptimize(plugin.descramble(false, DescramblerPlugin::kScrambling_EvenKey, 1,
+            &subSample, mapping->getPointer(), 0, mapping->getPointer(), kHeapSize / 2, &error));
+}
+
+void BM_Descramble_MapPerCall(benchmark::State& state) {
+    Heap heap(kHeapSize, static_cast<HeapType>(state.range(1)));
+    PassthroughDescrambler plugin;
+    for (auto _ : state) {
+        descrambleAccessUnit(plugin, heap.memory(), state.range(0), mapHeap);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void BM_Descramble_CachedMapping(benchmark::State& state) {
+    Heap heap(kHeapSize, static_cast<HeapType>(state.range(1)));
+    PassthroughDescrambler plugin;
+    SharedMemoryCache<std::shared_ptr<MappedHeap>> cache(mapHeap);
+    for (auto _ : state) {
+        descrambleAccessUnit(plugin, heap.memory(), state.range(0),
+                [&cache](const hidl_memory& memory) { return cache.map(memory); });
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// Typical TS access units: a few packets for audio, tens of KiB for video,
+// from either type of heap.
+void accessUnitsAndHeapTypes(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"bytes", "ashmem"});
+    for (int64_t type : {kMemfd, kAshmem}) {
+        benchmark->Args({1504, type})->Args({64 << 10, type});
+    }
+}
+
+BENCHMARK(BM_Descramble_MapPerCall)->Apply(accessUnitsAndHeapTypes);
+BENCHMARK(BM_Descramble_CachedMapping)->Apply(accessUnitsAndHeapTypes);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cutils/ashmem.h>
+#include <cutils/native_handle.h>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include "SharedMemoryCache.h"
+
+using ::android::hardware::hidl_memory;
+using ::android::hardware::cas::V1_0::implementation::HeapIdentity;
+using ::android::hardware::cas::V1_0::implementation::SharedMemoryCache;
+
+namespace {
+
+constexpr size_t kHeapSize = 4096;
+
+// A heap as a client sends it, whose first byte tells it apart.
+class Heap {
+public:
+    explicit Heap(uint8_t tag) {
+        init(memfd_create("cas-test", MFD_CLOEXEC));
+        ftruncate(mHandle->data[0], kHeapSize);
+        pwrite(mHandle->data[0], &tag, 1, 0);
+    }
+    // An ashmem region, mapped by the client as MemoryHeapBase does.
+    static std::unique_ptr<Heap> ashmem(uint8_t tag) {
+        std::unique_ptr<Heap> heap(new Heap());
+        heap->init(ashmem_create_region("cas-test", kHeapSize));
+        heap->mClientMapping = mmap(nullptr, kHeapSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                heap->mHandle->data[0], 0);
+        if (heap->mClientMapping != MAP_FAILED) {
+            *static_cast<uint8_t*>(heap->mClientMapping) = tag;
+        }
+        return heap;
+    }
+    // Takes ownership of fd.
+    static std::unique_ptr<Heap> fromFd(int fd) {
+        std::unique_ptr<Heap> heap(new Heap());
+        heap->init(fd);
+        return heap;
+    }
+    ~Heap() {
+        if (mClientMapping != MAP_FAILED) munmap(mClientMapping, kHeapSize);
+        native_handle_close(mHandle);
+        native_handle_delete(mHandle);
+    }
+
+    // The same heap, as received in another transaction.
+    std::unique_ptr<Heap> resend() const {
+        return fromFd(fcntl(mHandle->data[0], F_DUPFD_CLOEXEC, 0));
+    }
+    const hidl_memory& memory() const { return mMemory; }
+
+private:
+    Heap() = default;
+    void init(int fd) {
+        mHandle = native_handle_create(1, 0);
+        mHandle->data[0] = fd;
+        mMemory = hidl_memory("ashmem", mHandle, kHeapSize);
+    }
+
+    void* mClientMapping = MAP_FAILED;
+    native_handle_t* mHandle = nullptr;
+    hidl_memory mMemory;
+};
+
+struct Mapping {
+    explicit Mapping(const hidl_memory& heap)
+        : ptr(mmap(nullptr, heap.size(), PROT_READ, MAP_SHARED, heap.handle()->data[0], 0)),
+          size(heap.size()) {}
+    ~Mapping() {
+        if (ptr != MAP_FAILED) munmap(ptr, size);
+    }
+    uint8_t tag() const { return *static_cast<uint8_t*>(ptr); }
+
+    void* ptr;
+    size_t size;
+};
+
+class SharedMemoryCacheTest : public ::testing::Test {
+protected:
+    SharedMemoryCache<std::shared_ptr<Mapping>> mCache{[this](const hidl_memory& heap) {
+        mMaps++;
+        auto mapping = std::make_shared<Mapping>(heap);
+        return mapping->ptr == MAP_FAILED ? nullptr : mapping;
+    }};
+    int mMaps = 0;
+};
+
+TEST_F(SharedMemoryCacheTest, ReusesTheMappingOfAHeap) {
+    Heap heap(1);
+    auto mapping = mCache.map(heap.memory());
+    ASSERT_NE(nullptr, mapping);
+    auto resent = heap.resend();
+    EXPECT_EQ(mapping, mCache.map(resent->memory()));
+    EXPECT_EQ(1, mMaps);
+}
+
+TEST_F(SharedMemoryCacheTest, MapsADifferentHeapUnderTheSameNameAndSize) {
+    auto first = std::make_unique<Heap>(1);
+    auto mapping = mCache.map(first->memory());
+    ASSERT_NE(nullptr, mapping);
+    EXPECT_EQ(1, mapping->tag());
+
+    // The client replaced its heap with another one of the same size.
+    first.reset();
+    Heap second(2);
+    auto remapped = mCache.map(second.memory());
+    ASSERT_NE(nullptr, remapped);
+    EXPECT_NE(mapping, remapped);
+    EXPECT_EQ(2, remapped->tag());
+    EXPECT_EQ(2, mMaps);
+}
+
+TEST_F(SharedMemoryCacheTest, TellsAshmemRegionsApart) {
+    auto first = Heap::ashmem(1);
+    auto second = Heap::ashmem(2);
+    auto firstMapping = mCache.map(first->memory());
+    ASSERT_NE(nullptr, firstMapping);
+    EXPECT_EQ(1, firstMapping->tag());
+    auto secondMapping = mCache.map(second->memory());
+    ASSERT_NE(nullptr, secondMapping);
+    EXPECT_EQ(2, secondMapping->tag());
+    EXPECT_EQ(2, mMaps);
+
+    auto resent = first->resend();
+    EXPECT_EQ(firstMapping, mCache.map(resent->memory()));
+    EXPECT_EQ(2, mMaps);
+}
+
+TEST_F(SharedMemoryCacheTest, EvictsTheLeastRecentlyUsedHeap) {
+    std::vector<std::unique_ptr<Heap>> heaps;
+    for (size_t i = 0; i <= decltype(mCache)::kDefaultCapacity; i++) {
+        heaps.push_back(std::make_unique<Heap>(static_cast<uint8_t>(i)));
+        mCache.map(heaps.back()->memory());
+    }
+    const int maps = mMaps;
+    mCache.map(heaps.back()->memory());
+    EXPECT_EQ(maps, mMaps);
+    mCache.map(heaps.front()->memory());
+    EXPECT_EQ(maps + 1, mMaps);
+}
+
+TEST_F(SharedMemoryCacheTest, DoesntCacheHeapsItCantIdentify) {
+    // A character device without a backing file, as ashmem is on kernels
+    // which don't list it.
+    auto heap = Heap::fromFd(open("/dev/zero", O_RDWR | O_CLOEXEC));
+    EXPECT_FALSE(HeapIdentity::of(heap->memory()).has_value());
+    mCache.map(heap->memory());
+    mCache.map(heap->memory());
+    EXPECT_EQ(2, mMaps);
+}
+
+TEST(HeapIdentityTest, ReadsTheAshmemInodeFromFdinfo) {
+    EXPECT_EQ(4242u, HeapIdentity::ashmemInode(
+            "pos:\t0\nflags:\t02000002\nmnt_id:\t21\nino:\t1234\ninode:\t4242\n"
+            "name:\tMemoryHeapBase\nsize:\t1048576\n"));
+    // Regions which were never mapped have no backing file yet.
+    EXPECT_FALSE(HeapIdentity::ashmemInode(
+            "pos:\t0\nflags:\t02000002\nmnt_id:\t21\nino:\t1234\nsize:\t4096\n").has_value());
+    EXPECT_FALSE(HeapIdentity::ashmemInode("inode:\t12ab\n").has_value());
+}
+
+}  // namespace
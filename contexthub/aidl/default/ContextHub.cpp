@@ -23,6 +23,23 @@ namespace contexthub {
 
 using ::ndk::ScopedAStatus;
 
+namespace {
+
+// The simulated hub only rejects requests when its queue is full.
+ScopedAStatus toStatus(bool queued) {
+    return queued ? ScopedAStatus::ok() : ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+}
+
+}  // namespace
+
+ContextHub::ContextHub() : ContextHub(SimulatedHub::Config{}) {}
+
+ContextHub::ContextHub(const SimulatedHub::Config& config) : mHub(config) {
+    mHub.registerNanoappFactory(LoopbackNanoapp::kId,
+                                [] { return std::make_unique<LoopbackNanoapp>(); });
+    mHub.registerNanoappFactory(EchoNanoapp::kId, [] { return std::make_unique<EchoNanoapp>(); });
+}
+
 ScopedAStatus ContextHub::getContextHubs(std::vector<ContextHubInfo>* out_contextHubInfos) {
     ContextHubInfo hub = {};
     hub.name = "Mock Context Hub";
@@ -30,7 +47,7 @@ ScopedAStatus ContextHub::getContextHubs(std::vector<ContextHubInfo>* out_contex
     hub.toolchain = "n/a";
     hub.id = kMockHubId;
     hub.peakMips = 1;
-    hub.maxSupportedMessageLengthBytes = 4096;
+    hub.maxSupportedMessageLengthBytes = kMaxMessageLength;
     hub.chrePlatformId = UINT64_C(0x476f6f6754000000);
     hub.chreApiMajorVersion = 1;
     hub.chreApiMinorVersion = 6;
@@ -40,26 +57,39 @@ ScopedAStatus ContextHub::getContextHubs(std::vector<ContextHubInfo>* out_contex
     return ndk::ScopedAStatus::ok();
 }
 
-// We don't expose any nanoapps for the default impl, therefore all nanoapp-related APIs fail.
-ScopedAStatus ContextHub::loadNanoapp(int32_t /* in_contextHubId */,
-                                      const NanoappBinary& /* in_appBinary */,
-                                      int32_t /* in_transactionId */) {
-    return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+// Nanoapps are loaded by ID from the ones known to the simulated hub, i.e. LoopbackNanoapp::kId
+// and EchoNanoapp::kId. Transactions results are reported asynchronously by the hub.
+ScopedAStatus ContextHub::loadNanoapp(int32_t in_contextHubId, const NanoappBinary& in_appBinary,
+                                      int32_t in_transactionId) {
+    if (in_contextHubId != kMockHubId) {
+        return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    return toStatus(mHub.loadNanoapp(in_appBinary.nanoappId, in_appBinary.nanoappVersion,
+                                     in_transactionId));
 }
 
-ScopedAStatus ContextHub::unloadNanoapp(int32_t /* in_contextHubId */, int64_t /* in_appId */,
-                                        int32_t /* in_transactionId */) {
-    return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ScopedAStatus ContextHub::unloadNanoapp(int32_t in_contextHubId, int64_t in_appId,
+                                        int32_t in_transactionId) {
+    if (in_contextHubId != kMockHubId) {
+        return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    return toStatus(mHub.unloadNanoapp(in_appId, in_transactionId));
 }
 
-ScopedAStatus ContextHub::disableNanoapp(int32_t /* in_contextHubId */, int64_t /* in_appId */,
-                                         int32_t /* in_transactionId */) {
-    return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ScopedAStatus ContextHub::disableNanoapp(int32_t in_contextHubId, int64_t in_appId,
+                                         int32_t in_transactionId) {
+    if (in_contextHubId != kMockHubId) {
+        return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    return toStatus(mHub.disableNanoapp(in_appId, in_transactionId));
 }
 
-ScopedAStatus ContextHub::enableNanoapp(int32_t /* in_contextHubId */, int64_t /* in_appId */,
-                                        int32_t /* in_transactionId */) {
-    return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+ScopedAStatus ContextHub::enableNanoapp(int32_t in_contextHubId, int64_t in_appId,
+                                        int32_t in_transactionId) {
+    if (in_contextHubId != kMockHubId) {
+        return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    return toStatus(mHub.enableNanoapp(in_appId, in_transactionId));
 }
 
 ScopedAStatus ContextHub::onSettingChanged(Setting /* in_setting */, bool /*in_enabled */) {
@@ -67,10 +97,8 @@ ScopedAStatus ContextHub::onSettingChanged(Setting /* in_setting */, bool /*in_e
 }
 
 ScopedAStatus ContextHub::queryNanoapps(int32_t in_contextHubId) {
-    if (in_contextHubId == kMockHubId && mCallback != nullptr) {
-        std::vector<NanoappInfo> nanoapps;
-        mCallback->handleNanoappInfo(nanoapps);
-        return ndk::ScopedAStatus::ok();
+    if (in_contextHubId == kMockHubId) {
+        return toStatus(mHub.queryNanoapps());
     } else {
         return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
@@ -79,7 +107,7 @@ ScopedAStatus ContextHub::queryNanoapps(int32_t in_contextHubId) {
 ScopedAStatus ContextHub::registerCallback(int32_t in_contextHubId,
                                            const std::shared_ptr<IContextHubCallback>& in_cb) {
     if (in_contextHubId == kMockHubId) {
-        mCallback = in_cb;
+        mHub.setCallback(in_cb);
         return ndk::ScopedAStatus::ok();
     } else {
         return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
@@ -87,27 +115,25 @@ ScopedAStatus ContextHub::registerCallback(int32_t in_contextHubId,
 }
 
 ScopedAStatus ContextHub::sendMessageToHub(int32_t in_contextHubId,
-                                           const ContextHubMessage& /* in_message */) {
-    if (in_contextHubId == kMockHubId) {
-        // Return true here to indicate that the HAL has accepted the message.
-        // Successful delivery of the message to a nanoapp should be handled at
-        // a higher level protocol.
-        return ndk::ScopedAStatus::ok();
+                                           const ContextHubMessage& in_message) {
+    if (in_contextHubId == kMockHubId && in_message.messageBody.size() <= kMaxMessageLength) {
+        // Return ok here to indicate that the HAL has accepted the message, even if there is no
+        // nanoapp to receive it. Successful delivery of the message to a nanoapp should be
+        // handled at a higher level protocol.
+        return toStatus(mHub.sendMessageToHub(in_message));
     } else {
         return ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
     }
 }
 
 ScopedAStatus ContextHub::onHostEndpointConnected(const HostEndpointInfo& in_info) {
-    mConnectedHostEndpoints.insert(in_info.hostEndpointId);
+    mHub.onHostEndpointConnected(in_info.hostEndpointId);
 
     return ndk::ScopedAStatus::ok();
 }
 
 ScopedAStatus ContextHub::onHostEndpointDisconnected(char16_t in_hostEndpointId) {
-    if (mConnectedHostEndpoints.count(in_hostEndpointId) > 0) {
-        mConnectedHostEndpoints.erase(in_hostEndpointId);
-    }
+    mHub.onHostEndpointDisconnected(in_hostEndpointId);
 
     return ndk::ScopedAStatus::ok();
 }
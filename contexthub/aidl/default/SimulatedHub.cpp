@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "contexthub-impl/SimulatedHub.h"
+
+#include <android-base/logging.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace contexthub {
+
+void LoopbackNanoapp::handleMessage(const ContextHubMessage& message, const SendToHost& send) {
+    send(message);
+}
+
+void EchoNanoapp::handleMessage(const ContextHubMessage& message, const SendToHost& send) {
+    ContextHubMessage echo = message;
+    echo.hostEndPoint = SimulatedHub::kHostEndpointBroadcast;
+    send(std::move(echo));
+}
+
+SimulatedHub::SimulatedHub(const Config& config) : mConfig(config), mRandom(config.seed) {
+    mHubThread = std::thread(&SimulatedHub::hubThread, this);
+    mHostThread = std::thread(&SimulatedHub::hostThread, this);
+}
+
+SimulatedHub::~SimulatedHub() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mDestroy = true;
+    }
+    mHubCv.notify_all();
+    mHostCv.notify_all();
+    mHubThread.join();
+    mHostThread.join();
+}
+
+void SimulatedHub::registerNanoappFactory(int64_t appId, NanoappFactory factory) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mFactories[appId] = std::move(factory);
+}
+
+void SimulatedHub::setCallback(const std::shared_ptr<IContextHubCallback>& callback) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mCallback = callback;
+}
+
+bool SimulatedHub::loadNanoapp(int64_t appId, int32_t version, int32_t transactionId) {
+    return postToHub(mConfig.transactionLatency, [this, appId, version, transactionId]() {
+        completeTransaction(Transaction::LOAD, appId, version, transactionId);
+    });
+}
+
+bool SimulatedHub::unloadNanoapp(int64_t appId, int32_t transactionId) {
+    return postToHub(mConfig.transactionLatency, [this, appId, transactionId]() {
+        completeTransaction(Transaction::UNLOAD, appId, 0, transactionId);
+    });
+}
+
+bool SimulatedHub::enableNanoapp(int64_t appId, int32_t transactionId) {
+    return postToHub(mConfig.transactionLatency, [this, appId, transactionId]() {
+        completeTransaction(Transaction::ENABLE, appId, 0, transactionId);
+    });
+}
+
+bool SimulatedHub::disableNanoapp(int64_t appId, int32_t transactionId) {
+    return postToHub(mConfig.transactionLatency, [this, appId, transactionId]() {
+        completeTransaction(Transaction::DISABLE, appId, 0, transactionId);
+    });
+}
+
+bool SimulatedHub::sendMessageToHub(const ContextHubMessage& message) {
+    return postToHub(mConfig.messageLatency, [this, message]() { deliverToNanoapp(message); });
+}
+
+bool SimulatedHub::queryNanoapps() {
+    return postToHub(std::chrono::microseconds::zero(), [this]() {
+        auto nanoapps = getNanoapps();
+        std::lock_guard<std::mutex> lock(mLock);
+        postToHost({std::nullopt, std::move(nanoapps), 0, false});
+    });
+}
+
+std::vector<NanoappInfo> SimulatedHub::getNanoapps() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    std::vector<NanoappInfo> nanoapps;
+    for (const auto& [appId, nanoapp] : mNanoapps) {
+        NanoappInfo info;
+        info.nanoappId = appId;
+        info.nanoappVersion = nanoapp.version;
+        info.enabled = nanoapp.enabled;
+        nanoapps.push_back(info);
+    }
+    return nanoapps;
+}
+
+void SimulatedHub::onHostEndpointConnected(char16_t hostEndpointId) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mConnectedHostEndpoints.insert(hostEndpointId);
+}
+
+void SimulatedHub::onHostEndpointDisconnected(char16_t hostEndpointId) {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mConnectedHostEndpoints.erase(hostEndpointId) == 0) return;
+    }
+    // Nanoapps must learn about the disconnection even if the hub queue is full.
+    postToHub(
+            std::chrono::microseconds::zero(),
+            [this, hostEndpointId]() {
+                std::vector<SimulatedNanoapp*> apps;
+                {
+                    std::lock_guard<std::mutex> lock(mLock);
+                    for (auto& [appId, nanoapp] : mNanoapps) apps.push_back(nanoapp.app.get());
+                }
+                for (auto* app : apps) app->handleHostEndpointDisconnected(hostEndpointId);
+            },
+            /* bounded= */ false);
+}
+
+bool SimulatedHub::isHostEndpointConnected(char16_t hostEndpointId) const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mConnectedHostEndpoints.count(hostEndpointId) > 0;
+}
+
+SimulatedHub::Stats SimulatedHub::getStats() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mStats;
+}
+
+bool SimulatedHub::postToHub(std::chrono::microseconds latency, std::function<void()> run,
+                             bool bounded) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (bounded && mHubQueue.size() >= mConfig.hubQueueCapacity) return false;
+    // Requests are run in order, as if they went through a serial transport: a request can't
+    // overtake an earlier one with a longer latency.
+    mHubQueue.push_back({Clock::now() + latency, std::move(run)});
+    mHubCv.notify_one();
+    return true;
+}
+
+void SimulatedHub::completeTransaction(Transaction transaction, int64_t appId, int32_t version,
+                                       int32_t transactionId) {
+    std::lock_guard<std::mutex> lock(mLock);
+    const bool success = !inject(mConfig.transactionFailureRate) &&
+                         applyTransactionLocked(transaction, appId, version);
+    if (!success) mStats.failedTransactions++;
+    postToHost({std::nullopt, std::nullopt, transactionId, success});
+}
+
+bool SimulatedHub::applyTransactionLocked(Transaction transaction, int64_t appId,
+                                          int32_t version) {
+    auto nanoapp = mNanoapps.find(appId);
+    switch (transaction) {
+        case Transaction::LOAD: {
+            auto factory = mFactories.find(appId);
+            if (factory == mFactories.end() || nanoapp != mNanoapps.end()) return false;
+            mNanoapps[appId] = {factory->second(), version, true};
+            return true;
+        }
+        case Transaction::UNLOAD:
+            if (nanoapp == mNanoapps.end()) return false;
+            mNanoapps.erase(nanoapp);
+            return true;
+        case Transaction::ENABLE:
+        case Transaction::DISABLE:
+            if (nanoapp == mNanoapps.end()) return false;
+            nanoapp->second.enabled = transaction == Transaction::ENABLE;
+            return true;
+    }
+    return false;
+}
+
+void SimulatedHub::deliverToNanoapp(const ContextHubMessage& message) {
+    SimulatedNanoapp* app = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        auto nanoapp = mNanoapps.find(message.nanoappId);
+        if (inject(mConfig.messageDropRate) || nanoapp == mNanoapps.end() ||
+            !nanoapp->second.enabled) {
+            mStats.droppedToHub++;
+            return;
+        }
+        mStats.messagesToHub++;
+        app = nanoapp->second.app.get();
+    }
+    // Nanoapps are only unloaded from the hub thread, so the pointer stays valid here.
+    const int64_t appId = message.nanoappId;
+    app->handleMessage(message, [this, appId](ContextHubMessage reply) {
+        return sendToHost(appId, std::move(reply));
+    });
+}
+
+bool SimulatedHub::sendToHost(int64_t appId, ContextHubMessage message) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mHostQueueMessages >= mConfig.hostQueueCapacity ||
+        (message.hostEndPoint != kHostEndpointBroadcast &&
+         mConnectedHostEndpoints.count(message.hostEndPoint) == 0)) {
+        mStats.droppedToHost++;
+        return false;
+    }
+    message.nanoappId = appId;
+    mHostQueueMessages++;
+    postToHost({std::move(message), std::nullopt, 0, false});
+    return true;
+}
+
+void SimulatedHub::postToHost(HostEvent event) {
+    mHostQueue.push_back(std::move(event));
+    mHostCv.notify_one();
+}
+
+bool SimulatedHub::inject(double rate) {
+    if (rate <= 0) return false;
+    return std::uniform_real_distribution<double>(0, 1)(mRandom) < rate;
+}
+
+void SimulatedHub::hubThread() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (!mDestroy) {
+        if (mHubQueue.empty()) {
+            mHubCv.wait(lock);
+            continue;
+        }
+        if (Clock::now() < mHubQueue.front().readyTime) {
+            mHubCv.wait_until(lock, mHubQueue.front().readyTime);
+            continue;
+        }
+        auto run = std::move(mHubQueue.front().run);
+        mHubQueue.pop_front();
+        lock.unlock();
+        run();
+        lock.lock();
+    }
+}
+
+void SimulatedHub::hostThread() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (!mDestroy) {
+        if (mHostQueue.empty()) {
+            mHostCv.wait(lock);
+            continue;
+        }
+        HostEvent event = std::move(mHostQueue.front());
+        mHostQueue.pop_front();
+        if (event.message.has_value()) mHostQueueMessages--;
+        auto callback = mCallback;
+        lock.unlock();
+
+        if (callback == nullptr) {
+            LOG(WARNING) << "No callback registered, dropping event";
+        } else if (event.message.has_value()) {
+            callback->handleContextHubMessage(*event.message, {});
+        } else if (event.nanoapps.has_value()) {
+            callback->handleNanoappInfo(*event.nanoapps);
+        } else {
+            callback->handleTransactionResult(event.transactionId, event.success);
+        }
+
+        lock.lock();
+        if (event.message.has_value() && callback != nullptr) mStats.messagesToHost++;
+    }
+}
+
+}  // namespace contexthub
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
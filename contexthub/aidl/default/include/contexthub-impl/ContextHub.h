@@ -18,7 +18,7 @@
 
 #include <aidl/android/hardware/contexthub/BnContextHub.h>
 
-#include <unordered_set>
+#include "SimulatedHub.h"
 
 namespace aidl {
 namespace android {
@@ -26,6 +26,10 @@ namespace hardware {
 namespace contexthub {
 
 class ContextHub : public BnContextHub {
+  public:
+    ContextHub();
+    explicit ContextHub(const SimulatedHub::Config& config);
+
     ::ndk::ScopedAStatus getContextHubs(std::vector<ContextHubInfo>* out_contextHubInfos) override;
     ::ndk::ScopedAStatus loadNanoapp(int32_t in_contextHubId, const NanoappBinary& in_appBinary,
                                      int32_t in_transactionId) override;
@@ -45,11 +49,11 @@ class ContextHub : public BnContextHub {
 
     ::ndk::ScopedAStatus onHostEndpointDisconnected(char16_t in_hostEndpointId) override;
 
-  private:
     static constexpr uint32_t kMockHubId = 0;
-    std::shared_ptr<IContextHubCallback> mCallback;
+    static constexpr size_t kMaxMessageLength = 4096;
 
-    std::unordered_set<char16_t> mConnectedHostEndpoints;
+  private:
+    SimulatedHub mHub;
 };
 
 }  // namespace contexthub
@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/contexthub/ContextHubMessage.h>
+#include <aidl/android/hardware/contexthub/IContextHubCallback.h>
+#include <aidl/android/hardware/contexthub/NanoappInfo.h>
+#include <android-base/thread_annotations.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace contexthub {
+
+/**
+ * A nanoapp running in the simulated hub. All methods are called from the hub thread.
+ */
+class SimulatedNanoapp {
+  public:
+    // Sends a message to the host, returns false if it couldn't be queued.
+    using SendToHost = std::function<bool(ContextHubMessage)>;
+
+    virtual ~SimulatedNanoapp() = default;
+
+    virtual void handleMessage(const ContextHubMessage& message, const SendToHost& send) = 0;
+    virtual void handleHostEndpointDisconnected(char16_t /* hostEndpointId */) {}
+};
+
+/** Replies to every message with an identical message, addressed to its sender. */
+class LoopbackNanoapp : public SimulatedNanoapp {
+  public:
+    static constexpr int64_t kId = 0x476f6f6754000101;
+
+    void handleMessage(const ContextHubMessage& message, const SendToHost& send) override;
+};
+
+/** Broadcasts every message it receives to all host endpoints. */
+class EchoNanoapp : public SimulatedNanoapp {
+  public:
+    static constexpr int64_t kId = 0x476f6f6754000102;
+
+    void handleMessage(const ContextHubMessage& message, const SendToHost& send) override;
+};
+
+/**
+ * In-process stand-in for a context hub, backing the default IContextHub implementation.
+ *
+ * Nanoapps are loaded from factories registered by ID, the NanoappBinary content is ignored.
+ * Requests from the host are queued to a bounded hub queue and run on the hub thread, which
+ * reports transaction results and routes messages to nanoapps. Messages from nanoapps are queued
+ * to a bounded host queue and delivered to the callback from a separate thread, so a slow client
+ * doesn't stall the hub.
+ */
+class SimulatedHub {
+  public:
+    static constexpr char16_t kHostEndpointBroadcast = 0xFFFF;
+
+    struct Config {
+        // Delay before a load/unload/enable/disable transaction completes.
+        std::chrono::microseconds transactionLatency{0};
+        // Delay before a message from the host is handed to its nanoapp.
+        std::chrono::microseconds messageLatency{0};
+        // Probability, between 0 and 1, for a transaction to fail after its latency elapsed.
+        double transactionFailureRate = 0;
+        // Probability, between 0 and 1, for a message from the host to be lost.
+        double messageDropRate = 0;
+        size_t hubQueueCapacity = 64;
+        size_t hostQueueCapacity = 64;
+        uint32_t seed = 0;
+    };
+
+    struct Stats {
+        uint64_t messagesToHub = 0;
+        uint64_t messagesToHost = 0;
+        // Messages from the host dropped by failure injection or for lack of a running nanoapp.
+        uint64_t droppedToHub = 0;
+        // Messages from nanoapps dropped because the host queue was full or the endpoint is gone.
+        uint64_t droppedToHost = 0;
+        uint64_t failedTransactions = 0;
+    };
+
+    using NanoappFactory = std::function<std::unique_ptr<SimulatedNanoapp>()>;
+
+    explicit SimulatedHub(const Config& config);
+    ~SimulatedHub();
+
+    void registerNanoappFactory(int64_t appId, NanoappFactory factory);
+    void setCallback(const std::shared_ptr<IContextHubCallback>& callback);
+
+    // The following return false if the hub queue is full. Transactions results are reported
+    // through IContextHubCallback::handleTransactionResult.
+    bool loadNanoapp(int64_t appId, int32_t version, int32_t transactionId);
+    bool unloadNanoapp(int64_t appId, int32_t transactionId);
+    bool enableNanoapp(int64_t appId, int32_t transactionId);
+    bool disableNanoapp(int64_t appId, int32_t transactionId);
+    bool sendMessageToHub(const ContextHubMessage& message);
+    // Reports the loaded nanoapps through IContextHubCallback::handleNanoappInfo.
+    bool queryNanoapps();
+
+    std::vector<NanoappInfo> getNanoapps() const;
+
+    void onHostEndpointConnected(char16_t hostEndpointId);
+    void onHostEndpointDisconnected(char16_t hostEndpointId);
+    bool isHostEndpointConnected(char16_t hostEndpointId) const;
+
+    Stats getStats() const;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Nanoapp {
+        std::unique_ptr<SimulatedNanoapp> app;
+        int32_t version = 0;
+        bool enabled = true;
+    };
+
+    struct HubRequest {
+        Clock::time_point readyTime;
+        std::function<void()> run;
+    };
+
+    struct HostEvent {
+        std::optional<ContextHubMessage> message;
+        std::optional<std::vector<NanoappInfo>> nanoapps;
+        int32_t transactionId = 0;
+        bool success = false;
+    };
+
+    bool postToHub(std::chrono::microseconds latency, std::function<void()> run,
+                   bool bounded = true);
+    enum class Transaction { LOAD, UNLOAD, ENABLE, DISABLE };
+
+    void completeTransaction(Transaction transaction, int64_t appId, int32_t version,
+                             int32_t transactionId);
+    bool applyTransactionLocked(Transaction transaction, int64_t appId, int32_t version)
+            REQUIRES(mLock);
+    void deliverToNanoapp(const ContextHubMessage& message);
+    bool sendToHost(int64_t appId, ContextHubMessage message);
+    void postToHost(HostEvent event) REQUIRES(mLock);
+    bool inject(double rate) REQUIRES(mLock);
+    void hubThread();
+    void hostThread();
+
+    const Config mConfig;
+
+    mutable std::mutex mLock;
+    std::condition_variable mHubCv;
+    std::condition_variable mHostCv;
+    bool mDestroy GUARDED_BY(mLock) = false;
+    std::shared_ptr<IContextHubCallback> mCallback GUARDED_BY(mLock);
+    std::map<int64_t, NanoappFactory> mFactories GUARDED_BY(mLock);
+    std::map<int64_t, Nanoapp> mNanoapps GUARDED_BY(mLock);
+    std::unordered_set<char16_t> mConnectedHostEndpoints GUARDED_BY(mLock);
+    std::deque<HubRequest> mHubQueue GUARDED_BY(mLock);
+    std::deque<HostEvent> mHostQueue GUARDED_BY(mLock);
+    size_t mHostQueueMessages GUARDED_BY(mLock) = 0;
+    std::mt19937 mRandom GUARDED_BY(mLock);
+    Stats mStats GUARDED_BY(mLock);
+
+    std::thread mHubThread;
+    std::thread mHostThread;
+};
+
+}  // namespace contexthub
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
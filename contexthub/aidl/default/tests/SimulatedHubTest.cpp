@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <aidl/android/hardware/contexthub/BnContextHubCallback.h>
+#include <android-base/logging.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+#include "contexthub-impl/ContextHub.h"
+
+namespace aidl::android::hardware::contexthub {
+namespace {
+
+using ::ndk::ScopedAStatus;
+using namespace std::chrono_literals;
+
+constexpr int64_t kUnknownAppId = 0x476f6f6754555555;
+constexpr char16_t kHostEndpoint = 7;
+constexpr auto kTimeout = 5s;
+
+class TestCallback : public BnContextHubCallback {
+  public:
+    ScopedAStatus handleNanoappInfo(const std::vector<NanoappInfo>& appInfo) override {
+        std::lock_guard<std::mutex> lock(mLock);
+        mNanoapps = appInfo;
+        mCv.notify_all();
+        return ScopedAStatus::ok();
+    }
+
+    ScopedAStatus handleContextHubMessage(const ContextHubMessage& msg,
+                                          const std::vector<std::string>& /* perms */) override {
+        std::lock_guard<std::mutex> lock(mLock);
+        mMessages.push_back(msg);
+        mCv.notify_all();
+        return ScopedAStatus::ok();
+    }
+
+    ScopedAStatus handleContextHubAsyncEvent(AsyncEventType /* evt */) override {
+        return ScopedAStatus::ok();
+    }
+
+    ScopedAStatus handleTransactionResult(int32_t transactionId, bool success) override {
+        std::lock_guard<std::mutex> lock(mLock);
+        mTransactions[transactionId] = success;
+        mCv.notify_all();
+        return ScopedAStatus::ok();
+    }
+
+    std::optional<bool> waitForTransaction(int32_t transactionId) {
+        std::unique_lock<std::mutex> lock(mLock);
+        if (!mCv.wait_for(lock, kTimeout,
+                          [&] { return mTransactions.count(transactionId) > 0; })) {
+            return std::nullopt;
+        }
+        return mTransactions[transactionId];
+    }
+
+    std::optional<std::vector<NanoappInfo>> waitForNanoapps() {
+        std::unique_lock<std::mutex> lock(mLock);
+        if (!mCv.wait_for(lock, kTimeout, [&] { return mNanoapps.has_value(); })) {
+            return std::nullopt;
+        }
+        return std::exchange(mNanoapps, std::nullopt);
+    }
+
+    std::optional<ContextHubMessage> waitForMessage(std::chrono::milliseconds timeout = kTimeout) {
+        std::unique_lock<std::mutex> lock(mLock);
+        if (!mCv.wait_for(lock, timeout, [&] { return !mMessages.empty(); })) {
+            return std::nullopt;
+        }
+        auto message = std::move(mMessages.front());
+        mMessages.pop_front();
+        return message;
+    }
+
+  private:
+    std::mutex mLock;
+    std::condition_variable mCv;
+    std::map<int32_t, bool> mTransactions;
+    std::optional<std::vector<NanoappInfo>> mNanoapps;
+    std::deque<ContextHubMessage> mMessages;
+};
+
+class SimulatedHubTest : public ::testing::Test {
+  protected:
+    void SetUp() override { init({}); }
+
+    void init(const SimulatedHub::Config& config) {
+        mHub = ndk::SharedRefBase::make<ContextHub>(config);
+        mCallback = ndk::SharedRefBase::make<TestCallback>();
+        ASSERT_TRUE(mHub->registerCallback(ContextHub::kMockHubId, mCallback).isOk());
+        HostEndpointInfo info;
+        info.hostEndpointId = kHostEndpoint;
+        info.type = HostEndpointInfo::Type::FRAMEWORK;
+        ASSERT_TRUE(mHub->onHostEndpointConnected(info).isOk());
+    }
+
+    std::optional<bool> load(int64_t appId) {
+        NanoappBinary binary;
+        binary.nanoappId = appId;
+        binary.nanoappVersion = 1;
+        const int32_t transactionId = mNextTransactionId++;
+        if (!mHub->loadNanoapp(ContextHub::kMockHubId, binary, transactionId).isOk()) {
+            return std::nullopt;
+        }
+        return mCallback->waitForTransaction(transactionId);
+    }
+
+    static ContextHubMessage makeMessage(int64_t appId, int32_t type) {
+        ContextHubMessage message;
+        message.nanoappId = appId;
+        message.hostEndPoint = kHostEndpoint;
+        message.messageType = type;
+        message.messageBody = {1, 2, 3, 4};
+        return message;
+    }
+
+    std::shared_ptr<IContextHub> mHub;
+    std::shared_ptr<TestCallback> mCallback;
+    int32_t mNextTransactionId = 1;
+};
+
+TEST_F(SimulatedHubTest, LoadUnknownNanoappFails) {
+    EXPECT_EQ(load(kUnknownAppId), false);
+}
+
+TEST_F(SimulatedHubTest, NanoappLifecycle) {
+    EXPECT_EQ(load(LoopbackNanoapp::kId), true);
+    EXPECT_EQ(load(LoopbackNanoapp::kId), false);
+
+    ASSERT_TRUE(mHub->queryNanoapps(ContextHub::kMockHubId).isOk());
+    auto nanoapps = mCallback->waitForNanoapps();
+    ASSERT_TRUE(nanoapps.has_value());
+    ASSERT_EQ(nanoapps->size(), 1);
+    EXPECT_EQ((*nanoapps)[0].nanoappId, LoopbackNanoapp::kId);
+    EXPECT_TRUE((*nanoapps)[0].enabled);
+
+    ASSERT_TRUE(mHub->disableNanoapp(ContextHub::kMockHubId, LoopbackNanoapp::kId, 100).isOk());
+    EXPECT_EQ(mCallback->waitForTransaction(100), true);
+    ASSERT_TRUE(mHub->queryNanoapps(ContextHub::kMockHubId).isOk());
+    nanoapps = mCallback->waitForNanoapps();
+    ASSERT_TRUE(nanoapps.has_value());
+    ASSERT_EQ(nanoapps->size(), 1);
+    EXPECT_FALSE((*nanoapps)[0].enabled);
+
+    ASSERT_TRUE(mHub->enableNanoapp(ContextHub::kMockHubId, LoopbackNanoapp::kId, 101).isOk());
+    EXPECT_EQ(mCallback->waitForTransaction(101), true);
+    ASSERT_TRUE(mHub->unloadNanoapp(ContextHub::kMockHubId, LoopbackNanoapp::kId, 102).isOk());
+    EXPECT_EQ(mCallback->waitForTransaction(102), true);
+    ASSERT_TRUE(mHub->unloadNanoapp(ContextHub::kMockHubId, LoopbackNanoapp::kId, 103).isOk());
+    EXPECT_EQ(mCallback->waitForTransaction(103), false);
+    ASSERT_TRUE(mHub->enableNanoapp(ContextHub::kMockHubId, LoopbackNanoapp::kId, 104).isOk());
+    EXPECT_EQ(mCallback->waitForTransaction(104), false);
+}
+
+TEST_F(SimulatedHubTest, LoopbackRoundTrip) {
+    ASSERT_EQ(load(LoopbackNanoapp::kId), true);
+
+    const auto message = makeMessage(LoopbackNanoapp::kId, 42);
+    ASSERT_TRUE(mHub->sendMessageToHub(ContextHub::kMockHubId, message).isOk());
+    auto reply = mCallback->waitForMessage();
+    ASSERT_TRUE(reply.has_value());
+    EXPECT_EQ(reply->nanoappId, LoopbackNanoapp::kId);
+    EXPECT_EQ(reply->hostEndPoint, kHostEndpoint);
+    EXPECT_EQ(reply->messageType, 42);
+    EXPECT_EQ(reply->messageBody, message.messageBody);
+}
+
+TEST_F(SimulatedHubTest, EchoBroadcasts) {
+    ASSERT_EQ(load(EchoNanoapp::kId), true);
+
+    ASSERT_TRUE(
+            mHub->sendMessageToHub(ContextHub::kMockHubId, makeMessage(EchoNanoapp::kId, 1)).isOk());
+    auto reply = mCallback->waitForMessage();
+    ASSERT_TRUE(reply.has_value());
+    EXPECT_EQ(reply->nanoappId, EchoNanoapp::kId);
+    EXPECT_EQ(reply->hostEndPoint, SimulatedHub::kHostEndpointBroadcast);
+}
+
+TEST_F(SimulatedHubTest, MessagesToMissingOrDisabledNanoappsAreDropped) {
+    ASSERT_TRUE(
+            mHub->sendMessageToHub(ContextHub::kMockHubId, makeMessage(kUnknownAppId, 1)).isOk());
+
+    ASSERT_EQ(load(LoopbackNanoapp::kId), true);
+    ASSERT_TRUE(mHub->disableNanoapp(ContextHub::kMockHubId, LoopbackNanoapp::kId, 100).isOk());
+    ASSERT_EQ(mCallback->waitForTransaction(100), true);
+    ASSERT_TRUE(mHub->sendMessageToHub(ContextHub::kMockHubId, makeMessage(LoopbackNanoapp::kId, 1))
+                        .isOk());
+    EXPECT_FALSE(mCallback->waitForMessage(100ms).has_value());
+}
+
+TEST_F(SimulatedHubTest, RepliesToDisconnectedEndpointsAreDropped) {
+    ASSERT_EQ(load(LoopbackNanoapp::kId), true);
+    ASSERT_TRUE(mHub->onHostEndpointDisconnected(kHostEndpoint).isOk());
+
+    ASSERT_TRUE(mHub->sendMessageToHub(ContextHub::kMockHubId, makeMessage(LoopbackNanoapp::kId, 1))
+                        .isOk());
+    EXPECT_FALSE(mCallback->waitForMessage(100ms).has_value());
+}
+
+TEST_F(SimulatedHubTest, MessageTooLongIsRejected) {
+    auto message = makeMessage(LoopbackNanoapp::kId, 1);
+    message.messageBody.resize(ContextHub::kMaxMessageLength + 1);
+    EXPECT_FALSE(mHub->sendMessageToHub(ContextHub::kMockHubId, message).isOk());
+}
+
+TEST_F(SimulatedHubTest, TransactionFailureInjection) {
+    init({.transactionFailureRate = 1});
+    EXPECT_EQ(load(LoopbackNanoapp::kId), false);
+}
+
+TEST_F(SimulatedHubTest, MessageDropInjection) {
+    init({.messageDropRate = 1});
+    ASSERT_EQ(load(LoopbackNanoapp::kId), true);
+    ASSERT_TRUE(mHub->sendMessageToHub(ContextHub::kMockHubId, makeMessage(LoopbackNanoapp::kId, 1))
+                        .isOk());
+    EXPECT_FALSE(mCallback->waitForMessage(100ms).has_value());
+}
+
+TEST_F(SimulatedHubTest, TransactionLatency) {
+    init({.transactionLatency = 50ms});
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(load(LoopbackNanoapp::kId), true);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 50ms);
+}
+
+TEST_F(SimulatedHubTest, FullHubQueueRejectsRequests) {
+    init({.messageLatency = 1s, .hubQueueCapacity = 2});
+    const auto message = makeMessage(LoopbackNanoapp::kId, 1);
+    EXPECT_TRUE(mHub->sendMessageToHub(ContextHub::kMockHubId, message).isOk());
+    EXPECT_TRUE(mHub->sendMessageToHub(ContextHub::kMockHubId, message).isOk());
+    EXPECT_FALSE(mHub->sendMessageToHub(ContextHub::kMockHubId, message).isOk());
+}
+
+TEST_F(SimulatedHubTest, LoopbackThroughput) {
+    constexpr int kMessages = 20000;
+    constexpr int kWindow = 32;
+    ASSERT_EQ(load(LoopbackNanoapp::kId), true);
+
+    // Keeps up to kWindow messages in flight, so neither bounded queue overflows.
+    const auto start = std::chrono::steady_clock::now();
+    int sent = 0;
+    for (int received = 0; received < kMessages; received++) {
+        while (sent < kMessages && sent - received < kWindow) {
+            ASSERT_TRUE(mHub->sendMessageToHub(ContextHub::kMockHubId,
+                                               makeMessage(LoopbackNanoapp::kId, sent))
+                                .isOk());
+            sent++;
+        }
+        auto reply = mCallback->waitForMessage();
+        ASSERT_TRUE(reply.has_value());
+        ASSERT_EQ(reply->messageType, received);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    LOG(INFO) << kMessages << " round trips in " << elapsed.count() << "s ("
+              << kMessages / elapsed.count() << " messages/s)";
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::contexthub
@@ -0,0 +1,442 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BoardDumpCollector.h"
+
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+#include <android-base/thread_annotations.h>
+#include <android-base/unique_fd.h>
+#include <log/log.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace dumpstate {
+
+using ::android::base::Join;
+using ::android::base::ParseUint;
+using ::android::base::ReadFileToString;
+using ::android::base::ScopedLockAssertion;
+using ::android::base::StartsWith;
+using ::android::base::Trim;
+using ::android::base::unique_fd;
+using ::android::base::WriteStringToFd;
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+constexpr size_t kReadChunkBytes = 4096;
+constexpr int kMaxDirectoryDepth = 8;
+
+// A section being collected. It's shared with the thread collecting it, which may outlive the
+// dump if the section hangs.
+class SectionRun {
+  public:
+    SectionRun(const BoardDumpSection& section, steady_clock::time_point deadline,
+               size_t maxBytes)
+        : mSection(section),
+          mStart(steady_clock::now()),
+          mDeadline(deadline),
+          mMaxBytes(maxBytes) {}
+
+    const BoardDumpSection& section() const { return mSection; }
+    steady_clock::time_point deadline() const { return mDeadline; }
+
+    // Returns false once the section should stop, because its deadline passed or its output is
+    // full.
+    bool append(const char* data, size_t size) {
+        std::lock_guard<std::mutex> lock(mLock);
+        const size_t room = mMaxBytes - mOutput.size();
+        mOutput.append(data, std::min(size, room));
+        if (size > room) {
+            mTruncated = true;
+        }
+        return !mTruncated && !checkTimeoutLocked();
+    }
+
+    bool append(const std::string& text) { return append(text.data(), text.size()); }
+
+    bool shouldStop() {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mTruncated || checkTimeoutLocked();
+    }
+
+    void setTimedOut() {
+        std::lock_guard<std::mutex> lock(mLock);
+        mTimedOut = true;
+    }
+
+    void finish() {
+        std::lock_guard<std::mutex> lock(mLock);
+        mDone = true;
+        mEnd = steady_clock::now();
+        mDoneCondition.notify_all();
+    }
+
+    // Waits until the section is done or its deadline passes, then reports it.
+    std::string waitForReport(bool verbose) {
+        std::unique_lock<std::mutex> lock(mLock);
+        ScopedLockAssertion lockAssertion(mLock);
+        mDoneCondition.wait_until(lock, mDeadline, [this] {
+            ScopedLockAssertion lockAssertion(mLock);
+            return mDone;
+        });
+
+        std::string report = std::move(mOutput);
+        mOutput.clear();
+        if (!report.empty() && report.back() != '\n') {
+            report += '\n';
+        }
+        if (!mDone || mTimedOut) {
+            report += "*** " + mSection.name + " timed out after " +
+                      std::to_string(elapsed(steady_clock::now())) + " ms, output truncated\n";
+            return report;
+        }
+        if (mTruncated) {
+            report += "*** " + mSection.name + " output truncated at " +
+                      std::to_string(mMaxBytes) + " bytes\n";
+        }
+        if (verbose) {
+            report += "*** " + mSection.name + " took " + std::to_string(elapsed(mEnd)) +
+                      " ms\n";
+        }
+        return report;
+    }
+
+  private:
+    bool checkTimeoutLocked() REQUIRES(mLock) {
+        mTimedOut = mTimedOut || steady_clock::now() >= mDeadline;
+        return mTimedOut;
+    }
+
+    int64_t elapsed(steady_clock::time_point end) const {
+        return duration_cast<milliseconds>(end - mStart).count();
+    }
+
+    const BoardDumpSection mSection;
+    const steady_clock::time_point mStart;
+    const steady_clock::time_point mDeadline;
+    const size_t mMaxBytes;
+
+    std::mutex mLock;
+    std::condition_variable mDoneCondition;
+    std::string mOutput GUARDED_BY(mLock);
+    bool mTruncated GUARDED_BY(mLock) = false;
+    bool mDone GUARDED_BY(mLock) = false;
+    // Set when the section was stopped by its deadline.
+    bool mTimedOut GUARDED_BY(mLock) = false;
+    steady_clock::time_point mEnd GUARDED_BY(mLock);
+};
+
+void dumpFile(SectionRun* run, const std::string& path) {
+    unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (fd < 0) {
+        run->append("*** Failed to open " + path + ": " + strerror(errno) + "\n");
+        return;
+    }
+    char buffer[kReadChunkBytes];
+    while (true) {
+        ssize_t size = TEMP_FAILURE_RETRY(read(fd.get(), buffer, sizeof(buffer)));
+        if (size < 0) {
+            run->append("*** Failed to read " + path + ": " + strerror(errno) + "\n");
+            return;
+        }
+        if (size == 0 || !run->append(buffer, size)) {
+            return;
+        }
+    }
+}
+
+void dumpDirectory(SectionRun* run, const std::string& path, int depth) {
+    std::unique_ptr<DIR, int (*)(DIR*)> dir(opendir(path.c_str()), closedir);
+    if (!dir) {
+        run->append("*** Failed to open " + path + ": " + strerror(errno) + "\n");
+        return;
+    }
+    std::vector<std::string> names;
+    while (struct dirent* entry = readdir(dir.get())) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            names.push_back(entry->d_name);
+        }
+    }
+    dir.reset();
+    std::sort(names.begin(), names.end());
+
+    for (const auto& name : names) {
+        if (run->shouldStop()) {
+            return;
+        }
+        const std::string child = path + "/" + name;
+        // Links are not followed, as sysfs is full of cycles.
+        struct stat st;
+        if (lstat(child.c_str(), &st) != 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode) && depth < kMaxDirectoryDepth) {
+            dumpDirectory(run, child, depth + 1);
+        } else if (S_ISREG(st.st_mode)) {
+            run->append("--- " + child + " ---\n");
+            dumpFile(run, child);
+        }
+    }
+}
+
+void runCommand(SectionRun* run, const std::vector<std::string>& command) {
+    // Everything the child needs is prepared before forking.
+    std::vector<char*> argv;
+    for (const auto& arg : command) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    int pipeFds[2];
+    if (pipe2(pipeFds, O_CLOEXEC) != 0) {
+        run->append(std::string("*** Failed to create a pipe: ") + strerror(errno) + "\n");
+        return;
+    }
+    unique_fd readEnd(pipeFds[0]);
+    unique_fd writeEnd(pipeFds[1]);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        run->append(std::string("*** Failed to fork: ") + strerror(errno) + "\n");
+        return;
+    }
+    if (pid == 0) {
+        int devNull = open("/dev/null", O_RDONLY);
+        if (devNull < 0 || dup2(devNull, STDIN_FILENO) < 0 ||
+            dup2(writeEnd.get(), STDOUT_FILENO) < 0 || dup2(writeEnd.get(), STDERR_FILENO) < 0) {
+            _exit(127);
+        }
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    writeEnd.reset();
+
+    bool killed = false;
+    char buffer[kReadChunkBytes];
+    while (true) {
+        auto remaining = duration_cast<milliseconds>(run->deadline() - steady_clock::now());
+        struct pollfd pfd = {.fd = readEnd.get(), .events = POLLIN, .revents = 0};
+        int ready = remaining.count() > 0
+                            ? TEMP_FAILURE_RETRY(poll(&pfd, 1, static_cast<int>(remaining.count())))
+                            : 0;
+        ssize_t size = 0;
+        if (ready > 0) {
+            size = TEMP_FAILURE_RETRY(read(readEnd.get(), buffer, sizeof(buffer)));
+            if (size <= 0) {
+                break;
+            }
+        }
+        if (ready <= 0) {
+            run->setTimedOut();
+        }
+        if (ready <= 0 || !run->append(buffer, size)) {
+            // Timed out, or produced enough output.
+            kill(pid, SIGKILL);
+            killed = true;
+            break;
+        }
+    }
+
+    int status;
+    if (TEMP_FAILURE_RETRY(waitpid(pid, &status, 0)) != pid || killed) {
+        return;
+    }
+    if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+        run->append("*** " + command[0] + " exited with status " +
+                    std::to_string(WEXITSTATUS(status)) + "\n");
+    } else if (WIFSIGNALED(status)) {
+        run->append("*** " + command[0] + " was killed by signal " +
+                    std::to_string(WTERMSIG(status)) + "\n");
+    }
+}
+
+void collectSection(SectionRun* run) {
+    const BoardDumpSection& section = run->section();
+    switch (section.kind) {
+        case BoardDumpSection::Kind::FILE:
+            dumpFile(run, section.target[0]);
+            break;
+        case BoardDumpSection::Kind::DIRECTORY:
+            dumpDirectory(run, section.target[0], 0);
+            break;
+        case BoardDumpSection::Kind::COMMAND:
+            runCommand(run, section.target);
+            break;
+    }
+}
+
+bool isSelected(const BoardDumpSection& section, bool full, bool verbose) {
+    switch (section.mode) {
+        case BoardDumpSection::Mode::ALWAYS:
+            return true;
+        case BoardDumpSection::Mode::FULL:
+            return full;
+        case BoardDumpSection::Mode::VERBOSE:
+            return verbose;
+    }
+    return false;
+}
+
+}  // namespace
+
+std::vector<BoardDumpSection> BoardDumpCollector::parseConfig(const std::string& config) {
+    std::vector<BoardDumpSection> sections;
+    std::istringstream lines(config);
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(lines, line)) {
+        lineNumber++;
+        line = Trim(line);
+        if (line.empty() || StartsWith(line, "#")) {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::string kind, timeout, mode, word;
+        BoardDumpSection section;
+        fields >> kind >> section.name >> timeout >> mode;
+        while (fields >> word) {
+            section.target.push_back(word);
+        }
+
+        bool valid = !section.target.empty();
+        if (kind == "file" || kind == "dir") {
+            section.kind = kind == "file" ? BoardDumpSection::Kind::FILE
+                                          : BoardDumpSection::Kind::DIRECTORY;
+            valid = valid && section.target.size() == 1;
+        } else if (kind == "command") {
+            section.kind = BoardDumpSection::Kind::COMMAND;
+            // Commands are not looked up in PATH.
+            valid = valid && StartsWith(section.target[0], "/");
+        } else {
+            valid = false;
+        }
+        if (mode == "always") {
+            section.mode = BoardDumpSection::Mode::ALWAYS;
+        } else if (mode == "full") {
+            section.mode = BoardDumpSection::Mode::FULL;
+        } else if (mode == "verbose") {
+            section.mode = BoardDumpSection::Mode::VERBOSE;
+        } else {
+            valid = false;
+        }
+        uint32_t timeoutMs;
+        if (!ParseUint(timeout, &timeoutMs) || timeoutMs == 0) {
+            valid = false;
+        }
+        if (!valid) {
+            ALOGE("Ignoring invalid board dump section on line %d: %s", lineNumber, line.c_str());
+            continue;
+        }
+        section.timeout = milliseconds(timeoutMs);
+        sections.push_back(std::move(section));
+    }
+    return sections;
+}
+
+std::vector<BoardDumpSection> BoardDumpCollector::loadConfig(const std::string& path) {
+    std::string config;
+    if (!ReadFileToString(path, &config)) {
+        if (errno != ENOENT) {
+            ALOGE("Failed to read %s: %s", path.c_str(), strerror(errno));
+        }
+        return defaultSections();
+    }
+    return parseConfig(config);
+}
+
+std::vector<BoardDumpSection> BoardDumpCollector::defaultSections() {
+    return parseConfig(
+            "file cmdline 1000 always /proc/self/cmdline\n"
+            "file version 1000 always /proc/version\n"
+            "file interrupts 2000 full /proc/interrupts\n");
+}
+
+BoardDumpCollector::BoardDumpCollector(std::vector<BoardDumpSection> sections)
+    : BoardDumpCollector(std::move(sections), Options()) {}
+
+BoardDumpCollector::BoardDumpCollector(std::vector<BoardDumpSection> sections, Options options)
+    : mSections(std::move(sections)), mOptions(options) {}
+
+void BoardDumpCollector::collect(int fd, bool full, bool verbose, milliseconds budget) const {
+    const auto deadline = steady_clock::now() + budget;
+    std::vector<const BoardDumpSection*> selected;
+    for (const auto& section : mSections) {
+        if (isSelected(section, full, verbose)) {
+            selected.push_back(&section);
+        }
+    }
+
+    // Sections are started in order, at most a window ahead of the one being written, so that
+    // hung sections stop holding back the others once they're reported.
+    const size_t window = std::max<size_t>(1, mOptions.maxParallelSections);
+    std::vector<std::shared_ptr<SectionRun>> runs;
+    for (size_t i = 0; i < selected.size(); ++i) {
+        while (runs.size() < selected.size() && runs.size() < i + window &&
+               steady_clock::now() < deadline) {
+            const BoardDumpSection& section = *selected[runs.size()];
+            auto run = std::make_shared<SectionRun>(
+                    section, std::min(steady_clock::now() + section.timeout, deadline),
+                    mOptions.maxSectionBytes);
+            std::thread([run] {
+                collectSection(run.get());
+                run->finish();
+            }).detach();
+            runs.push_back(std::move(run));
+        }
+
+        const BoardDumpSection& section = *selected[i];
+        std::string report =
+                "------ " + section.name + " (" + Join(section.target, ' ') + ") ------\n";
+        if (i < runs.size()) {
+            report += runs[i]->waitForReport(verbose);
+            runs[i].reset();
+        } else {
+            report += "*** " + section.name + " skipped, the dump ran out of time\n";
+        }
+        if (!WriteStringToFd(report, fd)) {
+            ALOGE("Failed to write the board dump: %s", strerror(errno));
+            return;
+        }
+    }
+}
+
+}  // namespace dumpstate
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
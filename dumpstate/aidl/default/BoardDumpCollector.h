@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace dumpstate {
+
+struct BoardDumpSection {
+    enum class Kind {
+        FILE,
+        // Every regular file below the directory, in name order.
+        DIRECTORY,
+        COMMAND,
+    };
+
+    // When the section is included in a dump.
+    enum class Mode {
+        ALWAYS,
+        FULL,
+        VERBOSE,
+    };
+
+    Kind kind = Kind::FILE;
+    std::string name;
+    // The path to dump, or the command and its arguments.
+    std::vector<std::string> target;
+    std::chrono::milliseconds timeout{0};
+    Mode mode = Mode::ALWAYS;
+};
+
+/**
+ * Collects the board sections of a bug report. Sections run concurrently, each until its own
+ * timeout or the deadline of the whole dump, and are written in configuration order as soon as
+ * they and all the sections before them are done.
+ *
+ * A section which overruns is reported with the output it produced so far. Commands are killed,
+ * but a read blocked in a driver can't be interrupted, so its thread is left behind to finish on
+ * its own.
+ */
+class BoardDumpCollector {
+  public:
+    struct Options {
+        // How many sections may be collected at once, not counting abandoned ones.
+        size_t maxParallelSections = 4;
+        // Longer output is truncated.
+        size_t maxSectionBytes = 1024 * 1024;
+    };
+
+    /**
+     * Parses a configuration with one section per line:
+     *
+     *   <file|dir|command> <name> <timeout ms> <always|full|verbose> <path or command...>
+     *
+     * Empty lines and lines starting with '#' are ignored, invalid ones are logged and skipped.
+     */
+    static std::vector<BoardDumpSection> parseConfig(const std::string& config);
+
+    // The sections configured in the given file, or the default ones if it can't be read.
+    static std::vector<BoardDumpSection> loadConfig(const std::string& path);
+
+    static std::vector<BoardDumpSection> defaultSections();
+
+    explicit BoardDumpCollector(std::vector<BoardDumpSection> sections);
+    BoardDumpCollector(std::vector<BoardDumpSection> sections, Options options);
+
+    // Writes the sections selected by the mode into fd, returning within the budget.
+    void collect(int fd, bool full, bool verbose, std::chrono::milliseconds budget) const;
+
+  private:
+    const std::vector<BoardDumpSection> mSections;
+    const Options mOptions;
+};
+
+}  // namespace dumpstate
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -16,24 +16,24 @@
 
 #include <android-base/properties.h>
 #include <log/log.h>
-#include "DumpstateUtil.h"
 
 #include "Dumpstate.h"
 
-using android::os::dumpstate::DumpFileToFd;
-
 namespace aidl {
 namespace android {
 namespace hardware {
 namespace dumpstate {
 
 const char kVerboseLoggingProperty[] = "persist.dumpstate.verbose_logging.enabled";
+const char kBoardDumpConfig[] = "/vendor/etc/dumpstate/board_dump.conf";
+// Used when the caller sets no timeout.
+constexpr std::chrono::milliseconds kDefaultTimeout = std::chrono::seconds(30);
+
+Dumpstate::Dumpstate() : mCollector(BoardDumpCollector::loadConfig(kBoardDumpConfig)) {}
 
 ndk::ScopedAStatus Dumpstate::dumpstateBoard(const std::vector<::ndk::ScopedFileDescriptor>& in_fds,
                                              IDumpstateDevice::DumpstateMode in_mode,
                                              int64_t in_timeoutMillis) {
-    (void)in_timeoutMillis;
-
     if (in_fds.size() < 1) {
         return ndk::ScopedAStatus::fromExceptionCodeWithMessage(EX_ILLEGAL_ARGUMENT,
                                                                 "No file descriptor");
@@ -45,12 +45,14 @@ ndk::ScopedAStatus Dumpstate::dumpstateBoard(const std::vector<::ndk::ScopedFile
                                                                 "Invalid file descriptor");
     }
 
+    const auto timeout =
+            in_timeoutMillis > 0 ? std::chrono::milliseconds(in_timeoutMillis) : kDefaultTimeout;
     switch (in_mode) {
         case IDumpstateDevice::DumpstateMode::FULL:
-            return dumpstateBoardImpl(fd, true);
+            return dumpstateBoardImpl(fd, true, timeout);
 
         case IDumpstateDevice::DumpstateMode::DEFAULT:
-            return dumpstateBoardImpl(fd, false);
+            return dumpstateBoardImpl(fd, false, timeout);
 
         case IDumpstateDevice::DumpstateMode::INTERACTIVE:
         case IDumpstateDevice::DumpstateMode::REMOTE:
@@ -83,14 +85,16 @@ bool Dumpstate::getVerboseLoggingEnabledImpl() {
     return ::android::base::GetBoolProperty(kVerboseLoggingProperty, false);
 }
 
-ndk::ScopedAStatus Dumpstate::dumpstateBoardImpl(const int fd, const bool full) {
+ndk::ScopedAStatus Dumpstate::dumpstateBoardImpl(const int fd, const bool full,
+                                                 std::chrono::milliseconds timeout) {
     ALOGD("DumpstateDevice::dumpstateBoard() FD: %d\n", fd);
 
-    dprintf(fd, "verbose logging: %s\n", getVerboseLoggingEnabledImpl() ? "enabled" : "disabled");
+    const bool verbose = getVerboseLoggingEnabledImpl();
+    dprintf(fd, "verbose logging: %s\n", verbose ? "enabled" : "disabled");
     dprintf(fd, "[%s] %s\n", (full ? "full" : "default"), "Hello, world!");
 
-    // Shows an example on how to use the libdumpstateutil API.
-    DumpFileToFd(fd, "cmdline", "/proc/self/cmdline");
+    // A tenth of the time is left for dumpstate to wrap up.
+    mCollector.collect(fd, full, verbose, timeout - timeout / 10);
 
     return ndk::ScopedAStatus::ok();
 }
@@ -20,6 +20,10 @@
 #include <aidl/android/hardware/dumpstate/IDumpstateDevice.h>
 #include <android/binder_status.h>
 
+#include <chrono>
+
+#include "BoardDumpCollector.h"
+
 namespace aidl {
 namespace android {
 namespace hardware {
@@ -28,9 +32,14 @@ namespace dumpstate {
 class Dumpstate : public BnDumpstateDevice {
   private:
     bool getVerboseLoggingEnabledImpl();
-    ::ndk::ScopedAStatus dumpstateBoardImpl(const int fd, const bool full);
+    ::ndk::ScopedAStatus dumpstateBoardImpl(const int fd, const bool full,
+                                            std::chrono::milliseconds timeout);
+
+    const BoardDumpCollector mCollector;
 
   public:
+    Dumpstate();
+
     ::ndk::ScopedAStatus dumpstateBoard(const std::vector<::ndk::ScopedFileDescriptor>& in_fds,
                                         IDumpstateDevice::DumpstateMode in_mode,
                                         int64_t in_timeoutMillis) override;
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BoardDumpCollector.h"
+
+#include <android-base/file.h>
+#include <android-base/unique_fd.h>
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace dumpstate {
+namespace {
+
+using ::android::base::ReadFileToString;
+using ::android::base::unique_fd;
+using ::android::base::WriteStringToFile;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+#ifdef __ANDROID__
+constexpr char kShell[] = "/system/bin/sh";
+#else
+constexpr char kShell[] = "/bin/sh";
+#endif
+
+class BoardDumpCollectorTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mRoot = mDir.path;
+        ASSERT_TRUE(WriteStringToFile("board rev 3\n", mRoot + "/revision"));
+        ASSERT_EQ(mkdir((mRoot + "/thermal").c_str(), 0700), 0);
+        ASSERT_EQ(mkdir((mRoot + "/thermal/zone1").c_str(), 0700), 0);
+        ASSERT_TRUE(WriteStringToFile("42000", mRoot + "/thermal/zone1/temp"));
+        ASSERT_TRUE(WriteStringToFile("cpu\n", mRoot + "/thermal/type"));
+        ASSERT_EQ(symlink(mRoot.c_str(), (mRoot + "/thermal/loop").c_str()), 0);
+    }
+
+    void TearDown() override {
+        if (!mFifo.empty()) {
+            // Unblocks the thread left waiting on the FIFO.
+            unique_fd writer(open(mFifo.c_str(), O_WRONLY | O_CLOEXEC));
+        }
+    }
+
+    // A command running the given shell script.
+    std::string makeCommand(const std::string& name, const std::string& script) {
+        const std::string path = mRoot + "/" + name + ".sh";
+        EXPECT_TRUE(WriteStringToFile(script, path));
+        return std::string(kShell) + " " + path;
+    }
+
+    // A file whose reads hang, like a stuck driver node.
+    std::string makeHangingFile() {
+        mFifo = mRoot + "/hang";
+        EXPECT_EQ(mkfifo(mFifo.c_str(), 0600), 0);
+        return mFifo;
+    }
+
+    std::string collect(const std::string& config, bool full, bool verbose,
+                        milliseconds budget = milliseconds(10000),
+                        BoardDumpCollector::Options options = {}) {
+        BoardDumpCollector collector(BoardDumpCollector::parseConfig(config), options);
+        TemporaryFile output;
+        collector.collect(output.fd, full, verbose, budget);
+        std::string content;
+        EXPECT_TRUE(ReadFileToString(output.path, &content));
+        return content;
+    }
+
+    TemporaryDir mDir;
+    std::string mRoot;
+    std::string mFifo;
+};
+
+TEST_F(BoardDumpCollectorTest, ParsesConfig) {
+    auto sections = BoardDumpCollector::parseConfig(
+            "# kind name timeout mode target\n"
+            "\n"
+            "file revision 100 always /revision\n"
+            "dir thermal 200 full /thermal\n"
+            "command ps 300 verbose /bin/ps -A\n"
+            "command relative 300 always ps\n"
+            "file two 100 always /a /b\n"
+            "file zero 0 always /a\n"
+            "file mode 100 sometimes /a\n"
+            "pipe name 100 always /a\n");
+    ASSERT_EQ(sections.size(), 3u);
+    EXPECT_EQ(sections[0].kind, BoardDumpSection::Kind::FILE);
+    EXPECT_EQ(sections[0].name, "revision");
+    EXPECT_EQ(sections[0].timeout, milliseconds(100));
+    EXPECT_EQ(sections[0].mode, BoardDumpSection::Mode::ALWAYS);
+    EXPECT_EQ(sections[1].kind, BoardDumpSection::Kind::DIRECTORY);
+    EXPECT_EQ(sections[1].mode, BoardDumpSection::Mode::FULL);
+    EXPECT_EQ(sections[2].kind, BoardDumpSection::Kind::COMMAND);
+    EXPECT_EQ(sections[2].mode, BoardDumpSection::Mode::VERBOSE);
+    EXPECT_EQ(sections[2].target, (std::vector<std::string>{"/bin/ps", "-A"}));
+}
+
+TEST_F(BoardDumpCollectorTest, WritesSectionsInConfigOrder) {
+    // The first section finishes last.
+    std::string output =
+            collect("command slow 5000 always " + makeCommand("slow", "sleep 0.3\necho slow\n") +
+                            "\nfile revision 1000 always " + mRoot + "/revision\n"
+                            "dir thermal 1000 always " + mRoot + "/thermal\n",
+                    false, false);
+    size_t slow = output.find("------ slow");
+    size_t revision = output.find("------ revision");
+    size_t thermal = output.find("------ thermal");
+    ASSERT_NE(slow, std::string::npos) << output;
+    EXPECT_LT(slow, revision);
+    EXPECT_LT(revision, thermal);
+    EXPECT_NE(output.find("board rev 3\n", revision), std::string::npos);
+    // Directory files are in name order, and links aren't followed.
+    size_t type = output.find("--- " + mRoot + "/thermal/type ---\ncpu\n", thermal);
+    size_t temp = output.find("--- " + mRoot + "/thermal/zone1/temp ---\n42000\n", thermal);
+    EXPECT_NE(type, std::string::npos) << output;
+    EXPECT_LT(type, temp);
+    EXPECT_EQ(output.find("/thermal/loop"), std::string::npos);
+}
+
+TEST_F(BoardDumpCollectorTest, SkipsHangingFile) {
+    const auto start = steady_clock::now();
+    std::string output = collect("file stuck 200 always " + makeHangingFile() + "\n" +
+                                         "file revision 1000 always " + mRoot + "/revision\n",
+                                 false, false);
+    EXPECT_LT(steady_clock::now() - start, milliseconds(2000));
+    EXPECT_NE(output.find("*** stuck timed out after"), std::string::npos) << output;
+    EXPECT_NE(output.find("board rev 3\n"), std::string::npos) << output;
+}
+
+TEST_F(BoardDumpCollectorTest, KillsHangingCommand) {
+    const auto start = steady_clock::now();
+    std::string output = collect("command stuck 200 always " +
+                                         makeCommand("stuck", "echo started\nsleep 10\n") + "\n",
+                                 false, false);
+    EXPECT_LT(steady_clock::now() - start, milliseconds(2000));
+    EXPECT_NE(output.find("started\n*** stuck timed out after"), std::string::npos) << output;
+}
+
+TEST_F(BoardDumpCollectorTest, ReportsFailingCommands) {
+    std::string output =
+            collect("command fail 1000 always " + makeCommand("fail", "exit 3\n") + "\n", false,
+                    false);
+    EXPECT_NE(output.find("exited with status 3"), std::string::npos) << output;
+}
+
+TEST_F(BoardDumpCollectorTest, TruncatesLongOutput) {
+    BoardDumpCollector::Options options;
+    options.maxSectionBytes = 4;
+    std::string output = collect("file revision 1000 always " + mRoot + "/revision\n", false,
+                                 false, milliseconds(10000), options);
+    EXPECT_NE(output.find("boar\n*** revision output truncated at 4 bytes\n"), std::string::npos)
+            << output;
+}
+
+TEST_F(BoardDumpCollectorTest, SelectsSectionsByMode) {
+    const std::string config = "file always 1000 always " + mRoot + "/revision\n" +
+                               "file full 1000 full " + mRoot + "/revision\n" +
+                               "file verbose 1000 verbose " + mRoot + "/revision\n";
+    std::string output = collect(config, false, false);
+    EXPECT_NE(output.find("------ always"), std::string::npos);
+    EXPECT_EQ(output.find("------ full"), std::string::npos);
+    EXPECT_EQ(output.find("------ verbose"), std::string::npos);
+    EXPECT_EQ(output.find(" took "), std::string::npos);
+
+    output = collect(config, true, true);
+    EXPECT_NE(output.find("------ full"), std::string::npos);
+    EXPECT_NE(output.find("------ verbose"), std::string::npos);
+    EXPECT_NE(output.find("*** always took "), std::string::npos);
+}
+
+TEST_F(BoardDumpCollectorTest, HonorsTotalBudget) {
+    BoardDumpCollector::Options options;
+    options.maxParallelSections = 1;
+    const auto start = steady_clock::now();
+    std::string output = collect("file stuck 5000 always " + makeHangingFile() + "\n" +
+                                         "file revision 1000 always " + mRoot + "/revision\n",
+                                 false, false, milliseconds(300), options);
+    EXPECT_LT(steady_clock::now() - start, milliseconds(2000));
+    EXPECT_NE(output.find("*** stuck timed out after"), std::string::npos) << output;
+    EXPECT_NE(output.find("*** revision skipped, the dump ran out of time"), std::string::npos)
+            << output;
+}
+
+}  // namespace
+}  // namespace dumpstate
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
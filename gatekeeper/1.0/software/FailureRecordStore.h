@@ -0,0 +1,212 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef FAILURE_RECORD_STORE_H_
+#define FAILURE_RECORD_STORE_H_
+
+extern "C" {
+#include <openssl/mem.h>
+#include <openssl/sha.h>
+}
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+#include <gatekeeper/gatekeeper.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace gatekeeper {
+
+/**
+ * Failure records of the software gatekeeper, keyed by uid. When given a path, the records are
+ * loaded from it on construction and every change is written back before it takes effect, so
+ * lockout throttling survives a restart of the service.
+ *
+ * The file is replaced atomically: the records are written to a temporary file next to it, which
+ * is synced and renamed over the old one. A crash leaves either the old or the new records, never
+ * a mix. A file that fails its checksum is ignored.
+ *
+ * If the records can't be written, for instance because the device's sepolicy doesn't let the
+ * service write to the path, changes still take effect in memory and an error is logged.
+ * Throttling then only lasts until the service restarts, as it does with an empty path, which
+ * keeps the records in memory only. All methods are thread safe.
+ */
+class FailureRecordStore {
+  public:
+    explicit FailureRecordStore(std::string path) : path_(std::move(path)) {
+        if (!path_.empty()) Load();
+    }
+
+    const std::string& path() const { return path_; }
+
+    // Returns false, leaving record untouched, if there is no record for uid.
+    bool Get(uint32_t uid, failure_record_t* record) const {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto it = records_.find(uid);
+        if (it == records_.end()) return false;
+        *record = it->second;
+        return true;
+    }
+
+    void Put(uint32_t uid, const failure_record_t& record) {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto it = records_.find(uid);
+        if (it != records_.end() && Equals(it->second, record)) return;
+
+        records_[uid] = record;
+        bool persisted = Persist(records_);
+        if (!persisted && persisted_) {
+            LOG(ERROR) << "Keeping failure records in memory only, throttling won't survive a "
+                          "restart";
+        } else if (persisted && !persisted_) {
+            LOG(INFO) << "Failure records persisted to " << path_ << " again";
+        }
+        persisted_ = persisted;
+    }
+
+    // Whether the records in memory have been persisted, always true with an empty path.
+    bool persisted() const {
+        std::lock_guard<std::mutex> lock(lock_);
+        return persisted_;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(lock_);
+        return records_.size();
+    }
+
+  private:
+    typedef std::map<uint32_t, failure_record_t> RecordMap;
+
+    static constexpr uint32_t kMagic = 0x52464b47;  // "GKFR"
+    static constexpr uint32_t kVersion = 1;
+
+    struct __attribute__((__packed__)) FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t count;
+    };
+
+    struct __attribute__((__packed__)) FileEntry {
+        uint32_t uid;
+        failure_record_t record;
+    };
+
+    static bool Equals(const failure_record_t& a, const failure_record_t& b) {
+        return a.secure_user_id == b.secure_user_id &&
+               a.last_checked_timestamp == b.last_checked_timestamp &&
+               a.failure_counter == b.failure_counter;
+    }
+
+    void Load() {
+        std::string contents;
+        if (!android::base::ReadFileToString(path_, &contents)) {
+            if (errno != ENOENT) PLOG(ERROR) << "Failed to read failure records from " << path_;
+            return;
+        }
+
+        FileHeader header;
+        if (contents.size() < sizeof(header) + SHA256_DIGEST_LENGTH) {
+            LOG(ERROR) << "Ignoring truncated failure records in " << path_;
+            return;
+        }
+        memcpy(&header, contents.data(), sizeof(header));
+        size_t body_size = sizeof(header) + static_cast<size_t>(header.count) * sizeof(FileEntry);
+        if (header.magic != kMagic || header.version != kVersion ||
+            contents.size() != body_size + SHA256_DIGEST_LENGTH) {
+            LOG(ERROR) << "Ignoring malformed failure records in " << path_;
+            return;
+        }
+
+        uint8_t digest[SHA256_DIGEST_LENGTH];
+        SHA256(reinterpret_cast<const uint8_t*>(contents.data()), body_size, digest);
+        if (CRYPTO_memcmp(digest, contents.data() + body_size, sizeof(digest)) != 0) {
+            LOG(ERROR) << "Ignoring corrupted failure records in " << path_;
+            return;
+        }
+
+        const char* entries = contents.data() + sizeof(header);
+        for (uint32_t i = 0; i < header.count; ++i) {
+            FileEntry entry;
+            memcpy(&entry, entries + i * sizeof(entry), sizeof(entry));
+            records_[entry.uid] = entry.record;
+        }
+    }
+
+    bool Persist(const RecordMap& records) const {
+        if (path_.empty()) return true;
+
+        FileHeader header = {kMagic, kVersion, static_cast<uint32_t>(records.size())};
+        std::string contents(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& [uid, record] : records) {
+            FileEntry entry = {uid, record};
+            contents.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        }
+        uint8_t digest[SHA256_DIGEST_LENGTH];
+        SHA256(reinterpret_cast<const uint8_t*>(contents.data()), contents.size(), digest);
+        contents.append(reinterpret_cast<const char*>(digest), sizeof(digest));
+
+        std::string temp_path = path_ + ".tmp";
+        {
+            android::base::unique_fd fd(TEMP_FAILURE_RETRY(
+                    open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)));
+            if (fd < 0) {
+                PLOG(ERROR) << "Failed to create " << temp_path;
+                return false;
+            }
+            if (!android::base::WriteFully(fd, contents.data(), contents.size()) ||
+                fsync(fd) != 0) {
+                PLOG(ERROR) << "Failed to write " << temp_path;
+                unlink(temp_path.c_str());
+                return false;
+            }
+        }
+        if (rename(temp_path.c_str(), path_.c_str()) != 0) {
+            PLOG(ERROR) << "Failed to replace " << path_;
+            unlink(temp_path.c_str());
+            return false;
+        }
+
+        // The rename itself only survives a crash once the directory is synced. The new records
+        // are in place either way, so a failure here is only logged.
+        std::string dir = android::base::Dirname(path_);
+        android::base::unique_fd dir_fd(
+                TEMP_FAILURE_RETRY(open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)));
+        if (dir_fd < 0 || fsync(dir_fd) != 0) {
+            PLOG(WARNING) << "Failed to sync " << dir;
+        }
+        return true;
+    }
+
+    const std::string path_;
+    mutable std::mutex lock_;
+    RecordMap records_;
+    bool persisted_ = true;
+};
+
+}  // namespace gatekeeper
+
+#endif  // FAILURE_RECORD_STORE_H_
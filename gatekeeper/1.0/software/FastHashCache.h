@@ -0,0 +1,94 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef FAST_HASH_CACHE_H_
+#define FAST_HASH_CACHE_H_
+
+extern "C" {
+#include <openssl/sha.h>
+}
+
+#include <gatekeeper/password_handle.h>
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace gatekeeper {
+
+struct fast_hash_t {
+    uint64_t salt;
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    // Signature of the password handle the password was verified against. A fast hash only
+    // stands in for the handle it was computed for, not for one enrolled after it.
+    uint8_t handle_signature[sizeof(password_handle_t::signature)];
+};
+
+/**
+ * A thread safe cache of fast hashes by secure user id, holding at most capacity entries. Once
+ * full, inserting a new user evicts the least recently used one. A capacity of 0 disables caching.
+ */
+class FastHashCache {
+  public:
+    explicit FastHashCache(size_t capacity) : capacity_(capacity) {}
+
+    // Copies the entry of user_id to fast_hash and marks it as recently used.
+    bool Get(uint64_t user_id, fast_hash_t* fast_hash) {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto it = index_.find(user_id);
+        if (it == index_.end()) return false;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        *fast_hash = it->second->second;
+        return true;
+    }
+
+    void Put(uint64_t user_id, const fast_hash_t& fast_hash) {
+        if (capacity_ == 0) return;
+        std::lock_guard<std::mutex> lock(lock_);
+        auto it = index_.find(user_id);
+        if (it != index_.end()) {
+            it->second->second = fast_hash;
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return;
+        }
+        if (entries_.size() == capacity_) {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+        entries_.emplace_front(user_id, fast_hash);
+        index_[user_id] = entries_.begin();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(lock_);
+        return entries_.size();
+    }
+
+  private:
+    typedef std::list<std::pair<uint64_t, fast_hash_t>> EntryList;
+
+    const size_t capacity_;
+    mutable std::mutex lock_;
+    // Most recently used first.
+    EntryList entries_;
+    std::unordered_map<uint64_t, EntryList::iterator> index_;
+};
+
+}  // namespace gatekeeper
+
+#endif  // FAST_HASH_CACHE_H_
@@ -30,15 +30,19 @@ extern "C" {
 
 #include <iostream>
 #include <memory>
-#include <unordered_map>
+#include <mutex>
+#include <string>
 
-namespace gatekeeper {
+#include "FailureRecordStore.h"
+#include "FastHashCache.h"
 
-struct fast_hash_t {
-    uint64_t salt;
-    uint8_t digest[SHA256_DIGEST_LENGTH];
-};
+namespace gatekeeper {
 
+/**
+ * Software gatekeeper. Enroll and Verify may be called from several threads at once: requests of
+ * the same uid are serialized so that failure records are updated consistently, while requests of
+ * different uids run their scrypt computations concurrently.
+ */
 class SoftGateKeeper : public GateKeeper {
   public:
     static const uint32_t SIGNATURE_LENGTH_BYTES = 32;
@@ -50,11 +54,28 @@ class SoftGateKeeper : public GateKeeper {
 
     static const int MAX_UINT_32_CHARS = 11;
 
-    SoftGateKeeper() {
+    static const size_t DEFAULT_FAST_HASH_CAPACITY = 16;
+
+    // Failure records are persisted to failure_record_path, or kept in memory if it's empty.
+    explicit SoftGateKeeper(const std::string& failure_record_path = "",
+                            size_t fast_hash_capacity = DEFAULT_FAST_HASH_CAPACITY)
+        : failure_records_(failure_record_path), fast_hashes_(fast_hash_capacity) {
         key_.reset(new uint8_t[SIGNATURE_LENGTH_BYTES]);
         memset(key_.get(), 0, SIGNATURE_LENGTH_BYTES);
     }
 
+    // These hide the non-virtual GateKeeper methods to serialize requests per uid, as the failure
+    // record of a uid is read, checked and written back across a whole request.
+    void Enroll(const EnrollRequest& request, EnrollResponse* response) {
+        std::lock_guard<std::mutex> lock(UserLock(request.user_id));
+        GateKeeper::Enroll(request, response);
+    }
+
+    void Verify(const VerifyRequest& request, VerifyResponse* response) {
+        std::lock_guard<std::mutex> lock(UserLock(request.user_id));
+        GateKeeper::Verify(request, response);
+    }
+
     virtual ~SoftGateKeeper() {}
 
     virtual bool GetAuthTokenKey(const uint8_t** auth_token_key, uint32_t* length) const {
@@ -100,31 +121,33 @@ class SoftGateKeeper : public GateKeeper {
 
     virtual bool GetFailureRecord(uint32_t uid, secure_id_t user_id, failure_record_t* record,
                                   bool /* secure */) {
-        failure_record_t* stored = &failure_map_[uid];
-        if (user_id != stored->secure_user_id) {
-            stored->secure_user_id = user_id;
-            stored->last_checked_timestamp = 0;
-            stored->failure_counter = 0;
+        failure_record_t stored = {};
+        failure_records_.Get(uid, &stored);
+        if (user_id != stored.secure_user_id) {
+            stored.secure_user_id = user_id;
+            stored.last_checked_timestamp = 0;
+            stored.failure_counter = 0;
         }
-        memcpy(record, stored, sizeof(*record));
+        memcpy(record, &stored, sizeof(*record));
         return true;
     }
 
     virtual bool ClearFailureRecord(uint32_t uid, secure_id_t user_id, bool /* secure */) {
-        failure_record_t* stored = &failure_map_[uid];
-        stored->secure_user_id = user_id;
-        stored->last_checked_timestamp = 0;
-        stored->failure_counter = 0;
+        failure_record_t cleared = {};
+        cleared.secure_user_id = user_id;
+        cleared.last_checked_timestamp = 0;
+        cleared.failure_counter = 0;
+        failure_records_.Put(uid, cleared);
         return true;
     }
 
     virtual bool WriteFailureRecord(uint32_t uid, failure_record_t* record, bool /* secure */) {
-        failure_map_[uid] = *record;
+        failure_records_.Put(uid, *record);
         return true;
     }
 
     fast_hash_t ComputeFastHash(const SizedBuffer& password, uint64_t salt) {
-        fast_hash_t fast_hash;
+        fast_hash_t fast_hash = {};
         size_t digest_size = password.size() + sizeof(salt);
         std::unique_ptr<uint8_t[]> digest(new uint8_t[digest_size]);
         memcpy(digest.get(), &salt, sizeof(salt));
@@ -143,28 +166,38 @@ class SoftGateKeeper : public GateKeeper {
 
     bool DoVerify(const password_handle_t* expected_handle, const SizedBuffer& password) {
         uint64_t user_id = android::base::get_unaligned<secure_id_t>(&expected_handle->user_id);
-        FastHashMap::const_iterator it = fast_hash_map_.find(user_id);
-        if (it != fast_hash_map_.end() && VerifyFast(it->second, password)) {
+        fast_hash_t cached;
+        if (fast_hashes_.Get(user_id, &cached) &&
+            memcmp(cached.handle_signature, expected_handle->signature,
+                   sizeof(cached.handle_signature)) == 0 &&
+            VerifyFast(cached, password)) {
+            return true;
+        }
+
+        // The scrypt computation runs without any lock held.
+        if (GateKeeper::DoVerify(expected_handle, password)) {
+            uint64_t salt;
+            GetRandom(&salt, sizeof(salt));
+            fast_hash_t fast_hash = ComputeFastHash(password, salt);
+            memcpy(fast_hash.handle_signature, expected_handle->signature,
+                   sizeof(fast_hash.handle_signature));
+            fast_hashes_.Put(user_id, fast_hash);
             return true;
-        } else {
-            if (GateKeeper::DoVerify(expected_handle, password)) {
-                uint64_t salt;
-                GetRandom(&salt, sizeof(salt));
-                fast_hash_map_[user_id] = ComputeFastHash(password, salt);
-                return true;
-            }
         }
 
         return false;
     }
 
   private:
-    typedef std::unordered_map<uint32_t, failure_record_t> FailureRecordMap;
-    typedef std::unordered_map<uint64_t, fast_hash_t> FastHashMap;
+    // Requests of uids sharing a stripe are serialized with each other too.
+    static const size_t USER_LOCK_STRIPES = 32;
+
+    std::mutex& UserLock(uint32_t uid) { return user_locks_[uid % USER_LOCK_STRIPES]; }
 
     std::unique_ptr<uint8_t[]> key_;
-    FailureRecordMap failure_map_;
-    FastHashMap fast_hash_map_;
+    std::mutex user_locks_[USER_LOCK_STRIPES];
+    FailureRecordStore failure_records_;
+    FastHashCache fast_hashes_;
 };
 }  // namespace gatekeeper
 
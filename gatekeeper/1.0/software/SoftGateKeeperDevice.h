@@ -21,6 +21,7 @@
 #include <hidl/Status.h>
 
 #include <memory>
+#include <string>
 #include "SoftGateKeeper.h"
 
 namespace android {
@@ -30,7 +31,10 @@ namespace android {
  */
 class SoftGateKeeperDevice : public ::android::hardware::gatekeeper::V1_0::IGatekeeper {
   public:
-    SoftGateKeeperDevice() { impl_.reset(new ::gatekeeper::SoftGateKeeper()); }
+    // Failure records are persisted to failureRecordPath, or kept in memory if it's empty.
+    explicit SoftGateKeeperDevice(const std::string& failureRecordPath = "") {
+        impl_.reset(new ::gatekeeper::SoftGateKeeper(failureRecordPath));
+    }
 
     // Wrappers to translate the gatekeeper HAL API to the Kegyuard Messages API.
 
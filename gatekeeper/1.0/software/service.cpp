@@ -26,9 +26,13 @@
 using android::SoftGateKeeperDevice;
 using android::hardware::gatekeeper::V1_0::IGatekeeper;
 
+// Keeps lockout throttling in effect across restarts of the service.
+static const char kFailureRecordPath[] = "/data/vendor/gatekeeper/failure_records";
+
 int main() {
-    ::android::hardware::configureRpcThreadpool(1, true /* willJoinThreadpool */);
-    android::sp<SoftGateKeeperDevice> gatekeeper(new SoftGateKeeperDevice());
+    // Verifications of different users run concurrently, each using about 16MB for scrypt.
+    ::android::hardware::configureRpcThreadpool(4, true /* willJoinThreadpool */);
+    android::sp<SoftGateKeeperDevice> gatekeeper(new SoftGateKeeperDevice(kFailureRecordPath));
     auto status = gatekeeper->registerAsService();
     if (status != android::OK) {
         LOG(FATAL) << "Could not register service for Gatekeeper 1.0 (software) (" << status << ")";
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "../SoftGateKeeper.h"
+
+using ::gatekeeper::EnrollRequest;
+using ::gatekeeper::EnrollResponse;
+using ::gatekeeper::SizedBuffer;
+using ::gatekeeper::SoftGateKeeper;
+using ::gatekeeper::VerifyRequest;
+using ::gatekeeper::VerifyResponse;
+
+// Each benchmark thread verifies the password of its own user.
+static constexpr uint32_t kMaxUsers = 8;
+
+static SizedBuffer makePasswordBuffer() {
+    constexpr const uint32_t pw_buffer_size = 16;
+    auto pw_buffer = new uint8_t[pw_buffer_size];
+    memset(pw_buffer, 0, pw_buffer_size);
+    return {pw_buffer, pw_buffer_size};
+}
+
+static SizedBuffer copySizedBuffer(const SizedBuffer& rhs) {
+    auto buffer = new uint8_t[rhs.size()];
+    memcpy(buffer, rhs.Data<uint8_t>(), rhs.size());
+    return {buffer, rhs.size()};
+}
+
+struct EnrolledUsers {
+    explicit EnrolledUsers(size_t fast_hash_capacity) : gatekeeper("", fast_hash_capacity) {
+        handles.resize(kMaxUsers);
+        for (uint32_t uid = 0; uid < kMaxUsers; ++uid) {
+            EnrollRequest request(uid, {}, makePasswordBuffer(), {});
+            EnrollResponse response;
+            gatekeeper.Enroll(request, &response);
+            handles[uid] = std::move(response.enrolled_password_handle);
+        }
+    }
+
+    SoftGateKeeper gatekeeper;
+    std::vector<SizedBuffer> handles;
+    std::atomic<uint32_t> next_uid = 0;
+};
+
+static void verifyLoop(benchmark::State& state, EnrolledUsers* users) {
+    uint32_t uid = users->next_uid++ % kMaxUsers;
+    for (auto _ : state) {
+        VerifyRequest request(uid, 0, copySizedBuffer(users->handles[uid]), makePasswordBuffer());
+        VerifyResponse response;
+        users->gatekeeper.Verify(request, &response);
+        if (response.error != ::gatekeeper::ERROR_NONE) {
+            state.SkipWithError("Verification failed");
+            break;
+        }
+    }
+}
+
+// Every verification runs scrypt, so this shows how well it scales with the number of threads.
+static void BM_ConcurrentVerifyScrypt(benchmark::State& state) {
+    static EnrolledUsers users(0 /* fast_hash_capacity */);
+    verifyLoop(state, &users);
+}
+BENCHMARK(BM_ConcurrentVerifyScrypt)->ThreadRange(1, kMaxUsers)->UseRealTime();
+
+static void BM_ConcurrentVerifyFastHash(benchmark::State& state) {
+    static EnrolledUsers users(SoftGateKeeper::DEFAULT_FAST_HASH_CAPACITY);
+    verifyLoop(state, &users);
+}
+BENCHMARK(BM_ConcurrentVerifyFastHash)->ThreadRange(1, kMaxUsers)->UseRealTime();
+
+BENCHMARK_MAIN();
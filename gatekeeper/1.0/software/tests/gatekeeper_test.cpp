@@ -15,8 +15,13 @@
  */
 
 #include <arpa/inet.h>
+#include <unistd.h>
+#include <atomic>
 #include <iostream>
+#include <thread>
+#include <vector>
 
+#include <android-base/file.h>
 #include <gtest/gtest.h>
 #include <hardware/hw_auth_token.h>
 
@@ -24,6 +29,11 @@
 
 using ::gatekeeper::EnrollRequest;
 using ::gatekeeper::EnrollResponse;
+using ::gatekeeper::failure_record_t;
+using ::gatekeeper::FailureRecordStore;
+using ::gatekeeper::fast_hash_t;
+using ::gatekeeper::FastHashCache;
+using ::gatekeeper::password_handle_t;
 using ::gatekeeper::secure_id_t;
 using ::gatekeeper::SizedBuffer;
 using ::gatekeeper::SoftGateKeeper;
@@ -176,3 +186,198 @@ TEST(GateKeeperTest, VerifyBogusData) {
 
     ASSERT_EQ(::gatekeeper::gatekeeper_error_t::ERROR_INVALID, response.error);
 }
+
+static void do_enroll(SoftGateKeeper& gatekeeper, uint32_t uid, EnrollResponse* response) {
+    EnrollRequest request(uid, {}, makePasswordBuffer(), {});
+
+    gatekeeper.Enroll(request, response);
+}
+
+static ::gatekeeper::gatekeeper_error_t do_verify(SoftGateKeeper& gatekeeper, uint32_t uid,
+                                                  const SizedBuffer& handle, int password) {
+    VerifyRequest request(uid, 0, copySizedBuffer(handle), makePasswordBuffer(password));
+    VerifyResponse response;
+    gatekeeper.Verify(request, &response);
+    return response.error;
+}
+
+TEST(GateKeeperTest, ThrottlingPersistsAcrossRestart) {
+    TemporaryDir dir;
+    std::string path = std::string(dir.path) + "/failure_records";
+    EnrollResponse enroll_response;
+    {
+        SoftGateKeeper gatekeeper(path);
+        do_enroll(gatekeeper, &enroll_response);
+        ASSERT_EQ(::gatekeeper::gatekeeper_error_t::ERROR_NONE, enroll_response.error);
+
+        // The fifth failure in a row starts a timeout.
+        for (int i = 0; i < 5; ++i) {
+            do_verify(gatekeeper, 0, enroll_response.enrolled_password_handle, 1);
+        }
+        ASSERT_EQ(::gatekeeper::gatekeeper_error_t::ERROR_RETRY,
+                  do_verify(gatekeeper, 0, enroll_response.enrolled_password_handle, 0));
+    }
+
+    SoftGateKeeper restarted(path);
+    ASSERT_EQ(::gatekeeper::gatekeeper_error_t::ERROR_RETRY,
+              do_verify(restarted, 0, enroll_response.enrolled_password_handle, 0));
+}
+
+TEST(GateKeeperTest, FailureRecordsInMemoryWithoutPath) {
+    EnrollResponse enroll_response;
+    {
+        SoftGateKeeper gatekeeper;
+        do_enroll(gatekeeper, &enroll_response);
+        ASSERT_EQ(::gatekeeper::gatekeeper_error_t::ERROR_NONE, enroll_response.error);
+        for (int i = 0; i < 5; ++i) {
+            do_verify(gatekeeper, 0, enroll_response.enrolled_password_handle, 1);
+        }
+    }
+
+    SoftGateKeeper restarted;
+    ASSERT_EQ(::gatekeeper::gatekeeper_error_t::ERROR_NONE,
+              do_verify(restarted, 0, enroll_response.enrolled_password_handle, 0));
+}
+
+TEST(GateKeeperTest, FailureRecordStoreReloads) {
+    TemporaryDir dir;
+    std::string path = std::string(dir.path) + "/failure_records";
+    failure_record_t record = {42, 1000, 3};
+    {
+        FailureRecordStore store(path);
+        store.Put(7, record);
+        ASSERT_TRUE(store.persisted());
+    }
+
+    FailureRecordStore reloaded(path);
+    failure_record_t loaded = {};
+    ASSERT_TRUE(reloaded.Get(7, &loaded));
+    ASSERT_EQ(42u, loaded.secure_user_id);
+    ASSERT_EQ(1000u, loaded.last_checked_timestamp);
+    ASSERT_EQ(3u, loaded.failure_counter);
+    ASSERT_FALSE(reloaded.Get(8, &loaded));
+    // The temporary file has been renamed over the records.
+    ASSERT_NE(0, access((path + ".tmp").c_str(), F_OK));
+}
+
+TEST(GateKeeperTest, FailureRecordStoreIgnoresCorruptFile) {
+    TemporaryDir dir;
+    std::string path = std::string(dir.path) + "/failure_records";
+    failure_record_t record = {42, 1000, 3};
+    {
+        FailureRecordStore store(path);
+        store.Put(7, record);
+        ASSERT_TRUE(store.persisted());
+    }
+    std::string contents;
+    ASSERT_TRUE(android::base::ReadFileToString(path, &contents));
+    contents[contents.size() / 2] ^= 0xff;
+    ASSERT_TRUE(android::base::WriteStringToFile(contents, path));
+
+    FailureRecordStore reloaded(path);
+    ASSERT_EQ(0u, reloaded.size());
+}
+
+TEST(GateKeeperTest, FailureRecordStoreFallsBackToMemory) {
+    FailureRecordStore store("/nonexistent/failure_records");
+    failure_record_t record = {42, 1000, 3};
+    store.Put(7, record);
+    ASSERT_FALSE(store.persisted());
+    failure_record_t stored = {};
+    ASSERT_TRUE(store.Get(7, &stored));
+    ASSERT_EQ(3u, stored.failure_counter);
+}
+
+TEST(GateKeeperTest, ThrottlingWithoutWritableStorage) {
+    SoftGateKeeper gatekeeper("/nonexistent/failure_records");
+    EnrollResponse enroll_response;
+    do_enroll(gatekeeper, &enroll_response);
+    ASSERT_EQ(::gatekeeper::gatekeeper_error_t::ERROR_NONE, enroll_response.error);
+    ASSERT_EQ(::gatekeeper::gatekeeper_error_t::ERROR_NONE,
+              do_verify(gatekeeper, 0, enroll_response.enrolled_password_handle, 0));
+
+    for (int i = 0; i < 5; ++i) {
+        do_verify(gatekeeper, 0, enroll_response.enrolled_password_handle, 1);
+    }
+    ASSERT_EQ(::gatekeeper::gatekeeper_error_t::ERROR_RETRY,
+              do_verify(gatekeeper, 0, enroll_response.enrolled_password_handle, 0));
+}
+
+TEST(GateKeeperTest, FastHashCacheEvictsLeastRecentlyUsed) {
+    FastHashCache cache(2);
+    fast_hash_t fast_hash = {};
+    cache.Put(1, fast_hash);
+    cache.Put(2, fast_hash);
+    ASSERT_TRUE(cache.Get(1, &fast_hash));
+    cache.Put(3, fast_hash);
+
+    ASSERT_EQ(2u, cache.size());
+    ASSERT_TRUE(cache.Get(1, &fast_hash));
+    ASSERT_FALSE(cache.Get(2, &fast_hash));
+    ASSERT_TRUE(cache.Get(3, &fast_hash));
+}
+
+TEST(GateKeeperTest, OldPasswordRejectedAfterTrustedReEnroll) {
+    SoftGateKeeper gatekeeper;
+    EnrollResponse enroll_response;
+    do_enroll(gatekeeper, &enroll_response);
+    ASSERT_EQ(::gatekeeper::gatekeeper_error_t::ERROR_NONE, enroll_response.error);
+    // Caches a fast hash of the old password.
+    ASSERT_EQ(::gatekeeper::gatekeeper_error_t::ERROR_NONE,
+              do_verify(gatekeeper, 0, enroll_response.enrolled_password_handle, 0));
+
+    EnrollRequest enroll_request(0, std::move(enroll_response.enrolled_password_handle),
+                                 makePasswordBuffer(1), makePasswordBuffer());
+    gatekeeper.Enroll(enroll_request, &enroll_response);
+    ASSERT_EQ(::gatekeeper::gatekeeper_error_t::ERROR_NONE, enroll_response.error);
+
+    ASSERT_NE(::gatekeeper::gatekeeper_error_t::ERROR_NONE,
+              do_verify(gatekeeper, 0, enroll_response.enrolled_password_handle, 0));
+    ASSERT_EQ(::gatekeeper::gatekeeper_error_t::ERROR_NONE,
+              do_verify(gatekeeper, 0, enroll_response.enrolled_password_handle, 1));
+}
+
+TEST(GateKeeperTest, ConcurrentVerifyOfDifferentUsers) {
+    constexpr uint32_t kUsers = 4;
+    SoftGateKeeper gatekeeper("", 0 /* fast_hash_capacity */);
+    EnrollResponse enroll_responses[kUsers];
+    for (uint32_t uid = 0; uid < kUsers; ++uid) {
+        do_enroll(gatekeeper, uid, &enroll_responses[uid]);
+        ASSERT_EQ(::gatekeeper::gatekeeper_error_t::ERROR_NONE, enroll_responses[uid].error);
+    }
+
+    std::atomic<int> successes = 0;
+    std::vector<std::thread> threads;
+    for (uint32_t uid = 0; uid < kUsers; ++uid) {
+        threads.emplace_back([&, uid] {
+            for (int i = 0; i < 2; ++i) {
+                if (do_verify(gatekeeper, uid, enroll_responses[uid].enrolled_password_handle, 0) ==
+                    ::gatekeeper::gatekeeper_error_t::ERROR_NONE) {
+                    ++successes;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    ASSERT_EQ(static_cast<int>(kUsers * 2), successes);
+}
+
+TEST(GateKeeperTest, ConcurrentFailuresOfSameUserAllCounted) {
+    SoftGateKeeper gatekeeper;
+    EnrollResponse enroll_response;
+    do_enroll(gatekeeper, &enroll_response);
+    ASSERT_EQ(::gatekeeper::gatekeeper_error_t::ERROR_NONE, enroll_response.error);
+    secure_id_t user_id =
+            enroll_response.enrolled_password_handle.Data<password_handle_t>()->user_id;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back(
+                [&] { do_verify(gatekeeper, 0, enroll_response.enrolled_password_handle, 1); });
+    }
+    for (auto& thread : threads) thread.join();
+
+    failure_record_t record;
+    ASSERT_TRUE(gatekeeper.GetFailureRecord(0, user_id, &record, false));
+    ASSERT_EQ(4u, record.failure_counter);
+}
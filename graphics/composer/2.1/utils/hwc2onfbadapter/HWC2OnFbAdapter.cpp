@@ -698,7 +698,10 @@ void HWC2OnFbAdapter::updateDebugString() {
         buffer[sizeof(buffer) - 1] = '\0';
 
         mDebugString = buffer;
+    } else {
+        mDebugString.clear();
     }
+    mVsyncThread.dump(&mDebugString);
 }
 
 const std::string& HWC2OnFbAdapter::getDebugString() const {
@@ -784,7 +787,17 @@ void HWC2OnFbAdapter::setBuffer(buffer_handle_t buffer) {
 bool HWC2OnFbAdapter::postBuffer() {
     int error = 0;
     if (mBuffer) {
+        int64_t start = VsyncThread::now();
         error = mFbDevice->post(mFbDevice, mBuffer);
+        int64_t end = VsyncThread::now();
+
+        // Drivers which flip on vsync block in post until then, making the
+        // time post returns a present timestamp. Posts returning right away
+        // tell nothing about the panel, and locking onto them would only
+        // chase our own vsync.
+        if (error == 0 && end - start >= mFbInfo.vsync_period_ns / 8) {
+            mVsyncThread.addPresentTimestamp(end);
+        }
     }
 
     return error == 0;
@@ -798,6 +811,15 @@ void HWC2OnFbAdapter::enableVsync(bool enable) {
     mVsyncThread.enableCallback(enable);
 }
 
+void HWC2OnFbAdapter::setVsyncPeriod(int64_t period) {
+    mFbInfo.vsync_period_ns = int(period);
+    mVsyncThread.setPeriod(period);
+}
+
+void HWC2OnFbAdapter::addPresentTimestamp(int64_t timestamp) {
+    mVsyncThread.addPresentTimestamp(timestamp);
+}
+
 void HWC2OnFbAdapter::getCapabilities(uint32_t* outCount,
                                       int32_t* outCapabilities) {
     if (outCapabilities == nullptr) {
@@ -841,9 +863,11 @@ bool HWC2OnFbAdapter::VsyncThread::sleepUntil(int64_t t) {
 }
 
 void HWC2OnFbAdapter::VsyncThread::start(int64_t firstVsync, int64_t period) {
-    mNextVsync = firstVsync;
-    mPeriod = period;
-    mStarted = true;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mModel = VsyncModel(period, firstVsync);
+        mStarted = true;
+    }
     mThread = std::thread(&VsyncThread::vsyncLoop, this);
 }
 
@@ -870,40 +894,52 @@ void HWC2OnFbAdapter::VsyncThread::enableCallback(bool enable) {
     mCondition.notify_all();
 }
 
+// Until started, the model has no period to work with, and start() replaces
+// it anyway.
+void HWC2OnFbAdapter::VsyncThread::setPeriod(int64_t period) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mStarted) {
+        mModel.setPeriod(period, now());
+    }
+}
+
+void HWC2OnFbAdapter::VsyncThread::addPresentTimestamp(int64_t timestamp) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mStarted && !mModel.addSample(timestamp)) {
+        ALOGV("VsyncThread: ignoring present timestamp %" PRId64, timestamp);
+    }
+}
+
+void HWC2OnFbAdapter::VsyncThread::dump(std::string* out) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mModel.dump(out);
+}
+
 void HWC2OnFbAdapter::VsyncThread::vsyncLoop() {
     prctl(PR_SET_NAME, "VsyncThread", 0, 0, 0);
 
     std::unique_lock<std::mutex> lock(mMutex);
-    if (!mStarted) {
-        return;
-    }
-
-    while (true) {
+    while (mStarted) {
         if (!mCallbackEnabled) {
             mCondition.wait(lock, [this] { return mCallbackEnabled || !mStarted; });
-            if (!mStarted) {
-                break;
-            }
+            continue;
         }
 
-        lock.unlock();
-
-        // adjust mNextVsync if necessary
-        int64_t t = now();
-        if (mNextVsync < t) {
-            int64_t n = (t - mNextVsync + mPeriod - 1) / mPeriod;
-            mNextVsync += mPeriod * n;
-        }
-        bool fire = sleepUntil(mNextVsync);
+        // The model may have moved since the last vsync, never fire twice
+        // within a period.
+        int64_t t = std::max(now(), mLastVsync + mModel.getPeriod() / 2);
+        int64_t nextVsync = mModel.nextVsyncAfter(t);
 
+        lock.unlock();
+        bool fire = sleepUntil(nextVsync);
         lock.lock();
 
         if (fire) {
-            ALOGV("VsyncThread(%" PRId64 ")", mNextVsync);
+            ALOGV("VsyncThread(%" PRId64 ")", nextVsync);
             if (mCallback) {
-                mCallback(mCallbackData, getDisplayId(), mNextVsync);
+                mCallback(mCallbackData, getDisplayId(), nextVsync);
             }
-            mNextVsync += mPeriod;
+            mLastVsync = nextVsync;
         }
     }
 }
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hwc2onfbadapter/VsyncModel.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+
+namespace android {
+
+namespace {
+
+// Weight of a new sample in the running error statistics.
+constexpr double kStatsWeight = 1.0 / 16;
+
+} // anonymous namespace
+
+VsyncModel::Options VsyncModel::defaultOptions() {
+    return {
+            .phaseGain = 0.1,
+            .periodGain = 0.01,
+            .maxPhaseStep = 0.01,
+            .maxPeriodDeviation = 0.01,
+            .outlierThreshold = 0.25,
+            .maxConsecutiveOutliers = 8,
+    };
+}
+
+VsyncModel::VsyncModel(int64_t period, int64_t anchor)
+      : VsyncModel(period, anchor, defaultOptions()) {}
+
+VsyncModel::VsyncModel(int64_t period, int64_t anchor, const Options& options)
+      : mOptions(options), mNominalPeriod(period), mPeriod(period), mAnchor(anchor) {}
+
+void VsyncModel::setPeriod(int64_t period, int64_t now) {
+    if (period <= 0) {
+        return;
+    }
+    mAnchor = nextVsyncAfter(now) - mPeriod;
+    mNominalPeriod = period;
+    mPeriod = period;
+    mStats.driftPpm = 0;
+}
+
+int64_t VsyncModel::getNominalPeriod() const {
+    return mNominalPeriod;
+}
+
+int64_t VsyncModel::getPeriod() const {
+    return std::llround(mPeriod);
+}
+
+bool VsyncModel::addSample(int64_t timestamp) {
+    const double periods = std::round((timestamp - mAnchor) / mPeriod);
+    const double predicted = mAnchor + periods * mPeriod;
+    const double error = timestamp - predicted;
+
+    if (!mLocked || std::abs(error) > mOptions.outlierThreshold * mPeriod) {
+        if (mLocked && ++mConsecutiveOutliers < mOptions.maxConsecutiveOutliers) {
+            mStats.outliers++;
+            return false;
+        }
+        // Either the first sample or the panel moved, lock onto it.
+        mAnchor = timestamp;
+        mLocked = true;
+        mConsecutiveOutliers = 0;
+        mStats.samples++;
+        mStats.lastErrorNs = 0;
+        return true;
+    }
+    mConsecutiveOutliers = 0;
+
+    const double maxStep = mOptions.maxPhaseStep * mPeriod;
+    mAnchor = predicted + std::clamp(mOptions.phaseGain * error, -maxStep, maxStep);
+    if (periods != 0) {
+        const double maxDeviation = mOptions.maxPeriodDeviation * mNominalPeriod;
+        mPeriod = std::clamp(mPeriod + mOptions.periodGain * error / std::abs(periods),
+                             mNominalPeriod - maxDeviation, mNominalPeriod + maxDeviation);
+    }
+
+    mStats.samples++;
+    mStats.lastErrorNs = std::llround(error);
+    const double meanSquare = mStats.jitterNs * mStats.jitterNs;
+    mStats.jitterNs = std::sqrt(meanSquare + kStatsWeight * (error * error - meanSquare));
+    mStats.meanErrorNs += kStatsWeight * (error - mStats.meanErrorNs);
+    mStats.driftPpm = (mPeriod - mNominalPeriod) * 1e6 / mNominalPeriod;
+    return true;
+}
+
+int64_t VsyncModel::nextVsyncAfter(int64_t t) const {
+    const double periods = std::floor((t - mAnchor) / mPeriod) + 1;
+    int64_t next = std::llround(mAnchor + periods * mPeriod);
+    // Rounding may land on t itself.
+    if (next <= t) {
+        next = std::llround(mAnchor + (periods + 1) * mPeriod);
+    }
+    return next;
+}
+
+const VsyncModel::Stats& VsyncModel::getStats() const {
+    return mStats;
+}
+
+void VsyncModel::dump(std::string* out) const {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer),
+             "Vsync: period %" PRId64 " ns (nominal %" PRId64 " ns, drift %.1f ppm), "
+             "%" PRIu64 " samples, %" PRIu64 " outliers, jitter %.0f ns, mean error %.0f ns\n",
+             getPeriod(), mNominalPeriod, mStats.driftPpm, mStats.samples, mStats.outliers,
+             mStats.jitterNs, mStats.meanErrorNs);
+    out->append(buffer);
+}
+
+} // namespace android
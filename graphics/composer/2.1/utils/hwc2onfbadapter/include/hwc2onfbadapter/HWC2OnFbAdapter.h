@@ -29,6 +29,8 @@
 #undef HWC2_INCLUDE_STRINGIFICATION
 #undef HWC2_USE_CPP11
 
+#include "hwc2onfbadapter/VsyncModel.h"
+
 struct framebuffer_device_t;
 
 namespace android {
@@ -79,6 +81,10 @@ public:
 
     void setVsyncCallback(HWC2_PFN_VSYNC callback, hwc2_callback_data_t data);
     void enableVsync(bool enable);
+    // For integrations which learn of refresh rate changes or of the actual
+    // times frames were presented.
+    void setVsyncPeriod(int64_t period);
+    void addPresentTimestamp(int64_t timestamp);
     void getCapabilities(uint32_t* outCount, int32_t* outCapabilities);
 
 private:
@@ -106,17 +112,19 @@ private:
         void stop();
         void setCallback(HWC2_PFN_VSYNC callback, hwc2_callback_data_t data);
         void enableCallback(bool enable);
+        void setPeriod(int64_t period);
+        void addPresentTimestamp(int64_t timestamp);
+        void dump(std::string* out);
 
     private:
         void vsyncLoop();
-        bool waitUntilNextVsync();
 
         std::thread mThread;
-        int64_t mNextVsync{0};
-        int64_t mPeriod{0};
 
         std::mutex mMutex;
         std::condition_variable mCondition;
+        VsyncModel mModel{0, 0};
+        int64_t mLastVsync{0};
         bool mStarted{false};
         HWC2_PFN_VSYNC mCallback{nullptr};
         hwc2_callback_data_t mCallbackData{nullptr};
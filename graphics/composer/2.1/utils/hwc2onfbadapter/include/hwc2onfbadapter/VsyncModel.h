@@ -0,0 +1,103 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SF_HWC2_ON_FB_ADAPTER_VSYNC_MODEL_H
+#define ANDROID_SF_HWC2_ON_FB_ADAPTER_VSYNC_MODEL_H
+
+#include <cstdint>
+#include <string>
+
+namespace android {
+
+/*
+ * Predicts vsync timestamps of a panel from its nominal period, and
+ * phase-locks the predictions to timestamps observed when frames were
+ * presented.
+ *
+ * Each sample is compared against the nearest predicted vsync. A fraction of
+ * the error moves the phase, bounded per sample so that vsync timestamps
+ * never jump by more than a small part of a period, and a smaller fraction
+ * adjusts the period to follow a panel running faster or slower than its
+ * nominal rate. Samples too far from any predicted vsync are counted as
+ * outliers and ignored, unless they keep coming, in which case the model
+ * locks onto them anew.
+ *
+ * Timestamps are in nanoseconds on any monotonic clock. Not thread-safe.
+ */
+class VsyncModel {
+public:
+    struct Options {
+        // Fraction of the phase error corrected by each sample.
+        double phaseGain;
+        // Fraction of the phase error per period fed into the period.
+        double periodGain;
+        // The largest phase correction of a sample, as a fraction of the period.
+        double maxPhaseStep;
+        // The largest deviation of the period from nominal, as a fraction.
+        double maxPeriodDeviation;
+        // Samples further from the predicted vsync than this fraction of the
+        // period are outliers.
+        double outlierThreshold;
+        // Consecutive outliers after which the model locks onto them.
+        int maxConsecutiveOutliers;
+    };
+    static Options defaultOptions();
+
+    struct Stats {
+        uint64_t samples{0};
+        uint64_t outliers{0};
+        int64_t lastErrorNs{0};
+        // Root mean square and mean of the recent phase errors.
+        double jitterNs{0};
+        double meanErrorNs{0};
+        // Deviation of the tracked period from nominal.
+        double driftPpm{0};
+    };
+
+    VsyncModel(int64_t period, int64_t anchor);
+    VsyncModel(int64_t period, int64_t anchor, const Options& options);
+
+    // Changes the period from the last vsync before now on. Non-positive
+    // periods are ignored.
+    void setPeriod(int64_t period, int64_t now);
+    int64_t getNominalPeriod() const;
+    // The period as tracked, including drift.
+    int64_t getPeriod() const;
+
+    // Adds the time a frame was observed to be presented. Returns false if
+    // the sample was an outlier.
+    bool addSample(int64_t timestamp);
+
+    // Returns the first predicted vsync strictly after t.
+    int64_t nextVsyncAfter(int64_t t) const;
+
+    const Stats& getStats() const;
+    void dump(std::string* out) const;
+
+private:
+    Options mOptions;
+    int64_t mNominalPeriod;
+    double mPeriod;
+    // A predicted vsync, the one nearest the last accepted sample.
+    double mAnchor;
+    bool mLocked{false};
+    int mConsecutiveOutliers{0};
+    Stats mStats;
+};
+
+} // namespace android
+
+#endif // ANDROID_SF_HWC2_ON_FB_ADAPTER_VSYNC_MODEL_H
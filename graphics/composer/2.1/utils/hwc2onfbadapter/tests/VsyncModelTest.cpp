@@ -0,0 +1,199 @@
+/*
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hwc2onfbadapter/VsyncModel.h"
+
+#include <cstdlib>
+#include <random>
+
+#include <gtest/gtest.h>
+
+namespace android {
+namespace {
+
+constexpr int64_t kPeriod = 16'666'667;
+
+// A simulated panel, presenting frames at its own vsyncs with noisy
+// timestamps.
+class SimulatedPanel {
+public:
+    SimulatedPanel(int64_t period, int64_t phase, int64_t noise)
+          : mPeriod(period), mPhase(phase), mNoise(-noise, noise) {}
+
+    int64_t vsync(int64_t index) const { return mPhase + index * mPeriod; }
+    int64_t presentTime(int64_t index) { return vsync(index) + mNoise(mRandom); }
+
+    // Returns the distance from t to the nearest vsync.
+    int64_t error(int64_t t) const {
+        int64_t offset = ((t - mPhase) % mPeriod + mPeriod) % mPeriod;
+        return offset > mPeriod / 2 ? offset - mPeriod : offset;
+    }
+
+private:
+    const int64_t mPeriod;
+    const int64_t mPhase;
+    std::mt19937_64 mRandom{42};
+    std::uniform_int_distribution<int64_t> mNoise;
+};
+
+TEST(VsyncModelTest, PredictsFromTheNominalPeriod) {
+    VsyncModel model(kPeriod, 1000);
+    EXPECT_EQ(1000 + kPeriod, model.nextVsyncAfter(1000));
+    EXPECT_EQ(1000 + kPeriod, model.nextVsyncAfter(1001));
+    EXPECT_EQ(1000 + 2 * kPeriod, model.nextVsyncAfter(1000 + kPeriod));
+    EXPECT_EQ(1000, model.nextVsyncAfter(999));
+    EXPECT_EQ(1000 - kPeriod, model.nextVsyncAfter(-kPeriod));
+}
+
+TEST(VsyncModelTest, LocksOntoTheFirstSample) {
+    VsyncModel model(kPeriod, 0);
+    ASSERT_TRUE(model.addSample(5'000'000));
+    EXPECT_EQ(5'000'000 + kPeriod, model.nextVsyncAfter(5'000'000));
+    EXPECT_EQ(1u, model.getStats().samples);
+}
+
+TEST(VsyncModelTest, BoundsThePhaseCorrection) {
+    VsyncModel model(kPeriod, 0);
+    ASSERT_TRUE(model.addSample(0));
+    const int64_t before = model.nextVsyncAfter(kPeriod * 10 - 1);
+
+    // A sample 3 ms late moves the phase by at most 1% of the period.
+    ASSERT_TRUE(model.addSample(kPeriod * 10 + 3'000'000));
+    const int64_t after = model.nextVsyncAfter(kPeriod * 10 - 1);
+    EXPECT_GT(after, before);
+    EXPECT_LE(after - before, kPeriod / 100 + 1);
+}
+
+TEST(VsyncModelTest, FollowsADriftingPanel) {
+    // The panel runs 500 ppm slow, half way between two predicted vsyncs
+    // after a minute.
+    const int64_t panelPeriod = kPeriod + kPeriod / 2000;
+    SimulatedPanel panel(panelPeriod, 3'000'000, 200'000);
+    VsyncModel model(kPeriod, 0);
+
+    constexpr int kFrames = 60 * 60;
+    int64_t maxError = 0;
+    for (int64_t i = 0; i < kFrames; i++) {
+        model.addSample(panel.presentTime(i));
+        if (i > kFrames / 2) {
+            const int64_t predicted = model.nextVsyncAfter(panel.vsync(i) + kPeriod / 2);
+            maxError = std::max(maxError, std::abs(panel.error(predicted)));
+        }
+    }
+
+    EXPECT_LT(maxError, 150'000);
+    EXPECT_NEAR(500, model.getStats().driftPpm, 50);
+    EXPECT_NEAR(panelPeriod, model.getPeriod(), kPeriod / 20000);
+    EXPECT_EQ(0u, model.getStats().outliers);
+    // The noise is uniform, so its standard deviation is 200 / sqrt(3) us.
+    EXPECT_NEAR(115'000, model.getStats().jitterNs, 40'000);
+    EXPECT_NEAR(0, model.getStats().meanErrorNs, 50'000);
+}
+
+TEST(VsyncModelTest, TracksWithSkippedFrames) {
+    const int64_t panelPeriod = kPeriod - kPeriod / 5000;
+    SimulatedPanel panel(panelPeriod, 7'000'000, 100'000);
+    VsyncModel model(kPeriod, 0);
+
+    // Only every third vsync presents a frame.
+    for (int64_t i = 0; i < 3 * 3000; i += 3) {
+        model.addSample(panel.presentTime(i));
+    }
+    const int64_t t = panel.vsync(3 * 3000) + kPeriod / 2;
+    EXPECT_LT(std::abs(panel.error(model.nextVsyncAfter(t))), 150'000);
+    EXPECT_NEAR(-200, model.getStats().driftPpm, 30);
+}
+
+TEST(VsyncModelTest, BoundsThePeriodDeviation) {
+    // A panel 5% slow is beyond what the period may deviate.
+    SimulatedPanel panel(kPeriod + kPeriod / 20, 0, 0);
+    VsyncModel model(kPeriod, 0);
+    for (int64_t i = 0; i < 1000; i++) {
+        model.addSample(panel.presentTime(i));
+    }
+    EXPECT_LE(model.getPeriod(), kPeriod + kPeriod / 100 + 1);
+    EXPECT_NEAR(10000, model.getStats().driftPpm, 1);
+}
+
+TEST(VsyncModelTest, IgnoresOutliers) {
+    SimulatedPanel panel(kPeriod, 1'000'000, 100'000);
+    VsyncModel model(kPeriod, 0);
+    for (int64_t i = 0; i < 100; i++) {
+        model.addSample(panel.presentTime(i));
+    }
+
+    // A late frame, half a period off.
+    EXPECT_FALSE(model.addSample(panel.vsync(100) + kPeriod / 2));
+    EXPECT_EQ(1u, model.getStats().outliers);
+    EXPECT_LT(std::abs(panel.error(model.nextVsyncAfter(panel.vsync(101)))), 200'000);
+}
+
+TEST(VsyncModelTest, RelocksAfterConsecutiveOutliers) {
+    SimulatedPanel panel(kPeriod, 1'000'000, 0);
+    VsyncModel model(kPeriod, 0);
+    for (int64_t i = 0; i < 100; i++) {
+        model.addSample(panel.presentTime(i));
+    }
+
+    // The panel jumped by half a period.
+    SimulatedPanel moved(kPeriod, 1'000'000 + kPeriod / 2, 0);
+    const int maxOutliers = VsyncModel::defaultOptions().maxConsecutiveOutliers;
+    for (int64_t i = 100; i < 100 + maxOutliers - 1; i++) {
+        EXPECT_FALSE(model.addSample(moved.presentTime(i)));
+    }
+    EXPECT_TRUE(model.addSample(moved.presentTime(100 + maxOutliers)));
+    EXPECT_EQ(0, moved.error(model.nextVsyncAfter(moved.vsync(200))));
+}
+
+TEST(VsyncModelTest, ChangesPeriodAtRuntime) {
+    VsyncModel model(kPeriod, 0);
+    ASSERT_TRUE(model.addSample(0));
+
+    // Switch to 30 Hz between vsyncs 10 and 11.
+    constexpr int64_t kNewPeriod = 33'333'333;
+    model.setPeriod(kNewPeriod, 10 * kPeriod + 1000);
+    EXPECT_EQ(kNewPeriod, model.getNominalPeriod());
+    EXPECT_EQ(10 * kPeriod + kNewPeriod, model.nextVsyncAfter(10 * kPeriod + 1000));
+
+    // And it keeps tracking the panel at the new rate.
+    SimulatedPanel panel(kNewPeriod + kNewPeriod / 4000, 10 * kPeriod + kNewPeriod, 100'000);
+    for (int64_t i = 0; i < 3000; i++) {
+        EXPECT_TRUE(model.addSample(panel.presentTime(i)));
+    }
+    EXPECT_NEAR(250, model.getStats().driftPpm, 30);
+    EXPECT_LT(std::abs(panel.error(model.nextVsyncAfter(panel.vsync(3000)))), 150'000);
+}
+
+TEST(VsyncModelTest, IgnoresNonPositivePeriods) {
+    VsyncModel model(kPeriod, 0);
+    ASSERT_TRUE(model.addSample(0));
+    model.setPeriod(0, 1000);
+    model.setPeriod(-kPeriod, 1000);
+    EXPECT_EQ(kPeriod, model.getNominalPeriod());
+    EXPECT_EQ(kPeriod, model.nextVsyncAfter(1000));
+}
+
+TEST(VsyncModelTest, DumpsStatistics) {
+    VsyncModel model(kPeriod, 0);
+    model.addSample(0);
+    std::string dump;
+    model.dump(&dump);
+    EXPECT_NE(std::string::npos, dump.find("nominal 16666667 ns")) << dump;
+    EXPECT_NE(std::string::npos, dump.find("1 samples")) << dump;
+}
+
+} // anonymous namespace
+} // namespace android
@@ -309,10 +309,12 @@ ndk::ScopedAStatus IdentityCredential::startRetrieval(
                 IIdentityCredentialStore::STATUS_FAILED, "Error starting retrieving entries"));
     }
 
-    optional<vector<uint8_t>> signatureOfToBeSigned;
+    // Decode the reader signature once, its signature, algorithm and certificate
+    // chain are all needed below.
+    optional<support::CoseSign1> readerCoseSign1;
     if (readerSignature.size() > 0) {
-        signatureOfToBeSigned = support::coseSignGetSignature(readerSignature);
-        if (!signatureOfToBeSigned) {
+        readerCoseSign1 = support::coseSign1Decode(readerSignature);
+        if (!readerCoseSign1) {
             return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
                     IIdentityCredentialStore::STATUS_READER_SIGNATURE_CHECK_FAILED,
                     "Error extracting signatureOfToBeSigned from COSE_Sign1"));
@@ -342,9 +344,8 @@ ndk::ScopedAStatus IdentityCredential::startRetrieval(
 
     // If there is a signature, validate that it was made with the top-most key in the
     // certificate chain embedded in the COSE_Sign1 structure.
-    optional<vector<uint8_t>> readerCertificateChain;
     if (readerSignature.size() > 0) {
-        readerCertificateChain = support::coseSignGetX5Chain(readerSignature);
+        const optional<vector<uint8_t>>& readerCertificateChain = readerCoseSign1.value().x5chain;
         if (!readerCertificateChain) {
             return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
                     IIdentityCredentialStore::STATUS_READER_SIGNATURE_CHECK_FAILED,
@@ -360,6 +361,23 @@ ndk::ScopedAStatus IdentityCredential::startRetrieval(
                     IIdentityCredentialStore::STATUS_READER_SIGNATURE_CHECK_FAILED,
                     "Error splitting certificate chain from COSE_Sign1"));
         }
+
+        // The public keys of the profiles bound to a reader certificate, by profile id.
+        map<int32_t, vector<uint8_t>> profilePubKeys;
+        for (const SecureAccessControlProfile& profile : remainingAcps) {
+            if (profile.readerCertificate.encodedCertificate.size() == 0) {
+                continue;
+            }
+            optional<vector<uint8_t>> profilePubKey = support::certificateChainGetTopMostKey(
+                    profile.readerCertificate.encodedCertificate);
+            if (!profilePubKey) {
+                return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
+                        IIdentityCredentialStore::STATUS_FAILED,
+                        "Error getting public key from profile"));
+            }
+            profilePubKeys[profile.id] = std::move(profilePubKey.value());
+        }
+
         for (ssize_t n = splitCerts.value().size() - 1; n >= 0; --n) {
             const vector<uint8_t>& x509Cert = splitCerts.value()[n];
             if (!hwProxy_->pushReaderCert(x509Cert)) {
@@ -389,14 +407,7 @@ ndk::ScopedAStatus IdentityCredential::startRetrieval(
                     ++it;
                     continue;
                 }
-                optional<vector<uint8_t>> profilePubKey = support::certificateChainGetTopMostKey(
-                        profile.readerCertificate.encodedCertificate);
-                if (!profilePubKey) {
-                    return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
-                            IIdentityCredentialStore::STATUS_FAILED,
-                            "Error getting public key from profile"));
-                }
-                if (profilePubKey.value() == x509CertPubKey.value()) {
+                if (profilePubKeys[profile.id] == x509CertPubKey.value()) {
                     optional<bool> res = hwProxy_->validateAccessControlProfile(
                             profile.id, profile.readerCertificate.encodedCertificate,
                             profile.userAuthenticationRequired, profile.timeoutMillis,
@@ -419,20 +430,15 @@ ndk::ScopedAStatus IdentityCredential::startRetrieval(
         // ... then pass the request message and have the TA check it's signed by the
         // key in last certificate we pushed.
         if (sessionTranscript.size() > 0 && itemsRequest.size() > 0 && readerSignature.size() > 0) {
-            optional<vector<uint8_t>> tbsSignature = support::coseSignGetSignature(readerSignature);
-            if (!tbsSignature) {
-                return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
-                        IIdentityCredentialStore::STATUS_READER_SIGNATURE_CHECK_FAILED,
-                        "Error extracting toBeSigned from COSE_Sign1"));
-            }
-            optional<int> coseSignAlg = support::coseSignGetAlg(readerSignature);
+            const vector<uint8_t>& tbsSignature = readerCoseSign1.value().signature;
+            const optional<int>& coseSignAlg = readerCoseSign1.value().alg;
             if (!coseSignAlg) {
                 return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
                         IIdentityCredentialStore::STATUS_READER_SIGNATURE_CHECK_FAILED,
                         "Error extracting signature algorithm from COSE_Sign1"));
             }
             if (!hwProxy_->validateRequestMessage(sessionTranscript, itemsRequest,
-                                                  coseSignAlg.value(), tbsSignature.value())) {
+                                                  coseSignAlg.value(), tbsSignature)) {
                 return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
                         IIdentityCredentialStore::STATUS_READER_SIGNATURE_CHECK_FAILED,
                         "readerMessage is not signed by top-level certificate"));
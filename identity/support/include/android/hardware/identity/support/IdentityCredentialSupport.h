@@ -308,6 +308,17 @@ bool certificateChainValidate(const vector<uint8_t>& certificateChain);
 bool certificateSignedByPublicKey(const vector<uint8_t>& certificate,
                                   const vector<uint8_t>& publicKey);
 
+// Certificate chains which passed certificateChainValidate(), the keys returned
+// by certificateChainGetTopMostKey() and the public keys passed to
+// certificateSignedByPublicKey() and checkEcDsaSignature() are remembered in
+// small least-recently-used caches keyed by the SHA-256 of their encoding. This
+// way repeated presentations to the same reader don't parse and check the same
+// certificates over and over.
+//
+// Drops everything in these caches.
+//
+void clearCertificateCaches();
+
 // Signs |data| and |detachedContent| with |key| (which must be in the format
 // returned by ecKeyPairGetPrivateKey()).
 //
@@ -367,6 +378,31 @@ optional<int> coseSignGetAlg(const vector<uint8_t>& signatureCoseSign1);
 //
 optional<vector<uint8_t>> coseSignGetX5Chain(const vector<uint8_t>& signatureCoseSign1);
 
+// The parts of a COSE_Sign1, for callers needing more than one of them.
+struct CoseSign1 {
+    vector<uint8_t> encodedProtectedHeaders;
+    // Empty if the payload is null.
+    vector<uint8_t> payload;
+    vector<uint8_t> signature;
+    // The signature algorithm, if present in the protected headers.
+    optional<int> alg;
+    // The X.509 certificate chain, if present in the unprotected headers, as a
+    // concatenated chain of DER-encoded X.509 certificates.
+    optional<vector<uint8_t>> x5chain;
+};
+
+// Decodes |signatureCoseSign1| in one pass.
+//
+// Returns nothing if it's not a COSE_Sign1. Malformed headers only leave |alg|
+// or |x5chain| unset.
+//
+optional<CoseSign1> coseSign1Decode(const vector<uint8_t>& signatureCoseSign1);
+
+// Like the above version of coseCheckEcDsaSignature() but for an already decoded
+// COSE_Sign1.
+bool coseCheckEcDsaSignature(const CoseSign1& coseSign1, const vector<uint8_t>& detachedContent,
+                             const vector<uint8_t>& publicKey);
+
 // MACs |data| and |detachedContent| with |key| (which can be any sequence of
 // bytes).
 //
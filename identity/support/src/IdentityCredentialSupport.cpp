@@ -24,8 +24,12 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <time.h>
+#include <array>
 #include <chrono>
 #include <iomanip>
+#include <list>
+#include <memory>
+#include <mutex>
 
 #include <openssl/aes.h>
 #include <openssl/bn.h>
@@ -39,6 +43,7 @@
 #include <openssl/pem.h>
 #include <openssl/pkcs12.h>
 #include <openssl/rand.h>
+#include <openssl/sha.h>
 #include <openssl/x509.h>
 #include <openssl/x509_vfy.h>
 
@@ -625,29 +630,92 @@ optional<vector<vector<uint8_t>>> certificateChainSplit(const vector<uint8_t>& c
     return certificates;
 }
 
-static bool parseX509Certificates(const vector<uint8_t>& certificateChain,
-                                  vector<X509_Ptr>& parsedCertificates) {
-    const unsigned char* p = (unsigned char*)certificateChain.data();
-    const unsigned char* pEnd = p + certificateChain.size();
-    parsedCertificates.resize(0);
-    while (p < pEnd) {
-        auto x509 = X509_Ptr(d2i_X509(nullptr, &p, pEnd - p));
-        if (x509 == nullptr) {
-            LOG(ERROR) << "Error parsing X509 certificate";
-            return false;
+namespace {
+
+// Entries kept in each of the certificate caches. Presentations to a reader
+// involve a few certificates, so this covers a handful of readers.
+constexpr size_t kMaxCertificateCacheEntries = 32;
+
+using ContentHash = std::array<uint8_t, SHA256_DIGEST_LENGTH>;
+
+ContentHash contentHash(const vector<uint8_t>& data) {
+    ContentHash hash;
+    SHA256(data.data(), data.size(), hash.data());
+    return hash;
+}
+
+// A thread-safe least-recently-used cache of values derived from some data,
+// keyed by the SHA-256 of the data.
+template <typename T>
+class ContentCache {
+  public:
+    optional<T> get(const ContentHash& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            return {};
         }
-        parsedCertificates.push_back(std::move(x509));
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return it->second->second;
     }
-    return true;
+
+    void put(const ContentHash& key, T value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            it->second->second = std::move(value);
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return;
+        }
+        entries_.emplace_front(key, std::move(value));
+        index_[key] = entries_.begin();
+        if (entries_.size() > kMaxCertificateCacheEntries) {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        index_.clear();
+        entries_.clear();
+    }
+
+  private:
+    using Entries = std::list<pair<ContentHash, T>>;
+
+    std::mutex mutex_;
+    Entries entries_;
+    map<ContentHash, typename Entries::iterator> index_;
+};
+
+// Certificate chains which passed certificateChainValidate().
+ContentCache<bool>& validatedChainCache() {
+    static ContentCache<bool>* cache = new ContentCache<bool>();
+    return *cache;
 }
 
-bool certificateSignedByPublicKey(const vector<uint8_t>& certificate,
-                                  const vector<uint8_t>& publicKey) {
-    const unsigned char* p = certificate.data();
-    auto x509 = X509_Ptr(d2i_X509(nullptr, &p, certificate.size()));
-    if (x509 == nullptr) {
-        LOG(ERROR) << "Error parsing X509 certificate";
-        return false;
+// The key returned by certificateChainGetTopMostKey() for a chain.
+ContentCache<vector<uint8_t>>& topMostKeyCache() {
+    static ContentCache<vector<uint8_t>>* cache = new ContentCache<vector<uint8_t>>();
+    return *cache;
+}
+
+// Public keys in the format returned by ecKeyPairGetPublicKey(), as EVP_PKEYs.
+ContentCache<std::shared_ptr<EVP_PKEY>>& publicKeyCache() {
+    static ContentCache<std::shared_ptr<EVP_PKEY>>* cache =
+            new ContentCache<std::shared_ptr<EVP_PKEY>>();
+    return *cache;
+}
+
+// Returns |publicKey|, which must be in the format returned by
+// ecKeyPairGetPublicKey(), as an EVP_PKEY. The returned key is shared with
+// other callers and must not be modified.
+std::shared_ptr<EVP_PKEY> ecPublicKeyToEvpPkey(const vector<uint8_t>& publicKey) {
+    const ContentHash hash = contentHash(publicKey);
+    optional<std::shared_ptr<EVP_PKEY>> cached = publicKeyCache().get(hash);
+    if (cached) {
+        return cached.value();
     }
 
     auto group = EC_GROUP_Ptr(EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1));
@@ -655,24 +723,67 @@ bool certificateSignedByPublicKey(const vector<uint8_t>& certificate,
     if (EC_POINT_oct2point(group.get(), point.get(), publicKey.data(), publicKey.size(), nullptr) !=
         1) {
         LOG(ERROR) << "Error decoding publicKey";
-        return false;
+        return nullptr;
     }
     auto ecKey = EC_KEY_Ptr(EC_KEY_new());
     auto pkey = EVP_PKEY_Ptr(EVP_PKEY_new());
     if (ecKey.get() == nullptr || pkey.get() == nullptr) {
         LOG(ERROR) << "Memory allocation failed";
-        return false;
+        return nullptr;
     }
     if (EC_KEY_set_group(ecKey.get(), group.get()) != 1) {
         LOG(ERROR) << "Error setting group";
-        return false;
+        return nullptr;
     }
     if (EC_KEY_set_public_key(ecKey.get(), point.get()) != 1) {
         LOG(ERROR) << "Error setting point";
-        return false;
+        return nullptr;
     }
     if (EVP_PKEY_set1_EC_KEY(pkey.get(), ecKey.get()) != 1) {
         LOG(ERROR) << "Error setting key";
+        return nullptr;
+    }
+
+    std::shared_ptr<EVP_PKEY> ret(pkey.release(), EVP_PKEY_free);
+    publicKeyCache().put(hash, ret);
+    return ret;
+}
+
+}  // namespace
+
+void clearCertificateCaches() {
+    validatedChainCache().clear();
+    topMostKeyCache().clear();
+    publicKeyCache().clear();
+}
+
+static bool parseX509Certificates(const vector<uint8_t>& certificateChain,
+                                  vector<X509_Ptr>& parsedCertificates) {
+    const unsigned char* p = (unsigned char*)certificateChain.data();
+    const unsigned char* pEnd = p + certificateChain.size();
+    parsedCertificates.resize(0);
+    while (p < pEnd) {
+        auto x509 = X509_Ptr(d2i_X509(nullptr, &p, pEnd - p));
+        if (x509 == nullptr) {
+            LOG(ERROR) << "Error parsing X509 certificate";
+            return false;
+        }
+        parsedCertificates.push_back(std::move(x509));
+    }
+    return true;
+}
+
+bool certificateSignedByPublicKey(const vector<uint8_t>& certificate,
+                                  const vector<uint8_t>& publicKey) {
+    const unsigned char* p = certificate.data();
+    auto x509 = X509_Ptr(d2i_X509(nullptr, &p, certificate.size()));
+    if (x509 == nullptr) {
+        LOG(ERROR) << "Error parsing X509 certificate";
+        return false;
+    }
+
+    std::shared_ptr<EVP_PKEY> pkey = ecPublicKeyToEvpPkey(publicKey);
+    if (pkey == nullptr) {
         return false;
     }
 
@@ -690,6 +801,11 @@ bool certificateSignedByPublicKey(const vector<uint8_t>& certificate,
 //       It would be nice to use X509_verify_cert() instead of doing our own thing.
 //
 bool certificateChainValidate(const vector<uint8_t>& certificateChain) {
+    const ContentHash hash = contentHash(certificateChain);
+    if (validatedChainCache().get(hash)) {
+        return true;
+    }
+
     vector<X509_Ptr> certs;
 
     if (!parseX509Certificates(certificateChain, certs)) {
@@ -698,6 +814,7 @@ bool certificateChainValidate(const vector<uint8_t>& certificateChain) {
     }
 
     if (certs.size() == 1) {
+        validatedChainCache().put(hash, true);
         return true;
     }
 
@@ -712,6 +829,7 @@ bool certificateChainValidate(const vector<uint8_t>& certificateChain) {
         }
     }
 
+    validatedChainCache().put(hash, true);
     return true;
 }
 
@@ -724,33 +842,13 @@ bool checkEcDsaSignature(const vector<uint8_t>& digest, const vector<uint8_t>& s
         return false;
     }
 
-    auto group = EC_GROUP_Ptr(EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1));
-    auto point = EC_POINT_Ptr(EC_POINT_new(group.get()));
-    if (EC_POINT_oct2point(group.get(), point.get(), publicKey.data(), publicKey.size(), nullptr) !=
-        1) {
-        LOG(ERROR) << "Error decoding publicKey";
-        return false;
-    }
-    auto ecKey = EC_KEY_Ptr(EC_KEY_new());
-    auto pkey = EVP_PKEY_Ptr(EVP_PKEY_new());
-    if (ecKey.get() == nullptr || pkey.get() == nullptr) {
-        LOG(ERROR) << "Memory allocation failed";
-        return false;
-    }
-    if (EC_KEY_set_group(ecKey.get(), group.get()) != 1) {
-        LOG(ERROR) << "Error setting group";
-        return false;
-    }
-    if (EC_KEY_set_public_key(ecKey.get(), point.get()) != 1) {
-        LOG(ERROR) << "Error setting point";
-        return false;
-    }
-    if (EVP_PKEY_set1_EC_KEY(pkey.get(), ecKey.get()) != 1) {
-        LOG(ERROR) << "Error setting key";
+    std::shared_ptr<EVP_PKEY> pkey = ecPublicKeyToEvpPkey(publicKey);
+    if (pkey == nullptr) {
         return false;
     }
 
-    int rc = ECDSA_do_verify(digest.data(), digest.size(), sig.get(), ecKey.get());
+    int rc = ECDSA_do_verify(digest.data(), digest.size(), sig.get(),
+                             EVP_PKEY_get0_EC_KEY(pkey.get()));
     if (rc != 1) {
         LOG(ERROR) << "Error verifying signature (rc=" << rc << ")";
         return false;
@@ -1463,6 +1561,12 @@ tuple<bool, vector<uint8_t>, vector<uint8_t>> ecPublicKeyGetXandY(
 }
 
 optional<vector<uint8_t>> certificateChainGetTopMostKey(const vector<uint8_t>& certificateChain) {
+    const ContentHash hash = contentHash(certificateChain);
+    optional<vector<uint8_t>> cached = topMostKeyCache().get(hash);
+    if (cached) {
+        return cached;
+    }
+
     vector<X509_Ptr> certs;
     if (!parseX509Certificates(certificateChain, certs)) {
         return {};
@@ -1496,6 +1600,7 @@ optional<vector<uint8_t>> certificateChainGetTopMostKey(const vector<uint8_t>& c
     publicKey.resize(size);
     EC_POINT_point2oct(ecGroup, ecPoint, POINT_CONVERSION_UNCOMPRESSED, publicKey.data(),
                        publicKey.size(), nullptr);
+    topMostKeyCache().put(hash, publicKey);
     return publicKey;
 }
 
@@ -1883,74 +1988,165 @@ optional<vector<uint8_t>> coseSignEcDsa(const vector<uint8_t>& key, const vector
     return signatureCoseSign1;
 }
 
-bool coseCheckEcDsaSignature(const vector<uint8_t>& signatureCoseSign1,
-                             const vector<uint8_t>& detachedContent,
-                             const vector<uint8_t>& publicKey) {
+// Returns the value of the 'alg' label in the protected headers, or nothing if
+// there is none.
+static optional<int> coseProtectedHeadersGetAlg(const vector<uint8_t>& encodedProtectedHeaders) {
+    // An empty bstr stands for no protected headers at all.
+    if (encodedProtectedHeaders.size() == 0) {
+        return {};
+    }
+    auto [item, _, message] = cppbor::parse(encodedProtectedHeaders);
+    if (item == nullptr) {
+        LOG(ERROR) << "Error parsing protectedHeaders: " << message;
+        return {};
+    }
+    const cppbor::Map* protectedHeaders = item->asMap();
+    if (protectedHeaders == nullptr) {
+        LOG(ERROR) << "Decoded CBOR for protectedHeaders is not a map";
+        return {};
+    }
+
+    for (size_t n = 0; n < protectedHeaders->size(); n++) {
+        auto& [keyItem, valueItem] = (*protectedHeaders)[n];
+        const cppbor::Int* number = keyItem->asInt();
+        if (number == nullptr) {
+            LOG(ERROR) << "Key item in top-level map is not a number";
+            return {};
+        }
+        int label = number->value();
+        if (label == COSE_LABEL_ALG) {
+            const cppbor::Int* number = valueItem->asInt();
+            if (number != nullptr) {
+                return number->value();
+            }
+            LOG(ERROR) << "Value for COSE_LABEL_ALG label is not a number";
+            return {};
+        }
+    }
+    return {};
+}
+
+// Returns the value of the 'x5chain' label in the unprotected headers, or
+// nothing if there is none.
+static optional<vector<uint8_t>> coseUnprotectedHeadersGetX5Chain(
+        const cppbor::Map& unprotectedHeaders) {
+    for (size_t n = 0; n < unprotectedHeaders.size(); n++) {
+        auto& [keyItem, valueItem] = unprotectedHeaders[n];
+        const cppbor::Int* number = keyItem->asInt();
+        if (number == nullptr) {
+            LOG(ERROR) << "Key item in top-level map is not a number";
+            return {};
+        }
+        int label = number->value();
+        if (label == COSE_LABEL_X5CHAIN) {
+            const cppbor::Bstr* bstr = valueItem->asBstr();
+            if (bstr != nullptr) {
+                return bstr->value();
+            }
+            const cppbor::Array* array = valueItem->asArray();
+            if (array != nullptr) {
+                vector<uint8_t> certs;
+                for (size_t m = 0; m < array->size(); m++) {
+                    const cppbor::Bstr* bstr = ((*array)[m])->asBstr();
+                    if (bstr == nullptr) {
+                        LOG(ERROR) << "Item in x5chain array is not a bstr";
+                        return {};
+                    }
+                    const vector<uint8_t>& certValue = bstr->value();
+                    certs.insert(certs.end(), certValue.begin(), certValue.end());
+                }
+                return certs;
+            }
+            LOG(ERROR) << "Value for x5chain label is not a bstr or array";
+            return {};
+        }
+    }
+    return {};
+}
+
+optional<CoseSign1> coseSign1Decode(const vector<uint8_t>& signatureCoseSign1) {
     auto [item, _, message] = cppbor::parse(signatureCoseSign1);
     if (item == nullptr) {
         LOG(ERROR) << "Passed-in COSE_Sign1 is not valid CBOR: " << message;
-        return false;
+        return {};
     }
     const cppbor::Array* array = item->asArray();
     if (array == nullptr) {
         LOG(ERROR) << "Value for COSE_Sign1 is not an array";
-        return false;
+        return {};
     }
     if (array->size() != 4) {
         LOG(ERROR) << "Value for COSE_Sign1 is not an array of size 4";
-        return false;
+        return {};
     }
 
+    CoseSign1 coseSign1;
     const cppbor::Bstr* encodedProtectedHeadersBstr = (*array)[0]->asBstr();
-    ;
     if (encodedProtectedHeadersBstr == nullptr) {
         LOG(ERROR) << "Value for encodedProtectedHeaders is not a bstr";
-        return false;
+        return {};
     }
-    const vector<uint8_t> encodedProtectedHeaders = encodedProtectedHeadersBstr->value();
+    coseSign1.encodedProtectedHeaders = encodedProtectedHeadersBstr->value();
 
     const cppbor::Map* unprotectedHeaders = (*array)[1]->asMap();
     if (unprotectedHeaders == nullptr) {
         LOG(ERROR) << "Value for unprotectedHeaders is not a map";
-        return false;
+        return {};
     }
 
-    vector<uint8_t> data;
     const cppbor::Simple* payloadAsSimple = (*array)[2]->asSimple();
     if (payloadAsSimple != nullptr) {
         if (payloadAsSimple->asNull() == nullptr) {
             LOG(ERROR) << "Value for payload is not null or a bstr";
-            return false;
+            return {};
         }
+        // payload is null, so it should be empty (as it is)
     } else {
         const cppbor::Bstr* payloadAsBstr = (*array)[2]->asBstr();
         if (payloadAsBstr == nullptr) {
             LOG(ERROR) << "Value for payload is not null or a bstr";
-            return false;
+            return {};
         }
-        data = payloadAsBstr->value();  // TODO: avoid copy
+        coseSign1.payload = payloadAsBstr->value();
     }
 
-    if (data.size() > 0 && detachedContent.size() > 0) {
-        LOG(ERROR) << "data and detachedContent cannot both be non-empty";
+    const cppbor::Bstr* signatureAsBstr = (*array)[3]->asBstr();
+    if (signatureAsBstr == nullptr) {
+        LOG(ERROR) << "Value for signature is not a bstr";
+        return {};
+    }
+    coseSign1.signature = signatureAsBstr->value();
+
+    coseSign1.alg = coseProtectedHeadersGetAlg(coseSign1.encodedProtectedHeaders);
+    coseSign1.x5chain = coseUnprotectedHeadersGetX5Chain(*unprotectedHeaders);
+    return coseSign1;
+}
+
+bool coseCheckEcDsaSignature(const vector<uint8_t>& signatureCoseSign1,
+                             const vector<uint8_t>& detachedContent,
+                             const vector<uint8_t>& publicKey) {
+    optional<CoseSign1> coseSign1 = coseSign1Decode(signatureCoseSign1);
+    if (!coseSign1) {
         return false;
     }
+    return coseCheckEcDsaSignature(coseSign1.value(), detachedContent, publicKey);
+}
 
-    const cppbor::Bstr* signatureBstr = (*array)[3]->asBstr();
-    if (signatureBstr == nullptr) {
-        LOG(ERROR) << "Value for signature is a bstr";
+bool coseCheckEcDsaSignature(const CoseSign1& coseSign1, const vector<uint8_t>& detachedContent,
+                             const vector<uint8_t>& publicKey) {
+    if (coseSign1.payload.size() > 0 && detachedContent.size() > 0) {
+        LOG(ERROR) << "data and detachedContent cannot both be non-empty";
         return false;
     }
-    const vector<uint8_t>& coseSignature = signatureBstr->value();
 
     vector<uint8_t> derSignature;
-    if (!ecdsaSignatureCoseToDer(coseSignature, derSignature)) {
+    if (!ecdsaSignatureCoseToDer(coseSign1.signature, derSignature)) {
         LOG(ERROR) << "Error converting ECDSA signature from COSE to DER format";
         return false;
     }
 
-    vector<uint8_t> toBeSigned =
-            coseBuildToBeSigned(encodedProtectedHeaders, data, detachedContent);
+    vector<uint8_t> toBeSigned = coseBuildToBeSigned(coseSign1.encodedProtectedHeaders,
+                                                     coseSign1.payload, detachedContent);
     if (!checkEcDsaSignature(support::sha256(toBeSigned), derSignature, publicKey)) {
         LOG(ERROR) << "Signature check failed";
         return false;
@@ -1960,178 +2156,41 @@ bool coseCheckEcDsaSignature(const vector<uint8_t>& signatureCoseSign1,
 
 // Extracts the signature (of the ToBeSigned CBOR) from a COSE_Sign1.
 optional<vector<uint8_t>> coseSignGetSignature(const vector<uint8_t>& signatureCoseSign1) {
-    auto [item, _, message] = cppbor::parse(signatureCoseSign1);
-    if (item == nullptr) {
-        LOG(ERROR) << "Passed-in COSE_Sign1 is not valid CBOR: " << message;
-        return {};
-    }
-    const cppbor::Array* array = item->asArray();
-    if (array == nullptr) {
-        LOG(ERROR) << "Value for COSE_Sign1 is not an array";
-        return {};
-    }
-    if (array->size() != 4) {
-        LOG(ERROR) << "Value for COSE_Sign1 is not an array of size 4";
+    optional<CoseSign1> coseSign1 = coseSign1Decode(signatureCoseSign1);
+    if (!coseSign1) {
         return {};
     }
-
-    vector<uint8_t> signature;
-    const cppbor::Bstr* signatureAsBstr = (*array)[3]->asBstr();
-    if (signatureAsBstr == nullptr) {
-        LOG(ERROR) << "Value for signature is not a bstr";
-        return {};
-    }
-    // Copy payload into |data|
-    signature = signatureAsBstr->value();
-
-    return signature;
+    return std::move(coseSign1.value().signature);
 }
 
 optional<vector<uint8_t>> coseSignGetPayload(const vector<uint8_t>& signatureCoseSign1) {
-    auto [item, _, message] = cppbor::parse(signatureCoseSign1);
-    if (item == nullptr) {
-        LOG(ERROR) << "Passed-in COSE_Sign1 is not valid CBOR: " << message;
-        return {};
-    }
-    const cppbor::Array* array = item->asArray();
-    if (array == nullptr) {
-        LOG(ERROR) << "Value for COSE_Sign1 is not an array";
-        return {};
-    }
-    if (array->size() != 4) {
-        LOG(ERROR) << "Value for COSE_Sign1 is not an array of size 4";
+    optional<CoseSign1> coseSign1 = coseSign1Decode(signatureCoseSign1);
+    if (!coseSign1) {
         return {};
     }
-
-    vector<uint8_t> data;
-    const cppbor::Simple* payloadAsSimple = (*array)[2]->asSimple();
-    if (payloadAsSimple != nullptr) {
-        if (payloadAsSimple->asNull() == nullptr) {
-            LOG(ERROR) << "Value for payload is not null or a bstr";
-            return {};
-        }
-        // payload is null, so |data| should be empty (as it is)
-    } else {
-        const cppbor::Bstr* payloadAsBstr = (*array)[2]->asBstr();
-        if (payloadAsBstr == nullptr) {
-            LOG(ERROR) << "Value for payload is not null or a bstr";
-            return {};
-        }
-        // Copy payload into |data|
-        data = payloadAsBstr->value();
-    }
-
-    return data;
+    return std::move(coseSign1.value().payload);
 }
 
 optional<int> coseSignGetAlg(const vector<uint8_t>& signatureCoseSign1) {
-    auto [item, _, message] = cppbor::parse(signatureCoseSign1);
-    if (item == nullptr) {
-        LOG(ERROR) << "Passed-in COSE_Sign1 is not valid CBOR: " << message;
+    optional<CoseSign1> coseSign1 = coseSign1Decode(signatureCoseSign1);
+    if (!coseSign1) {
         return {};
     }
-    const cppbor::Array* array = item->asArray();
-    if (array == nullptr) {
-        LOG(ERROR) << "Value for COSE_Sign1 is not an array";
-        return {};
-    }
-    if (array->size() != 4) {
-        LOG(ERROR) << "Value for COSE_Sign1 is not an array of size 4";
-        return {};
-    }
-
-    const cppbor::Bstr* protectedHeadersBytes = (*array)[0]->asBstr();
-    if (protectedHeadersBytes == nullptr) {
-        LOG(ERROR) << "Value for protectedHeaders is not a bstr";
-        return {};
-    }
-    auto [item2, _2, message2] = cppbor::parse(protectedHeadersBytes->value());
-    if (item2 == nullptr) {
-        LOG(ERROR) << "Error parsing protectedHeaders: " << message2;
-        return {};
-    }
-    const cppbor::Map* protectedHeaders = item2->asMap();
-    if (protectedHeaders == nullptr) {
-        LOG(ERROR) << "Decoded CBOR for protectedHeaders is not a map";
-        return {};
-    }
-
-    for (size_t n = 0; n < protectedHeaders->size(); n++) {
-        auto& [keyItem, valueItem] = (*protectedHeaders)[n];
-        const cppbor::Int* number = keyItem->asInt();
-        if (number == nullptr) {
-            LOG(ERROR) << "Key item in top-level map is not a number";
-            return {};
-        }
-        int label = number->value();
-        if (label == COSE_LABEL_ALG) {
-            const cppbor::Int* number = valueItem->asInt();
-            if (number != nullptr) {
-                return number->value();
-            }
-            LOG(ERROR) << "Value for COSE_LABEL_ALG label is not a number";
-            return {};
-        }
+    if (!coseSign1.value().alg) {
+        LOG(ERROR) << "Did not find COSE_LABEL_ALG label in protected headers";
     }
-    LOG(ERROR) << "Did not find COSE_LABEL_ALG label in protected headers";
-    return {};
+    return coseSign1.value().alg;
 }
 
 optional<vector<uint8_t>> coseSignGetX5Chain(const vector<uint8_t>& signatureCoseSign1) {
-    auto [item, _, message] = cppbor::parse(signatureCoseSign1);
-    if (item == nullptr) {
-        LOG(ERROR) << "Passed-in COSE_Sign1 is not valid CBOR: " << message;
-        return {};
-    }
-    const cppbor::Array* array = item->asArray();
-    if (array == nullptr) {
-        LOG(ERROR) << "Value for COSE_Sign1 is not an array";
-        return {};
-    }
-    if (array->size() != 4) {
-        LOG(ERROR) << "Value for COSE_Sign1 is not an array of size 4";
+    optional<CoseSign1> coseSign1 = coseSign1Decode(signatureCoseSign1);
+    if (!coseSign1) {
         return {};
     }
-
-    const cppbor::Map* unprotectedHeaders = (*array)[1]->asMap();
-    if (unprotectedHeaders == nullptr) {
-        LOG(ERROR) << "Value for unprotectedHeaders is not a map";
-        return {};
-    }
-
-    for (size_t n = 0; n < unprotectedHeaders->size(); n++) {
-        auto& [keyItem, valueItem] = (*unprotectedHeaders)[n];
-        const cppbor::Int* number = keyItem->asInt();
-        if (number == nullptr) {
-            LOG(ERROR) << "Key item in top-level map is not a number";
-            return {};
-        }
-        int label = number->value();
-        if (label == COSE_LABEL_X5CHAIN) {
-            const cppbor::Bstr* bstr = valueItem->asBstr();
-            if (bstr != nullptr) {
-                return bstr->value();
-            }
-            const cppbor::Array* array = valueItem->asArray();
-            if (array != nullptr) {
-                vector<uint8_t> certs;
-                for (size_t m = 0; m < array->size(); m++) {
-                    const cppbor::Bstr* bstr = ((*array)[m])->asBstr();
-                    if (bstr == nullptr) {
-                        LOG(ERROR) << "Item in x5chain array is not a bstr";
-                        return {};
-                    }
-                    const vector<uint8_t>& certValue = bstr->value();
-                    certs.insert(certs.end(), certValue.begin(), certValue.end());
-                }
-                return certs;
-            }
-            LOG(ERROR) << "Value for x5chain label is not a bstr or array";
-            return {};
-        }
+    if (!coseSign1.value().x5chain) {
+        LOG(ERROR) << "Did not find x5chain label in unprotected headers";
     }
-    LOG(ERROR) << "Did not find x5chain label in unprotected headers";
-    return {};
+    return std::move(coseSign1.value().x5chain);
 }
 
 vector<uint8_t> coseBuildToBeMACed(const vector<uint8_t>& encodedProtectedHeaders,
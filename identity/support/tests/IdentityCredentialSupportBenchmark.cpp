@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2019, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <optional>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <android/hardware/identity/support/IdentityCredentialSupport.h>
+
+using std::optional;
+using std::vector;
+
+namespace support = ::android::hardware::identity::support;
+
+namespace {
+
+// A reader authenticating with a key certified by a root, and a credential
+// with an access control profile bound to that root.
+struct Reader {
+    Reader() {
+        vector<uint8_t> rootKeyPair = support::createEcKeyPair().value();
+        vector<uint8_t> rootPrivKey = support::ecKeyPairGetPrivateKey(rootKeyPair).value();
+        vector<uint8_t> rootPubKey = support::ecKeyPairGetPublicKey(rootKeyPair).value();
+        vector<uint8_t> keyPair = support::createEcKeyPair().value();
+        vector<uint8_t> privKey = support::ecKeyPairGetPrivateKey(keyPair).value();
+        pubKey = support::ecKeyPairGetPublicKey(keyPair).value();
+
+        profileCertificate = support::ecPublicKeyGenerateCertificate(
+                                     rootPubKey, rootPrivKey, "0001", "root", "root", 0, 0, {})
+                                     .value();
+        vector<uint8_t> readerCertificate =
+                support::ecPublicKeyGenerateCertificate(pubKey, rootPrivKey, "0002", "root",
+                                                        "reader", 0, 0, {})
+                        .value();
+        vector<uint8_t> chain =
+                support::certificateChainJoin({readerCertificate, profileCertificate});
+
+        readerAuthentication = vector<uint8_t>(256, 0x42);
+        readerSignature = support::coseSignEcDsa(privKey, {} /* data */, readerAuthentication,
+                                                 chain)
+                                  .value();
+    }
+
+    vector<uint8_t> pubKey;
+    vector<uint8_t> profileCertificate;
+    vector<uint8_t> readerAuthentication;
+    vector<uint8_t> readerSignature;
+};
+
+// The support library work of authenticating the reader in a presentation:
+// decoding its signature, checking its certificate chain, matching the
+// certificates against the profile, and checking the signature.
+bool authenticateReader(const Reader& reader) {
+    optional<support::CoseSign1> coseSign1 = support::coseSign1Decode(reader.readerSignature);
+    if (!coseSign1 || !coseSign1.value().x5chain || !coseSign1.value().alg) {
+        return false;
+    }
+    const vector<uint8_t>& chain = coseSign1.value().x5chain.value();
+    if (!support::certificateChainValidate(chain)) {
+        return false;
+    }
+    optional<vector<vector<uint8_t>>> certificates = support::certificateChainSplit(chain);
+    optional<vector<uint8_t>> profilePubKey =
+            support::certificateChainGetTopMostKey(reader.profileCertificate);
+    if (!certificates || !profilePubKey) {
+        return false;
+    }
+    bool profileMatched = false;
+    for (const vector<uint8_t>& certificate : certificates.value()) {
+        optional<vector<uint8_t>> pubKey = support::certificateChainGetTopMostKey(certificate);
+        if (!pubKey) {
+            return false;
+        }
+        profileMatched |= pubKey.value() == profilePubKey.value();
+    }
+    optional<vector<uint8_t>> readerPubKey =
+            support::certificateChainGetTopMostKey(certificates.value()[0]);
+    return profileMatched && readerPubKey &&
+           support::coseCheckEcDsaSignature(coseSign1.value(), reader.readerAuthentication,
+                                            readerPubKey.value());
+}
+
+}  // namespace
+
+// Every presentation to the same reader after the first one finds its certificates cached.
+static void BM_RepeatedPresentation(benchmark::State& state) {
+    static Reader reader;
+    for (auto _ : state) {
+        if (!authenticateReader(reader)) {
+            state.SkipWithError("Reader authentication failed");
+            break;
+        }
+    }
+}
+BENCHMARK(BM_RepeatedPresentation);
+
+// For comparison, presentations to readers never seen before.
+static void BM_FirstPresentation(benchmark::State& state) {
+    static Reader reader;
+    for (auto _ : state) {
+        support::clearCertificateCaches();
+        if (!authenticateReader(reader)) {
+            state.SkipWithError("Reader authentication failed");
+            break;
+        }
+    }
+}
+BENCHMARK(BM_FirstPresentation);
+
+BENCHMARK_MAIN();
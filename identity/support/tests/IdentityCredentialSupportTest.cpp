@@ -236,6 +236,86 @@ TEST(IdentityCredentialSupport, CoseSignaturesX5ChainWithMultipleCerts) {
     EXPECT_EQ(certsRecovered.value(), certChain);
 }
 
+TEST(IdentityCredentialSupport, CoseSign1Decode) {
+    optional<vector<uint8_t>> keyPair = support::createEcKeyPair();
+    ASSERT_TRUE(keyPair);
+    optional<vector<uint8_t>> privKey = support::ecKeyPairGetPrivateKey(keyPair.value());
+    ASSERT_TRUE(privKey);
+    optional<vector<uint8_t>> pubKey = support::ecKeyPairGetPublicKey(keyPair.value());
+    ASSERT_TRUE(pubKey);
+
+    vector<uint8_t> certChain = generateCertChain(2);
+    vector<uint8_t> data = {1, 2, 3};
+    optional<vector<uint8_t>> coseSign1 =
+            support::coseSignEcDsa(privKey.value(), data, {} /* detachedContent */, certChain);
+    ASSERT_TRUE(coseSign1);
+
+    optional<support::CoseSign1> decoded = support::coseSign1Decode(coseSign1.value());
+    ASSERT_TRUE(decoded);
+    EXPECT_EQ(data, decoded.value().payload);
+    EXPECT_EQ(support::coseSignGetSignature(coseSign1.value()), decoded.value().signature);
+    EXPECT_EQ(-7, decoded.value().alg);  // ECDSA 256
+    EXPECT_EQ(certChain, decoded.value().x5chain);
+    EXPECT_TRUE(support::coseCheckEcDsaSignature(decoded.value(), {}, pubKey.value()));
+
+    decoded.value().payload[0] ^= 0xff;
+    EXPECT_FALSE(support::coseCheckEcDsaSignature(decoded.value(), {}, pubKey.value()));
+
+    // Headers are optional.
+    cppbor::Array withoutHeaders;
+    withoutHeaders.add(vector<uint8_t>());
+    withoutHeaders.add(cppbor::Map());
+    withoutHeaders.add(cppbor::Null());
+    withoutHeaders.add(vector<uint8_t>(64));
+    decoded = support::coseSign1Decode(withoutHeaders.encode());
+    ASSERT_TRUE(decoded);
+    EXPECT_TRUE(decoded.value().payload.empty());
+    EXPECT_FALSE(decoded.value().alg);
+    EXPECT_FALSE(decoded.value().x5chain);
+
+    EXPECT_FALSE(support::coseSign1Decode(cppbor::Array().add(1).encode()));
+    EXPECT_FALSE(support::coseSign1Decode({0xff}));
+}
+
+TEST(IdentityCredentialSupport, CertificateCaches) {
+    optional<vector<uint8_t>> rootKeyPair = support::createEcKeyPair();
+    ASSERT_TRUE(rootKeyPair);
+    optional<vector<uint8_t>> rootPrivKey = support::ecKeyPairGetPrivateKey(rootKeyPair.value());
+    optional<vector<uint8_t>> rootPubKey = support::ecKeyPairGetPublicKey(rootKeyPair.value());
+    optional<vector<uint8_t>> keyPair = support::createEcKeyPair();
+    ASSERT_TRUE(keyPair);
+    optional<vector<uint8_t>> pubKey = support::ecKeyPairGetPublicKey(keyPair.value());
+
+    optional<vector<uint8_t>> rootCert = support::ecPublicKeyGenerateCertificate(
+            rootPubKey.value(), rootPrivKey.value(), "0001", "root", "root", 0, 0, {});
+    ASSERT_TRUE(rootCert);
+    optional<vector<uint8_t>> cert = support::ecPublicKeyGenerateCertificate(
+            pubKey.value(), rootPrivKey.value(), "0002", "root", "leaf", 0, 0, {});
+    ASSERT_TRUE(cert);
+    vector<uint8_t> chain = support::certificateChainJoin({cert.value(), rootCert.value()});
+    vector<uint8_t> wrongChain = support::certificateChainJoin({rootCert.value(), cert.value()});
+
+    support::clearCertificateCaches();
+    for (int n = 0; n < 2; n++) {
+        // Cached results are the same as the computed ones...
+        EXPECT_TRUE(support::certificateChainValidate(chain));
+        EXPECT_FALSE(support::certificateChainValidate(wrongChain));
+        EXPECT_EQ(pubKey, support::certificateChainGetTopMostKey(chain));
+        EXPECT_EQ(rootPubKey, support::certificateChainGetTopMostKey(wrongChain));
+        EXPECT_TRUE(support::certificateSignedByPublicKey(cert.value(), rootPubKey.value()));
+        EXPECT_FALSE(support::certificateSignedByPublicKey(cert.value(), pubKey.value()));
+
+        // ... and don't leak into similar data.
+        vector<uint8_t> modifiedChain = chain;
+        modifiedChain[cert.value().size() - 1] ^= 0x01;
+        EXPECT_FALSE(support::certificateChainValidate(modifiedChain));
+    }
+
+    support::clearCertificateCaches();
+    EXPECT_TRUE(support::certificateChainValidate(chain));
+    EXPECT_EQ(pubKey, support::certificateChainGetTopMostKey(chain));
+}
+
 TEST(IdentityCredentialSupport, CertificateChain) {
     optional<vector<uint8_t>> keyPair = support::createEcKeyPair();
     ASSERT_TRUE(keyPair);
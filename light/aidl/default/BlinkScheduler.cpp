@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BlinkScheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+using std::chrono::steady_clock;
+
+BlinkScheduler::BlinkScheduler() : mClock(steady_clock::now), mThreaded(true) {}
+
+BlinkScheduler::BlinkScheduler(Clock clock) : mClock(std::move(clock)), mThreaded(false) {}
+
+BlinkScheduler::~BlinkScheduler() {
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStopping = true;
+        thread = std::move(mThread);
+    }
+    mCondition.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void BlinkScheduler::start(int id, std::chrono::milliseconds on, std::chrono::milliseconds off,
+                           Switch switchLight) {
+    std::lock_guard<std::mutex> lock(mLock);
+    switchLight(true);
+    mBlinks[id] = {on, off, std::move(switchLight), true, mClock() + on};
+    if (mThreaded && !mThread.joinable()) {
+        mThread = std::thread(&BlinkScheduler::run, this);
+    }
+    mCondition.notify_all();
+}
+
+void BlinkScheduler::stop(int id) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mBlinks.erase(id);
+}
+
+bool BlinkScheduler::isBlinking(int id) const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mBlinks.count(id) > 0;
+}
+
+steady_clock::time_point BlinkScheduler::switchDue() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return switchDueLocked();
+}
+
+void BlinkScheduler::run() {
+    std::unique_lock<std::mutex> lock(mLock);
+    ::android::base::ScopedLockAssertion lockAssertion(mLock);
+    while (!mStopping) {
+        const auto next = switchDueLocked();
+        // Woken early when a blink is added, removed or replaced.
+        if (next == steady_clock::time_point::max()) {
+            mCondition.wait(lock);
+        } else {
+            mCondition.wait_until(lock, next);
+        }
+    }
+}
+
+steady_clock::time_point BlinkScheduler::switchDueLocked() {
+    const auto now = mClock();
+    auto next = steady_clock::time_point::max();
+    for (auto& [id, blink] : mBlinks) {
+        if (blink.next <= now) {
+            blink.isOn = !blink.isOn;
+            blink.switchLight(blink.isOn);
+            blink.next += blink.isOn ? blink.on : blink.off;
+            // Don't try to catch up after falling behind, it would only flicker.
+            if (blink.next < now) {
+                blink.next = now + (blink.isOn ? blink.on : blink.off);
+            }
+        }
+        next = std::min(next, blink.next);
+    }
+    return next;
+}
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+/**
+ * Blinks lights in software, all of them from a single thread which sleeps until the next light
+ * is due to change. The thread is started with the first blink.
+ *
+ * Lights are switched with the scheduler lock held, so once stop() returns a light is no longer
+ * switched, and switching must not call back into the scheduler.
+ */
+class BlinkScheduler {
+  public:
+    using Switch = std::function<void(bool on)>;
+    using Clock = std::function<std::chrono::steady_clock::time_point()>;
+
+    BlinkScheduler();
+    // Doesn't start a thread: lights are only switched by calls to switchDue(), at the times
+    // the clock tells. For tests.
+    explicit BlinkScheduler(Clock clock);
+    ~BlinkScheduler();
+
+    // Starts blinking the light, replacing its previous blink if any. The light is switched on
+    // before this returns.
+    void start(int id, std::chrono::milliseconds on, std::chrono::milliseconds off,
+               Switch switchLight);
+    void stop(int id);
+    bool isBlinking(int id) const;
+
+    // Switches the lights which are due, returns when the next one is, or time_point::max()
+    // without blinks.
+    std::chrono::steady_clock::time_point switchDue();
+
+  private:
+    struct Blink {
+        std::chrono::milliseconds on;
+        std::chrono::milliseconds off;
+        Switch switchLight;
+        bool isOn = true;
+        std::chrono::steady_clock::time_point next;
+    };
+
+    void run();
+    std::chrono::steady_clock::time_point switchDueLocked() REQUIRES(mLock);
+
+    const Clock mClock;
+    const bool mThreaded;
+
+    mutable std::mutex mLock;
+    std::condition_variable mCondition;
+    std::map<int, Blink> mBlinks GUARDED_BY(mLock);
+    bool mStopping GUARDED_BY(mLock) = false;
+    std::thread mThread GUARDED_BY(mLock);
+};
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
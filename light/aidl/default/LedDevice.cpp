@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LedDevice.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+
+#include <unistd.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+namespace {
+
+constexpr char kBrightness[] = "brightness";
+constexpr char kTrigger[] = "trigger";
+constexpr char kDelayOn[] = "delay_on";
+constexpr char kDelayOff[] = "delay_off";
+
+}  // namespace
+
+std::shared_ptr<LedDevice> LedDevice::create(const std::string& path) {
+    if (access((path + "/" + kBrightness).c_str(), W_OK) != 0) {
+        return nullptr;
+    }
+
+    int maxBrightness = 255;
+    std::string value;
+    if (::android::base::ReadFileToString(path + "/max_brightness", &value) &&
+        !::android::base::ParseInt(::android::base::Trim(value), &maxBrightness, 1)) {
+        LOG(WARNING) << "Invalid max_brightness of " << path << ": " << value;
+        return nullptr;
+    }
+
+    // The trigger attribute lists the available triggers, the current one in brackets.
+    std::string currentTrigger;
+    bool supportsTimerTrigger = false;
+    if (::android::base::ReadFileToString(path + "/" + kTrigger, &value)) {
+        for (auto trigger : ::android::base::Split(::android::base::Trim(value), " ")) {
+            if (trigger.size() > 2 && trigger.front() == '[' && trigger.back() == ']') {
+                trigger = trigger.substr(1, trigger.size() - 2);
+                currentTrigger = trigger;
+            }
+            if (trigger == "timer") {
+                supportsTimerTrigger = true;
+            }
+        }
+    }
+    const bool triggerWritable = access((path + "/" + kTrigger).c_str(), W_OK) == 0;
+    return std::shared_ptr<LedDevice>(new LedDevice(path, maxBrightness, currentTrigger,
+                                                    triggerWritable, supportsTimerTrigger));
+}
+
+LedDevice::LedDevice(std::string path, int maxBrightness, const std::string& trigger,
+                     bool triggerWritable, bool supportsTimerTrigger)
+    : mPath(std::move(path)),
+      mName(::android::base::Basename(mPath)),
+      mMaxBrightness(maxBrightness),
+      mTriggerWritable(triggerWritable),
+      mSupportsTimerTrigger(triggerWritable && supportsTimerTrigger) {
+    // The current trigger counts as written, so that LEDs without one don't need their trigger
+    // to be written at all.
+    if (!trigger.empty()) {
+        mWritten[kTrigger] = trigger;
+    }
+}
+
+bool LedDevice::supportsTimerTrigger() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mSupportsTimerTrigger;
+}
+
+bool LedDevice::writeLocked(const std::string& attribute, const std::string& value) {
+    auto written = mWritten.find(attribute);
+    if (written != mWritten.end() && written->second == value) {
+        return true;
+    }
+    const std::string path = mPath + "/" + attribute;
+    if (!::android::base::WriteStringToFile(value, path)) {
+        PLOG(ERROR) << "Failed to write " << value << " to " << path;
+        mWritten.erase(attribute);
+        return false;
+    }
+    mWritten[attribute] = value;
+    return true;
+}
+
+bool LedDevice::setTriggerLocked(const std::string& trigger) {
+    auto written = mWritten.find(kTrigger);
+    if (written != mWritten.end() && written->second == trigger) {
+        return true;
+    }
+    // Changing the trigger turns the LED off, and the timer trigger recreates its delays.
+    mWritten.erase(kBrightness);
+    mWritten.erase(kDelayOn);
+    mWritten.erase(kDelayOff);
+    return writeLocked(kTrigger, trigger);
+}
+
+bool LedDevice::setBrightnessLocked(int brightness) {
+    if (!writeLocked(kBrightness, std::to_string(brightness))) {
+        return false;
+    }
+    if (brightness == 0) {
+        // Turning the LED off removes its trigger.
+        mWritten.erase(kDelayOn);
+        mWritten.erase(kDelayOff);
+        if (mWritten.count(kTrigger)) {
+            mWritten[kTrigger] = "none";
+        }
+    }
+    return true;
+}
+
+bool LedDevice::setSteady(int brightness) {
+    std::lock_guard<std::mutex> lock(mLock);
+    // Without a known trigger, the LED may still be blinking from before we started.
+    if (mTriggerWritable && !setTriggerLocked("none")) {
+        LOG(WARNING) << "Driving " << mName << " through its brightness only";
+        mTriggerWritable = false;
+        mSupportsTimerTrigger = false;
+    }
+    return setBrightnessLocked(brightness);
+}
+
+bool LedDevice::setTimerBlink(int brightness, int onMs, int offMs) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (brightness == 0) {
+        return setTriggerLocked("none") && setBrightnessLocked(0);
+    }
+    if (setTriggerLocked("timer") && writeLocked(kDelayOn, std::to_string(onMs)) &&
+        writeLocked(kDelayOff, std::to_string(offMs)) && setBrightnessLocked(brightness)) {
+        return true;
+    }
+    // The delays are created along with the timer trigger, and may not be writable even when
+    // the trigger is. Blinking is left to software from now on.
+    mSupportsTimerTrigger = false;
+    return false;
+}
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
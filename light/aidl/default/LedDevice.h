@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+/**
+ * An LED class device, as found under /sys/class/leds.
+ *
+ * The values last written to each attribute are remembered, and writing them again is skipped.
+ * The kernel resets some attributes on its own: changing the trigger turns the LED off, and
+ * turning the LED off removes the trigger, so those writes forget the values they affect.
+ *
+ * Devices may only grant write access to brightness. LEDs whose trigger can't be written are
+ * driven through their brightness only, and don't blink with the timer trigger.
+ */
+class LedDevice {
+  public:
+    // Returns null if the directory isn't an LED.
+    static std::shared_ptr<LedDevice> create(const std::string& path);
+
+    const std::string& name() const { return mName; }
+    int maxBrightness() const { return mMaxBrightness; }
+    // Whether the kernel can blink the LED by itself, with the timer trigger.
+    bool supportsTimerTrigger();
+
+    bool setSteady(int brightness);
+    // Returns false, and stops supporting the timer trigger, if the LED can't blink with it.
+    bool setTimerBlink(int brightness, int onMs, int offMs);
+
+  private:
+    LedDevice(std::string path, int maxBrightness, const std::string& trigger,
+              bool triggerWritable, bool supportsTimerTrigger);
+
+    bool writeLocked(const std::string& attribute, const std::string& value) REQUIRES(mLock);
+    bool setTriggerLocked(const std::string& trigger) REQUIRES(mLock);
+    bool setBrightnessLocked(int brightness) REQUIRES(mLock);
+
+    const std::string mPath;
+    const std::string mName;
+    const int mMaxBrightness;
+
+    std::mutex mLock;
+    bool mTriggerWritable GUARDED_BY(mLock);
+    bool mSupportsTimerTrigger GUARDED_BY(mLock);
+    // The values of the attributes as last written, by attribute.
+    std::map<std::string, std::string> mWritten GUARDED_BY(mLock);
+};
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -17,19 +17,223 @@
 #include "Lights.h"
 
 #include <android-base/logging.h>
+#include <android-base/strings.h>
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <cctype>
+#include <map>
 
 namespace aidl {
 namespace android {
 namespace hardware {
 namespace light {
 
+namespace {
+
+constexpr char kDefaultRoot[] = "/sys/class/leds";
+
+const std::map<std::string, LightType> kFunctionTypes = {
+        {"backlight", LightType::BACKLIGHT},
+        {"lcd-backlight", LightType::BACKLIGHT},
+        {"kbd_backlight", LightType::KEYBOARD},
+        {"keyboard-backlight", LightType::KEYBOARD},
+        {"buttons", LightType::BUTTONS},
+        {"button-backlight", LightType::BUTTONS},
+        {"charging", LightType::BATTERY},
+        {"battery", LightType::BATTERY},
+        {"status", LightType::NOTIFICATIONS},
+        {"indicator", LightType::NOTIFICATIONS},
+        {"notification", LightType::NOTIFICATIONS},
+        {"attention", LightType::ATTENTION},
+        {"bluetooth", LightType::BLUETOOTH},
+        {"wlan", LightType::WIFI},
+        {"mute", LightType::MICROPHONE},
+        {"micmute", LightType::MICROPHONE},
+        {"flash", LightType::CAMERA},
+        {"torch", LightType::CAMERA},
+};
+
+struct LedName {
+    // LEDs of the same light share their group.
+    std::string group;
+    std::string color;
+    LightType type;
+};
+
+std::optional<LedName> parseLedName(const std::string& name) {
+    // Legacy names, which carry either the function or the color.
+    if (name == "red" || name == "green" || name == "blue" || name == "white") {
+        return LedName{"notification", name, LightType::NOTIFICATIONS};
+    }
+    auto parts = ::android::base::Split(name, ":");
+    if (parts.size() == 1) {
+        parts = {"", "", name};
+    } else if (parts.size() == 2) {
+        parts.insert(parts.begin(), "");
+    }
+    if (parts.size() != 3) {
+        return std::nullopt;
+    }
+
+    // Functions may be enumerated, as in status-1.
+    std::string function = parts[2];
+    const size_t dash = function.find_last_of('-');
+    if (dash != std::string::npos && dash + 1 < function.size() &&
+        std::all_of(function.begin() + dash + 1, function.end(), ::isdigit)) {
+        function.resize(dash);
+    }
+    auto type = kFunctionTypes.find(function);
+    if (type == kFunctionTypes.end()) {
+        return std::nullopt;
+    }
+    return LedName{parts[0] + ":" + parts[2], parts[1], type->second};
+}
+
+}  // namespace
+
+Lights::Lights() : Lights(kDefaultRoot) {}
+
+Lights::Lights(const std::string& root) : Lights(root, std::make_shared<BlinkScheduler>()) {}
+
+Lights::Lights(const std::string& root, std::shared_ptr<BlinkScheduler> blinkScheduler)
+    : mLights(discover(root)), mBlinkScheduler(std::move(blinkScheduler)) {
+    for (const auto& light : mLights) {
+        std::vector<std::string> names;
+        for (const auto& led : light.leds) {
+            names.push_back(led.device->name());
+        }
+        LOG(INFO) << "Light " << light.info.id << " is " << toString(light.info.type) << " "
+                  << light.info.ordinal << ", with " << ::android::base::Join(names, ", ");
+    }
+}
+
+std::vector<Lights::Light> Lights::discover(const std::string& root) {
+    std::vector<std::string> names;
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(root.c_str()), closedir);
+    if (!dir) {
+        PLOG(WARNING) << "Failed to open " << root;
+        return {};
+    }
+    while (struct dirent* entry = readdir(dir.get())) {
+        if (entry->d_name[0] != '.') {
+            names.push_back(entry->d_name);
+        }
+    }
+    std::sort(names.begin(), names.end());
+
+    std::map<std::string, Light> groups;
+    for (const auto& name : names) {
+        auto ledName = parseLedName(name);
+        if (!ledName) {
+            LOG(INFO) << "Ignoring LED " << name << " of unknown function";
+            continue;
+        }
+        auto device = LedDevice::create(root + "/" + name);
+        if (!device) {
+            continue;
+        }
+        Channel channel = Channel::BRIGHTNESS;
+        if (ledName->color == "red") {
+            channel = Channel::RED;
+        } else if (ledName->color == "green") {
+            channel = Channel::GREEN;
+        } else if (ledName->color == "blue") {
+            channel = Channel::BLUE;
+        }
+        Light& light = groups[ledName->group];
+        light.info.type = ledName->type;
+        light.leds.push_back({std::move(device), channel});
+    }
+
+    std::vector<Light> lights;
+    std::map<LightType, int> ordinals;
+    for (auto& [group, light] : groups) {
+        light.info.id = lights.size();
+        light.info.ordinal = ordinals[light.info.type]++;
+        lights.push_back(std::move(light));
+    }
+    return lights;
+}
+
+int Lights::level(const Led& led, int color) {
+    const int red = (color >> 16) & 0xff;
+    const int green = (color >> 8) & 0xff;
+    const int blue = color & 0xff;
+    int value = 0;
+    switch (led.channel) {
+        case Channel::RED:
+            value = red;
+            break;
+        case Channel::GREEN:
+            value = green;
+            break;
+        case Channel::BLUE:
+            value = blue;
+            break;
+        case Channel::BRIGHTNESS:
+            value = (77 * red + 150 * green + 29 * blue) >> 8;
+            break;
+    }
+    return (value * led.device->maxBrightness() + 127) / 255;
+}
+
 ndk::ScopedAStatus Lights::setLightState(int id, const HwLightState& state) {
-    LOG(INFO) << "Lights setting state for id=" << id << " to color " << std::hex << state.color;
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    std::lock_guard<std::mutex> lock(mLock);
+    if (id < 0 || id >= static_cast<int>(mLights.size()) ||
+        state.brightnessMode == BrightnessMode::LOW_PERSISTENCE) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    }
+    Light& light = mLights[id];
+    if (light.state == state) {
+        return ndk::ScopedAStatus::ok();
+    }
+
+    mBlinkScheduler->stop(id);
+    light.state.reset();
+    const bool blink = state.flashMode != FlashMode::NONE && state.flashOnMs > 0 &&
+                       state.flashOffMs > 0 && (state.color & 0xffffff) != 0;
+    bool timerBlink =
+            blink && std::all_of(light.leds.begin(), light.leds.end(), [](const Led& led) {
+                return led.device->supportsTimerTrigger();
+            });
+    if (timerBlink) {
+        for (const auto& led : light.leds) {
+            timerBlink = led.device->setTimerBlink(level(led, state.color), state.flashOnMs,
+                                                   state.flashOffMs) &&
+                         timerBlink;
+        }
+        if (!timerBlink) {
+            LOG(WARNING) << "Blinking light " << id << " in software instead";
+        }
+    }
+    bool ok = true;
+    if (blink && !timerBlink) {
+        mBlinkScheduler->start(id, std::chrono::milliseconds(state.flashOnMs),
+                               std::chrono::milliseconds(state.flashOffMs),
+                               [leds = light.leds, color = state.color](bool on) {
+                                   for (const auto& led : leds) {
+                                       led.device->setSteady(on ? level(led, color) : 0);
+                                   }
+                               });
+    } else if (!blink) {
+        for (const auto& led : light.leds) {
+            ok &= led.device->setSteady(level(led, state.color));
+        }
+    }
+    if (!ok) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+    light.state = state;
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Lights::getLights(std::vector<HwLight>* /*lights*/) {
-    LOG(INFO) << "Lights reporting supported lights";
+ndk::ScopedAStatus Lights::getLights(std::vector<HwLight>* lights) {
+    std::lock_guard<std::mutex> lock(mLock);
+    for (const auto& light : mLights) {
+        lights->push_back(light.info);
+    }
     return ndk::ScopedAStatus::ok();
 }
 
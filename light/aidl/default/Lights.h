@@ -17,16 +17,66 @@
 #pragma once
 
 #include <aidl/android/hardware/light/BnLights.h>
+#include <android-base/thread_annotations.h>
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "BlinkScheduler.h"
+#include "LedDevice.h"
 
 namespace aidl {
 namespace android {
 namespace hardware {
 namespace light {
 
-// Default implementation that reports no supported lights.
+/**
+ * Drives the LED class devices found under a sysfs root, /sys/class/leds by default.
+ *
+ * LEDs are named devicename:color:function, and those sharing a device name and function make
+ * up one light, whose type follows from the function. Lights with red, green and blue LEDs show
+ * colors, other lights show the brightness of the color. The legacy names lcd-backlight,
+ * button-backlight, keyboard-backlight and red, green and blue for the notification light are
+ * understood as well.
+ *
+ * Lights blink with the kernel timer trigger when all their LEDs support it, and in software
+ * otherwise.
+ */
 class Lights : public BnLights {
+  public:
+    Lights();
+    explicit Lights(const std::string& root);
+    Lights(const std::string& root, std::shared_ptr<BlinkScheduler> blinkScheduler);
+
     ndk::ScopedAStatus setLightState(int id, const HwLightState& state) override;
     ndk::ScopedAStatus getLights(std::vector<HwLight>* types) override;
+
+  private:
+    enum class Channel { RED, GREEN, BLUE, BRIGHTNESS };
+
+    struct Led {
+        std::shared_ptr<LedDevice> device;
+        Channel channel;
+    };
+
+    struct Light {
+        HwLight info;
+        std::vector<Led> leds;
+        std::optional<HwLightState> state;
+    };
+
+    // Discovers the lights, returns them in ID order.
+    static std::vector<Light> discover(const std::string& root);
+    static int level(const Led& led, int color);
+
+    std::mutex mLock;
+    std::vector<Light> mLights GUARDED_BY(mLock);
+    // Declared last, so blinking stops before the lights go. Blinks hold on to their own LEDs,
+    // so a scheduler shared with a test may outlive the lights.
+    const std::shared_ptr<BlinkScheduler> mBlinkScheduler;
 };
 
 }  // namespace light
@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <gtest/gtest.h>
+
+#include "BlinkScheduler.h"
+#include "Lights.h"
+
+using ::aidl::android::hardware::light::BlinkScheduler;
+using ::aidl::android::hardware::light::BrightnessMode;
+using ::aidl::android::hardware::light::FlashMode;
+using ::aidl::android::hardware::light::HwLight;
+using ::aidl::android::hardware::light::HwLightState;
+using ::aidl::android::hardware::light::Lights;
+using ::aidl::android::hardware::light::LightType;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+// A fake /sys/class/leds, and a fake clock for blinking in software.
+class LightsTest : public ::testing::Test {
+  protected:
+    void addLed(const std::string& name, int maxBrightness, bool timerTrigger) {
+        const std::string dir = std::string(mRoot.path) + "/" + name;
+        ASSERT_EQ(0, mkdir(dir.c_str(), 0700));
+        write(name, "brightness", "0");
+        write(name, "max_brightness", std::to_string(maxBrightness));
+        write(name, "trigger", timerTrigger ? "[none] timer heartbeat" : "[none] heartbeat");
+        if (timerTrigger) {
+            write(name, "delay_on", "500");
+            write(name, "delay_off", "500");
+        }
+    }
+
+    void write(const std::string& led, const std::string& attribute, const std::string& value) {
+        ASSERT_TRUE(android::base::WriteStringToFile(
+                value, std::string(mRoot.path) + "/" + led + "/" + attribute));
+    }
+
+    std::string read(const std::string& led, const std::string& attribute) {
+        std::string value;
+        EXPECT_TRUE(android::base::ReadFileToString(
+                std::string(mRoot.path) + "/" + led + "/" + attribute, &value));
+        return value;
+    }
+
+    std::shared_ptr<Lights> makeLights() {
+        return ndk::SharedRefBase::make<Lights>(std::string(mRoot.path), mBlinkScheduler);
+    }
+
+    // Lets time pass, switching the lights blinking in software as they come due.
+    void advance(milliseconds duration) {
+        const auto end = mNow + duration;
+        for (auto next = mBlinkScheduler->switchDue(); next <= end;
+             next = mBlinkScheduler->switchDue()) {
+            mNow = next;
+        }
+        mNow = end;
+    }
+
+    // Returns the lights by their type and ordinal.
+    std::map<std::pair<LightType, int>, int> lightIds(const std::shared_ptr<Lights>& lights) {
+        std::vector<HwLight> list;
+        EXPECT_TRUE(lights->getLights(&list).isOk());
+        std::map<std::pair<LightType, int>, int> ids;
+        for (const auto& light : list) {
+            ids[{light.type, light.ordinal}] = light.id;
+        }
+        return ids;
+    }
+
+    static HwLightState steady(int color) {
+        HwLightState state;
+        state.color = color;
+        state.flashMode = FlashMode::NONE;
+        state.brightnessMode = BrightnessMode::USER;
+        return state;
+    }
+
+    static HwLightState flashing(int color, int onMs, int offMs) {
+        HwLightState state = steady(color);
+        state.flashMode = FlashMode::TIMED;
+        state.flashOnMs = onMs;
+        state.flashOffMs = offMs;
+        return state;
+    }
+
+    TemporaryDir mRoot;
+    steady_clock::time_point mNow = steady_clock::time_point() + seconds(1000);
+    std::shared_ptr<BlinkScheduler> mBlinkScheduler =
+            std::make_shared<BlinkScheduler>([this] { return mNow; });
+};
+
+TEST_F(LightsTest, DiscoversLights) {
+    addLed("lcd-backlight", 1023, false);
+    addLed("red", 255, false);
+    addLed("green", 255, false);
+    addLed("blue", 255, false);
+    addLed("platform:white:charging", 1, false);
+    addLed("platform:green:status-1", 255, false);
+    addLed("mmc0::", 255, true);
+    auto ids = lightIds(makeLights());
+
+    ASSERT_EQ(4u, ids.size());
+    EXPECT_TRUE(ids.count({LightType::BACKLIGHT, 0}));
+    EXPECT_TRUE(ids.count({LightType::BATTERY, 0}));
+    EXPECT_TRUE(ids.count({LightType::NOTIFICATIONS, 0}));
+    EXPECT_TRUE(ids.count({LightType::NOTIFICATIONS, 1}));
+    std::set<int> unique;
+    for (const auto& [light, id] : ids) {
+        EXPECT_TRUE(unique.insert(id).second);
+    }
+}
+
+TEST_F(LightsTest, ReportsNoLightsWithoutLeds) {
+    EXPECT_TRUE(lightIds(makeLights()).empty());
+}
+
+TEST_F(LightsTest, RejectsUnsupportedRequests) {
+    addLed("lcd-backlight", 255, false);
+    auto lights = makeLights();
+    auto status = lights->setLightState(1, steady(0xffffffff));
+    EXPECT_EQ(EX_UNSUPPORTED_OPERATION, status.getExceptionCode());
+    status = lights->setLightState(-1, steady(0xffffffff));
+    EXPECT_EQ(EX_UNSUPPORTED_OPERATION, status.getExceptionCode());
+    HwLightState state = steady(0xffffffff);
+    state.brightnessMode = BrightnessMode::LOW_PERSISTENCE;
+    status = lights->setLightState(0, state);
+    EXPECT_EQ(EX_UNSUPPORTED_OPERATION, status.getExceptionCode());
+}
+
+TEST_F(LightsTest, MapsColorsToChannels) {
+    addLed("lcd-backlight", 1023, false);
+    addLed("red", 255, false);
+    addLed("green", 100, false);
+    addLed("blue", 255, false);
+    auto lights = makeLights();
+    auto ids = lightIds(lights);
+
+    ASSERT_TRUE(lights->setLightState(ids[{LightType::NOTIFICATIONS, 0}], steady(0xff8040ff))
+                        .isOk());
+    EXPECT_EQ("128", read("red", "brightness"));
+    EXPECT_EQ("25", read("green", "brightness"));
+    EXPECT_EQ("255", read("blue", "brightness"));
+
+    // Single channel lights show the luminance of the color.
+    ASSERT_TRUE(
+            lights->setLightState(ids[{LightType::BACKLIGHT, 0}], steady(0xffffffff)).isOk());
+    EXPECT_EQ("1023", read("lcd-backlight", "brightness"));
+    ASSERT_TRUE(
+            lights->setLightState(ids[{LightType::BACKLIGHT, 0}], steady(0xff800000)).isOk());
+    EXPECT_EQ("152", read("lcd-backlight", "brightness"));
+    // Already without a trigger, so it isn't written.
+    EXPECT_EQ("[none] heartbeat", read("lcd-backlight", "trigger"));
+}
+
+TEST_F(LightsTest, ClearsTheTriggerSetBeforeStarting) {
+    addLed("lcd-backlight", 255, false);
+    write("lcd-backlight", "trigger", "none [heartbeat]");
+    auto lights = makeLights();
+    ASSERT_TRUE(lights->setLightState(0, steady(0xffffffff)).isOk());
+    EXPECT_EQ("none", read("lcd-backlight", "trigger"));
+    EXPECT_EQ("255", read("lcd-backlight", "brightness"));
+}
+
+TEST_F(LightsTest, DrivesLedsWithAReadOnlyTrigger) {
+    if (geteuid() == 0) {
+        GTEST_SKIP() << "File permissions don't apply to root";
+    }
+    addLed("platform:white:status", 255, true);
+    ASSERT_EQ(0, chmod((std::string(mRoot.path) + "/platform:white:status/trigger").c_str(),
+                       0444));
+    auto lights = makeLights();
+    ASSERT_TRUE(lights->setLightState(0, steady(0xffffffff)).isOk());
+    EXPECT_EQ("255", read("platform:white:status", "brightness"));
+
+    // Blinks in software rather than with the timer trigger.
+    ASSERT_TRUE(lights->setLightState(0, flashing(0xffffffff, 20, 20)).isOk());
+    advance(milliseconds(20));
+    EXPECT_EQ("0", read("platform:white:status", "brightness"));
+    EXPECT_EQ("[none] timer heartbeat", read("platform:white:status", "trigger"));
+}
+
+TEST_F(LightsTest, DrivesLedsWhoseTriggerCantBeWritten) {
+    // Unlike permissions, this holds for root as well.
+    addLed("lcd-backlight", 255, false);
+    const std::string trigger = std::string(mRoot.path) + "/lcd-backlight/trigger";
+    ASSERT_EQ(0, unlink(trigger.c_str()));
+    ASSERT_EQ(0, mkdir(trigger.c_str(), 0700));
+    auto lights = makeLights();
+    ASSERT_TRUE(lights->setLightState(0, steady(0xffffffff)).isOk());
+    EXPECT_EQ("255", read("lcd-backlight", "brightness"));
+    ASSERT_TRUE(lights->setLightState(0, steady(0xff000000)).isOk());
+    EXPECT_EQ("0", read("lcd-backlight", "brightness"));
+}
+
+TEST_F(LightsTest, BlinksInSoftwareWhenTheDelaysCantBeWritten) {
+    addLed("platform:white:status", 255, true);
+    const std::string delayOn = std::string(mRoot.path) + "/platform:white:status/delay_on";
+    ASSERT_EQ(0, unlink(delayOn.c_str()));
+    ASSERT_EQ(0, mkdir(delayOn.c_str(), 0700));
+    auto lights = makeLights();
+    ASSERT_TRUE(lights->setLightState(0, flashing(0xffffffff, 20, 20)).isOk());
+    EXPECT_EQ("none", read("platform:white:status", "trigger"));
+    EXPECT_EQ("255", read("platform:white:status", "brightness"));
+    advance(milliseconds(20));
+    EXPECT_EQ("0", read("platform:white:status", "brightness"));
+}
+
+TEST_F(LightsTest, CoalescesWrites) {
+    addLed("red", 255, false);
+    addLed("green", 255, false);
+    addLed("blue", 255, false);
+    auto lights = makeLights();
+    ASSERT_TRUE(lights->setLightState(0, steady(0xffff0000)).isOk());
+    EXPECT_EQ("255", read("red", "brightness"));
+
+    // Anything written again would overwrite the markers.
+    write("red", "brightness", "marker");
+    write("red", "trigger", "marker");
+    write("green", "brightness", "marker");
+    ASSERT_TRUE(lights->setLightState(0, steady(0xffff0000)).isOk());
+    EXPECT_EQ("marker", read("green", "brightness"));
+
+    ASSERT_TRUE(lights->setLightState(0, steady(0xffff00ff)).isOk());
+    EXPECT_EQ("marker", read("red", "brightness"));
+    EXPECT_EQ("marker", read("red", "trigger"));
+    EXPECT_EQ("marker", read("green", "brightness"));
+    EXPECT_EQ("255", read("blue", "brightness"));
+}
+
+TEST_F(LightsTest, BlinksWithTheTimerTrigger) {
+    addLed("platform:white:status", 255, true);
+    auto lights = makeLights();
+    ASSERT_TRUE(lights->setLightState(0, flashing(0xffffffff, 100, 900)).isOk());
+    EXPECT_EQ("timer", read("platform:white:status", "trigger"));
+    EXPECT_EQ("100", read("platform:white:status", "delay_on"));
+    EXPECT_EQ("900", read("platform:white:status", "delay_off"));
+    EXPECT_EQ("255", read("platform:white:status", "brightness"));
+
+    // Stays in the kernel's hands.
+    EXPECT_EQ(steady_clock::time_point::max(), mBlinkScheduler->switchDue());
+    write("platform:white:status", "brightness", "marker");
+    advance(milliseconds(2000));
+    EXPECT_EQ("marker", read("platform:white:status", "brightness"));
+
+    ASSERT_TRUE(lights->setLightState(0, steady(0xff000000)).isOk());
+    EXPECT_EQ("none", read("platform:white:status", "trigger"));
+    EXPECT_EQ("0", read("platform:white:status", "brightness"));
+}
+
+TEST_F(LightsTest, BlinksInSoftwareWithoutTheTimerTrigger) {
+    addLed("red", 255, false);
+    addLed("green", 255, false);
+    addLed("blue", 255, false);
+    addLed("platform:white:status", 255, true);
+    auto lights = makeLights();
+    auto ids = lightIds(lights);
+    const int rgb = ids[{LightType::NOTIFICATIONS, 0}];
+    const int white = ids[{LightType::NOTIFICATIONS, 1}];
+
+    ASSERT_TRUE(lights->setLightState(rgb, flashing(0xff00ff00, 20, 20)).isOk());
+    ASSERT_TRUE(lights->setLightState(white, flashing(0xffffffff, 20, 20)).isOk());
+    EXPECT_EQ("timer", read("platform:white:status", "trigger"));
+    EXPECT_EQ("[none] heartbeat", read("green", "trigger"));
+    EXPECT_EQ("255", read("green", "brightness"));
+    advance(milliseconds(20));
+    EXPECT_EQ("0", read("green", "brightness"));
+    advance(milliseconds(20));
+    EXPECT_EQ("255", read("green", "brightness"));
+    EXPECT_EQ("0", read("red", "brightness"));
+
+    // Stopping the blink leaves the light as requested.
+    advance(milliseconds(20));
+    ASSERT_TRUE(lights->setLightState(rgb, steady(0xff0000ff)).isOk());
+    EXPECT_EQ("0", read("green", "brightness"));
+    EXPECT_EQ("255", read("blue", "brightness"));
+    write("green", "brightness", "marker");
+    advance(milliseconds(100));
+    EXPECT_EQ("marker", read("green", "brightness"));
+}
+
+class BlinkSchedulerTest : public ::testing::Test {
+  protected:
+    steady_clock::time_point mNow = steady_clock::time_point() + seconds(1000);
+    BlinkScheduler mScheduler{[this] { return mNow; }};
+};
+
+TEST_F(BlinkSchedulerTest, MultiplexesBlinks) {
+    int fastSwitches = 0;
+    int slowSwitches = 0;
+    bool fastOn = false;
+    mScheduler.start(1, milliseconds(10), milliseconds(20), [&](bool on) {
+        fastOn = on;
+        fastSwitches++;
+    });
+    mScheduler.start(2, milliseconds(100), milliseconds(100), [&](bool) { slowSwitches++; });
+    EXPECT_TRUE(fastOn);
+    EXPECT_EQ(1, slowSwitches);
+
+    // Each light is switched when due, and the scheduler tells when the next one is.
+    EXPECT_EQ(mNow + milliseconds(10), mScheduler.switchDue());
+    mNow += milliseconds(10);
+    EXPECT_EQ(mNow + milliseconds(20), mScheduler.switchDue());
+    EXPECT_FALSE(fastOn);
+    mNow += milliseconds(20);
+    EXPECT_EQ(mNow + milliseconds(10), mScheduler.switchDue());
+    EXPECT_TRUE(fastOn);
+    EXPECT_EQ(3, fastSwitches);
+
+    for (int i = 0; i < 42; i++) {
+        mNow += milliseconds(5);
+        mScheduler.switchDue();
+    }
+    // 240 ms in, on 10 ms and off 20 ms, and on and off every 100 ms.
+    EXPECT_EQ(17, fastSwitches);
+    EXPECT_EQ(3, slowSwitches);
+
+    mScheduler.stop(1);
+    EXPECT_FALSE(mScheduler.isBlinking(1));
+    EXPECT_TRUE(mScheduler.isBlinking(2));
+    EXPECT_EQ(steady_clock::time_point() + seconds(1000) + milliseconds(300),
+              mScheduler.switchDue());
+    mNow += milliseconds(100);
+    mScheduler.switchDue();
+    EXPECT_EQ(17, fastSwitches);
+    EXPECT_EQ(4, slowSwitches);
+}
+
+TEST_F(BlinkSchedulerTest, ReplacesBlinks) {
+    int oldSwitches = 0;
+    int newSwitches = 0;
+    mScheduler.start(1, milliseconds(5), milliseconds(5), [&](bool) { oldSwitches++; });
+    mScheduler.start(1, milliseconds(5), milliseconds(5), [&](bool) { newSwitches++; });
+    for (int i = 0; i < 4; i++) {
+        mNow += milliseconds(5);
+        mScheduler.switchDue();
+    }
+    EXPECT_EQ(1, oldSwitches);
+    EXPECT_EQ(5, newSwitches);
+}
+
+TEST_F(BlinkSchedulerTest, DoesntCatchUpAfterFallingBehind) {
+    int switches = 0;
+    mScheduler.start(1, milliseconds(10), milliseconds(10), [&](bool) { switches++; });
+    mNow += milliseconds(1000);
+    EXPECT_EQ(mNow + milliseconds(10), mScheduler.switchDue());
+    EXPECT_EQ(2, switches);
+}
+
+TEST(BlinkSchedulerThreadTest, BlinksFromItsThread) {
+    std::mutex lock;
+    std::condition_variable switched;
+    int switches = 0;
+    BlinkScheduler scheduler;
+    scheduler.start(1, milliseconds(1), milliseconds(1), [&](bool) {
+        std::lock_guard<std::mutex> guard(lock);
+        switches++;
+        switched.notify_all();
+    });
+    std::unique_lock<std::mutex> guard(lock);
+    // The timeout only bounds a failing run.
+    EXPECT_TRUE(switched.wait_for(guard, seconds(10), [&] { return switches >= 5; }));
+}
+
+}  // namespace
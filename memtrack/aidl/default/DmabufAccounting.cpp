@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DmabufAccounting.h"
+
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cinttypes>
+#include <climits>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace memtrack {
+
+using ::android::base::ParseUint;
+using ::android::base::ReadFileToString;
+using ::android::base::StartsWith;
+using ::android::base::Trim;
+
+namespace {
+
+// Older kernels name all dma-buf files alike, newer ones append the buffer name.
+bool isDmabufPath(const std::string& path) {
+    return StartsWith(path, "/dmabuf:") || path == "anon_inode:dmabuf";
+}
+
+// Reads the "key:<whitespace>value" lines of an fdinfo file.
+std::map<std::string, std::string> readFdinfo(const std::string& path) {
+    std::map<std::string, std::string> fields;
+    std::string content;
+    if (!ReadFileToString(path, &content)) {
+        return fields;
+    }
+    std::istringstream lines(content);
+    std::string line;
+    while (std::getline(lines, line)) {
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            fields[line.substr(0, colon)] = Trim(line.substr(colon + 1));
+        }
+    }
+    return fields;
+}
+
+template <typename Visitor>
+bool forEachEntry(const std::string& path, Visitor visit) {
+    std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(path.c_str()), closedir);
+    if (!dir) {
+        return false;
+    }
+    while (struct dirent* entry = readdir(dir.get())) {
+        if (entry->d_name[0] != '.') {
+            visit(entry->d_name);
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+std::vector<std::pair<std::string, MemtrackType>> DmabufAccounting::defaultExporterTypes() {
+    // Heaps are named by what they're for. Everything else comes from display or GPU drivers,
+    // or from the generic system heaps gralloc allocates from.
+    return {
+            {"camera", MemtrackType::CAMERA},
+            {"video", MemtrackType::MULTIMEDIA},
+            {"vframe", MemtrackType::MULTIMEDIA},
+            {"vstream", MemtrackType::MULTIMEDIA},
+            {"system", MemtrackType::GRAPHICS},
+            {"virtio_gpu", MemtrackType::GRAPHICS},
+            {"msm_drm", MemtrackType::GRAPHICS},
+            {"i915", MemtrackType::GRAPHICS},
+            {"amdgpu", MemtrackType::GRAPHICS},
+            {"mali", MemtrackType::GRAPHICS},
+            {"panfrost", MemtrackType::GRAPHICS},
+    };
+}
+
+DmabufAccounting::DmabufAccounting(Options options) : mOptions(std::move(options)) {}
+
+bool DmabufAccounting::getUsage(int pid, std::map<MemtrackType, Usage>* usage) {
+    std::lock_guard<std::mutex> lock(mLock);
+    usage->clear();
+    std::unordered_map<uint64_t, Buffer> buffers;
+    if (!collectBuffers(mOptions.procRoot + "/" + std::to_string(pid), &buffers)) {
+        return false;
+    }
+    refreshSharingLocked();
+
+    for (const auto& [inode, buffer] : buffers) {
+        Usage& typeUsage = (*usage)[classify(buffer.exporter)];
+        auto users = mUsers.find(inode);
+        // Buffers allocated since the last refresh are only known to be used by this process.
+        const uint32_t userCount = users == mUsers.end() ? 1 : users->second;
+        const auto size = static_cast<int64_t>(buffer.size);
+        if (userCount > 1) {
+            typeUsage.sharedBytes += size;
+            typeUsage.sharedPssBytes += size / userCount;
+        } else {
+            typeUsage.privateBytes += size;
+        }
+    }
+    return true;
+}
+
+size_t DmabufAccounting::cachedBufferCount() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mCache.size();
+}
+
+bool DmabufAccounting::collectBuffers(const std::string& pidDir,
+                                      std::unordered_map<uint64_t, Buffer>* buffers) {
+    const std::string fdDir = pidDir + "/fd";
+    const bool listed = forEachEntry(fdDir, [&](const char* fd) {
+        char target[PATH_MAX];
+        ssize_t length = readlink((fdDir + "/" + fd).c_str(), target, sizeof(target) - 1);
+        if (length < 0 || !isDmabufPath(std::string(target, length))) {
+            return;
+        }
+        Buffer buffer;
+        // Known buffers only take a stat() of the file to identify.
+        struct stat st;
+        const bool statted = stat((fdDir + "/" + fd).c_str(), &st) == 0;
+        if (statted && findCached(st.st_ino, &buffer)) {
+            buffers->emplace(st.st_ino, std::move(buffer));
+            return;
+        }
+        // The fdinfo of a dma-buf holds its inode, size and exporter. Older kernels leave out the
+        // inode, which is then the one of the file.
+        auto fields = readFdinfo(pidDir + "/fdinfo/" + fd);
+        uint64_t inode;
+        if (!ParseUint(fields["ino"], &inode)) {
+            if (!statted) {
+                return;
+            }
+            inode = st.st_ino;
+        }
+        if (buffers->count(inode) || !ParseUint(fields["size"], &buffer.size)) {
+            return;
+        }
+        buffer.exporter = fields["exp_name"];
+        remember(inode, buffer);
+        buffers->emplace(inode, std::move(buffer));
+    });
+    if (!listed) {
+        // The process is gone, or its buffers can't be read.
+        return false;
+    }
+    collectMappedBuffers(pidDir, buffers);
+    return true;
+}
+
+void DmabufAccounting::collectMappedBuffers(const std::string& pidDir,
+                                            std::unordered_map<uint64_t, Buffer>* buffers) {
+    std::ifstream maps(pidDir + "/maps");
+    // Buffers whose size is unknown are charged the part the process maps.
+    std::unordered_map<uint64_t, Buffer> unsized;
+    std::string line;
+    while (std::getline(maps, line)) {
+        // <start>-<end> <perms> <offset> <dev> <inode> <path>
+        std::istringstream fields(line);
+        std::string range, perms, offset, dev, path;
+        uint64_t inode;
+        if (!(fields >> range >> perms >> offset >> dev >> inode) || buffers->count(inode)) {
+            continue;
+        }
+        std::getline(fields, path);
+        if (!isDmabufPath(Trim(path))) {
+            continue;
+        }
+
+        Buffer buffer;
+        if (findCached(inode, &buffer) || readBufferStats(inode, &buffer)) {
+            buffers->emplace(inode, std::move(buffer));
+            continue;
+        }
+        uint64_t start, end;
+        if (sscanf(range.c_str(), "%" SCNx64 "-%" SCNx64, &start, &end) == 2 && end > start) {
+            unsized[inode].size += end - start;
+        }
+    }
+    for (auto& [inode, buffer] : unsized) {
+        buffers->emplace(inode, std::move(buffer));
+    }
+}
+
+bool DmabufAccounting::findCached(uint64_t inode, Buffer* buffer) {
+    auto it = mCache.find(inode);
+    if (it == mCache.end()) {
+        return false;
+    }
+    it->second.lastSeen = mScan;
+    *buffer = it->second.buffer;
+    return true;
+}
+
+bool DmabufAccounting::readBufferStats(uint64_t inode, Buffer* buffer) {
+    const std::string dir = mOptions.sysfsBuffersRoot + "/" + std::to_string(inode);
+    std::string size;
+    std::string exporter;
+    if (!ReadFileToString(dir + "/size", &size) || !ParseUint(Trim(size), &buffer->size) ||
+        !ReadFileToString(dir + "/exporter_name", &exporter)) {
+        return false;
+    }
+    buffer->exporter = Trim(exporter);
+    remember(inode, *buffer);
+    return true;
+}
+
+void DmabufAccounting::remember(uint64_t inode, const Buffer& buffer) {
+    mCache[inode] = {.buffer = buffer, .lastSeen = mScan};
+}
+
+void DmabufAccounting::refreshSharingLocked() {
+    const auto now = std::chrono::steady_clock::now();
+    if (mRefreshed && now - mLastRefresh < mOptions.sharingRefreshInterval) {
+        return;
+    }
+    mRefreshed = true;
+    mLastRefresh = now;
+
+    mScan++;
+    mUsers.clear();
+    forEachEntry(mOptions.procRoot, [&](const char* name) {
+        int pid;
+        if (!::android::base::ParseInt(name, &pid)) {
+            return;
+        }
+        std::unordered_map<uint64_t, Buffer> buffers;
+        if (collectBuffers(mOptions.procRoot + "/" + name, &buffers)) {
+            for (const auto& [inode, buffer] : buffers) {
+                mUsers[inode]++;
+            }
+        }
+    });
+    trimCacheLocked();
+}
+
+void DmabufAccounting::trimCacheLocked() {
+    if (mCache.size() <= mOptions.maxCachedBuffers) {
+        return;
+    }
+    // Buffers no process was seen using by this full scan have most likely been freed. Polls of
+    // single processes in between don't trim, as they don't see the buffers of the others.
+    for (auto it = mCache.begin(); it != mCache.end();) {
+        it = it->second.lastSeen == mScan ? std::next(it) : mCache.erase(it);
+    }
+}
+
+MemtrackType DmabufAccounting::classify(const std::string& exporter) const {
+    for (const auto& [prefix, type] : mOptions.exporterTypes) {
+        if (StartsWith(exporter, prefix)) {
+            return type;
+        }
+    }
+    return MemtrackType::OTHER;
+}
+
+}  // namespace memtrack
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/memtrack/MemtrackType.h>
+#include <android-base/thread_annotations.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace memtrack {
+
+/**
+ * Attributes dma-buf memory to processes. A process uses the buffers it holds file descriptors
+ * of, as listed in /proc/<pid>/fd and fdinfo, and the buffers it maps, as listed in
+ * /proc/<pid>/maps. Buffers only mapped are sized through the dma-buf sysfs statistics.
+ *
+ * A buffer used by several processes is shared, and each of them is charged an equal part of it
+ * as proportional size. Which processes use a buffer is learned by scanning all processes, at
+ * most once per refresh interval, so that polling every process costs about one full scan.
+ */
+class DmabufAccounting {
+  public:
+    struct Options {
+        std::string procRoot = "/proc";
+        // Sysfs statistics of dma-buf buffers, one directory per inode.
+        std::string sysfsBuffersRoot = "/sys/kernel/dmabuf/buffers";
+        std::chrono::milliseconds sharingRefreshInterval = std::chrono::seconds(1);
+        size_t maxCachedBuffers = 4096;
+        // Buffers are classified by the first exporter name prefix they match, and are OTHER
+        // memory if none matches.
+        std::vector<std::pair<std::string, MemtrackType>> exporterTypes = defaultExporterTypes();
+    };
+
+    struct Usage {
+        int64_t privateBytes = 0;
+        int64_t sharedBytes = 0;
+        // The proportional size of shared buffers.
+        int64_t sharedPssBytes = 0;
+    };
+
+    static std::vector<std::pair<std::string, MemtrackType>> defaultExporterTypes();
+
+    explicit DmabufAccounting(Options options);
+
+    // Returns false if the process doesn't exist or its buffers can't be read.
+    bool getUsage(int pid, std::map<MemtrackType, Usage>* usage);
+
+    size_t cachedBufferCount() const;
+
+  private:
+    struct Buffer {
+        uint64_t size = 0;
+        std::string exporter;
+    };
+
+    struct CachedBuffer {
+        Buffer buffer;
+        uint64_t lastSeen = 0;
+    };
+
+    // The buffers a process uses, by inode. Returns false if the process can't be read.
+    bool collectBuffers(const std::string& pidDir, std::unordered_map<uint64_t, Buffer>* buffers)
+            REQUIRES(mLock);
+    void collectMappedBuffers(const std::string& pidDir,
+                              std::unordered_map<uint64_t, Buffer>* buffers) REQUIRES(mLock);
+    bool findCached(uint64_t inode, Buffer* buffer) REQUIRES(mLock);
+    // Reads the size and exporter of a buffer from sysfs, and caches them.
+    bool readBufferStats(uint64_t inode, Buffer* buffer) REQUIRES(mLock);
+    void remember(uint64_t inode, const Buffer& buffer) REQUIRES(mLock);
+    void refreshSharingLocked() REQUIRES(mLock);
+    void trimCacheLocked() REQUIRES(mLock);
+    MemtrackType classify(const std::string& exporter) const;
+
+    const Options mOptions;
+
+    mutable std::mutex mLock;
+    std::unordered_map<uint64_t, CachedBuffer> mCache GUARDED_BY(mLock);
+    // Bumped by every full scan of all processes, to tell the buffers still in use from the
+    // freed ones.
+    uint64_t mScan GUARDED_BY(mLock) = 0;
+    // How many processes use a buffer, by inode, as of the last refresh.
+    std::unordered_map<uint64_t, uint32_t> mUsers GUARDED_BY(mLock);
+    std::chrono::steady_clock::time_point mLastRefresh GUARDED_BY(mLock);
+    bool mRefreshed GUARDED_BY(mLock) = false;
+};
+
+}  // namespace memtrack
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
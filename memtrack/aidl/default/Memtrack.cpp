@@ -31,6 +31,31 @@ ndk::ScopedAStatus Memtrack::getMemory(int pid, MemtrackType type,
         return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_UNSUPPORTED_OPERATION));
     }
     _aidl_return->clear();
+    // Only dma-buf memory is tracked, which isn't GPU-private, so there is no global total.
+    if (pid == 0) {
+        return ndk::ScopedAStatus::ok();
+    }
+
+    std::map<MemtrackType, DmabufAccounting::Usage> usage;
+    if (!mDmabufs.getUsage(pid, &usage)) {
+        return ndk::ScopedAStatus::ok();
+    }
+    auto it = usage.find(type);
+    if (it == usage.end()) {
+        // The process uses no buffers of this type.
+        return ndk::ScopedAStatus::ok();
+    }
+    const DmabufAccounting::Usage& typeUsage = it->second;
+    // dma-buf memory is never accounted in smaps.
+    _aidl_return->push_back(
+            {.flags = MemtrackRecord::FLAG_SMAPS_UNACCOUNTED | MemtrackRecord::FLAG_PRIVATE,
+             .sizeInBytes = typeUsage.privateBytes});
+    _aidl_return->push_back(
+            {.flags = MemtrackRecord::FLAG_SMAPS_UNACCOUNTED | MemtrackRecord::FLAG_SHARED,
+             .sizeInBytes = typeUsage.sharedBytes});
+    _aidl_return->push_back(
+            {.flags = MemtrackRecord::FLAG_SMAPS_UNACCOUNTED | MemtrackRecord::FLAG_SHARED_PSS,
+             .sizeInBytes = typeUsage.sharedPssBytes});
     return ndk::ScopedAStatus::ok();
 }
 
@@ -21,16 +21,24 @@
 #include <aidl/android/hardware/memtrack/MemtrackRecord.h>
 #include <aidl/android/hardware/memtrack/MemtrackType.h>
 
+#include "DmabufAccounting.h"
+
 namespace aidl {
 namespace android {
 namespace hardware {
 namespace memtrack {
 
 class Memtrack : public BnMemtrack {
+  public:
+    explicit Memtrack(DmabufAccounting::Options options = {}) : mDmabufs(std::move(options)) {}
+
     ndk::ScopedAStatus getMemory(int pid, MemtrackType type,
                                  std::vector<MemtrackRecord>* _aidl_return) override;
 
     ndk::ScopedAStatus getGpuDeviceInfo(std::vector<DeviceInfo>* _aidl_return) override;
+
+  private:
+    DmabufAccounting mDmabufs;
 };
 
 }  // namespace memtrack
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DmabufAccounting.h"
+#include "Memtrack.h"
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <filesystem>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace memtrack {
+namespace {
+
+using ::android::base::WriteStringToFile;
+
+/**
+ * A synthetic procfs and dma-buf sysfs:
+ *  - Process 100 holds a system heap buffer (1001) and a camera buffer (1002), which it also
+ *    maps, and maps a video buffer (1003) it holds no descriptor of.
+ *  - Process 200 shares the camera buffer, and maps a buffer (1004) missing from sysfs in two
+ *    parts.
+ */
+class DmabufAccountingTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mProc = std::string(mRoot.path) + "/proc";
+        mSysfs = std::string(mRoot.path) + "/buffers";
+        ASSERT_EQ(mkdir(mProc.c_str(), 0700), 0);
+        ASSERT_EQ(mkdir(mSysfs.c_str(), 0700), 0);
+        ASSERT_EQ(mkdir((mProc + "/self").c_str(), 0700), 0);
+
+        addProcess(100);
+        addFd(100, 3, 1001, 4096, "system");
+        addLink(100, 4, "/dev/null");
+        addFd(100, 5, 1002, 8192, "camera");
+        addBufferStats(1003, 16384, "video");
+        addMaps(100,
+                "7000000000-7000001000 rw-s 00000000 00:0a 1001    /dmabuf:\n"
+                "7000001000-7000003000 rw-s 00000000 00:0a 1002    /dmabuf:preview\n"
+                "7000003000-7000004000 r--s 00000000 00:0a 1003    anon_inode:dmabuf\n"
+                "7100000000-7100001000 r-xp 00000000 fd:00 42      /system/lib64/libc.so\n");
+
+        addProcess(200);
+        addFd(200, 7, 1002, 8192, "camera");
+        addMaps(200,
+                "7000000000-7000001000 rw-s 00000000 00:0a 1004    /dmabuf:\n"
+                "7000002000-7000003000 rw-s 00001000 00:0a 1004    /dmabuf:\n");
+    }
+
+    DmabufAccounting::Options options() {
+        DmabufAccounting::Options options;
+        options.procRoot = mProc;
+        options.sysfsBuffersRoot = mSysfs;
+        options.sharingRefreshInterval = std::chrono::milliseconds(0);
+        return options;
+    }
+
+    void addProcess(int pid) {
+        const std::string dir = mProc + "/" + std::to_string(pid);
+        ASSERT_EQ(mkdir(dir.c_str(), 0700), 0);
+        ASSERT_EQ(mkdir((dir + "/fd").c_str(), 0700), 0);
+        ASSERT_EQ(mkdir((dir + "/fdinfo").c_str(), 0700), 0);
+        addMaps(pid, "");
+    }
+
+    void addLink(int pid, int fd, const std::string& target) {
+        const std::string path = mProc + "/" + std::to_string(pid) + "/fd/" + std::to_string(fd);
+        ASSERT_EQ(symlink(target.c_str(), path.c_str()), 0);
+    }
+
+    void addFd(int pid, int fd, uint64_t inode, uint64_t size, const std::string& exporter) {
+        addLink(pid, fd, "/dmabuf:");
+        const std::string fdinfo = "pos:\t0\nflags:\t02000002\nmnt_id:\t9\nino:\t" +
+                                   std::to_string(inode) + "\nsize:\t" + std::to_string(size) +
+                                   "\ncount:\t2\nexp_name:\t" + exporter + "\nname:\t\n";
+        ASSERT_TRUE(WriteStringToFile(
+                fdinfo, mProc + "/" + std::to_string(pid) + "/fdinfo/" + std::to_string(fd)));
+    }
+
+    void addMaps(int pid, const std::string& maps) {
+        ASSERT_TRUE(WriteStringToFile(maps, mProc + "/" + std::to_string(pid) + "/maps"));
+    }
+
+    void addBufferStats(uint64_t inode, uint64_t size, const std::string& exporter) {
+        const std::string dir = mSysfs + "/" + std::to_string(inode);
+        ASSERT_EQ(mkdir(dir.c_str(), 0700), 0);
+        ASSERT_TRUE(WriteStringToFile(std::to_string(size) + "\n", dir + "/size"));
+        ASSERT_TRUE(WriteStringToFile(exporter + "\n", dir + "/exporter_name"));
+    }
+
+    TemporaryDir mRoot;
+    std::string mProc;
+    std::string mSysfs;
+};
+
+TEST_F(DmabufAccountingTest, AttributesBuffersByExporter) {
+    DmabufAccounting accounting(options());
+    std::map<MemtrackType, DmabufAccounting::Usage> usage;
+    ASSERT_TRUE(accounting.getUsage(100, &usage));
+
+    // A buffer both held and mapped counts once.
+    EXPECT_EQ(usage[MemtrackType::GRAPHICS].privateBytes, 4096);
+    EXPECT_EQ(usage[MemtrackType::GRAPHICS].sharedBytes, 0);
+    EXPECT_EQ(usage[MemtrackType::CAMERA].privateBytes, 0);
+    EXPECT_EQ(usage[MemtrackType::CAMERA].sharedBytes, 8192);
+    EXPECT_EQ(usage[MemtrackType::CAMERA].sharedPssBytes, 4096);
+    EXPECT_EQ(usage[MemtrackType::MULTIMEDIA].privateBytes, 16384);
+    EXPECT_EQ(usage[MemtrackType::OTHER].privateBytes, 0);
+}
+
+TEST_F(DmabufAccountingTest, ChargesMappedPartsOfUnknownBuffers) {
+    DmabufAccounting accounting(options());
+    std::map<MemtrackType, DmabufAccounting::Usage> usage;
+    ASSERT_TRUE(accounting.getUsage(200, &usage));
+    EXPECT_EQ(usage[MemtrackType::OTHER].privateBytes, 8192);
+    EXPECT_EQ(usage[MemtrackType::CAMERA].sharedBytes, 8192);
+}
+
+TEST_F(DmabufAccountingTest, FailsForMissingProcesses) {
+    DmabufAccounting accounting(options());
+    std::map<MemtrackType, DmabufAccounting::Usage> usage;
+    EXPECT_FALSE(accounting.getUsage(300, &usage));
+    EXPECT_TRUE(usage.empty());
+}
+
+TEST_F(DmabufAccountingTest, IdentifiesBuffersByTheirFileWithoutInodeInFdinfo) {
+    // The buffer is a file standing in for the dma-buf, so that it can be stat()ed.
+    addProcess(300);
+    const std::string fdinfo = "size:\t4096\ncount:\t2\nexp_name:\tsystem\n";
+    ASSERT_TRUE(WriteStringToFile("", mProc + "/300/fd/anon_inode:dmabuf"));
+    for (int fd : {3, 4}) {
+        addLink(300, fd, "anon_inode:dmabuf");
+        ASSERT_TRUE(WriteStringToFile(fdinfo, mProc + "/300/fdinfo/" + std::to_string(fd)));
+    }
+
+    DmabufAccounting accounting(options());
+    std::map<MemtrackType, DmabufAccounting::Usage> usage;
+    ASSERT_TRUE(accounting.getUsage(300, &usage));
+    // Held twice, but counted once.
+    EXPECT_EQ(usage[MemtrackType::GRAPHICS].privateBytes, 4096);
+}
+
+TEST_F(DmabufAccountingTest, CachesBufferSizes) {
+    DmabufAccounting accounting(options());
+    std::map<MemtrackType, DmabufAccounting::Usage> usage;
+    ASSERT_TRUE(accounting.getUsage(100, &usage));
+    EXPECT_EQ(accounting.cachedBufferCount(), 3u);
+
+    // Sysfs isn't read again for known buffers.
+    std::filesystem::remove_all(mSysfs + "/1003");
+    ASSERT_TRUE(accounting.getUsage(100, &usage));
+    EXPECT_EQ(usage[MemtrackType::MULTIMEDIA].privateBytes, 16384);
+}
+
+TEST_F(DmabufAccountingTest, DropsFreedBuffersFromFullCache) {
+    DmabufAccounting::Options limited = options();
+    limited.maxCachedBuffers = 2;
+    DmabufAccounting accounting(limited);
+    std::map<MemtrackType, DmabufAccounting::Usage> usage;
+    // Buffers in use are kept even beyond the limit.
+    ASSERT_TRUE(accounting.getUsage(100, &usage));
+    EXPECT_EQ(accounting.cachedBufferCount(), 3u);
+
+    std::filesystem::remove_all(mProc + "/100");
+    ASSERT_TRUE(accounting.getUsage(200, &usage));
+}
+
+TEST_F(DmabufAccountingTest, KeepsBuffersOfOtherProcessesBetweenRefreshes) {
+    DmabufAccounting::Options limited = options();
+    limited.maxCachedBuffers = 2;
+    limited.sharingRefreshInterval = std::chrono::hours(1);
+    DmabufAccounting accounting(limited);
+    std::map<MemtrackType, DmabufAccounting::Usage> usage;
+    ASSERT_TRUE(accounting.getUsage(100, &usage));
+    EXPECT_EQ(accounting.cachedBufferCount(), 3u);
+
+    // Polling another process sees none of the buffers of process 100, which stay cached.
+    ASSERT_TRUE(accounting.getUsage(200, &usage));
+    EXPECT_EQ(accounting.cachedBufferCount(), 3u);
+    std::filesystem::remove_all(mSysfs + "/1003");
+    ASSERT_TRUE(accounting.getUsage(100, &usage));
+    EXPECT_EQ(usage[MemtrackType::MULTIMEDIA].privateBytes, 16384);
+}
+
+TEST_F(DmabufAccountingTest, RefreshesSharingPeriodically) {
+    DmabufAccounting::Options slow = options();
+    slow.sharingRefreshInterval = std::chrono::hours(1);
+    DmabufAccounting accounting(slow);
+    std::map<MemtrackType, DmabufAccounting::Usage> usage;
+    ASSERT_TRUE(accounting.getUsage(100, &usage));
+    EXPECT_EQ(usage[MemtrackType::GRAPHICS].privateBytes, 4096);
+
+    // Another process starts using the buffer, which is only noticed by the next refresh.
+    addProcess(300);
+    addFd(300, 3, 1001, 4096, "system");
+    ASSERT_TRUE(accounting.getUsage(100, &usage));
+    EXPECT_EQ(usage[MemtrackType::GRAPHICS].privateBytes, 4096);
+
+    DmabufAccounting fresh(options());
+    ASSERT_TRUE(fresh.getUsage(100, &usage));
+    EXPECT_EQ(usage[MemtrackType::GRAPHICS].privateBytes, 0);
+    EXPECT_EQ(usage[MemtrackType::GRAPHICS].sharedBytes, 4096);
+    EXPECT_EQ(usage[MemtrackType::GRAPHICS].sharedPssBytes, 2048);
+}
+
+TEST_F(DmabufAccountingTest, ReportsUnaccountedRecords) {
+    auto memtrack = ndk::SharedRefBase::make<Memtrack>(options());
+    std::vector<MemtrackRecord> records;
+    ASSERT_TRUE(memtrack->getMemory(100, MemtrackType::CAMERA, &records).isOk());
+    ASSERT_EQ(records.size(), 3u);
+    for (const auto& record : records) {
+        EXPECT_TRUE(record.flags & MemtrackRecord::FLAG_SMAPS_UNACCOUNTED);
+        if (record.flags & MemtrackRecord::FLAG_PRIVATE) {
+            EXPECT_EQ(record.sizeInBytes, 0);
+        } else if (record.flags & MemtrackRecord::FLAG_SHARED) {
+            EXPECT_EQ(record.sizeInBytes, 8192);
+        } else {
+            EXPECT_TRUE(record.flags & MemtrackRecord::FLAG_SHARED_PSS);
+            EXPECT_EQ(record.sizeInBytes, 4096);
+        }
+    }
+
+    // Process 200 uses no graphics buffers.
+    ASSERT_TRUE(memtrack->getMemory(200, MemtrackType::GRAPHICS, &records).isOk());
+    EXPECT_TRUE(records.empty());
+    ASSERT_TRUE(memtrack->getMemory(0, MemtrackType::GL, &records).isOk());
+    EXPECT_TRUE(records.empty());
+    ASSERT_TRUE(memtrack->getMemory(300, MemtrackType::GL, &records).isOk());
+    EXPECT_TRUE(records.empty());
+    EXPECT_FALSE(memtrack->getMemory(-1, MemtrackType::GL, &records).isOk());
+}
+
+}  // namespace
+}  // namespace memtrack
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -17,14 +17,13 @@
 #ifndef ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RESILIENT_BUFFER_H
 #define ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RESILIENT_BUFFER_H
 
-#include <android-base/thread_annotations.h>
 #include <nnapi/IBuffer.h>
 #include <nnapi/Result.h>
 #include <nnapi/Types.h>
+#include <nnapi/hal/ResilientObject.h>
 
 #include <functional>
 #include <memory>
-#include <mutex>
 #include <utility>
 #include <vector>
 
@@ -43,6 +42,7 @@ class ResilientBuffer final : public nn::IBuffer {
 
     nn::SharedBuffer getBuffer() const;
     nn::GeneralResult<nn::SharedBuffer> recover(const nn::IBuffer* failingBuffer) const;
+    RecoveryMetrics getRecoveryMetrics() const;
 
     nn::Request::MemoryDomainToken getToken() const override;
 
@@ -53,8 +53,7 @@ class ResilientBuffer final : public nn::IBuffer {
 
   private:
     const Factory kMakeBuffer;
-    mutable std::mutex mMutex;
-    mutable nn::SharedBuffer mBuffer GUARDED_BY(mMutex);
+    const ResilientObject<nn::IBuffer> mBuffer;
 };
 
 }  // namespace android::hardware::neuralnetworks::utils
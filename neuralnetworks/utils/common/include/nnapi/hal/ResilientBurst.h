@@ -17,14 +17,13 @@
 #ifndef ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RESILIENT_BURST_H
 #define ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RESILIENT_BURST_H
 
-#include <android-base/thread_annotations.h>
 #include <nnapi/IBurst.h>
 #include <nnapi/Result.h>
 #include <nnapi/Types.h>
+#include <nnapi/hal/ResilientObject.h>
 
 #include <functional>
 #include <memory>
-#include <mutex>
 #include <optional>
 #include <utility>
 
@@ -43,6 +42,7 @@ class ResilientBurst final : public nn::IBurst,
 
     nn::SharedBurst getBurst() const;
     nn::GeneralResult<nn::SharedBurst> recover(const nn::IBurst* failingBurst) const;
+    RecoveryMetrics getRecoveryMetrics() const;
 
     OptionalCacheHold cacheMemory(const nn::SharedMemory& memory) const override;
 
@@ -59,7 +59,7 @@ class ResilientBurst final : public nn::IBurst,
             const std::vector<nn::ExtensionNameAndPrefix>& extensionNameToPrefix) const override;
 
   private:
-    bool isValidInternal() const EXCLUDES(mMutex);
+    bool isValidInternal() const;
     nn::GeneralResult<nn::SharedExecution> createReusableExecutionInternal(
             const nn::Request& request, nn::MeasureTiming measure,
             const nn::OptionalDuration& loopTimeoutDuration,
@@ -67,8 +67,7 @@ class ResilientBurst final : public nn::IBurst,
             const std::vector<nn::ExtensionNameAndPrefix>& extensionNameToPrefix) const;
 
     const Factory kMakeBurst;
-    mutable std::mutex mMutex;
-    mutable nn::SharedBurst mBurst GUARDED_BY(mMutex);
+    const ResilientObject<nn::IBurst> mBurst;
 };
 
 }  // namespace android::hardware::neuralnetworks::utils
@@ -17,16 +17,16 @@
 #ifndef ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RESILIENT_DEVICE_H
 #define ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RESILIENT_DEVICE_H
 
-#include <android-base/thread_annotations.h>
 #include <nnapi/IBuffer.h>
 #include <nnapi/IDevice.h>
 #include <nnapi/IPreparedModel.h>
 #include <nnapi/Result.h>
 #include <nnapi/Types.h>
+#include <nnapi/hal/ResilientObject.h>
 
+#include <atomic>
 #include <functional>
 #include <memory>
-#include <mutex>
 #include <string>
 #include <vector>
 
@@ -45,9 +45,10 @@ class ResilientDevice final : public nn::IDevice,
                              std::string versionString, std::vector<nn::Extension> extensions,
                              nn::Capabilities capabilities, nn::SharedDevice device);
 
-    nn::SharedDevice getDevice() const EXCLUDES(mMutex);
+    nn::SharedDevice getDevice() const;
     nn::GeneralResult<nn::SharedDevice> recover(const nn::IDevice* failingDevice,
-                                                bool blocking) const EXCLUDES(mMutex);
+                                                bool blocking) const;
+    RecoveryMetrics getRecoveryMetrics() const;
 
     const std::string& getName() const override;
     const std::string& getVersionString() const override;
@@ -80,7 +81,7 @@ class ResilientDevice final : public nn::IDevice,
             const std::vector<nn::BufferRole>& outputRoles) const override;
 
   private:
-    bool isValidInternal() const EXCLUDES(mMutex);
+    bool isValidInternal() const;
     nn::GeneralResult<nn::SharedPreparedModel> prepareModelInternal(
             const nn::Model& model, nn::ExecutionPreference preference, nn::Priority priority,
             nn::OptionalTimePoint deadline, const std::vector<nn::SharedHandle>& modelCache,
@@ -100,9 +101,8 @@ class ResilientDevice final : public nn::IDevice,
     const std::string kVersionString;
     const std::vector<nn::Extension> kExtensions;
     const nn::Capabilities kCapabilities;
-    mutable std::mutex mMutex;
-    mutable nn::SharedDevice mDevice GUARDED_BY(mMutex);
-    mutable bool mIsValid GUARDED_BY(mMutex) = true;
+    const ResilientObject<nn::IDevice> mDevice;
+    mutable std::atomic<bool> mIsValid = true;
 };
 
 }  // namespace android::hardware::neuralnetworks::utils
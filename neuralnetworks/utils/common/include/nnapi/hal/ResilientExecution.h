@@ -17,14 +17,13 @@
 #ifndef ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RESILIENT_EXECUTION_H
 #define ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RESILIENT_EXECUTION_H
 
-#include <android-base/thread_annotations.h>
 #include <nnapi/IExecution.h>
 #include <nnapi/Result.h>
 #include <nnapi/Types.h>
+#include <nnapi/hal/ResilientObject.h>
 
 #include <functional>
 #include <memory>
-#include <mutex>
 #include <utility>
 #include <vector>
 
@@ -45,6 +44,7 @@ class ResilientExecution final : public nn::IExecution,
 
     nn::SharedExecution getExecution() const;
     nn::GeneralResult<nn::SharedExecution> recover(const nn::IExecution* failingExecution) const;
+    RecoveryMetrics getRecoveryMetrics() const;
 
     nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> compute(
             const nn::OptionalTimePoint& deadline) const override;
@@ -54,11 +54,10 @@ class ResilientExecution final : public nn::IExecution,
             const nn::OptionalDuration& timeoutDurationAfterFence) const override;
 
   private:
-    bool isValidInternal() const EXCLUDES(mMutex);
+    bool isValidInternal() const;
 
     const Factory kMakeExecution;
-    mutable std::mutex mMutex;
-    mutable nn::SharedExecution mExecution GUARDED_BY(mMutex);
+    const ResilientObject<nn::IExecution> mExecution;
 };
 
 }  // namespace android::hardware::neuralnetworks::utils
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RESILIENT_OBJECT_H
+#define ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RESILIENT_OBJECT_H
+
+#include <android-base/logging.h>
+#include <android-base/thread_annotations.h>
+#include <nnapi/Result.h>
+#include <nnapi/Types.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace android::hardware::neuralnetworks::utils {
+
+struct RecoveryMetrics {
+    // Number of times the factory was run to recover the object.
+    uint64_t attempts = 0;
+    uint64_t successes = 0;
+    uint64_t failures = 0;
+    // Number of recover() calls served by a recovery made by another caller.
+    uint64_t joined = 0;
+    // Number of recover() calls rejected without running the factory, because a previous attempt
+    // failed less than the current backoff period ago.
+    uint64_t throttled = 0;
+};
+
+/**
+ * Holds the current object behind a Resilient* wrapper and recovers it when it dies.
+ *
+ * The current object is read with an atomic snapshot, so the hot path never blocks on a recovery
+ * in progress. Recoveries are single-flight: concurrent callers observing the same dead object
+ * share the result of one factory run. After a failed recovery, further attempts are rejected with
+ * the last error until an exponentially growing backoff period has elapsed.
+ */
+template <typename Type>
+class ResilientObject final {
+  public:
+    using SharedObject = std::shared_ptr<const Type>;
+    using Duration = std::chrono::steady_clock::duration;
+    using Clock = std::function<std::chrono::steady_clock::time_point()>;
+
+    static constexpr Duration kDefaultInitialBackoff = std::chrono::milliseconds(10);
+    static constexpr Duration kDefaultMaxBackoff = std::chrono::seconds(1);
+
+    explicit ResilientObject(SharedObject object, Duration initialBackoff = kDefaultInitialBackoff,
+                             Duration maxBackoff = kDefaultMaxBackoff,
+                             Clock clock = std::chrono::steady_clock::now)
+        : kInitialBackoff(initialBackoff),
+          kMaxBackoff(maxBackoff),
+          kClock(std::move(clock)),
+          mObject(std::move(object)) {
+        CHECK(mObject != nullptr);
+        CHECK(kInitialBackoff <= kMaxBackoff);
+    }
+
+    SharedObject get() const { return std::atomic_load(&mObject); }
+
+    /**
+     * Replaces failingObject with a new object from makeObject, unless it was already replaced.
+     *
+     * makeObject is called with the current object while recovery is serialized, and must return
+     * nn::GeneralResult<SharedObject>.
+     */
+    template <typename Factory>
+    nn::GeneralResult<SharedObject> recover(const Type* failingObject,
+                                            const Factory& makeObject) const EXCLUDES(mMutex) {
+        std::lock_guard guard(mMutex);
+
+        // Another caller updated the failing object, possibly while this one was waiting.
+        auto current = get();
+        if (current.get() != failingObject) {
+            mMetrics.joined++;
+            return current;
+        }
+
+        const auto now = kClock();
+        if (mLastError.has_value() && now < mNextAttempt) {
+            mMetrics.throttled++;
+            return nn::error(mLastError->code)
+                   << mLastError->message << " (recovery throttled after "
+                   << mConsecutiveFailures << " consecutive failures)";
+        }
+
+        mMetrics.attempts++;
+        auto result = makeObject(current);
+        if (!result.has_value()) {
+            mMetrics.failures++;
+            mConsecutiveFailures++;
+            mNextAttempt = now + backoffLocked();
+            mLastError = result.error();
+            return result;
+        }
+
+        mMetrics.successes++;
+        mConsecutiveFailures = 0;
+        mLastError.reset();
+        std::atomic_store(&mObject, result.value());
+        return result;
+    }
+
+    RecoveryMetrics getMetrics() const EXCLUDES(mMutex) {
+        std::lock_guard guard(mMutex);
+        return mMetrics;
+    }
+
+  private:
+    Duration backoffLocked() const REQUIRES(mMutex) {
+        const auto shift = std::min<uint32_t>(mConsecutiveFailures - 1, 62);
+        const int64_t factor = int64_t{1} << shift;
+        // Checked by dividing, as the product may overflow.
+        if (kInitialBackoff > kMaxBackoff / factor) {
+            return kMaxBackoff;
+        }
+        return kInitialBackoff * factor;
+    }
+
+    const Duration kInitialBackoff;
+    const Duration kMaxBackoff;
+    const Clock kClock;
+
+    // Only accessed through std::atomic_load and std::atomic_store.
+    mutable SharedObject mObject;
+
+    mutable std::mutex mMutex;
+    mutable uint32_t mConsecutiveFailures GUARDED_BY(mMutex) = 0;
+    mutable std::chrono::steady_clock::time_point mNextAttempt GUARDED_BY(mMutex);
+    mutable std::optional<nn::GeneralError> mLastError GUARDED_BY(mMutex);
+    mutable RecoveryMetrics mMetrics GUARDED_BY(mMutex);
+};
+
+}  // namespace android::hardware::neuralnetworks::utils
+
+#endif  // ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RESILIENT_OBJECT_H
@@ -17,14 +17,13 @@
 #ifndef ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RESILIENT_PREPARED_MODEL_H
 #define ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RESILIENT_PREPARED_MODEL_H
 
-#include <android-base/thread_annotations.h>
 #include <nnapi/IPreparedModel.h>
 #include <nnapi/Result.h>
 #include <nnapi/Types.h>
+#include <nnapi/hal/ResilientObject.h>
 
 #include <functional>
 #include <memory>
-#include <mutex>
 #include <utility>
 #include <vector>
 
@@ -46,6 +45,7 @@ class ResilientPreparedModel final : public nn::IPreparedModel,
     nn::SharedPreparedModel getPreparedModel() const;
     nn::GeneralResult<nn::SharedPreparedModel> recover(
             const nn::IPreparedModel* failingPreparedModel) const;
+    RecoveryMetrics getRecoveryMetrics() const;
 
     nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> execute(
             const nn::Request& request, nn::MeasureTiming measure,
@@ -72,7 +72,7 @@ class ResilientPreparedModel final : public nn::IPreparedModel,
     std::any getUnderlyingResource() const override;
 
   private:
-    bool isValidInternal() const EXCLUDES(mMutex);
+    bool isValidInternal() const;
     nn::GeneralResult<nn::SharedExecution> createReusableExecutionInternal(
             const nn::Request& request, nn::MeasureTiming measure,
             const nn::OptionalDuration& loopTimeoutDuration,
@@ -81,8 +81,7 @@ class ResilientPreparedModel final : public nn::IPreparedModel,
     nn::GeneralResult<nn::SharedBurst> configureExecutionBurstInternal() const;
 
     const Factory kMakePreparedModel;
-    mutable std::mutex mMutex;
-    mutable nn::SharedPreparedModel mPreparedModel GUARDED_BY(mMutex);
+    const ResilientObject<nn::IPreparedModel> mPreparedModel;
 };
 
 }  // namespace android::hardware::neuralnetworks::utils
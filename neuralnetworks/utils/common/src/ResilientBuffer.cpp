@@ -17,7 +17,6 @@
 #include "ResilientBuffer.h"
 
 #include <android-base/logging.h>
-#include <android-base/thread_annotations.h>
 #include <nnapi/IBuffer.h>
 #include <nnapi/Result.h>
 #include <nnapi/TypeUtils.h>
@@ -25,7 +24,6 @@
 
 #include <functional>
 #include <memory>
-#include <mutex>
 #include <utility>
 #include <vector>
 
@@ -75,24 +73,19 @@ ResilientBuffer::ResilientBuffer(PrivateConstructorTag /*tag*/, Factory makeBuff
                                  nn::SharedBuffer buffer)
     : kMakeBuffer(std::move(makeBuffer)), mBuffer(std::move(buffer)) {
     CHECK(kMakeBuffer != nullptr);
-    CHECK(mBuffer != nullptr);
 }
 
 nn::SharedBuffer ResilientBuffer::getBuffer() const {
-    std::lock_guard guard(mMutex);
-    return mBuffer;
+    return mBuffer.get();
 }
 nn::GeneralResult<nn::SharedBuffer> ResilientBuffer::recover(
         const nn::IBuffer* failingBuffer) const {
-    std::lock_guard guard(mMutex);
-
-    // Another caller updated the failing prepared model.
-    if (mBuffer.get() != failingBuffer) {
-        return mBuffer;
-    }
+    const auto makeBuffer = [this](const nn::SharedBuffer& /*current*/) { return kMakeBuffer(); };
+    return mBuffer.recover(failingBuffer, makeBuffer);
+}
 
-    mBuffer = NN_TRY(kMakeBuffer());
-    return mBuffer;
+RecoveryMetrics ResilientBuffer::getRecoveryMetrics() const {
+    return mBuffer.getMetrics();
 }
 
 nn::Request::MemoryDomainToken ResilientBuffer::getToken() const {
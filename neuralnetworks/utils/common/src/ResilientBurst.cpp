@@ -17,7 +17,6 @@
 #include "ResilientBurst.h"
 
 #include <android-base/logging.h>
-#include <android-base/thread_annotations.h>
 #include <nnapi/IBurst.h>
 #include <nnapi/IPreparedModel.h>
 #include <nnapi/Result.h>
@@ -26,7 +25,6 @@
 
 #include <functional>
 #include <memory>
-#include <mutex>
 #include <optional>
 #include <utility>
 
@@ -78,24 +76,19 @@ ResilientBurst::ResilientBurst(PrivateConstructorTag /*tag*/, Factory makeBurst,
                                nn::SharedBurst burst)
     : kMakeBurst(std::move(makeBurst)), mBurst(std::move(burst)) {
     CHECK(kMakeBurst != nullptr);
-    CHECK(mBurst != nullptr);
 }
 
 nn::SharedBurst ResilientBurst::getBurst() const {
-    std::lock_guard guard(mMutex);
-    return mBurst;
+    return mBurst.get();
 }
 
 nn::GeneralResult<nn::SharedBurst> ResilientBurst::recover(const nn::IBurst* failingBurst) const {
-    std::lock_guard guard(mMutex);
-
-    // Another caller updated the failing burst.
-    if (mBurst.get() != failingBurst) {
-        return mBurst;
-    }
+    const auto makeBurst = [this](const nn::SharedBurst& /*current*/) { return kMakeBurst(); };
+    return mBurst.recover(failingBurst, makeBurst);
+}
 
-    mBurst = NN_TRY(kMakeBurst());
-    return mBurst;
+RecoveryMetrics ResilientBurst::getRecoveryMetrics() const {
+    return mBurst.getMetrics();
 }
 
 ResilientBurst::OptionalCacheHold ResilientBurst::cacheMemory(
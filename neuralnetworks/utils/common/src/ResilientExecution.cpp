@@ -20,7 +20,6 @@
 #include "ResilientBurst.h"
 
 #include <android-base/logging.h>
-#include <android-base/thread_annotations.h>
 #include <nnapi/IExecution.h>
 #include <nnapi/Result.h>
 #include <nnapi/TypeUtils.h>
@@ -28,7 +27,6 @@
 
 #include <functional>
 #include <memory>
-#include <mutex>
 #include <sstream>
 #include <utility>
 #include <vector>
@@ -79,25 +77,22 @@ ResilientExecution::ResilientExecution(PrivateConstructorTag /*tag*/, Factory ma
                                        nn::SharedExecution execution)
     : kMakeExecution(std::move(makeExecution)), mExecution(std::move(execution)) {
     CHECK(kMakeExecution != nullptr);
-    CHECK(mExecution != nullptr);
 }
 
 nn::SharedExecution ResilientExecution::getExecution() const {
-    std::lock_guard guard(mMutex);
-    return mExecution;
+    return mExecution.get();
 }
 
 nn::GeneralResult<nn::SharedExecution> ResilientExecution::recover(
         const nn::IExecution* failingExecution) const {
-    std::lock_guard guard(mMutex);
-
-    // Another caller updated the failing prepared model.
-    if (mExecution.get() != failingExecution) {
-        return mExecution;
-    }
+    const auto makeExecution = [this](const nn::SharedExecution& /*current*/) {
+        return kMakeExecution();
+    };
+    return mExecution.recover(failingExecution, makeExecution);
+}
 
-    mExecution = NN_TRY(kMakeExecution());
-    return mExecution;
+RecoveryMetrics ResilientExecution::getRecoveryMetrics() const {
+    return mExecution.getMetrics();
 }
 
 nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>>
@@ -22,7 +22,6 @@
 #include "ResilientExecution.h"
 
 #include <android-base/logging.h>
-#include <android-base/thread_annotations.h>
 #include <nnapi/IPreparedModel.h>
 #include <nnapi/Result.h>
 #include <nnapi/TypeUtils.h>
@@ -30,7 +29,6 @@
 
 #include <functional>
 #include <memory>
-#include <mutex>
 #include <sstream>
 #include <utility>
 #include <vector>
@@ -82,25 +80,22 @@ ResilientPreparedModel::ResilientPreparedModel(PrivateConstructorTag /*tag*/,
                                                nn::SharedPreparedModel preparedModel)
     : kMakePreparedModel(std::move(makePreparedModel)), mPreparedModel(std::move(preparedModel)) {
     CHECK(kMakePreparedModel != nullptr);
-    CHECK(mPreparedModel != nullptr);
 }
 
 nn::SharedPreparedModel ResilientPreparedModel::getPreparedModel() const {
-    std::lock_guard guard(mMutex);
-    return mPreparedModel;
+    return mPreparedModel.get();
 }
 
 nn::GeneralResult<nn::SharedPreparedModel> ResilientPreparedModel::recover(
         const nn::IPreparedModel* failingPreparedModel) const {
-    std::lock_guard guard(mMutex);
-
-    // Another caller updated the failing prepared model.
-    if (mPreparedModel.get() != failingPreparedModel) {
-        return mPreparedModel;
-    }
+    const auto makePreparedModel = [this](const nn::SharedPreparedModel& /*current*/) {
+        return kMakePreparedModel();
+    };
+    return mPreparedModel.recover(failingPreparedModel, makePreparedModel);
+}
 
-    mPreparedModel = NN_TRY(kMakePreparedModel());
-    return mPreparedModel;
+RecoveryMetrics ResilientPreparedModel::getRecoveryMetrics() const {
+    return mPreparedModel.getMetrics();
 }
 
 nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>>
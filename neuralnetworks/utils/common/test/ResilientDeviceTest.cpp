@@ -18,6 +18,8 @@
 #include <nnapi/TypeUtils.h>
 #include <nnapi/Types.h>
 #include <nnapi/hal/ResilientDevice.h>
+#include <atomic>
+#include <thread>
 #include <tuple>
 #include <utility>
 #include "MockBuffer.h"
@@ -721,4 +723,38 @@ TEST(ResilientDeviceTest, recoverCacheMismatchInvalidAllocate) {
     EXPECT_TRUE(result.value() != nullptr);
 }
 
+TEST(ResilientDeviceTest, concurrentDeadObjectSingleRecovery) {
+    // setup call
+    constexpr size_t kNumThreads = 64;
+    const auto [mockDevice, mockDeviceFactory, device] = setup();
+    // Every thread observes the dead device before any of them attempts a recovery.
+    std::atomic<size_t> waiting = 0;
+    EXPECT_CALL(*mockDevice, wait()).WillRepeatedly([&waiting] {
+        waiting++;
+        while (waiting < kNumThreads) std::this_thread::yield();
+        return nn::GeneralResult<void>(nn::error(nn::ErrorStatus::DEAD_OBJECT));
+    });
+    const auto recoveredMockDevice = createConfiguredMockDevice();
+    EXPECT_CALL(*recoveredMockDevice, wait()).WillRepeatedly(Return(nn::GeneralResult<void>{}));
+    EXPECT_CALL(*mockDeviceFactory, Call(true)).Times(1).WillOnce(Return(recoveredMockDevice));
+
+    // run test
+    std::atomic<size_t> successes = 0;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kNumThreads; ++i) {
+        threads.emplace_back([resilientDevice = device, &successes] {
+            if (resilientDevice->wait().has_value()) successes++;
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    // verify result
+    EXPECT_EQ(successes, kNumThreads);
+    const auto metrics = device->getRecoveryMetrics();
+    EXPECT_EQ(metrics.attempts, 1u);
+    EXPECT_EQ(metrics.successes, 1u);
+    EXPECT_EQ(metrics.failures, 0u);
+    EXPECT_EQ(metrics.joined, kNumThreads - 1);
+}
+
 }  // namespace android::hardware::neuralnetworks::utils
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gmock/gmock.h>
+#include <nnapi/TypeUtils.h>
+#include <nnapi/Types.h>
+#include <nnapi/hal/ResilientObject.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace android::hardware::neuralnetworks::utils {
+namespace {
+
+using namespace std::chrono_literals;
+
+struct Object {};
+using SharedObject = std::shared_ptr<const Object>;
+
+const auto kFailRecovery = [](const SharedObject& /*current*/) -> nn::GeneralResult<SharedObject> {
+    return NN_ERROR(nn::ErrorStatus::GENERAL_FAILURE) << "driver is still dead";
+};
+
+const auto kRecover = [](const SharedObject& /*current*/) -> nn::GeneralResult<SharedObject> {
+    return std::make_shared<const Object>();
+};
+
+}  // namespace
+
+TEST(ResilientObjectTest, get) {
+    // setup call
+    const auto object = std::make_shared<const Object>();
+    const ResilientObject<Object> resilientObject(object);
+
+    // run test
+    const auto result = resilientObject.get();
+
+    // verify result
+    EXPECT_TRUE(result == object);
+}
+
+TEST(ResilientObjectTest, recover) {
+    // setup call
+    const auto object = std::make_shared<const Object>();
+    const ResilientObject<Object> resilientObject(object);
+
+    // run test
+    const auto result = resilientObject.recover(object.get(), kRecover);
+
+    // verify result
+    ASSERT_TRUE(result.has_value())
+            << "Failed with " << result.error().code << ": " << result.error().message;
+    EXPECT_TRUE(result.value() != object);
+    EXPECT_TRUE(resilientObject.get() == result.value());
+    EXPECT_EQ(resilientObject.getMetrics().successes, 1u);
+}
+
+TEST(ResilientObjectTest, failedRecoveryIsThrottled) {
+    // setup call
+    const auto object = std::make_shared<const Object>();
+    const ResilientObject<Object> resilientObject(object, /*initialBackoff=*/1h,
+                                                  /*maxBackoff=*/1h);
+    resilientObject.recover(object.get(), kFailRecovery);
+
+    // run test
+    const auto result = resilientObject.recover(object.get(), kRecover);
+
+    // verify result
+    ASSERT_FALSE(result.has_value());
+    EXPECT_EQ(result.error().code, nn::ErrorStatus::GENERAL_FAILURE);
+    const auto metrics = resilientObject.getMetrics();
+    EXPECT_EQ(metrics.attempts, 1u);
+    EXPECT_EQ(metrics.failures, 1u);
+    EXPECT_EQ(metrics.throttled, 1u);
+    EXPECT_TRUE(resilientObject.get() == object);
+}
+
+TEST(ResilientObjectTest, backoffGrowsExponentially) {
+    // setup call
+    const auto object = std::make_shared<const Object>();
+    auto now = std::chrono::steady_clock::time_point{};
+    const ResilientObject<Object> resilientObject(object, /*initialBackoff=*/100ms,
+                                                  /*maxBackoff=*/10s, [&now] { return now; });
+
+    // run test
+    resilientObject.recover(object.get(), kFailRecovery);
+    now += 100ms;
+    // The first backoff period is over, so this attempt runs and doubles the backoff.
+    resilientObject.recover(object.get(), kFailRecovery);
+    now += 199ms;
+    const auto throttledResult = resilientObject.recover(object.get(), kRecover);
+    now += 1ms;
+    const auto result = resilientObject.recover(object.get(), kRecover);
+
+    // verify result
+    EXPECT_FALSE(throttledResult.has_value());
+    EXPECT_TRUE(result.has_value());
+    const auto metrics = resilientObject.getMetrics();
+    EXPECT_EQ(metrics.attempts, 3u);
+    EXPECT_EQ(metrics.failures, 2u);
+    EXPECT_EQ(metrics.throttled, 1u);
+}
+
+TEST(ResilientObjectTest, backoffIsCappedWithoutOverflowing) {
+    // setup call
+    const auto object = std::make_shared<const Object>();
+    auto now = std::chrono::steady_clock::time_point{};
+    const ResilientObject<Object> resilientObject(object, /*initialBackoff=*/10s,
+                                                  /*maxBackoff=*/24h, [&now] { return now; });
+    // 10s doubled 40 times overflows nanoseconds.
+    for (int i = 0; i < 40; ++i) {
+        ASSERT_FALSE(resilientObject.recover(object.get(), kFailRecovery).has_value());
+        now += 24h;
+    }
+    ASSERT_FALSE(resilientObject.recover(object.get(), kFailRecovery).has_value());
+
+    // run test
+    now += 24h - 1ns;
+    const auto throttledResult = resilientObject.recover(object.get(), kRecover);
+    now += 1ns;
+    const auto result = resilientObject.recover(object.get(), kRecover);
+
+    // verify result
+    EXPECT_FALSE(throttledResult.has_value());
+    EXPECT_TRUE(result.has_value());
+    EXPECT_EQ(resilientObject.getMetrics().throttled, 1u);
+}
+
+TEST(ResilientObjectTest, successfulRecoveryResetsBackoff) {
+    // setup call
+    const auto object = std::make_shared<const Object>();
+    auto now = std::chrono::steady_clock::time_point{};
+    const ResilientObject<Object> resilientObject(object, /*initialBackoff=*/10ms,
+                                                  /*maxBackoff=*/1s, [&now] { return now; });
+    resilientObject.recover(object.get(), kFailRecovery);
+    now += 10ms;
+    resilientObject.recover(object.get(), kFailRecovery);
+    now += 20ms;
+    const auto recovered = resilientObject.recover(object.get(), kRecover).value();
+    resilientObject.recover(recovered.get(), kFailRecovery);
+
+    // run test
+    now += 10ms;
+    const auto result = resilientObject.recover(recovered.get(), kRecover);
+
+    // verify result
+    ASSERT_TRUE(result.has_value())
+            << "Failed with " << result.error().code << ": " << result.error().message;
+    EXPECT_EQ(resilientObject.getMetrics().successes, 2u);
+}
+
+TEST(ResilientObjectTest, concurrentFailuresShareOneAttempt) {
+    // setup call
+    constexpr size_t kNumThreads = 64;
+    const auto object = std::make_shared<const Object>();
+    const ResilientObject<Object> resilientObject(object, /*initialBackoff=*/1h,
+                                                  /*maxBackoff=*/1h);
+    std::atomic<size_t> factoryCalls = 0;
+    const auto slowFailRecovery = [&factoryCalls](const SharedObject& current) {
+        factoryCalls++;
+        std::this_thread::sleep_for(10ms);
+        return kFailRecovery(current);
+    };
+
+    // run test
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kNumThreads; ++i) {
+        threads.emplace_back([&resilientObject, &object, &slowFailRecovery] {
+            EXPECT_FALSE(resilientObject.recover(object.get(), slowFailRecovery).has_value());
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    // verify result
+    EXPECT_EQ(factoryCalls, 1u);
+    const auto metrics = resilientObject.getMetrics();
+    EXPECT_EQ(metrics.attempts, 1u);
+    EXPECT_EQ(metrics.throttled, kNumThreads - 1);
+}
+
+TEST(ResilientObjectTest, getDuringRecoveryDoesNotBlock) {
+    // setup call
+    const auto object = std::make_shared<const Object>();
+    const ResilientObject<Object> resilientObject(object);
+    std::atomic<bool> inFactory = false;
+    std::atomic<bool> releaseFactory = false;
+    const auto blockingRecovery = [&](const SharedObject& current) {
+        inFactory = true;
+        while (!releaseFactory) std::this_thread::yield();
+        return kRecover(current);
+    };
+    std::thread recoveryThread(
+            [&] { resilientObject.recover(object.get(), blockingRecovery).value(); });
+    while (!inFactory) std::this_thread::yield();
+
+    // run test
+    const auto result = resilientObject.get();
+    releaseFactory = true;
+    recoveryThread.join();
+
+    // verify result
+    EXPECT_TRUE(result == object);
+    EXPECT_TRUE(resilientObject.get() != object);
+}
+
+}  // namespace android::hardware::neuralnetworks::utils
@@ -33,11 +33,25 @@ namespace android::hardware::radio::compat {
  */
 static constexpr auto kDelayedSetterDelay = 100ms;
 
+/**
+ * Indications that may be rate limited with ro.vendor.radio.compat.indication.* properties.
+ */
+static const std::vector<std::string> kFilteredIndications = {
+        "cellInfoList",
+        "currentSignalStrength",
+};
+
 CallbackManager::CallbackManager(std::shared_ptr<DriverContext> context, sp<V1_5::IRadio> hidlHal)
     : mHidlHal(hidlHal),
       mRadioResponse(sp<compat::RadioResponse>::make(context)),
       mRadioIndication(sp<compat::RadioIndication>::make(context)),
-      mDelayedSetterThread(&CallbackManager::delayedSetterThread, this) {}
+      mDelayedSetterThread(&CallbackManager::delayedSetterThread, this) {
+    auto& filter = mRadioIndication->indicationFilter();
+    filter.setAckFunction([weakHal = wp<V1_5::IRadio>(hidlHal)]() {
+        if (auto hal = weakHal.promote()) hal->responseAcknowledgement();
+    });
+    filter.configureFromProperties(kFilteredIndications);
+}
 
 CallbackManager::~CallbackManager() {
     {
@@ -53,6 +67,10 @@ RadioResponse& CallbackManager::response() const {
     return *mRadioResponse;
 }
 
+IndicationFilter& CallbackManager::indicationFilter() const {
+    return mRadioIndication->indicationFilter();
+}
+
 void CallbackManager::setResponseFunctionsDelayed() {
     std::unique_lock<std::mutex> lock(mDelayedSetterGuard);
     mDelayedSetterDeadline = std::chrono::steady_clock::now() + kDelayedSetterDelay;
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <libradiocompat/IndicationFilter.h>
+
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/properties.h>
+#include <android-base/strings.h>
+
+namespace android::hardware::radio::compat {
+
+static constexpr char kPropertyPrefix[] = "ro.vendor.radio.compat.indication.";
+
+static std::optional<IndicationFilter::Config> parseConfig(const std::string& value) {
+    using Policy = IndicationFilter::Policy;
+    if (value == "passthrough") return IndicationFilter::Config{};
+    if (value == "suppress") return IndicationFilter::Config{.policy = Policy::SUPPRESS_IDENTICAL};
+
+    static constexpr char kCoalesce[] = "coalesce:";
+    unsigned windowMs;
+    if (base::StartsWith(value, kCoalesce) &&
+        base::ParseUint(value.substr(sizeof(kCoalesce) - 1), &windowMs)) {
+        return IndicationFilter::Config{
+                .policy = Policy::COALESCE,
+                .window = std::chrono::milliseconds(windowMs),
+        };
+    }
+    return std::nullopt;
+}
+
+IndicationFilter::IndicationFilter() : mFlushThread(&IndicationFilter::flushThread, this) {}
+
+IndicationFilter::~IndicationFilter() {
+    {
+        std::unique_lock<std::mutex> lock(mGuard);
+        mDestroy = true;
+        mCv.notify_all();
+    }
+    mFlushThread.join();
+}
+
+void IndicationFilter::setAckFunction(AckFunction ack) {
+    std::unique_lock<std::mutex> lock(mGuard);
+    mAck = ack;
+}
+
+void IndicationFilter::configure(const std::string& indication, Config config) {
+    std::unique_lock<std::mutex> lock(mGuard);
+    auto& channel = mChannels[indication];
+    channel.config = config;
+    channel.last.reset();
+    channel.lastDelivery = std::nullopt;
+    // Anything pending gets flushed on the next filter thread iteration.
+    if (channel.pending) channel.deadline = std::chrono::steady_clock::now();
+    mCv.notify_all();
+}
+
+void IndicationFilter::configureFromProperties(const std::vector<std::string>& indications) {
+    for (const auto& indication : indications) {
+        const auto value = base::GetProperty(kPropertyPrefix + indication, "");
+        if (value.empty()) continue;
+
+        const auto config = parseConfig(value);
+        if (!config) {
+            LOG(ERROR) << "Invalid policy for " << indication << ": " << value;
+            continue;
+        }
+        LOG(INFO) << "Indication policy for " << indication << ": " << value;
+        configure(indication, *config);
+    }
+}
+
+IndicationFilter::Counters IndicationFilter::getCounters(const std::string& indication) const {
+    std::unique_lock<std::mutex> lock(mGuard);
+    const auto it = mChannels.find(indication);
+    if (it == mChannels.end()) return {};
+    return it->second.counters;
+}
+
+void IndicationFilter::acknowledge(V1_0::RadioIndicationType type) {
+    if (type != V1_0::RadioIndicationType::UNSOLICITED_ACK_EXP) return;
+    AckFunction ack;
+    {
+        std::unique_lock<std::mutex> lock(mGuard);
+        ack = mAck;
+    }
+    if (ack) ack();
+}
+
+void IndicationFilter::flushThread() {
+    std::unique_lock<std::mutex> lock(mGuard);
+    while (!mDestroy) {
+        const auto now = std::chrono::steady_clock::now();
+        std::optional<std::chrono::steady_clock::time_point> nextDeadline;
+        std::vector<std::function<void()>> due;
+
+        for (auto& [name, channel] : mChannels) {
+            if (!channel.deadline.has_value()) continue;
+            if (*channel.deadline > now) {
+                if (!nextDeadline || *channel.deadline < *nextDeadline) {
+                    nextDeadline = channel.deadline;
+                }
+                continue;
+            }
+            channel.deadline = std::nullopt;
+            channel.lastDelivery = now;
+            channel.counters.delivered++;
+            due.push_back(std::move(channel.pending));
+            channel.pending = nullptr;
+        }
+
+        if (!due.empty()) {
+            lock.unlock();
+            for (const auto& deliver : due) deliver();
+            lock.lock();
+            continue;
+        }
+
+        if (nextDeadline) {
+            mCv.wait_until(lock, *nextDeadline);
+        } else {
+            mCv.wait(lock);
+        }
+    }
+}
+
+}  // namespace android::hardware::radio::compat
@@ -20,4 +20,8 @@ namespace android::hardware::radio::compat {
 
 RadioIndication::RadioIndication(std::shared_ptr<DriverContext> context) : mContext(context) {}
 
+IndicationFilter& RadioIndication::indicationFilter() {
+    return mFilter;
+}
+
 }  // namespace android::hardware::radio::compat
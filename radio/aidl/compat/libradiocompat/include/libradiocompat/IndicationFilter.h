@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <android/hardware/radio/1.0/types.h>
+
+#include <any>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android::hardware::radio::compat {
+
+/**
+ * Rate limiter for high frequency HIDL indications (such as cell info or signal strength), applied
+ * before converting them to AIDL and waking up the framework.
+ *
+ * Each indication is identified by its AIDL name and has its own policy. By default, every
+ * indication is passed through immediately.
+ */
+class IndicationFilter {
+  public:
+    enum class Policy {
+        /** Deliver every indication immediately. */
+        PASS_THROUGH,
+        /** Drop indications with payload identical to the last delivered one. */
+        SUPPRESS_IDENTICAL,
+        /** Deliver at most one indication per window, the latest one wins. */
+        COALESCE,
+    };
+
+    struct Config {
+        Policy policy = Policy::PASS_THROUGH;
+        std::chrono::milliseconds window = {};
+    };
+
+    struct Counters {
+        uint64_t delivered = 0;
+        /** Indications not delivered, because they didn't carry any new information. */
+        uint64_t dropped = 0;
+        /** Indications replaced by a newer one before the end of a coalescing window. */
+        uint64_t merged = 0;
+    };
+
+    using AckFunction = std::function<void()>;
+
+    IndicationFilter();
+    ~IndicationFilter();
+
+    /**
+     * Sets a function acknowledging UNSOLICITED_ACK_EXP indications that are dropped or deferred,
+     * so the modem doesn't keep a wakelock waiting for the framework to do it.
+     */
+    void setAckFunction(AckFunction ack);
+
+    void configure(const std::string& indication, Config config);
+
+    /**
+     * Configures indications from vendor properties, i.e.:
+     * ro.vendor.radio.compat.indication.<indication>=passthrough|suppress|coalesce:<window ms>
+     */
+    void configureFromProperties(const std::vector<std::string>& indications);
+
+    Counters getCounters(const std::string& indication) const;
+
+    /**
+     * Passes a HIDL indication through the filter.
+     *
+     * \param indication AIDL name of the indication
+     * \param type HIDL indication type
+     * \param payload HIDL payload, must be copyable and equality comparable
+     * \param deliver converts the payload to AIDL and sends it to the framework; it may be called
+     *        later, from the filter thread
+     */
+    template <typename T>
+    void submit(const std::string& indication, V1_0::RadioIndicationType type, const T& payload,
+                std::function<void(V1_0::RadioIndicationType, const T&)> deliver) {
+        std::unique_lock<std::mutex> lock(mGuard);
+        auto& channel = mChannels[indication];
+        const auto now = std::chrono::steady_clock::now();
+
+        if (channel.config.policy == Policy::SUPPRESS_IDENTICAL) {
+            const auto* last = std::any_cast<T>(&channel.last);
+            if (last != nullptr && *last == payload) {
+                channel.counters.dropped++;
+                lock.unlock();
+                acknowledge(type);
+                return;
+            }
+            channel.last = payload;
+        }
+
+        // While an indication is pending, newer ones must replace it to preserve ordering.
+        if (channel.config.policy == Policy::COALESCE &&
+            (channel.pending || (channel.lastDelivery.has_value() &&
+                                 now < *channel.lastDelivery + channel.config.window))) {
+            if (channel.pending) channel.counters.merged++;
+            // The deferred indication is acknowledged right away, so it's sent as UNSOLICITED.
+            channel.pending = [deliver, payload]() {
+                deliver(V1_0::RadioIndicationType::UNSOLICITED, payload);
+            };
+            if (!channel.deadline.has_value()) {
+                channel.deadline = *channel.lastDelivery + channel.config.window;
+                mCv.notify_all();
+            }
+            lock.unlock();
+            acknowledge(type);
+            return;
+        }
+
+        channel.counters.delivered++;
+        channel.lastDelivery = now;
+        lock.unlock();
+        deliver(type, payload);
+    }
+
+  private:
+    struct Channel {
+        Config config;
+        Counters counters;
+        std::any last;
+        std::optional<std::chrono::steady_clock::time_point> lastDelivery;
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+        std::function<void()> pending;
+    };
+
+    mutable std::mutex mGuard;
+    std::map<std::string, Channel> mChannels GUARDED_BY(mGuard);
+    AckFunction mAck GUARDED_BY(mGuard);
+    std::condition_variable mCv;
+    bool mDestroy GUARDED_BY(mGuard) = false;
+    std::thread mFlushThread;
+
+    void acknowledge(V1_0::RadioIndicationType type);
+    void flushThread();
+};
+
+}  // namespace android::hardware::radio::compat
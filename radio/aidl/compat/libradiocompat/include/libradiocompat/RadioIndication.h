@@ -17,6 +17,7 @@
 
 #include "DriverContext.h"
 #include "GuaranteedCallback.h"
+#include "IndicationFilter.h"
 
 #include <aidl/android/hardware/radio/data/IRadioDataIndication.h>
 #include <aidl/android/hardware/radio/messaging/IRadioMessagingIndication.h>
@@ -56,6 +57,8 @@ class RadioIndication : public V1_6::IRadioIndication {
             ::aidl::android::hardware::radio::voice::IRadioVoiceIndicationDefault, true>
             mVoiceCb;
 
+    IndicationFilter mFilter;
+
     // IRadioIndication @ 1.0
     Return<void> radioStateChanged(V1_0::RadioIndicationType type,
                                    V1_0::RadioState radioState) override;
@@ -228,6 +231,8 @@ class RadioIndication : public V1_6::IRadioIndication {
     std::shared_ptr<::aidl::android::hardware::radio::network::IRadioNetworkIndication> networkCb();
     std::shared_ptr<::aidl::android::hardware::radio::sim::IRadioSimIndication> simCb();
     std::shared_ptr<::aidl::android::hardware::radio::voice::IRadioVoiceIndication> voiceCb();
+
+    IndicationFilter& indicationFilter();
 };
 
 }  // namespace android::hardware::radio::compat
@@ -75,14 +75,22 @@ Return<void> RadioIndication::cellInfoList_1_4(V1_0::RadioIndicationType type,
 Return<void> RadioIndication::cellInfoList_1_5(V1_0::RadioIndicationType type,
                                                const hidl_vec<V1_5::CellInfo>& records) {
     LOG_CALL << type;
-    networkCb()->cellInfoList(toAidl(type), toAidl(records));
+    mFilter.submit<hidl_vec<V1_5::CellInfo>>(
+            "cellInfoList", type, records,
+            [this](auto deliveredType, const auto& payload) {
+                networkCb()->cellInfoList(toAidl(deliveredType), toAidl(payload));
+            });
     return {};
 }
 
 Return<void> RadioIndication::cellInfoList_1_6(V1_0::RadioIndicationType type,
                                                const hidl_vec<V1_6::CellInfo>& records) {
     LOG_CALL << type;
-    networkCb()->cellInfoList(toAidl(type), toAidl(records));
+    mFilter.submit<hidl_vec<V1_6::CellInfo>>(
+            "cellInfoList", type, records,
+            [this](auto deliveredType, const auto& payload) {
+                networkCb()->cellInfoList(toAidl(deliveredType), toAidl(payload));
+            });
     return {};
 }
 
@@ -138,14 +146,22 @@ Return<void> RadioIndication::currentSignalStrength_1_2(V1_0::RadioIndicationTyp
 Return<void> RadioIndication::currentSignalStrength_1_4(
         V1_0::RadioIndicationType type, const V1_4::SignalStrength& signalStrength) {
     LOG_CALL << type;
-    networkCb()->currentSignalStrength(toAidl(type), toAidl(signalStrength));
+    mFilter.submit<V1_4::SignalStrength>(
+            "currentSignalStrength", type, signalStrength,
+            [this](auto deliveredType, const auto& payload) {
+                networkCb()->currentSignalStrength(toAidl(deliveredType), toAidl(payload));
+            });
     return {};
 }
 
 Return<void> RadioIndication::currentSignalStrength_1_6(
         V1_0::RadioIndicationType type, const V1_6::SignalStrength& signalStrength) {
     LOG_CALL << type;
-    networkCb()->currentSignalStrength(toAidl(type), toAidl(signalStrength));
+    mFilter.submit<V1_6::SignalStrength>(
+            "currentSignalStrength", type, signalStrength,
+            [this](auto deliveredType, const auto& payload) {
+                networkCb()->currentSignalStrength(toAidl(deliveredType), toAidl(payload));
+            });
     return {};
 }
 
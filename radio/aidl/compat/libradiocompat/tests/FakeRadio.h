@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <android/hardware/radio/1.5/IRadio.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace android::hardware::radio::compat {
+
+/**
+ * Stands in for the HIDL modem: keeps the indication callback the compat layer registers and
+ * counts the acknowledgements it sends. Requests are ignored.
+ */
+class FakeRadio : public V1_5::IRadio {
+  public:
+    /** Waits for the compat layer to register its indication callback, nullptr on timeout. */
+    sp<V1_0::IRadioIndication> waitForIndication() {
+        std::unique_lock<std::mutex> lock(mGuard);
+        mRegistered.wait_for(lock, std::chrono::seconds(5),
+                             [this]() { return mIndication != nullptr; });
+        return mIndication;
+    }
+
+    int acks() const { return mAcks; }
+
+    Return<void> setResponseFunctions(const sp<V1_0::IRadioResponse>& /*radioResponse*/,
+                                      const sp<V1_0::IRadioIndication>& radioIndication) override {
+        std::lock_guard<std::mutex> lock(mGuard);
+        mIndication = radioIndication;
+        mRegistered.notify_all();
+        return {};
+    }
+
+    Return<void> responseAcknowledgement() override {
+        mAcks++;
+        return {};
+    }
+
+    // IRadio @ 1.0
+    Return<void> getIccCardStatus(int32_t) override { return {}; }
+    Return<void> supplyIccPinForApp(int32_t, const hidl_string&, const hidl_string&) override {
+        return {};
+    }
+    Return<void> supplyIccPukForApp(int32_t, const hidl_string&, const hidl_string&,
+                                    const hidl_string&) override {
+        return {};
+    }
+    Return<void> supplyIccPin2ForApp(int32_t, const hidl_string&, const hidl_string&) override {
+        return {};
+    }
+    Return<void> supplyIccPuk2ForApp(int32_t, const hidl_string&, const hidl_string&,
+                                     const hidl_string&) override {
+        return {};
+    }
+    Return<void> changeIccPinForApp(int32_t, const hidl_string&, const hidl_string&,
+                                    const hidl_string&) override {
+        return {};
+    }
+    Return<void> changeIccPin2ForApp(int32_t, const hidl_string&, const hidl_string&,
+                                     const hidl_string&) override {
+        return {};
+    }
+    Return<void> supplyNetworkDepersonalization(int32_t, const hidl_string&) override { return {}; }
+    Return<void> getCurrentCalls(int32_t) override { return {}; }
+    Return<void> dial(int32_t, const V1_0::Dial&) override { return {}; }
+    Return<void> getImsiForApp(int32_t, const hidl_string&) override { return {}; }
+    Return<void> hangup(int32_t, int32_t) override { return {}; }
+    Return<void> hangupWaitingOrBackground(int32_t) override { return {}; }
+    Return<void> hangupForegroundResumeBackground(int32_t) override { return {}; }
+    Return<void> switchWaitingOrHoldingAndActive(int32_t) override { return {}; }
+    Return<void> conference(int32_t) override { return {}; }
+    Return<void> rejectCall(int32_t) override { return {}; }
+    Return<void> getLastCallFailCause(int32_t) override { return {}; }
+    Return<void> getSignalStrength(int32_t) override { return {}; }
+    Return<void> getVoiceRegistrationState(int32_t) override { return {}; }
+    Return<void> getDataRegistrationState(int32_t) override { return {}; }
+    Return<void> getOperator(int32_t) override { return {}; }
+    Return<void> setRadioPower(int32_t, bool) override { return {}; }
+    Return<void> sendDtmf(int32_t, const hidl_string&) override { return {}; }
+    Return<void> sendSms(int32_t, const V1_0::GsmSmsMessage&) override { return {}; }
+    Return<void> sendSMSExpectMore(int32_t, const V1_0::GsmSmsMessage&) override { return {}; }
+    Return<void> setupDataCall(int32_t, V1_0::RadioTechnology, const V1_0::DataProfileInfo&, bool,
+                               bool, bool) override {
+        return {};
+    }
+    Return<void> iccIOForApp(int32_t, const V1_0::IccIo&) override { return {}; }
+    Return<void> sendUssd(int32_t, const hidl_string&) override { return {}; }
+    Return<void> cancelPendingUssd(int32_t) override { return {}; }
+    Return<void> getClir(int32_t) override { return {}; }
+    Return<void> setClir(int32_t, int32_t) override { return {}; }
+    Return<void> getCallForwardStatus(int32_t, const V1_0::CallForwardInfo&) override { return {}; }
+    Return<void> setCallForward(int32_t, const V1_0::CallForwardInfo&) override { return {}; }
+    Return<void> getCallWaiting(int32_t, int32_t) override { return {}; }
+    Return<void> setCallWaiting(int32_t, bool, int32_t) override { return {}; }
+    Return<void> acknowledgeLastIncomingGsmSms(int32_t, bool,
+                                               V1_0::SmsAcknowledgeFailCause) override {
+        return {};
+    }
+    Return<void> acceptCall(int32_t) override { return {}; }
+    Return<void> deactivateDataCall(int32_t, int32_t, bool) override { return {}; }
+    Return<void> getFacilityLockForApp(int32_t, const hidl_string&, const hidl_string&, int32_t,
+                                       const hidl_string&) override {
+        return {};
+    }
+    Return<void> setFacilityLockForApp(int32_t, const hidl_string&, bool, const hidl_string&,
+                                       int32_t, const hidl_string&) override {
+        return {};
+    }
+    Return<void> setBarringPassword(int32_t, const hidl_string&, const hidl_string&,
+                                    const hidl_string&) override {
+        return {};
+    }
+    Return<void> getNetworkSelectionMode(int32_t) override { return {}; }
+    Return<void> setNetworkSelectionModeAutomatic(int32_t) override { return {}; }
+    Return<void> setNetworkSelectionModeManual(int32_t, const hidl_string&) override { return {}; }
+    Return<void> getAvailableNetworks(int32_t) override { return {}; }
+    Return<void> startDtmf(int32_t, const hidl_string&) override { return {}; }
+    Return<void> stopDtmf(int32_t) override { return {}; }
+    Return<void> getBasebandVersion(int32_t) override { return {}; }
+    Return<void> separateConnection(int32_t, int32_t) override { return {}; }
+    Return<void> setMute(int32_t, bool) override { return {}; }
+    Return<void> getMute(int32_t) override { return {}; }
+    Return<void> getClip(int32_t) override { return {}; }
+    Return<void> getDataCallList(int32_t) override { return {}; }
+    Return<void> setSuppServiceNotifications(int32_t, bool) override { return {}; }
+    Return<void> writeSmsToSim(int32_t, const V1_0::SmsWriteArgs&) override { return {}; }
+    Return<void> deleteSmsOnSim(int32_t, int32_t) override { return {}; }
+    Return<void> setBandMode(int32_t, V1_0::RadioBandMode) override { return {}; }
+    Return<void> getAvailableBandModes(int32_t) override { return {}; }
+    Return<void> sendEnvelope(int32_t, const hidl_string&) override { return {}; }
+    Return<void> sendTerminalResponseToSim(int32_t, const hidl_string&) override { return {}; }
+    Return<void> handleStkCallSetupRequestFromSim(int32_t, bool) override { return {}; }
+    Return<void> explicitCallTransfer(int32_t) override { return {}; }
+    Return<void> setPreferredNetworkType(int32_t, V1_0::PreferredNetworkType) override {
+        return {};
+    }
+    Return<void> getPreferredNetworkType(int32_t) override { return {}; }
+    Return<void> getNeighboringCids(int32_t) override { return {}; }
+    Return<void> setLocationUpdates(int32_t, bool) override { return {}; }
+    Return<void> setCdmaSubscriptionSource(int32_t, V1_0::CdmaSubscriptionSource) override {
+        return {};
+    }
+    Return<void> setCdmaRoamingPreference(int32_t, V1_0::CdmaRoamingType) override { return {}; }
+    Return<void> getCdmaRoamingPreference(int32_t) override { return {}; }
+    Return<void> setTTYMode(int32_t, V1_0::TtyMode) override { return {}; }
+    Return<void> getTTYMode(int32_t) override { return {}; }
+    Return<void> setPreferredVoicePrivacy(int32_t, bool) override { return {}; }
+    Return<void> getPreferredVoicePrivacy(int32_t) override { return {}; }
+    Return<void> sendCDMAFeatureCode(int32_t, const hidl_string&) override { return {}; }
+    Return<void> sendBurstDtmf(int32_t, const hidl_string&, int32_t, int32_t) override {
+        return {};
+    }
+    Return<void> sendCdmaSms(int32_t, const V1_0::CdmaSmsMessage&) override { return {}; }
+    Return<void> acknowledgeLastIncomingCdmaSms(int32_t, const V1_0::CdmaSmsAck&) override {
+        return {};
+    }
+    Return<void> getGsmBroadcastConfig(int32_t) override { return {}; }
+    Return<void> setGsmBroadcastConfig(int32_t,
+                                       const hidl_vec<V1_0::GsmBroadcastSmsConfigInfo>&) override {
+        return {};
+    }
+    Return<void> setGsmBroadcastActivation(int32_t, bool) override { return {}; }
+    Return<void> getCdmaBroadcastConfig(int32_t) override { return {}; }
+            int32_t, const hidl_vec<V1_0::CdmaBroadcastSmsConfigInfo>&) override {
+        return {};
+    }
+    Return<void> setCdmaBroadcastActivation(int32_t, bool) override { return {}; }
+    Return<void> getCDMASubscription(int32_t) override { return {}; }
+    Return<void> writeSmsToRuim(int32_t, const V1_0::CdmaSmsWriteArgs&) override { return {}; }
+    Return<void> deleteSmsOnRuim(int32_t, int32_t) override { return {}; }
+    Return<void> getDeviceIdentity(int32_t) override { return {}; }
+    Return<void> exitEmergencyCallbackMode(int32_t) override { return {}; }
+    Return<void> getSmscAddress(int32_t) override { return {}; }
+    Return<void> setSmscAddress(int32_t, const hidl_string&) override { return {}; }
+    Return<void> reportSmsMemoryStatus(int32_t, bool) override { return {}; }
+    Return<void> reportStkServiceIsRunning(int32_t) override { return {}; }
+    Return<void> getCdmaSubscriptionSource(int32_t) override { return {}; }
+    Return<void> requestIsimAuthentication(int32_t, const hidl_string&) override { return {}; }
+    Return<void> acknowledgeIncomingGsmSmsWithPdu(int32_t, bool, const hidl_string&) override {
+        return {};
+    }
+    Return<void> sendEnvelopeWithStatus(int32_t, const hidl_string&) override { return {}; }
+    Return<void> getVoiceRadioTechnology(int32_t) override { return {}; }
+    Return<void> getCellInfoList(int32_t) override { return {}; }
+    Return<void> setCellInfoListRate(int32_t, int32_t) override { return {}; }
+    Return<void> setInitialAttachApn(int32_t, const V1_0::DataProfileInfo&, bool, bool) override {
+        return {};
+    }
+    Return<void> getImsRegistrationState(int32_t) override { return {}; }
+    Return<void> sendImsSms(int32_t, const V1_0::ImsSmsMessage&) override { return {}; }
+    Return<void> iccTransmitApduBasicChannel(int32_t, const V1_0::SimApdu&) override { return {}; }
+    Return<void> iccOpenLogicalChannel(int32_t, const hidl_string&, int32_t) override { return {}; }
+    Return<void> iccCloseLogicalChannel(int32_t, int32_t) override { return {}; }
+    Return<void> iccTransmitApduLogicalChannel(int32_t, const V1_0::SimApdu&) override {
+        return {};
+    }
+    Return<void> nvReadItem(int32_t, V1_0::NvItem) override { return {}; }
+    Return<void> nvWriteItem(int32_t, const V1_0::NvWriteItem&) override { return {}; }
+    Return<void> nvWriteCdmaPrl(int32_t, const hidl_vec<uint8_t>&) override { return {}; }
+    Return<void> nvResetConfig(int32_t, V1_0::ResetNvType) override { return {}; }
+    Return<void> setUiccSubscription(int32_t, const V1_0::SelectUiccSub&) override { return {}; }
+    Return<void> setDataAllowed(int32_t, bool) override { return {}; }
+    Return<void> getHardwareConfig(int32_t) override { return {}; }
+    Return<void> requestIccSimAuthentication(int32_t, int32_t, const hidl_string&,
+                                             const hidl_string&) override {
+        return {};
+    }
+    Return<void> setDataProfile(int32_t, const hidl_vec<V1_0::DataProfileInfo>&, bool) override {
+        return {};
+    }
+    Return<void> requestShutdown(int32_t) override { return {}; }
+    Return<void> getRadioCapability(int32_t) override { return {}; }
+    Return<void> setRadioCapability(int32_t, const V1_0::RadioCapability&) override { return {}; }
+    Return<void> startLceService(int32_t, int32_t, bool) override { return {}; }
+    Return<void> stopLceService(int32_t) override { return {}; }
+    Return<void> pullLceData(int32_t) override { return {}; }
+    Return<void> getModemActivityInfo(int32_t) override { return {}; }
+    Return<void> setAllowedCarriers(int32_t, bool, const V1_0::CarrierRestrictions&) override {
+        return {};
+    }
+    Return<void> getAllowedCarriers(int32_t) override { return {}; }
+    Return<void> sendDeviceState(int32_t, V1_0::DeviceStateType, bool) override { return {}; }
+    Return<void> setIndicationFilter(int32_t, hidl_bitfield<V1_0::IndicationFilter>) override {
+        return {};
+    }
+    Return<void> setSimCardPower(int32_t, bool) override { return {}; }
+
+    // IRadio @ 1.1
+    Return<void> setCarrierInfoForImsiEncryption(int32_t,
+                                                 const V1_1::ImsiEncryptionInfo&) override {
+        return {};
+    }
+    Return<void> setSimCardPower_1_1(int32_t, V1_1::CardPowerState) override { return {}; }
+    Return<void> startNetworkScan(int32_t, const V1_1::NetworkScanRequest&) override { return {}; }
+    Return<void> stopNetworkScan(int32_t) override { return {}; }
+    Return<void> startKeepalive(int32_t, const V1_1::KeepaliveRequest&) override { return {}; }
+    Return<void> stopKeepalive(int32_t, int32_t) override { return {}; }
+
+    // IRadio @ 1.2
+    Return<void> startNetworkScan_1_2(int32_t, const V1_2::NetworkScanRequest&) override {
+        return {};
+    }
+    Return<void> setIndicationFilter_1_2(int32_t, hidl_bitfield<V1_2::IndicationFilter>) override {
+        return {};
+    }
+    Return<void> setSignalStrengthReportingCriteria(int32_t, int32_t, int32_t,
+                                                    const hidl_vec<int32_t>&,
+                                                    V1_2::AccessNetwork) override {
+        return {};
+    }
+    Return<void> setLinkCapacityReportingCriteria(int32_t, int32_t, int32_t, int32_t,
+                                                  const hidl_vec<int32_t>&,
+                                                  const hidl_vec<int32_t>&,
+                                                  V1_2::AccessNetwork) override {
+        return {};
+    }
+    Return<void> setupDataCall_1_2(int32_t, V1_2::AccessNetwork, const V1_0::DataProfileInfo&, bool,
+                                   bool, bool, V1_2::DataRequestReason,
+                                   const hidl_vec<hidl_string>&,
+                                   const hidl_vec<hidl_string>&) override {
+        return {};
+    }
+    Return<void> deactivateDataCall_1_2(int32_t, int32_t, V1_2::DataRequestReason) override {
+        return {};
+    }
+
+    // IRadio @ 1.3
+    Return<void> setSystemSelectionChannels(int32_t, bool,
+                                            const hidl_vec<V1_1::RadioAccessSpecifier>&) override {
+        return {};
+    }
+    Return<void> enableModem(int32_t, bool) override { return {}; }
+    Return<void> getModemStackStatus(int32_t) override { return {}; }
+
+    // IRadio @ 1.4
+    Return<void> setupDataCall_1_4(int32_t, V1_4::AccessNetwork, const V1_4::DataProfileInfo&, bool,
+                                   V1_2::DataRequestReason, const hidl_vec<hidl_string>&,
+                                   const hidl_vec<hidl_string>&) override {
+        return {};
+    }
+    Return<void> setInitialAttachApn_1_4(int32_t, const V1_4::DataProfileInfo&) override {
+        return {};
+    }
+    Return<void> setDataProfile_1_4(int32_t, const hidl_vec<V1_4::DataProfileInfo>&) override {
+        return {};
+    }
+    Return<void> emergencyDial(int32_t, const V1_0::Dial&,
+                               hidl_bitfield<V1_4::EmergencyServiceCategory>,
+                               const hidl_vec<hidl_string>&, V1_4::EmergencyCallRouting, bool,
+                               bool) override {
+        return {};
+    }
+    Return<void> startNetworkScan_1_4(int32_t, const V1_2::NetworkScanRequest&) override {
+        return {};
+    }
+    Return<void> getPreferredNetworkTypeBitmap(int32_t) override { return {}; }
+    Return<void> setPreferredNetworkTypeBitmap(int32_t,
+                                               hidl_bitfield<V1_4::RadioAccessFamily>) override {
+        return {};
+    }
+    Return<void> setAllowedCarriers_1_4(int32_t, const V1_4::CarrierRestrictionsWithPriority&,
+                                        V1_4::SimLockMultiSimPolicy) override {
+        return {};
+    }
+    Return<void> getAllowedCarriers_1_4(int32_t) override { return {}; }
+    Return<void> getSignalStrength_1_4(int32_t) override { return {}; }
+
+    // IRadio @ 1.5
+    Return<void> setSignalStrengthReportingCriteria_1_5(int32_t, const V1_5::SignalThresholdInfo&,
+                                                        V1_5::AccessNetwork) override {
+        return {};
+    }
+    Return<void> setLinkCapacityReportingCriteria_1_5(int32_t, int32_t, int32_t, int32_t,
+                                                      const hidl_vec<int32_t>&,
+                                                      const hidl_vec<int32_t>&,
+                                                      V1_5::AccessNetwork) override {
+        return {};
+    }
+    Return<void> enableUiccApplications(int32_t, bool) override { return {}; }
+    Return<void> areUiccApplicationsEnabled(int32_t) override { return {}; }
+            int32_t, bool, const hidl_vec<V1_5::RadioAccessSpecifier>&) override {
+        return {};
+    }
+    Return<void> startNetworkScan_1_5(int32_t, const V1_5::NetworkScanRequest&) override {
+        return {};
+    }
+    Return<void> setupDataCall_1_5(int32_t, V1_5::AccessNetwork, const V1_5::DataProfileInfo&, bool,
+                                   V1_2::DataRequestReason, const hidl_vec<V1_5::LinkAddress>&,
+                                   const hidl_vec<hidl_string>&) override {
+        return {};
+    }
+    Return<void> setInitialAttachApn_1_5(int32_t, const V1_5::DataProfileInfo&) override {
+        return {};
+    }
+    Return<void> setDataProfile_1_5(int32_t, const hidl_vec<V1_5::DataProfileInfo>&) override {
+        return {};
+    }
+    Return<void> setRadioPower_1_5(int32_t, bool, bool, bool) override { return {}; }
+    Return<void> setIndicationFilter_1_5(int32_t, hidl_bitfield<V1_5::IndicationFilter>) override {
+        return {};
+    }
+    Return<void> getBarringInfo(int32_t) override { return {}; }
+    Return<void> getVoiceRegistrationState_1_5(int32_t) override { return {}; }
+    Return<void> getDataRegistrationState_1_5(int32_t) override { return {}; }
+    Return<void> setNetworkSelectionModeManual_1_5(int32_t, const hidl_string&,
+                                                   V1_5::RadioAccessNetworks) override {
+        return {};
+    }
+    Return<void> sendCdmaSmsExpectMore(int32_t, const V1_0::CdmaSmsMessage&) override { return {}; }
+    Return<void> supplySimDepersonalization(int32_t, V1_5::PersoSubstate,
+                                            const hidl_string&) override {
+        return {};
+    }
+
+  private:
+    std::mutex mGuard;
+    std::condition_variable mRegistered;
+    sp<V1_0::IRadioIndication> mIndication;
+    std::atomic<int> mAcks = 0;
+};
+
+}  // namespace android::hardware::radio::compat
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FakeRadio.h"
+
+#include <libradiocompat/CallbackManager.h>
+#include <libradiocompat/RadioIndication.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace android::hardware::radio::compat {
+namespace {
+
+using namespace std::chrono_literals;
+namespace aidl = ::aidl::android::hardware::radio;
+
+using Policy = IndicationFilter::Policy;
+
+/** Stands in for the framework, recording what the compat layer delivers. */
+class FakeNetworkIndication : public aidl::network::IRadioNetworkIndicationDefault {
+  public:
+    ndk::ScopedAStatus currentSignalStrength(
+            aidl::RadioIndicationType type,
+            const aidl::network::SignalStrength& signalStrength) override {
+        std::lock_guard<std::mutex> lock(mGuard);
+        mTypes.push_back(type);
+        mGsmStrengths.push_back(signalStrength.gsm.signalStrength);
+        mDelivered.notify_all();
+        return ndk::ScopedAStatus::ok();
+    }
+
+    /** Waits for the last delivered signal strength to be the given one. */
+    bool waitForLastGsmStrength(int32_t gsm) {
+        std::unique_lock<std::mutex> lock(mGuard);
+        return mDelivered.wait_for(lock, 5s, [this, gsm]() {
+            return !mGsmStrengths.empty() && mGsmStrengths.back() == gsm;
+        });
+    }
+
+    std::vector<int32_t> gsmStrengths() {
+        std::lock_guard<std::mutex> lock(mGuard);
+        return mGsmStrengths;
+    }
+
+    std::vector<aidl::RadioIndicationType> types() {
+        std::lock_guard<std::mutex> lock(mGuard);
+        return mTypes;
+    }
+
+  private:
+    std::mutex mGuard;
+    std::condition_variable mDelivered;
+    std::vector<int32_t> mGsmStrengths;
+    std::vector<aidl::RadioIndicationType> mTypes;
+};
+
+class IndicationFilterTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mIndication = sp<RadioIndication>::make(std::make_shared<DriverContext>());
+        mFramework = ndk::SharedRefBase::make<FakeNetworkIndication>();
+        mIndication->setResponseFunction(
+                std::static_pointer_cast<aidl::network::IRadioNetworkIndication>(mFramework));
+        mIndication->indicationFilter().setAckFunction([this]() { mAcks++; });
+    }
+
+    /** Plays the role of the HIDL modem sending a signal strength indication. */
+    void modemSendsSignalStrength(uint32_t gsm, V1_0::RadioIndicationType type =
+                                                        V1_0::RadioIndicationType::UNSOLICITED) {
+        V1_6::SignalStrength signalStrength = {};
+        signalStrength.gsm.signalStrength = gsm;
+        sp<V1_6::IRadioIndication> hidl = mIndication;
+        hidl->currentSignalStrength_1_6(type, signalStrength).assertOk();
+    }
+
+    IndicationFilter::Counters counters() {
+        return mIndication->indicationFilter().getCounters("currentSignalStrength");
+    }
+
+    sp<RadioIndication> mIndication;
+    std::shared_ptr<FakeNetworkIndication> mFramework;
+    std::atomic<int> mAcks = 0;
+};
+
+TEST_F(IndicationFilterTest, PassThroughByDefault) {
+    for (int i = 0; i < 5; i++) modemSendsSignalStrength(10);
+
+    EXPECT_EQ(mFramework->gsmStrengths(), std::vector<int32_t>(5, 10));
+    EXPECT_EQ(counters().delivered, 5u);
+    EXPECT_EQ(counters().dropped, 0u);
+}
+
+TEST_F(IndicationFilterTest, SuppressIdentical) {
+    mIndication->indicationFilter().configure("currentSignalStrength",
+                                              {.policy = Policy::SUPPRESS_IDENTICAL});
+
+    modemSendsSignalStrength(10);
+    modemSendsSignalStrength(10);
+    modemSendsSignalStrength(10, V1_0::RadioIndicationType::UNSOLICITED_ACK_EXP);
+    modemSendsSignalStrength(11);
+    modemSendsSignalStrength(10);
+
+    EXPECT_EQ(mFramework->gsmStrengths(), (std::vector<int32_t>{10, 11, 10}));
+    EXPECT_EQ(counters().delivered, 3u);
+    EXPECT_EQ(counters().dropped, 2u);
+    // The dropped UNSOLICITED_ACK_EXP indication is acknowledged on the framework's behalf.
+    EXPECT_EQ(mAcks, 1);
+}
+
+TEST_F(IndicationFilterTest, CoalesceDeliversLatestPerWindow) {
+    mIndication->indicationFilter().configure("currentSignalStrength",
+                                              {.policy = Policy::COALESCE, .window = 200ms});
+
+    for (uint32_t i = 0; i < 10; i++) {
+        modemSendsSignalStrength(i, V1_0::RadioIndicationType::UNSOLICITED_ACK_EXP);
+    }
+    EXPECT_EQ(mFramework->gsmStrengths(), std::vector<int32_t>{0});
+
+    ASSERT_TRUE(mFramework->waitForLastGsmStrength(9));
+    EXPECT_EQ(mFramework->gsmStrengths(), (std::vector<int32_t>{0, 9}));
+    EXPECT_EQ(counters().delivered, 2u);
+    EXPECT_EQ(counters().merged, 8u);
+    // Deferred indications are acknowledged right away and delivered as UNSOLICITED.
+    EXPECT_EQ(mAcks, 9);
+    EXPECT_EQ(mFramework->types()[1], aidl::RadioIndicationType::UNSOLICITED);
+}
+
+TEST_F(IndicationFilterTest, CoalescePreservesOrdering) {
+    mIndication->indicationFilter().configure("currentSignalStrength",
+                                              {.policy = Policy::COALESCE, .window = 50ms});
+
+    for (uint32_t i = 0; i < 200; i++) {
+        modemSendsSignalStrength(i);
+        // Let the pending indication go out every now and then, so that later ones start new
+        // windows while earlier ones are still being flushed.
+        if (i % 20 == 19) {
+            ASSERT_TRUE(mFramework->waitForLastGsmStrength(i));
+        }
+    }
+
+    const auto delivered = mFramework->gsmStrengths();
+    ASSERT_FALSE(delivered.empty());
+    EXPECT_TRUE(std::is_sorted(delivered.begin(), delivered.end()));
+    EXPECT_EQ(delivered.back(), 199);
+    EXPECT_EQ(counters().delivered + counters().merged, 200u);
+}
+
+/** Runs the indications through the callback manager, which acknowledges them to the modem. */
+class IndicationAckTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mModem = sp<FakeRadio>::make();
+        mCallbackManager =
+                std::make_unique<CallbackManager>(std::make_shared<DriverContext>(), mModem);
+        mFramework = ndk::SharedRefBase::make<FakeNetworkIndication>();
+        mCallbackManager->setResponseFunctions(
+                ndk::SharedRefBase::make<aidl::network::IRadioNetworkResponseDefault>(),
+                std::static_pointer_cast<aidl::network::IRadioNetworkIndication>(mFramework));
+        const auto registered = mModem->waitForIndication();
+        ASSERT_NE(registered, nullptr);
+        mIndication = V1_6::IRadioIndication::castFrom(registered);
+        ASSERT_NE(mIndication, nullptr);
+    }
+
+    void modemSendsSignalStrength(uint32_t gsm, V1_0::RadioIndicationType type) {
+        V1_6::SignalStrength signalStrength = {};
+        signalStrength.gsm.signalStrength = gsm;
+        mIndication->currentSignalStrength_1_6(type, signalStrength).assertOk();
+    }
+
+    sp<FakeRadio> mModem;
+    std::unique_ptr<CallbackManager> mCallbackManager;
+    std::shared_ptr<FakeNetworkIndication> mFramework;
+    sp<V1_6::IRadioIndication> mIndication;
+};
+
+TEST_F(IndicationAckTest, AcknowledgesDroppedIndications) {
+    mCallbackManager->indicationFilter().configure("currentSignalStrength",
+                                                   {.policy = Policy::SUPPRESS_IDENTICAL});
+
+    modemSendsSignalStrength(10, V1_0::RadioIndicationType::UNSOLICITED_ACK_EXP);
+    modemSendsSignalStrength(10, V1_0::RadioIndicationType::UNSOLICITED_ACK_EXP);
+    modemSendsSignalStrength(10, V1_0::RadioIndicationType::UNSOLICITED);
+
+    // Delivered indications are left for the framework to acknowledge, and UNSOLICITED ones
+    // aren't acknowledged at all.
+    EXPECT_EQ(mFramework->gsmStrengths(), std::vector<int32_t>{10});
+    EXPECT_EQ(mFramework->types(),
+              std::vector<aidl::RadioIndicationType>{
+                      aidl::RadioIndicationType::UNSOLICITED_ACK_EXP});
+    EXPECT_EQ(mModem->acks(), 1);
+}
+
+TEST_F(IndicationAckTest, AcknowledgesCoalescedIndications) {
+    mCallbackManager->indicationFilter().configure("currentSignalStrength",
+                                                   {.policy = Policy::COALESCE, .window = 1h});
+
+    for (uint32_t i = 0; i < 5; i++) {
+        modemSendsSignalStrength(i, V1_0::RadioIndicationType::UNSOLICITED_ACK_EXP);
+    }
+    modemSendsSignalStrength(5, V1_0::RadioIndicationType::UNSOLICITED);
+
+    // The first is delivered, the others wait for the end of the window and are acknowledged
+    // meanwhile, so that the modem can release its wakelock.
+    EXPECT_EQ(mFramework->gsmStrengths(), std::vector<int32_t>{0});
+    EXPECT_EQ(mModem->acks(), 4);
+}
+
+}  // namespace
+}  // namespace android::hardware::radio::compat
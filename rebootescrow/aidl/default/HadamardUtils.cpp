@@ -33,8 +33,26 @@ static inline uint8_t read_bit(const std::vector<uint8_t>& input, size_t bit) {
 constexpr uint64_t RNG_MODULUS = 0x7fffffff;
 constexpr uint64_t RNG_MUL = 742938285;
 constexpr uint64_t RNG_SEED = 20170705;
-constexpr uint64_t RNG_INV_MUL = 1413043504;   // (mul * inv_mul) % modulus == 1
-constexpr uint64_t RNG_INV_SEED = 1173538311;  // (seed * mul**65534) % modulus
+
+static_assert(OUTPUT_SIZE_BYTES <= 1u << 16, "shuffle indices must fit in uint16_t");
+
+// The Fisher-Yates shuffle doesn't depend on the data, so it's computed once: byte i of the
+// unshuffled encoding is byte ShuffleTable()[i] of the shuffled one.
+static const std::vector<uint16_t>& ShuffleTable() {
+    static const std::vector<uint16_t> table = [] {
+        std::vector<uint16_t> source(OUTPUT_SIZE_BYTES, 0);
+        uint64_t rng_state = RNG_SEED;
+        for (size_t i = 1; i < OUTPUT_SIZE_BYTES; i++) {
+            auto j = rng_state % (i + 1);
+            source[i] = source[j];
+            source[j] = i;
+            rng_state *= RNG_MUL;
+            rng_state %= RNG_MODULUS;
+        }
+        return source;
+    }();
+    return table;
+}
 
 // Apply an error correcting encoding.
 //
@@ -52,7 +70,7 @@ constexpr uint64_t RNG_INV_SEED = 1173538311;  // (seed * mul**65534) % modulus
 // ones, and this ensures that errors will be random.
 std::vector<uint8_t> EncodeKey(const std::vector<uint8_t>& input) {
     CHECK_EQ(input.size(), KEY_SIZE_IN_BYTES);
-    std::vector<uint8_t> result(OUTPUT_SIZE_BYTES, 0);
+    std::vector<uint8_t> encoded(OUTPUT_SIZE_BYTES, 0);
     static_assert(OUTPUT_SIZE_BYTES == 64 * 1024);
     // Transpose the key so that each row contains one bit from each codeword
     uint16_t wordmatrix[CODEWORD_BITS];
@@ -74,55 +92,81 @@ std::vector<uint8_t> EncodeKey(const std::vector<uint8_t>& input) {
                 break;
             }
         }
-        result[ix * KEY_CODEWORD_BYTES] = val & 0xffu;
-        result[ix * KEY_CODEWORD_BYTES + 1] = val >> 8u;
+        encoded[ix * KEY_CODEWORD_BYTES] = val & 0xffu;
+        encoded[ix * KEY_CODEWORD_BYTES + 1] = val >> 8u;
     }
     // Apply the inverse shuffle here; we apply the forward shuffle in decoding.
-    uint64_t rng_state = RNG_INV_SEED;
-    for (size_t i = OUTPUT_SIZE_BYTES - 1; i > 0; i--) {
-        auto j = rng_state % (i + 1);
-        auto t = result[i];
-        result[i] = result[j];
-        result[j] = t;
-        rng_state *= RNG_INV_MUL;
-        rng_state %= RNG_MODULUS;
+    const auto& table = ShuffleTable();
+    std::vector<uint8_t> result(OUTPUT_SIZE_BYTES, 0);
+    for (size_t i = 0; i < OUTPUT_SIZE_BYTES; i++) {
+        result[table[i]] = encoded[i];
     }
     return result;
 }
 
-// Constant-time conditional copy, to fix b/146520538
-// ctl must be 0 or 1; we do the copy if it's 1.
-static void CondCopy(uint32_t ctl, void* dest, const void* src, size_t len) {
-    const auto cdest = reinterpret_cast<uint8_t*>(dest);
-    const auto csrc = reinterpret_cast<const uint8_t*>(src);
-    for (size_t i = 0; i < len; i++) {
-        const uint32_t d = cdest[i];
-        const uint32_t s = csrc[i];
-        cdest[i] = d ^ (-ctl & (s ^ d));
+// The decoder works on all the codewords at once: row i of the score matrix holds, for each
+// codeword, the score of bit i of its encoding. Every step of the transform then applies the same
+// operation to the KEY_CODEWORDS lanes of a row, which compilers turn into SIMD instructions.
+constexpr size_t LANES = KEY_CODEWORDS;
+
+// Stages of the transform done on blocks of rows small enough to stay in the L1 cache, before
+// the remaining stages run over the whole matrix.
+constexpr uint32_t BLOCK_STAGES = 10;
+static_assert(BLOCK_STAGES < CODE_K);
+
+// After n stages, scores are between -2^n and 2^n, so all the stages but the last fit in int16_t
+// as long as 2^(CODE_K - 1) <= INT16_MAX.
+static_assert(CODE_K - 1 < 15, "scores of the first stages must fit in int16_t");
+
+static inline void Butterfly(int16_t* __restrict a, int16_t* __restrict b) {
+    for (size_t lane = 0; lane < LANES; lane++) {
+        const int16_t a0 = a[lane];
+        const int16_t a1 = b[lane];
+        a[lane] = static_cast<int16_t>(a0 + a1);
+        b[lane] = static_cast<int16_t>(a0 - a1);
     }
 }
 
-struct CodewordWinner {
-    uint16_t codeword;
-    int32_t score;
-};
-
-// Replace dest with src if it has a higher score
-static void CopyWinner(CodewordWinner* dest, const CodewordWinner& src) {
-    // Scores are between - 2^15 and 2^15, so taking the difference won't
-    // overflow; we use the sign bit of the difference here.
-    CondCopy(static_cast<uint32_t>(dest->score - src.score) >> 31, dest, &src,
-             sizeof(CodewordWinner));
+// Runs the stages [first, last) of the transform on the given number of rows.
+static void TransformStages(int16_t* rows, uint32_t first, uint32_t last, size_t count) {
+    for (uint32_t i = first; i < last; i++) {
+        const size_t step = 1u << i;
+        for (size_t j = 0; j < count; j += 2 * step) {
+            for (size_t k = j; k < j + step; k++) {
+                Butterfly(rows + k * LANES, rows + (k + step) * LANES);
+            }
+        }
+    }
 }
 
-// Decode a single codeword. Because of the way codewords are striped together
-// this takes the entire input, plus an offset telling it which word to decode.
-static uint16_t DecodeWord(size_t word, const std::vector<uint8_t>& encoded) {
-    std::vector<int32_t> scores;
-    scores.reserve(ENCODE_LENGTH);
-    // Convert x -> -1^x in the encoded bits. e.g [1, 0, 0, 1] -> [-1, 1, 1, -1]
-    for (uint32_t i = 0; i < ENCODE_LENGTH; i++) {
-        scores.push_back(1 - 2 * read_bit(encoded, i * KEY_CODEWORDS + word));
+// Constant-time version of: if (score > best_score) { best_score = score; best_codeword = codeword; }
+// for each lane, to fix b/146520538. On ties the earlier codeword is kept.
+static inline void SelectWinners(int32_t* __restrict best_score, int32_t* __restrict best_codeword,
+                                 const int32_t* __restrict score, int32_t codeword) {
+    for (size_t lane = 0; lane < LANES; lane++) {
+        // Scores are between - 2^15 and 2^15, so taking the difference won't
+        // overflow; we use the sign bit of the difference here.
+        const uint32_t ctl = static_cast<uint32_t>(best_score[lane] - score[lane]) >> 31;
+        const int32_t mask = -static_cast<int32_t>(ctl);
+        best_score[lane] ^= mask & (best_score[lane] ^ score[lane]);
+        best_codeword[lane] ^= mask & (best_codeword[lane] ^ codeword);
+    }
+}
+
+std::vector<uint8_t> KeyDecoder::Decode(const std::vector<uint8_t>& shuffled) {
+    CHECK_EQ(OUTPUT_SIZE_BYTES, shuffled.size());
+    scores_.resize(ENCODE_LENGTH * LANES);
+    int16_t* rows = scores_.data();
+
+    // Apply the forward Fisher-Yates shuffle and convert x -> -1^x in the encoded bits,
+    // e.g [1, 0, 0, 1] -> [-1, 1, 1, -1].
+    const auto& table = ShuffleTable();
+    for (size_t i = 0; i < ENCODE_LENGTH; i++) {
+        const uint32_t word = shuffled[table[i * KEY_CODEWORD_BYTES]] |
+                              shuffled[table[i * KEY_CODEWORD_BYTES + 1]] << 8u;
+        for (size_t lane = 0; lane < LANES; lane++) {
+            rows[i * LANES + lane] = static_cast<int16_t>(1 - 2 * ((word >> lane) & 1u));
+        }
     }
 
     // Multiply the hadamard matrix by the transformed input.
@@ -130,50 +174,54 @@ static uint16_t DecodeWord(size_t word, const std::vector<uint8_t>& encoded) {
     // |1 -1  1 -1|  *  | 1|  =  | 0|
     // |1  1 -1 -1|     | 1|     | 0|
     // |1 -1 -1  1|     |-1|     |-4|
-    for (uint32_t i = 0; i < CODE_K; i++) {
-        uint16_t step = 1u << i;
-        for (uint32_t j = 0; j < ENCODE_LENGTH; j += 2 * step) {
-            for (uint32_t k = j; k < j + step; k++) {
-                auto a0 = scores[k];
-                auto a1 = scores[k + step];
-                scores[k] = a0 + a1;
-                scores[k + step] = a0 - a1;
-            }
-        }
+    constexpr size_t BLOCK_ROWS = 1u << BLOCK_STAGES;
+    for (size_t block = 0; block < ENCODE_LENGTH; block += BLOCK_ROWS) {
+        TransformStages(rows + block * LANES, 0, BLOCK_STAGES, BLOCK_ROWS);
     }
-    // -ENCODE_LENGTH is least possible score, so start one less than that
-    auto best = CodewordWinner{0, -static_cast<int32_t>(ENCODE_LENGTH + 1)};
+    TransformStages(rows, BLOCK_STAGES, CODE_K - 1, ENCODE_LENGTH);
+
+    // The last stage may reach 2^15, so it's done in int32_t while looking for the best codeword.
     // For every possible codeword value, look at its score, and replace best if it's higher,
-    // in constant time.
-    for (size_t i = 0; i < ENCODE_LENGTH; i++) {
-        CopyWinner(&best, CodewordWinner{static_cast<uint16_t>(i), scores[i]});
-        CopyWinner(&best, CodewordWinner{static_cast<uint16_t>(i | (1 << CODE_K)), -scores[i]});
+    // in constant time. Codewords are visited in increasing order, with each one followed by its
+    // complement, so that ties are resolved the same way as by a plain scan.
+    // -ENCODE_LENGTH is least possible score, so start one less than that
+    int32_t best_score[LANES];
+    int32_t best_codeword[LANES];
+    for (size_t lane = 0; lane < LANES; lane++) {
+        best_score[lane] = -static_cast<int32_t>(ENCODE_LENGTH + 1);
+        best_codeword[lane] = 0;
     }
-    return best.codeword;
-}
-
-std::vector<uint8_t> DecodeKey(const std::vector<uint8_t>& shuffled) {
-    CHECK_EQ(OUTPUT_SIZE_BYTES, shuffled.size());
-    // Apply the forward Fisher-Yates shuffle.
-    std::vector<uint8_t> encoded(OUTPUT_SIZE_BYTES, 0);
-    encoded[0] = shuffled[0];
-    uint64_t rng_state = RNG_SEED;
-    for (size_t i = 1; i < OUTPUT_SIZE_BYTES; i++) {
-        auto j = rng_state % (i + 1);
-        encoded[i] = encoded[j];
-        encoded[j] = shuffled[i];
-        rng_state *= RNG_MUL;
-        rng_state %= RNG_MODULUS;
+    constexpr size_t HALF = ENCODE_LENGTH / 2;
+    for (int32_t sign : {1, -1}) {
+        const int32_t offset = sign > 0 ? 0 : HALF;
+        for (size_t k = 0; k < HALF; k++) {
+            const int16_t* a = rows + k * LANES;
+            const int16_t* b = rows + (k + HALF) * LANES;
+            int32_t score[LANES];
+            int32_t complement[LANES];
+            for (size_t lane = 0; lane < LANES; lane++) {
+                score[lane] = a[lane] + sign * b[lane];
+                complement[lane] = -score[lane];
+            }
+            const int32_t codeword = offset + k;
+            SelectWinners(best_score, best_codeword, score, codeword);
+            SelectWinners(best_score, best_codeword, complement, codeword | (1 << CODE_K));
+        }
     }
+
     std::vector<uint8_t> result(KEY_SIZE_IN_BYTES, 0);
     for (size_t i = 0; i < KEY_CODEWORDS; i++) {
-        uint16_t val = DecodeWord(i, encoded);
+        uint16_t val = best_codeword[i];
         result[i * CODEWORD_BYTES] = val & 0xffu;
         result[i * CODEWORD_BYTES + 1] = val >> 8u;
     }
     return result;
 }
 
+std::vector<uint8_t> DecodeKey(const std::vector<uint8_t>& shuffled) {
+    return KeyDecoder().Decode(shuffled);
+}
+
 }  // namespace hadamard
 }  // namespace rebootescrow
 }  // namespace hardware
@@ -43,6 +43,15 @@ std::vector<uint8_t> EncodeKey(const std::vector<uint8_t>& input);
 // Given a byte array representation of the encoded keys, decodes it and return the result.
 std::vector<uint8_t> DecodeKey(const std::vector<uint8_t>& encoded);
 
+// Same as DecodeKey, but keeps its scratch buffer (1 MiB) between calls.
+class KeyDecoder {
+  public:
+    std::vector<uint8_t> Decode(const std::vector<uint8_t>& encoded);
+
+  private:
+    std::vector<int16_t> scores_;
+};
+
 }  // namespace hadamard
 }  // namespace rebootescrow
 }  // namespace hardware
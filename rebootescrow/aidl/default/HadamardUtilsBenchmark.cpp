@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include <HadamardUtils.h>
+
+using namespace aidl::android::hardware::rebootescrow::hadamard;
+
+static std::vector<uint8_t> RandomKey() {
+    std::mt19937 rng(1);
+    std::vector<uint8_t> key(KEY_SIZE_IN_BYTES);
+    for (auto& b : key) {
+        b = rng() & 0xff;
+    }
+    return key;
+}
+
+static void BM_EncodeKey(benchmark::State& state) {
+    const auto key = RandomKey();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(EncodeKey(key));
+    }
+}
+BENCHMARK(BM_EncodeKey);
+
+static void BM_DecodeKey(benchmark::State& state) {
+    const auto encoded = EncodeKey(RandomKey());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(DecodeKey(encoded));
+    }
+}
+BENCHMARK(BM_DecodeKey);
+
+static void BM_KeyDecoder_Reused(benchmark::State& state) {
+    const auto encoded = EncodeKey(RandomKey());
+    KeyDecoder decoder;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(decoder.Decode(encoded));
+    }
+}
+BENCHMARK(BM_KeyDecoder_Reused);
+
+BENCHMARK_MAIN();
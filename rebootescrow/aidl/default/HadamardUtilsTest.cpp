@@ -15,6 +15,7 @@
  */
 
 #include <stdint.h>
+#include <algorithm>
 #include <random>
 
 #include <gtest/gtest.h>
@@ -23,8 +24,124 @@
 
 using namespace aidl::android::hardware::rebootescrow::hadamard;
 
+// The original scalar implementation, which the optimized one must match bit for bit.
+namespace reference {
+
+static inline uint8_t read_bit(const std::vector<uint8_t>& input, size_t bit) {
+    return (input[bit >> 3] >> (bit & 7)) & 1u;
+}
+
+constexpr uint64_t RNG_MODULUS = 0x7fffffff;
+constexpr uint64_t RNG_MUL = 742938285;
+constexpr uint64_t RNG_SEED = 20170705;
+constexpr uint64_t RNG_INV_MUL = 1413043504;
+constexpr uint64_t RNG_INV_SEED = 1173538311;
+
+// Applies the inverse Fisher-Yates shuffle, as the encoder does.
+std::vector<uint8_t> Shuffle(std::vector<uint8_t> result) {
+    uint64_t rng_state = RNG_INV_SEED;
+    for (size_t i = OUTPUT_SIZE_BYTES - 1; i > 0; i--) {
+        auto j = rng_state % (i + 1);
+        auto t = result[i];
+        result[i] = result[j];
+        result[j] = t;
+        rng_state *= RNG_INV_MUL;
+        rng_state %= RNG_MODULUS;
+    }
+    return result;
+}
+
+std::vector<uint8_t> EncodeKey(const std::vector<uint8_t>& input) {
+    std::vector<uint8_t> result(OUTPUT_SIZE_BYTES, 0);
+    uint16_t wordmatrix[CODEWORD_BITS];
+    for (size_t i = 0; i < CODEWORD_BITS; i++) {
+        uint16_t word = 0;
+        for (size_t j = 0; j < KEY_CODEWORDS; j++) {
+            word |= read_bit(input, i + j * CODEWORD_BITS) << j;
+        }
+        wordmatrix[i] = word;
+    }
+    uint16_t val = wordmatrix[CODEWORD_BITS - 1];
+    size_t ix = 0;
+    for (size_t i = 0; i < ENCODE_LENGTH; i++) {
+        for (size_t b = 0; b < CODEWORD_BITS; b++) {
+            if (i & (1 << b)) {
+                ix ^= (1 << b);
+                val ^= wordmatrix[b];
+                break;
+            }
+        }
+        result[ix * KEY_CODEWORD_BYTES] = val & 0xffu;
+        result[ix * KEY_CODEWORD_BYTES + 1] = val >> 8u;
+    }
+    return Shuffle(std::move(result));
+}
+
+static uint16_t DecodeWord(size_t word, const std::vector<uint8_t>& encoded) {
+    std::vector<int32_t> scores;
+    scores.reserve(ENCODE_LENGTH);
+    for (uint32_t i = 0; i < ENCODE_LENGTH; i++) {
+        scores.push_back(1 - 2 * read_bit(encoded, i * KEY_CODEWORDS + word));
+    }
+    for (uint32_t i = 0; i < CODE_K; i++) {
+        uint16_t step = 1u << i;
+        for (uint32_t j = 0; j < ENCODE_LENGTH; j += 2 * step) {
+            for (uint32_t k = j; k < j + step; k++) {
+                auto a0 = scores[k];
+                auto a1 = scores[k + step];
+                scores[k] = a0 + a1;
+                scores[k + step] = a0 - a1;
+            }
+        }
+    }
+    uint16_t best_codeword = 0;
+    int32_t best_score = -static_cast<int32_t>(ENCODE_LENGTH + 1);
+    for (size_t i = 0; i < ENCODE_LENGTH; i++) {
+        if (scores[i] > best_score) {
+            best_codeword = i;
+            best_score = scores[i];
+        }
+        if (-scores[i] > best_score) {
+            best_codeword = i | (1 << CODE_K);
+            best_score = -scores[i];
+        }
+    }
+    return best_codeword;
+}
+
+std::vector<uint8_t> DecodeKey(const std::vector<uint8_t>& shuffled) {
+    std::vector<uint8_t> encoded(OUTPUT_SIZE_BYTES, 0);
+    encoded[0] = shuffled[0];
+    uint64_t rng_state = RNG_SEED;
+    for (size_t i = 1; i < OUTPUT_SIZE_BYTES; i++) {
+        auto j = rng_state % (i + 1);
+        encoded[i] = encoded[j];
+        encoded[j] = shuffled[i];
+        rng_state *= RNG_MUL;
+        rng_state %= RNG_MODULUS;
+    }
+    std::vector<uint8_t> result(KEY_SIZE_IN_BYTES, 0);
+    for (size_t i = 0; i < KEY_CODEWORDS; i++) {
+        uint16_t val = DecodeWord(i, encoded);
+        result[i * CODEWORD_BYTES] = val & 0xffu;
+        result[i * CODEWORD_BYTES + 1] = val >> 8u;
+    }
+    return result;
+}
+
+}  // namespace reference
+
 class HadamardTest : public testing::Test {};
 
+static std::vector<uint8_t> RandomBytes(std::mt19937* rng, size_t size) {
+    std::uniform_int_distribution<int> dist(0, 0xff);
+    std::vector<uint8_t> bytes(size);
+    for (auto& b : bytes) {
+        b = dist(*rng);
+    }
+    return bytes;
+}
+
 static void AddError(std::vector<uint8_t>* data) {
     for (size_t i = 0; i < data->size(); i++) {
         for (size_t j = 0; j < BYTE_LENGTH; j++) {
@@ -49,3 +166,67 @@ TEST_F(HadamardTest, Decode_error_correction) {
         ASSERT_EQ(key, std::vector<uint8_t>(decoded.begin(), decoded.begin() + key.size()));
     }
 }
+
+TEST_F(HadamardTest, Encode_matches_reference) {
+    std::mt19937 rng(1);
+    for (int i = 0; i < 20; i++) {
+        auto key = RandomBytes(&rng, KEY_SIZE_IN_BYTES);
+        ASSERT_EQ(reference::EncodeKey(key), EncodeKey(key));
+    }
+}
+
+TEST_F(HadamardTest, Decode_matches_reference) {
+    std::mt19937 rng(2);
+    KeyDecoder decoder;
+    for (int i = 0; i < 10; i++) {
+        // Noisy encodings, and pure noise where many codewords tie for the best score.
+        auto encoded = EncodeKey(RandomBytes(&rng, KEY_SIZE_IN_BYTES));
+        AddError(&encoded);
+        auto noise = RandomBytes(&rng, OUTPUT_SIZE_BYTES);
+        for (const auto& input : {encoded, noise}) {
+            auto expected = reference::DecodeKey(input);
+            ASSERT_EQ(expected, DecodeKey(input));
+            ASSERT_EQ(expected, decoder.Decode(input));
+        }
+    }
+}
+
+TEST_F(HadamardTest, Decode_ties_match_reference) {
+    // Each codeword is replaced by a mix of two codewords a and b, so that both get exactly the
+    // same score, and the decoder has to pick the same one as the reference.
+    std::mt19937 rng(3);
+    for (int iteration = 0; iteration < 5; iteration++) {
+        auto a = RandomBytes(&rng, KEY_SIZE_IN_BYTES);
+        auto b = RandomBytes(&rng, KEY_SIZE_IN_BYTES);
+        auto bit = [](const std::vector<uint8_t>& key, size_t word, uint32_t ix) {
+            uint16_t codeword = key[word * CODEWORD_BYTES] | key[word * CODEWORD_BYTES + 1] << 8u;
+            return ((codeword >> CODE_K) ^ __builtin_parity(codeword & ix & (ENCODE_LENGTH - 1))) &
+                   1u;
+        };
+        std::vector<uint8_t> mixed(OUTPUT_SIZE_BYTES, 0);
+        for (size_t word = 0; word < KEY_CODEWORDS; word++) {
+            // Where a and b disagree, take a's bit on a random half of the rows, b's on the rest.
+            std::vector<uint32_t> disagreements;
+            for (uint32_t ix = 0; ix < ENCODE_LENGTH; ix++) {
+                auto value = bit(a, word, ix);
+                if (value != bit(b, word, ix)) {
+                    disagreements.push_back(ix);
+                }
+                mixed[(ix * KEY_CODEWORDS + word) >> 3] |= value << (word & 7);
+            }
+            std::shuffle(disagreements.begin(), disagreements.end(), rng);
+            for (size_t i = 0; i < disagreements.size() / 2; i++) {
+                mixed[(disagreements[i] * KEY_CODEWORDS + word) >> 3] ^= 1u << (word & 7);
+            }
+        }
+        auto input = reference::Shuffle(mixed);
+        auto expected = reference::DecodeKey(input);
+        ASSERT_EQ(expected, DecodeKey(input));
+        for (size_t word = 0; word < KEY_CODEWORDS; word++) {
+            for (size_t byte = 0; byte < CODEWORD_BYTES; byte++) {
+                const size_t i = word * CODEWORD_BYTES + byte;
+                ASSERT_TRUE(expected[i] == a[i] || expected[i] == b[i]);
+            }
+        }
+    }
+}
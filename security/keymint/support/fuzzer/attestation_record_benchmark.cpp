@@ -0,0 +1,118 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Parsing throughput of the CBS attestation record parser, against the ASN.1 template parser it
+// replaced, on a fixed corpus of valid generated records.
+
+#include <benchmark/benchmark.h>
+#include <fuzzer/FuzzedDataProvider.h>
+
+#include <random>
+#include <vector>
+
+#include <keymint_support/attestation_record.h>
+
+#include "attestation_record_generator.h"
+#include "attestation_record_reference.h"
+
+namespace aidl::android::hardware::security::keymint::test {
+
+namespace {
+
+constexpr size_t kRecordCount = 256;
+constexpr size_t kSeedSize = 2048;
+
+const std::vector<std::vector<uint8_t>>& records() {
+    static const std::vector<std::vector<uint8_t>> records = [] {
+        std::vector<std::vector<uint8_t>> records;
+        std::mt19937 rng(0);
+        std::vector<uint8_t> seed(kSeedSize);
+        while (records.size() < kRecordCount) {
+            for (auto& b : seed) b = rng();
+            FuzzedDataProvider fdp(seed.data(), seed.size());
+            records.push_back(AttestationRecordGenerator(&fdp, false).generate());
+        }
+        return records;
+    }();
+    return records;
+}
+
+template <typename ParseRecord>
+void parseRecords(benchmark::State& state, ParseRecord parseRecord) {
+    size_t bytes = 0;
+    for (auto _ : state) {
+        for (const auto& record : records()) {
+            uint32_t attestationVersion;
+            SecurityLevel attestationSecurityLevel;
+            uint32_t keymintVersion;
+            SecurityLevel keymintSecurityLevel;
+            std::vector<uint8_t> attestationChallenge;
+            AuthorizationSet softwareEnforced;
+            AuthorizationSet teeEnforced;
+            std::vector<uint8_t> uniqueId;
+            benchmark::DoNotOptimize(parseRecord(
+                    record.data(), record.size(), &attestationVersion, &attestationSecurityLevel,
+                    &keymintVersion, &keymintSecurityLevel, &attestationChallenge,
+                    &softwareEnforced, &teeEnforced, &uniqueId));
+            bytes += record.size();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * records().size());
+    state.SetBytesProcessed(bytes);
+}
+
+template <typename ParseRootOfTrust>
+void parseRootsOfTrust(benchmark::State& state, ParseRootOfTrust parseRootOfTrust) {
+    for (auto _ : state) {
+        for (const auto& record : records()) {
+            std::vector<uint8_t> verifiedBootKey;
+            VerifiedBoot verifiedBootState;
+            bool deviceLocked;
+            std::vector<uint8_t> verifiedBootHash;
+            benchmark::DoNotOptimize(parseRootOfTrust(record.data(), record.size(),
+                                                      &verifiedBootKey, &verifiedBootState,
+                                                      &deviceLocked, &verifiedBootHash));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * records().size());
+}
+
+void BM_ParseAttestationRecord_Reference(benchmark::State& state) {
+    parseRecords(state, reference::parse_attestation_record);
+}
+
+void BM_ParseAttestationRecord(benchmark::State& state) {
+    parseRecords(state, parse_attestation_record);
+}
+
+void BM_ParseRootOfTrust_Reference(benchmark::State& state) {
+    parseRootsOfTrust(state, reference::parse_root_of_trust);
+}
+
+void BM_ParseRootOfTrust(benchmark::State& state) {
+    parseRootsOfTrust(state, parse_root_of_trust);
+}
+
+BENCHMARK(BM_ParseAttestationRecord_Reference);
+BENCHMARK(BM_ParseAttestationRecord);
+BENCHMARK(BM_ParseRootOfTrust_Reference);
+BENCHMARK(BM_ParseRootOfTrust);
+
+}  // namespace
+
+}  // namespace aidl::android::hardware::security::keymint::test
+
+BENCHMARK_MAIN();
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Differential fuzzer for the attestation record parser: records are generated from the fuzzer
+// input, and both the CBS parser and the ASN.1 template parser it replaced must agree on them.
+
+#include <fuzzer/FuzzedDataProvider.h>
+
+#include <android-base/logging.h>
+
+#include <keymint_support/attestation_record.h>
+
+#include "attestation_record_generator.h"
+#include "attestation_record_reference.h"
+
+namespace aidl::android::hardware::security::keymint::test {
+
+namespace {
+
+struct ParsedRecord {
+    ErrorCode error;
+    uint32_t attestationVersion = 0;
+    SecurityLevel attestationSecurityLevel = SecurityLevel::SOFTWARE;
+    uint32_t keymintVersion = 0;
+    SecurityLevel keymintSecurityLevel = SecurityLevel::SOFTWARE;
+    std::vector<uint8_t> attestationChallenge;
+    AuthorizationSet softwareEnforced;
+    AuthorizationSet teeEnforced;
+    std::vector<uint8_t> uniqueId;
+
+    ErrorCode rootOfTrustError;
+    std::vector<uint8_t> verifiedBootKey;
+    VerifiedBoot verifiedBootState = VerifiedBoot::VERIFIED;
+    bool deviceLocked = false;
+    std::vector<uint8_t> verifiedBootHash;
+};
+
+template <typename ParseRecord, typename ParseRootOfTrust>
+ParsedRecord parse(const std::vector<uint8_t>& record, ParseRecord parseRecord,
+                   ParseRootOfTrust parseRootOfTrust) {
+    ParsedRecord parsed;
+    parsed.error = parseRecord(record.data(), record.size(), &parsed.attestationVersion,
+                               &parsed.attestationSecurityLevel, &parsed.keymintVersion,
+                               &parsed.keymintSecurityLevel, &parsed.attestationChallenge,
+                               &parsed.softwareEnforced, &parsed.teeEnforced, &parsed.uniqueId);
+    parsed.rootOfTrustError =
+            parseRootOfTrust(record.data(), record.size(), &parsed.verifiedBootKey,
+                             &parsed.verifiedBootState, &parsed.deviceLocked,
+                             &parsed.verifiedBootHash);
+    return parsed;
+}
+
+void checkSame(const ParsedRecord& parsed, const ParsedRecord& expected) {
+    CHECK(parsed.error == expected.error);
+    if (parsed.error == ErrorCode::OK) {
+        CHECK_EQ(parsed.attestationVersion, expected.attestationVersion);
+        CHECK(parsed.attestationSecurityLevel == expected.attestationSecurityLevel);
+        CHECK_EQ(parsed.keymintVersion, expected.keymintVersion);
+        CHECK(parsed.keymintSecurityLevel == expected.keymintSecurityLevel);
+        CHECK(parsed.attestationChallenge == expected.attestationChallenge);
+        CHECK(parsed.softwareEnforced.vector_data() == expected.softwareEnforced.vector_data());
+        CHECK(parsed.teeEnforced.vector_data() == expected.teeEnforced.vector_data());
+        CHECK(parsed.uniqueId == expected.uniqueId);
+    } else {
+        CHECK(parsed.softwareEnforced.empty());
+        CHECK(parsed.teeEnforced.empty());
+    }
+    CHECK(parsed.rootOfTrustError == expected.rootOfTrustError);
+    if (parsed.rootOfTrustError == ErrorCode::OK) {
+        CHECK(parsed.verifiedBootKey == expected.verifiedBootKey);
+        CHECK(parsed.verifiedBootState == expected.verifiedBootState);
+        CHECK_EQ(parsed.deviceLocked, expected.deviceLocked);
+        CHECK(parsed.verifiedBootHash == expected.verifiedBootHash);
+    }
+}
+
+}  // namespace
+
+}  // namespace aidl::android::hardware::security::keymint::test
+
+using namespace aidl::android::hardware::security::keymint;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    FuzzedDataProvider fdp(data, size);
+    // Byte level corruption can produce encodings that aren't DER, which the parsers may treat
+    // differently. Such records must not crash either parser, and must parse the same when both
+    // accept them. Corrupted records that are still DER must be accepted whenever the reference
+    // accepts them.
+    const bool corrupt = fdp.ConsumeIntegralInRange<uint8_t>(0, 7) == 0;
+    const size_t corruptOffset = fdp.ConsumeIntegral<uint16_t>();
+    const uint8_t corruptByte = fdp.ConsumeIntegral<uint8_t>();
+    std::vector<uint8_t> record = test::AttestationRecordGenerator(&fdp, true).generate();
+    if (corrupt && !record.empty()) {
+        record[corruptOffset % record.size()] ^= corruptByte;
+    }
+
+    test::ParsedRecord parsed =
+            test::parse(record, parse_attestation_record, parse_root_of_trust);
+    test::ParsedRecord expected = test::parse(record, reference::parse_attestation_record,
+                                              reference::parse_root_of_trust);
+    if (corrupt && (parsed.error != ErrorCode::OK || expected.error != ErrorCode::OK)) {
+        CHECK(expected.error != ErrorCode::OK ||
+              !reference::is_der_attestation_record(record.data(), record.size()));
+        CHECK(parsed.error == ErrorCode::OK ||
+              (parsed.softwareEnforced.empty() && parsed.teeEnforced.empty()));
+        return 0;
+    }
+    test::checkSame(parsed, expected);
+    return 0;
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "attestation_record_generator.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include <keymint_support/keymint_tags.h>
+
+namespace aidl::android::hardware::security::keymint::test {
+
+namespace {
+
+constexpr uint8_t kUniversal = 0x00;
+constexpr uint8_t kContextSpecific = 0x80;
+constexpr uint8_t kConstructed = 0x20;
+
+constexpr uint32_t kBoolean = 0x01;
+constexpr uint32_t kInteger = 0x02;
+constexpr uint32_t kOctetString = 0x04;
+constexpr uint32_t kNull = 0x05;
+constexpr uint32_t kEnumerated = 0x0a;
+constexpr uint32_t kSequence = 0x10;
+constexpr uint32_t kSet = 0x11;
+
+// Tags of the AuthorizationList fields, in tag order.
+constexpr Tag kAuthListTags[] = {
+        Tag::PURPOSE,
+        Tag::ALGORITHM,
+        Tag::KEY_SIZE,
+        Tag::DIGEST,
+        Tag::PADDING,
+        Tag::EC_CURVE,
+        Tag::RSA_PUBLIC_EXPONENT,
+        Tag::RSA_OAEP_MGF_DIGEST,
+        Tag::ROLLBACK_RESISTANCE,
+        Tag::EARLY_BOOT_ONLY,
+        Tag::ACTIVE_DATETIME,
+        Tag::ORIGINATION_EXPIRE_DATETIME,
+        Tag::USAGE_EXPIRE_DATETIME,
+        Tag::USAGE_COUNT_LIMIT,
+        Tag::NO_AUTH_REQUIRED,
+        Tag::USER_AUTH_TYPE,
+        Tag::AUTH_TIMEOUT,
+        Tag::ALLOW_WHILE_ON_BODY,
+        Tag::TRUSTED_USER_PRESENCE_REQUIRED,
+        Tag::TRUSTED_CONFIRMATION_REQUIRED,
+        Tag::UNLOCKED_DEVICE_REQUIRED,
+        Tag::CREATION_DATETIME,
+        Tag::ORIGIN,
+        Tag::ROOT_OF_TRUST,
+        Tag::OS_VERSION,
+        Tag::OS_PATCHLEVEL,
+        Tag::ATTESTATION_APPLICATION_ID,
+        Tag::ATTESTATION_ID_BRAND,
+        Tag::ATTESTATION_ID_DEVICE,
+        Tag::ATTESTATION_ID_PRODUCT,
+        Tag::ATTESTATION_ID_SERIAL,
+        Tag::ATTESTATION_ID_IMEI,
+        Tag::ATTESTATION_ID_MEID,
+        Tag::ATTESTATION_ID_MANUFACTURER,
+        Tag::ATTESTATION_ID_MODEL,
+        Tag::VENDOR_PATCHLEVEL,
+        Tag::BOOT_PATCHLEVEL,
+        Tag::DEVICE_UNIQUE_ATTESTATION,
+        Tag::IDENTITY_CREDENTIAL_KEY,
+};
+
+// Tags that have no place in an AuthorizationList.
+constexpr Tag kUnknownTags[] = {
+        Tag::BLOCK_MODE,  Tag::CALLER_NONCE, Tag::USER_SECURE_ID,
+        Tag::STORAGE_KEY, Tag::NONCE,        Tag::MAX_BOOT_LEVEL,
+};
+
+uint32_t maskedTag(Tag tag) {
+    return static_cast<uint32_t>(tag) & 0x0FFFFFFF;
+}
+
+void appendElement(uint8_t identifier, uint32_t number, const std::vector<uint8_t>& contents,
+                   std::vector<uint8_t>* out) {
+    if (number < 0x1f) {
+        out->push_back(identifier | number);
+    } else {
+        out->push_back(identifier | 0x1f);
+        uint8_t base128[5];
+        size_t len = 0;
+        do {
+            base128[len++] = number & 0x7f;
+            number >>= 7;
+        } while (number);
+        while (len > 1) out->push_back(base128[--len] | 0x80);
+        out->push_back(base128[0]);
+    }
+    size_t size = contents.size();
+    if (size < 0x80) {
+        out->push_back(size);
+    } else {
+        uint8_t lengthBytes[sizeof(size)];
+        size_t len = 0;
+        for (; size; size >>= 8) lengthBytes[len++] = size & 0xff;
+        out->push_back(0x80 | len);
+        while (len) out->push_back(lengthBytes[--len]);
+    }
+    out->insert(out->end(), contents.begin(), contents.end());
+}
+
+std::vector<uint8_t> element(uint8_t identifier, uint32_t number,
+                             const std::vector<uint8_t>& contents) {
+    std::vector<uint8_t> out;
+    appendElement(identifier, number, contents, &out);
+    return out;
+}
+
+// Strips the leading bytes that a DER INTEGER doesn't allow.
+std::vector<uint8_t> minimalInteger(std::vector<uint8_t> bytes) {
+    if (bytes.empty()) return {0};
+    size_t start = 0;
+    while (start + 1 < bytes.size() &&
+           ((bytes[start] == 0x00 && !(bytes[start + 1] & 0x80)) ||
+            (bytes[start] == 0xff && (bytes[start + 1] & 0x80)))) {
+        ++start;
+    }
+    return std::vector<uint8_t>(bytes.begin() + start, bytes.end());
+}
+
+std::vector<uint8_t> int64Bytes(int64_t value) {
+    std::vector<uint8_t> bytes(sizeof(value));
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        bytes[bytes.size() - 1 - i] = static_cast<uint64_t>(value) >> (8 * i);
+    }
+    return minimalInteger(bytes);
+}
+
+}  // namespace
+
+bool AttestationRecordGenerator::oneIn(uint8_t n) {
+    return mFdp->ConsumeIntegralInRange<uint8_t>(1, n) == 1;
+}
+
+std::vector<uint8_t> AttestationRecordGenerator::integer() {
+    switch (mFdp->ConsumeIntegralInRange<uint8_t>(0, 3)) {
+        case 0:
+            return int64Bytes(mFdp->ConsumeIntegralInRange<int64_t>(0, 1024));
+        case 1:
+            return int64Bytes(mFdp->ConsumeIntegral<uint32_t>());
+        case 2:
+            return int64Bytes(mFdp->ConsumeIntegral<int64_t>());
+        default:
+            // Up to 80 bits, to go past what fits in a long or a BN_ULONG.
+            return minimalInteger(
+                    mFdp->ConsumeBytes<uint8_t>(mFdp->ConsumeIntegralInRange<size_t>(1, 10)));
+    }
+}
+
+std::vector<uint8_t> AttestationRecordGenerator::bytes() {
+    return mFdp->ConsumeBytes<uint8_t>(mFdp->ConsumeIntegralInRange<size_t>(0, 200));
+}
+
+std::vector<uint8_t> AttestationRecordGenerator::rootOfTrust() {
+    std::vector<uint8_t> contents;
+    appendElement(kUniversal, kOctetString, bytes(), &contents);
+    // DER booleans are 0x00 or 0xff, other values are left to invalid records.
+    uint8_t locked = mFdp->ConsumeBool() ? 0xff : 0x00;
+    if (mAllowInvalid && oneIn(16)) locked = mFdp->ConsumeIntegral<uint8_t>();
+    appendElement(kUniversal, kBoolean, {locked}, &contents);
+    appendElement(kUniversal, kEnumerated, integer(), &contents);
+    appendElement(kUniversal, kOctetString, bytes(), &contents);
+    return element(kUniversal | kConstructed, kSequence, contents);
+}
+
+std::vector<uint8_t> AttestationRecordGenerator::value(Tag tag) {
+    if (tag == Tag::ROOT_OF_TRUST) return rootOfTrust();
+    switch (typeFromTag(tag)) {
+        case TagType::ENUM_REP:
+        case TagType::UINT_REP:
+        case TagType::ULONG_REP: {
+            std::vector<uint8_t> set;
+            for (size_t count = mFdp->ConsumeIntegralInRange<size_t>(0, 4); count > 0; --count) {
+                appendElement(kUniversal, kInteger, integer(), &set);
+            }
+            return element(kUniversal | kConstructed, kSet, set);
+        }
+        case TagType::ENUM:
+        case TagType::UINT:
+        case TagType::ULONG:
+        case TagType::DATE:
+            return element(kUniversal, kInteger, integer());
+        case TagType::BOOL: {
+            std::vector<uint8_t> null;
+            if (mAllowInvalid && oneIn(32)) null.push_back(0);
+            return element(kUniversal, kNull, null);
+        }
+        default:
+            return element(kUniversal, kOctetString, bytes());
+    }
+}
+
+std::vector<uint8_t> AttestationRecordGenerator::authorizationList() {
+    std::vector<Tag> tags;
+    for (Tag tag : kAuthListTags) {
+        if (mFdp->ConsumeBool()) tags.push_back(tag);
+    }
+    if (mAllowInvalid && !tags.empty() && oneIn(16)) {
+        const size_t i = mFdp->ConsumeIntegralInRange<size_t>(0, tags.size() - 1);
+        const size_t j = mFdp->ConsumeIntegralInRange<size_t>(0, tags.size() - 1);
+        std::swap(tags[i], tags[j]);
+    }
+    if (mAllowInvalid && !tags.empty() && oneIn(16)) {
+        const size_t i = mFdp->ConsumeIntegralInRange<size_t>(0, tags.size() - 1);
+        tags.insert(tags.begin() + i, tags[i]);
+    }
+    if (mAllowInvalid && oneIn(16)) {
+        const size_t i = mFdp->ConsumeIntegralInRange<size_t>(0, tags.size());
+        const size_t unknown =
+                mFdp->ConsumeIntegralInRange<size_t>(0, std::size(kUnknownTags) - 1);
+        tags.insert(tags.begin() + i, kUnknownTags[unknown]);
+    }
+
+    std::vector<uint8_t> fields;
+    for (Tag tag : tags) {
+        std::vector<uint8_t> fieldValue = value(tag);
+        // Explicitly tagged fields hold exactly one element.
+        if (mAllowInvalid && oneIn(64)) appendElement(kUniversal, kNull, {}, &fieldValue);
+        appendElement(kContextSpecific | kConstructed, maskedTag(tag), fieldValue, &fields);
+    }
+    return element(kUniversal | kConstructed, kSequence, fields);
+}
+
+std::vector<uint8_t> AttestationRecordGenerator::generate() {
+    // The type of each KeyDescription field, one of them is changed in some invalid records.
+    uint32_t types[] = {kInteger, kEnumerated, kInteger, kEnumerated, kOctetString, kOctetString};
+    if (mAllowInvalid && oneIn(32)) {
+        types[mFdp->ConsumeIntegralInRange<size_t>(0, std::size(types) - 1)] = kNull;
+    }
+
+    std::vector<uint8_t> contents;
+    for (uint32_t type : types) {
+        appendElement(kUniversal, type, type == kOctetString ? bytes() : integer(), &contents);
+    }
+    std::vector<uint8_t> softwareEnforced = authorizationList();
+    contents.insert(contents.end(), softwareEnforced.begin(), softwareEnforced.end());
+    std::vector<uint8_t> teeEnforced = authorizationList();
+    contents.insert(contents.end(), teeEnforced.begin(), teeEnforced.end());
+    if (mAllowInvalid && oneIn(32)) appendElement(kUniversal, kNull, {}, &contents);
+    return element(kUniversal | kConstructed, kSequence, contents);
+}
+
+}  // namespace aidl::android::hardware::security::keymint::test
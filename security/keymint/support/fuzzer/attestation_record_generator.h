@@ -0,0 +1,55 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <fuzzer/FuzzedDataProvider.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <aidl/android/hardware/security/keymint/Tag.h>
+
+namespace aidl::android::hardware::security::keymint::test {
+
+/**
+ * Writes DER-encoded attestation records, with their contents picked by a FuzzedDataProvider.
+ *
+ * Fields are present or not, and integers take any value, including values that don't fit the
+ * field. When invalid records are allowed, some records also have fields that are unknown,
+ * repeated, out of order or of the wrong type, which the parsers must reject. Records are always
+ * DER; byte level corruption is left to the caller.
+ */
+class AttestationRecordGenerator {
+  public:
+    AttestationRecordGenerator(FuzzedDataProvider* fdp, bool allowInvalid)
+        : mFdp(fdp), mAllowInvalid(allowInvalid) {}
+
+    std::vector<uint8_t> generate();
+
+  private:
+    bool oneIn(uint8_t n);
+    std::vector<uint8_t> integer();
+    std::vector<uint8_t> bytes();
+    std::vector<uint8_t> value(Tag tag);
+    std::vector<uint8_t> rootOfTrust();
+    std::vector<uint8_t> authorizationList();
+
+    FuzzedDataProvider* mFdp;
+    const bool mAllowInvalid;
+};
+
+}  // namespace aidl::android::hardware::security::keymint::test
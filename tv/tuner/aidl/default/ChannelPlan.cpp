@@ -0,0 +1,239 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "android.hardware.tv.tuner-service.example-ChannelPlan"
+
+#include <utils/Log.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+#include "ChannelPlan.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+
+namespace {
+
+FrontendModulation makeModulation(FrontendType type, int32_t value) {
+    FrontendModulation modulation;
+    switch (type) {
+        case FrontendType::DVBC:
+            modulation.set<FrontendModulation::Tag::dvbc>(
+                    static_cast<FrontendDvbcModulation>(value));
+            break;
+        case FrontendType::DVBS:
+            modulation.set<FrontendModulation::Tag::dvbs>(
+                    static_cast<FrontendDvbsModulation>(value));
+            break;
+        case FrontendType::DVBT:
+            modulation.set<FrontendModulation::Tag::dvbt>(
+                    static_cast<FrontendDvbtConstellation>(value));
+            break;
+        case FrontendType::ISDBS:
+            modulation.set<FrontendModulation::Tag::isdbs>(
+                    static_cast<FrontendIsdbsModulation>(value));
+            break;
+        case FrontendType::ISDBS3:
+            modulation.set<FrontendModulation::Tag::isdbs3>(
+                    static_cast<FrontendIsdbs3Modulation>(value));
+            break;
+        case FrontendType::ISDBT:
+            modulation.set<FrontendModulation::Tag::isdbt>(
+                    static_cast<FrontendIsdbtModulation>(value));
+            break;
+        case FrontendType::ATSC:
+            modulation.set<FrontendModulation::Tag::atsc>(
+                    static_cast<FrontendAtscModulation>(value));
+            break;
+        case FrontendType::ATSC3:
+            modulation.set<FrontendModulation::Tag::atsc3>(
+                    static_cast<FrontendAtsc3Modulation>(value));
+            break;
+        case FrontendType::DTMB:
+            modulation.set<FrontendModulation::Tag::dtmb>(
+                    static_cast<FrontendDtmbModulation>(value));
+            break;
+        default:
+            break;
+    }
+    return modulation;
+}
+
+bool parseFrontendType(const std::string& name, FrontendType* type) {
+    for (FrontendType candidate : ::ndk::enum_range<FrontendType>()) {
+        if (candidate != FrontendType::UNDEFINED && toString(candidate) == name) {
+            *type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+const ScanChannel* ChannelPlan::findChannel(int64_t frequency) const {
+    const int64_t range = std::max<int64_t>(step / 2, 1);
+    auto it = std::lower_bound(channels.begin(), channels.end(), frequency - range,
+                               [](const ScanChannel& channel, int64_t value) {
+                                   return channel.frequency < value;
+                               });
+    const ScanChannel* closest = nullptr;
+    for (; it != channels.end() && it->frequency <= frequency + range; ++it) {
+        if (closest == nullptr ||
+            std::abs(it->frequency - frequency) < std::abs(closest->frequency - frequency)) {
+            closest = &*it;
+        }
+    }
+    return closest;
+}
+
+ChannelPlan ChannelPlan::defaultFor(FrontendType type) {
+    ChannelPlan plan;
+    plan.startFrequency = 139000000;
+    plan.endFrequency = 1139000000;
+
+    int32_t symbolRate = 0;
+    int32_t modulation = 0;
+    switch (type) {
+        case FrontendType::ANALOG:
+        case FrontendType::ATSC:
+        case FrontendType::ATSC3:
+        case FrontendType::ISDBT:
+            plan.step = 6000000;
+            break;
+        case FrontendType::DVBS:
+        case FrontendType::ISDBS:
+        case FrontendType::ISDBS3:
+            plan.step = 20000000;
+            break;
+        default:
+            plan.step = 8000000;
+            break;
+    }
+    switch (type) {
+        case FrontendType::ATSC:
+            modulation = static_cast<int32_t>(FrontendAtscModulation::MOD_8VSB);
+            break;
+        case FrontendType::ATSC3:
+            modulation = static_cast<int32_t>(FrontendAtsc3Modulation::MOD_256QAM);
+            break;
+        case FrontendType::DVBC:
+            symbolRate = 6900000;
+            modulation = static_cast<int32_t>(FrontendDvbcModulation::MOD_256QAM);
+            break;
+        case FrontendType::DVBS:
+            symbolRate = 27500000;
+            modulation = static_cast<int32_t>(FrontendDvbsModulation::MOD_8PSK);
+            break;
+        case FrontendType::DVBT:
+            modulation = static_cast<int32_t>(FrontendDvbtConstellation::CONSTELLATION_64QAM);
+            break;
+        case FrontendType::ISDBS:
+            symbolRate = 28860000;
+            modulation = static_cast<int32_t>(FrontendIsdbsModulation::MOD_TC8PSK);
+            break;
+        case FrontendType::ISDBS3:
+            symbolRate = 33756000;
+            modulation = static_cast<int32_t>(FrontendIsdbs3Modulation::MOD_8PSK);
+            break;
+        case FrontendType::ISDBT:
+            modulation = static_cast<int32_t>(FrontendIsdbtModulation::MOD_64QAM);
+            break;
+        case FrontendType::DTMB:
+            modulation = static_cast<int32_t>(FrontendDtmbModulation::CONSTELLATION_64QAM);
+            break;
+        default:
+            break;
+    }
+
+    // Only present when pushed by the VTS, see its AndroidTest.xml.
+    const std::string sourceFile = "/data/local/tmp/segment000000.ts";
+    const FrontendModulation mod = makeModulation(type, modulation);
+    plan.channels = {
+            {474000000, -45000, symbolRate, mod, sourceFile},
+            {578000000, -50000, symbolRate, mod, sourceFile},
+            // Too weak to lock.
+            {698000000, -92000, symbolRate, mod, ""},
+    };
+    return plan;
+}
+
+bool parseChannelPlans(std::istream& in, std::map<FrontendType, ChannelPlan>* plans) {
+    std::map<FrontendType, ChannelPlan> parsed;
+    ChannelPlan* current = nullptr;
+    FrontendType currentType = FrontendType::UNDEFINED;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string keyword;
+        if (!(fields >> keyword) || keyword[0] == '#') {
+            continue;
+        }
+
+        if (keyword == "band") {
+            std::string typeName;
+            ChannelPlan plan;
+            if (!(fields >> typeName >> plan.startFrequency >> plan.endFrequency >> plan.step) ||
+                !parseFrontendType(typeName, &currentType) || plan.step <= 0 ||
+                plan.endFrequency < plan.startFrequency) {
+                ALOGE("[ChannelPlan] invalid band on line %d", lineNumber);
+                return false;
+            }
+            int32_t minLockStrength;
+            if (fields >> minLockStrength) {
+                plan.minLockStrength = minLockStrength;
+            }
+            current = &(parsed[currentType] = std::move(plan));
+        } else if (keyword == "channel") {
+            ScanChannel channel;
+            int32_t modulation;
+            if (current == nullptr || !(fields >> channel.frequency >> channel.signalStrength >>
+                                        channel.symbolRate >> modulation)) {
+                ALOGE("[ChannelPlan] invalid channel on line %d", lineNumber);
+                return false;
+            }
+            fields >> channel.sourceFile;
+            channel.modulation = makeModulation(currentType, modulation);
+            current->channels.push_back(std::move(channel));
+        } else {
+            ALOGE("[ChannelPlan] unknown keyword %s on line %d", keyword.c_str(), lineNumber);
+            return false;
+        }
+    }
+
+    for (auto& [type, plan] : parsed) {
+        std::stable_sort(plan.channels.begin(), plan.channels.end(),
+                         [](const ScanChannel& a, const ScanChannel& b) {
+                             return a.frequency < b.frequency;
+                         });
+        (*plans)[type] = std::move(plan);
+    }
+    return true;
+}
+
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/tv/tuner/FrontendModulation.h>
+#include <aidl/android/hardware/tv/tuner/FrontendType.h>
+
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+
+/**
+ * A channel that a simulated scan can find.
+ */
+struct ScanChannel {
+    int64_t frequency = 0;
+    // Signal strength at the tuner input, in 0.001 dBm.
+    int32_t signalStrength = 0;
+    // Symbols per second, 0 for delivery systems that don't report one.
+    int32_t symbolRate = 0;
+    FrontendModulation modulation;
+    // Transport stream fed to the demux while the channel is locked. May be empty.
+    std::string sourceFile;
+};
+
+/**
+ * The band of one delivery system, and the channels on it.
+ */
+struct ChannelPlan {
+    int64_t startFrequency = 0;
+    int64_t endFrequency = 0;
+    // Raster of blind scans. A channel is found from the raster positions within half a step.
+    int64_t step = 0;
+    // Channels weaker than this are detected, but fail to lock.
+    int32_t minLockStrength = -85000;
+    // Sorted by frequency.
+    std::vector<ScanChannel> channels;
+
+    // Returns the channel within half a step of frequency, or nullptr.
+    const ScanChannel* findChannel(int64_t frequency) const;
+
+    // The plan used when none is configured for the delivery system. It covers the frequency
+    // range of getFrontendInfo() and has a channel at the VTS default frequency. The channels play
+    // /data/local/tmp/segment000000.ts, the test stream the VTS pushes to the device, and so have
+    // no source outside of tests.
+    static ChannelPlan defaultFor(FrontendType type);
+};
+
+/**
+ * Parses channel plans for any number of delivery systems. Each plan is a "band" line followed
+ * by its "channel" lines:
+ *
+ *   band DVBT 474000000 858000000 8000000 [minLockStrength]
+ *   channel 578000000 -45000 0 8 /data/local/tmp/segment000000.ts
+ *
+ * Channel fields are the frequency, signal strength, symbol rate, the modulation as a value of
+ * the delivery system's modulation enum, and an optional source file. Empty lines and lines
+ * starting with '#' are ignored.
+ *
+ * Returns false on malformed input, in which case plans is left unchanged.
+ */
+bool parseChannelPlans(std::istream& in, std::map<FrontendType, ChannelPlan>* plans);
+
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
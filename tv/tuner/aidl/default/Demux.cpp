@@ -21,6 +21,10 @@
 #include <aidl/android/hardware/tv/tuner/Result.h>
 
 #include <utils/Log.h>
+
+#include <chrono>
+#include <fstream>
+
 #include "Demux.h"
 
 namespace aidl {
@@ -31,6 +35,11 @@ namespace tuner {
 
 #define WAIT_TIMEOUT 3000000000
 
+static constexpr size_t kTsPacketSize = 188;
+// 256 packets every 20ms is about 19Mbps, the payload of a typical DVB-T multiplex.
+static constexpr size_t kSourceFilePacketsPerRead = 256;
+static constexpr std::chrono::milliseconds kSourceFileReadInterval(20);
+
 Demux::Demux(int32_t demuxId, std::shared_ptr<Tuner> tuner) {
     mDemuxId = demuxId;
     mTuner = tuner;
@@ -357,6 +366,12 @@ void Demux::frontendInputThreadLoop() {
     }
 
     if (!mDvrPlayback) {
+        string sourceFile = mFrontend != nullptr ? mFrontend->getSourceFile() : "";
+        if (!sourceFile.empty()) {
+            frontendSourceFileLoop(sourceFile);
+            mFrontendInputThreadRunning = false;
+            return;
+        }
         ALOGW("[Demux] No software Frontend input configured. Ending Frontend thread loop.");
         mFrontendInputThreadRunning = false;
         return;
@@ -393,6 +408,49 @@ void Demux::frontendInputThreadLoop() {
     ALOGW("[Demux] Frontend Input thread end.");
 }
 
+void Demux::frontendSourceFileLoop(const string& sourceFile) {
+    std::ifstream input(sourceFile, std::ios::binary | std::ios::ate);
+    if (!input.is_open()) {
+        ALOGW("[Demux] Can't open frontend source file %s", sourceFile.c_str());
+        return;
+    }
+    if (input.tellg() < static_cast<std::streamoff>(kTsPacketSize)) {
+        ALOGW("[Demux] Frontend source file %s has no packets", sourceFile.c_str());
+        return;
+    }
+    input.seekg(0);
+    ALOGD("[Demux] feeding frontend source file %s", sourceFile.c_str());
+
+    vector<int8_t> packet(kTsPacketSize);
+    auto nextRead = std::chrono::steady_clock::now();
+    while (mFrontendInputThreadRunning) {
+        size_t packets = 0;
+        for (; packets < kSourceFilePacketsPerRead; packets++) {
+            if (!input.read(reinterpret_cast<char*>(packet.data()), kTsPacketSize)) {
+                // Loop the stream, dropping any partial packet at the end of the file.
+                input.clear();
+                input.seekg(0);
+                break;
+            }
+            if (mIsRecording) {
+                sendFrontendInputToRecord(packet);
+            } else {
+                startBroadcastTsFilter(packet);
+            }
+        }
+        if (packets > 0) {
+            bool dispatched = mIsRecording ? startRecordFilterDispatcher()
+                                           : startBroadcastFilterDispatcher();
+            if (!dispatched) {
+                ALOGE("[Demux] frontend source data failed to be filtered. Ending thread");
+                break;
+            }
+        }
+        nextRead += kSourceFileReadInterval;
+        std::this_thread::sleep_until(nextRead);
+    }
+}
+
 void Demux::stopFrontendInput() {
     ALOGD("[Demux] stop frontend on demux");
     mKeepFetchingDataFromFrontend = false;
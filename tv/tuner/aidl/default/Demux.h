@@ -113,6 +113,9 @@ class Demux : public BnDemux {
 
     static void* __threadLoopFrontend(void* user);
     void frontendInputThreadLoop();
+    // Feeds the transport stream of the frontend's locked channel to the filters, looping over
+    // the file, at roughly the bit rate of a broadcast multiplex.
+    void frontendSourceFileLoop(const string& sourceFile);
 
     /**
      * To create a FilterMQ with the next available Filter ID.
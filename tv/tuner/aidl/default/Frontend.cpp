@@ -20,6 +20,8 @@
 #include <aidl/android/hardware/tv/tuner/Result.h>
 #include <utils/Log.h>
 
+#include <cinttypes>
+
 #include "Frontend.h"
 
 namespace aidl {
@@ -28,6 +30,25 @@ namespace hardware {
 namespace tv {
 namespace tuner {
 
+// Channel plans of the scan simulator, in the format of parseChannelPlans(). Delivery systems it
+// doesn't cover, or all of them if it's missing or malformed, get ChannelPlan::defaultFor().
+static const char kChannelPlanPath[] = "/vendor/etc/tuner_channel_plan.conf";
+
+static ChannelPlan loadChannelPlan(FrontendType type) {
+    std::ifstream file(kChannelPlanPath);
+    if (file.is_open()) {
+        map<FrontendType, ChannelPlan> plans;
+        if (!parseChannelPlans(file, &plans)) {
+            ALOGW("[   WARN   ] Ignoring malformed channel plan %s", kChannelPlanPath);
+        }
+        auto it = plans.find(type);
+        if (it != plans.end()) {
+            return it->second;
+        }
+    }
+    return ChannelPlan::defaultFor(type);
+}
+
 Frontend::Frontend(FrontendType type, int32_t id, std::shared_ptr<Tuner> tuner) {
     mType = type;
     mId = id;
@@ -168,12 +189,25 @@ Frontend::Frontend(FrontendType type, int32_t id, std::shared_ptr<Tuner> tuner)
             break;
         }
     }
+
+    mScanSimulator = std::make_unique<ScanSimulator>(
+            mType, loadChannelPlan(mType), ScanSimulator::Timing(),
+            [this](FrontendScanMessageType type, const FrontendScanMessage& message) {
+                std::shared_ptr<IFrontendCallback> callback = mCallback;
+                if (callback != nullptr) {
+                    callback->onScanMessage(type, message);
+                }
+            },
+            [this](const ScanChannel* channel) { onScanLockChanged(channel); });
 }
 
-Frontend::~Frontend() {}
+Frontend::~Frontend() {
+    mScanSimulator->stop();
+}
 
 ::ndk::ScopedAStatus Frontend::close() {
     ALOGV("%s", __FUNCTION__);
+    mScanSimulator->stop();
     // Reset callback
     mCallback = nullptr;
     mIsLocked = false;
@@ -194,7 +228,7 @@ Frontend::~Frontend() {}
     return ::ndk::ScopedAStatus::ok();
 }
 
-::ndk::ScopedAStatus Frontend::tune(const FrontendSettings& /* in_settings */) {
+::ndk::ScopedAStatus Frontend::tune(const FrontendSettings& in_settings) {
     ALOGV("%s", __FUNCTION__);
     if (mCallback == nullptr) {
         ALOGW("[   WARN   ] Frontend callback is not set when tune");
@@ -202,6 +236,12 @@ Frontend::~Frontend() {}
                 static_cast<int32_t>(Result::INVALID_STATE));
     }
 
+    const ScanChannel* channel = mScanSimulator->getChannelPlan().findChannel(
+            ScanSimulator::getFrequency(in_settings));
+    {
+        std::lock_guard<std::mutex> lock(mSourceFileLock);
+        mSourceFile = channel != nullptr ? channel->sourceFile : "";
+    }
     mTuner->frontendStartTune(mId);
     mCallback->onEvent(FrontendEventType::LOCKED);
     mIsLocked = true;
@@ -220,198 +260,39 @@ Frontend::~Frontend() {}
 
 ::ndk::ScopedAStatus Frontend::scan(const FrontendSettings& in_settings, FrontendScanType in_type) {
     ALOGV("%s", __FUNCTION__);
-
-    // If it's in middle of scanning, stop it first.
-    if (mScanThread.joinable()) {
-        mScanThread.join();
+    if (mCallback == nullptr) {
+        ALOGW("[   WARN   ] Frontend callback is not set when scan");
+        return ::ndk::ScopedAStatus::fromServiceSpecificError(
+                static_cast<int32_t>(Result::INVALID_STATE));
     }
 
-    mFrontendSettings = in_settings;
-    mFrontendScanType = in_type;
-    mScanThread = std::thread(&Frontend::scanThreadLoop, this);
+    // Continues the scan if it's the same as the one in progress, and restarts it otherwise.
+    mScanSimulator->scan(in_settings, in_type);
 
     return ::ndk::ScopedAStatus::ok();
 }
 
-void Frontend::scanThreadLoop() {
-    if (mIsLocked) {
-        FrontendScanMessage msg;
-        msg.set<FrontendScanMessage::Tag::isEnd>(true);
-        mCallback->onScanMessage(FrontendScanMessageType::END, msg);
-        return;
-    }
-
-    int64_t frequency = 0;
-    switch (mFrontendSettings.getTag()) {
-        case FrontendSettings::Tag::analog:
-            frequency = mFrontendSettings.get<FrontendSettings::Tag::analog>().frequency;
-            break;
-        case FrontendSettings::Tag::atsc:
-            frequency = mFrontendSettings.get<FrontendSettings::Tag::atsc>().frequency;
-            break;
-        case FrontendSettings::Tag::atsc3:
-            frequency = mFrontendSettings.get<FrontendSettings::Tag::atsc3>().frequency;
-            break;
-        case FrontendSettings::Tag::dvbs:
-            frequency = mFrontendSettings.get<FrontendSettings::Tag::dvbs>().frequency;
-            break;
-        case FrontendSettings::Tag::dvbc:
-            frequency = mFrontendSettings.get<FrontendSettings::Tag::dvbc>().frequency;
-            break;
-        case FrontendSettings::Tag::dvbt:
-            frequency = mFrontendSettings.get<FrontendSettings::Tag::dvbt>().frequency;
-            break;
-        case FrontendSettings::Tag::isdbs:
-            frequency = mFrontendSettings.get<FrontendSettings::Tag::isdbs>().frequency;
-            break;
-        case FrontendSettings::Tag::isdbs3:
-            frequency = mFrontendSettings.get<FrontendSettings::Tag::isdbs3>().frequency;
-            break;
-        case FrontendSettings::Tag::isdbt:
-            frequency = mFrontendSettings.get<FrontendSettings::Tag::isdbt>().frequency;
-            break;
-        default:
-            break;
-    }
-
-    if (mFrontendScanType == FrontendScanType::SCAN_BLIND) {
-        frequency += 100 * 1000;
-    }
-
-    {
-        FrontendScanMessage msg;
-        vector<int64_t> frequencies = {frequency};
-        msg.set<FrontendScanMessage::Tag::frequencies>(frequencies);
-        mCallback->onScanMessage(FrontendScanMessageType::FREQUENCY, msg);
-    }
-
-    {
-        FrontendScanMessage msg;
-        msg.set<FrontendScanMessage::Tag::progressPercent>(20);
-        mCallback->onScanMessage(FrontendScanMessageType::PROGRESS_PERCENT, msg);
-    }
-
-    {
-        FrontendScanMessage msg;
-        vector<int32_t> symbolRates = {30};
-        msg.set<FrontendScanMessage::Tag::symbolRates>(symbolRates);
-        mCallback->onScanMessage(FrontendScanMessageType::SYMBOL_RATE, msg);
-    }
-
-    if (mType == FrontendType::DVBT) {
-        FrontendScanMessage msg;
-        msg.set<FrontendScanMessage::Tag::hierarchy>(FrontendDvbtHierarchy::HIERARCHY_NON_NATIVE);
-        mCallback->onScanMessage(FrontendScanMessageType::HIERARCHY, msg);
-    }
-
-    if (mType == FrontendType::ANALOG) {
-        FrontendScanMessage msg;
-        msg.set<FrontendScanMessage::Tag::analogType>(FrontendAnalogType::PAL);
-        mCallback->onScanMessage(FrontendScanMessageType::ANALOG_TYPE, msg);
-    }
-
-    {
-        FrontendScanMessage msg;
-        vector<int32_t> plpIds = {2};
-        msg.set<FrontendScanMessage::Tag::plpIds>(plpIds);
-        mCallback->onScanMessage(FrontendScanMessageType::PLP_IDS, msg);
-    }
-
-    {
-        FrontendScanMessage msg;
-        vector<int32_t> groupIds = {3};
-        msg.set<FrontendScanMessage::Tag::groupIds>(groupIds);
-        mCallback->onScanMessage(FrontendScanMessageType::GROUP_IDS, msg);
-    }
-
-    {
-        FrontendScanMessage msg;
-        vector<int32_t> inputStreamIds = {1};
-        msg.set<FrontendScanMessage::Tag::inputStreamIds>(inputStreamIds);
-        mCallback->onScanMessage(FrontendScanMessageType::INPUT_STREAM_IDS, msg);
-    }
-
-    switch (mType) {
-        case FrontendType::DVBT: {
-            FrontendScanMessage msg;
-            FrontendScanMessageStandard std;
-            std.set<FrontendScanMessageStandard::Tag::tStd>(FrontendDvbtStandard::AUTO);
-            msg.set<FrontendScanMessage::Tag::std>(std);
-            mCallback->onScanMessage(FrontendScanMessageType::STANDARD, msg);
-            break;
-        }
-        case FrontendType::DVBS: {
-            FrontendScanMessage msg;
-            FrontendScanMessageStandard std;
-            std.set<FrontendScanMessageStandard::Tag::sStd>(FrontendDvbsStandard::AUTO);
-            msg.set<FrontendScanMessage::Tag::std>(std);
-            mCallback->onScanMessage(FrontendScanMessageType::STANDARD, msg);
-            break;
-        }
-        case FrontendType::ANALOG: {
-            FrontendScanMessage msg;
-            FrontendScanMessageStandard std;
-            std.set<FrontendScanMessageStandard::Tag::sifStd>(FrontendAnalogSifStandard::AUTO);
-            msg.set<FrontendScanMessage::Tag::std>(std);
-            mCallback->onScanMessage(FrontendScanMessageType::STANDARD, msg);
-            break;
-        }
-        default:
-            break;
-    }
-
-    {
-        FrontendScanMessage msg;
-        FrontendScanAtsc3PlpInfo info;
-        info.plpId = 1;
-        info.bLlsFlag = false;
-        vector<FrontendScanAtsc3PlpInfo> atsc3PlpInfos = {info};
-        msg.set<FrontendScanMessage::Tag::atsc3PlpInfos>(atsc3PlpInfos);
-        mCallback->onScanMessage(FrontendScanMessageType::ATSC3_PLP_INFO, msg);
-    }
-
-    {
-        FrontendScanMessage msg;
-        FrontendModulation modulation;
-        modulation.set<FrontendModulation::Tag::dvbc>(FrontendDvbcModulation::MOD_16QAM);
-        msg.set<FrontendScanMessage::Tag::modulation>(modulation);
-        mCallback->onScanMessage(FrontendScanMessageType::MODULATION, msg);
-    }
-
-    {
-        FrontendScanMessage msg;
-        msg.set<FrontendScanMessage::Tag::isHighPriority>(true);
-        mCallback->onScanMessage(FrontendScanMessageType::HIGH_PRIORITY, msg);
-    }
-
-    if (mType == FrontendType::DVBT) {
-        FrontendScanMessage msg;
-        vector<int32_t> dvbtCellIds = {0, 1};
-        msg.set<FrontendScanMessage::Tag::dvbtCellIds>(dvbtCellIds);
-        mCallback->onScanMessage(FrontendScanMessageType::DVBT_CELL_IDS, msg);
-    }
-
-    {
-        FrontendScanMessage msg;
-        msg.set<FrontendScanMessage::Tag::isLocked>(false);
-        mCallback->onScanMessage(FrontendScanMessageType::LOCKED, msg);
+void Frontend::onScanLockChanged(const ScanChannel* channel) {
+    if (channel == nullptr) {
+        mTuner->frontendStopTune(mId);
         mIsLocked = false;
+        std::lock_guard<std::mutex> lock(mSourceFileLock);
+        mSourceFile.clear();
+        return;
     }
 
     {
-        FrontendScanMessage msg;
-        msg.set<FrontendScanMessage::Tag::isLocked>(true);
-        mCallback->onScanMessage(FrontendScanMessageType::LOCKED, msg);
-        mIsLocked = true;
+        std::lock_guard<std::mutex> lock(mSourceFileLock);
+        mSourceFile = channel->sourceFile;
     }
+    mIsLocked = true;
+    mTuner->frontendStartTune(mId);
 }
 
 ::ndk::ScopedAStatus Frontend::stopScan() {
     ALOGV("%s", __FUNCTION__);
 
-    if (mScanThread.joinable()) {
-        mScanThread.join();
-    }
+    mScanSimulator->stop();
 
     mIsLocked = false;
     return ::ndk::ScopedAStatus::ok();
@@ -421,13 +302,16 @@ void Frontend::scanThreadLoop() {
                                          std::vector<FrontendStatus>* _aidl_return) {
     ALOGV("%s", __FUNCTION__);
 
+    // While scanning, the status of the frequency being scanned.
+    std::optional<ScanSimulator::Status> scanStatus = mScanSimulator->getStatus();
     for (int i = 0; i < in_statusTypes.size(); i++) {
         FrontendStatusType type = in_statusTypes[i];
         FrontendStatus status;
         // assign randomly selected values for testing.
         switch (type) {
             case FrontendStatusType::DEMOD_LOCK: {
-                status.set<FrontendStatus::isDemodLocked>(true);
+                status.set<FrontendStatus::isDemodLocked>(
+                        scanStatus.has_value() ? scanStatus->isDemodLocked : true);
                 break;
             }
             case FrontendStatusType::SNR: {
@@ -451,11 +335,13 @@ void Frontend::scanThreadLoop() {
                 break;
             }
             case FrontendStatusType::SIGNAL_STRENGTH: {
-                status.set<FrontendStatus::signalStrength>(5);
+                status.set<FrontendStatus::signalStrength>(
+                        scanStatus.has_value() ? scanStatus->signalStrength : 5);
                 break;
             }
             case FrontendStatusType::SYMBOL_RATE: {
-                status.set<FrontendStatus::symbolRate>(6);
+                status.set<FrontendStatus::symbolRate>(
+                        scanStatus.has_value() ? scanStatus->symbolRate : 6);
                 break;
             }
             case FrontendStatusType::FEC: {
@@ -546,7 +432,8 @@ void Frontend::scanThreadLoop() {
                 break;
             }
             case FrontendStatusType::RF_LOCK: {
-                status.set<FrontendStatus::isRfLocked>(false);
+                status.set<FrontendStatus::isRfLocked>(
+                        scanStatus.has_value() && scanStatus->isRfLocked);
                 break;
             }
             case FrontendStatusType::ATSC3_PLP_INFO: {
@@ -904,6 +791,13 @@ binder_status_t Frontend::dump(int fd, const char** /* args */, uint32_t /* numA
     dprintf(fd, "    mType: %d\n", mType);
     dprintf(fd, "    mIsLocked: %d\n", mIsLocked);
     dprintf(fd, "    mCiCamId: %d\n", mCiCamId);
+    std::optional<ScanSimulator::Status> scanStatus = mScanSimulator->getStatus();
+    if (scanStatus.has_value()) {
+        dprintf(fd, "    scanning: %" PRId64 " Hz, rf lock %d, demod lock %d, %d mdBm\n",
+                scanStatus->frequency, scanStatus->isRfLocked, scanStatus->isDemodLocked,
+                scanStatus->signalStrength);
+    }
+    dprintf(fd, "    mSourceFile: %s\n", getSourceFile().c_str());
     dprintf(fd, "    mFrontendStatusCaps:");
     for (int i = 0; i < mFrontendStatusCaps.size(); i++) {
         dprintf(fd, "        %d\n", mFrontendStatusCaps[i]);
@@ -961,6 +855,11 @@ bool Frontend::supportsSatellite() {
            mType == FrontendType::ISDBS3;
 }
 
+string Frontend::getSourceFile() {
+    std::lock_guard<std::mutex> lock(mSourceFileLock);
+    return mSourceFile;
+}
+
 bool Frontend::isLocked() {
     return mIsLocked;
 }
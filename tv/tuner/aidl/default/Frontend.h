@@ -19,7 +19,9 @@
 #include <aidl/android/hardware/tv/tuner/BnFrontend.h>
 #include <fstream>
 #include <iostream>
-#include <thread>
+#include <memory>
+#include <mutex>
+#include "ScanSimulator.h"
 #include "Tuner.h"
 
 using namespace std;
@@ -66,7 +68,7 @@ class Frontend : public BnFrontend {
   private:
     virtual ~Frontend();
     bool supportsSatellite();
-    void scanThreadLoop();
+    void onScanLockChanged(const ScanChannel* channel);
 
     std::shared_ptr<IFrontendCallback> mCallback;
     std::shared_ptr<Tuner> mTuner;
@@ -74,12 +76,14 @@ class Frontend : public BnFrontend {
     int32_t mId = 0;
     bool mIsLocked = false;
     int32_t mCiCamId;
-    std::thread mScanThread;
-    FrontendSettings mFrontendSettings;
-    FrontendScanType mFrontendScanType;
     std::ifstream mFrontendData;
     FrontendCapabilities mFrontendCaps;
     vector<FrontendStatusType> mFrontendStatusCaps;
+    // Transport stream of the locked channel, fed to the demux. Empty when there is none.
+    std::mutex mSourceFileLock;
+    string mSourceFile;
+    // Declared last, so that the scan stops before the members it calls back into go away.
+    std::unique_ptr<ScanSimulator> mScanSimulator;
 };
 
 }  // namespace tuner
@@ -0,0 +1,313 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "android.hardware.tv.tuner-service.example-ScanSimulator"
+
+#include <utils/Log.h>
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "ScanSimulator.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+
+ScanSimulator::ScanSimulator(FrontendType type, ChannelPlan plan, Timing timing,
+                             MessageCallback onMessage, LockCallback onLock)
+    : mType(type),
+      mPlan(std::move(plan)),
+      mTiming(timing),
+      mOnMessage(std::move(onMessage)),
+      mOnLock(std::move(onLock)) {}
+
+ScanSimulator::~ScanSimulator() {
+    stop();
+}
+
+void ScanSimulator::scan(const FrontendSettings& settings, FrontendScanType type) {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mRunning && !mStopping && mSettings == settings && mScanType == type) {
+            ALOGV("[ScanSimulator] continue sweep");
+            mContinue = true;
+            mCondition.notify_all();
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> control(mControlLock);
+    stopLocked();
+
+    const int64_t from = getFrequency(settings);
+    const bool blind = type == FrontendScanType::SCAN_BLIND;
+    std::vector<int64_t> frequencies;
+    if (blind) {
+        for (int64_t frequency = std::max(from, mPlan.startFrequency);
+             frequency <= mPlan.endFrequency; frequency += mPlan.step) {
+            frequencies.push_back(frequency);
+        }
+    } else {
+        // Auto scans start from the channel the requested frequency belongs to.
+        const int64_t range = mPlan.step / 2;
+        for (const ScanChannel& channel : mPlan.channels) {
+            if (channel.frequency + range >= from && channel.frequency >= mPlan.startFrequency &&
+                channel.frequency <= mPlan.endFrequency) {
+                frequencies.push_back(channel.frequency);
+            }
+        }
+    }
+    ALOGV("[ScanSimulator] %s sweep of %zu frequencies from %" PRId64, blind ? "blind" : "auto",
+          frequencies.size(), from);
+
+    std::lock_guard<std::mutex> lock(mLock);
+    mRunning = true;
+    mStopping = false;
+    mContinue = false;
+    mSettings = settings;
+    mScanType = type;
+    mStatus = {};
+    mThread = std::thread(&ScanSimulator::sweepThreadLoop, this, std::move(frequencies), blind);
+}
+
+void ScanSimulator::stop() {
+    std::lock_guard<std::mutex> control(mControlLock);
+    stopLocked();
+}
+
+void ScanSimulator::stopLocked() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStopping = true;
+        mCondition.notify_all();
+    }
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    mRunning = false;
+    mStatus = {};
+}
+
+std::optional<ScanSimulator::Status> ScanSimulator::getStatus() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mRunning) {
+        return std::nullopt;
+    }
+    return mStatus;
+}
+
+int64_t ScanSimulator::getFrequency(const FrontendSettings& settings) {
+    switch (settings.getTag()) {
+        case FrontendSettings::Tag::analog:
+            return settings.get<FrontendSettings::Tag::analog>().frequency;
+        case FrontendSettings::Tag::atsc:
+            return settings.get<FrontendSettings::Tag::atsc>().frequency;
+        case FrontendSettings::Tag::atsc3:
+            return settings.get<FrontendSettings::Tag::atsc3>().frequency;
+        case FrontendSettings::Tag::dvbs:
+            return settings.get<FrontendSettings::Tag::dvbs>().frequency;
+        case FrontendSettings::Tag::dvbc:
+            return settings.get<FrontendSettings::Tag::dvbc>().frequency;
+        case FrontendSettings::Tag::dvbt:
+            return settings.get<FrontendSettings::Tag::dvbt>().frequency;
+        case FrontendSettings::Tag::isdbs:
+            return settings.get<FrontendSettings::Tag::isdbs>().frequency;
+        case FrontendSettings::Tag::isdbs3:
+            return settings.get<FrontendSettings::Tag::isdbs3>().frequency;
+        case FrontendSettings::Tag::isdbt:
+            return settings.get<FrontendSettings::Tag::isdbt>().frequency;
+        case FrontendSettings::Tag::dtmb:
+            return settings.get<FrontendSettings::Tag::dtmb>().frequency;
+        default:
+            return 0;
+    }
+}
+
+void ScanSimulator::sweepThreadLoop(std::vector<int64_t> frequencies, bool blind) {
+    const ScanChannel* lastChannel = nullptr;
+    for (size_t i = 0; i < frequencies.size(); i++) {
+        const int64_t frequency = frequencies[i];
+        setStatus({.frequency = frequency});
+        if (!sleepFor(mTiming.dwell)) {
+            return;
+        }
+
+        const ScanChannel* channel = mPlan.findChannel(frequency);
+        // Adjacent raster positions can both be in range of a channel, it's only found once.
+        if (channel != nullptr && channel != lastChannel) {
+            lastChannel = channel;
+            setStatus({
+                    .frequency = frequency,
+                    .isRfLocked = true,
+                    .signalStrength = channel->signalStrength,
+            });
+            if (!sleepFor(mTiming.lock)) {
+                return;
+            }
+
+            if (channel->signalStrength < mPlan.minLockStrength) {
+                ALOGV("[ScanSimulator] no lock at %" PRId64, channel->frequency);
+                FrontendScanMessage msg;
+                msg.set<FrontendScanMessage::Tag::isLocked>(false);
+                sendMessage(FrontendScanMessageType::LOCKED, msg);
+            } else {
+                ALOGV("[ScanSimulator] locked at %" PRId64, channel->frequency);
+                {
+                    std::lock_guard<std::mutex> lock(mLock);
+                    mContinue = false;
+                    mStatus = {
+                            .frequency = channel->frequency,
+                            .isRfLocked = true,
+                            .isDemodLocked = true,
+                            .signalStrength = channel->signalStrength,
+                            .symbolRate = channel->symbolRate,
+                    };
+                }
+                mOnLock(channel);
+                reportLocked(*channel);
+                const bool continued = waitForContinue();
+                mOnLock(nullptr);
+                if (!continued) {
+                    return;
+                }
+            }
+        }
+
+        FrontendScanMessage msg;
+        msg.set<FrontendScanMessage::Tag::progressPercent>(
+                static_cast<int32_t>((i + 1) * 100 / frequencies.size()));
+        sendMessage(FrontendScanMessageType::PROGRESS_PERCENT, msg);
+    }
+
+    if (frequencies.empty()) {
+        FrontendScanMessage msg;
+        msg.set<FrontendScanMessage::Tag::progressPercent>(100);
+        sendMessage(FrontendScanMessageType::PROGRESS_PERCENT, msg);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mRunning = false;
+        mStatus = {};
+    }
+    ALOGV("[ScanSimulator] %s sweep ended", blind ? "blind" : "auto");
+    FrontendScanMessage msg;
+    msg.set<FrontendScanMessage::Tag::isEnd>(true);
+    sendMessage(FrontendScanMessageType::END, msg);
+}
+
+bool ScanSimulator::sleepFor(std::chrono::milliseconds duration) {
+    std::unique_lock<std::mutex> lock(mLock);
+    return !mCondition.wait_for(lock, duration, [this] { return mStopping; });
+}
+
+bool ScanSimulator::waitForContinue() {
+    std::unique_lock<std::mutex> lock(mLock);
+    mCondition.wait(lock, [this] { return mStopping || mContinue; });
+    mContinue = false;
+    return !mStopping;
+}
+
+void ScanSimulator::setStatus(const Status& status) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mStatus = status;
+}
+
+void ScanSimulator::reportLocked(const ScanChannel& channel) {
+    {
+        FrontendScanMessage msg;
+        std::vector<int64_t> frequencies = {channel.frequency};
+        msg.set<FrontendScanMessage::Tag::frequencies>(frequencies);
+        sendMessage(FrontendScanMessageType::FREQUENCY, msg);
+    }
+
+    if (channel.symbolRate > 0) {
+        FrontendScanMessage msg;
+        std::vector<int32_t> symbolRates = {channel.symbolRate};
+        msg.set<FrontendScanMessage::Tag::symbolRates>(symbolRates);
+        sendMessage(FrontendScanMessageType::SYMBOL_RATE, msg);
+    }
+
+    if (mType != FrontendType::ANALOG) {
+        FrontendScanMessage msg;
+        msg.set<FrontendScanMessage::Tag::modulation>(channel.modulation);
+        sendMessage(FrontendScanMessageType::MODULATION, msg);
+    }
+
+    switch (mType) {
+        case FrontendType::DVBT: {
+            FrontendScanMessage msg;
+            msg.set<FrontendScanMessage::Tag::hierarchy>(
+                    FrontendDvbtHierarchy::HIERARCHY_NON_NATIVE);
+            sendMessage(FrontendScanMessageType::HIERARCHY, msg);
+
+            FrontendScanMessageStandard standard;
+            standard.set<FrontendScanMessageStandard::Tag::tStd>(FrontendDvbtStandard::T);
+            msg.set<FrontendScanMessage::Tag::std>(standard);
+            sendMessage(FrontendScanMessageType::STANDARD, msg);
+            break;
+        }
+        case FrontendType::DVBS: {
+            FrontendScanMessage msg;
+            FrontendScanMessageStandard standard;
+            standard.set<FrontendScanMessageStandard::Tag::sStd>(FrontendDvbsStandard::S2);
+            msg.set<FrontendScanMessage::Tag::std>(standard);
+            sendMessage(FrontendScanMessageType::STANDARD, msg);
+            break;
+        }
+        case FrontendType::ANALOG: {
+            FrontendScanMessage msg;
+            msg.set<FrontendScanMessage::Tag::analogType>(FrontendAnalogType::PAL);
+            sendMessage(FrontendScanMessageType::ANALOG_TYPE, msg);
+
+            FrontendScanMessageStandard standard;
+            standard.set<FrontendScanMessageStandard::Tag::sifStd>(FrontendAnalogSifStandard::AUTO);
+            msg.set<FrontendScanMessage::Tag::std>(standard);
+            sendMessage(FrontendScanMessageType::STANDARD, msg);
+            break;
+        }
+        case FrontendType::ATSC3: {
+            FrontendScanMessage msg;
+            FrontendScanAtsc3PlpInfo info;
+            info.plpId = 1;
+            info.bLlsFlag = false;
+            std::vector<FrontendScanAtsc3PlpInfo> atsc3PlpInfos = {info};
+            msg.set<FrontendScanMessage::Tag::atsc3PlpInfos>(atsc3PlpInfos);
+            sendMessage(FrontendScanMessageType::ATSC3_PLP_INFO, msg);
+            break;
+        }
+        default:
+            break;
+    }
+
+    FrontendScanMessage msg;
+    msg.set<FrontendScanMessage::Tag::isLocked>(true);
+    sendMessage(FrontendScanMessageType::LOCKED, msg);
+}
+
+void ScanSimulator::sendMessage(FrontendScanMessageType type, const FrontendScanMessage& message) {
+    mOnMessage(type, message);
+}
+
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/tv/tuner/FrontendScanMessage.h>
+#include <aidl/android/hardware/tv/tuner/FrontendScanMessageType.h>
+#include <aidl/android/hardware/tv/tuner/FrontendScanType.h>
+#include <aidl/android/hardware/tv/tuner/FrontendSettings.h>
+#include <aidl/android/hardware/tv/tuner/FrontendType.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "ChannelPlan.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+
+/**
+ * Sweeps a channel plan on a thread of its own, the way a frontend scans a band.
+ *
+ * A blind scan visits every raster position of the band from the requested frequency on, an auto
+ * scan only the frequencies of the plan's channels. Each position takes the dwell time. A channel
+ * found there takes the lock time on top of it, and is then reported with LOCKED(false) if it's
+ * too weak to lock. Otherwise its parameters and LOCKED(true) are reported, and the sweep holds
+ * the lock until scan() is called again with the same settings, as clients do to continue a
+ * scan. The sweep ends with PROGRESS_PERCENT(100) and END.
+ */
+class ScanSimulator {
+  public:
+    struct Timing {
+        // Time spent on each frequency of the sweep.
+        std::chrono::milliseconds dwell{50};
+        // Additional time to acquire a channel, whether it locks or not.
+        std::chrono::milliseconds lock{200};
+    };
+
+    static constexpr int32_t kNoiseFloor = -100000;
+
+    // What the frontend receives at the current frequency of a sweep.
+    struct Status {
+        int64_t frequency = 0;
+        bool isRfLocked = false;
+        bool isDemodLocked = false;
+        // In 0.001 dBm; the noise floor when there is no signal.
+        int32_t signalStrength = kNoiseFloor;
+        int32_t symbolRate = 0;
+    };
+
+    // Callbacks are made from the sweep thread, with no lock held. They may continue the sweep,
+    // but not stop it.
+    using MessageCallback =
+            std::function<void(FrontendScanMessageType type, const FrontendScanMessage& message)>;
+    // Called with the channel when the sweep locks on it, and with nullptr when the lock is
+    // released, either to continue the sweep or because the sweep is stopped.
+    using LockCallback = std::function<void(const ScanChannel* channel)>;
+
+    ScanSimulator(FrontendType type, ChannelPlan plan, Timing timing, MessageCallback onMessage,
+                  LockCallback onLock);
+    ~ScanSimulator();
+
+    // Continues the current sweep if it was started with the same settings and type. Otherwise
+    // stops it, and starts a new one from the frequency in settings.
+    void scan(const FrontendSettings& settings, FrontendScanType type);
+
+    // Stops the sweep, if any, and waits for its thread to finish. No END is reported.
+    void stop();
+
+    // Returns the status of the current sweep, or nullopt if there is none.
+    std::optional<Status> getStatus() const;
+
+    const ChannelPlan& getChannelPlan() const { return mPlan; }
+
+    static int64_t getFrequency(const FrontendSettings& settings);
+
+  private:
+    void stopLocked();
+    void sweepThreadLoop(std::vector<int64_t> frequencies, bool blind);
+    // Sleeps for duration, returning false if the sweep is stopped meanwhile.
+    bool sleepFor(std::chrono::milliseconds duration);
+    // Waits until the sweep is continued or stopped, returning false in the latter case.
+    bool waitForContinue();
+    void setStatus(const Status& status);
+    void reportLocked(const ScanChannel& channel);
+    void sendMessage(FrontendScanMessageType type, const FrontendScanMessage& message);
+
+    const FrontendType mType;
+    const ChannelPlan mPlan;
+    const Timing mTiming;
+    const MessageCallback mOnMessage;
+    const LockCallback mOnLock;
+
+    // Serializes starting and stopping sweeps.
+    std::mutex mControlLock;
+    mutable std::mutex mLock;
+    std::condition_variable mCondition;
+    std::thread mThread;
+    // Set while a sweep thread is running, until it reports END or is stopped.
+    bool mRunning = false;
+    bool mStopping = false;
+    bool mContinue = false;
+    FrontendSettings mSettings;
+    FrontendScanType mScanType = FrontendScanType::SCAN_UNDEFINED;
+    Status mStatus;
+};
+
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
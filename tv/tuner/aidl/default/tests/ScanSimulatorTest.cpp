@@ -0,0 +1,376 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ChannelPlan.h"
+#include "ScanSimulator.h"
+
+namespace aidl::android::hardware::tv::tuner {
+namespace {
+
+using namespace std::chrono_literals;
+
+constexpr auto kTimeout = 5s;
+
+ChannelPlan testPlan() {
+    ChannelPlan plan;
+    plan.startFrequency = 100000000;
+    plan.endFrequency = 200000000;
+    plan.step = 8000000;
+    plan.minLockStrength = -85000;
+    FrontendModulation modulation;
+    modulation.set<FrontendModulation::Tag::dvbt>(FrontendDvbtConstellation::CONSTELLATION_64QAM);
+    plan.channels = {
+            {118000000, -50000, 0, modulation, "/data/local/tmp/a.ts"},
+            {150000000, -95000, 0, modulation, ""},
+            {182000000, -60000, 0, modulation, "/data/local/tmp/b.ts"},
+    };
+    return plan;
+}
+
+FrontendSettings dvbtSettings(int64_t frequency) {
+    FrontendDvbtSettings dvbt;
+    dvbt.frequency = frequency;
+    FrontendSettings settings;
+    settings.set<FrontendSettings::Tag::dvbt>(dvbt);
+    return settings;
+}
+
+// Records what a ScanSimulator reports, optionally continuing the scan on every lock like the
+// clients do.
+class ScanRecorder {
+  public:
+    struct Message {
+        FrontendScanMessageType type;
+        FrontendScanMessage message;
+    };
+
+    explicit ScanRecorder(bool continueOnLock, ScanSimulator::Timing timing = fastTiming())
+        : mContinueOnLock(continueOnLock),
+          mSimulator(
+                  FrontendType::DVBT, testPlan(), timing,
+                  [this](FrontendScanMessageType type, const FrontendScanMessage& message) {
+                      onMessage(type, message);
+                  },
+                  [this](const ScanChannel* channel) { onLock(channel); }) {}
+
+    static ScanSimulator::Timing fastTiming() { return {.dwell = 1ms, .lock = 2ms}; }
+
+    void scan(const FrontendSettings& settings, FrontendScanType type) {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mSettings = settings;
+            mScanType = type;
+        }
+        mSimulator.scan(settings, type);
+    }
+
+    bool waitForMessages(FrontendScanMessageType type, size_t count) {
+        std::unique_lock<std::mutex> lock(mLock);
+        return mCv.wait_for(lock, kTimeout, [&] { return countLocked(type) >= count; });
+    }
+
+    size_t count(FrontendScanMessageType type) {
+        std::lock_guard<std::mutex> lock(mLock);
+        return countLocked(type);
+    }
+
+    std::vector<Message> messages() {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mMessages;
+    }
+
+    // Source files of the locked channels, with "" for every released lock.
+    std::vector<std::string> locks() {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mLocks;
+    }
+
+    std::vector<bool> lockResults() {
+        std::vector<bool> results;
+        for (const Message& m : messages()) {
+            if (m.type == FrontendScanMessageType::LOCKED) {
+                results.push_back(m.message.get<FrontendScanMessage::Tag::isLocked>());
+            }
+        }
+        return results;
+    }
+
+    std::vector<int64_t> lockedFrequencies() {
+        std::vector<int64_t> frequencies;
+        for (const Message& m : messages()) {
+            if (m.type == FrontendScanMessageType::FREQUENCY) {
+                for (int64_t f : m.message.get<FrontendScanMessage::Tag::frequencies>()) {
+                    frequencies.push_back(f);
+                }
+            }
+        }
+        return frequencies;
+    }
+
+    std::vector<int32_t> progress() {
+        std::vector<int32_t> percents;
+        for (const Message& m : messages()) {
+            if (m.type == FrontendScanMessageType::PROGRESS_PERCENT) {
+                percents.push_back(m.message.get<FrontendScanMessage::Tag::progressPercent>());
+            }
+        }
+        return percents;
+    }
+
+    ScanSimulator& simulator() { return mSimulator; }
+
+  private:
+    void onMessage(FrontendScanMessageType type, const FrontendScanMessage& message) {
+        FrontendSettings settings;
+        FrontendScanType scanType;
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mMessages.push_back({type, message});
+            mCv.notify_all();
+            settings = mSettings;
+            scanType = mScanType;
+        }
+        if (mContinueOnLock && type == FrontendScanMessageType::LOCKED &&
+            message.get<FrontendScanMessage::Tag::isLocked>()) {
+            mSimulator.scan(settings, scanType);
+        }
+    }
+
+    void onLock(const ScanChannel* channel) {
+        std::lock_guard<std::mutex> lock(mLock);
+        mLocks.push_back(channel != nullptr ? channel->sourceFile : "");
+        mCv.notify_all();
+    }
+
+    size_t countLocked(FrontendScanMessageType type) {
+        size_t n = 0;
+        for (const Message& m : mMessages) {
+            if (m.type == type) n++;
+        }
+        return n;
+    }
+
+    const bool mContinueOnLock;
+    std::mutex mLock;
+    std::condition_variable mCv;
+    std::vector<Message> mMessages;
+    std::vector<std::string> mLocks;
+    FrontendSettings mSettings;
+    FrontendScanType mScanType = FrontendScanType::SCAN_UNDEFINED;
+    // Last, so that the sweep thread stops before the recorder goes away.
+    ScanSimulator mSimulator;
+};
+
+TEST(ChannelPlanTest, FindsClosestChannelWithinHalfAStep) {
+    ChannelPlan plan = testPlan();
+    ASSERT_NE(plan.findChannel(118000000), nullptr);
+    EXPECT_EQ(plan.findChannel(114000000)->frequency, 118000000);
+    EXPECT_EQ(plan.findChannel(121900000)->frequency, 118000000);
+    EXPECT_EQ(plan.findChannel(113900000), nullptr);
+    EXPECT_EQ(plan.findChannel(134000000), nullptr);
+    EXPECT_EQ(plan.findChannel(0), nullptr);
+}
+
+TEST(ChannelPlanTest, DefaultPlanHasTheVtsFrequency) {
+    for (FrontendType type : {FrontendType::DVBT, FrontendType::DVBS, FrontendType::ATSC3,
+                              FrontendType::ISDBT}) {
+        ChannelPlan plan = ChannelPlan::defaultFor(type);
+        const ScanChannel* channel = plan.findChannel(578000000);
+        ASSERT_NE(channel, nullptr);
+        EXPECT_EQ(channel->frequency, 578000000);
+        EXPECT_GE(channel->signalStrength, plan.minLockStrength);
+    }
+}
+
+TEST(ChannelPlanTest, Parse) {
+    std::istringstream in(R"(
+# A comment.
+band DVBT 474000000 858000000 8000000
+channel 578000000 -45000 0 8 /data/local/tmp/segment000000.ts
+channel 490000000 -90000 0 4
+
+band DVBC 100000000 900000000 8000000 -80000
+channel 306000000 -60000 6900000 32 /data/local/tmp/dvbc.ts
+)");
+    std::map<FrontendType, ChannelPlan> plans;
+    ASSERT_TRUE(parseChannelPlans(in, &plans));
+    ASSERT_EQ(plans.size(), 2u);
+
+    const ChannelPlan& dvbt = plans[FrontendType::DVBT];
+    EXPECT_EQ(dvbt.startFrequency, 474000000);
+    EXPECT_EQ(dvbt.endFrequency, 858000000);
+    EXPECT_EQ(dvbt.step, 8000000);
+    EXPECT_EQ(dvbt.minLockStrength, ChannelPlan().minLockStrength);
+    ASSERT_EQ(dvbt.channels.size(), 2u);
+    EXPECT_EQ(dvbt.channels[0].frequency, 490000000);
+    EXPECT_EQ(dvbt.channels[0].sourceFile, "");
+    EXPECT_EQ(dvbt.channels[1].frequency, 578000000);
+    EXPECT_EQ(dvbt.channels[1].signalStrength, -45000);
+    EXPECT_EQ(dvbt.channels[1].modulation.get<FrontendModulation::Tag::dvbt>(),
+              FrontendDvbtConstellation::CONSTELLATION_64QAM);
+    EXPECT_EQ(dvbt.channels[1].sourceFile, "/data/local/tmp/segment000000.ts");
+
+    const ChannelPlan& dvbc = plans[FrontendType::DVBC];
+    EXPECT_EQ(dvbc.minLockStrength, -80000);
+    ASSERT_EQ(dvbc.channels.size(), 1u);
+    EXPECT_EQ(dvbc.channels[0].symbolRate, 6900000);
+    EXPECT_EQ(dvbc.channels[0].modulation.get<FrontendModulation::Tag::dvbc>(),
+              FrontendDvbcModulation::MOD_256QAM);
+}
+
+TEST(ChannelPlanTest, RejectsMalformedPlans) {
+    for (const char* text : {
+                 "channel 578000000 -45000 0 8\n",
+                 "band DVBX 474000000 858000000 8000000\n",
+                 "band DVBT 474000000 858000000 0\n",
+                 "band DVBT 858000000 474000000 8000000\n",
+                 "band DVBT 474000000 858000000 8000000\nchannel 578000000\n",
+                 "bands DVBT 474000000 858000000 8000000\n",
+         }) {
+        std::istringstream in(text);
+        std::map<FrontendType, ChannelPlan> plans;
+        plans[FrontendType::ATSC] = ChannelPlan();
+        EXPECT_FALSE(parseChannelPlans(in, &plans)) << text;
+        EXPECT_EQ(plans.size(), 1u) << text;
+    }
+}
+
+TEST(ScanSimulatorTest, BlindScanSweepsTheBand) {
+    ScanRecorder recorder(true /* continueOnLock */);
+    recorder.scan(dvbtSettings(0), FrontendScanType::SCAN_BLIND);
+    ASSERT_TRUE(recorder.waitForMessages(FrontendScanMessageType::END, 1));
+
+    EXPECT_EQ(recorder.lockResults(), (std::vector<bool>{true, false, true}));
+    EXPECT_EQ(recorder.lockedFrequencies(), (std::vector<int64_t>{118000000, 182000000}));
+    EXPECT_EQ(recorder.locks(), (std::vector<std::string>{"/data/local/tmp/a.ts", "",
+                                                          "/data/local/tmp/b.ts", ""}));
+
+    // One progress report per raster position, from 100MHz to 196MHz.
+    std::vector<int32_t> progress = recorder.progress();
+    ASSERT_EQ(progress.size(), 13u);
+    EXPECT_TRUE(std::is_sorted(progress.begin(), progress.end()));
+    EXPECT_EQ(progress.back(), 100);
+    EXPECT_EQ(recorder.messages().back().type, FrontendScanMessageType::END);
+    EXPECT_FALSE(recorder.simulator().getStatus().has_value());
+}
+
+TEST(ScanSimulatorTest, BlindScanStartsAtTheRequestedFrequency) {
+    ScanRecorder recorder(true /* continueOnLock */);
+    recorder.scan(dvbtSettings(181900000), FrontendScanType::SCAN_BLIND);
+    ASSERT_TRUE(recorder.waitForMessages(FrontendScanMessageType::END, 1));
+
+    EXPECT_EQ(recorder.lockResults(), (std::vector<bool>{true}));
+    EXPECT_EQ(recorder.lockedFrequencies(), (std::vector<int64_t>{182000000}));
+    EXPECT_EQ(recorder.progress().size(), 3u);
+}
+
+TEST(ScanSimulatorTest, AutoScanOnlyVisitsChannels) {
+    ScanRecorder recorder(true /* continueOnLock */);
+    recorder.scan(dvbtSettings(150000000), FrontendScanType::SCAN_AUTO);
+    ASSERT_TRUE(recorder.waitForMessages(FrontendScanMessageType::END, 1));
+
+    EXPECT_EQ(recorder.lockResults(), (std::vector<bool>{false, true}));
+    EXPECT_EQ(recorder.lockedFrequencies(), (std::vector<int64_t>{182000000}));
+    EXPECT_EQ(recorder.progress(), (std::vector<int32_t>{50, 100}));
+}
+
+TEST(ScanSimulatorTest, EmptySweepEnds) {
+    ScanRecorder recorder(true /* continueOnLock */);
+    recorder.scan(dvbtSettings(300000000), FrontendScanType::SCAN_BLIND);
+    ASSERT_TRUE(recorder.waitForMessages(FrontendScanMessageType::END, 1));
+
+    EXPECT_TRUE(recorder.lockResults().empty());
+    EXPECT_EQ(recorder.progress(), (std::vector<int32_t>{100}));
+}
+
+TEST(ScanSimulatorTest, HoldsTheLockUntilContinued) {
+    ScanRecorder recorder(false /* continueOnLock */);
+    const FrontendSettings settings = dvbtSettings(0);
+    recorder.scan(settings, FrontendScanType::SCAN_BLIND);
+    ASSERT_TRUE(recorder.waitForMessages(FrontendScanMessageType::LOCKED, 1));
+
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(recorder.count(FrontendScanMessageType::LOCKED), 1u);
+    EXPECT_EQ(recorder.locks(), (std::vector<std::string>{"/data/local/tmp/a.ts"}));
+    std::optional<ScanSimulator::Status> status = recorder.simulator().getStatus();
+    ASSERT_TRUE(status.has_value());
+    EXPECT_EQ(status->frequency, 118000000);
+    EXPECT_TRUE(status->isRfLocked);
+    EXPECT_TRUE(status->isDemodLocked);
+    EXPECT_EQ(status->signalStrength, -50000);
+
+    recorder.scan(settings, FrontendScanType::SCAN_BLIND);
+    ASSERT_TRUE(recorder.waitForMessages(FrontendScanMessageType::LOCKED, 3));
+    EXPECT_EQ(recorder.count(FrontendScanMessageType::END), 0u);
+    recorder.scan(settings, FrontendScanType::SCAN_BLIND);
+    ASSERT_TRUE(recorder.waitForMessages(FrontendScanMessageType::END, 1));
+    EXPECT_EQ(recorder.lockResults(), (std::vector<bool>{true, false, true}));
+}
+
+TEST(ScanSimulatorTest, NewSettingsRestartTheScan) {
+    ScanRecorder recorder(false /* continueOnLock */);
+    recorder.scan(dvbtSettings(0), FrontendScanType::SCAN_BLIND);
+    ASSERT_TRUE(recorder.waitForMessages(FrontendScanMessageType::LOCKED, 1));
+
+    recorder.scan(dvbtSettings(170000000), FrontendScanType::SCAN_BLIND);
+    ASSERT_TRUE(recorder.waitForMessages(FrontendScanMessageType::LOCKED, 2));
+    EXPECT_EQ(recorder.lockedFrequencies(), (std::vector<int64_t>{118000000, 182000000}));
+    EXPECT_EQ(recorder.locks(), (std::vector<std::string>{"/data/local/tmp/a.ts", "",
+                                                          "/data/local/tmp/b.ts"}));
+}
+
+TEST(ScanSimulatorTest, StopsMidSweep) {
+    ScanRecorder recorder(true /* continueOnLock */, {.dwell = 50ms, .lock = 50ms});
+    recorder.scan(dvbtSettings(0), FrontendScanType::SCAN_BLIND);
+    ASSERT_TRUE(recorder.waitForMessages(FrontendScanMessageType::PROGRESS_PERCENT, 1));
+    ASSERT_TRUE(recorder.simulator().getStatus().has_value());
+
+    const auto start = std::chrono::steady_clock::now();
+    recorder.simulator().stop();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 40ms);
+
+    const size_t messages = recorder.messages().size();
+    std::this_thread::sleep_for(120ms);
+    EXPECT_EQ(recorder.messages().size(), messages);
+    EXPECT_EQ(recorder.count(FrontendScanMessageType::END), 0u);
+    EXPECT_FALSE(recorder.simulator().getStatus().has_value());
+}
+
+TEST(ScanSimulatorTest, StopReleasesTheLock) {
+    ScanRecorder recorder(false /* continueOnLock */);
+    recorder.scan(dvbtSettings(0), FrontendScanType::SCAN_BLIND);
+    ASSERT_TRUE(recorder.waitForMessages(FrontendScanMessageType::LOCKED, 1));
+
+    recorder.simulator().stop();
+    EXPECT_EQ(recorder.locks(), (std::vector<std::string>{"/data/local/tmp/a.ts", ""}));
+    EXPECT_EQ(recorder.count(FrontendScanMessageType::END), 0u);
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::tv::tuner
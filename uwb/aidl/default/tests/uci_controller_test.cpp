@@ -0,0 +1,398 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "uci_controller.h"
+#include "uci_packet.h"
+
+namespace android {
+namespace hardware {
+namespace uwb {
+namespace impl {
+namespace {
+using namespace uci;
+using Bytes = std::vector<uint8_t>;
+
+constexpr auto kTimeout = std::chrono::seconds(5);
+
+// Session 0x01020304, as it appears in payloads.
+const Bytes kSessionId = {0x04, 0x03, 0x02, 0x01};
+
+Bytes concat(std::initializer_list<Bytes> parts) {
+    Bytes result;
+    for (const auto& part : parts) {
+        result.insert(result.end(), part.begin(), part.end());
+    }
+    return result;
+}
+
+class UciControllerTest : public ::testing::Test {
+  protected:
+    void SetUp() override { start(UciController::Options()); }
+
+    void start(UciController::Options options) {
+        mController.reset();
+        mController = std::make_unique<UciController>(
+                [this](const Bytes& packet) {
+                    std::lock_guard<std::mutex> lock(mLock);
+                    mPackets.push_back(packet);
+                    mCondition.notify_all();
+                },
+                options);
+    }
+
+    // Sends a raw byte stream and returns the packets sent back right away.
+    std::vector<Bytes> send(const Bytes& data) {
+        mController->receive(data);
+        return takePackets();
+    }
+
+    std::vector<Bytes> takePackets() {
+        std::lock_guard<std::mutex> lock(mLock);
+        return std::move(mPackets);
+    }
+
+    // Waits for a packet starting with the given header octets.
+    Bytes waitForPacket(uint8_t octet0, uint8_t octet1) {
+        std::unique_lock<std::mutex> lock(mLock);
+        Bytes found;
+        mCondition.wait_for(lock, kTimeout, [&] {
+            for (auto it = mPackets.begin(); it != mPackets.end(); ++it) {
+                if ((*it)[0] == octet0 && (*it)[1] == octet1) {
+                    found = std::move(*it);
+                    mPackets.erase(it);
+                    return true;
+                }
+            }
+            return false;
+        });
+        return found;
+    }
+
+    // Brings session 0x01020304 to the idle state, ranging with the given peers every 20 ms.
+    void configureSession(const Bytes& peers) {
+        send(concat({{0x21, 0x00, 0x00, 0x05}, kSessionId, {0x00}}));
+        const Bytes params = concat({{0x04},
+                                     {0x05, 0x01, static_cast<uint8_t>(peers.size() / 2)},
+                                     {0x06, 0x02, 0x11, 0x22},
+                                     {0x07, static_cast<uint8_t>(peers.size())},
+                                     peers,
+                                     {0x09, 0x04, 0x14, 0x00, 0x00, 0x00}});
+        auto packets = send(concat({{0x21, 0x03, 0x00, static_cast<uint8_t>(4 + params.size())},
+                                    kSessionId,
+                                    params}));
+        ASSERT_EQ(packets.size(), 2u);
+        EXPECT_EQ(packets[0], (Bytes{0x41, 0x03, 0x00, 0x02, kStatusOk, 0x00}));
+        EXPECT_EQ(packets[1],
+                  concat({{0x61, 0x02, 0x00, 0x06}, kSessionId, {kSessionStateIdle, 0x00}}));
+    }
+
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    std::vector<Bytes> mPackets;
+    std::unique_ptr<UciController> mController;
+};
+
+TEST(UciPacketTest, SegmentsLongMessages) {
+    UciMessage message = {.type = MessageType::NOTIFICATION,
+                          .gid = kGidRangingSessionControl,
+                          .oid = kOidRangeData,
+                          .payload = Bytes(300, 0xAB)};
+    auto packets = segmentMessage(message, kMaxPayloadSize);
+    ASSERT_EQ(packets.size(), 2u);
+    EXPECT_EQ(Bytes(packets[0].begin(), packets[0].begin() + 4), (Bytes{0x72, 0x00, 0x00, 0xFF}));
+    EXPECT_EQ(Bytes(packets[1].begin(), packets[1].begin() + 4), (Bytes{0x62, 0x00, 0x00, 0x2D}));
+    EXPECT_EQ(packets[1].size(), 4u + 45);
+
+    Reassembler reassembler(1024);
+    UciMessage joined;
+    EXPECT_EQ(reassembler.add(packets[0], &joined), Reassembler::Result::INCOMPLETE);
+    EXPECT_EQ(reassembler.add(packets[1], &joined), Reassembler::Result::COMPLETE);
+    EXPECT_EQ(joined.type, MessageType::NOTIFICATION);
+    EXPECT_EQ(joined.gid, kGidRangingSessionControl);
+    EXPECT_EQ(joined.payload, message.payload);
+}
+
+TEST(UciPacketTest, SegmentsEmptyMessages) {
+    UciMessage message = {.type = MessageType::COMMAND,
+                          .gid = kGidCore,
+                          .oid = kOidCoreGetDeviceInfo,
+                          .payload = {}};
+    EXPECT_EQ(segmentMessage(message, kMaxPayloadSize),
+              (std::vector<Bytes>{{0x20, 0x02, 0x00, 0x00}}));
+}
+
+TEST(UciPacketTest, RejectsInterleavedSegments) {
+    Reassembler reassembler(1024);
+    UciMessage message;
+    EXPECT_EQ(reassembler.add({0x31, 0x03, 0x00, 0x01, 0xAA}, &message),
+              Reassembler::Result::INCOMPLETE);
+    EXPECT_EQ(reassembler.add({0x21, 0x04, 0x00, 0x01, 0xBB}, &message),
+              Reassembler::Result::ERROR);
+    // The next message starts afresh.
+    EXPECT_EQ(reassembler.add({0x21, 0x04, 0x00, 0x01, 0xBB}, &message),
+              Reassembler::Result::COMPLETE);
+    EXPECT_EQ(message.payload, Bytes{0xBB});
+}
+
+TEST(UciPacketTest, RejectsOversizedMessages) {
+    Reassembler reassembler(4);
+    UciMessage message;
+    EXPECT_EQ(reassembler.add({0x31, 0x03, 0x00, 0x03, 1, 2, 3}, &message),
+              Reassembler::Result::INCOMPLETE);
+    EXPECT_EQ(reassembler.add({0x21, 0x03, 0x00, 0x02, 4, 5}, &message),
+              Reassembler::Result::ERROR);
+    EXPECT_EQ(reassembler.add({0x21, 0x03, 0x00, 0x02}, &message), Reassembler::Result::ERROR);
+}
+
+TEST(UciPacketTest, SplitsStreams) {
+    std::vector<Bytes> packets;
+    EXPECT_TRUE(splitPackets({0x20, 0x02, 0x00, 0x00, 0x21, 0x05, 0x00, 0x00}, &packets));
+    EXPECT_EQ(packets, (std::vector<Bytes>{{0x20, 0x02, 0x00, 0x00}, {0x21, 0x05, 0x00, 0x00}}));
+
+    packets.clear();
+    EXPECT_FALSE(splitPackets({0x20, 0x02, 0x00, 0x00, 0x21, 0x03, 0x00, 0x04, 0x01}, &packets));
+    EXPECT_EQ(packets.size(), 1u);
+}
+
+TEST_F(UciControllerTest, ReportsReadyOnPowerOn) {
+    mController->powerOn();
+    EXPECT_EQ(takePackets(), (std::vector<Bytes>{{0x60, 0x01, 0x00, 0x01, kDeviceStateReady}}));
+}
+
+TEST_F(UciControllerTest, GetDeviceInfo) {
+    EXPECT_EQ(send({0x20, 0x02, 0x00, 0x00}),
+              (std::vector<Bytes>{{0x40, 0x02, 0x00, 0x0A, kStatusOk, 0x01, 0x10, 0x01, 0x30, 0x01,
+                                   0x30, 0x01, 0x10, 0x00}}));
+}
+
+TEST_F(UciControllerTest, ResetsDevice) {
+    send(concat({{0x21, 0x00, 0x00, 0x05}, kSessionId, {0x00}}));
+    EXPECT_EQ(send({0x20, 0x00, 0x00, 0x01, 0x00}),
+              (std::vector<Bytes>{{0x40, 0x00, 0x00, 0x01, kStatusOk},
+                                  {0x60, 0x01, 0x00, 0x01, kDeviceStateReady}}));
+    EXPECT_EQ(send({0x21, 0x05, 0x00, 0x00}),
+              (std::vector<Bytes>{{0x41, 0x05, 0x00, 0x02, kStatusOk, 0x00}}));
+}
+
+TEST_F(UciControllerTest, SetsAndGetsDeviceConfig) {
+    // Low power mode can be set, the device state can't.
+    EXPECT_EQ(send({0x20, 0x04, 0x00, 0x07, 0x02, 0x01, 0x01, 0x00, 0x00, 0x01, 0x01}),
+              (std::vector<Bytes>{
+                      {0x40, 0x04, 0x00, 0x04, kStatusInvalidParam, 0x01, 0x00, kStatusReadOnly}}));
+    EXPECT_EQ(send({0x20, 0x05, 0x00, 0x03, 0x02, 0x00, 0x01}),
+              (std::vector<Bytes>{{0x40, 0x05, 0x00, 0x08, kStatusOk, 0x02, 0x00, 0x01,
+                                   kDeviceStateReady, 0x01, 0x01, 0x00}}));
+}
+
+TEST_F(UciControllerTest, RangesWithSyntheticPeers) {
+    configureSession({0xA1, 0xB1});
+
+    EXPECT_EQ(send(concat({{0x22, 0x00, 0x00, 0x04}, kSessionId})),
+              (std::vector<Bytes>{
+                      {0x42, 0x00, 0x00, 0x01, kStatusOk},
+                      concat({{0x61, 0x02, 0x00, 0x06}, kSessionId, {kSessionStateActive, 0x00}}),
+                      {0x60, 0x01, 0x00, 0x01, kDeviceStateActive}}));
+
+    for (uint32_t sequence = 0; sequence < 3; ++sequence) {
+        Bytes data = waitForPacket(0x62, 0x00);
+        ASSERT_EQ(data.size(), 4u + 25 + 31);
+        EXPECT_EQ(data[3], 25 + 31);
+        EXPECT_EQ(Bytes(data.begin() + 4, data.begin() + 8),
+                  (Bytes{static_cast<uint8_t>(sequence), 0x00, 0x00, 0x00}));
+        EXPECT_EQ(Bytes(data.begin() + 8, data.begin() + 12), kSessionId);
+        // The ranging interval.
+        EXPECT_EQ(Bytes(data.begin() + 13, data.begin() + 17), (Bytes{0x14, 0x00, 0x00, 0x00}));
+        EXPECT_EQ(data[28], 1);
+        // The peer, its status and distance.
+        EXPECT_EQ(Bytes(data.begin() + 29, data.begin() + 33),
+                  (Bytes{0xA1, 0xB1, kStatusOk, 0x00}));
+        EXPECT_EQ(data[33] | (data[34] << 8), 100 + 5 * sequence);
+    }
+
+    mController->holdResponses(true);
+    mController->receive(concat({{0x22, 0x01, 0x00, 0x04}, kSessionId}));
+    takePackets();
+    mController->holdResponses(false);
+    auto packets = takePackets();
+    ASSERT_GE(packets.size(), 3u);
+    EXPECT_EQ(packets[0], (Bytes{0x42, 0x01, 0x00, 0x01, kStatusOk}));
+    EXPECT_EQ(packets[1],
+              concat({{0x61, 0x02, 0x00, 0x06}, kSessionId, {kSessionStateIdle, 0x00}}));
+    EXPECT_EQ(packets[2], (Bytes{0x60, 0x01, 0x00, 0x01, kDeviceStateReady}));
+
+    packets = send(concat({{0x22, 0x03, 0x00, 0x04}, kSessionId}));
+    ASSERT_EQ(packets.size(), 1u);
+    EXPECT_EQ(Bytes(packets[0].begin(), packets[0].begin() + 5),
+              (Bytes{0x42, 0x03, 0x00, 0x05, kStatusOk}));
+    EXPECT_GE(packets[0][5], 3);
+
+    EXPECT_EQ(send(concat({{0x21, 0x01, 0x00, 0x04}, kSessionId})),
+              (std::vector<Bytes>{{0x41, 0x01, 0x00, 0x01, kStatusOk},
+                                  concat({{0x61, 0x02, 0x00, 0x06},
+                                          kSessionId,
+                                          {kSessionStateDeinit, 0x00}})}));
+    EXPECT_FALSE(mController->hasSession(0x01020304));
+}
+
+TEST_F(UciControllerTest, SegmentsRangeDataOfManyPeers) {
+    configureSession({1, 0, 2, 0, 3, 0, 4, 0, 5, 0, 6, 0, 7, 0, 8, 0});
+    send(concat({{0x22, 0x00, 0x00, 0x04}, kSessionId}));
+
+    // 25 + 8 * 31 bytes don't fit a single packet.
+    Bytes first = waitForPacket(0x72, 0x00);
+    ASSERT_EQ(first.size(), 4u + 255);
+    Bytes last = waitForPacket(0x62, 0x00);
+    ASSERT_EQ(last.size(), 4u + 25 + 8 * 31 - 255);
+}
+
+TEST_F(UciControllerTest, ReassemblesSegmentedCommands) {
+    send(concat({{0x21, 0x00, 0x00, 0x05}, kSessionId, {0x00}}));
+    // SESSION_SET_APP_CONFIG split after the session id.
+    const Bytes stream = concat({{0x31, 0x03, 0x00, 0x04},
+                                 kSessionId,
+                                 {0x21, 0x03, 0x00, 0x09, 0x02, 0x06, 0x02, 0x11, 0x22, 0x07, 0x02,
+                                  0xA1, 0xB1}});
+    auto packets = send(stream);
+    ASSERT_EQ(packets.size(), 2u);
+    EXPECT_EQ(packets[0], (Bytes{0x41, 0x03, 0x00, 0x02, kStatusOk, 0x00}));
+    EXPECT_EQ(packets[1],
+              concat({{0x61, 0x02, 0x00, 0x06}, kSessionId, {kSessionStateIdle, 0x00}}));
+
+    EXPECT_EQ(send(concat({{0x21, 0x04, 0x00, 0x06}, kSessionId, {0x01, 0x07}})),
+              (std::vector<Bytes>{{0x41, 0x04, 0x00, 0x06, kStatusOk, 0x01, 0x07, 0x02, 0xA1,
+                                   0xB1}}));
+}
+
+TEST_F(UciControllerTest, RejectsInvalidAppConfig) {
+    send(concat({{0x21, 0x00, 0x00, 0x05}, kSessionId, {0x00}}));
+    // Channel 7 doesn't exist, the device address is applied regardless.
+    EXPECT_EQ(send(concat({{0x21, 0x03, 0x00, 0x0C}, kSessionId,
+                           {0x02, 0x04, 0x01, 0x07, 0x06, 0x02, 0x11, 0x22}})),
+              (std::vector<Bytes>{{0x41, 0x03, 0x00, 0x04, kStatusInvalidParam, 0x01, 0x04,
+                                   kStatusInvalidParam}}));
+    EXPECT_EQ(send(concat({{0x21, 0x06, 0x00, 0x04}, kSessionId})),
+              (std::vector<Bytes>{{0x41, 0x06, 0x00, 0x02, kStatusOk, kSessionStateInit}}));
+    // An unconfigured session can't range.
+    EXPECT_EQ(send(concat({{0x22, 0x00, 0x00, 0x04}, kSessionId})),
+              (std::vector<Bytes>{{0x42, 0x00, 0x00, 0x01, kStatusSessionNotConfigured}}));
+}
+
+TEST_F(UciControllerTest, EnforcesSessionRules) {
+    start({.maxSessions = 1,
+           .maxPayloadSize = kMaxPayloadSize,
+           .maxMessageSize = 2048,
+           .commandCredits = 1});
+    send(concat({{0x21, 0x00, 0x00, 0x05}, kSessionId, {0x00}}));
+    EXPECT_EQ(send(concat({{0x21, 0x00, 0x00, 0x05}, kSessionId, {0x00}})),
+              (std::vector<Bytes>{{0x41, 0x00, 0x00, 0x01, kStatusSessionDuplicate}}));
+    EXPECT_EQ(send({0x21, 0x00, 0x00, 0x05, 0x01, 0x00, 0x00, 0x00, 0x00}),
+              (std::vector<Bytes>{{0x41, 0x00, 0x00, 0x01, kStatusMaxSessionsExceeded}}));
+    EXPECT_EQ(send({0x22, 0x01, 0x00, 0x04, 0x09, 0x00, 0x00, 0x00}),
+              (std::vector<Bytes>{{0x42, 0x01, 0x00, 0x01, kStatusSessionNotExist}}));
+    EXPECT_EQ(send(concat({{0x22, 0x01, 0x00, 0x04}, kSessionId})),
+              (std::vector<Bytes>{{0x42, 0x01, 0x00, 0x01, kStatusRejected}}));
+}
+
+TEST_F(UciControllerTest, ReportsMalformedPackets) {
+    const Bytes syntaxError = {0x60, 0x07, 0x00, 0x01, kStatusSyntaxError};
+    EXPECT_EQ(send({0x2B, 0x00, 0x00, 0x00}),
+              (std::vector<Bytes>{{0x4B, 0x00, 0x00, 0x01, kStatusUnknownGid}}));
+    EXPECT_EQ(send({0x20, 0x3F, 0x00, 0x00}),
+              (std::vector<Bytes>{{0x40, 0x3F, 0x00, 0x01, kStatusUnknownOid}}));
+    EXPECT_EQ(send({0x20, 0x02, 0x00, 0x01, 0x00}),
+              (std::vector<Bytes>{{0x40, 0x02, 0x00, 0x01, kStatusSyntaxError}}));
+    // Truncated packets, responses and data packets aren't accepted.
+    EXPECT_EQ(send({0x20, 0x00, 0x00, 0x01}), std::vector<Bytes>{syntaxError});
+    EXPECT_EQ(send({0x40, 0x02, 0x00, 0x00}), std::vector<Bytes>{syntaxError});
+    EXPECT_EQ(send({0x00, 0x00, 0x01, 0x00, 0xFF}), std::vector<Bytes>{syntaxError});
+    // Packets before a malformed one are handled.
+    EXPECT_EQ(send({0x21, 0x05, 0x00, 0x00, 0x21}),
+              (std::vector<Bytes>{{0x41, 0x05, 0x00, 0x02, kStatusOk, 0x00}, syntaxError}));
+}
+
+TEST_F(UciControllerTest, InjectsFailures) {
+    mController->failNextCommand(kGidCore, kOidCoreGetDeviceInfo, kStatusFailed);
+    EXPECT_EQ(send({0x20, 0x02, 0x00, 0x00}),
+              (std::vector<Bytes>{{0x40, 0x02, 0x00, 0x01, kStatusFailed}}));
+    EXPECT_EQ(send({0x20, 0x02, 0x00, 0x00})[0][4], kStatusOk);
+
+    mController->sendGenericError(kStatusFailed);
+    EXPECT_EQ(takePackets(), (std::vector<Bytes>{{0x60, 0x07, 0x00, 0x01, kStatusFailed}}));
+
+    configureSession({0xA1, 0xB1});
+    send(concat({{0x22, 0x00, 0x00, 0x04}, kSessionId}));
+    mController->enterErrorState();
+    EXPECT_EQ(waitForPacket(0x60, 0x01), (Bytes{0x60, 0x01, 0x00, 0x01, kDeviceStateError}));
+    takePackets();
+    EXPECT_EQ(send({0x21, 0x05, 0x00, 0x00}),
+              (std::vector<Bytes>{{0x41, 0x05, 0x00, 0x01, kStatusRejected}}));
+    // Only a reset recovers.
+    EXPECT_EQ(send({0x20, 0x00, 0x00, 0x01, 0x00}),
+              (std::vector<Bytes>{{0x40, 0x00, 0x00, 0x01, kStatusOk},
+                                  {0x60, 0x01, 0x00, 0x01, kDeviceStateReady}}));
+    EXPECT_EQ(send({0x21, 0x05, 0x00, 0x00}),
+              (std::vector<Bytes>{{0x41, 0x05, 0x00, 0x02, kStatusOk, 0x00}}));
+}
+
+TEST_F(UciControllerTest, EnforcesCommandCredits) {
+    mController->holdResponses(true);
+    EXPECT_TRUE(send({0x20, 0x02, 0x00, 0x00}).empty());
+    // The host didn't wait for the response.
+    EXPECT_EQ(send({0x21, 0x05, 0x00, 0x00}),
+              (std::vector<Bytes>{{0x60, 0x07, 0x00, 0x01, kStatusCommandRetry}}));
+
+    mController->holdResponses(false);
+    auto packets = takePackets();
+    ASSERT_EQ(packets.size(), 1u);
+    EXPECT_EQ(packets[0][1], kOidCoreGetDeviceInfo);
+    EXPECT_EQ(send({0x21, 0x05, 0x00, 0x00}),
+              (std::vector<Bytes>{{0x41, 0x05, 0x00, 0x02, kStatusOk, 0x00}}));
+}
+
+TEST_F(UciControllerTest, AllowsPipelinedCommandsWithMoreCredits) {
+    start({.maxSessions = 5,
+           .maxPayloadSize = kMaxPayloadSize,
+           .maxMessageSize = 2048,
+           .commandCredits = 2});
+    mController->holdResponses(true);
+    send({0x20, 0x02, 0x00, 0x00});
+    send({0x21, 0x05, 0x00, 0x00});
+    mController->holdResponses(false);
+    auto packets = takePackets();
+    ASSERT_EQ(packets.size(), 2u);
+    EXPECT_EQ(packets[0][0], 0x40);
+    EXPECT_EQ(packets[1][0], 0x41);
+}
+
+TEST_F(UciControllerTest, SetsCountryCode) {
+    EXPECT_EQ(send({0x2C, 0x01, 0x00, 0x02, 'U', 'S'}),
+              (std::vector<Bytes>{{0x4C, 0x01, 0x00, 0x01, kStatusOk}}));
+    EXPECT_EQ(send({0x2C, 0x01, 0x00, 0x02, '0', '0'}),
+              (std::vector<Bytes>{{0x4C, 0x01, 0x00, 0x01, kStatusInvalidParam}}));
+}
+
+}  // namespace
+}  // namespace impl
+}  // namespace uwb
+}  // namespace hardware
+}  // namespace android
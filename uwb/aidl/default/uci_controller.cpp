@@ -0,0 +1,655 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cctype>
+
+#include <android-base/logging.h>
+
+#include "uci_controller.h"
+
+namespace android {
+namespace hardware {
+namespace uwb {
+namespace impl {
+using namespace uci;
+using ::android::base::ScopedLockAssertion;
+using std::chrono::steady_clock;
+
+namespace {
+constexpr uint32_t kDefaultRangingIntervalMs = 200;
+constexpr uint8_t kMaxControlees = 8;
+constexpr uint8_t kSessionTypeFiraRanging = 0x00;
+constexpr uint8_t kSessionTypeFiraRangingAndData = 0x01;
+constexpr uint8_t kRangingMeasurementTwoWay = 0x01;
+constexpr uint8_t kConfigDeviceState = 0x00;
+constexpr uint8_t kReasonStateChange = 0x00;
+
+void appendLe16(std::vector<uint8_t>* out, uint16_t value) {
+    out->push_back(value & 0xFF);
+    out->push_back(value >> 8);
+}
+
+void appendLe32(std::vector<uint8_t>* out, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        out->push_back((value >> shift) & 0xFF);
+    }
+}
+
+uint32_t readLe32(const std::vector<uint8_t>& data, size_t offset) {
+    return data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16) |
+           (static_cast<uint32_t>(data[offset + 3]) << 24);
+}
+
+using Tlvs = std::vector<std::pair<uint8_t, std::vector<uint8_t>>>;
+
+// Parses a parameter count at offset followed by that many id, length and value triplets, which
+// must take the rest of the payload.
+bool parseTlvs(const std::vector<uint8_t>& payload, size_t offset, Tlvs* tlvs) {
+    if (offset >= payload.size()) {
+        return false;
+    }
+    const size_t count = payload[offset++];
+    for (size_t i = 0; i < count; ++i) {
+        if (payload.size() - offset < 2 || payload.size() - offset - 2 < payload[offset + 1]) {
+            return false;
+        }
+        const uint8_t id = payload[offset];
+        const size_t length = payload[offset + 1];
+        tlvs->emplace_back(id, std::vector<uint8_t>(payload.begin() + offset + 2,
+                                                    payload.begin() + offset + 2 + length));
+        offset += 2 + length;
+    }
+    return offset == payload.size();
+}
+
+void appendTlv(std::vector<uint8_t>* out, uint8_t id, const std::vector<uint8_t>& value) {
+    out->push_back(id);
+    out->push_back(value.size());
+    out->insert(out->end(), value.begin(), value.end());
+}
+
+bool isValidAppConfig(uint8_t id, const std::vector<uint8_t>& value) {
+    switch (id) {
+        case kAppConfigDeviceType:
+        case kAppConfigRangingRoundUsage:
+            return value.size() == 1;
+        case kAppConfigChannelNumber:
+            return value.size() == 1 && (value[0] == 5 || value[0] == 6 || value[0] == 8 ||
+                                         value[0] == 9 || value[0] == 10 || value[0] == 12 ||
+                                         value[0] == 13 || value[0] == 14);
+        case kAppConfigNumberOfControlees:
+            return value.size() == 1 && value[0] >= 1 && value[0] <= kMaxControlees;
+        case kAppConfigDeviceMacAddress:
+            return value.size() == 2;
+        case kAppConfigDstMacAddress:
+            return !value.empty() && value.size() % 2 == 0 && value.size() <= 2 * kMaxControlees;
+        case kAppConfigRangingInterval:
+            return value.size() == 4 && readLe32(value, 0) > 0;
+        default:
+            // Other parameters aren't modeled, and are stored as they are.
+            return true;
+    }
+}
+
+uint32_t rangingIntervalMs(const std::map<uint8_t, std::vector<uint8_t>>& appConfig) {
+    auto it = appConfig.find(kAppConfigRangingInterval);
+    return it == appConfig.end() ? kDefaultRangingIntervalMs : readLe32(it->second, 0);
+}
+
+// A session can range once it knows its own address and those of all its peers.
+bool isConfigured(const std::map<uint8_t, std::vector<uint8_t>>& appConfig) {
+    auto controlees = appConfig.find(kAppConfigNumberOfControlees);
+    auto peers = appConfig.find(kAppConfigDstMacAddress);
+    const size_t peerCount = controlees == appConfig.end() ? 1 : controlees->second[0];
+    return appConfig.count(kAppConfigDeviceMacAddress) && peers != appConfig.end() &&
+           peers->second.size() == 2 * peerCount;
+}
+
+UciMessage notification(uint8_t gid, uint8_t oid, std::vector<uint8_t> payload) {
+    return {.type = MessageType::NOTIFICATION, .gid = gid, .oid = oid,
+            .payload = std::move(payload)};
+}
+
+}  // namespace
+
+UciController::UciController(PacketSender sender) : UciController(std::move(sender), Options()) {}
+
+UciController::UciController(PacketSender sender, Options options)
+    : mSender(std::move(sender)),
+      mOptions(options),
+      mReassembler(options.maxMessageSize),
+      mCredits(options.commandCredits),
+      mRangingThread([this] { rangingLoop(); }) {}
+
+UciController::~UciController() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStopping = true;
+        mRangingCondition.notify_all();
+    }
+    mRangingThread.join();
+}
+
+void UciController::powerOn() {
+    std::lock_guard<std::mutex> lock(mLock);
+    resetLocked();
+    sendLocked(notification(kGidCore, kOidCoreDeviceStatus, {mDeviceState}));
+}
+
+void UciController::receive(const std::vector<uint8_t>& data) {
+    std::lock_guard<std::mutex> lock(mLock);
+    std::vector<std::vector<uint8_t>> packets;
+    const bool complete = splitPackets(data, &packets);
+    for (const auto& packet : packets) {
+        UciMessage message;
+        switch (mReassembler.add(packet, &message)) {
+            case Reassembler::Result::INCOMPLETE:
+                break;
+            case Reassembler::Result::COMPLETE:
+                if (message.type == MessageType::COMMAND) {
+                    handleCommandLocked(message);
+                    break;
+                }
+                // Only commands may be sent to the controller.
+                [[fallthrough]];
+            case Reassembler::Result::ERROR:
+                LOG(WARNING) << "Dropping a malformed UCI packet";
+                sendLocked(notification(kGidCore, kOidCoreGenericError, {kStatusSyntaxError}));
+                break;
+        }
+    }
+    if (!complete) {
+        LOG(WARNING) << "Dropping a truncated UCI packet";
+        sendLocked(notification(kGidCore, kOidCoreGenericError, {kStatusSyntaxError}));
+    }
+}
+
+bool UciController::hasSession(uint32_t sessionId) const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mSessions.count(sessionId) != 0;
+}
+
+void UciController::failNextCommand(uint8_t gid, uint8_t oid, uint8_t status) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mFailures[{gid, oid}] = status;
+}
+
+void UciController::sendGenericError(uint8_t status) {
+    std::lock_guard<std::mutex> lock(mLock);
+    sendLocked(notification(kGidCore, kOidCoreGenericError, {status}));
+}
+
+void UciController::enterErrorState() {
+    std::lock_guard<std::mutex> lock(mLock);
+    for (auto& [id, session] : mSessions) {
+        if (session.state == kSessionStateActive) {
+            session.state = kSessionStateIdle;
+        }
+    }
+    mDeviceState = kDeviceStateError;
+    sendLocked(notification(kGidCore, kOidCoreDeviceStatus, {mDeviceState}));
+}
+
+void UciController::holdResponses(bool hold) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mHoldResponses = hold;
+    if (hold) {
+        return;
+    }
+    while (!mHeldMessages.empty()) {
+        transmitLocked(mHeldMessages.front());
+        mHeldMessages.pop_front();
+    }
+}
+
+void UciController::handleCommandLocked(const UciMessage& command) {
+    if (mCredits == 0) {
+        // The host didn't wait for the response to its previous command.
+        LOG(WARNING) << "Dropping a UCI command sent without credit";
+        transmitLocked(notification(kGidCore, kOidCoreGenericError, {kStatusCommandRetry}));
+        return;
+    }
+    mCredits--;
+
+    std::vector<UciMessage> notifications;
+    sendLocked({.type = MessageType::RESPONSE,
+                .gid = command.gid,
+                .oid = command.oid,
+                .payload = executeLocked(command, &notifications)});
+    for (const auto& message : notifications) {
+        sendLocked(message);
+    }
+}
+
+std::vector<uint8_t> UciController::executeLocked(const UciMessage& command,
+                                                  std::vector<UciMessage>* notifications) {
+    auto failure = mFailures.find({command.gid, command.oid});
+    if (failure != mFailures.end()) {
+        const uint8_t status = failure->second;
+        mFailures.erase(failure);
+        return {status};
+    }
+    // Only a reset gets the device out of the error state.
+    if (mDeviceState == kDeviceStateError &&
+        !(command.gid == kGidCore && (command.oid == kOidCoreDeviceReset ||
+                                      command.oid == kOidCoreGetDeviceInfo))) {
+        return {kStatusRejected};
+    }
+
+    switch (command.gid) {
+        case kGidCore:
+            return coreCommandLocked(command, notifications);
+        case kGidSessionConfig:
+            return sessionConfigCommandLocked(command, notifications);
+        case kGidRangingSessionControl:
+            return rangingCommandLocked(command, notifications);
+        case kGidAndroid:
+            return androidCommandLocked(command);
+        default:
+            return {kStatusUnknownGid};
+    }
+}
+
+std::vector<uint8_t> UciController::coreCommandLocked(const UciMessage& command,
+                                                      std::vector<UciMessage>* notifications) {
+    const std::vector<uint8_t>& payload = command.payload;
+    switch (command.oid) {
+        case kOidCoreDeviceReset:
+            if (payload.size() != 1) {
+                return {kStatusSyntaxError};
+            }
+            resetLocked();
+            notifications->push_back(
+                    notification(kGidCore, kOidCoreDeviceStatus, {kDeviceStateReady}));
+            return {kStatusOk};
+
+        case kOidCoreGetDeviceInfo:
+            if (!payload.empty()) {
+                return {kStatusSyntaxError};
+            }
+            // UCI 1.1.0, MAC 1.3.0, PHY 1.3.0 and UCI test 1.1.0, without vendor information.
+            return {kStatusOk, 0x01, 0x10, 0x01, 0x30, 0x01, 0x30, 0x01, 0x10, 0x00};
+
+        case kOidCoreGetCapsInfo:
+            if (!payload.empty()) {
+                return {kStatusSyntaxError};
+            }
+            return {kStatusOk, 0x00};
+
+        case kOidCoreSetConfig: {
+            Tlvs tlvs;
+            if (!parseTlvs(payload, 0, &tlvs)) {
+                return {kStatusSyntaxError, 0};
+            }
+            std::vector<uint8_t> failures;
+            for (auto& [id, value] : tlvs) {
+                if (id == kConfigDeviceState) {
+                    failures.push_back(id);
+                    failures.push_back(kStatusReadOnly);
+                } else {
+                    mDeviceConfig[id] = std::move(value);
+                }
+            }
+            std::vector<uint8_t> response = {failures.empty() ? kStatusOk : kStatusInvalidParam,
+                                             static_cast<uint8_t>(failures.size() / 2)};
+            response.insert(response.end(), failures.begin(), failures.end());
+            return response;
+        }
+
+        case kOidCoreGetConfig: {
+            if (payload.empty() || payload.size() != 1u + payload[0]) {
+                return {kStatusSyntaxError, 0};
+            }
+            std::vector<uint8_t> response = {kStatusOk, payload[0]};
+            for (size_t i = 1; i < payload.size(); ++i) {
+                auto it = mDeviceConfig.find(payload[i]);
+                if (payload[i] == kConfigDeviceState) {
+                    appendTlv(&response, payload[i], {mDeviceState});
+                } else if (it != mDeviceConfig.end()) {
+                    appendTlv(&response, payload[i], it->second);
+                } else {
+                    response[0] = kStatusInvalidParam;
+                    appendTlv(&response, payload[i], {});
+                }
+            }
+            return response;
+        }
+
+        default:
+            return {kStatusUnknownOid};
+    }
+}
+
+std::vector<uint8_t> UciController::sessionConfigCommandLocked(
+        const UciMessage& command, std::vector<UciMessage>* notifications) {
+    const std::vector<uint8_t>& payload = command.payload;
+    switch (command.oid) {
+        case kOidSessionInit: {
+            if (payload.size() != 5) {
+                return {kStatusSyntaxError};
+            }
+            const uint32_t id = readLe32(payload, 0);
+            const uint8_t type = payload[4];
+            if (type != kSessionTypeFiraRanging && type != kSessionTypeFiraRangingAndData) {
+                return {kStatusInvalidParam};
+            }
+            if (mSessions.count(id)) {
+                return {kStatusSessionDuplicate};
+            }
+            if (mSessions.size() >= mOptions.maxSessions) {
+                return {kStatusMaxSessionsExceeded};
+            }
+            Session& session = mSessions[id];
+            session.id = id;
+            session.type = type;
+            notifications->push_back(sessionStatus(session, kReasonStateChange));
+            return {kStatusOk};
+        }
+
+        case kOidSessionDeinit: {
+            Session* session = payload.size() == 4 ? findSessionLocked(payload) : nullptr;
+            if (session == nullptr) {
+                return {payload.size() == 4 ? kStatusSessionNotExist : kStatusSyntaxError};
+            }
+            session->state = kSessionStateDeinit;
+            notifications->push_back(sessionStatus(*session, kReasonStateChange));
+            mSessions.erase(session->id);
+            updateDeviceStateLocked(notifications);
+            return {kStatusOk};
+        }
+
+        case kOidSessionSetAppConfig: {
+            Session* session = payload.size() >= 4 ? findSessionLocked(payload) : nullptr;
+            if (session == nullptr) {
+                return {payload.size() >= 4 ? kStatusSessionNotExist : kStatusSyntaxError, 0};
+            }
+            std::vector<uint8_t> failures;
+            const uint8_t status = setAppConfigLocked(session, payload, &failures);
+            std::vector<uint8_t> response = {status, static_cast<uint8_t>(failures.size() / 2)};
+            response.insert(response.end(), failures.begin(), failures.end());
+            if (session->state == kSessionStateInit && isConfigured(session->appConfig)) {
+                session->state = kSessionStateIdle;
+                notifications->push_back(sessionStatus(*session, kReasonStateChange));
+            }
+            return response;
+        }
+
+        case kOidSessionGetAppConfig: {
+            Session* session = payload.size() >= 5 ? findSessionLocked(payload) : nullptr;
+            if (session == nullptr) {
+                return {payload.size() >= 5 ? kStatusSessionNotExist : kStatusSyntaxError, 0};
+            }
+            if (payload.size() != 5u + payload[4]) {
+                return {kStatusSyntaxError, 0};
+            }
+            std::vector<uint8_t> response = {kStatusOk, payload[4]};
+            if (payload[4] == 0) {
+                // All parameters were asked for.
+                response[1] = session->appConfig.size();
+                for (const auto& [id, value] : session->appConfig) {
+                    appendTlv(&response, id, value);
+                }
+            }
+            for (size_t i = 5; i < payload.size(); ++i) {
+                auto it = session->appConfig.find(payload[i]);
+                if (it == session->appConfig.end()) {
+                    response[0] = kStatusInvalidParam;
+                    appendTlv(&response, payload[i], {});
+                } else {
+                    appendTlv(&response, payload[i], it->second);
+                }
+            }
+            return response;
+        }
+
+        case kOidSessionGetCount:
+            if (!payload.empty()) {
+                return {kStatusSyntaxError};
+            }
+            return {kStatusOk, static_cast<uint8_t>(mSessions.size())};
+
+        case kOidSessionGetState: {
+            Session* session = payload.size() == 4 ? findSessionLocked(payload) : nullptr;
+            if (session == nullptr) {
+                return {payload.size() == 4 ? kStatusSessionNotExist : kStatusSyntaxError};
+            }
+            return {kStatusOk, session->state};
+        }
+
+        default:
+            return {kStatusUnknownOid};
+    }
+}
+
+std::vector<uint8_t> UciController::rangingCommandLocked(const UciMessage& command,
+                                                         std::vector<UciMessage>* notifications) {
+    const std::vector<uint8_t>& payload = command.payload;
+    if (command.oid != kOidRangeStart && command.oid != kOidRangeStop &&
+        command.oid != kOidRangeGetRangingCount) {
+        return {kStatusUnknownOid};
+    }
+    Session* session = payload.size() == 4 ? findSessionLocked(payload) : nullptr;
+    if (session == nullptr) {
+        return {payload.size() == 4 ? kStatusSessionNotExist : kStatusSyntaxError};
+    }
+
+    switch (command.oid) {
+        case kOidRangeStart:
+            if (session->state == kSessionStateInit) {
+                return {kStatusSessionNotConfigured};
+            }
+            if (session->state == kSessionStateActive) {
+                return {kStatusSessionActive};
+            }
+            session->state = kSessionStateActive;
+            session->nextRound = steady_clock::now() +
+                                 std::chrono::milliseconds(rangingIntervalMs(session->appConfig));
+            notifications->push_back(sessionStatus(*session, kReasonStateChange));
+            updateDeviceStateLocked(notifications);
+            mRangingCondition.notify_all();
+            return {kStatusOk};
+
+        case kOidRangeStop:
+            if (session->state != kSessionStateActive) {
+                return {kStatusRejected};
+            }
+            session->state = kSessionStateIdle;
+            notifications->push_back(sessionStatus(*session, kReasonStateChange));
+            updateDeviceStateLocked(notifications);
+            return {kStatusOk};
+
+        default: {
+            std::vector<uint8_t> response = {kStatusOk};
+            appendLe32(&response, session->rangingCount);
+            return response;
+        }
+    }
+}
+
+std::vector<uint8_t> UciController::androidCommandLocked(const UciMessage& command) {
+    switch (command.oid) {
+        case kOidAndroidGetPowerStats: {
+            if (!command.payload.empty()) {
+                return {kStatusSyntaxError};
+            }
+            // Idle, transmit and receive times, and the wake count. Nothing is drawn by a
+            // simulated radio.
+            std::vector<uint8_t> response = {kStatusOk};
+            response.insert(response.end(), 16, 0);
+            return response;
+        }
+
+        case kOidAndroidSetCountryCode:
+            if (command.payload.size() != 2) {
+                return {kStatusSyntaxError};
+            }
+            return {isalpha(command.payload[0]) && isalpha(command.payload[1])
+                            ? kStatusOk
+                            : kStatusInvalidParam};
+
+        default:
+            return {kStatusUnknownOid};
+    }
+}
+
+uint8_t UciController::setAppConfigLocked(Session* session, const std::vector<uint8_t>& payload,
+                                          std::vector<uint8_t>* failures) {
+    Tlvs tlvs;
+    if (!parseTlvs(payload, 4, &tlvs)) {
+        return kStatusSyntaxError;
+    }
+    if (session->state == kSessionStateActive) {
+        return kStatusSessionActive;
+    }
+    for (auto& [id, value] : tlvs) {
+        if (isValidAppConfig(id, value)) {
+            session->appConfig[id] = std::move(value);
+        } else {
+            failures->push_back(id);
+            failures->push_back(kStatusInvalidParam);
+        }
+    }
+    return failures->empty() ? kStatusOk : kStatusInvalidParam;
+}
+
+UciController::Session* UciController::findSessionLocked(const std::vector<uint8_t>& payload) {
+    auto it = mSessions.find(readLe32(payload, 0));
+    return it == mSessions.end() ? nullptr : &it->second;
+}
+
+void UciController::sendLocked(const UciMessage& message) {
+    // Nothing overtakes a held response.
+    if ((mHoldResponses && message.type == MessageType::RESPONSE) || !mHeldMessages.empty()) {
+        mHeldMessages.push_back(message);
+        return;
+    }
+    transmitLocked(message);
+}
+
+void UciController::transmitLocked(const UciMessage& message) {
+    for (const auto& packet : segmentMessage(message, mOptions.maxPayloadSize)) {
+        mSender(packet);
+    }
+    if (message.type == MessageType::RESPONSE) {
+        mCredits++;
+    }
+}
+
+void UciController::updateDeviceStateLocked(std::vector<UciMessage>* notifications) {
+    // The device is active while any session ranges.
+    bool active = false;
+    for (const auto& [id, session] : mSessions) {
+        active = active || session.state == kSessionStateActive;
+    }
+    const uint8_t state = active ? kDeviceStateActive : kDeviceStateReady;
+    if (state != mDeviceState) {
+        mDeviceState = state;
+        notifications->push_back(notification(kGidCore, kOidCoreDeviceStatus, {mDeviceState}));
+    }
+}
+
+void UciController::resetLocked() {
+    mSessions.clear();
+    mDeviceConfig.clear();
+    mDeviceState = kDeviceStateReady;
+}
+
+UciMessage UciController::sessionStatus(const Session& session, uint8_t reasonCode) const {
+    std::vector<uint8_t> payload;
+    appendLe32(&payload, session.id);
+    payload.push_back(session.state);
+    payload.push_back(reasonCode);
+    return notification(kGidSessionConfig, kOidSessionStatus, std::move(payload));
+}
+
+UciMessage UciController::rangeData(Session* session) const {
+    const uint32_t sequenceNumber = session->sequenceNumber++;
+    session->rangingCount++;
+
+    std::vector<uint8_t> payload;
+    appendLe32(&payload, sequenceNumber);
+    appendLe32(&payload, session->id);
+    payload.push_back(0);  // RCR indicator
+    appendLe32(&payload, rangingIntervalMs(session->appConfig));
+    payload.push_back(kRangingMeasurementTwoWay);
+    payload.push_back(0);  // Reserved
+    payload.push_back(0);  // Short MAC addresses
+    payload.insert(payload.end(), 8, 0);  // Reserved
+
+    const std::vector<uint8_t>& peers = session->appConfig.at(kAppConfigDstMacAddress);
+    payload.push_back(peers.size() / 2);
+    for (size_t i = 0; i < peers.size() / 2; ++i) {
+        // Peers are spread around the device, each moving back and forth over a meter.
+        const uint32_t phase = sequenceNumber % 40;
+        const uint16_t distanceCm = 100 + 50 * i + 5 * (phase < 20 ? phase : 40 - phase);
+        const int16_t azimuthDegrees = -60 + 30 * (i % 5);
+
+        payload.push_back(peers[2 * i]);
+        payload.push_back(peers[2 * i + 1]);
+        payload.push_back(kStatusOk);
+        payload.push_back(0);  // Line of sight
+        appendLe16(&payload, distanceCm);
+        // Angles are in Q9.7 degrees, each followed by its figure of merit.
+        appendLe16(&payload, static_cast<uint16_t>(azimuthDegrees * 128));
+        payload.push_back(100);
+        appendLe16(&payload, 0);  // Elevation
+        payload.push_back(100);
+        appendLe16(&payload, 0);  // Azimuth at the peer
+        payload.push_back(0);
+        appendLe16(&payload, 0);  // Elevation at the peer
+        payload.push_back(0);
+        payload.push_back(i);  // Slot index
+        payload.insert(payload.end(), 12, 0);  // Reserved
+    }
+    return notification(kGidRangingSessionControl, kOidRangeData, std::move(payload));
+}
+
+void UciController::rangingLoop() {
+    std::unique_lock<std::mutex> lock(mLock);
+    ScopedLockAssertion lockAssertion(mLock);
+    while (!mStopping) {
+        const auto now = steady_clock::now();
+        std::optional<steady_clock::time_point> nextRound;
+        for (auto& [id, session] : mSessions) {
+            if (session.state != kSessionStateActive) {
+                continue;
+            }
+            if (session.nextRound <= now) {
+                sendLocked(rangeData(&session));
+                const auto interval =
+                        std::chrono::milliseconds(rangingIntervalMs(session.appConfig));
+                session.nextRound += interval;
+                if (session.nextRound <= now) {
+                    // Rounds missed while the controller was busy are skipped.
+                    session.nextRound = now + interval;
+                }
+            }
+            if (!nextRound || session.nextRound < *nextRound) {
+                nextRound = session.nextRound;
+            }
+        }
+        if (nextRound) {
+            mRangingCondition.wait_until(lock, *nextRound);
+        } else {
+            mRangingCondition.wait(lock);
+        }
+    }
+}
+
+}  // namespace impl
+}  // namespace uwb
+}  // namespace hardware
+}  // namespace android
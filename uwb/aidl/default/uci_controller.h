@@ -0,0 +1,153 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_UWB_UCICONTROLLER
+#define ANDROID_HARDWARE_UWB_UCICONTROLLER
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <android-base/thread_annotations.h>
+
+#include "uci_packet.h"
+
+namespace android {
+namespace hardware {
+namespace uwb {
+namespace impl {
+
+/**
+ * An in-process model of a UWB subsystem speaking UCI, for simulator targets. It implements the
+ * core and session state machines, and ranging sessions which report synthetic measurements of
+ * the configured peers at the configured interval.
+ *
+ * The host may have as many commands outstanding as the controller has credits, one by default
+ * as per the specification. Commands sent without a credit are dropped and answered with a
+ * generic error asking for a retry.
+ *
+ * Packets for the host are sent in order, with the controller lock held, so the sender must not
+ * call back into the controller.
+ */
+class UciController {
+  public:
+    using PacketSender = std::function<void(const std::vector<uint8_t>& packet)>;
+
+    struct Options {
+        size_t maxSessions = 5;
+        // Longer messages to the host are segmented.
+        size_t maxPayloadSize = uci::kMaxPayloadSize;
+        // Longer messages from the host are rejected.
+        size_t maxMessageSize = 2048;
+        uint32_t commandCredits = 1;
+    };
+
+    explicit UciController(PacketSender sender);
+    UciController(PacketSender sender, Options options);
+    ~UciController();
+
+    // Reports the device ready, as after booting.
+    void powerOn();
+
+    // Handles a buffer of one or more packets from the host.
+    void receive(const std::vector<uint8_t>& data);
+
+    bool hasSession(uint32_t sessionId) const;
+
+    // Fault injection, for tests.
+    //
+    // Fails the next command of the given group and opcode with the given status.
+    void failNextCommand(uint8_t gid, uint8_t oid, uint8_t status);
+    void sendGenericError(uint8_t status);
+    // Stops all sessions and rejects all commands until the device is reset.
+    void enterErrorState();
+    // Holds back responses, and everything sent after them, keeping the credits of the
+    // commands until released.
+    void holdResponses(bool hold);
+
+  private:
+    struct Session {
+        uint32_t id = 0;
+        uint8_t type = 0;
+        uint8_t state = uci::kSessionStateInit;
+        std::map<uint8_t, std::vector<uint8_t>> appConfig;
+        uint32_t sequenceNumber = 0;
+        uint32_t rangingCount = 0;
+        std::chrono::steady_clock::time_point nextRound;
+    };
+
+    void handleCommandLocked(const uci::UciMessage& command) REQUIRES(mLock);
+    // Handles a command, returning the response payload. Notifications which follow the response
+    // are added to notifications.
+    std::vector<uint8_t> executeLocked(const uci::UciMessage& command,
+                                       std::vector<uci::UciMessage>* notifications)
+            REQUIRES(mLock);
+    std::vector<uint8_t> coreCommandLocked(const uci::UciMessage& command,
+                                           std::vector<uci::UciMessage>* notifications)
+            REQUIRES(mLock);
+    std::vector<uint8_t> sessionConfigCommandLocked(const uci::UciMessage& command,
+                                                    std::vector<uci::UciMessage>* notifications)
+            REQUIRES(mLock);
+    std::vector<uint8_t> rangingCommandLocked(const uci::UciMessage& command,
+                                              std::vector<uci::UciMessage>* notifications)
+            REQUIRES(mLock);
+    std::vector<uint8_t> androidCommandLocked(const uci::UciMessage& command) REQUIRES(mLock);
+    uint8_t setAppConfigLocked(Session* session, const std::vector<uint8_t>& payload,
+                               std::vector<uint8_t>* failures) REQUIRES(mLock);
+    Session* findSessionLocked(const std::vector<uint8_t>& payload) REQUIRES(mLock);
+
+    // Sends a message, or queues it behind held responses.
+    void sendLocked(const uci::UciMessage& message) REQUIRES(mLock);
+    void transmitLocked(const uci::UciMessage& message) REQUIRES(mLock);
+    // Updates the device state from the session states.
+    void updateDeviceStateLocked(std::vector<uci::UciMessage>* notifications) REQUIRES(mLock);
+    void resetLocked() REQUIRES(mLock);
+
+    uci::UciMessage sessionStatus(const Session& session, uint8_t reasonCode) const;
+    uci::UciMessage rangeData(Session* session) const;
+    void rangingLoop();
+
+    const PacketSender mSender;
+    const Options mOptions;
+
+    mutable std::mutex mLock;
+    std::condition_variable mRangingCondition;
+    uci::Reassembler mReassembler GUARDED_BY(mLock);
+    uint8_t mDeviceState GUARDED_BY(mLock) = uci::kDeviceStateReady;
+    std::map<uint8_t, std::vector<uint8_t>> mDeviceConfig GUARDED_BY(mLock);
+    std::map<uint32_t, Session> mSessions GUARDED_BY(mLock);
+    uint32_t mCredits GUARDED_BY(mLock);
+    bool mHoldResponses GUARDED_BY(mLock) = false;
+    std::deque<uci::UciMessage> mHeldMessages GUARDED_BY(mLock);
+    // Injected failures, by group and opcode.
+    std::map<std::pair<uint8_t, uint8_t>, uint8_t> mFailures GUARDED_BY(mLock);
+    bool mStopping GUARDED_BY(mLock) = false;
+    std::thread mRangingThread;
+};
+
+}  // namespace impl
+}  // namespace uwb
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_UWB_UCICONTROLLER
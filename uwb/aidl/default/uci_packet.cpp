@@ -0,0 +1,122 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "uci_packet.h"
+
+#include <algorithm>
+
+namespace android {
+namespace hardware {
+namespace uwb {
+namespace impl {
+namespace uci {
+
+namespace {
+
+constexpr uint8_t kPacketBoundaryFlag = 0x10;
+constexpr uint8_t kGidMask = 0x0F;
+constexpr uint8_t kOidMask = 0x3F;
+
+MessageType messageType(uint8_t octet0) {
+    return static_cast<MessageType>(octet0 >> 5);
+}
+
+// Data packets have a 16 bit payload length in octets 2 and 3.
+size_t payloadSize(const uint8_t* header) {
+    if (messageType(header[0]) == MessageType::DATA) {
+        return header[2] | (header[3] << 8);
+    }
+    return header[3];
+}
+
+}  // namespace
+
+std::vector<std::vector<uint8_t>> segmentMessage(const UciMessage& message,
+                                                 size_t maxPayloadSize) {
+    maxPayloadSize = std::clamp<size_t>(maxPayloadSize, 1, kMaxPayloadSize);
+    std::vector<std::vector<uint8_t>> packets;
+    size_t offset = 0;
+    do {
+        const size_t size = std::min(maxPayloadSize, message.payload.size() - offset);
+        const bool last = offset + size == message.payload.size();
+        std::vector<uint8_t> packet = {
+                static_cast<uint8_t>((static_cast<uint8_t>(message.type) << 5) |
+                                     (last ? 0 : kPacketBoundaryFlag) | (message.gid & kGidMask)),
+                static_cast<uint8_t>(message.oid & kOidMask),
+                0,
+                static_cast<uint8_t>(size),
+        };
+        packet.insert(packet.end(), message.payload.begin() + offset,
+                      message.payload.begin() + offset + size);
+        packets.push_back(std::move(packet));
+        offset += size;
+    } while (offset < message.payload.size());
+    return packets;
+}
+
+bool splitPackets(const std::vector<uint8_t>& data, std::vector<std::vector<uint8_t>>* packets) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        if (data.size() - offset < kHeaderSize) {
+            return false;
+        }
+        const size_t size = kHeaderSize + payloadSize(&data[offset]);
+        if (data.size() - offset < size) {
+            return false;
+        }
+        packets->emplace_back(data.begin() + offset, data.begin() + offset + size);
+        offset += size;
+    }
+    return true;
+}
+
+Reassembler::Reassembler(size_t maxMessageSize) : mMaxMessageSize(maxMessageSize) {}
+
+Reassembler::Result Reassembler::add(const std::vector<uint8_t>& packet, UciMessage* message) {
+    const bool valid = packet.size() >= kHeaderSize &&
+                       messageType(packet[0]) != MessageType::DATA &&
+                       packet.size() == kHeaderSize + payloadSize(packet.data());
+    const MessageType type = valid ? messageType(packet[0]) : MessageType::DATA;
+    const uint8_t gid = valid ? packet[0] & kGidMask : 0;
+    const uint8_t oid = valid ? packet[1] & kOidMask : 0;
+    if (!valid || (mPending && (type != mMessage.type || gid != mMessage.gid ||
+                                oid != mMessage.oid))) {
+        mPending = false;
+        return Result::ERROR;
+    }
+
+    if (!mPending) {
+        mMessage = {.type = type, .gid = gid, .oid = oid, .payload = {}};
+        mPending = true;
+    }
+    if (mMessage.payload.size() + packet.size() - kHeaderSize > mMaxMessageSize) {
+        mPending = false;
+        return Result::ERROR;
+    }
+    mMessage.payload.insert(mMessage.payload.end(), packet.begin() + kHeaderSize, packet.end());
+    if (packet[0] & kPacketBoundaryFlag) {
+        return Result::INCOMPLETE;
+    }
+    mPending = false;
+    *message = std::move(mMessage);
+    return Result::COMPLETE;
+}
+
+}  // namespace uci
+}  // namespace impl
+}  // namespace uwb
+}  // namespace hardware
+}  // namespace android
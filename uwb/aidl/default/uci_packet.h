@@ -0,0 +1,162 @@
+/*
+ * Copyright 2021, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_UWB_UCIPACKET
+#define ANDROID_HARDWARE_UWB_UCIPACKET
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace uwb {
+namespace impl {
+namespace uci {
+
+// Control packets have a 4 byte header:
+//   octet 0: message type (bits 7-5), packet boundary flag (bit 4), group id (bits 3-0)
+//   octet 1: opcode id (bits 5-0)
+//   octet 2: reserved
+//   octet 3: payload length
+constexpr size_t kHeaderSize = 4;
+constexpr size_t kMaxPayloadSize = 255;
+
+enum class MessageType : uint8_t {
+    DATA = 0,
+    COMMAND = 1,
+    RESPONSE = 2,
+    NOTIFICATION = 3,
+};
+
+// Group identifiers.
+constexpr uint8_t kGidCore = 0x0;
+constexpr uint8_t kGidSessionConfig = 0x1;
+constexpr uint8_t kGidRangingSessionControl = 0x2;
+constexpr uint8_t kGidAndroid = 0xC;
+
+// Opcodes of the core group.
+constexpr uint8_t kOidCoreDeviceReset = 0x00;
+constexpr uint8_t kOidCoreDeviceStatus = 0x01;
+constexpr uint8_t kOidCoreGetDeviceInfo = 0x02;
+constexpr uint8_t kOidCoreGetCapsInfo = 0x03;
+constexpr uint8_t kOidCoreSetConfig = 0x04;
+constexpr uint8_t kOidCoreGetConfig = 0x05;
+constexpr uint8_t kOidCoreGenericError = 0x07;
+
+// Opcodes of the session config group.
+constexpr uint8_t kOidSessionInit = 0x00;
+constexpr uint8_t kOidSessionDeinit = 0x01;
+constexpr uint8_t kOidSessionStatus = 0x02;
+constexpr uint8_t kOidSessionSetAppConfig = 0x03;
+constexpr uint8_t kOidSessionGetAppConfig = 0x04;
+constexpr uint8_t kOidSessionGetCount = 0x05;
+constexpr uint8_t kOidSessionGetState = 0x06;
+
+// Opcodes of the ranging session control group. Range data notifications share the opcode of
+// RANGE_START.
+constexpr uint8_t kOidRangeStart = 0x00;
+constexpr uint8_t kOidRangeData = 0x00;
+constexpr uint8_t kOidRangeStop = 0x01;
+constexpr uint8_t kOidRangeGetRangingCount = 0x03;
+
+// Opcodes of the Android vendor group, see UwbVendorGidAndroidOids.
+constexpr uint8_t kOidAndroidGetPowerStats = 0x00;
+constexpr uint8_t kOidAndroidSetCountryCode = 0x01;
+
+// Status codes.
+constexpr uint8_t kStatusOk = 0x00;
+constexpr uint8_t kStatusRejected = 0x01;
+constexpr uint8_t kStatusFailed = 0x02;
+constexpr uint8_t kStatusSyntaxError = 0x03;
+constexpr uint8_t kStatusInvalidParam = 0x04;
+constexpr uint8_t kStatusInvalidRange = 0x05;
+constexpr uint8_t kStatusInvalidMessageSize = 0x06;
+constexpr uint8_t kStatusUnknownGid = 0x07;
+constexpr uint8_t kStatusUnknownOid = 0x08;
+constexpr uint8_t kStatusReadOnly = 0x09;
+constexpr uint8_t kStatusCommandRetry = 0x0A;
+constexpr uint8_t kStatusSessionNotExist = 0x11;
+constexpr uint8_t kStatusSessionDuplicate = 0x12;
+constexpr uint8_t kStatusSessionActive = 0x13;
+constexpr uint8_t kStatusMaxSessionsExceeded = 0x14;
+constexpr uint8_t kStatusSessionNotConfigured = 0x15;
+
+// Device states.
+constexpr uint8_t kDeviceStateReady = 0x01;
+constexpr uint8_t kDeviceStateActive = 0x02;
+constexpr uint8_t kDeviceStateError = 0xFF;
+
+// Session states.
+constexpr uint8_t kSessionStateInit = 0x00;
+constexpr uint8_t kSessionStateDeinit = 0x01;
+constexpr uint8_t kSessionStateActive = 0x02;
+constexpr uint8_t kSessionStateIdle = 0x03;
+
+// Application configuration parameters.
+constexpr uint8_t kAppConfigDeviceType = 0x00;
+constexpr uint8_t kAppConfigRangingRoundUsage = 0x01;
+constexpr uint8_t kAppConfigChannelNumber = 0x04;
+constexpr uint8_t kAppConfigNumberOfControlees = 0x05;
+constexpr uint8_t kAppConfigDeviceMacAddress = 0x06;
+constexpr uint8_t kAppConfigDstMacAddress = 0x07;
+constexpr uint8_t kAppConfigRangingInterval = 0x09;
+
+struct UciMessage {
+    MessageType type = MessageType::COMMAND;
+    uint8_t gid = 0;
+    uint8_t oid = 0;
+    std::vector<uint8_t> payload;
+};
+
+// Splits a message into packets carrying at most maxPayloadSize payload bytes each. Every packet
+// but the last has its packet boundary flag set.
+std::vector<std::vector<uint8_t>> segmentMessage(const UciMessage& message, size_t maxPayloadSize);
+
+// Splits a buffer into the control packets it holds. Returns false if it ends with a partial
+// packet, which is dropped.
+bool splitPackets(const std::vector<uint8_t>& data, std::vector<std::vector<uint8_t>>* packets);
+
+// Joins the segments of control messages.
+class Reassembler {
+  public:
+    enum class Result {
+        // The packet was a segment of a message still missing its last one.
+        INCOMPLETE,
+        COMPLETE,
+        // The packet was malformed, didn't continue the pending message or made it too long.
+        // The pending message is dropped.
+        ERROR,
+    };
+
+    explicit Reassembler(size_t maxMessageSize);
+
+    // Adds a complete packet. Fills message once its last segment arrived.
+    Result add(const std::vector<uint8_t>& packet, UciMessage* message);
+
+  private:
+    const size_t mMaxMessageSize;
+    bool mPending = false;
+    UciMessage mMessage;
+};
+
+}  // namespace uci
+}  // namespace impl
+}  // namespace uwb
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_UWB_UCIPACKET
@@ -35,22 +35,45 @@ UwbChip::~UwbChip() {}
 }
 
 ::ndk::ScopedAStatus UwbChip::open(const std::shared_ptr<IUwbClientCallback>& clientCallback) {
+    std::lock_guard<std::mutex> lock(mLock);
     mClientCallback = clientCallback;
+    mController = std::make_unique<UciController>(
+            [clientCallback](const std::vector<uint8_t>& packet) {
+                clientCallback->onUciMessage(packet);
+            });
     mClientCallback->onHalEvent(UwbEvent::OPEN_CPLT, UwbStatus::OK);
+    mController->powerOn();
     return ndk::ScopedAStatus::ok();
 }
 
 ::ndk::ScopedAStatus UwbChip::close() {
-    mClientCallback->onHalEvent(UwbEvent::CLOSE_CPLT, UwbStatus::OK);
-    mClientCallback = nullptr;
+    std::unique_ptr<UciController> controller;
+    std::shared_ptr<IUwbClientCallback> clientCallback;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        controller = std::move(mController);
+        clientCallback = std::move(mClientCallback);
+    }
+    // Stops ranging before the stack is told the chip is closed.
+    controller.reset();
+    if (clientCallback != nullptr) {
+        clientCallback->onHalEvent(UwbEvent::CLOSE_CPLT, UwbStatus::OK);
+    }
     return ndk::ScopedAStatus::ok();
 }
 
 ::ndk::ScopedAStatus UwbChip::coreInit() {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mClientCallback == nullptr) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+    // The simulated subsystem has no vendor configuration to apply.
+    mClientCallback->onHalEvent(UwbEvent::POST_INIT_CPLT, UwbStatus::OK);
     return ndk::ScopedAStatus::ok();
 }
 
 ::ndk::ScopedAStatus UwbChip::sessionInit(int /* sessionId */) {
+    // Nor does it need vendor specific session setup.
     return ndk::ScopedAStatus::ok();
 }
 
@@ -59,10 +82,15 @@ UwbChip::~UwbChip() {}
     return ndk::ScopedAStatus::ok();
 }
 
-::ndk::ScopedAStatus UwbChip::sendUciMessage(const std::vector<uint8_t>& /* data */,
-                                             int32_t* /* bytes_written */) {
-    // TODO(b/195992658): Need emulator support for UCI stack.
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+::ndk::ScopedAStatus UwbChip::sendUciMessage(const std::vector<uint8_t>& data,
+                                             int32_t* bytes_written) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mController == nullptr) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    }
+    mController->receive(data);
+    *bytes_written = data.size();
+    return ndk::ScopedAStatus::ok();
 }
 }  // namespace impl
 }  // namespace uwb
@@ -17,10 +17,15 @@
 #ifndef ANDROID_HARDWARE_UWB_UWBCHIP
 #define ANDROID_HARDWARE_UWB_UWBCHIP
 
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include <aidl/android/hardware/uwb/BnUwbChip.h>
 #include <aidl/android/hardware/uwb/IUwbClientCallback.h>
+#include <android-base/thread_annotations.h>
+
+#include "uci_controller.h"
 
 namespace android {
 namespace hardware {
@@ -44,7 +49,10 @@ class UwbChip : public BnUwbChip {
 
   private:
     std::string name_;
-    std::shared_ptr<IUwbClientCallback> mClientCallback;
+    std::mutex mLock;
+    std::shared_ptr<IUwbClientCallback> mClientCallback GUARDED_BY(mLock);
+    // The simulated UWB subsystem, powered while the chip is open.
+    std::unique_ptr<UciController> mController GUARDED_BY(mLock);
 };
 }  // namespace impl
 }  // namespace uwb
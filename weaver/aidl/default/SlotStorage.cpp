@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SlotStorage.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace weaver {
+
+namespace {
+
+// The file holds the magic, the number of slots and then for each slot its failure count, key
+// and value. Integers are 32 bit little endian and byte strings are prefixed by their length.
+constexpr uint32_t kMagic = 0x31525657;  // "WVR1"
+
+void putU32(std::string* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out->push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void putBytes(std::string* out, const std::vector<uint8_t>& bytes) {
+    putU32(out, bytes.size());
+    out->append(bytes.begin(), bytes.end());
+}
+
+class Reader {
+  public:
+    explicit Reader(const std::string& data) : mData(data) {}
+
+    bool getU32(uint32_t* value) {
+        if (mData.size() - mOffset < 4) {
+            return false;
+        }
+        *value = 0;
+        for (int i = 0; i < 4; i++) {
+            *value |= static_cast<uint32_t>(static_cast<uint8_t>(mData[mOffset++])) << (8 * i);
+        }
+        return true;
+    }
+
+    bool getBytes(std::vector<uint8_t>* bytes) {
+        uint32_t size;
+        if (!getU32(&size) || mData.size() - mOffset < size) {
+            return false;
+        }
+        bytes->assign(mData.begin() + mOffset, mData.begin() + mOffset + size);
+        mOffset += size;
+        return true;
+    }
+
+    bool done() const { return mOffset == mData.size(); }
+
+  private:
+    const std::string& mData;
+    size_t mOffset = 0;
+};
+
+}  // namespace
+
+SlotStorage::SlotStorage(std::string path) : mPath(std::move(path)) {}
+
+bool SlotStorage::load(std::vector<Slot>* slots) const {
+    slots->clear();
+    std::string data;
+    if (!::android::base::ReadFileToString(mPath, &data)) {
+        if (errno == ENOENT) {
+            return true;
+        }
+        PLOG(ERROR) << "Failed to read " << mPath;
+        keepUnreadableFile();
+        return false;
+    }
+
+    Reader reader(data);
+    uint32_t magic, count;
+    if (!reader.getU32(&magic) || magic != kMagic || !reader.getU32(&count)) {
+        LOG(ERROR) << mPath << " is not a slot file";
+        keepUnreadableFile();
+        return false;
+    }
+    // Don't trust the count for the allocation, each slot takes at least 12 bytes.
+    if (count > data.size() / 12) {
+        LOG(ERROR) << mPath << " is truncated";
+        keepUnreadableFile();
+        return false;
+    }
+    slots->resize(count);
+    for (auto& slot : *slots) {
+        if (!reader.getU32(&slot.failures) || !reader.getBytes(&slot.key) ||
+            !reader.getBytes(&slot.value)) {
+            LOG(ERROR) << mPath << " is truncated";
+            slots->clear();
+            keepUnreadableFile();
+            return false;
+        }
+    }
+    if (!reader.done()) {
+        LOG(ERROR) << mPath << " has trailing data";
+        slots->clear();
+        keepUnreadableFile();
+        return false;
+    }
+    return true;
+}
+
+void SlotStorage::keepUnreadableFile() const {
+    // Starting over loses every slot, so keep the file for inspection rather than overwriting it
+    // with the next write.
+    const std::string keptPath = mPath + ".corrupt";
+    if (rename(mPath.c_str(), keptPath.c_str()) != 0) {
+        PLOG(ERROR) << "Failed to keep " << mPath << " as " << keptPath;
+        return;
+    }
+    LOG(ERROR) << "All stored weaver slots are lost, the unreadable slot file was kept as "
+               << keptPath;
+}
+
+bool SlotStorage::save(const std::vector<Slot>& slots) const {
+    std::string data;
+    putU32(&data, kMagic);
+    putU32(&data, slots.size());
+    for (const auto& slot : slots) {
+        putU32(&data, slot.failures);
+        putBytes(&data, slot.key);
+        putBytes(&data, slot.value);
+    }
+
+    const std::string tmpPath = mPath + ".tmp";
+    ::android::base::unique_fd fd(
+            TEMP_FAILURE_RETRY(open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                                    S_IRUSR | S_IWUSR)));
+    if (fd < 0) {
+        PLOG(ERROR) << "Failed to create " << tmpPath;
+        return false;
+    }
+    if (!::android::base::WriteStringToFd(data, fd) || fsync(fd) != 0) {
+        PLOG(ERROR) << "Failed to write " << tmpPath;
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    fd.reset();
+    if (rename(tmpPath.c_str(), mPath.c_str()) != 0) {
+        PLOG(ERROR) << "Failed to replace " << mPath;
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    // Make the rename itself durable. The new contents are in place whatever happens here, so
+    // failing to sync doesn't fail the save: the caller would otherwise roll back a change that
+    // readers already see.
+    const std::string dir = ::android::base::Dirname(mPath);
+    ::android::base::unique_fd dirFd(
+            TEMP_FAILURE_RETRY(open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)));
+    if (dirFd < 0 || fsync(dirFd) != 0) {
+        PLOG(WARNING) << "Failed to sync " << dir << ", the last change may not survive a crash";
+    }
+    return true;
+}
+
+}  // namespace weaver
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
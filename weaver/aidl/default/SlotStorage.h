@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace weaver {
+
+struct Slot {
+    std::vector<uint8_t> key;
+    std::vector<uint8_t> value;
+    // Failed reads since the slot was last written or successfully read.
+    uint32_t failures = 0;
+};
+
+// Keeps the slots in a file. The file is replaced as a whole by renaming a synced temporary file
+// over it, so a crash leaves either the old or the new contents.
+class SlotStorage {
+  public:
+    explicit SlotStorage(std::string path);
+
+    // Returns false if the file exists but can't be read or parsed, in which case it is moved
+    // aside to <path>.corrupt. A missing file loads as no slots.
+    bool load(std::vector<Slot>* slots) const;
+    // Returns false if the new contents couldn't be put in place.
+    bool save(const std::vector<Slot>& slots) const;
+
+  private:
+    void keepUnreadableFile() const;
+
+    const std::string mPath;
+};
+
+}  // namespace weaver
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -15,52 +15,154 @@
  */
 
 #include "Weaver.h"
-#include <array>
+
+#include <algorithm>
+#include <utility>
+
+#include <android-base/logging.h>
 
 namespace aidl {
 namespace android {
 namespace hardware {
 namespace weaver {
 
-struct Slotinfo {
-    int slot_id;
-    std::vector<uint8_t> key;
-    std::vector<uint8_t> value;
-};
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+::ndk::ScopedAStatus serviceError(int32_t status) {
+    return ::ndk::ScopedAStatus(AStatus_fromServiceSpecificError(status));
+}
+
+}  // namespace
+
+Weaver::Weaver() : Weaver(Options{}) {}
+
+Weaver::Weaver(Options options) : Weaver(std::move(options), steady_clock::now) {}
+
+Weaver::Weaver(Options options, Clock clock)
+    : mOptions(std::move(options)),
+      mClock(std::move(clock)),
+      mStorage(mOptions.storagePath.empty()
+                       ? std::nullopt
+                       : std::make_optional<SlotStorage>(mOptions.storagePath)),
+      mSlots(mOptions.slots),
+      mThrottledUntil(mOptions.slots) {
+    std::vector<Slot> stored;
+    if (!mStorage || !mStorage->load(&stored)) {
+        return;
+    }
+    if (stored.size() > mSlots.size()) {
+        LOG(WARNING) << "Dropping " << stored.size() - mSlots.size() << " stored slots";
+        stored.resize(mSlots.size());
+    }
+    const auto now = mClock();
+    for (size_t i = 0; i < stored.size(); i++) {
+        if (stored[i].key.size() > static_cast<size_t>(mOptions.keySize) ||
+            stored[i].value.size() > static_cast<size_t>(mOptions.valueSize)) {
+            LOG(WARNING) << "Dropping stored slot " << i << ", it doesn't fit";
+            continue;
+        }
+        mSlots[i] = std::move(stored[i]);
+        // Restarting restarts the back-off rather than ending it.
+        mThrottledUntil[i] = now + backoff(mSlots[i].failures);
+    }
+}
+
+milliseconds Weaver::backoff(uint32_t failures) const {
+    if (failures <= mOptions.freeAttempts) {
+        return milliseconds(0);
+    }
+    milliseconds backoff = mOptions.initialBackoff;
+    for (uint32_t i = mOptions.freeAttempts + 1; i < failures && backoff < mOptions.maxBackoff;
+         i++) {
+        backoff *= 2;
+    }
+    return std::min(backoff, mOptions.maxBackoff);
+}
+
+bool Weaver::keysMatch(const std::vector<uint8_t>& stored, const std::vector<uint8_t>& key) const {
+    // Look at every byte whatever the contents, so the time taken doesn't tell how much of the
+    // key was right.
+    uint8_t diff = stored.size() != key.size();
+    for (size_t i = 0; i < static_cast<size_t>(mOptions.keySize); i++) {
+        const uint8_t a = i < stored.size() ? stored[i] : 0;
+        const uint8_t b = i < key.size() ? key[i] : 0;
+        diff |= a ^ b;
+    }
+    return diff == 0;
+}
+
+void Weaver::saveLocked() {
+    if (!mStorage) {
+        return;
+    }
+    const bool persisted = mStorage->save(mSlots);
+    if (!persisted && mPersisted) {
+        LOG(ERROR) << "Keeping weaver slots in memory only, they won't survive a restart";
+    } else if (persisted && !mPersisted) {
+        LOG(INFO) << "Weaver slots stored to " << mOptions.storagePath << " again";
+    }
+    mPersisted = persisted;
+}
+
+bool Weaver::persisted() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mPersisted;
+}
 
-std::array<struct Slotinfo, 16> slot_array;
 // Methods from ::android::hardware::weaver::IWeaver follow.
 
 ::ndk::ScopedAStatus Weaver::getConfig(WeaverConfig* out_config) {
-    *out_config = {16, 16, 16};
+    *out_config = {mOptions.slots, mOptions.keySize, mOptions.valueSize};
     return ::ndk::ScopedAStatus::ok();
 }
 
 ::ndk::ScopedAStatus Weaver::read(int32_t in_slotId, const std::vector<uint8_t>& in_key, WeaverReadResponse* out_response) {
-
-    if (in_slotId > 15 || in_key.size() > 16) {
-        *out_response = {0, {}};
-        return ndk::ScopedAStatus(AStatus_fromServiceSpecificError(Weaver::STATUS_FAILED));
+    *out_response = {0, {}};
+    if (in_slotId < 0 || in_slotId >= mOptions.slots ||
+        in_key.size() > static_cast<size_t>(mOptions.keySize)) {
+        return serviceError(Weaver::STATUS_FAILED);
     }
 
-    if (slot_array[in_slotId].key != in_key) {
-        *out_response = {0, {}};
-        return ndk::ScopedAStatus(AStatus_fromServiceSpecificError(Weaver::STATUS_INCORRECT_KEY));
+    std::lock_guard<std::mutex> lock(mLock);
+    Slot& slot = mSlots[in_slotId];
+    const auto now = mClock();
+    if (now < mThrottledUntil[in_slotId]) {
+        const auto remaining = mThrottledUntil[in_slotId] - now;
+        out_response->timeout = std::chrono::ceil<milliseconds>(remaining).count();
+        return serviceError(Weaver::STATUS_THROTTLE);
     }
 
-    *out_response = {0, slot_array[in_slotId].value};
+    if (!keysMatch(slot.key, in_key)) {
+        slot.failures++;
+        const milliseconds timeout = backoff(slot.failures);
+        mThrottledUntil[in_slotId] = now + timeout;
+        saveLocked();
+        out_response->timeout = timeout.count();
+        return serviceError(Weaver::STATUS_INCORRECT_KEY);
+    }
 
+    if (slot.failures > 0) {
+        slot.failures = 0;
+        saveLocked();
+    }
+    out_response->value = slot.value;
     return ::ndk::ScopedAStatus::ok();
 }
 
 ::ndk::ScopedAStatus Weaver::write(int32_t in_slotId, const std::vector<uint8_t>& in_key, const std::vector<uint8_t>& in_value) {
+    if (in_slotId < 0 || in_slotId >= mOptions.slots ||
+        in_key.size() > static_cast<size_t>(mOptions.keySize) ||
+        in_value.size() > static_cast<size_t>(mOptions.valueSize)) {
+        return serviceError(Weaver::STATUS_FAILED);
+    }
 
-    if (in_slotId > 15 || in_key.size() > 16 || in_value.size() > 16)
-        return ::ndk::ScopedAStatus::fromStatus(STATUS_FAILED_TRANSACTION);
-
-    slot_array[in_slotId].key = in_key;
-    slot_array[in_slotId].value = in_value;
-
+    std::lock_guard<std::mutex> lock(mLock);
+    mSlots[in_slotId] = Slot{in_key, in_value, 0};
+    mThrottledUntil[in_slotId] = {};
+    saveLocked();
     return ::ndk::ScopedAStatus::ok();
 }
 
@@ -16,7 +16,17 @@
 
 #pragma once
 
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
 #include <aidl/android/hardware/weaver/BnWeaver.h>
+#include <android-base/thread_annotations.h>
+
+#include "SlotStorage.h"
 
 namespace aidl {
 namespace android {
@@ -26,14 +36,58 @@ namespace weaver {
 using ::aidl::android::hardware::weaver::WeaverConfig;
 using ::aidl::android::hardware::weaver::WeaverReadResponse;
 
+/**
+ * Behaves like a secure element would: slots survive restarts, keys are compared in constant
+ * time, and failed reads of a slot throttle further reads of it with an exponential back-off.
+ * The failure count is kept with the slot, so restarting doesn't reset the back-off, and is
+ * cleared by writing the slot or reading it with the right key.
+ */
 struct Weaver : public BnWeaver {
 public:
-    Weaver() = default;
+    using Clock = std::function<std::chrono::steady_clock::time_point()>;
+
+    struct Options {
+        int32_t slots = 16;
+        int32_t keySize = 16;
+        int32_t valueSize = 16;
+        // Where slots are kept, or empty to keep them in memory only.
+        std::string storagePath;
+        // Failed reads of a slot allowed before throttling starts.
+        uint32_t freeAttempts = 5;
+        // The back-off after the first throttled failure, doubling after each further one.
+        std::chrono::milliseconds initialBackoff = std::chrono::seconds(30);
+        std::chrono::milliseconds maxBackoff = std::chrono::hours(24);
+    };
+
+    Weaver();
+    explicit Weaver(Options options);
+    Weaver(Options options, Clock clock);
+
+    // Whether the slots in memory have been stored, always true without a storage path.
+    bool persisted();
 
     // Methods from ::android::hardware::weaver::IWeaver follow.
     ::ndk::ScopedAStatus getConfig(WeaverConfig* _aidl_return) override;
     ::ndk::ScopedAStatus read(int32_t in_slotId, const std::vector<uint8_t>& in_key, WeaverReadResponse* _aidl_return) override;
     ::ndk::ScopedAStatus write(int32_t in_slotId, const std::vector<uint8_t>& in_key, const std::vector<uint8_t>& in_value) override;
+
+private:
+    std::chrono::milliseconds backoff(uint32_t failures) const;
+    bool keysMatch(const std::vector<uint8_t>& stored, const std::vector<uint8_t>& key) const;
+    // Stores the slots. They are kept in memory whether or not that works, so the HAL keeps
+    // working without storage, at the cost of forgetting everything on a restart.
+    void saveLocked() REQUIRES(mLock);
+
+    const Options mOptions;
+    const Clock mClock;
+    const std::optional<SlotStorage> mStorage;
+
+    std::mutex mLock;
+    std::vector<Slot> mSlots GUARDED_BY(mLock);
+    // When each slot can next be read.
+    std::vector<std::chrono::steady_clock::time_point> mThrottledUntil GUARDED_BY(mLock);
+    // Whether the slots in memory are the stored ones.
+    bool mPersisted GUARDED_BY(mLock) = true;
 };
 
 }  // namespace weaver
@@ -15,16 +15,31 @@
  */
 
 #include <android-base/logging.h>
+#include <android-base/properties.h>
 #include <android/binder_manager.h>
 #include <android/binder_process.h>
 
 #include "Weaver.h"
 
 using ::aidl::android::hardware::weaver::Weaver;
+using ::android::base::GetIntProperty;
+
+// Every slot is held in memory and rewritten to storage on each change, so keep the config small.
+// Properties out of these ranges fall back to the defaults.
+constexpr int32_t kMaxSlots = 1024;
+constexpr int32_t kMaxKeySize = 64;
+constexpr int32_t kMaxValueSize = 64;
 
 int main() {
+    Weaver::Options options;
+    options.slots = GetIntProperty("ro.vendor.weaver.slots", options.slots, 1, kMaxSlots);
+    options.keySize = GetIntProperty("ro.vendor.weaver.key_size", options.keySize, 1, kMaxKeySize);
+    options.valueSize =
+            GetIntProperty("ro.vendor.weaver.value_size", options.valueSize, 1, kMaxValueSize);
+    options.storagePath = "/data/vendor/weaver/slots";
+
     ABinderProcess_setThreadPoolMaxThreadCount(0);
-    std::shared_ptr<Weaver> weaver = ndk::SharedRefBase::make<Weaver>();
+    std::shared_ptr<Weaver> weaver = ndk::SharedRefBase::make<Weaver>(options);
 
     const std::string instance = std::string() + Weaver::descriptor + "/default";
     binder_status_t status = AServiceManager_addService(weaver->asBinder().get(), instance.c_str());
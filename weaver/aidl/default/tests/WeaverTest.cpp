@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/stat.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "Weaver.h"
+
+using ::aidl::android::hardware::weaver::Weaver;
+using ::aidl::android::hardware::weaver::WeaverConfig;
+using ::aidl::android::hardware::weaver::WeaverReadResponse;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+const std::vector<uint8_t> KEY{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+const std::vector<uint8_t> WRONG_KEY{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0};
+const std::vector<uint8_t> VALUE{16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1};
+
+class WeaverTest : public ::testing::Test {
+  protected:
+    WeaverTest() {
+        mOptions.storagePath = std::string(mDir.path) + "/slots";
+        mOptions.freeAttempts = 2;
+        mOptions.initialBackoff = seconds(30);
+        mOptions.maxBackoff = seconds(100);
+    }
+
+    // Creates a weaver over the storage, as after a restart.
+    std::shared_ptr<Weaver> makeWeaver() {
+        return ndk::SharedRefBase::make<Weaver>(mOptions, [this] { return mNow; });
+    }
+
+    // Returns the service specific error of a read, or 0 on success.
+    int32_t read(const std::shared_ptr<Weaver>& weaver, int32_t slotId,
+                 const std::vector<uint8_t>& key, WeaverReadResponse* response) {
+        auto status = weaver->read(slotId, key, response);
+        if (status.isOk()) {
+            return 0;
+        }
+        EXPECT_EQ(EX_SERVICE_SPECIFIC, status.getExceptionCode());
+        return status.getServiceSpecificError();
+    }
+
+    TemporaryDir mDir;
+    Weaver::Options mOptions;
+    steady_clock::time_point mNow = steady_clock::time_point() + seconds(1000);
+};
+
+TEST_F(WeaverTest, ReportsConfig) {
+    mOptions.slots = 32;
+    mOptions.keySize = 24;
+    mOptions.valueSize = 48;
+    WeaverConfig config;
+    ASSERT_TRUE(makeWeaver()->getConfig(&config).isOk());
+    EXPECT_EQ(32, config.slots);
+    EXPECT_EQ(24, config.keySize);
+    EXPECT_EQ(48, config.valueSize);
+}
+
+TEST_F(WeaverTest, ReadsWhatWasWritten) {
+    auto weaver = makeWeaver();
+    ASSERT_TRUE(weaver->write(3, KEY, VALUE).isOk());
+    WeaverReadResponse response;
+    ASSERT_EQ(0, read(weaver, 3, KEY, &response));
+    EXPECT_EQ(VALUE, response.value);
+    EXPECT_EQ(0, response.timeout);
+
+    EXPECT_EQ(Weaver::STATUS_INCORRECT_KEY, read(weaver, 3, WRONG_KEY, &response));
+    EXPECT_TRUE(response.value.empty());
+    // Keys of other lengths don't match either.
+    EXPECT_EQ(Weaver::STATUS_INCORRECT_KEY,
+              read(weaver, 3, std::vector<uint8_t>(KEY.begin(), KEY.end() - 1), &response));
+}
+
+TEST_F(WeaverTest, RejectsInvalidArguments) {
+    auto weaver = makeWeaver();
+    const std::vector<uint8_t> longKey(17);
+    EXPECT_FALSE(weaver->write(-1, KEY, VALUE).isOk());
+    EXPECT_FALSE(weaver->write(16, KEY, VALUE).isOk());
+    EXPECT_FALSE(weaver->write(0, longKey, VALUE).isOk());
+    EXPECT_FALSE(weaver->write(0, KEY, std::vector<uint8_t>(17)).isOk());
+
+    WeaverReadResponse response;
+    EXPECT_EQ(Weaver::STATUS_FAILED, read(weaver, -1, KEY, &response));
+    EXPECT_EQ(Weaver::STATUS_FAILED, read(weaver, 16, KEY, &response));
+    EXPECT_EQ(Weaver::STATUS_FAILED, read(weaver, 0, longKey, &response));
+    EXPECT_EQ(0, response.timeout);
+}
+
+TEST_F(WeaverTest, KeepsSlotsAcrossRestarts) {
+    ASSERT_TRUE(makeWeaver()->write(15, KEY, VALUE).isOk());
+    auto weaver = makeWeaver();
+    WeaverReadResponse response;
+    ASSERT_EQ(0, read(weaver, 15, KEY, &response));
+    EXPECT_EQ(VALUE, response.value);
+}
+
+TEST_F(WeaverTest, StartsEmptyFromACorruptFile) {
+    ASSERT_TRUE(android::base::WriteStringToFile("garbage", mOptions.storagePath));
+    auto weaver = makeWeaver();
+    WeaverReadResponse response;
+    EXPECT_EQ(Weaver::STATUS_INCORRECT_KEY, read(weaver, 0, KEY, &response));
+    ASSERT_TRUE(weaver->write(0, KEY, VALUE).isOk());
+    ASSERT_EQ(0, read(makeWeaver(), 0, KEY, &response));
+
+    // The corrupt file is kept aside rather than overwritten.
+    std::string kept;
+    ASSERT_TRUE(android::base::ReadFileToString(mOptions.storagePath + ".corrupt", &kept));
+    EXPECT_EQ("garbage", kept);
+}
+
+TEST_F(WeaverTest, KeepsSlotsInMemoryWithoutStorage) {
+    const std::string dir = std::string(mDir.path) + "/missing";
+    mOptions.storagePath = dir + "/slots";
+    auto weaver = makeWeaver();
+    ASSERT_TRUE(weaver->write(0, KEY, VALUE).isOk());
+    EXPECT_FALSE(weaver->persisted());
+    WeaverReadResponse response;
+    ASSERT_EQ(0, read(weaver, 0, KEY, &response));
+    EXPECT_EQ(VALUE, response.value);
+
+    // Once storage works again, everything in memory is stored.
+    ASSERT_EQ(0, mkdir(dir.c_str(), 0700));
+    ASSERT_TRUE(weaver->write(1, KEY, VALUE).isOk());
+    EXPECT_TRUE(weaver->persisted());
+    weaver = makeWeaver();
+    ASSERT_EQ(0, read(weaver, 0, KEY, &response));
+    ASSERT_EQ(0, read(weaver, 1, KEY, &response));
+}
+
+TEST_F(WeaverTest, ThrottlesFailedReads) {
+    auto weaver = makeWeaver();
+    ASSERT_TRUE(weaver->write(0, KEY, VALUE).isOk());
+    ASSERT_TRUE(weaver->write(1, KEY, VALUE).isOk());
+    WeaverReadResponse response;
+
+    // The free attempts.
+    ASSERT_EQ(Weaver::STATUS_INCORRECT_KEY, read(weaver, 0, WRONG_KEY, &response));
+    EXPECT_EQ(0, response.timeout);
+    ASSERT_EQ(Weaver::STATUS_INCORRECT_KEY, read(weaver, 0, WRONG_KEY, &response));
+    EXPECT_EQ(0, response.timeout);
+
+    ASSERT_EQ(Weaver::STATUS_INCORRECT_KEY, read(weaver, 0, WRONG_KEY, &response));
+    EXPECT_EQ(30000, response.timeout);
+    // Even the right key is turned away while throttled.
+    mNow += milliseconds(10500);
+    ASSERT_EQ(Weaver::STATUS_THROTTLE, read(weaver, 0, KEY, &response));
+    EXPECT_EQ(19500, response.timeout);
+    EXPECT_TRUE(response.value.empty());
+    // Other slots aren't throttled.
+    ASSERT_EQ(0, read(weaver, 1, KEY, &response));
+
+    mNow += milliseconds(19500);
+    ASSERT_EQ(Weaver::STATUS_INCORRECT_KEY, read(weaver, 0, WRONG_KEY, &response));
+    EXPECT_EQ(60000, response.timeout);
+    mNow += seconds(60);
+    ASSERT_EQ(Weaver::STATUS_INCORRECT_KEY, read(weaver, 0, WRONG_KEY, &response));
+    EXPECT_EQ(100000, response.timeout);
+
+    // The right key resets the back-off.
+    mNow += seconds(100);
+    ASSERT_EQ(0, read(weaver, 0, KEY, &response));
+    EXPECT_EQ(VALUE, response.value);
+    ASSERT_EQ(Weaver::STATUS_INCORRECT_KEY, read(weaver, 0, WRONG_KEY, &response));
+    EXPECT_EQ(0, response.timeout);
+}
+
+TEST_F(WeaverTest, KeepsThrottlingAcrossRestarts) {
+    auto weaver = makeWeaver();
+    ASSERT_TRUE(weaver->write(0, KEY, VALUE).isOk());
+    WeaverReadResponse response;
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(Weaver::STATUS_INCORRECT_KEY, read(weaver, 0, WRONG_KEY, &response));
+    }
+
+    weaver = makeWeaver();
+    ASSERT_EQ(Weaver::STATUS_THROTTLE, read(weaver, 0, KEY, &response));
+    EXPECT_EQ(30000, response.timeout);
+    mNow += seconds(30);
+    ASSERT_EQ(Weaver::STATUS_INCORRECT_KEY, read(weaver, 0, WRONG_KEY, &response));
+    EXPECT_EQ(60000, response.timeout);
+}
+
+TEST_F(WeaverTest, WritingEndsThrottling) {
+    auto weaver = makeWeaver();
+    WeaverReadResponse response;
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(Weaver::STATUS_INCORRECT_KEY, read(weaver, 0, WRONG_KEY, &response));
+    }
+    ASSERT_TRUE(weaver->write(0, KEY, VALUE).isOk());
+    ASSERT_EQ(0, read(weaver, 0, KEY, &response));
+    EXPECT_EQ(VALUE, response.value);
+}
+
+TEST_F(WeaverTest, HandlesConcurrentAccess) {
+    constexpr int kThreads = 8;
+    constexpr int kIterations = 50;
+    mOptions.freeAttempts = kThreads * kIterations;
+    auto weaver = ndk::SharedRefBase::make<Weaver>(mOptions);
+    std::atomic<int> errors = 0;
+
+    // Each thread owns a slot, and all of them share slot 0, whose value is always its key.
+    std::vector<std::thread> threads;
+    for (int t = 1; t <= kThreads; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kIterations; i++) {
+                const std::vector<uint8_t> key(16, static_cast<uint8_t>(t));
+                const std::vector<uint8_t> value(16, static_cast<uint8_t>(i));
+                WeaverReadResponse response;
+                if (!weaver->write(t, key, value).isOk() ||
+                    !weaver->read(t, key, &response).isOk() || response.value != value) {
+                    errors++;
+                }
+                if (!weaver->write(0, key, key).isOk()) {
+                    errors++;
+                }
+                // Another thread may have rewritten the shared slot since.
+                auto status = weaver->read(0, key, &response);
+                if (status.isOk() ? response.value != key
+                                  : status.getServiceSpecificError() !=
+                                            Weaver::STATUS_INCORRECT_KEY) {
+                    errors++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(0, errors);
+
+    // Everything ended up stored.
+    weaver = makeWeaver();
+    for (int t = 1; t <= kThreads; t++) {
+        WeaverReadResponse response;
+        ASSERT_EQ(0, read(weaver, t, std::vector<uint8_t>(16, static_cast<uint8_t>(t)), &response));
+        EXPECT_EQ(std::vector<uint8_t>(16, static_cast<uint8_t>(kIterations - 1)), response.value);
+    }
+}
+
+}  // namespace
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BatchRelay.h"
+
+#include <android-base/logging.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace android::nlinterceptor {
+
+BatchRelay::BatchRelay(int fd, Router router, const Config& config)
+    : mFd(fd),
+      mRouter(std::move(router)),
+      mConfig(config),
+      mEpollFd(epoll_create1(EPOLL_CLOEXEC)),
+      mStopFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+      mPool(config.poolSize * config.bufferSize),
+      mSlots(config.poolSize),
+      mHeaders(config.batchSize) {
+    CHECK(config.batchSize > 0 && config.poolSize >= config.batchSize)
+        << "Pool must hold at least one batch";
+    mFreeSlots.reserve(config.poolSize);
+    for (size_t i = 0; i < config.poolSize; i++) {
+        mSlots[i].iov = {&mPool[i * config.bufferSize], config.bufferSize};
+        mFreeSlots.push_back(config.poolSize - 1 - i);
+    }
+}
+
+bool BatchRelay::run() {
+    if (!mEpollFd.ok() || !mStopFd.ok()) {
+        LOG(ERROR) << "Failed to set up relay: epoll or eventfd missing";
+        return false;
+    }
+    epoll_event stopEvent = {.events = EPOLLIN, .data = {.fd = mStopFd.get()}};
+    epoll_event sockEvent = {.events = EPOLLIN, .data = {.fd = mFd}};
+    if (epoll_ctl(mEpollFd.get(), EPOLL_CTL_ADD, mStopFd.get(), &stopEvent) <
+            0 ||
+        epoll_ctl(mEpollFd.get(), EPOLL_CTL_ADD, mFd, &sockEvent) < 0) {
+        PLOG(ERROR) << "Failed to set up relay epoll";
+        return false;
+    }
+
+    bool blocked = false;
+    epoll_event events[2];
+    while (true) {
+        // A blocked destination doesn't make our own socket unwritable (at
+        // least for Netlink), so it's retried on a timer rather than EPOLLOUT.
+        const int timeout = blocked ? mConfig.retryInterval.count() : -1;
+        const int count = epoll_wait(mEpollFd.get(), events, 2, timeout);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            PLOG(ERROR) << "epoll_wait failed";
+            return false;
+        }
+
+        bool readable = false;
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.fd == mStopFd.get()) return true;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                LOG(ERROR) << "Relayed socket is bad";
+                return false;
+            }
+            readable |= (events[i].events & EPOLLIN) != 0;
+        }
+
+        if (readable && !receiveBatch()) return false;
+        if (!sendPending(&blocked)) return false;
+    }
+}
+
+void BatchRelay::stop() {
+    const uint64_t one = 1;
+    if (TEMP_FAILURE_RETRY(write(mStopFd.get(), &one, sizeof(one))) < 0) {
+        PLOG(ERROR) << "Failed to signal relay to stop";
+    }
+}
+
+BatchRelay::Stats BatchRelay::getStats() const {
+    return {
+        .received = mStats.received,
+        .relayed = mStats.relayed,
+        .dropped = mStats.dropped,
+        .rejected = mStats.rejected,
+        .truncated = mStats.truncated,
+        .overruns = mStats.overruns,
+    };
+}
+
+void BatchRelay::dropOldest(size_t count) {
+    count = std::min(count, mPendingSlots.size());
+    for (size_t i = 0; i < count; i++) {
+        mFreeSlots.push_back(mPendingSlots.front());
+        mPendingSlots.pop_front();
+    }
+    mStats.dropped += count;
+}
+
+bool BatchRelay::receiveBatch() {
+    if (mFreeSlots.size() < mConfig.batchSize) {
+        dropOldest(mConfig.batchSize - mFreeSlots.size());
+    }
+
+    const size_t batch = mConfig.batchSize;
+    mBatchSlots.assign(mFreeSlots.end() - batch, mFreeSlots.end());
+    mFreeSlots.resize(mFreeSlots.size() - batch);
+    for (size_t i = 0; i < batch; i++) {
+        auto& slot = mSlots[mBatchSlots[i]];
+        mHeaders[i] = {};
+        mHeaders[i].msg_hdr.msg_name = &slot.datagram.address;
+        mHeaders[i].msg_hdr.msg_namelen = sizeof(slot.datagram.address);
+        mHeaders[i].msg_hdr.msg_iov = &slot.iov;
+        mHeaders[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    const int count = TEMP_FAILURE_RETRY(
+        recvmmsg(mFd, mHeaders.data(), batch, MSG_DONTWAIT, nullptr));
+    const int error = errno;
+    const size_t received = std::max(count, 0);
+
+    for (size_t i = 0; i < received; i++) {
+        const size_t index = mBatchSlots[i];
+        auto& slot = mSlots[index];
+        const auto& header = mHeaders[i];
+        mStats.received++;
+
+        slot.datagram.data = static_cast<const uint8_t*>(slot.iov.iov_base);
+        slot.datagram.size = header.msg_len;
+        slot.datagram.addressLength = header.msg_hdr.msg_namelen;
+        if (header.msg_hdr.msg_flags & MSG_TRUNC) {
+            mStats.truncated++;
+            mFreeSlots.push_back(index);
+        } else if (!mRouter(slot.datagram)) {
+            mStats.rejected++;
+            mFreeSlots.push_back(index);
+        } else {
+            mPendingSlots.push_back(index);
+        }
+    }
+    mFreeSlots.insert(mFreeSlots.end(), mBatchSlots.begin() + received,
+                      mBatchSlots.end());
+
+    if (count < 0) {
+        if (error == EAGAIN || error == EWOULDBLOCK) return true;
+        if (error == ENOBUFS) {
+            // The kernel dropped datagrams for us, the socket is still fine.
+            mStats.overruns++;
+            return true;
+        }
+        errno = error;
+        PLOG(ERROR) << "Failed to receive datagrams";
+        return false;
+    }
+    return true;
+}
+
+bool BatchRelay::sendPending(bool* blocked) {
+    *blocked = false;
+    while (!mPendingSlots.empty()) {
+        const size_t batch = std::min(mConfig.batchSize, mPendingSlots.size());
+        for (size_t i = 0; i < batch; i++) {
+            auto& slot = mSlots[mPendingSlots[i]];
+            slot.iov.iov_len = slot.datagram.size;
+            mHeaders[i] = {};
+            if (slot.datagram.addressLength > 0) {
+                mHeaders[i].msg_hdr.msg_name = &slot.datagram.address;
+                mHeaders[i].msg_hdr.msg_namelen = slot.datagram.addressLength;
+            }
+            mHeaders[i].msg_hdr.msg_iov = &slot.iov;
+            mHeaders[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        const int count =
+            sendmmsg(mFd, mHeaders.data(), batch, MSG_DONTWAIT | MSG_NOSIGNAL);
+        const int error = errno;
+
+        // Restore the buffer length for the slots going back to the pool.
+        for (size_t i = 0; i < batch; i++) {
+            mSlots[mPendingSlots[i]].iov.iov_len = mConfig.bufferSize;
+        }
+
+        if (count < 0) {
+            switch (error) {
+                case EINTR:
+                    continue;
+                case EAGAIN:
+                case ENOBUFS:
+                    *blocked = true;
+                    return true;
+                case ECONNREFUSED:
+                    // Destination is gone, only its datagram is lost.
+                    dropOldest(1);
+                    continue;
+                default:
+                    errno = error;
+                    PLOG(ERROR) << "Failed to send datagrams";
+                    return false;
+            }
+        }
+
+        for (int i = 0; i < count; i++) {
+            mFreeSlots.push_back(mPendingSlots.front());
+            mPendingSlots.pop_front();
+        }
+        mStats.relayed += count;
+    }
+    return true;
+}
+
+}  // namespace android::nlinterceptor
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace android::nlinterceptor {
+
+/**
+ * Relays datagrams received on a socket back out of the same socket, to a
+ * destination picked for each datagram.
+ *
+ * Datagrams are drained in batches with recvmmsg into a fixed pool of
+ * buffers, and forwarded from those same buffers in batches with sendmmsg.
+ * When a destination is too slow to keep up, datagrams wait in the pool; once
+ * the pool is exhausted, the oldest waiting datagrams are dropped to make
+ * room for new ones, so the kernel side of the socket keeps being drained.
+ */
+class BatchRelay {
+   public:
+    struct Config {
+        size_t batchSize = 32;    ///< Datagrams per recvmmsg/sendmmsg call.
+        size_t poolSize = 128;    ///< Buffers, i.e. datagrams held at most.
+        size_t bufferSize = 8192; ///< Largest datagram relayed.
+        /** How long to wait before retrying a blocked destination. */
+        std::chrono::milliseconds retryInterval{5};
+    };
+
+    struct Stats {
+        uint64_t received = 0;
+        uint64_t relayed = 0;
+        /** Dropped because the destination couldn't keep up or is gone. */
+        uint64_t dropped = 0;
+        /** Rejected by the router. */
+        uint64_t rejected = 0;
+        /** Larger than Config::bufferSize. */
+        uint64_t truncated = 0;
+        /** Times the socket reported lost datagrams (ENOBUFS). */
+        uint64_t overruns = 0;
+    };
+
+    /** A received datagram, it's relayed from where it was received. */
+    struct Datagram {
+        const uint8_t* data;
+        size_t size;
+        /** Source address on input, destination address on output. */
+        sockaddr_storage address;
+        /** Set to 0 to send on a connected socket without an address. */
+        socklen_t addressLength;
+    };
+
+    /**
+     * Rewrites a datagram's source address to its destination address.
+     * Returns false to drop the datagram.
+     */
+    using Router = std::function<bool(Datagram& datagram)>;
+
+    /**
+     * \param fd - socket to relay on; it's not owned by the relay.
+     * \param router - picks the destination of each datagram.
+     */
+    BatchRelay(int fd, Router router, const Config& config);
+    BatchRelay(int fd, Router router) : BatchRelay(fd, router, Config{}) {}
+
+    /**
+     * Relays datagrams until stop() is called.
+     *
+     * \return false if it stopped because of a socket error.
+     */
+    bool run();
+
+    /** Makes run() return. Safe to call from any thread, even before run(). */
+    void stop();
+
+    Stats getStats() const;
+
+   private:
+    struct Slot {
+        Datagram datagram;
+        iovec iov;
+    };
+
+    const int mFd;
+    const Router mRouter;
+    const Config mConfig;
+
+    base::unique_fd mEpollFd;
+    base::unique_fd mStopFd;
+
+    std::vector<uint8_t> mPool;
+    std::vector<Slot> mSlots;
+    std::vector<size_t> mFreeSlots;
+    std::deque<size_t> mPendingSlots;  ///< In the order they were received.
+    std::vector<size_t> mBatchSlots;   ///< Slots lent to the current recvmmsg.
+    std::vector<mmsghdr> mHeaders;
+
+    struct AtomicStats {
+        std::atomic<uint64_t> received = 0;
+        std::atomic<uint64_t> relayed = 0;
+        std::atomic<uint64_t> dropped = 0;
+        std::atomic<uint64_t> rejected = 0;
+        std::atomic<uint64_t> truncated = 0;
+        std::atomic<uint64_t> overruns = 0;
+    } mStats;
+
+    bool receiveBatch();
+    bool sendPending(bool* blocked);
+    void dropOldest(size_t count);
+};
+
+}  // namespace android::nlinterceptor
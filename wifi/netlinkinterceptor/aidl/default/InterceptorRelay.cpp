@@ -18,26 +18,27 @@
 
 #include <android-base/logging.h>
 #include <libnl++/printer.h>
-#include <poll.h>
-
-#include <chrono>
-
-#include "util.h"
 
 namespace android::nlinterceptor {
-using namespace std::chrono_literals;
 
-static constexpr std::chrono::milliseconds kPollTimeout = 300ms;
-static constexpr bool kSuperVerbose = true;
+// Logs every relayed message. The service logs at VERBOSE, so this is too
+// expensive to leave on during scan storms.
+static constexpr bool kSuperVerbose = false;
 
 InterceptorRelay::InterceptorRelay(uint32_t nlFamily, uint32_t clientNlPid,
                                    const std::string& clientName)
     : mClientName(clientName),
       mNlSocket(std::make_optional<nl::Socket>(nlFamily, 0, 0)),
-      mClientNlPid(clientNlPid) {}
+      mClientNlPid(clientNlPid) {
+    // nl::Socket doesn't expose its descriptor other than for polling.
+    const int fd = mNlSocket->preparePoll().fd;
+    mRelay.emplace(fd, [this](BatchRelay::Datagram& datagram) {
+        return routeMessage(datagram);
+    });
+}
 
 InterceptorRelay::~InterceptorRelay() {
-    mRunning = false;
+    mRelay->stop();
     if (mRelayThread.joinable()) mRelayThread.join();
 }
 
@@ -47,53 +48,38 @@ uint32_t InterceptorRelay::getPid() {
     return *pidMaybe;
 }
 
+bool InterceptorRelay::routeMessage(BatchRelay::Datagram& datagram) {
+    const nl::Buffer<nlmsghdr> msg(
+        reinterpret_cast<const nlmsghdr*>(datagram.data), datagram.size);
+    if (!msg.firstOk()) {
+        LOG(ERROR) << "Netlink packet is malformed!";
+        // Test messages might be empty, this isn't fatal.
+        return false;
+    }
+    if constexpr (kSuperVerbose) {
+        LOG(VERBOSE) << "[" << mClientName
+                     << "] nlMsg: " << nl::toString(msg, NETLINK_GENERIC);
+    }
+
+    auto& sa = reinterpret_cast<sockaddr_nl&>(datagram.address);
+    const uint32_t destinationPid = sa.nl_pid == 0 ? mClientNlPid : 0;
+    sa = {.nl_family = AF_NETLINK,
+          .nl_pad = 0,
+          .nl_pid = destinationPid,
+          .nl_groups = 0};
+    datagram.addressLength = sizeof(sa);
+    return true;
+}
+
 void InterceptorRelay::relayMessages() {
-    pollfd fds[] = {
-        mNlSocket->preparePoll(POLLIN),
-    };
-    while (mRunning) {
-        if (poll(fds, countof(fds), kPollTimeout.count()) < 0) {
-            PLOG(FATAL) << "poll failed";
-            return;
-        }
-        const auto nlsockEvents = fds[0].revents;
-
-        if (isSocketBad(nlsockEvents)) {
-            LOG(ERROR) << "Netlink socket is bad";
-            mRunning = false;
-            return;
-        }
-        if (!isSocketReadable(nlsockEvents)) continue;
-
-        const auto [msgMaybe, sa] = mNlSocket->receiveFrom();
-        if (!msgMaybe.has_value()) {
-            LOG(ERROR) << "Failed to receive Netlink data!";
-            mRunning = false;
-            return;
-        }
-        const auto msg = *msgMaybe;
-        if (!msg.firstOk()) {
-            LOG(ERROR) << "Netlink packet is malformed!";
-            // Test messages might be empty, this isn't fatal.
-            continue;
-        }
-        if constexpr (kSuperVerbose) {
-            LOG(VERBOSE) << "[" << mClientName
-                         << "] nlMsg: " << nl::toString(msg, NETLINK_GENERIC);
-        }
-
-        uint32_t destinationPid = 0;
-        if (sa.nl_pid == 0) {
-            destinationPid = mClientNlPid;
-        }
-
-        if (!mNlSocket->send(msg, destinationPid)) {
-            LOG(ERROR) << "Failed to send Netlink message!";
-            mRunning = false;
-            return;
-        }
+    if (!mRelay->run()) {
+        LOG(ERROR) << "[" << mClientName << "] Netlink relay failed";
     }
-    LOG(VERBOSE) << "[" << mClientName << "] Exiting relay thread!";
+    const auto stats = mRelay->getStats();
+    LOG(VERBOSE) << "[" << mClientName << "] Exiting relay thread! relayed "
+                 << stats.relayed << "/" << stats.received << ", dropped "
+                 << stats.dropped << ", overruns " << stats.overruns;
+    mRunning = false;
 }
 
 bool InterceptorRelay::start() {
@@ -21,6 +21,8 @@
 #include <mutex>
 #include <thread>
 
+#include "BatchRelay.h"
+
 namespace android::nlinterceptor {
 
 class InterceptorRelay {
@@ -74,16 +76,24 @@ class InterceptorRelay {
     const uint32_t mClientNlPid = 0;  ///< pid of client NL socket.
 
     /**
-     * If set to true, the relay thread should be running. Setting this to false
-     * stops the relay thread.
+     * Set to true while the relay thread is running.
      */
     std::atomic_bool mRunning = false;
 
     /**
-     * Reads incoming Netlink messages destined for mNlSocket. If from the
-     * kernel, the message is relayed to the client specified in the
-     * constructor. Otherwise, the message is relayed to the kernel. This will
-     * run as long as mRunning is set to true.
+     * Relays incoming Netlink messages destined for mNlSocket, in batches.
+     */
+    std::optional<BatchRelay> mRelay;
+
+    /**
+     * Picks the destination of a Netlink message: if from the kernel, the
+     * message is relayed to the client specified in the constructor.
+     * Otherwise, the message is relayed to the kernel.
+     */
+    bool routeMessage(BatchRelay::Datagram& datagram);
+
+    /**
+     * Runs mRelay until the relay is stopped or the socket fails.
      */
     void relayMessages();
 
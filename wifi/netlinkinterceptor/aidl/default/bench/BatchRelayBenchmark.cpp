@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+#include <benchmark/benchmark.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "BatchRelay.h"
+
+using ::android::base::unique_fd;
+using ::android::nlinterceptor::BatchRelay;
+using ::benchmark::Counter;
+using ::benchmark::State;
+
+namespace {
+
+/**
+ * Client side of a relay: sends a window of datagrams and waits for all of
+ * them to come back, using batched calls so the relay is what's measured.
+ */
+class Client {
+   public:
+    Client(int fd, size_t window, size_t size)
+        : mFd(fd),
+          mBuffers(window, std::vector<uint8_t>(size, 0x5a)),
+          mIovs(window),
+          mHeaders(window) {
+        for (size_t i = 0; i < window; i++) {
+            mIovs[i] = {mBuffers[i].data(), size};
+            mHeaders[i].msg_hdr.msg_iov = &mIovs[i];
+            mHeaders[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    void roundTrip() {
+        CHECK_EQ(sendmmsg(mFd, mHeaders.data(), mHeaders.size(), 0),
+                 static_cast<int>(mHeaders.size()));
+        size_t received = 0;
+        while (received < mHeaders.size()) {
+            const int count =
+                recvmmsg(mFd, mHeaders.data() + received,
+                         mHeaders.size() - received, MSG_WAITFORONE, nullptr);
+            CHECK_GT(count, 0);
+            received += count;
+        }
+    }
+
+   private:
+    const int mFd;
+    std::vector<std::vector<uint8_t>> mBuffers;
+    std::vector<iovec> mIovs;
+    std::vector<mmsghdr> mHeaders;
+};
+
+void runBatchRelay(State& state, int relayFd, int clientFd,
+                   BatchRelay::Router router) {
+    const size_t size = state.range(0);
+    const size_t window = state.range(1);
+    BatchRelay relay(relayFd, router);
+    std::thread thread([&relay] { CHECK(relay.run()); });
+
+    Client client(clientFd, window, size);
+    for (auto _ : state) client.roundTrip();
+
+    relay.stop();
+    thread.join();
+    const auto stats = relay.getStats();
+    CHECK_EQ(stats.dropped, 0u);
+    state.counters["datagrams"] = Counter(stats.relayed, Counter::kIsRate);
+    state.SetBytesProcessed(stats.relayed * size);
+}
+
+/** Echoes datagrams back to the other end of a connected socket. */
+bool routeToPeer(BatchRelay::Datagram& datagram) {
+    datagram.addressLength = 0;
+    return true;
+}
+
+/** Echoes Netlink datagrams back to the port they came from. */
+bool routeToSender(BatchRelay::Datagram& /* datagram */) { return true; }
+
+void BM_BatchRelay_SocketPair(State& state) {
+    int fds[2];
+    CHECK_EQ(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds), 0);
+    unique_fd relayFd(fds[0]), clientFd(fds[1]);
+    runBatchRelay(state, relayFd.get(), clientFd.get(), routeToPeer);
+}
+
+unique_fd openUserSock() {
+    unique_fd fd(socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_USERSOCK));
+    sockaddr_nl sa = {};
+    sa.nl_family = AF_NETLINK;
+    CHECK(fd.ok() &&
+          bind(fd.get(), reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) == 0);
+    return fd;
+}
+
+void BM_BatchRelay_Netlink(State& state) {
+    auto relayFd = openUserSock();
+    auto clientFd = openUserSock();
+    sockaddr_nl relayAddr = {};
+    socklen_t len = sizeof(relayAddr);
+    CHECK_EQ(getsockname(relayFd.get(),
+                         reinterpret_cast<sockaddr*>(&relayAddr), &len),
+             0);
+    CHECK_EQ(connect(clientFd.get(), reinterpret_cast<sockaddr*>(&relayAddr),
+                     sizeof(relayAddr)),
+             0);
+    runBatchRelay(state, relayFd.get(), clientFd.get(), routeToSender);
+}
+
+/** The relay loop this replaced: one poll, recvfrom and sendto per datagram. */
+void BM_SingleRelay_SocketPair(State& state) {
+    int fds[2];
+    CHECK_EQ(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds), 0);
+    unique_fd relayFd(fds[0]), clientFd(fds[1]);
+    const size_t size = state.range(0);
+    const size_t window = state.range(1);
+
+    std::atomic_bool running = true;
+    std::thread thread([&] {
+        std::vector<uint8_t> buffer(8192);
+        pollfd pfd = {relayFd.get(), POLLIN, 0};
+        while (running) {
+            if (poll(&pfd, 1, 10) <= 0) continue;
+            const auto n =
+                recvfrom(relayFd.get(), buffer.data(), buffer.size(), 0,
+                         nullptr, nullptr);
+            CHECK_GT(n, 0);
+            std::vector<uint8_t> copy(buffer.begin(), buffer.begin() + n);
+            CHECK_EQ(send(relayFd.get(), copy.data(), copy.size(), 0), n);
+        }
+    });
+
+    Client client(clientFd.get(), window, size);
+    for (auto _ : state) client.roundTrip();
+
+    running = false;
+    thread.join();
+    state.counters["datagrams"] =
+        Counter(state.iterations() * window, Counter::kIsRate);
+    state.SetBytesProcessed(state.iterations() * window * size);
+}
+
+void DefaultArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"size", "window"});
+    for (int64_t size : {64, 1024}) {
+        for (int64_t window : {1, 32}) b->Args({size, window});
+    }
+}
+
+BENCHMARK(BM_BatchRelay_SocketPair)->Apply(DefaultArgs);
+BENCHMARK(BM_BatchRelay_Netlink)->Apply(DefaultArgs);
+BENCHMARK(BM_SingleRelay_SocketPair)->Apply(DefaultArgs);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/unique_fd.h>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BatchRelay.h"
+
+namespace android::nlinterceptor {
+namespace {
+
+using ::android::base::unique_fd;
+
+/**
+ * A Unix datagram socket bound to an autobound abstract address. Unix
+ * datagram sockets push back on senders once the receiver's queue is full,
+ * which is what a slow Netlink destination does to the relay.
+ */
+struct Socket {
+    Socket() : fd(socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0)) {
+        sockaddr_un autobind = {};
+        autobind.sun_family = AF_UNIX;
+        EXPECT_EQ(0, bind(fd.get(), reinterpret_cast<sockaddr*>(&autobind),
+                          sizeof(sa_family_t)));
+        addressLength = sizeof(address);
+        EXPECT_EQ(0,
+                  getsockname(fd.get(), reinterpret_cast<sockaddr*>(&address),
+                              &addressLength));
+    }
+
+    void sendTo(const Socket& destination, uint32_t sequence,
+                size_t size = sizeof(uint32_t)) {
+        std::vector<uint8_t> data(std::max(size, sizeof(sequence)));
+        memcpy(data.data(), &sequence, sizeof(sequence));
+        const auto address =
+            reinterpret_cast<const sockaddr*>(&destination.address);
+        ASSERT_EQ(static_cast<ssize_t>(data.size()),
+                  sendto(fd.get(), data.data(), data.size(), 0, address,
+                         destination.addressLength));
+    }
+
+    /** Receives everything queued, returns the sequence numbers in order. */
+    std::vector<uint32_t> drain() {
+        std::vector<uint32_t> sequences;
+        uint32_t sequence;
+        while (recv(fd.get(), &sequence, sizeof(sequence), MSG_DONTWAIT) ==
+               sizeof(sequence)) {
+            sequences.push_back(sequence);
+        }
+        return sequences;
+    }
+
+    /** Waits for the next datagram, returns its sequence number. */
+    uint32_t receive() {
+        const timeval timeout = {5, 0};
+        setsockopt(fd.get(), SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                   sizeof(timeout));
+        uint32_t sequence = UINT32_MAX;
+        EXPECT_EQ(static_cast<ssize_t>(sizeof(sequence)),
+                  recv(fd.get(), &sequence, sizeof(sequence), 0));
+        return sequence;
+    }
+
+    unique_fd fd;
+    sockaddr_storage address;
+    socklen_t addressLength;
+};
+
+class BatchRelayTest : public ::testing::Test {
+   protected:
+    static constexpr BatchRelay::Config kConfig = {
+        .batchSize = 4,
+        .poolSize = 8,
+        .bufferSize = 64,
+        .retryInterval = std::chrono::milliseconds(1),
+    };
+
+    void SetUp() override {
+        mRelay = std::make_unique<BatchRelay>(
+            mRelaySocket.fd.get(),
+            [this](BatchRelay::Datagram& datagram) {
+                uint32_t sequence;
+                memcpy(&sequence, datagram.data, sizeof(sequence));
+                const bool accept = !mRejectOdd || sequence % 2 == 0;
+                datagram.address = mDestination.address;
+                datagram.addressLength = mDestination.addressLength;
+
+                std::lock_guard<std::mutex> lock(mLock);
+                mRouted = sequence;
+                mRoutedCv.notify_all();
+                return accept;
+            },
+            kConfig);
+        mThread = std::thread([this] { EXPECT_TRUE(mRelay->run()); });
+    }
+
+    void TearDown() override { stopRelay(); }
+
+    /** Waits for the relay to have received the given datagram. */
+    void waitForRouted(uint32_t sequence) {
+        std::unique_lock<std::mutex> lock(mLock);
+        ASSERT_TRUE(mRoutedCv.wait_for(lock, std::chrono::seconds(5), [&] {
+            return mRouted == sequence;
+        }));
+    }
+
+    /** Stops the relay, so that its stats are final. */
+    void stopRelay() {
+        if (mThread.joinable()) {
+            mRelay->stop();
+            mThread.join();
+        }
+    }
+
+    Socket mClient;
+    Socket mRelaySocket;
+    Socket mDestination;
+    bool mRejectOdd = false;
+    std::unique_ptr<BatchRelay> mRelay;
+    std::thread mThread;
+
+    std::mutex mLock;
+    std::condition_variable mRoutedCv;
+    uint32_t mRouted = UINT32_MAX;
+};
+
+TEST_F(BatchRelayTest, OverflowDropsOldestDatagrams) {
+    // The destination isn't read, so its queue fills up and the relay's pool
+    // overflows.
+    constexpr uint32_t kCount = 100;
+    for (uint32_t i = 0; i < kCount; i++) mClient.sendTo(mRelaySocket, i);
+    waitForRouted(kCount - 1);
+
+    // The destination got the first datagrams, up to what its queue holds.
+    const std::vector<uint32_t> first = mDestination.drain();
+    ASSERT_FALSE(first.empty());
+    for (size_t i = 0; i < first.size(); i++) EXPECT_EQ(i, first[i]);
+
+    // The datagrams still held in the pool are the newest ones, and go out
+    // once the destination accepts them again.
+    std::vector<uint32_t> second = {mDestination.receive()};
+    while (second.back() < kCount - 1) {
+        second.push_back(mDestination.receive());
+        ASSERT_EQ(second[second.size() - 2] + 1, second.back());
+    }
+    EXPECT_LE(second.size(), kConfig.poolSize);
+    stopRelay();
+
+    const auto stats = mRelay->getStats();
+    EXPECT_EQ(kCount, stats.received);
+    EXPECT_EQ(first.size() + second.size(), stats.relayed);
+    EXPECT_EQ(kCount - stats.relayed, stats.dropped);
+    EXPECT_EQ(0u, stats.rejected);
+    EXPECT_EQ(0u, stats.truncated);
+}
+
+TEST_F(BatchRelayTest, CountsRejectedAndTruncatedDatagrams) {
+    mRejectOdd = true;
+    mClient.sendTo(mRelaySocket, 0);
+    mClient.sendTo(mRelaySocket, 1);
+    mClient.sendTo(mRelaySocket, 2, kConfig.bufferSize + 1);
+    mClient.sendTo(mRelaySocket, 3);
+    mClient.sendTo(mRelaySocket, 4);
+    waitForRouted(4);
+    EXPECT_EQ(0u, mDestination.receive());
+    EXPECT_EQ(4u, mDestination.receive());
+    stopRelay();
+
+    const auto stats = mRelay->getStats();
+    EXPECT_EQ(5u, stats.received);
+    EXPECT_EQ(2u, stats.relayed);
+    EXPECT_EQ(2u, stats.rejected);
+    EXPECT_EQ(1u, stats.truncated);
+    EXPECT_EQ(0u, stats.dropped);
+}
+
+}  // namespace
+}  // namespace android::nlinterceptor